@@ -0,0 +1,49 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/proxy/message_format.hpp"
+#include "include/utils/addr_storage.hpp"
+
+#include <vector>
+
+/**
+ * @brief Run the microbenchmarks selected by the Google Benchmark command line
+ *        arguments (e.g. --benchmark_filter=querier), target CONFIG+=bench.
+ *        The querier benchmarks need a raw socket like the proxy.
+ */
+int run_benchmarks(int arg_count, char* args[]);
+
+/**
+ * @brief Address number @p n of a benchmark, from 10.0.0.1 or fd00::1 on for sources and from 239.1.0.0 or ff05::1:0 on for groups.
+ */
+addr_storage bench_addr(int addr_family, bool group, unsigned int n);
+
+/**
+ * @brief Source list of the sources number @p first up to first + count.
+ */
+source_list<source> bench_slist(int addr_family, unsigned int first, unsigned int count);
+
+#endif // BENCH_HPP
@@ -118,8 +118,19 @@ void hc_set_log_fun(hc_log_fun_t function_ptr);
  */
 void hc_log(int log_lvl, const char* function_name, const char* log_msg);
 
+/**
+ * @brief Check if a message of the level @p log_lvl would be logged by the
+ *        current log function, the log macros format a message only if so.
+ * @returns @c 1 if the level is logged; otherwise @c 0
+ */
+int hc_log_lvl_enabled(int log_lvl);
+
 /**
  * @brief Get a default logging implementation (one logfile per thread).
+ *        The messages are queued without blocking and written by a background
+ *        thread, if a thread logs faster than they are written the excess
+ *        messages are dropped and counted in its logfile. The function name
+ *        passed to hc_log() has to be a string literal like @c HC_FUN.
  * @param log_lvl The desired logging level.
  * @returns Set a log function that discards all log messages with
  *         <code>level < @p log_lvl</code>.
@@ -202,8 +213,9 @@ int hc_logging_enabled();
 
 #elif defined(__cplusplus)
 
+//the message is only formatted if its level is logged
 #define HC_DO_LOG(message, loglvl)                                             \
-    {                                                                          \
+    if (!hc_log_lvl_enabled(loglvl)) { } else {                                \
         std::ostringstream scoped_oss;                                         \
         scoped_oss << message;                                                 \
         std::string scoped_osss = scoped_oss.str();                            \
@@ -215,7 +227,10 @@ namespace
 template<int m_lvl>
 struct HC_trace_helper {
     const char* m_fun;
-    HC_trace_helper(const char* fun, const std::string& initmsg) : m_fun(fun) {
+    bool m_enabled;
+    HC_trace_helper(const char* fun) : m_fun(fun), m_enabled(hc_log_lvl_enabled(m_lvl)) {
+    }
+    void enter(const std::string& initmsg) {
         std::string msg = "ENTER";
         if (!initmsg.empty()) {
             msg += ": ";
@@ -224,22 +239,30 @@ struct HC_trace_helper {
         hc_log(m_lvl, m_fun, msg.c_str());
     }
     ~HC_trace_helper() {
-        hc_log(m_lvl, m_fun, "LEAVE");
+        if (m_enabled) {
+            hc_log(m_lvl, m_fun, "LEAVE");
+        }
     }
 };
 }
 
 #define HC_LOG_TRACE(message)                                                  \
-    ::std::ostringstream hc_trace_helper_##__LINE__ ;                          \
-    hc_trace_helper_##__LINE__ << message ;                                    \
     ::HC_trace_helper< HC_LOG_TRACE_LVL > hc_fun_HC_trace_helper_##__LINE__    \
-        ( HC_FUN , hc_trace_helper_##__LINE__ .str() )
+        ( HC_FUN );                                                            \
+    if (hc_fun_HC_trace_helper_##__LINE__ .m_enabled) {                        \
+        ::std::ostringstream hc_trace_helper_##__LINE__ ;                      \
+        hc_trace_helper_##__LINE__ << message ;                                \
+        hc_fun_HC_trace_helper_##__LINE__ .enter(hc_trace_helper_##__LINE__ .str()); \
+    } ((void) 0)
 
 #define HC_LOG_SCOPE(scope_name, message)                                      \
-    ::std::ostringstream hc_trace_helper_##__LINE__ ;                          \
-    hc_trace_helper_##__LINE__ << message ;                                    \
     ::HC_trace_helper< HC_LOG_TRACE_LVL > hc_fun_HC_trace_helper_##__LINE__    \
-        ( scope_name , hc_trace_helper_##__LINE__ .str() )
+        ( scope_name );                                                        \
+    if (hc_fun_HC_trace_helper_##__LINE__ .m_enabled) {                        \
+        ::std::ostringstream hc_trace_helper_##__LINE__ ;                      \
+        hc_trace_helper_##__LINE__ << message ;                                \
+        hc_fun_HC_trace_helper_##__LINE__ .enter(hc_trace_helper_##__LINE__ .str()); \
+    } ((void) 0)
 
 #define HC_PRINT(message) std::cerr << message << std::endl;
 
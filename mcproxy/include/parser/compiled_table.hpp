@@ -0,0 +1,116 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+#ifndef COMPILED_TABLE_HPP
+#define COMPILED_TABLE_HPP
+
+#include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#define COMPILED_TABLE_MAX_DEPTH 16 //maximum nesting of tables and table references
+
+/**
+ * @brief The rules of a table flattened at configuration time. The rules are grouped by the
+ *        name of their input interface, the group addresses of each group of rules are split
+ *        into sorted intervals, each with the sorted and merged source intervals of the rules
+ *        covering it. A match is a binary search over the group intervals and a binary search
+ *        over the source intervals.
+ */
+class compiled_table
+{
+private:
+    //rules with the same input interface
+    struct rule_set {
+        //group and source interval of each rule, including from and to, cleared by build()
+        std::vector<std::pair<mc_addr, mc_addr>> m_groups;
+        std::vector<std::pair<mc_addr, mc_addr>> m_sources;
+
+        //first group address of each interval, neighbouring intervals have different source intervals
+        std::vector<mc_addr> m_bounds;
+
+        //the source intervals of interval i are m_source_set[m_offsets[i]] to m_source_set[m_offsets[i + 1]] (excluding)
+        std::vector<uint32_t> m_offsets;
+        std::vector<std::pair<mc_addr, mc_addr>> m_source_set;
+
+        void build(int addr_family);
+        bool match(const mc_addr& gaddr, const mc_addr& saddr) const;
+    };
+
+    //the rule sets of the existing interfaces by interface index, sorted
+    struct if_index_map {
+        unsigned int m_generation; //of the interface names it is resolved with
+        std::vector<std::pair<unsigned int, const rule_set*>> m_rules;
+    };
+
+    int m_addr_family;
+
+    //sorted by interface name
+    std::vector<std::pair<std::string, rule_set>> m_if_rules;
+
+    //rules without an interface name
+    rule_set m_any_if_rules;
+
+    //resolved again after the interface names have changed, the replaced maps are kept
+    //until the table is destroyed because a concurrent match() may still read them
+    mutable std::atomic<const if_index_map*> m_if_index_map;
+    mutable std::mutex m_resolve_lock;
+    mutable std::vector<std::unique_ptr<if_index_map>> m_if_index_maps;
+
+    rule_set& get_rule_set(const std::string& if_name);
+
+    //map the interface names of the rule sets to the current interface indexes
+    const if_index_map* resolve() const;
+
+public:
+    compiled_table(int addr_family);
+
+    int get_addr_family() const;
+
+    /**
+     * @brief Add a rule, the wildcard address of the table family stands for any address.
+     * @param if_name input interface of the rule, empty for all interfaces
+     * @return false if the interface does not exist yet, the rule matches as soon as it exists
+     */
+    bool add_rule(const std::string& if_name, const addr_storage& gaddr_from, const addr_storage& gaddr_to, const addr_storage& saddr_from, const addr_storage& saddr_to);
+
+    /**
+     * @brief Build the search structures, has to be called after the last add_rule().
+     */
+    void build();
+
+    /**
+     * @brief Return true if a rule matches, does not allocate any memory unless the interface
+     *        names have changed since the last match.
+     */
+    bool match(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+};
+
+#endif // COMPILED_TABLE_HPP
@@ -60,6 +60,11 @@ public:
     const std::shared_ptr<const interfaces> get_interfaces_for_pinstance(const std::string& instance_name) const;
     group_mem_protocol get_group_mem_protocol() const;
     const inst_def_set& get_inst_def_set() const;
+    const std::shared_ptr<global_table_set>& get_global_table_set() const;
+
+    //use the interfaces (virtual interface indexes) of the running configuration for all proxy instances
+    //and add the interfaces of this configuration to them, false if an instance is not running
+    bool adopt_interfaces(const configuration& running);
 
     std::string to_string() const;
 
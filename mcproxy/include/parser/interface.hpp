@@ -24,20 +24,30 @@
 #define INTERFACE_HPP
 #include <list>
 #include <set>
+#include <vector>
 #include <string>
 #include <memory>
 #include <chrono>
 
 #include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_addr.hpp"
+#include "include/parser/compiled_table.hpp"
+#include "include/proxy/def.hpp"
 
 struct addr_match {
     bool is_wildcard(const addr_storage& addr, int addr_family) const;
     virtual bool match(const addr_storage& addr) const = 0;
+
+    //matched addresses from and to (including), the wildcard address stands for any address
+    virtual void get_interval(addr_storage& from, addr_storage& to) const = 0;
     virtual std::string to_string() const = 0;
 };
 
 struct rule_box {
     virtual bool match(const std::string& if_name, const addr_storage& saddr, const addr_storage& gaddr) const = 0;
+
+    //add the rules to a compiled table, return false if a rule cannot be compiled
+    virtual bool compile(compiled_table& ct, unsigned int depth) const = 0;
     virtual std::string to_string() const = 0;
 };
 
@@ -47,6 +57,7 @@ class single_addr: public addr_match
 public:
     single_addr(const addr_storage& addr);
     bool match(const addr_storage& addr) const override;
+    void get_interval(addr_storage& from, addr_storage& to) const override;
     std::string to_string() const override;
 };
 
@@ -59,6 +70,7 @@ public:
 
     //uncluding from and to
     bool match(const addr_storage& addr) const override;
+    void get_interval(addr_storage& from, addr_storage& to) const override;
     std::string to_string() const override;
 };
 
@@ -70,6 +82,7 @@ class rule_addr : public rule_box
 public:
     rule_addr(const std::string& if_name, std::unique_ptr<addr_match> group, std::unique_ptr<addr_match> source);
     bool match(const std::string& if_name, const addr_storage& gaddr, const addr_storage& saddr) const override;
+    bool compile(compiled_table& ct, unsigned int depth) const override;
     std::string to_string() const override;
 };
 
@@ -82,6 +95,7 @@ public:
     table(const std::string& name, std::list<std::unique_ptr<rule_box>>&& rule_box_list);
     const std::string& get_name() const;
     bool match(const std::string& if_name, const addr_storage& gaddr, const addr_storage& saddr) const override;
+    bool compile(compiled_table& ct, unsigned int depth) const override;
     std::string to_string() const override;
     friend bool operator<(const table& t1, const table& t2);
 };
@@ -98,6 +112,7 @@ class rule_table : public rule_box
 public:
     rule_table(std::unique_ptr<table> t);
     bool match(const std::string& if_name, const addr_storage& gaddr, const addr_storage& saddr) const override;
+    bool compile(compiled_table& ct, unsigned int depth) const override;
     std::string to_string() const override;
 };
 
@@ -118,6 +133,7 @@ class rule_table_ref : public rule_box
 public:
     rule_table_ref(const std::string& table_name, const std::shared_ptr<const global_table_set>& global_table_set);
     bool match(const std::string& if_name, const addr_storage& gaddr, const addr_storage& saddr) const override;
+    bool compile(compiled_table& ct, unsigned int depth) const override;
     std::string to_string() const override;
 };
 
@@ -137,8 +153,9 @@ enum rb_filter_type {
     FT_BLACKLIST, FT_WHITELIST, FT_UNDEFINED
 };
 
+//RMT_HASH spreads the groups (upstream in) or the (S,G) pairs (upstream out) over the upstreams by weighted rendezvous hashing
 enum rb_rule_matching_type {
-    RMT_ALL, RMT_FIRST, RMT_MUTEX, RMT_UNDEFINED
+    RMT_ALL, RMT_FIRST, RMT_MUTEX, RMT_HASH, RMT_UNDEFINED
 };
 
 class rule_binding
@@ -153,6 +170,7 @@ private:
     //RBT_FILTER
     rb_filter_type m_filter_type;
     std::unique_ptr<table> m_table;
+    std::unique_ptr<compiled_table> m_compiled_table;
 
     //RBT_RULE_MATCHING
     rb_rule_matching_type m_rule_matching_type;
@@ -176,6 +194,10 @@ public:
     const table& get_table() const;
     bool match(const std::string& if_name, const addr_storage& saddr, const addr_storage& gaddr) const;
 
+    //compile the table for match() by interface index, has to be called after all tables are parsed
+    void compile(int addr_family);
+    bool match(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+
     //RBT_RULE_MATCHING
     rb_rule_matching_type get_rule_matching_type() const;
     std::chrono::milliseconds get_timeout() const;
@@ -183,11 +205,36 @@ public:
     std::string to_string() const;
 };
 
+#define PREJOIN_MAX_GROUPS 4096 //configured hot groups of an upstream
+
+/**
+ * @brief Hot groups of an upstream. The upstream keeps their memberships and the routes of their sources
+ *        without downstream interest, so a join only adds the downstream to an existing route. Hot groups
+ *        are configured as addresses and ranges or learned as the most often joined groups.
+ */
+struct prejoin_groups {
+    std::vector<std::pair<mc_addr, mc_addr>> ranges; //configured groups, including from and to
+    unsigned int popular = 0; //number of the most often joined groups
+
+    bool is_enabled() const;
+    bool is_configured(const mc_addr& gaddr) const;
+
+    //all configured groups, at most PREJOIN_MAX_GROUPS
+    std::vector<mc_addr> get_configured_groups() const;
+    std::string to_string() const;
+};
+
+#define UPSTREAM_MAX_WEIGHT 1000 //capacity of an upstream relative to the other upstreams (rule matching hash)
+
 class interface
 {
     std::string m_if_name;
     std::unique_ptr<rule_binding> m_output_filter;
     std::unique_ptr<rule_binding> m_input_filter;
+    membership_limits m_limits; //only used for downstreams
+    bool m_fast_leave; //only used for downstreams
+    prejoin_groups m_prejoin; //only used for upstreams
+    unsigned int m_weight; //only used for upstreams, 0 if not configured
     bool match_filter(const std::string& input_if_name, const addr_storage& saddr, const addr_storage& gaddr, const std::unique_ptr<rule_binding>& filter) const;
 
 public:
@@ -196,6 +243,24 @@ public:
     bool match_output_filter(const std::string& input_if_name, const addr_storage& saddr, const addr_storage& gaddr) const;
     bool match_input_filter(const std::string& input_if_name, const addr_storage& saddr, const addr_storage& gaddr) const;
 
+    //compile the filters, the filters are matched without comparing interface names
+    void compile_filters(int addr_family);
+    bool match_output_filter(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+    bool match_input_filter(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+
+    //true if an input or output filter is defined, the filters can depend on the source address
+    bool has_filter() const;
+
+    const membership_limits& get_limits() const;
+
+    //the downstream has a single listener, leaves are processed without last listener queries
+    bool is_fast_leave() const;
+
+    const prejoin_groups& get_prejoin() const;
+
+    //share of the groups of the upstream with the rule matching hash, 1 by default
+    unsigned int get_weight() const;
+
     std::string to_string_rule_binding() const;
     std::string to_string_interface() const;
     friend class parser;
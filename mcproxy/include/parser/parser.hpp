@@ -56,6 +56,11 @@ private:
 
     void parse_interface_rule_match_binding(std::string&& instance_name, rb_interface_type interface_type, std::string&& if_name, rb_interface_direction filter_direction, const inst_def_set& ids);
 
+    void parse_interface_limit(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids);
+    void parse_interface_fast_leave(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids);
+    void parse_interface_prejoin(std::string&& instance_name, std::string&& if_name, group_mem_protocol gmp, const inst_def_set& ids);
+    void parse_interface_weight(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids);
+
 public:
     parser(unsigned int current_line, const std::string& cmd);
     parser_type get_parser_type();
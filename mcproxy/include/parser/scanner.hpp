@@ -24,10 +24,14 @@
 #define SCANNER_HPP
 
 #include <string>
-#include <vector>
+#include <deque>
 
-class token;
+#include "include/parser/token.hpp"
 
+/**
+ * @brief Split a command into tokens. The tokens are scanned on demand, only the peeked
+ *        tokens are buffered.
+ */
 class scanner
 {
 private:
@@ -36,14 +40,18 @@ private:
     unsigned int m_current_cmd_pos; 
     char m_current_cmd_char;
          
-    std::vector<token> m_token_vec;
-    unsigned int m_token_pos;
+    //scanned but not yet consumed tokens
+    std::deque<token> m_lookahead;
 
     void read_next_char();
     void skip_spaces();
+
+    //consume "-" and word if they follow the current keyword (e.g. fast-leave)
+    bool is_keyword_continued(const std::string& word);
     token read_next_token();    
 
-    void fill_token_vec();
+    //scan until the lookahead holds count tokens or the command ends
+    void fill_lookahead(unsigned int count);
 
 public:
     scanner(unsigned int current_line, const std::string& cmd);
@@ -48,7 +48,12 @@ enum token_type {
     TT_ALL,
     TT_FIRST,
     TT_MUTEX,
+    TT_HASH,
     TT_DISABLE,
+    TT_LIMIT,
+    TT_FAST_LEAVE, //"fast-leave"
+    TT_PREJOIN,
+    TT_WEIGHT,
     //TT_PATH, //@path@
     TT_LEFT_BRACE, //"{"
     TT_RIGHT_BRACE, //"}"
@@ -71,7 +76,7 @@ private:
     std::string m_string;
 
 public:
-    token(token_type type= TT_NIL, const std::string str= "");
+    token(token_type type= TT_NIL, std::string str= std::string());
 
     token_type get_type() const; 
     const std::string& get_string() const;
@@ -0,0 +1,72 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+/**
+ * @addtogroup mod_proxy_instance Proxy Instance
+ * @{
+ */
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include "include/proxy/proxy_snapshot.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+
+#define CHECKPOINT_INTERVAL 10 //time in seconds between two checkpoints
+#define CHECKPOINT_FORMAT_VERSION 1
+
+/**
+ * @brief Persists the snapshots of the proxy instances (memberships of the downstreams and known
+ *        multicast sources) in a compact binary file to restore them after a restart. The interfaces
+ *        are stored by name, their indexes may change with a restart.
+ */
+class checkpoint
+{
+private:
+    //bounds checked access to the memory-mapped file
+    class writer;
+    class reader;
+
+    static void write_snapshot(writer& w, const proxy_snapshot& s);
+    static std::shared_ptr<proxy_snapshot> read_snapshot(reader& r);
+
+public:
+    /**
+     * @brief Write the snapshots and the current wall-clock time to a memory-mapped temporary file
+     *        and replace path with it, so an interrupted write never destroys the last checkpoint.
+     */
+    static bool write(const std::string& path, const std::vector<std::shared_ptr<const proxy_snapshot>>& snapshots);
+
+    /**
+     * @brief Read the snapshots of the checkpoint path, unknown interfaces are skipped.
+     * @param elapsed returns the wall-clock time since the checkpoint was written
+     */
+    static bool read(const std::string& path, std::vector<std::shared_ptr<const proxy_snapshot>>& snapshots, std::chrono::milliseconds& elapsed);
+};
+
+#endif // CHECKPOINT_HPP
+/** @} */
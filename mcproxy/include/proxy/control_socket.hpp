@@ -0,0 +1,82 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_proxy Proxy
+ * @{
+ */
+
+#ifndef CONTROL_SOCKET_HPP
+#define CONTROL_SOCKET_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#define CONTROL_SOCKET_MAX_COMMAND 1024 //byte, longer commands are truncated
+#define CONTROL_SOCKET_TIMEOUT 1 //sec, a client has to send its command and read the answer within this time
+
+/**
+ * @brief Answer a command, the first argument is the command name.
+ */
+using control_handler = std::function<std::string(const std::vector<std::string>& args)>;
+
+/**
+ * @brief Unix stream socket of the proxy control. A client sends one command line per connection,
+ *        the answer is written by the handler and the connection is closed.
+ */
+class control_socket
+{
+private:
+    std::string m_path;
+    int m_fd;
+    control_handler m_handler;
+
+    void handle_connection(int fd) const;
+
+    control_socket(const control_socket&) = delete;
+    control_socket& operator=(const control_socket&) = delete;
+
+public:
+    /**
+     * @brief Create the socket at @p path, an existing file is replaced. Only root can connect.
+     */
+    control_socket(const std::string& path, const control_handler& handler);
+
+    /**
+     * @brief Close and remove the socket.
+     */
+    virtual ~control_socket();
+
+    /**
+     * @brief File descriptor to wait for new connections.
+     */
+    int get_fd() const;
+
+    /**
+     * @brief Accept all pending connections and answer their commands.
+     */
+    void handle_requests() const;
+};
+
+#endif // CONTROL_SOCKET_HPP
+/** @} */
@@ -23,6 +23,8 @@
 #ifndef DEF_HPP
 #define DEF_HPP
 
+#include "include/utils/flat_set.hpp"
+
 #include <netinet/in.h>
 
 #include <map>
@@ -47,6 +49,26 @@ std::string get_group_mem_protocol_name(group_mem_protocol gmp);
 enum mcast_addr_record_type {MODE_IS_INCLUDE = 1, MODE_IS_EXCLUDE = 2, CHANGE_TO_INCLUDE_MODE = 3, CHANGE_TO_EXCLUDE_MODE = 4, ALLOW_NEW_SOURCES = 5, BLOCK_OLD_SOURCES = 6};
 std::string get_mcast_addr_record_type_name(mcast_addr_record_type art);
 
+//------------------------------------------------------------------------
+//what happens to a group record that would exceed a membership limit
+enum limit_policy {LP_TRUNCATE, LP_REJECT};
+std::string get_limit_policy_name(limit_policy lp);
+
+/**
+ * @brief Limits of the membership state of one downstream, zero means unlimited.
+ * With LP_TRUNCATE a record creates the new groups and sources that fit into the limits and the
+ * rest is ignored, with LP_REJECT a record that would exceed a limit is ignored completely.
+ */
+struct membership_limits {
+    unsigned int max_groups = 0;
+    unsigned int max_sources = 0; //per group, requested and blocked sources
+    unsigned int max_total_sources = 0; //sources of all groups
+    limit_policy policy = LP_TRUNCATE;
+
+    bool is_limited() const;
+    std::string to_string() const;
+};
+
 //------------------------------------------------------------------------
 std::string time_to_string(const std::chrono::seconds& sec);
 std::string time_to_string(const std::chrono::milliseconds& msec);
@@ -54,14 +76,13 @@ std::string time_to_string(const std::chrono::milliseconds& msec);
 //------------------------------------------------------------------------
 std::string indention(std::string str);
 //------------------------------------------------------------------------
-template<typename T> using source_list = std::set<T>;
+template<typename T> using source_list = flat_set<T>;
 
 //A+B means the union of set A and B
 template<typename T>
 inline source_list<T>& operator+=(source_list<T>& l, const source_list<T>& r)
 {
-    l.insert(r.cbegin(), r.cend());
-    return l;
+    return l.unite(r);
 }
 
 template<typename T>
@@ -72,29 +93,18 @@ inline source_list<T> operator+(const source_list<T>& l, const source_list<T>& r
     return new_sl;
 }
 
+template<typename T>
+inline source_list<T> operator+(source_list<T>&& l, const source_list<T>& r)
+{
+    l += r;
+    return std::move(l);
+}
+
 //A*B means the intersection of set A and B
 template<typename T>
 inline source_list<T>& operator*=(source_list<T>& l, const source_list<T>& r)
 {
-    auto cur_l = std::begin(l);
-    auto cur_r = std::begin(r);
-
-    while (cur_l != std::end(l) && cur_r != std::end(r)) {
-        if (*cur_l == *cur_r) {
-            cur_l++;
-            cur_r++;
-        } else if (*cur_l < *cur_r) {
-            cur_l = l.erase(cur_l);
-        } else { //cur_l > cur_r
-            cur_r++;
-        }
-    }
-
-    if (cur_l != std::end(l)) {
-        l.erase(cur_l, std::end(l));
-    }
-
-    return l;
+    return l.intersect(r);
 }
 
 template<typename T>
@@ -105,15 +115,18 @@ inline source_list<T> operator*(const source_list<T>& l, const source_list<T>& r
     return new_sl;
 }
 
+template<typename T>
+inline source_list<T> operator*(source_list<T>&& l, const source_list<T>& r)
+{
+    l *= r;
+    return std::move(l);
+}
+
 //A-B means the removal of all elements of set B from set A
 template<typename T>
 inline source_list<T>& operator-=(source_list<T>& l, const source_list<T>& r)
 {
-    for (auto e : r) {
-        l.erase(e);
-    }
-
-    return l;
+    return l.subtract(r);
 }
 
 template<typename T>
@@ -124,6 +137,13 @@ inline source_list<T> operator-(const source_list<T>& l, const source_list<T>& r
     return new_sl;
 }
 
+template<typename T>
+inline source_list<T> operator-(source_list<T>&& l, const source_list<T>& r)
+{
+    l -= r;
+    return std::move(l);
+}
+
 template<typename T>
 inline std::ostream& operator<<(std::ostream& stream, const source_list<T> sl)
 {
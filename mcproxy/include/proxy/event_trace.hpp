@@ -0,0 +1,101 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+/**
+ * @addtogroup mod_proxy_instance Proxy Instance
+ * @{
+ */
+
+#ifndef EVENT_TRACE_HPP
+#define EVENT_TRACE_HPP
+
+#include "include/proxy/def.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+
+#define EVENT_TRACE_FORMAT_VERSION 1
+#define EVENT_TRACE_BUFFER_SIZE 65536 //byte, the trace is written in blocks of this size
+
+struct proxy_msg;
+
+/**
+ * @brief Records the input events of the proxy instances (group records, kernel upcalls of new sources,
+ *        timer expiries, configuration, upstream queries and queries of other queriers) with their time in a compact binary trace
+ *        of length-prefixed records. The trace can be replayed to reproduce a load.
+ */
+class event_trace
+{
+public:
+    enum event_type {
+        ET_GROUP_RECORD = 1,
+        ET_NEW_SOURCE = 2,
+        ET_TIMER = 3,
+        ET_CONFIG = 4,
+        ET_UPSTREAM_QUERY = 5,
+        ET_QUERIER_QUERY = 6
+    };
+
+private:
+    //the proxy instance and its querier shards record concurrently
+    std::mutex m_lock;
+    int m_fd;
+    std::vector<char> m_buf;
+    std::chrono::steady_clock::time_point m_start;
+
+    void record_timer(const std::shared_ptr<proxy_msg>& msg);
+
+    //write m_buf to the file, m_lock has to be locked
+    void flush();
+
+    event_trace(const event_trace&) = delete;
+    event_trace& operator=(const event_trace&) = delete;
+
+public:
+    /**
+     * @brief Create the trace file path, an existing file is replaced.
+     */
+    event_trace(const std::string& path, group_mem_protocol gmp);
+
+    /**
+     * @brief Write the remaining events and close the trace file.
+     */
+    virtual ~event_trace();
+
+    /**
+     * @brief Append an input event, other messages are ignored.
+     */
+    void record(const std::shared_ptr<proxy_msg>& msg);
+
+    /**
+     * @brief Feed the events of a trace as fast as possible into a proxy instance in debug testing mode
+     *        and print the throughput. The interfaces are mapped by name and forward without rule bindings,
+     *        timer expiries are only counted since the queriers accept only the timers they started.
+     * @return Return true on success.
+     */
+    static bool replay(const std::string& path);
+};
+
+#endif // EVENT_TRACE_HPP
+/** @} */
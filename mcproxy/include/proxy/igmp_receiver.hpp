@@ -50,12 +50,21 @@ private:
     int get_ctrl_min_size() override;
     int get_iov_min_size() override;
     void analyse_packet(struct msghdr* msg, int info_size) override;
+    void get_socket_filter(std::vector<struct sock_filter>& filter) override;
+
+    //interface of a packet, from an IP_PKTINFO control message if present (injected packets) or by the subnet of the source address
+    unsigned int get_if_index(struct msghdr* msg, const addr_storage& saddr) const;
 
 public:
     /**
      * @brief Create an igmp_receiver.
      */
     igmp_receiver(proxy_instance* pr_i, const std::shared_ptr<const mroute_socket> mrt_sock,const std::shared_ptr<const interfaces> interfaces, bool in_debug_testing_mode);
+
+    /**
+     * @brief Stop receiving before the packet analysis is destroyed.
+     */
+    virtual ~igmp_receiver();
 };
 
 #endif // IGMP_RECEIVER_HPP
@@ -36,10 +36,31 @@
 class igmp_sender : public sender
 {
 private:
+    //ip header, router alert option and query header of the queries of an interface, only the
+    //variable fields are filled per query, the ip header checksum is updated incrementally (RFC 1624)
+    struct query_template {
+        unsigned int m_generation; //of m_interfaces when the source address was taken
+        std::vector<unsigned char> m_header;
+        uint64_t m_ip_sum; //unfolded sum of the ip header without total length and destination address
+    };
+
+    mutable std::map<unsigned int, query_template> m_query_templates;
+    mutable std::mutex m_query_templates_lock;
+
+    //copy the query template of if_index to packet, build it if it is missing or outdated
+    uint64_t fill_query_template(unsigned int if_index, unsigned char* packet) const;
+
+    //complete the ip header of a template with the total length and the destination address
+    void complete_ip_header(unsigned char* packet, unsigned int size, const addr_storage& dst_addr, uint64_t ip_sum) const;
+
     bool send_igmpv3_query(unsigned int if_index, const timers_values& tv, const addr_storage& gaddr, bool s_flag, const source_list<source>& slist) const;
 
+    void get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const override;
+
+    void queue_report(unsigned int if_index, std::vector<report_record>::const_iterator begin, std::vector<report_record>::const_iterator end) const override;
+
 public:
-    igmp_sender(const std::shared_ptr<const interfaces>& interfaces);
+    igmp_sender(const std::shared_ptr<const interfaces>& interfaces, bool native_reports = false);
 
     bool send_record(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const override;
 
@@ -0,0 +1,107 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_proxy Proxy
+ * @{
+ */
+
+#ifndef INTERFACE_MONITOR_HPP
+#define INTERFACE_MONITOR_HPP
+
+#include <thread>
+#include <memory>
+#include <map>
+#include <set>
+#include <functional>
+#include <chrono>
+
+#define INTERFACE_MONITOR_SETTLE_TIME 100 //msec, the events of a burst are reported together
+#define INTERFACE_MONITOR_BUFFER_SIZE 16384 //byte
+
+struct nlmsghdr;
+
+/**
+ * @brief Listen to the link and address events of the kernel (rtnetlink) and report
+ *        the changes of a burst of events at once instead of polling the interfaces.
+ */
+class interface_monitor
+{
+public:
+    //if indexes whose link is running again, if indexes whose link is not running anymore, addresses may have changed,
+    //the sets are empty if only interfaces were created or deleted
+    typedef std::function<void(const std::set<unsigned int>&, const std::set<unsigned int>&, bool)> change_callback;
+
+private:
+    bool m_running;
+    std::unique_ptr<std::thread> m_thread;
+    void worker_thread();
+
+    change_callback m_cb;
+
+    int m_event_fd;
+    int m_netlink_fd;
+    unsigned int m_seq;
+
+    //if_index, link is running
+    std::map<unsigned int, bool> m_links;
+
+    //changes of the current burst, reported when the deadline is reached
+    std::set<unsigned int> m_up;
+    std::set<unsigned int> m_down;
+    bool m_addresses_changed;
+    bool m_pending;
+    std::chrono::steady_clock::time_point m_deadline;
+
+    void init_fds();
+    void close_fds();
+
+    //request the state of all links, the answers are handled like link events
+    bool request_links();
+
+    //read all pending netlink messages
+    void receive();
+    void handle_msg(const struct nlmsghdr* nh);
+    void set_link(unsigned int if_index, bool running);
+    void set_pending();
+
+    void start();
+    void stop();
+    void join() const;
+
+    interface_monitor(const interface_monitor&) = delete;
+    interface_monitor& operator=(const interface_monitor&) = delete;
+
+public:
+    /**
+     * @brief Start the monitor thread, cb is called in this thread.
+     */
+    interface_monitor(const change_callback& cb);
+
+    /**
+     * @brief Stop the monitor thread and release all resources.
+     */
+    virtual ~interface_monitor();
+};
+
+#endif // INTERFACE_MONITOR_HPP
+/** @} */
@@ -30,6 +30,10 @@
 #include <map>
 #include <vector>
 #include <sstream>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+#include <atomic>
 
 class addr_storage;
 
@@ -46,12 +50,39 @@ private:
 
     //ipv4 only
     bool m_reset_reverse_path_filter;
-    if_prop m_if_prop;
     reverse_path_filter m_reverse_path_filter;
 
+    //a configuration reload adds interfaces while the proxy instance threads map them
+    mutable std::mutex m_vif_lock;
     std::map<int, unsigned int> m_vif_if;
     std::map<unsigned int, int> m_if_vif;
 
+    //ipv4 only, subnets of all interfaces grouped by netmask (longest netmask first), each group sorted by subnet
+    struct ipv4_subnet {
+        uint32_t m_subnet; //host byte order
+        unsigned int m_if_index;
+    };
+    struct ipv4_subnet_group {
+        uint32_t m_netmask; //host byte order
+        std::vector<ipv4_subnet> m_subnets;
+    };
+
+    //properties of the network interfaces shared by all instances, replaced as a whole by
+    //refresh_network_interfaces() and accessed only with std::atomic_load/std::atomic_store
+    struct if_state {
+        if_prop m_if_prop;
+        std::vector<ipv4_subnet_group> m_ipv4_subnets;
+    };
+    static std::shared_ptr<const if_state> m_state;
+
+    //incremented whenever the addresses of the interfaces have changed
+    static std::atomic<unsigned int> m_generation;
+
+    static std::shared_ptr<const if_state> get_state();
+
+    //fill m_ipv4_subnets from m_if_prop
+    static void build_ipv4_subnets(if_state& state);
+
     int get_free_vif_number() const;
 
     //flags example: IFF_UP IFF_LOOPBACK IFF_POINTOPOINT IFF_RUNNING IFF_ALLMULTI
@@ -61,7 +92,11 @@ public:
     interfaces(int addr_family, bool reset_reverse_path_filter);
     ~interfaces();
 
-    bool refresh_network_interfaces();
+    //read the properties of all network interfaces again, the readers of the last properties are not blocked
+    static bool refresh_network_interfaces();
+
+    //changes whenever the addresses of the interfaces have changed
+    unsigned int get_generation() const;
 
     bool add_interface(const std::string& if_name);
     bool add_interface(unsigned int if_index);
@@ -71,9 +106,24 @@ public:
 
 
     int get_virtual_if_index(unsigned int if_index) const;
+
+    //copy the properties of the last scan of an interface, false if the interface is unknown
+    bool get_if_prop(unsigned int if_index, if_index_prop& prop) const;
+
+    //maximum number of virtual interfaces of one multicast routing table (MAXVIFS or MAXMIFS)
+    int get_max_vifs() const;
     addr_storage get_saddr(const std::string& if_name) const;
+    addr_storage get_saddr(unsigned int if_index) const;
 
+    //address of the interface for the querier election, for IPv6 the link-local one (RFC 3810 7.6.2)
+    addr_storage get_link_local_saddr(unsigned int if_index) const;
+
+    //the names and indexes of the interfaces are cached, refresh_if_names() reloads them after interface changes
     static std::string get_if_name(unsigned int if_index);
+    static void refresh_if_names();
+
+    //changes whenever the cached names or indexes of the interfaces have changed
+    static unsigned int get_if_names_generation();
 
     static unsigned int get_if_index(const std::string& if_name);
     static unsigned int get_if_index(const char* if_name);
@@ -24,15 +24,75 @@
 #define MEMBERSHIP_DB_HPP
 
 #include "include/utils/addr_storage.hpp"
+#include "include/utils/addr_hash_map.hpp"
 #include "include/proxy/def.hpp"
 #include "include/proxy/membership_db.hpp"
 #include "include/proxy/message_format.hpp"
 
+#include <atomic>
 #include <iostream>
 #include <set>
 #include <map>
 #include <chrono>
 #include <memory>
+#include <vector>
+
+/**
+ * @brief Explicit tracking (draft-ietf-pim-explicit-tracking) of the hosts reporting one group address.
+ * The reference counters answer in constant time whether a tracked host still wants the group or a source.
+ */
+struct host_tracking {
+    struct host_state {
+        mc_filter filter_mode;
+        source_list<mc_addr> slist; //requested sources in INCLUDE_MODE, blocked sources in EXCLUDE_MODE
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    host_tracking();
+
+    addr_hash_map<host_state> hosts; //reporter address, last reported state
+    unsigned int exclude_hosts; //number of hosts in EXCLUDE_MODE
+    addr_hash_map<unsigned int> include_refs; //source address, number of hosts in INCLUDE_MODE requesting it
+    addr_hash_map<unsigned int> exclude_refs; //source address, number of hosts in EXCLUDE_MODE blocking it
+
+    //apply a record of host to its state, the host is tracked until expiry or it leaves the group
+    void update(const mc_addr& host, mcast_addr_record_type record_type, const source_list<source>& slist, std::chrono::steady_clock::time_point expiry);
+
+    //stop tracking the hosts which have not reported until now
+    void purge(std::chrono::steady_clock::time_point now);
+
+    //true if a tracked host is in EXCLUDE_MODE
+    bool is_group_wanted() const;
+
+    //true if a tracked host wants to receive traffic from saddr
+    bool is_source_wanted(const mc_addr& saddr) const;
+
+private:
+    void add_refs(const host_state& hs);
+    void del_refs(const host_state& hs);
+};
+
+/**
+ * @brief Size of membership state, the memory is estimated from the capacity of the containers without the timers.
+ */
+struct membership_size {
+    long groups = 0;
+    long sources = 0; //requested and blocked sources
+    long bytes = 0;
+
+    membership_size& operator+=(const membership_size& r);
+    membership_size& operator-=(const membership_size& r);
+};
+
+/**
+ * @brief Groups and sources of one downstream, shared by the queriers of its group slices to enforce the limits of the downstream.
+ */
+struct downstream_usage {
+    downstream_usage();
+
+    std::atomic<long> groups;
+    std::atomic<long> sources;
+};
 
 struct gaddr_info {
     gaddr_info(group_mem_protocol compatibility_mode_variable);
@@ -56,17 +116,52 @@ struct gaddr_info {
 
     std::shared_ptr<retransmit_source_timer_msg> source_retransmission_timer; //runs as long as a source in include_requested_list has an retransmission timer greater than zero
 
+    std::weak_ptr<source_timer_msg> source_timer_bucket; //newest source timer with the Multicast Address Listening Interval, does not count as a reference of the timer
+
     source_list<source> include_requested_list;
     source_list<source> exclude_list;
 
+    unsigned long long version; //changes with every state change notification of this group, 0 is never used
+
+    host_tracking tracking; //used only if the explicit tracking of the membership database is enabled
+
+    //return to the state of a new group, the memory of the source lists and the tracking is kept
+    void reset(group_mem_protocol compatibility_mode_variable);
+
+    membership_size get_size() const;
+
     bool is_in_backward_compatibility_mode() const;
     bool is_under_bakcward_compatibility_effects() const; 
     std::string to_string() const;
     friend std::ostream& operator<<(std::ostream& stream, const gaddr_info& g);
 };
 
-using gaddr_map = std::map<addr_storage, gaddr_info>;
-using gaddr_pair = std::pair<addr_storage, gaddr_info>;
+using gaddr_map = addr_hash_map<gaddr_info>;
+using gaddr_pair = gaddr_map::value_type;
+
+#define GADDR_INFO_POOL_MAX_SPARE 256 //spare groups per membership database
+#define GADDR_INFO_POOL_MAX_CAPACITY 64 //larger source lists are freed when their group is released
+
+/**
+ * @brief Keeps the state of deleted groups for the next new group, so a group that comes and goes
+ * does not allocate its source lists and tracking tables again. The timers are released together
+ * with the group. The spare groups are freed with the membership database, e.g. if the interface
+ * is removed.
+ */
+class gaddr_info_pool
+{
+private:
+    std::vector<gaddr_info> m_spare;
+
+public:
+    gaddr_info acquire(group_mem_protocol compatibility_mode_variable);
+    void release(gaddr_info&& ginfo);
+
+    //free all spare groups
+    void clear();
+
+    std::size_t size() const;
+};
 
 /**
  * @brief The Membership Database maintaines the membership records for one specific interface (RFC 4605)
@@ -83,7 +178,15 @@ struct membership_db {
 
     group_mem_protocol querier_version_mode; 
     bool is_querier;
+    bool explicit_tracking; //track the state of each reporting host, the last leaving host prunes without a query round
     gaddr_map group_info; //subscribed multicast group with their source lists
+    gaddr_info_pool group_pool; //state of deleted groups, reused by add_group
+
+    //add an empty group in INCLUDE_MODE, the group must not exist
+    gaddr_map::iterator add_group(const mc_addr& gaddr);
+
+    //delete a group and keep its memory for the next one, invalidates all iterators of group_info
+    void erase_group(gaddr_map::iterator it);
 
     static void test_arithmetic();
 
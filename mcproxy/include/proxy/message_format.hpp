@@ -29,16 +29,23 @@
 
 #include "include/hamcast_logging.h"
 #include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_addr.hpp"
+#include "include/utils/source_table.hpp"
 #include "include/proxy/def.hpp"
 #include "include/proxy/interfaces.hpp"
 #include "include/proxy/timers_values.hpp"
+#include "include/proxy/timing_wheel.hpp"
+#include "include/proxy/message_pool.hpp"
 #include "include/parser/interface.hpp"
+#include "include/proxy/proxy_snapshot.hpp"
 
 #include <iostream>
 #include <string>
 #include <map>
 #include <memory>
 #include <chrono>
+#include <vector>
+#include <algorithm>
 
 struct proxy_msg {
     enum message_type {
@@ -55,7 +62,13 @@ struct proxy_msg {
         GENERAL_QUERY_TIMER_MSG,
         CONFIG_MSG,
         GROUP_RECORD_MSG,
-        DEBUG_MSG
+        DEBUG_MSG,
+        TIMER_BATCH_MSG,
+        STATE_CHANGE_MSG,
+        UPSTREAM_QUERY_MSG,
+        UPSTREAM_REPORT_TIMER_MSG,
+        RESTORE_MSG,
+        QUERIER_QUERY_MSG
     };
 
     enum message_priority {
@@ -79,7 +92,13 @@ struct proxy_msg {
             {GENERAL_QUERY_TIMER_MSG,      "GENERAL_QUERY_TIMER_MSG"     },
             {CONFIG_MSG,           "CONFIG_MSG"          },
             {GROUP_RECORD_MSG,     "GROUP_RECORD_MSG"    },
-            {DEBUG_MSG,            "DEBUG_MSG"           }
+            {DEBUG_MSG,            "DEBUG_MSG"           },
+            {TIMER_BATCH_MSG,      "TIMER_BATCH_MSG"     },
+            {STATE_CHANGE_MSG,     "STATE_CHANGE_MSG"    },
+            {UPSTREAM_QUERY_MSG,   "UPSTREAM_QUERY_MSG"  },
+            {UPSTREAM_REPORT_TIMER_MSG, "UPSTREAM_REPORT_TIMER_MSG"},
+            {RESTORE_MSG,          "RESTORE_MSG"         },
+            {QUERIER_QUERY_MSG,    "QUERIER_QUERY_MSG"   }
         };
         return name_map[mt];
     }
@@ -124,6 +143,18 @@ struct proxy_msg {
         HC_LOG_TRACE("Empty operator");
     }
 
+    /**
+     * @brief Receive time of the group record that caused this message, the default
+     *        time point if the message is not traced (see metrics::set_origin()).
+     */
+    const std::chrono::steady_clock::time_point& get_origin() const {
+        return m_origin;
+    }
+
+    void set_origin(const std::chrono::steady_clock::time_point& origin) {
+        m_origin = origin;
+    }
+
 protected:
     proxy_msg(message_type type, message_priority prio): m_type(type), m_prio(prio) {
         HC_LOG_TRACE("");
@@ -131,11 +162,28 @@ protected:
 
     message_type m_type;
     message_priority m_prio;
+    std::chrono::steady_clock::time_point m_origin;
 };
 
-struct comp_proxy_msg {
-    bool operator()(const std::shared_ptr<proxy_msg>& l, const std::shared_ptr<proxy_msg>& r) const {
-        return *l > *r;
+/**
+ * @brief Maps a message to the job queue lane of its priority, lane 0 is served first.
+ */
+struct lane_proxy_msg {
+    static const unsigned int lane_count = 3;
+
+    static unsigned int get_lane(proxy_msg::message_priority prio) {
+        switch (prio) {
+        case proxy_msg::USER_INPUT:
+            return 0;
+        case proxy_msg::SYSTEMIC:
+            return 1;
+        default:
+            return 2;
+        }
+    }
+
+    unsigned int operator()(const std::shared_ptr<proxy_msg>& msg) const {
+        return get_lane(msg->get_priority());
     }
 };
 
@@ -162,11 +210,11 @@ private:
 
 //------------------------------------------------------------------------
 struct timer_msg : public proxy_msg {
-    timer_msg(message_type type, unsigned int if_index, const addr_storage& gaddr, const std::chrono::milliseconds& duration)
+    timer_msg(message_type type, unsigned int if_index, const mc_addr& gaddr, const std::chrono::milliseconds& duration)
         : proxy_msg(type, SYSTEMIC)
         , m_if_index(if_index)
         , m_gaddr(gaddr)
-        , m_end_time(std::chrono::steady_clock::now() + duration) {
+        , m_end_time(timer_clock::now() + duration) {
         HC_LOG_TRACE("");
     }
 
@@ -174,18 +222,36 @@ struct timer_msg : public proxy_msg {
         return m_if_index;
     }
 
-    const addr_storage& get_gaddr() {
+    const mc_addr& get_gaddr() {
         return m_gaddr;
     }
 
+    /**
+     * @brief Reminder of this timer, set by the owner after adding it to the timing.
+     */
+    const timer_handle& get_handle() {
+        return m_handle;
+    }
+
+    void set_handle(const timer_handle& handle) {
+        m_handle = handle;
+    }
+
+    /**
+     * @brief Set a new duration after the reminder is rescheduled.
+     */
+    void restart(const std::chrono::milliseconds& duration) {
+        m_end_time = timer_clock::now() + duration;
+    }
+
     bool is_remaining_time_greater_than(std::chrono::milliseconds comp_time) {
-        return (std::chrono::steady_clock::now() + comp_time) <= m_end_time;
+        return (timer_clock::now() + comp_time) <= m_end_time;
     }
 
     std::string get_remaining_time() {
         using namespace std::chrono;
         std::ostringstream s;
-        auto current_time = steady_clock::now();
+        auto current_time = timer_clock::now();
         auto time_span = m_end_time - current_time;
         double seconds = time_span.count()  * steady_clock::period::num / steady_clock::period::den;
         if (seconds >= 0) {
@@ -198,12 +264,13 @@ struct timer_msg : public proxy_msg {
 
 private:
     unsigned int m_if_index;
-    addr_storage m_gaddr;
+    mc_addr m_gaddr;
     std::chrono::time_point<std::chrono::steady_clock> m_end_time;
+    timer_handle m_handle;
 };
 
 struct filter_timer_msg : public timer_msg {
-    filter_timer_msg(unsigned int if_index, const addr_storage& gaddr, std::chrono::milliseconds duration): timer_msg(FILTER_TIMER_MSG, if_index, gaddr, duration), m_is_used_as_source_timer(false) {
+    filter_timer_msg(unsigned int if_index, const mc_addr& gaddr, std::chrono::milliseconds duration): timer_msg(FILTER_TIMER_MSG, if_index, gaddr, duration), m_is_used_as_source_timer(false) {
         HC_LOG_TRACE("");
     }
 
@@ -220,49 +287,68 @@ private:
 };
 
 struct source_timer_msg : public timer_msg {
-    source_timer_msg(unsigned int if_index, const addr_storage& gaddr, std::chrono::milliseconds duration): timer_msg(SOURCE_TIMER_MSG, if_index, gaddr, duration) {
+    source_timer_msg(unsigned int if_index, const mc_addr& gaddr, std::chrono::milliseconds duration): timer_msg(SOURCE_TIMER_MSG, if_index, gaddr, duration) {
         HC_LOG_TRACE("");
     }
 };
 
 struct retransmit_group_timer_msg : public timer_msg {
-    retransmit_group_timer_msg(unsigned int if_index, const addr_storage& gaddr, std::chrono::milliseconds duration): timer_msg(RET_GROUP_TIMER_MSG, if_index, gaddr, duration) {
+    retransmit_group_timer_msg(unsigned int if_index, const mc_addr& gaddr, std::chrono::milliseconds duration): timer_msg(RET_GROUP_TIMER_MSG, if_index, gaddr, duration) {
         HC_LOG_TRACE("");
     }
 };
 
 struct retransmit_source_timer_msg : public timer_msg {
-    retransmit_source_timer_msg(unsigned int if_index, const addr_storage& gaddr, std::chrono::milliseconds duration): timer_msg(RET_SOURCE_TIMER_MSG, if_index, gaddr, duration) {
+    retransmit_source_timer_msg(unsigned int if_index, const mc_addr& gaddr, std::chrono::milliseconds duration): timer_msg(RET_SOURCE_TIMER_MSG, if_index, gaddr, duration) {
         HC_LOG_TRACE("");
     }
 };
 
 struct older_host_present_timer_msg : public timer_msg {
-    older_host_present_timer_msg(unsigned int if_index, const addr_storage& gaddr, std::chrono::milliseconds duration): timer_msg(OLDER_HOST_PRESENT_TIMER_MSG, if_index, gaddr, duration) {
+    older_host_present_timer_msg(unsigned int if_index, const mc_addr& gaddr, std::chrono::milliseconds duration): timer_msg(OLDER_HOST_PRESENT_TIMER_MSG, if_index, gaddr, duration) {
         HC_LOG_TRACE("");
     }
 };
 
 struct general_query_timer_msg : public timer_msg {
-    general_query_timer_msg(unsigned int if_index, std::chrono::milliseconds duration): timer_msg(GENERAL_QUERY_TIMER_MSG, if_index, addr_storage(), duration) {
+    general_query_timer_msg(unsigned int if_index, std::chrono::milliseconds duration): timer_msg(GENERAL_QUERY_TIMER_MSG, if_index, mc_addr(), duration) {
         HC_LOG_TRACE("");
     }
 };
 
 struct new_source_timer_msg : public timer_msg {
-    new_source_timer_msg(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr, std::chrono::milliseconds duration)
+    new_source_timer_msg(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr, std::chrono::milliseconds duration)
         : timer_msg(NEW_SOURCE_TIMER_MSG, if_index, gaddr, duration)
         , m_saddr(saddr)  {
         HC_LOG_TRACE("");
     }
 
-    const addr_storage& get_saddr() {
+    const mc_addr& get_saddr() {
         HC_LOG_TRACE("");
         return m_saddr;
     }
 
 private:
-    addr_storage m_saddr;
+    mc_addr m_saddr;
+};
+
+/**
+ * @brief Pending answer to a query of an upstream router (native upstream reports). A general
+ *        answer continues after the group address gaddr, otherwise only gaddr is reported.
+ */
+struct upstream_report_timer_msg : public timer_msg {
+    upstream_report_timer_msg(unsigned int if_index, const mc_addr& gaddr, bool general, std::chrono::milliseconds duration)
+        : timer_msg(UPSTREAM_REPORT_TIMER_MSG, if_index, gaddr, duration)
+        , m_general(general) {
+        HC_LOG_TRACE("");
+    }
+
+    bool is_general() {
+        return m_general;
+    }
+
+private:
+    bool m_general;
 };
 
 //------------------------------------------------------------------------
@@ -273,6 +359,23 @@ struct debug_msg : public proxy_msg {
     }
 };
 
+//------------------------------------------------------------------------
+/**
+ * @brief Timer events of a worker that expired within the same timer slack.
+ */
+struct timer_batch_msg : public proxy_msg {
+    timer_batch_msg(): proxy_msg(TIMER_BATCH_MSG, SYSTEMIC) {
+        HC_LOG_TRACE("");
+    }
+
+    std::vector<std::shared_ptr<proxy_msg>>& get_timers() {
+        return m_timers;
+    }
+
+private:
+    std::vector<std::shared_ptr<proxy_msg>> m_timers;
+};
+
 //------------------------------------------------------------------------
 
 struct source {
@@ -283,12 +386,20 @@ struct source {
     source(const source&) = default;
     source& operator=(const source& s) = default;
 
-    source(const addr_storage& saddr)
+    source(const source_addr& saddr)
         : saddr(saddr)
         , shared_source_timer(nullptr)
         , retransmission_count(-1) { /*not in a retransmission state*/
     }
 
+    source(const mc_addr& saddr)
+        : source(source_addr(saddr)) {
+    }
+
+    source(const addr_storage& saddr)
+        : source(mc_addr(saddr)) {
+    }
+
     std::string to_string() const {
         std::ostringstream s;
         s << saddr;
@@ -315,22 +426,48 @@ struct source {
         return l.saddr == r.saddr;
     }
 
-    addr_storage saddr;
+    source_addr saddr; //interned, sources compare their ids
     mutable std::shared_ptr<timer_msg> shared_source_timer;
     mutable long retransmission_count;
 };
 
+/**
+ * @brief Print a source list in the order of the addresses instead of the order of the interned ids.
+ */
+inline std::ostream& operator<<(std::ostream& stream, const source_list<source>& sl)
+{
+    std::vector<const source*> sorted;
+    sorted.reserve(sl.size());
+    for (auto & e : sl) {
+        sorted.push_back(&e);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const source * l, const source * r) {
+        return l->saddr.get() < r->saddr.get();
+    });
+
+    int i = 1;
+    for (auto e : sorted) {
+        if (i % 3 == 0 ) {
+            stream << std::endl << "\t";
+        }
+        stream << *e << "; ";
+        i++;
+    }
+    return stream;
+}
+
 struct group_record_msg : public proxy_msg {
     //group_record_msg()
     //: group_record_msg(0, MODE_IS_INCLUDE, addr_storage(), source_list<source>(), IGMPv3) {}
 
-    group_record_msg(unsigned int if_index, mcast_addr_record_type record_type, const addr_storage& gaddr, source_list<source>&& slist, group_mem_protocol grp_mem_proto)
+    group_record_msg(unsigned int if_index, mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>&& slist, group_mem_protocol grp_mem_proto, const mc_addr& host = mc_addr())
         : proxy_msg(GROUP_RECORD_MSG, LOSEABLE)
         , m_if_index(if_index)
         , m_record_type(record_type)
         , m_gaddr(gaddr)
-        , m_slist(slist)
-        , m_grp_mem_proto(grp_mem_proto){}
+        , m_slist(std::move(slist))
+        , m_grp_mem_proto(grp_mem_proto)
+        , m_host(host) {}
 
     friend std::ostream& operator<<(std::ostream& stream, const group_record_msg& r) {
         return stream << r.to_string();
@@ -344,6 +481,9 @@ struct group_record_msg : public proxy_msg {
         s << "group address: " << m_gaddr << std::endl;
         s << "source list: " << m_slist << std::endl;
         s << "report version: " << get_group_mem_protocol_name(m_grp_mem_proto);
+        if (m_host.is_valid()) {
+            s << std::endl << "host: " << m_host;
+        }
         return s.str();
     }
 
@@ -355,7 +495,7 @@ struct group_record_msg : public proxy_msg {
         return m_record_type;
     }
 
-    const addr_storage& get_gaddr() {
+    const mc_addr& get_gaddr() {
         return m_gaddr;
     }
 
@@ -367,16 +507,22 @@ struct group_record_msg : public proxy_msg {
         return m_grp_mem_proto;
     }
 
+    //address of the reporting host, invalid if unknown
+    const mc_addr& get_host() {
+        return m_host;
+    }
+
 private:
     unsigned int m_if_index;
     mcast_addr_record_type m_record_type;
-    addr_storage m_gaddr;
+    mc_addr m_gaddr;
     source_list<source> m_slist;
     group_mem_protocol m_grp_mem_proto;
+    mc_addr m_host;
 };
 
 struct new_source_msg : public proxy_msg {
-    new_source_msg(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr)
+    new_source_msg(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr)
         : proxy_msg(NEW_SOURCE_MSG, LOSEABLE)
         , m_if_index(if_index)
         , m_gaddr(gaddr)
@@ -388,18 +534,18 @@ struct new_source_msg : public proxy_msg {
         return m_if_index;
     }
 
-    const addr_storage& get_gaddr() {
+    const mc_addr& get_gaddr() {
         return m_gaddr;
     }
 
-    const addr_storage& get_saddr() {
+    const mc_addr& get_saddr() {
         return m_saddr;
     }
 
 private:
     unsigned int m_if_index;
-    addr_storage m_gaddr;
-    addr_storage m_saddr;
+    mc_addr m_gaddr;
+    mc_addr m_saddr;
 };
 
 //------------------------------------------------------------------------
@@ -409,7 +555,11 @@ struct config_msg : public proxy_msg {
         DEL_DOWNSTREAM,
         ADD_UPSTREAM,
         DEL_UPSTREAM,
-        SET_GLOBAL_RULE_BINDING
+        SET_GLOBAL_RULE_BINDING,
+        SET_DOWNSTREAM, //replace the rule bindings of a downstream and keep its querier
+        SET_UPSTREAM, //replace the rule bindings and the priority of an upstream
+        LINK_UP, //the link of an interface is running again, the memberships may be outdated
+        LINK_DOWN //the link of an interface is not running
     };
 
     config_msg(config_instruction instruction, unsigned int if_index, unsigned int upstream_priority, const std::shared_ptr<interface>& interf)
@@ -419,7 +569,7 @@ struct config_msg : public proxy_msg {
         , m_upstream_priority(upstream_priority)
         , m_interface(interf)
         , m_tv(timers_values()) {
-        if (instruction != DEL_DOWNSTREAM && instruction != ADD_UPSTREAM && instruction != DEL_UPSTREAM) {
+        if (instruction != DEL_DOWNSTREAM && instruction != ADD_UPSTREAM && instruction != DEL_UPSTREAM && instruction != SET_DOWNSTREAM && instruction != SET_UPSTREAM && instruction != LINK_UP && instruction != LINK_DOWN) {
             HC_LOG_ERROR("config_msg is incomplet, missing parameter timer_values");
             throw "config_msg is incomplet, missing parameter timer_values";
         }
@@ -480,5 +630,123 @@ struct exit_cmd : public proxy_msg {
     }
 };
 
+/**
+ * @brief The membership state of a group on a downstream interface changed.
+ */
+struct state_change_msg : public proxy_msg {
+    state_change_msg(unsigned int if_index, const mc_addr& gaddr)
+        : proxy_msg(STATE_CHANGE_MSG, SYSTEMIC)
+        , m_if_index(if_index)
+        , m_gaddr(gaddr) {
+        HC_LOG_TRACE("");
+    }
+
+    unsigned int get_if_index() {
+        return m_if_index;
+    }
+
+    const mc_addr& get_gaddr() {
+        return m_gaddr;
+    }
+
+private:
+    unsigned int m_if_index;
+    mc_addr m_gaddr;
+};
+
+//------------------------------------------------------------------------
+/**
+ * @brief A query received on an upstream interface, gaddr is unspecified for a general query.
+ */
+struct upstream_query_msg : public proxy_msg {
+    upstream_query_msg(unsigned int if_index, const mc_addr& gaddr, const std::chrono::milliseconds& max_resp_time)
+        : proxy_msg(UPSTREAM_QUERY_MSG, LOSEABLE)
+        , m_if_index(if_index)
+        , m_gaddr(gaddr)
+        , m_max_resp_time(max_resp_time) {
+        HC_LOG_TRACE("");
+    }
+
+    unsigned int get_if_index() {
+        return m_if_index;
+    }
+
+    const mc_addr& get_gaddr() {
+        return m_gaddr;
+    }
+
+    const std::chrono::milliseconds& get_max_resp_time() {
+        return m_max_resp_time;
+    }
+
+private:
+    unsigned int m_if_index;
+    mc_addr m_gaddr;
+    std::chrono::milliseconds m_max_resp_time;
+};
+
+//------------------------------------------------------------------------
+/**
+ * @brief A query of another router with a lower address received on a downstream interface,
+ *        gaddr is unspecified for a general query.
+ */
+struct querier_query_msg : public proxy_msg {
+    querier_query_msg(unsigned int if_index, const mc_addr& querier, const mc_addr& gaddr, bool suppress)
+        : proxy_msg(QUERIER_QUERY_MSG, LOSEABLE)
+        , m_if_index(if_index)
+        , m_querier(querier)
+        , m_gaddr(gaddr)
+        , m_suppress(suppress) {
+        HC_LOG_TRACE("");
+    }
+
+    unsigned int get_if_index() {
+        return m_if_index;
+    }
+
+    const mc_addr& get_querier() {
+        return m_querier;
+    }
+
+    const mc_addr& get_gaddr() {
+        return m_gaddr;
+    }
+
+    //the timers of the group are not lowered (S flag or a group-and-source-specific query)
+    bool is_suppressed() {
+        return m_suppress;
+    }
+
+private:
+    unsigned int m_if_index;
+    mc_addr m_querier;
+    mc_addr m_gaddr;
+    bool m_suppress;
+};
+
+/**
+ * @brief Restore the memberships and multicast sources of a checkpoint written elapsed time ago.
+ */
+struct restore_msg : public proxy_msg {
+    restore_msg(const std::shared_ptr<const proxy_snapshot>& snapshot, const std::chrono::milliseconds& elapsed)
+        : proxy_msg(RESTORE_MSG, SYSTEMIC)
+        , m_snapshot(snapshot)
+        , m_elapsed(elapsed) {
+        HC_LOG_TRACE("");
+    }
+
+    const std::shared_ptr<const proxy_snapshot>& get_snapshot() {
+        return m_snapshot;
+    }
+
+    const std::chrono::milliseconds& get_elapsed() {
+        return m_elapsed;
+    }
+
+private:
+    std::shared_ptr<const proxy_snapshot> m_snapshot;
+    std::chrono::milliseconds m_elapsed;
+};
+
 #endif // MESSAGE_FORMAT_HPP
 /** @} */
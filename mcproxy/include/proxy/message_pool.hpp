@@ -0,0 +1,241 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_communication Communication
+ * @{
+ */
+
+#ifndef MESSAGE_POOL_HPP
+#define MESSAGE_POOL_HPP
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <cstddef>
+#include <utility>
+
+#define MESSAGE_POOL_MAX_FREE_BLOCKS 4096 //per block size, in the global overflow list
+#define MESSAGE_POOL_BATCH_BLOCKS 32 //blocks moved at once between a thread and the overflow list
+
+/**
+ * @brief Free lists of equally sized memory blocks.
+ *
+ * The messages are allocated by the receivers and the timing and released
+ * by the workers. Each thread keeps its own free list, a releasing thread
+ * hands batches of blocks over to a global overflow list, an allocating
+ * thread takes a whole batch from it, so the lock is taken once per batch.
+ */
+template<std::size_t Size>
+class message_pool_free_list
+{
+private:
+    struct block {
+        block* m_next;
+        block* m_next_batch; //first block of a batch in the overflow list
+        std::size_t m_batch_size;
+    };
+
+    //free list of one thread, trivially destructible so it can still be used after the thread exit
+    struct thread_cache {
+        block* m_head;
+        std::size_t m_free_blocks;
+        bool m_closed; //the blocks released after the thread exit go to the overflow list
+    };
+
+    //hands the blocks of the thread over to the overflow list when the thread exits
+    struct thread_cache_guard {
+        thread_cache& m_cache;
+
+        thread_cache_guard(thread_cache& cache)
+            : m_cache(cache) {}
+
+        ~thread_cache_guard() {
+            if (m_cache.m_head != nullptr) {
+                get_instance().push_batch(m_cache.m_head, m_cache.m_free_blocks);
+            }
+            m_cache.m_head = nullptr;
+            m_cache.m_free_blocks = 0;
+            m_cache.m_closed = true;
+        }
+    };
+
+    std::mutex m_lock;
+    block* m_batches;
+    std::size_t m_free_blocks;
+
+    message_pool_free_list()
+        : m_batches(nullptr)
+        , m_free_blocks(0) {}
+
+    message_pool_free_list(const message_pool_free_list&) = delete;
+    message_pool_free_list& operator=(const message_pool_free_list&) = delete;
+
+    static thread_cache& get_thread_cache() {
+        static thread_local thread_cache cache;
+        static thread_local thread_cache_guard guard(cache);
+        return cache;
+    }
+
+    void push_batch(block* head, std::size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_free_blocks < MESSAGE_POOL_MAX_FREE_BLOCKS) {
+                head->m_next_batch = m_batches;
+                head->m_batch_size = size;
+                m_batches = head;
+                m_free_blocks += size;
+                return;
+            }
+        }
+
+        while (head != nullptr) {
+            block* b = head;
+            head = b->m_next;
+            ::operator delete(b);
+        }
+    }
+
+    block* pop_batch(std::size_t& size) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        block* head = m_batches;
+        if (head != nullptr) {
+            m_batches = head->m_next_batch;
+            size = head->m_batch_size;
+            m_free_blocks -= size;
+        }
+        return head;
+    }
+
+public:
+    static const std::size_t block_size = Size < sizeof(block) ? sizeof(block) : Size;
+
+    /**
+     * @brief The free list lives until the end of the process, so messages can be released during exit.
+     */
+    static message_pool_free_list& get_instance() {
+        static message_pool_free_list* const instance = new message_pool_free_list();
+        return *instance;
+    }
+
+    void* allocate() {
+        thread_cache& cache = get_thread_cache();
+        if (cache.m_closed) {
+            return ::operator new(block_size);
+        } else if (cache.m_head == nullptr) {
+            cache.m_head = pop_batch(cache.m_free_blocks);
+            if (cache.m_head == nullptr) {
+                return ::operator new(block_size);
+            }
+        }
+
+        block* b = cache.m_head;
+        cache.m_head = b->m_next;
+        --cache.m_free_blocks;
+        return b;
+    }
+
+    void deallocate(void* p) {
+        thread_cache& cache = get_thread_cache();
+        block* b = static_cast<block*>(p);
+        if (cache.m_closed) {
+            b->m_next = nullptr;
+            push_batch(b, 1);
+            return;
+        }
+
+        b->m_next = cache.m_head;
+        cache.m_head = b;
+        ++cache.m_free_blocks;
+
+        //keep one batch for the next allocations, hand the others over
+        if (cache.m_free_blocks >= 2 * MESSAGE_POOL_BATCH_BLOCKS) {
+            block* last = cache.m_head;
+            for (std::size_t i = 1; i < MESSAGE_POOL_BATCH_BLOCKS; ++i) {
+                last = last->m_next;
+            }
+
+            block* batch = last->m_next;
+            last->m_next = nullptr;
+            push_batch(batch, cache.m_free_blocks - MESSAGE_POOL_BATCH_BLOCKS);
+            cache.m_free_blocks = MESSAGE_POOL_BATCH_BLOCKS;
+        }
+    }
+};
+
+/**
+ * @brief Allocator that recycles the memory of released messages (object and reference count in one block).
+ */
+template<typename T>
+struct message_pool_allocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = message_pool_allocator<U>;
+    };
+
+    message_pool_allocator() = default;
+
+    template<typename U>
+    message_pool_allocator(const message_pool_allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        if (n == 1) {
+            return static_cast<T*>(message_pool_free_list<sizeof(T)>::get_instance().allocate());
+        } else {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        if (n == 1) {
+            message_pool_free_list<sizeof(T)>::get_instance().deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const message_pool_allocator<T>&, const message_pool_allocator<U>&)
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const message_pool_allocator<T>&, const message_pool_allocator<U>&)
+{
+    return false;
+}
+
+/**
+ * @brief Same as std::make_shared but the memory is taken from the message pool.
+ */
+template<typename T, typename... Args>
+std::shared_ptr<T> make_pooled_msg(Args&& ... args)
+{
+    return std::allocate_shared<T>(message_pool_allocator<T>(), std::forward<Args>(args)...);
+}
+
+#endif // MESSAGE_POOL_HPP
+/** @}*/
@@ -30,32 +30,105 @@
 #ifndef MESSAGE_QUEUE_HPP
 #define MESSAGE_QUEUE_HPP
 #include "include/hamcast_logging.h"
+#include "include/proxy/mpsc_ring.hpp"
+#include "include/utils/metrics.hpp"
+
 #include <thread>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
+#include <atomic>
 #include <climits>
 #include <vector>
+#include <memory>
+
+#define MESSAGE_QUEUE_LANE_CAPACITY 16384
+
+/**
+ * @brief Defines what happens to a new element if its lane is full.
+ */
+enum message_queue_policy {
+    MQ_BLOCK,       //wait until the consumer has made space (backpressure)
+    MQ_DROP_NEWEST, //discard the new element
+    MQ_DROP_OLDEST, //accept the new element, the consumer discards the oldest element of the lane
+    MQ_MERGE,       //like MQ_DROP_NEWEST, in addition the consumer merges equal elements
+    MQ_TRY          //like MQ_DROP_NEWEST, but the producer keeps the element to retry it, it is not counted as dropped
+};
 
 /**
- * @brief Fixed sized synchronised priority job queue.
+ * @brief Counters of a message_queue lane.
  */
-template<typename T, typename Compare = std::less<T>>
+struct message_queue_stats {
+    unsigned int m_size;
+    unsigned int m_bound;
+    unsigned int m_high_water;
+    unsigned long long m_enqueued;
+    unsigned long long m_dropped;
+};
+
+/**
+ * @brief Synchronised job queue with one lock-free lane per priority.
+ *
+ * The lane of an element is chosen by the functor Lane, which also defines
+ * the number of lanes (Lane::lane_count). Producers never lock, the single
+ * consumer drains the lanes in strict priority order (lane 0 first) and only
+ * locks to sleep if all lanes are empty.
+ */
+template<typename T, typename Lane>
 class message_queue
 {
 private:
-    std::priority_queue<T, std::vector<T>, Compare> m_q;
+    struct lane {
+        lane(std::size_t capacity, unsigned int bound)
+            : m_ring(capacity)
+            , m_count(0)
+            , m_bound(bound)
+            , m_drop_pending(0)
+            , m_high_water(0)
+            , m_enqueued(0)
+            , m_dropped(0) {}
+
+        mpsc_ring<T> m_ring;
+        std::atomic<unsigned int> m_count;
+        std::atomic<unsigned int> m_bound;
+
+        //number of old elements the consumer has to discard (MQ_DROP_OLDEST)
+        std::atomic<unsigned int> m_drop_pending;
+
+        std::atomic<unsigned int> m_high_water;
+        std::atomic<unsigned long long> m_enqueued;
+        std::atomic<unsigned long long> m_dropped;
+    };
+
+    Lane m_lane;
+    std::vector<std::unique_ptr<lane>> m_lanes;
     unsigned int m_size;
 
-    std::mutex m_global_lock;
+    std::atomic<bool> m_consumer_waiting;
+    std::mutex m_wait_lock;
     std::condition_variable cond_empty;
 
+    bool try_dequeue(T& t);
+    void notify_consumer();
+
+    bool reserve(lane& l, message_queue_policy policy);
+    void update_high_water(lane& l, unsigned int count);
+
 public:
     /**
       * @brief Create a message_queue with a maximum size.
-      * @param size size of the message_queue.
+      * @param size maximum size of each lane, limited by MESSAGE_QUEUE_LANE_CAPACITY.
+      */
+    message_queue(int size = UINT_MAX, Lane l = Lane());
+
+    /**
+      * @brief Set the maximum size of a lane, limited by MESSAGE_QUEUE_LANE_CAPACITY.
       */
-    message_queue(int size = UINT_MAX, Compare compare = Compare());
+    void set_lane_bound(unsigned int lane_index, unsigned int bound);
+
+    /**
+      * @brief Return the counters of a lane.
+      */
+    message_queue_stats get_stats(unsigned int lane_index) const;
 
     /**
       * @brief Return true if the message queue is empty.
@@ -73,105 +146,241 @@ public:
     int max_size() const;
 
     /**
-     * @brief Add an element on tail or delete the element if the queue is full.
+     * @brief Add an element on tail or delete the element if its lane is full.
      */
     bool enqueue_loseable(const T& t);
 
     /**
-     * @brief Add an element on tail and wait if the queie is full.
+     * @brief Add an element on tail, a full lane is handled according to policy.
+     * @return false if the element was discarded
      */
-    void enqueue(const T& t);
+    bool enqueue(const T& t, message_queue_policy policy = MQ_BLOCK);
 
     /**
      * @brief get and el element on head and wait if empty.
      */
     T dequeue(void);
+
+    /**
+     * @brief Append all pending elements up to max_count in priority order to batch and wait if empty.
+     */
+    void dequeue_batch(std::vector<T>& batch, unsigned int max_count);
 };
 
-template<typename T, typename Compare>
-message_queue<T, Compare>::message_queue(int size, Compare compare)
-    : m_q(compare)
+template<typename T, typename Lane>
+message_queue<T, Lane>::message_queue(int size, Lane l)
+    : m_lane(l)
     , m_size(size)
+    , m_consumer_waiting(false)
 {
     HC_LOG_TRACE("");
+
+    for (unsigned int i = 0; i < Lane::lane_count; ++i) {
+        m_lanes.emplace_back(new lane(MESSAGE_QUEUE_LANE_CAPACITY, 0));
+        set_lane_bound(i, m_size);
+    }
 }
 
-template<typename T, typename Compare>
-bool message_queue<T, Compare>::is_empty() const
+template<typename T, typename Lane>
+void message_queue<T, Lane>::set_lane_bound(unsigned int lane_index, unsigned int bound)
 {
     HC_LOG_TRACE("");
 
-    std::lock_guard<std::mutex> lock(m_global_lock);
+    lane& l = *m_lanes[lane_index];
+    if (bound > l.m_ring.capacity()) {
+        bound = l.m_ring.capacity();
+    }
+    l.m_bound.store(bound, std::memory_order_relaxed);
+}
+
+template<typename T, typename Lane>
+message_queue_stats message_queue<T, Lane>::get_stats(unsigned int lane_index) const
+{
+    HC_LOG_TRACE("");
 
-    return m_q.empty();
+    const lane& l = *m_lanes[lane_index];
+    message_queue_stats s;
+    s.m_size = l.m_count.load(std::memory_order_relaxed);
+    s.m_bound = l.m_bound.load(std::memory_order_relaxed);
+    s.m_high_water = l.m_high_water.load(std::memory_order_relaxed);
+    s.m_enqueued = l.m_enqueued.load(std::memory_order_relaxed);
+    s.m_dropped = l.m_dropped.load(std::memory_order_relaxed);
+    return s;
 }
 
-template<typename T, typename Compare>
-unsigned int message_queue<T, Compare>::size() const
+template<typename T, typename Lane>
+bool message_queue<T, Lane>::is_empty() const
 {
     HC_LOG_TRACE("");
 
-    std::lock_guard<std::mutex> lock(m_global_lock);
+    return size() == 0;
+}
+
+template<typename T, typename Lane>
+unsigned int message_queue<T, Lane>::size() const
+{
+    HC_LOG_TRACE("");
 
-    return m_q.size();
+    unsigned int result = 0;
+    for (auto & e : m_lanes) {
+        result += e->m_count.load(std::memory_order_relaxed);
+    }
+    return result;
 }
 
-template<typename T, typename Compare>
-int message_queue<T, Compare>::max_size() const
+template<typename T, typename Lane>
+int message_queue<T, Lane>::max_size() const
 {
     HC_LOG_TRACE("");
 
     return m_size;
 }
 
-template<typename T, typename Compare>
-bool message_queue<T, Compare>::enqueue_loseable(const T& t)
+template<typename T, typename Lane>
+void message_queue<T, Lane>::notify_consumer()
+{
+    //pairs with the fence in dequeue(), either the consumer sees the new element or we see it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_consumer_waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(m_wait_lock);
+        cond_empty.notify_one();
+    }
+}
+
+template<typename T, typename Lane>
+void message_queue<T, Lane>::update_high_water(lane& l, unsigned int count)
+{
+    unsigned int hw = l.m_high_water.load(std::memory_order_relaxed);
+    while (count > hw && !l.m_high_water.compare_exchange_weak(hw, count, std::memory_order_relaxed)) {
+    }
+}
+
+template<typename T, typename Lane>
+bool message_queue<T, Lane>::reserve(lane& l, message_queue_policy policy)
+{
+    if (policy == MQ_DROP_OLDEST) {
+        unsigned int count = l.m_count.fetch_add(1, std::memory_order_relaxed);
+        if (count >= l.m_bound.load(std::memory_order_relaxed)) {
+            l.m_drop_pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        update_high_water(l, count + 1);
+        return true;
+    }
+
+    unsigned int count = l.m_count.load(std::memory_order_relaxed);
+    for (;;) {
+        if (count >= l.m_bound.load(std::memory_order_relaxed)) {
+            if (policy != MQ_BLOCK) {
+                return false;
+            }
+
+            notify_consumer();
+            std::this_thread::yield();
+            count = l.m_count.load(std::memory_order_relaxed);
+        } else if (l.m_count.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+            update_high_water(l, count + 1);
+            return true;
+        }
+    }
+}
+
+template<typename T, typename Lane>
+bool message_queue<T, Lane>::enqueue_loseable(const T& t)
+{
+    HC_LOG_TRACE("");
+
+    return enqueue(t, MQ_DROP_NEWEST);
+}
+
+template<typename T, typename Lane>
+bool message_queue<T, Lane>::enqueue(const T& t, message_queue_policy policy)
 {
     HC_LOG_TRACE("");
 
-    {
-        std::unique_lock<std::mutex> lock(m_global_lock);
-        if (m_q.size() < m_size) {
-            m_q.push(t);
-        } else {
-            HC_LOG_WARN("message_queue is full, failed to insert message");
+    lane& l = *m_lanes[m_lane(t)];
+
+    if (!reserve(l, policy)) {
+        if (policy == MQ_TRY) {
             return false;
         }
+
+        l.m_dropped.fetch_add(1, std::memory_order_relaxed);
+        metrics::add(METRIC_QUEUE_DROPPED);
+        HC_LOG_WARN("message_queue is full, failed to insert message");
+        return false;
     }
-    cond_empty.notify_one();
+
+    while (!l.m_ring.try_push(t)) {
+        notify_consumer();
+        std::this_thread::yield();
+    }
+
+    l.m_enqueued.fetch_add(1, std::memory_order_relaxed);
+    metrics::add(METRIC_QUEUE_ENQUEUED);
+    metrics::add(METRIC_QUEUE_DEPTH);
+    notify_consumer();
     return true;
 }
 
-template<typename T, typename Compare>
-void message_queue<T, Compare>::enqueue(const T& t)
+template<typename T, typename Lane>
+bool message_queue<T, Lane>::try_dequeue(T& t)
 {
-    HC_LOG_TRACE("");
+    for (auto & e : m_lanes) {
+        while (e->m_ring.try_pop(t)) {
+            e->m_count.fetch_sub(1, std::memory_order_relaxed);
+            metrics::add(METRIC_QUEUE_DEPTH, -1);
+
+            //the lane overflowed with MQ_DROP_OLDEST, discard the oldest element
+            unsigned int drop = e->m_drop_pending.load(std::memory_order_relaxed);
+            if (drop > 0 && e->m_drop_pending.compare_exchange_strong(drop, drop - 1, std::memory_order_relaxed)) {
+                e->m_dropped.fetch_add(1, std::memory_order_relaxed);
+                metrics::add(METRIC_QUEUE_DROPPED);
+                t = T();
+                continue;
+            }
 
-    {
-        std::unique_lock<std::mutex> lock(m_global_lock);
-        m_q.push(t);
+            return true;
+        }
     }
-    cond_empty.notify_one();
-    HC_LOG_DEBUG("!!!!!test2");
+
+    return false;
 }
 
-template<typename T, typename Compare>
-T message_queue<T, Compare>::dequeue(void)
+template<typename T, typename Lane>
+T message_queue<T, Lane>::dequeue(void)
 {
     HC_LOG_TRACE("");
 
     T t;
-    {
-        std::unique_lock<std::mutex> lock(m_global_lock);
-        cond_empty.wait(lock, [&]() {
-            return m_q.size() != 0;
-        });
-
-        t = m_q.top();
-        m_q.pop();
+    while (!try_dequeue(t)) {
+        std::unique_lock<std::mutex> lock(m_wait_lock);
+        m_consumer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (!try_dequeue(t)) {
+            cond_empty.wait(lock);
+            m_consumer_waiting.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        m_consumer_waiting.store(false, std::memory_order_relaxed);
+        break;
     }
     return t;
 }
 
+template<typename T, typename Lane>
+void message_queue<T, Lane>::dequeue_batch(std::vector<T>& batch, unsigned int max_count)
+{
+    HC_LOG_TRACE("");
+
+    batch.push_back(dequeue());
+
+    T t;
+    for (unsigned int i = 1; i < max_count && try_dequeue(t); ++i) {
+        batch.push_back(std::move(t));
+    }
+}
+
 #endif // MESSAGE_QUEUE_HPP
 /** @} */
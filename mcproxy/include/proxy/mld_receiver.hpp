@@ -44,9 +44,15 @@ private:
     int get_ctrl_min_size() override; //size in byte
     int get_iov_min_size() override; //size in byte
     void analyse_packet(struct msghdr* msg, int info_size) override;
+    void get_socket_filter(std::vector<struct sock_filter>& filter) override;
 
 public:
     mld_receiver(proxy_instance* pr_i, std::shared_ptr<const mroute_socket> mrt_sock, std::shared_ptr<const interfaces> interfaces, bool in_debug_testing_mode);
+
+    /**
+     * @brief Stop receiving before the packet analysis is destroyed.
+     */
+    virtual ~mld_receiver();
 };
 
 #endif // MLD_RECEIVER_HPP
@@ -55,8 +55,12 @@ private:
 
     bool send_mldv2_query(unsigned int if_index, const timers_values& tv, const addr_storage& gaddr, bool s_flag, const source_list<source>& slist) const;
 
+    void get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const override;
+
+    void queue_report(unsigned int if_index, std::vector<report_record>::const_iterator begin, std::vector<report_record>::const_iterator end) const override;
+
 public:
-    mld_sender(const std::shared_ptr<const interfaces>& interfaces);
+    mld_sender(const std::shared_ptr<const interfaces>& interfaces, bool native_reports = false);
 
     bool send_record(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const override;
 
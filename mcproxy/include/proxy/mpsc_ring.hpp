@@ -0,0 +1,161 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_communication Communication
+ * @{
+ */
+
+#ifndef MPSC_RING_HPP
+#define MPSC_RING_HPP
+
+#include "include/hamcast_logging.h"
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free ring for multiple producers and a single consumer.
+ *
+ * Each cell carries a sequence number that tells the producers whether the
+ * cell is free and the consumer whether the cell is filled (D. Vyukov's bounded queue).
+ */
+template<typename T>
+class mpsc_ring
+{
+private:
+    struct cell {
+        std::atomic<std::size_t> m_seq;
+        T m_data;
+    };
+
+    const std::size_t m_mask;
+    std::unique_ptr<cell[]> m_buffer;
+
+    std::atomic<std::size_t> m_enqueue_pos;
+
+    //only used by the consumer
+    std::size_t m_dequeue_pos;
+
+    static std::size_t round_up_to_power_of_two(std::size_t size);
+
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+public:
+    /**
+     * @param capacity minimum number of elements, rounded up to a power of two
+     */
+    mpsc_ring(std::size_t capacity);
+
+    /**
+     * @brief Add an element, can be called by any thread.
+     * @return false if the ring is full
+     */
+    bool try_push(const T& t);
+
+    /**
+     * @brief Remove the oldest element, must only be called by the consumer.
+     * @return false if the ring is empty
+     */
+    bool try_pop(T& t);
+
+    std::size_t capacity() const;
+};
+
+template<typename T>
+std::size_t mpsc_ring<T>::round_up_to_power_of_two(std::size_t size)
+{
+    std::size_t result = 2;
+    while (result < size) {
+        result <<= 1;
+    }
+    return result;
+}
+
+template<typename T>
+mpsc_ring<T>::mpsc_ring(std::size_t capacity)
+    : m_mask(round_up_to_power_of_two(capacity) - 1)
+    , m_buffer(new cell[m_mask + 1])
+    , m_enqueue_pos(0)
+    , m_dequeue_pos(0)
+{
+    HC_LOG_TRACE("");
+
+    for (std::size_t i = 0; i <= m_mask; ++i) {
+        m_buffer[i].m_seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+bool mpsc_ring<T>::try_push(const T& t)
+{
+    cell* c;
+    std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+    for (;;) {
+        c = &m_buffer[pos & m_mask];
+        std::size_t seq = c->m_seq.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+
+        if (diff == 0) { //free cell, try to claim it
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) { //the consumer has not freed this cell yet
+            return false;
+        } else { //another producer claimed the cell
+            pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    c->m_data = t;
+    c->m_seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T>
+bool mpsc_ring<T>::try_pop(T& t)
+{
+    cell* c = &m_buffer[m_dequeue_pos & m_mask];
+    std::size_t seq = c->m_seq.load(std::memory_order_acquire);
+
+    if (seq != m_dequeue_pos + 1) { //not filled yet
+        return false;
+    }
+
+    t = std::move(c->m_data);
+    c->m_data = T();
+    c->m_seq.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+    ++m_dequeue_pos;
+    return true;
+}
+
+template<typename T>
+std::size_t mpsc_ring<T>::capacity() const
+{
+    return m_mask + 1;
+}
+
+#endif // MPSC_RING_HPP
+/** @} */
@@ -0,0 +1,140 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+/**
+ * @addtogroup mod_proxy_instance Proxy Instance
+ * @{
+ */
+
+#ifndef PCAP_REPLAY_HPP
+#define PCAP_REPLAY_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4 //classic pcap format with microsecond time stamps
+#define PCAP_MAGIC_NSEC 0xa1b23c4d //classic pcap format with nanosecond time stamps
+#define PCAP_MAX_PACKET_SIZE 262144
+
+//supported link layer header types
+#define PCAP_LINKTYPE_NULL 0
+#define PCAP_LINKTYPE_EN10MB 1
+#define PCAP_LINKTYPE_RAW 101
+#define PCAP_LINKTYPE_LINUX_SLL 113
+#define PCAP_LINKTYPE_IPV4 228
+#define PCAP_LINKTYPE_IPV6 229
+#define PCAP_LINKTYPE_LINUX_SLL2 276
+
+#define PCAP_REPLAY_UNRESOLVED_MSEC 10000 //time the kernel queues the packets of a new source until its route is added
+
+class proxy_instance;
+class interfaces;
+class recording_kernel;
+class recording_sender;
+
+/**
+ * @brief Replays the IGMP/MLD packets and the multicast data of a capture file (classic pcap format)
+ *        through the receiver of a proxy instance. The kernel and the sender of the proxy instance are
+ *        replaced by recording ones, so neither packets are sent nor kernel routes are changed. The
+ *        membership messages are received on the first downstream and the multicast data on the first
+ *        upstream of the first proxy instance of the configuration, queries are skipped.
+ */
+class pcap_replay
+{
+private:
+    std::ifstream m_file;
+    bool m_swapped; //the capture has the other byte order
+    bool m_nsec;
+    uint32_t m_link_type;
+
+    std::shared_ptr<const interfaces> m_interfaces;
+    std::shared_ptr<recording_kernel> m_kernel;
+    std::shared_ptr<recording_sender> m_sender;
+    std::unique_ptr<proxy_instance> m_proxy_instance;
+    group_mem_protocol m_group_mem_protocol;
+    unsigned int m_upstream;
+    unsigned int m_downstream;
+
+    std::vector<unsigned char> m_frame;
+    std::vector<unsigned char> m_packet; //aligned copy of the analysed part of a packet
+    uint64_t m_time; //capture time of the current packet in usec
+
+    unsigned long long m_packets;
+    unsigned long long m_reports;
+    unsigned long long m_leaves;
+    unsigned long long m_queries;
+    unsigned long long m_data;
+    unsigned long long m_upcalls;
+    unsigned long long m_skipped;
+
+    uint32_t get_uint32(const unsigned char* buf) const;
+
+    //read the file header, return false if the format is not supported
+    bool read_header();
+
+    //read the next packet into m_frame, return false at the end of the capture
+    bool read_packet(bool& truncated);
+
+    //offset and address family of the ip packet in m_frame, false if the frame has no ip packet
+    bool get_ip_packet(std::size_t& offset, int& addr_family) const;
+
+    void analyse_ipv4(const unsigned char* buf, std::size_t size);
+    void analyse_ipv6(const unsigned char* buf, std::size_t size);
+
+    //hand a membership message to the receiver as received on the first downstream
+    void inject_ipv4(const unsigned char* buf, std::size_t size);
+    void inject_ipv6(const unsigned char* buf, std::size_t size, const addr_storage& saddr, const addr_storage& daddr);
+
+    //pass a multicast data packet received on the first upstream to the recording kernel, which reports new sources
+    void forward(const mc_addr& gaddr, const mc_addr& saddr);
+
+    //wait until the proxy instance has processed all injected messages and set its routes
+    void wait_until_processed();
+
+    void print_summary(double capture_sec, double replay_sec, long start_rss) const;
+
+    pcap_replay(const pcap_replay&) = delete;
+    pcap_replay& operator=(const pcap_replay&) = delete;
+
+    pcap_replay();
+
+public:
+    virtual ~pcap_replay();
+
+    /**
+     * @brief Replay a capture as fast as possible and print the throughput, the peak memory and the kernel and
+     *        sender calls. The interfaces of the configuration have to exist, but no privileges are required.
+     * @param pcap_path capture in the classic pcap format (pcapng has to be converted, e.g. with tshark -F pcap)
+     * @param config_path configuration file of the proxy
+     * @param explicit_tracking track the membership of each host like the option -e
+     * @return false if the capture cannot be read
+     */
+    static bool replay(const std::string& pcap_path, const std::string& config_path, bool explicit_tracking);
+};
+
+#endif // PCAP_REPLAY_HPP
+/** @} */
@@ -31,14 +31,22 @@
 #ifndef PROXY_HPP
 #define PROXY_HPP
 
+#include "include/proxy/report_pacer.hpp"
+
 #include <vector>
 #include <string>
 #include <memory>
 #include <map>
+#include <set>
+#include <chrono>
 
 class configuration;
 class timing;
 class proxy_instance;
+class instance_definition;
+class interface_monitor;
+class event_trace;
+class control_socket;
 
 /**
   * @brief start and maintain all proxy instances.
@@ -47,22 +55,90 @@ class proxy
 {
 private:
     static bool m_running;
+
+    //set by SIGHUP, the configuration file is reloaded by the main loop
+    static bool m_reload;
+
+    //the signal handler wakes the main loop by writing to this pipe
+    static int m_signal_pipe[2];
+
     int m_verbose_lvl;
     bool m_print_proxy_status;
     bool m_reset_rp_filter;
     std::string m_config_path;
 
+    //coalesce the timer events of each proxy instance, zero disables it
+    std::chrono::milliseconds m_timer_slack;
+    unsigned int m_querier_shards;
+    bool m_group_sharding;
+    bool m_explicit_tracking;
+
+    //build the upstream reports in the proxy instead of the kernel
+    bool m_native_reports;
+
+    //merge and rate limit the upstream records of each proxy instance, disabled by default
+    report_pacing m_report_pacing;
+
+    //number of timer threads shared round robin by the proxy instances, zero gives each instance its own
+    unsigned int m_timing_threads;
+
+    //checkpoint file of the memberships and sources restored on startup, empty if disabled
+    std::string m_checkpoint_path;
+    std::chrono::steady_clock::time_point m_last_checkpoint;
+    std::chrono::steady_clock::time_point m_start_time;
+
+    //records the input events of all proxy instances to this file, empty if disabled
+    std::string m_trace_path;
+    std::shared_ptr<event_trace> m_event_trace;
+
+    //directory the XDP program that forwards the multicast data instead of the kernel is pinned in, empty if disabled
+    std::string m_xdp_pin_path;
+
+    //status, membership dumps, metrics and reload served by the main loop, empty if disabled
+    std::string m_control_path;
+    std::unique_ptr<control_socket> m_control_socket;
+
+    //answer a command of the control socket from the published snapshots, the proxy instances are not interrupted
+    std::string handle_control_command(const std::vector<std::string>& args);
+    std::string control_status() const;
+    std::string control_dump(const std::string& instance_name) const;
+
+    //block the main loop until a signal, a control command or the timeout (negative waits infinitely)
+    void wait(std::chrono::milliseconds timeout) const;
+
+    //time until the next checkpoint has to be written, negative if checkpoints are disabled
+    std::chrono::milliseconds get_checkpoint_timeout() const;
+
     std::unique_ptr<configuration> m_configuration;
-    std::shared_ptr<timing> m_timing;
+
+    //reports link and address changes of the interfaces, the proxy instances are notified by config messages
+    std::unique_ptr<interface_monitor> m_interface_monitor;
+    void handle_interface_changes(const std::set<unsigned int>& up, const std::set<unsigned int>& down, bool addresses_changed);
+    std::vector<std::shared_ptr<timing>> m_timings;
+
+    //return the timer thread of the proxy instance with the given position
+    const std::shared_ptr<timing>& get_timing(unsigned int instance_number);
 
     //table (= interface index), proxy_instance
     std::map<int, std::unique_ptr<proxy_instance>> m_proxy_instances;
 
+    //instance name, table
+    std::map<std::string, int> m_instance_tables;
+
     void prozess_commandline_args(int arg_count, char* args[]);
     void help_output();
 
     void start_proxy_instances();
 
+    //parse the configuration file again and send only the changed interfaces and rule bindings to the running proxy instances,
+    //the state of unchanged interfaces is kept; false if the new configuration needs a restart (nothing is changed then)
+    bool reload_configuration();
+
+    //restore the proxy instances from the checkpoint file, write it every CHECKPOINT_INTERVAL or if force is set
+    void restore_checkpoint();
+    void write_checkpoint(bool force);
+    void reload_proxy_instance(proxy_instance& pr_i, const instance_definition& running, const instance_definition& next, bool tables_changed);
+
 
     static void signal_handler(int sig);
 
@@ -71,7 +147,7 @@ private:
     unsigned int get_default_priority_interval();
 public:
     /**
-     * @brief Set default values of the class members and add signal handlers for the signal SIGINT and SIGTERM.
+     * @brief Set default values of the class members and add signal handlers for the signal SIGINT, SIGTERM and SIGHUP (reload the configuration).
      */
     proxy(int arg_count, char* args[]);
 
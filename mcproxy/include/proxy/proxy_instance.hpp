@@ -33,11 +33,25 @@
 #include "include/proxy/worker.hpp"
 #include "include/proxy/def.hpp"
 #include "include/proxy/querier.hpp"
+#include "include/proxy/proxy_snapshot.hpp"
+#include "include/proxy/report_pacer.hpp"
 #include "include/parser/interface.hpp"
 
 #include <memory>
 #include <set>
+#include <map>
+#include <vector>
+#include <tuple>
 #include <functional>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <atomic>
+
+#define PROXY_INSTANCE_BATCH_SIZE 256 //maximum number of messages processed at once
+#define PROXY_INSTANCE_QUERY_JITTER 10 //jitter of the general query phases in percent of the distance between two downstreams
+#define PROXY_INSTANCE_REPORT_RECORDS 256 //current state records per step of the answer to an upstream general query (native reports)
+#define PROXY_INSTANCE_REPORT_PACE_MSEC 10 //time between two steps of the answer to an upstream general query
 
 class timing;
 class receiver;
@@ -48,6 +62,9 @@ class interface;
 class simple_mc_proxy_routing;
 class routing_management;
 class interface_memberships;
+class querier_shard;
+class event_trace;
+class pcap_replay;
 
 /**
  * @brief Represent a multicast proxy (RFC 4605)
@@ -56,11 +73,12 @@ class proxy_instance: public worker
 {
 private:
     struct downstream_infos {
-        downstream_infos(std::unique_ptr<querier> querier, const std::shared_ptr<interface>& interf)
-            : m_querier(std::move(querier))
+        downstream_infos(std::vector<std::unique_ptr<querier>>&& queriers, const std::shared_ptr<interface>& interf)
+            : m_queriers(std::move(queriers))
             , m_interface(interf) {}
 
-        std::unique_ptr<querier> m_querier;
+        //one querier per group slice (see get_slice), the first one sends the general queries
+        std::vector<std::unique_ptr<querier>> m_queriers;
         std::shared_ptr<interface> m_interface;
     };
 
@@ -76,7 +94,8 @@ private:
             
         friend bool operator < (const upstream_infos& l, const upstream_infos& r) {
             HC_LOG_TRACE("");
-            return l.m_priority < r.m_priority;
+            //equal priorities exist only while a configuration reload reorders the upstreams
+            return l.m_priority < r.m_priority || (l.m_priority == r.m_priority && l.m_if_index < r.m_if_index);
         }
     };
 
@@ -87,10 +106,20 @@ private:
     const std::string m_instance_name;
     const int m_table_number;
     const bool m_in_debug_testing_mode;
+    const bool m_explicit_tracking;
+
+    //distribute the group addresses instead of the downstreams to the querier shards
+    const bool m_group_sharding;
+
+    //build the upstream reports on the raw socket instead of joining the groups on the sender socket
+    const bool m_native_reports;
 
     const std::shared_ptr<const interfaces> m_interfaces;
     const std::shared_ptr<timing> m_timing;
 
+    //records the input events of this instance and its querier shards, nullptr if disabled
+    const std::shared_ptr<event_trace> m_event_trace;
+
     std::shared_ptr<mroute_socket> m_mrt_sock;
     std::shared_ptr<sender> m_sender;
 
@@ -107,9 +136,58 @@ private:
     //std::map<unsigned int, std::unique_ptr<querier>> m_querier;
     std::map<unsigned int, downstream_infos> m_downstreams;
 
+    //worker threads processing the queriers of the downstreams (if_index % number of shards or with group sharding
+    //the group slice of every downstream), empty if this instance does it itself
+    std::vector<std::unique_ptr<querier_shard>> m_shards;
+
     std::shared_ptr<rule_binding> m_upstream_input_rule;
     std::shared_ptr<rule_binding> m_upstream_output_rule;
 
+    //group addresses changed by the queriers while processing a batch of messages
+    //(group address, (interface index, receive time of the oldest group record that caused the change))
+    std::map<mc_addr, std::pair<unsigned int, std::chrono::steady_clock::time_point>> m_pending_state_changes;
+    void add_pending_state_change(unsigned int if_index, const mc_addr& gaddr, const std::chrono::steady_clock::time_point& origin);
+
+    //random jitter of the general query phases
+    std::minstd_rand m_query_jitter;
+
+    //last group record per interface, group address and host (only with explicit tracking, otherwise empty)
+    //and the new sources of the current batch (MQ_MERGE)
+    std::map<std::tuple<unsigned int, mc_addr, mc_addr>, std::shared_ptr<group_record_msg>> m_batch_records;
+    std::set<std::tuple<unsigned int, mc_addr, mc_addr>> m_batch_sources;
+
+    //outcome of the route changes, updated by the route writer thread of m_routing
+    std::atomic<unsigned long long> m_route_changes;
+    std::atomic<unsigned long long> m_route_failures;
+    std::atomic<long long> m_route_max_latency_usec;
+
+    void route_completed(const mc_addr& gaddr, const mc_addr& saddr, bool add, bool success, const std::chrono::steady_clock::duration& latency);
+
+    //pending answer to a general query per upstream (native reports), the current step of a paced answer
+    std::map<unsigned int, std::shared_ptr<upstream_report_timer_msg>> m_upstream_reports;
+
+    //pending retransmission of the upstream state changes (native reports)
+    std::shared_ptr<upstream_report_timer_msg> m_report_retransmission;
+
+    //merges and rate limits the upstream state changes, nullptr if disabled, and its pending flush
+    std::unique_ptr<report_pacer> m_report_pacer;
+    std::shared_ptr<upstream_report_timer_msg> m_report_pacing;
+
+    //answer the queries of the upstream routers with the current state of the upstream
+    void handle_upstream_query(const std::shared_ptr<upstream_query_msg>& msg);
+    void handle_upstream_report(const std::shared_ptr<upstream_report_timer_msg>& msg);
+
+    //hand the query of another router to the queriers of the downstream for the querier election, a general query
+    //to the queriers of all group slices and a group specific query to the querier of the group
+    void handle_querier_query(const std::shared_ptr<querier_query_msg>& msg);
+
+    //send the paced upstream records that are due, send the upstream reports of the state changes
+    //and schedule their retransmission (native reports)
+    void flush_reports();
+
+    //last published state of this instance, replaced as a whole and accessed only with std::atomic_load/std::atomic_store
+    std::shared_ptr<const proxy_snapshot> m_snapshot;
+
     //init
     bool init_mrt_socket();
     bool init_sender();
@@ -119,10 +197,47 @@ private:
 
     //receives and process all events
     void worker_thread();
+    void handle_msg(const std::shared_ptr<proxy_msg>& msg);
+
+    //return true if msg repeats a message of the current batch without any other event in between
+    bool is_merged(const std::shared_ptr<proxy_msg>& msg);
+
+    //collect the querier state changes and recalculate the routing once per group address
+    void querier_state_change(unsigned int if_index, const mc_addr& gaddr);
+    void flush_state_changes();
+
+    //send the queries the queriers of this instance collected while processing the last batch
+    void flush_queries();
+
+    //publish a new snapshot if the membership or routing state has changed since the last one
+    void publish_snapshot();
 
     //add and del interfaces
     void handle_config(const std::shared_ptr<config_msg>& msg);
 
+    //recalculate the routes and upstream memberships of all known groups after the rule bindings or upstreams changed
+    void reevaluate_groups();
+
+    //restore the memberships and multicast sources of a checkpoint
+    void handle_restore(const std::shared_ptr<restore_msg>& msg);
+
+    //spread the general queries of all downstreams evenly over their query interval
+    void spread_general_queries();
+
+    //forward coalesced timer events to their queriers and the routing management
+    void handle_timer_batch(const std::shared_ptr<timer_batch_msg>& msg);
+
+    //number of queriers per downstream and the one responsible for gaddr
+    unsigned int get_slice_count() const;
+    unsigned int get_slice(const mc_addr& gaddr) const;
+
+    //return the shard of a querier or nullptr if the querier runs in this instance
+    querier_shard* get_shard(unsigned int if_index, unsigned int slice = 0) const;
+
+    //returns a lock on a querier of if_index, the lock is empty if the querier runs in this instance
+    std::unique_lock<std::mutex> lock_querier(unsigned int if_index, unsigned int slice = 0) const;
+    std::unique_lock<std::mutex> lock_querier(unsigned int if_index, const mc_addr& gaddr) const;
+
     bool is_upstream(unsigned int if_index) const;
     bool is_downstream(unsigned int if_index) const;
 
@@ -136,28 +251,62 @@ public:
      * @param interfaces Holds all possible needed information of all upstream and downstream interfaces.
      * @param shared_timing Stores and triggers all time-dependent events for this proxy instance.
      * @param in_debug_testing_mode If true this proxy instance stops receiving group membership messages and prints a lot of status messages to the command line.
+     * @param querier_shards Number of worker threads the queriers of the downstreams are distributed to, if set to 0 the queriers run in the thread of this instance.
+     * @param explicit_tracking If true the queriers track the state of each reporting host and prune without last listener queries.
+     * @param group_sharding If true every querier shard processes a slice of the group addresses of all downstreams instead of whole downstreams.
+     * @param native_reports If true the IGMPv3/MLDv2 reports to the upstreams are built by the proxy, packed into reports of the interface mtu, and the queries of the upstream routers are answered by the proxy.
+     * @param trace If set the input events of the worker threads are recorded to replay them with event_trace::replay().
+     * @param mrt_sock If set this created socket is used for the kernel calls instead of a new one (e.g. a recording kernel).
+     * @param snd If set this sender is used instead of a new one.
      */
-    proxy_instance(group_mem_protocol group_mem_protocol, const std::string& intance_name, int table_number, const std::shared_ptr<const interfaces>& interfaces, const std::shared_ptr<timing>& shared_timing, bool in_debug_testing_mode = false);
+    proxy_instance(group_mem_protocol group_mem_protocol, const std::string& intance_name, int table_number, const std::shared_ptr<const interfaces>& interfaces, const std::shared_ptr<timing>& shared_timing, bool in_debug_testing_mode = false, unsigned int querier_shards = 0, bool explicit_tracking = false, bool group_sharding = false, bool native_reports = false, const std::shared_ptr<event_trace>& trace = nullptr, const std::shared_ptr<mroute_socket>& mrt_sock = nullptr, const std::shared_ptr<sender>& snd = nullptr);
 
     /**
      * @brief Release all resources.
      */
     virtual ~proxy_instance();
 
-    static void test_querier(std::string if_name);
+    /**
+     * @brief Return the worker that processes the group records and timers of the querier of if_index.
+     */
+    const worker* get_querier_worker(unsigned int if_index) const;
+
+    /**
+     * @brief Return the worker that processes the group records of gaddr received on if_index.
+     */
+    const worker* get_querier_worker(unsigned int if_index, const mc_addr& gaddr) const;
 
-    static void test_a(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
-    static void test_b(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
-    static void test_c(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
-    static void test_d(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
-    static void test_backward_compatibility(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
+    /**
+     * @brief Return true if the upstream reports are built by the proxy instead of the kernel.
+     */
+    bool has_native_reports() const;
 
-    static void quick_test(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
-    static void rand_test(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance);
+    /**
+     * @brief Return true if the queriers track the state of each reporting host (option -e).
+     */
+    bool has_explicit_tracking() const;
+
+    /**
+     * @brief Return the membership and routing state after the last processed batch of messages.
+     *        Can be called from any thread, the snapshot is immutable and does not block the instance.
+     */
+    std::shared_ptr<const proxy_snapshot> get_snapshot() const;
+
+    /**
+     * @brief Set the timer slack of this instance and all querier shards.
+     */
+    void set_timer_slack(const std::chrono::milliseconds& slack);
+
+    /**
+     * @brief Merge the upstream state changes of a group over the interval of the pacing and limit
+     *        the records per second of each upstream. Has to be called before the first message is added.
+     */
+    void set_report_pacing(const report_pacing& pacing);
 
     friend routing_management;
     friend simple_mc_proxy_routing;
     friend interface_memberships;
+    friend pcap_replay;
 };
 
 #endif // PROXY_INSTANCE_HPP
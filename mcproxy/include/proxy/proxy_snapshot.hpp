@@ -0,0 +1,96 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+/**
+ * @addtogroup mod_proxy_instance Proxy Instance
+ * @{
+ */
+
+#ifndef PROXY_SNAPSHOT_HPP
+#define PROXY_SNAPSHOT_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+
+/**
+ * @brief Immutable membership state of one group address of a downstream.
+ */
+struct group_snapshot {
+    mc_addr gaddr;
+    unsigned long long version; //group version of the querier this snapshot was taken from
+    mc_filter filter_mode;
+    group_mem_protocol compatibility_mode;
+    source_list<mc_addr> include_requested_list;
+    source_list<mc_addr> exclude_list;
+
+    std::string to_string() const;
+};
+
+/**
+ * @brief Immutable membership state of one downstream, the groups are sorted by their address.
+ */
+struct downstream_snapshot {
+    unsigned int if_index;
+    unsigned long long version; //state version of the querier this snapshot was taken from
+    group_mem_protocol querier_version_mode;
+    bool is_querier;
+    std::vector<std::shared_ptr<const group_snapshot>> groups;
+
+    std::string to_string() const;
+};
+
+/**
+ * @brief A multicast source known by the routing and the interface it is received on.
+ */
+struct route_snapshot {
+    mc_addr gaddr;
+    mc_addr saddr;
+    unsigned int input_if_index;
+};
+
+using route_snapshot_list = std::vector<route_snapshot>;
+
+/**
+ * @brief Immutable membership and routing state of a proxy instance. A snapshot is
+ *        never changed after it has been published, unchanged parts are shared with the previous snapshot.
+ */
+struct proxy_snapshot {
+    unsigned long long version; //incremented with every published snapshot of the instance
+    std::chrono::steady_clock::time_point time;
+    std::string instance_name;
+    int table_number;
+    std::vector<unsigned int> upstreams; //ordered by priority
+    std::vector<std::shared_ptr<const downstream_snapshot>> downstreams; //ordered by if_index
+    std::shared_ptr<const route_snapshot_list> routes; //ordered by group and source address
+
+    std::string to_string() const;
+    friend std::ostream& operator<<(std::ostream& stream, const proxy_snapshot& s);
+};
+
+#endif // PROXY_SNAPSHOT_HPP
+/** @} */
@@ -25,21 +25,32 @@
 
 #include "include/proxy/membership_db.hpp"
 #include "include/proxy/timers_values.hpp"
+#include "include/proxy/proxy_snapshot.hpp"
 
 #include <functional>
 #include <string>
 #include <memory>
 #include <functional>
+#include <set>
+#include <map>
+#include <vector>
+#include <atomic>
 
 class timing;
 class sender;
 class worker;
+struct querier_query_msg;
+
+/**
+ * @brief Sources of a group whose source timers end within this time (in milliseconds) share one source timer.
+ */
+#define QUERIER_SOURCE_TIMER_BUCKET 1000
 
 /**
  * @brief Callback function to publish querier state change informations.
  * The callback function informs about the involved interface index, group address and the involved multicast sources.
  */
-using callback_querier_state_change = std::function<void(unsigned int, const addr_storage&)>;
+using callback_querier_state_change = std::function<void(unsigned int, const mc_addr&)>;
 
 /**
  * @brief Defines the behaviour of a multicast querier for a specific interface.
@@ -47,7 +58,7 @@ using callback_querier_state_change = std::function<void(unsigned int, const add
 class querier
 {
 private:
-    worker* const m_msg_worker;
+    const worker* const m_msg_worker;
     const unsigned int m_if_index;
     membership_db m_db;
     timers_values m_timers_values;
@@ -56,32 +67,99 @@ private:
     const std::shared_ptr<const sender> m_sender;
     const std::shared_ptr<timing> m_timing;
 
+    //sends the general queries and joins the router groups, false for the further group slices of a downstream
+    const bool m_owns_interface;
+
+    //the general queries are sent at phase + n * query interval, set by the query scheduler of the proxy instance
+    bool m_has_general_query_phase;
+    std::chrono::steady_clock::time_point m_general_query_phase;
+    bool m_is_startup_timer; //the pending general query timer runs with the startup query interval
+
+    //queries of the current message batch, sent once per group address by flush_queries()
+    struct pending_query {
+        bool m_group; //multicast address specific query
+        bool m_sources; //multicast address and source specific query
+    };
+    std::map<mc_addr, pending_query> m_pending_queries;
+
+    //limits of the downstream, the usage is shared by the queriers of all group slices of the downstream
+    membership_limits m_limits;
+    const std::shared_ptr<downstream_usage> m_usage;
+    membership_size m_size; //state of this querier
+
+    //the downstream has a single listener, a leave removes the group or the sources without last listener queries
+    bool m_fast_leave;
+
+    //address of the elected querier while this router is not the querier, its general queries restart the
+    //general query timer with the other querier present interval
+    mc_addr m_other_querier;
+
+    //changes with every state change notification, the last snapshot is reused as long as it does not change,
+    //written with the lock of the querier held and read by the proxy instance without it
+    std::atomic<unsigned long long> m_state_version;
+    std::shared_ptr<const downstream_snapshot> m_snapshot;
+
     //join all router groups or leave them
     bool router_groups_function(bool subscribe) const;
     bool send_general_query();
 
+    //time until the next general query phase, at most one query interval
+    std::chrono::milliseconds get_general_query_phase_delay() const;
+
+    //truncate the sources of a record to the limits of the downstream, false if the record has to be ignored
+    bool apply_limits(group_record_msg& gr, gaddr_map::iterator db_info_it);
+
+    //size of the state of a group, zero if the group does not exist
+    membership_size get_group_size(const mc_addr& gaddr) const;
+
+    //publish the change of the state of a group to the usage of the downstream and the metrics
+    void update_usage(const membership_size& before, const membership_size& after);
+
+    void process_record(const std::shared_ptr<group_record_msg>& gr, gaddr_map::iterator db_info_it);
+
     //
-    void receive_record_in_include_mode(mcast_addr_record_type record_type, const addr_storage& gaddr, source_list<source>& slist, gaddr_info& ginfo);
-    void receive_record_in_exclude_mode(mcast_addr_record_type record_type, const addr_storage& gaddr, source_list<source>& slist, gaddr_info& ginfo);
+    void receive_record_in_include_mode(mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>& slist, gaddr_info& ginfo);
+    void receive_record_in_exclude_mode(mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>& slist, gaddr_info& ginfo);
+
+    //add a timer to the timing and store its reminder handle in the timer
+    void add_timer(std::chrono::milliseconds delay, const std::shared_ptr<timer_msg>& timer) const;
+
+    //restart a pending timer in place, false if the timer is not pending anymore
+    bool restart_timer(std::chrono::milliseconds delay, const std::shared_ptr<timer_msg>& timer) const;
+
+    //cancel the reminder of a replaced timer if timer is its last reference
+    void cancel_unused_timer(const std::shared_ptr<timer_msg>& timer) const;
+
+    //cancel the reminders of replaced timers which are not referenced anymore
+    void cancel_unused_timers(const std::set<std::shared_ptr<timer_msg>>& timers) const;
+
+    //set the filter timer to delay, restart it in place if no source shares it
+    void set_filter_timer(const mc_addr& gaddr, gaddr_info& ginfo, std::chrono::milliseconds delay) const;
 
     //RFC3810 Section 7.2.3 Definition of Souce timers
     //Updates the filter_timer to the Multicast Address Listener Interval
-    void mali(const addr_storage& gaddr, gaddr_info& ginfo) const;
+    void mali(const mc_addr& gaddr, gaddr_info& ginfo) const;
 
-    //Updates a list of source_timers to the Multicast Address Listener Interval
-    void mali(const addr_storage& gaddr, source_list<source>& slist) const;
+    //Updates a list of source_timers to the Multicast Address Listener Interval, the sources join the expiry bucket of the group
+    void mali(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist) const;
 
     //Updates specific source timers (tmp_slist) of list slist to the Multicast Address Listener Interval
-    void mali(const addr_storage& gaddr, source_list<source>& slist, source_list<source>&& tmp_slist) const;
+    void mali(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_slist) const;
 
     //Set specific source timers (tmp_slist) of list slist to the corresponding filter time
     void filter_time(gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_slist);
 
+    //the explicit tracking knows all hosts only if no older host version is present (no report suppression)
+    bool is_tracking_reliable(const gaddr_info& ginfo) const;
+
+    //expire specific source timers (tmp_slist) of list slist immediately
+    void expire_sources(const mc_addr& gaddr, source_list<source>& slist, source_list<source>&& tmp_slist) const;
+
     //send multicast address specific query
-    void send_Q(const addr_storage& gaddr, gaddr_info& ginfo);
+    void send_Q(const mc_addr& gaddr, gaddr_info& ginfo);
 
     //send multicast address and source specific and include only elements of tmp_list
-    void send_Q(const addr_storage& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_list, bool in_retransmission_state = false);
+    void send_Q(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_list, bool in_retransmission_state = false);
 
     void timer_triggerd_filter_timer(gaddr_map::iterator db_info_it, const std::shared_ptr<timer_msg>& msg);
     void timer_triggerd_source_timer(gaddr_map::iterator db_info_it, const std::shared_ptr<timer_msg>& msg);
@@ -91,7 +169,13 @@ private:
     void timer_triggerd_general_query_timer(const std::shared_ptr<timer_msg>& msg);
 
     //call the callback function querier_state_change
-    void state_change_notification(const addr_storage& gaddr);
+    void state_change_notification(const mc_addr& gaddr);
+
+    //change the querier role, only the querier forwards the groups, so the state of all groups changes
+    void set_querier(bool is_querier);
+
+    //versions are unique over all queriers, a deleted and recreated group never gets an old version again
+    static unsigned long long next_group_version();
 
 public:
     virtual ~querier();
@@ -104,8 +188,12 @@ public:
      * @param shared_timing Stores and triggers all time-dependent events for this querier.
      * @param tv contain all nessesary timers and values.
      * @param cb_state_change Callback function to publish querier state change informations.
+     * @param explicit_tracking Track the state of each reporting host and skip the last listener queries if the last host leaves.
+     * @param owns_interface If false the querier maintains only a slice of the groups of the interface and another querier sends the general queries.
+     * @param limits Limits of the groups and sources of the interface.
+     * @param usage Groups and sources of the interface, shared by the queriers of all group slices (nullptr if the querier maintains all groups).
      */
-    querier(worker* msg_worker, group_mem_protocol querier_version_mode, int if_index, const std::shared_ptr<const sender>& sender, const std::shared_ptr<timing>& timing, const timers_values& tv, callback_querier_state_change cb_state_change);
+    querier(const worker* msg_worker, group_mem_protocol querier_version_mode, int if_index, const std::shared_ptr<const sender>& sender, const std::shared_ptr<timing>& timing, const timers_values& tv, callback_querier_state_change cb_state_change, bool explicit_tracking = false, bool owns_interface = true, const membership_limits& limits = membership_limits(), const std::shared_ptr<downstream_usage>& usage = nullptr);
 
     /**
      * @brief All received group records of the interface maintained by this querier musst be submitted to this function. 
@@ -113,13 +201,29 @@ public:
      */
     void receive_record(const std::shared_ptr<proxy_msg>& msg);
 
+    /**
+     * @brief Submit the queries of routers with a lower address than this interface (querier election).
+     *        A general query makes this querier a non-querier until the other querier present interval
+     *        passes without a general query, it keeps the memberships up to date but sends no queries.
+     *        A multicast address specific query of the querier lowers the filter timer of the group
+     *        (RFC 3376 6.6.1, RFC 3810 7.6.1).
+     * @param msg the received query
+     */
+    void receive_query(const std::shared_ptr<querier_query_msg>& msg);
+
     /**
      * @brief all timer events orderd by this querier musst be submitted to this function. 
      * @param msg the timer event 
      */
     void timer_triggerd(const std::shared_ptr<proxy_msg>& msg);
 
-    //bool suggest_to_forward_traffic(const addr_storage& gaddr, const addr_storage& saddr, mc_filter* filter_mode = nullptr, source_list<source>* slist = nullptr) const; //4.2.  Per-Interface State (merge your own multicast state)
+    /**
+     * @brief Process timer events that expired together.
+     * @param msgs the timer events, their only reference should be held by this list
+     */
+    void timer_triggerd(const std::vector<std::shared_ptr<proxy_msg>>& msgs);
+
+    //bool suggest_to_forward_traffic(const mc_addr& gaddr, const mc_addr& saddr, mc_filter* filter_mode = nullptr, source_list<source>* slist = nullptr) const; //4.2.  Per-Interface State (merge your own multicast state)
     /**
      * @brief RFC 3810 Section 7.3. MLDv2 Source Specific Forwarding Rules 
      * A querier can make suggestions to forward traffic to its maintained interface. 
@@ -128,18 +232,82 @@ public:
      * @param interface_filter_fun If the filter function is false the interface will be not added to rt_slist
      * If the querier suggest to forward traffic of the group address gaddr and the source it adds its own interface to the return list.
      */
-    void suggest_to_forward_traffic(const addr_storage& gaddr, std::list<std::pair<source, std::list<unsigned int>>>& rt_slist, std::function<bool(const addr_storage&)> interface_filter_fun) const;
+    void suggest_to_forward_traffic(const mc_addr& gaddr, std::list<std::pair<source, std::list<unsigned int>>>& rt_slist, std::function<bool(const mc_addr&)> interface_filter_fun) const;
+
+    /**
+     * @brief Return true if the querier makes the same forwarding suggestion for all sources of gaddr.
+     * @param forward returns true if the traffic of all sources of gaddr is suggested to forward, false if none
+     */
+    bool is_source_independent(const mc_addr& gaddr, bool& forward) const;
+
+    /**
+     * @brief Send the multicast address (and source) specific queries collected while processing the last message batch.
+     *        The queries of one group address are merged, the source lists are packed into as few packets as possible.
+     */
+    void flush_queries();
+
+    /**
+     * @brief Send the general queries after the startup queries at phase + n * query interval. A pending general
+     *        query is moved only to an earlier time, so the distance between two queries never exceeds the query interval.
+     */
+    void set_general_query_phase(std::chrono::steady_clock::time_point phase);
+
+    /**
+     * @brief Send the startup queries again, e.g. after the link of the interface has been down.
+     */
+    bool restart_startup_queries();
+
+    /**
+     * @brief The forwarding suggestions for the group address gaddr change only if this version changes.
+     * @return 0 if the querier suggests to forward no traffic of gaddr, otherwise the version of the group
+     */
+    unsigned long long get_group_version(const mc_addr& gaddr) const;
+
+    /**
+     * @brief Return an immutable copy of the membership state. The snapshot is rebuilt only after
+     *        a state change, the snapshots of unchanged groups are shared with the previous one.
+     */
+    std::shared_ptr<const downstream_snapshot> get_snapshot();
+
+    /**
+     * @brief Return the state version of the next snapshot, can be called without the lock of the querier.
+     *        The snapshot has not changed as long as the version is the one of the last snapshot.
+     */
+    unsigned long long get_state_version() const;
+
+    /**
+     * @brief Restore the membership of a group from a checkpoint written elapsed time ago. The timers start with the
+     *        Multicast Address Listening Interval reduced by elapsed, at most the time they had left at the checkpoint.
+     *        Nothing is restored if the group exists or its state would have expired.
+     * @return true if the group was restored, the state change is not notified and has to be published by the caller
+     */
+    bool restore_group(const group_snapshot& g, std::chrono::milliseconds elapsed);
 
     /**
      * @return return all group membership information of group address gaddr
      */
-    std::pair<mc_filter, source_list<source>> get_group_membership_infos(const addr_storage& gaddr);
+    std::pair<mc_filter, source_list<source>> get_group_membership_infos(const mc_addr& gaddr);
 
     /**
      * @brief Roadworks
      */
     void receive_query();
 
+    /**
+     * @brief Replace the limits of the interface, the existing state is kept even if it exceeds the new limits.
+     */
+    void set_limits(const membership_limits& limits);
+
+    /**
+     * @brief Remove left groups and sources immediately instead of sending last listener queries.
+     */
+    void set_fast_leave(bool fast_leave);
+
+    /**
+     * @return size and estimated memory of the membership state of this querier
+     */
+    const membership_size& get_size() const;
+
     /**
      * @return return the timers and counter values for a modification
      */
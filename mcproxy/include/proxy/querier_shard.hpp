@@ -0,0 +1,114 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_proxy_instance Proxy Instance
+ * @{
+ */
+
+#ifndef QUERIER_SHARD_HPP
+#define QUERIER_SHARD_HPP
+
+#include "include/proxy/worker.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <tuple>
+#include <chrono>
+
+#define QUERIER_SHARD_BATCH_SIZE 256 //maximum number of messages processed at once
+
+class proxy_instance;
+class querier;
+class sender;
+class event_trace;
+
+/**
+ * @brief Worker thread that processes the group records and timers of a part of the
+ *        downstream queriers of a proxy instance. The proxy instance owns the queriers and
+ *        stays the coordinator that recalculates the routing.
+ */
+class querier_shard : public worker
+{
+private:
+    proxy_instance* const m_coordinator;
+    const std::shared_ptr<const sender> m_sender;
+
+    //records the input events of this shard, nullptr if disabled
+    const std::shared_ptr<event_trace> m_event_trace;
+
+    //guards m_queriers and the state of the queriers
+    mutable std::mutex m_lock;
+    std::map<unsigned int, querier*> m_queriers;
+
+    //state changes of the current batch (interface index, group address) and the receive time of their group record,
+    //posted to the coordinator without m_lock held
+    std::vector<std::tuple<unsigned int, mc_addr, std::chrono::steady_clock::time_point>> m_state_changes;
+
+    void worker_thread() override;
+
+    //m_lock has to be locked
+    void handle_msg(const std::shared_ptr<proxy_msg>& msg);
+    void handle_timer_batch(const std::shared_ptr<timer_batch_msg>& msg);
+
+    void post_state_changes();
+
+public:
+    /**
+     * @param coordinator proxy instance that receives the state changes of the queriers
+     * @param sender sender of the queriers, flushed after each batch of messages
+     * @param trace records the input events of this shard, nullptr if disabled
+     */
+    querier_shard(proxy_instance* coordinator, const std::shared_ptr<const sender>& sender, const std::shared_ptr<event_trace>& trace = nullptr);
+
+    /**
+     * @brief Stop and join the worker thread.
+     */
+    virtual ~querier_shard();
+
+    /**
+     * @brief Stop and join the worker thread, afterwards the shard arms no more timers.
+     */
+    void shutdown();
+
+    /**
+     * @brief Lock to access the queriers of this shard from an other thread.
+     */
+    std::mutex& get_lock() const;
+
+    /**
+     * @brief Add or delete a querier, the lock has to be locked.
+     */
+    void add_querier(unsigned int if_index, querier* q);
+    void del_querier(unsigned int if_index);
+
+    /**
+     * @brief Callback of the queriers, called by the worker thread with the lock held.
+     */
+    void querier_state_change(unsigned int if_index, const mc_addr& gaddr);
+};
+
+#endif // QUERIER_SHARD_HPP
+/** @} */
@@ -36,19 +36,57 @@
 #include "include/proxy/interfaces.hpp"
 #include "include/proxy/message_format.hpp"
 #include "include/proxy/def.hpp"
+#include "include/proxy/receiver_io.hpp"
 
 #include <set>
-#include <thread>
+#include <map>
+#include <tuple>
 #include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <chrono>
 #include <memory>
 #include <sstream>
 
+#include <sys/socket.h>
+#include <linux/filter.h>
+
 class proxy_instance;
+class worker;
+
+/**
+ * @brief Maximum number of packets received with one system call.
+ */
+#define RECEIVER_BATCH_SIZE 32
+
+/**
+ * @brief Maximum number of relevant interfaces checked by the socket filter, beyond that
+ *        the filter accepts the packets of all interfaces (relative BPF jumps are limited to 255).
+ */
+#define RECEIVER_FILTER_MAX_INTERFACES 200
+
+/**
+ * @brief Time window in which identical current state records of an interface are
+ *        forwarded only once to the querier (e.g. the answers of all hosts to a general query).
+ */
+#define RECEIVER_DEDUP_WINDOW_MSEC 1000
+
+/**
+ * @brief Time a kernel upcall of a new source is pending, repeated upcalls of the same source
+ *        are dropped until the proxy instance has programmed its route or the time has expired.
+ */
+#define RECEIVER_UPCALL_HOLD_MSEC 1000
+
+/**
+ * @brief Maximum number of kernel upcalls per second and interface forwarded to the proxy instance.
+ */
+#define RECEIVER_UPCALL_RATE 500
 
 /**
- * @brief Receive timout set to have not a blocking receive funktion.
+ * @brief Number of kernel upcalls of an interface that can exceed RECEIVER_UPCALL_RATE at once.
  */
-#define RECEIVER_RECV_TIMEOUT 100 //msec
+#define RECEIVER_UPCALL_BURST 100
 
 /**
  * @brief Abstract basic receiver class.
@@ -59,16 +97,90 @@ private:
 
     bool m_running;
     bool m_in_debug_testing_mode;
-    std::unique_ptr<std::thread> m_thread;
 
+    //shared thread that waits for the socket and calls receive_batch()
+    std::shared_ptr<receiver_io> m_io;
+
+    //relevant interfaces, changed under m_data_lock and published as an immutable bitmap for the packet processing
     std::set<unsigned int> m_relevant_if_index;
 
-    void worker_thread();
+    struct if_index_bitmap {
+        std::vector<uint64_t> m_bits;
 
-    std::mutex m_data_lock;
+        bool contains(unsigned int if_index) const {
+            return if_index / 64 < m_bits.size() && (m_bits[if_index / 64] & (uint64_t(1) << (if_index % 64))) != 0;
+        }
+    };
 
-    void stop();
-    void join();
+    std::atomic<const if_index_bitmap*> m_relevant_if_bitmap;
+    std::atomic<const if_index_bitmap*> m_relevant_if_bitmap_in_use; //hazard pointer of the receiving thread
+    std::vector<const if_index_bitmap*> m_retired_if_bitmaps; //m_data_lock has to be locked
+    const if_index_bitmap* m_batch_if_bitmap; //bitmap of the current batch, only used by the receiving thread
+
+    //build a new bitmap from m_relevant_if_index and free the retired ones that are no longer in use, m_data_lock has to be locked
+    void publish_relevant_if_bitmap();
+
+    //protect the current bitmap for the packets of a batch
+    void acquire_relevant_if_bitmap();
+    void release_relevant_if_bitmap();
+
+    //ring of msgs, one iov and control buffer per packet
+    std::unique_ptr<unsigned char[]> m_iov_buf;
+    std::unique_ptr<unsigned char[]> m_ctrl_buf;
+    struct iovec m_iov[RECEIVER_BATCH_SIZE];
+    struct mmsghdr m_msgs[RECEIVER_BATCH_SIZE];
+    struct sockaddr_storage m_names[RECEIVER_BATCH_SIZE]; //source addresses of the packets
+
+    void init_msgs();
+    void receive_batch();
+
+    //receive time of the current batch, the origin of its group records
+    std::chrono::steady_clock::time_point m_receive_time;
+
+    //add a message to a worker, in debug testing mode wait for a full job queue instead of dropping the message
+    void deliver(const worker* target, const std::shared_ptr<proxy_msg>& msg) const;
+
+    //regenerate the socket filter for m_relevant_if_index, m_data_lock has to be locked
+    void update_socket_filter();
+
+    //last forwarded current state record per interface, group address and host (only with explicit tracking, otherwise empty)
+    struct dedup_entry {
+        std::chrono::steady_clock::time_point m_time;
+        mcast_addr_record_type m_record_type;
+        group_mem_protocol m_grp_mem_proto;
+        unsigned long long m_slist_hash;
+    };
+
+    std::map<std::tuple<unsigned int, mc_addr, mc_addr>, dedup_entry> m_dedup_cache;
+    std::chrono::steady_clock::time_point m_dedup_last_purge;
+    unsigned long long m_dedup_suppressed;
+
+    //only used by the receiving thread
+    bool is_duplicate_record(unsigned int if_index, mcast_addr_record_type record_type, const mc_addr& gaddr, const source_list<source>& slist, group_mem_protocol grp_mem_proto, const mc_addr& host);
+    void purge_dedup_cache(const std::chrono::steady_clock::time_point& now);
+
+    static unsigned long long hash_slist(const source_list<source>& slist);
+
+    //new sources sent to the proxy instance and not yet resolved (interface index, group address, source address)
+    std::map<std::tuple<unsigned int, mc_addr, mc_addr>, std::chrono::steady_clock::time_point> m_pending_sources;
+    std::chrono::steady_clock::time_point m_pending_last_purge;
+    unsigned long long m_upcall_duplicates;
+
+    //token bucket of the kernel upcalls per interface
+    struct upcall_limit {
+        double m_tokens;
+        std::chrono::steady_clock::time_point m_time;
+        unsigned long long m_rate_limited;
+    };
+
+    std::map<unsigned int, upcall_limit> m_upcall_limits;
+
+    //m_data_lock has to be locked
+    bool is_upcall_pending(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr, const std::chrono::steady_clock::time_point& now);
+    bool is_upcall_rate_limited(unsigned int if_index, const std::chrono::steady_clock::time_point& now);
+
+    //protects the relevant interfaces and the pending upcalls, which are changed by the proxy instance
+    std::mutex m_data_lock;
 
 protected:
     const proxy_instance * const m_proxy_instance;
@@ -81,6 +193,11 @@ protected:
 
     void start();
 
+    /**
+     * @brief Stop receiving, has to be called by the destructor of the derived class.
+     */
+    void stop();
+
     bool is_if_index_relevant(unsigned int if_index) const;
 
     /**
@@ -95,11 +212,53 @@ protected:
 
     /**
      * @brief Analyze the received packet and send a message to the relevant proxy instance.
+     *        Called by the receiving thread without a lock.
      * @param msg received message
      * @param info_size received information size
      */
     virtual void analyse_packet(struct msghdr* msg, int info_size) = 0;
 
+    /**
+     * @brief Send a received group record of the host to the querier of the interface. Current state records
+     *        that repeat the last record of the group and host within RECEIVER_DEDUP_WINDOW_MSEC are dropped.
+     *        Called by the receiving thread.
+     */
+    void send_record(unsigned int if_index, mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>&& slist, group_mem_protocol grp_mem_proto, const mc_addr& host);
+
+    /**
+     * @brief Send a new source reported by the kernel to the proxy instance. Upcalls of a source that is
+     *        still pending and upcalls exceeding RECEIVER_UPCALL_RATE of the interface are dropped.
+     *        Called by the receiving thread.
+     */
+    void send_new_source(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr);
+
+    /**
+     * @brief Send a query received on if_index to the proxy instance (native upstream reports only),
+     *        gaddr is unspecified for a general query.
+     */
+    void send_upstream_query(unsigned int if_index, const mc_addr& gaddr, const std::chrono::milliseconds& max_resp_time);
+
+    /**
+     * @brief Send a query of another router received on if_index to the proxy instance for the querier election,
+     *        gaddr is unspecified for a general query. Only the queries of routers with a lower address than
+     *        the interface are sent, the others do not change the election.
+     */
+    void send_querier_query(unsigned int if_index, const mc_addr& querier, const mc_addr& gaddr, bool suppress);
+
+    /**
+     * @brief Jump targets of the socket filter, can be used as jt or jf and are resolved by the receiver.
+     */
+    enum socket_filter_label {
+        FILTER_CHECK_INTERFACE = 253, //accept if the packet arrived on a relevant interface
+        FILTER_DROP = 254,
+        FILTER_ACCEPT = 255
+    };
+
+    /**
+     * @brief Get the protocol specific beginning of the socket filter, it has to end with a jump to a label.
+     */
+    virtual void get_socket_filter(std::vector<struct sock_filter>& filter) = 0;
+
 public:
     /**
       * @brief Create a receiver.
@@ -126,6 +285,20 @@ public:
      */
     void del_interface(unsigned int if_index);
 
+    /**
+     * @brief Release a pending new source after the proxy instance has processed it,
+     *        following upcalls of this source are sent again.
+     */
+    void release_source(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr);
+
+    /**
+     * @brief Analyse a packet that was not received on the socket (e.g. read from a capture file)
+     *        like a received one, only in debug testing mode.
+     * @param msg packet in the format of the socket, the interface can be set by a packet info control message
+     * @param info_size size of the packet
+     */
+    void inject_packet(struct msghdr* msg, int info_size);
+
     /**
      * @brief Check whether the receiver is running.
      */
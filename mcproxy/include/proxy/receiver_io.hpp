@@ -0,0 +1,94 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_receiver Receiver
+ * @{
+ */
+
+#ifndef RECEIVER_IO_HPP
+#define RECEIVER_IO_HPP
+
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <functional>
+
+#define RECEIVER_IO_MAX_EVENTS 32
+
+/**
+ * @brief One I/O thread serves the raw sockets of all receivers. It sleeps in
+ *        epoll_wait until a socket is readable or the eventfd wakes it up to stop.
+ */
+class receiver_io
+{
+private:
+    bool m_running;
+    std::unique_ptr<std::thread> m_thread;
+    void worker_thread();
+
+    //the handlers are called with m_lock held, so a deleted socket is never served afterwards
+    std::mutex m_lock;
+    std::map<int, std::function<void()>> m_handlers;
+
+    int m_event_fd;
+    int m_epoll_fd;
+
+    void init_fds();
+    void close_fds();
+
+    void start();
+    void stop();
+    void join() const;
+
+    receiver_io(const receiver_io&) = delete;
+    receiver_io& operator=(const receiver_io&) = delete;
+
+public:
+    receiver_io();
+
+    /**
+     * @brief Return the I/O thread shared by all receivers, it runs as long as a receiver holds it.
+     */
+    static std::shared_ptr<receiver_io> get_instance();
+
+    /**
+     * @brief Call handler in the I/O thread whenever the socket sock is readable.
+     * @return Return true on success.
+     */
+    bool add_socket(int sock, const std::function<void()>& handler);
+
+    /**
+     * @brief Stop serving a socket, its handler is not running anymore after the return.
+     * @return Return true on success.
+     */
+    bool del_socket(int sock);
+
+    /**
+     * @brief Release all resources.
+     */
+    virtual ~receiver_io();
+};
+
+#endif // RECEIVER_IO_HPP
+/** @} */
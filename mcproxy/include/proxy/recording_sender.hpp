@@ -0,0 +1,89 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+/**
+ * @addtogroup mod_sender Sender
+ * @{
+ */
+
+#ifndef RECORDING_SENDER_HPP
+#define RECORDING_SENDER_HPP
+
+#include "include/proxy/sender.hpp"
+
+#include <atomic>
+
+/**
+ * @brief Sender without a socket, counts the reports and queries instead of sending them
+ *        (e.g. for the pcap replay and the scale suite).
+ */
+class recording_sender : public sender
+{
+public:
+    mutable std::atomic<unsigned long long> m_records;
+    mutable std::atomic<unsigned long long> m_general_queries;
+    mutable std::atomic<unsigned long long> m_group_queries;
+    mutable std::atomic<unsigned long long> m_source_queries;
+
+    recording_sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp)
+        : sender(interfaces, gmp, false, false)
+        , m_records(0)
+        , m_general_queries(0)
+        , m_group_queries(0)
+        , m_source_queries(0) {
+    }
+
+    bool send_record(unsigned int, mc_filter, const addr_storage&, const source_list<source>&) const override {
+        ++m_records;
+        return true;
+    }
+
+    bool send_general_query(unsigned int, const timers_values&) const override {
+        ++m_general_queries;
+        return true;
+    }
+
+    bool send_mc_addr_specific_query(unsigned int, const timers_values&, const addr_storage&, bool) const override {
+        ++m_group_queries;
+        return true;
+    }
+
+    //counts down the retransmissions of the sources like the igmp_sender and the mld_sender
+    bool send_mc_addr_and_src_specific_query(unsigned int, const timers_values&, const addr_storage&, source_list<source>& slist) const override {
+        bool is_sent = false;
+        bool rc = false;
+        for (auto & e : slist) {
+            if (e.retransmission_count > 0) {
+                e.retransmission_count--;
+                is_sent = true;
+                rc = rc || e.retransmission_count > 0;
+            }
+        }
+
+        if (is_sent) {
+            ++m_source_queries;
+        }
+        return rc;
+    }
+};
+
+#endif // RECORDING_SENDER_HPP
+/** @} */
@@ -0,0 +1,125 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef REPORT_PACER_HPP
+#define REPORT_PACER_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+
+class sender;
+struct source;
+
+/**
+ * @brief Settings of the upstream report pacing (option -u).
+ */
+struct report_pacing {
+    std::chrono::milliseconds interval = std::chrono::milliseconds(0); //changes of a group within the interval are merged
+    unsigned int rate = 0; //records per second and upstream, 0 is unlimited
+
+    bool is_enabled() const {
+        return interval.count() > 0 || rate > 0;
+    }
+
+    /**
+     * @brief Parse <interval msec>[:<records per second>].
+     * @return false if the setting is invalid
+     */
+    bool parse(const std::string& arg);
+};
+
+/**
+ * @brief Paces the upstream records of a proxy instance. The changes of a group are merged over
+ *        the pacing interval and sent in the order of their first change, each upstream sends at
+ *        most rate records per second (token bucket with a burst of one second). The first join
+ *        of a group on an upstream is sent immediately, a change that is reverted within the interval
+ *        is not sent at all.
+ */
+class report_pacer
+{
+private:
+    using key = std::pair<unsigned int, mc_addr>; //upstream if_index, group address
+
+    struct upstream_budget {
+        double m_tokens;
+        std::chrono::steady_clock::time_point m_last_refill;
+    };
+
+    const std::shared_ptr<const sender> m_sender;
+    const report_pacing m_pacing;
+
+    struct pending_record {
+        std::chrono::steady_clock::time_point m_due; //first change + interval
+        mc_filter m_filter_mode;
+        source_list<source> m_slist;
+    };
+
+    //latest state per group and the groups in the order of their first change, the order
+    //may contain outdated entries, they are valid only if the due time matches the record
+    std::map<key, pending_record> m_pending;
+    std::deque<std::pair<std::chrono::steady_clock::time_point, key>> m_order;
+
+    //last state sent of the groups with a membership
+    std::map<key, std::pair<mc_filter, source_list<source>>> m_reported;
+
+    std::map<unsigned int, upstream_budget> m_budgets;
+
+    unsigned long long m_merged_records;
+    unsigned long long m_urgent_records;
+
+    upstream_budget& refill(unsigned int if_index, const std::chrono::steady_clock::time_point& now);
+    void send(const key& k, mc_filter filter_mode, const source_list<source>& slist);
+
+public:
+    report_pacer(const std::shared_ptr<const sender>& snd, const report_pacing& pacing);
+
+    /**
+     * @brief Send the record now if it is the first join of the group, otherwise queue it until the next flush().
+     *        A record of the state that was sent last drops the queued record of the group.
+     */
+    void send_record(unsigned int if_index, mc_filter filter_mode, const mc_addr& gaddr, const source_list<source>& slist);
+
+    /**
+     * @brief Send the queued records the budgets of the upstreams allow.
+     * @return delay until the next flush, zero if nothing is queued
+     */
+    std::chrono::milliseconds flush();
+
+    bool has_pending() const;
+
+    const report_pacing& get_pacing() const;
+
+    /**
+     * @brief Forget the queued and reported groups of an upstream that is deleted.
+     */
+    void del_upstream(unsigned int if_index);
+
+    std::string to_string() const;
+};
+
+#endif // REPORT_PACER_HPP
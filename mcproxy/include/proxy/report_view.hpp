@@ -0,0 +1,158 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_receiver Receiver
+ * @{
+ */
+
+#ifndef REPORT_VIEW_HPP
+#define REPORT_VIEW_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/proxy/message_format.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+#include <arpa/inet.h>
+
+/**
+ * @brief Read-only view of the multicast address records of an IGMPv3 or MLDv2 report,
+ *        the records and their sources are read in place from the receive buffer.
+ *
+ * Report and Record are the packed header structs (e.g. igmpv3_mc_report and
+ * igmpv3_mc_record), Addr is the address type (in_addr or in6_addr).
+ *
+ * The view ends with the receiver, each record is copied once into a pooled
+ * group_record_msg: the querier runs on a worker thread while the receive
+ * buffer is already reused for the next packet, and it merges the sources
+ * into its own source lists anyway.
+ */
+template<typename Report, typename Record, typename Addr>
+class report_view
+{
+private:
+    const unsigned char* m_pos;
+    const unsigned char* const m_end;
+    unsigned int m_remaining_records;
+
+    //reused to sort the sources of each record before they are inserted into a source_list
+    std::vector<Addr> m_sorted;
+
+    static bool less(const in_addr& l, const in_addr& r) {
+        return ntohl(l.s_addr) < ntohl(r.s_addr);
+    }
+
+    static bool less(const in6_addr& l, const in6_addr& r) {
+        return memcmp(l.s6_addr, r.s6_addr, sizeof(r.s6_addr)) < 0;
+    }
+
+public:
+    /**
+     * @brief A record inside the receive buffer, only valid as long as the buffer is unchanged.
+     */
+    struct record {
+        const Record* m_rec;
+        const Addr* m_srcs;
+
+        mcast_addr_record_type get_record_type() const {
+            return static_cast<mcast_addr_record_type>(m_rec->type);
+        }
+
+        addr_storage get_gaddr() const {
+            Addr gaddr;
+            memcpy(&gaddr, &m_rec->gaddr, sizeof(gaddr));
+            return addr_storage(gaddr);
+        }
+
+        unsigned int get_num_of_srcs() const {
+            return ntohs(m_rec->num_of_srcs);
+        }
+    };
+
+    /**
+     * @param report first byte of the report header
+     * @param size number of received bytes from the report header on
+     */
+    report_view(const void* report, std::size_t size)
+        : m_pos(static_cast<const unsigned char*>(report))
+        , m_end(m_pos + size)
+        , m_remaining_records(0) {
+        if (size >= sizeof(Report)) {
+            m_remaining_records = ntohs(reinterpret_cast<const Report*>(m_pos)->num_of_mc_records);
+            m_pos += sizeof(Report);
+        } else {
+            m_pos = m_end;
+        }
+    }
+
+    /**
+     * @brief Get the next record.
+     * @return false if there are no more records or the next record exceeds the received size
+     */
+    bool next(record& r) {
+        if (m_remaining_records == 0 || static_cast<std::size_t>(m_end - m_pos) < sizeof(Record)) {
+            return false;
+        }
+
+        const Record* rec = reinterpret_cast<const Record*>(m_pos);
+        std::size_t nos = ntohs(rec->num_of_srcs);
+        std::size_t rec_size = sizeof(Record) + nos * sizeof(Addr) + rec->aux_data_len * 4; //Aux Data Len in 32-bit words
+        if (static_cast<std::size_t>(m_end - m_pos) < rec_size) {
+            HC_LOG_DEBUG("record exceeds the received size");
+            m_remaining_records = 0;
+            return false;
+        }
+
+        r.m_rec = rec;
+        r.m_srcs = reinterpret_cast<const Addr*>(m_pos + sizeof(Record));
+
+        m_pos += rec_size;
+        --m_remaining_records;
+        return true;
+    }
+
+    /**
+     * @brief Fill slist with the sources of a record, sorted so each source is appended at the end of the set.
+     */
+    void get_slist(const record& r, source_list<source>& slist) {
+        unsigned int nos = r.get_num_of_srcs();
+
+        m_sorted.resize(nos);
+        if (nos > 0) {
+            memcpy(m_sorted.data(), r.m_srcs, nos * sizeof(Addr)); //the sources are not aligned
+        }
+        std::sort(std::begin(m_sorted), std::end(m_sorted), [](const Addr & l, const Addr & r) {
+            return less(l, r);
+        });
+
+        for (auto & e : m_sorted) {
+            slist.insert(std::end(slist), source(addr_storage(e)));
+        }
+    }
+};
+
+#endif // REPORT_VIEW_HPP
+/** @} */
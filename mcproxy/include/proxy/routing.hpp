@@ -31,14 +31,31 @@
 
 //#include "include/utils/mroute_socket.hpp"
 #include "include/utils/if_prop.hpp"
+#include "include/utils/mc_addr.hpp"
 
 #include <set>
 #include <list>
+#include <map>
+#include <vector>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
 
 class interfaces;
 class mroute_socket;
 class addr_storage;
+class pcap_replay;
+
+/**
+ * @brief Called by the route writer thread for each route change it has sent to the kernel.
+ * @param add true for an added route, false for a deleted one
+ * @param success false if the kernel refused the route change
+ * @param latency time between the route change and its completion
+ */
+using route_callback = std::function<void(const mc_addr& gaddr, const mc_addr& saddr, bool add, bool success, const std::chrono::steady_clock::duration& latency)>;
 
 /**
  * @brief Set and delete virtual interfaces and forwarding rules in the Linux kernel.
@@ -51,16 +68,75 @@ private:
 
     const std::shared_ptr<const interfaces> m_interfaces;
     const std::shared_ptr<const mroute_socket> m_mrt_sock;
-    if_prop m_if_prop; //return interface properties
 
     mutable std::set<unsigned int> m_added_ifs; 
 
+    //interfaces added to the virtual interfaces whose table binding is sent with the next flush_routes()
+    mutable std::list<uint32_t> m_pending_table_binds;
+
+    //bind the interfaces of m_pending_table_binds to the table in one batch, the failed ones stay queued
+    bool bind_pending_vifs() const;
+
+    //hand the queued route changes to the route writer thread
+    bool hand_over_routes() const;
+
+    //a multicast forwarding cache entry as it is installed in the kernel
+    struct mfc_entry {
+        int m_input_vif;
+        std::vector<int> m_output_vifs; //sorted
+        unsigned long long m_version; //version of the route change that set the entry
+    };
+
+    //shadow copy of the installed kernel routes (group address, source address), unchanged routes are not set again
+    mutable std::map<std::pair<mc_addr, mc_addr>, mfc_entry> m_mfc;
+    mutable unsigned long long m_route_version;
+
+    //latest route change of a route, changes are coalesced until the route writer applies them
+    struct route_change {
+        bool m_add;
+        int m_input_vif;
+        std::list<int> m_output_vif;
+        unsigned long long m_version;
+        std::chrono::steady_clock::time_point m_time; //oldest unapplied change of the route
+        bool m_new_route; //the route was not installed before the first change, a deletion cancels it
+        std::chrono::steady_clock::time_point m_origin; //receive time of the oldest group record that caused a change
+    };
+
+    typedef std::map<std::pair<mc_addr, mc_addr>, route_change> route_change_map;
+
+    //route changes of the current batch, only accessed by the calling thread
+    mutable route_change_map m_queued_changes;
+
+    //the route writer thread sends the route changes to the kernel, the other members are protected by m_writer_lock
+    std::unique_ptr<std::thread> m_writer;
+    mutable std::mutex m_writer_lock;
+    mutable std::condition_variable m_writer_cond; //new route changes or stop
+    mutable std::condition_variable m_writer_idle_cond; //all route changes applied
+    mutable route_change_map m_pending_changes;
+    mutable std::vector<std::pair<std::pair<mc_addr, mc_addr>, unsigned long long>> m_failed_changes; //route, version
+    mutable bool m_writer_busy;
+    bool m_writer_stop;
+
+    route_callback m_route_callback;
+
+    void writer_thread();
+
+    //send route changes to the kernel and call the route callback, return the refused routes
+    std::set<std::pair<mc_addr, mc_addr>> apply_route_changes(const route_change_map& changes);
+
+    //queue a route change for the next flush_routes()
+    void queue_route_change(const std::pair<mc_addr, mc_addr>& key, bool add, bool installed, int input_vif, const std::list<int>& output_vif) const;
+
+    //block until the route writer has applied all flushed route changes
+    void wait_for_routes() const;
+
 public:
     routing(int addr_family, std::shared_ptr<const mroute_socket> mrt_sock, std::shared_ptr<const interfaces> interfaces, int table_number);
 
     virtual ~routing();
     /**
-      * @brief Add a virtual interface to the linux kernel table.
+      * @brief Add a virtual interface to the linux kernel table, the interface is bound to the table
+      *        of this instance with the next flush_routes() together with the other added interfaces.
       * @return Return true on success.
       */
     bool add_vif(int if_index, int vif) const;
@@ -72,16 +148,36 @@ public:
     bool del_vif(int if_index, int vif) const;
 
     /**
-      * @brief Add a multicast route to the linux kernel table.
+      * @brief Add a multicast route to the linux kernel table with the next flush_routes(). Nothing is done if
+      *        the kernel already has the same route.
       * @return Return true on success.
       */
     bool add_route(int input_vif, const addr_storage& g_addr, const addr_storage& src_addr, const std::list<int>& output_vif) const;
 
     /**
-      * @brief Delete a multicast route from the linux kernel table.
+      * @brief Delete a multicast route from the linux kernel table with the next flush_routes(), nothing is done if the route is not installed.
       * @return Return true on success.
       */
     bool del_route(int vif, const addr_storage& g_addr, const addr_storage& src_addr) const;
+
+    /**
+      * @brief The table bindings of the added virtual interfaces are sent to the kernel in one batch and
+      *        the route changes of add_route() and del_route() are collected and handed to the route writer
+      *        thread by this function, it must be called after each processed batch of events. The route writer
+      *        sends them in batches to the kernel, only the latest change of a route is applied. The function
+      *        does not wait for the kernel.
+      * @return Return false if the kernel refused route changes of an earlier flush, the shadow copy of these
+      *         routes is discarded, or if new virtual interfaces could not be bound to the table, they are
+      *         bound again with the next flush.
+      */
+    bool flush_routes() const;
+
+    /**
+      * @brief Set the function called by the route writer thread after a route change, must be set before the first route change.
+      */
+    void set_route_callback(const route_callback& callback);
+
+    friend pcap_replay;
 };
 
 #endif // ROUTING_HPP
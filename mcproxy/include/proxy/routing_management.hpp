@@ -24,15 +24,17 @@
 #define ROUTING_MANAGEMENT_HPP
 
 #include "include/proxy/def.hpp"
+#include "include/proxy/proxy_snapshot.hpp"
+#include "include/utils/mc_addr.hpp"
 
 #include <memory>
 #include <string>
 #include <sstream>
+#include <vector>
 
 struct proxy_msg;
 struct source;
 class proxy_instance;
-class addr_storage;
 
 /**
  * @brief abstract interface of a summary of routing events 
@@ -46,9 +48,18 @@ public:
     routing_management(const proxy_instance* p): m_p(p) {}
 
     virtual void event_new_source(const std::shared_ptr<proxy_msg>& msg) = 0;
-    virtual void event_querier_state_change(unsigned int if_index, const addr_storage& gaddr) = 0;
+    virtual void event_querier_state_change(unsigned int if_index, const mc_addr& gaddr) = 0;
     virtual void timer_triggerd_maintain_routing_table(const std::shared_ptr<proxy_msg>& msg) = 0;
 
+    //the interfaces or rule bindings have changed, forget all cached filter decisions
+    virtual void event_config_change() {}
+
+    //hot groups that are or have to be joined without downstream interest, they are reevaluated after a configuration change
+    virtual std::vector<mc_addr> get_prejoined_groups() const {return {};}
+
+    //immutable copy of the known multicast sources, nullptr if not supported
+    virtual std::shared_ptr<const route_snapshot_list> get_snapshot() {return nullptr;}
+
     virtual std::string to_string() const {return std::string();}
 
     friend std::ostream& operator<<(std::ostream& stream, const routing_management& rm) {
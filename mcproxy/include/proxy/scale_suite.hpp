@@ -0,0 +1,128 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+#ifndef SCALE_SUITE_HPP
+#define SCALE_SUITE_HPP
+
+#include "include/proxy/def.hpp"
+#include "include/proxy/timing_wheel.hpp"
+#include "include/proxy/timers_values.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+#define SCALE_SUITE_DEFAULT_GROUPS 100
+#define SCALE_SUITE_DEFAULT_SOURCES 8
+#define SCALE_SUITE_DEFAULT_DOWNSTREAMS 4
+#define SCALE_SUITE_DEFAULT_ROUNDS 10
+#define SCALE_SUITE_DEFAULT_ROUND_INTERVAL 10000 //msec
+#define SCALE_SUITE_DEFAULT_SEED 1
+#define SCALE_SUITE_OLDER_VERSION_RATE 25 //one of n records is sent by a host of the older protocol version
+
+class querier;
+class timing;
+class recording_sender;
+struct source;
+
+/**
+ * @brief Settings of the scale suite, read from the argument of the option -S.
+ */
+struct scale_suite_settings {
+    group_mem_protocol version = IGMPv3;
+    unsigned int groups = SCALE_SUITE_DEFAULT_GROUPS;
+    unsigned int sources = SCALE_SUITE_DEFAULT_SOURCES;
+    unsigned int downstreams = SCALE_SUITE_DEFAULT_DOWNSTREAMS;
+    unsigned int rounds = SCALE_SUITE_DEFAULT_ROUNDS;
+    std::chrono::milliseconds round_interval = std::chrono::milliseconds(SCALE_SUITE_DEFAULT_ROUND_INTERVAL);
+    unsigned int seed = SCALE_SUITE_DEFAULT_SEED;
+};
+
+/**
+ * @brief Deterministic regression suite of the querier. Each downstream is served by one querier, the records
+ *        are passed directly to the queriers and the queries are counted by a recording sender. The timers
+ *        run on a virtual clock, which jumps to the next deadline, so hours of protocol time pass in seconds.
+ *
+ * The scripted scenarios of the former querier tests run first, then each round sends one random record
+ * (seeded) to every group of every downstream, spread over the round interval. The state of all queriers
+ * is hashed after each scenario and round. Equal digests mean equal protocol behavior, so runs with the
+ * same settings are comparable across commits by their digests, throughput and memory.
+ */
+class scale_suite
+{
+private:
+    scale_suite_settings m_settings;
+    int m_addr_family;
+
+    std::shared_ptr<timing> m_timing;
+    std::shared_ptr<recording_sender> m_sender;
+    std::vector<std::unique_ptr<querier>> m_queriers; //querier of the downstream with the interface index n is at n - 1
+    timers_values m_timers_values;
+
+    std::mt19937 m_rand;
+    timing_db_key m_start;
+
+    unsigned long long m_records;
+    unsigned long long m_timers;
+    unsigned long long m_state_changes;
+    std::chrono::steady_clock::duration m_run_time; //spent by the queriers, without hashing their state
+
+    mc_addr get_group_addr(unsigned int group) const;
+    addr_storage get_source_addr(unsigned int source) const;
+
+    void create_queriers(unsigned int count);
+    void send_record(unsigned int if_index, const mc_addr& gaddr, mcast_addr_record_type record_type, source_list<source>&& slist, group_mem_protocol gmp);
+
+    //let the virtual time pass and hand the expired timers to their queriers
+    void wait(std::chrono::milliseconds duration);
+
+    //FNV-1a hash of the state of all queriers
+    uint64_t get_digest() const;
+    std::size_t get_group_count() const;
+
+    uint64_t run_scripted_scenarios();
+    uint64_t run_random_rounds();
+
+    scale_suite(const scale_suite&) = delete;
+    scale_suite& operator=(const scale_suite&) = delete;
+
+    scale_suite(const scale_suite_settings& settings);
+
+public:
+    virtual ~scale_suite();
+
+    /**
+     * @brief Parse the settings of the suite, a comma separated list of key=value pairs with the keys
+     *        protocol (IGMPv3 or MLDv2), groups, sources, downstreams, rounds, interval (msec) and seed.
+     * @return false if the list cannot be parsed
+     */
+    static bool parse_settings(const std::string& arg, scale_suite_settings& settings);
+
+    /**
+     * @brief Run the suite and print the digests, the throughput and the memory.
+     */
+    static void run(const scale_suite_settings& settings);
+};
+
+#endif // SCALE_SUITE_HPP
@@ -34,6 +34,12 @@
 #include "include/proxy/interfaces.hpp"
 
 #include "memory"
+#include <mutex>
+#include <map>
+#include <vector>
+
+#define SENDER_DEFAULT_MTU 1280 //used if the mtu of an interface is unknown, minimum mtu of IPv6
+#define SENDER_MAX_BATCH 64 //maximum number of packets sent with one sendmmsg
 
 class timers_values;
 struct source;
@@ -49,9 +55,73 @@ protected:
 
     mroute_socket m_sock;
 
+    //packets of the queriers of all threads, sent together by flush_packets
+    struct pending_packet {
+        unsigned int m_if_index;
+        addr_storage m_dst;
+        std::vector<unsigned char> m_data;
+    };
+    mutable std::vector<pending_packet> m_pending_packets;
+    mutable std::mutex m_send_lock;
+
+    //queue a packet for the interface if_index, the ancillary data of flush_packets selects the interface
+    void queue_packet(unsigned int if_index, const addr_storage& dst, std::vector<unsigned char>&& data) const;
+
+    //number of source addresses of addr_size that fit behind a packet header of header_size into the mtu of the interface
+    unsigned int get_max_sources(unsigned int if_index, unsigned int header_size, unsigned int addr_size) const;
+
+    //last filter applied to the socket per interface index and group address (without timers),
+    //with native reports the state reported to the upstream router
+    mutable std::map<std::pair<unsigned int, addr_storage>, std::pair<mc_filter, source_list<source>>> m_socket_filters;
+    mutable std::mutex m_socket_filters_lock;
+
+    //build the upstream reports on the raw socket instead of joining the groups on the socket
+    const bool m_native_reports;
+
+    //group record of a native report
+    struct report_record {
+        unsigned int m_if_index;
+        mcast_addr_record_type m_type;
+        addr_storage m_gaddr;
+        source_list<source> m_slist;
+    };
+
+    //records queued since the last flush_packets, guarded by m_send_lock
+    mutable std::vector<report_record> m_pending_records;
+
+    //remaining retransmissions of the state changes per interface index and group address, guarded by m_socket_filters_lock
+    mutable std::map<std::pair<unsigned int, addr_storage>, unsigned int> m_retransmissions;
+
+    void queue_record(unsigned int if_index, mcast_addr_record_type type, const addr_storage& gaddr, const source_list<source>& slist) const;
+
+    //store the new reported state of gaddr and queue its state change records (RFC 3376 5.1, RFC 3810 6.1)
+    bool set_report_state(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const;
+
+    //queue the current state record of an entry of m_socket_filters, m_socket_filters_lock has to be locked
+    void queue_current_state(const std::pair<unsigned int, addr_storage>& key, const std::pair<mc_filter, source_list<source>>& state) const;
+
+    //pack the records into reports of the mtu of their interface and queue them
+    void queue_reports(std::vector<report_record>& records) const;
+
+    //size of the ip header with options and report header, of a record header and of an address of the report format
+    virtual void get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const;
+
+    //queue one report of if_index containing the records [begin, end)
+    virtual void queue_report(unsigned int if_index, std::vector<report_record>::const_iterator begin, std::vector<report_record>::const_iterator end) const;
+
+    unsigned int get_mtu(unsigned int if_index) const;
+
+    //set the socket filter of gaddr on if_index, skip it if nothing changed since the last call and
+    //apply only the changed sources if the filter mode is the same
+    bool set_socket_filter(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const;
+    bool change_socket_filter(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& from, const source_list<source>& to) const;
+
+    //without a socket for derived classes that do not send (e.g. the recording sender of the pcap replay)
+    sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp, bool native_reports, bool open_socket);
+
 public:
 
-    sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp);
+    sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp, bool native_reports = false);
 
     virtual bool send_record(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const;
 
@@ -61,6 +131,46 @@ public:
 
     virtual bool send_mc_addr_and_src_specific_query(unsigned int if_index, const timers_values& tv, const addr_storage& gaddr, source_list<source>& slist) const;
 
+    /**
+     * @brief Send all queued queries, SENDER_MAX_BATCH packets with one system call.
+     *        Has to be called after the queries of a batch of messages are generated.
+     * @return false if at least one packet could not be sent
+     */
+    bool flush_packets() const;
+
+    /**
+     * @brief Return true if the reports to the upstreams are built on the raw socket.
+     */
+    bool has_native_reports() const;
+
+    /**
+     * @brief Queue the current state records of the groups reported on if_index (native reports only),
+     *        at most max_records in the order of the group addresses and beginning after gaddr.
+     * @return true if records are left, gaddr is set to the group address of the last queued record
+     */
+    bool send_current_state(unsigned int if_index, addr_storage& gaddr, unsigned int max_records) const;
+
+    /**
+     * @brief Queue the current state record of gaddr on if_index if the group is reported (native reports only).
+     */
+    void send_current_state(unsigned int if_index, const addr_storage& gaddr) const;
+
+    /**
+     * @brief Repeat the pending state changes (native reports only) as filter mode change records of the
+     *        current state, so a lost report is repaired even if the state changed again in between.
+     */
+    void retransmit_state_changes() const;
+
+    /**
+     * @brief Return true if state changes are waiting for their retransmission.
+     */
+    bool has_retransmissions() const;
+
+    /**
+     * @brief Leave all groups joined or reported on if_index, e.g. if the interface is no longer an upstream.
+     */
+    void leave_all_groups(unsigned int if_index) const;
+
     virtual ~sender();
 };
 
@@ -26,11 +26,21 @@
 #include "include/proxy/routing_management.hpp"
 #include "include/proxy/simple_routing_data.hpp"
 #include "include/parser/interface.hpp"
+#include "include/utils/addr_hash_map.hpp"
+#include "include/utils/source_table.hpp"
 
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
 #include <memory>
 #include <chrono>
 
+#define SIMPLE_MC_PROXY_ROUTING_FILTER_CACHE_SIZE 16384 //maximum number of cached filter decisions
+#define SIMPLE_MC_PROXY_ROUTING_JOIN_DECAY 0.75 //weight of the past joins of a group after each source life time
+#define SIMPLE_MC_PROXY_ROUTING_JOIN_MIN 0.1 //decayed join counts below are forgotten
+
 struct timer_msg;
 struct source;
 struct new_source_timer_msg;
@@ -43,6 +53,42 @@ struct source_state {
     std::string to_string() const;
 };
 
+/**
+ * @brief Bounded cache of the filter decisions of the interfaces of a proxy instance,
+ *        it has to be cleared if the configuration changes.
+ */
+class filter_cache
+{
+private:
+    struct filter_key {
+        const interface* m_interface;
+        rb_interface_direction m_interface_direction;
+        unsigned int m_input_if_index;
+        mc_addr m_gaddr;
+        mc_addr m_saddr;
+
+        bool operator==(const filter_key& k) const {
+            return m_interface == k.m_interface && m_interface_direction == k.m_interface_direction && m_input_if_index == k.m_input_if_index && m_gaddr == k.m_gaddr && m_saddr == k.m_saddr;
+        }
+    };
+
+    struct filter_key_hash {
+        std::size_t operator()(const filter_key& k) const {
+            return k.m_gaddr.hash() ^ (k.m_saddr.hash() * 31) ^ (std::hash<const interface*>()(k.m_interface) * 17) ^ (k.m_input_if_index << 1) ^ k.m_interface_direction;
+        }
+    };
+
+    mutable std::unordered_map<filter_key, bool, filter_key_hash> m_decisions;
+
+public:
+    /**
+     * @brief Match the input (ID_IN) or output (ID_OUT) filter of an interface.
+     */
+    bool match(const interface& interf, rb_interface_direction interface_direction, unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+
+    void clear();
+};
+
 class interface_memberships
 {
 private:
@@ -53,14 +99,21 @@ private:
 
     void merge_membership_infos(source_state& merge_to, const source_state& merge_from) const;
 
-    void process_upstream_in_first(const addr_storage& gaddr, const proxy_instance* pi);
-    void process_upstream_in_mutex(const addr_storage& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data);
+    //the upstreams (if_index, interface) get the sources their input filters accept in the given order
+    void process_upstream_in_first(const mc_addr& gaddr, const proxy_instance* pi, const filter_cache& filters, const std::vector<std::pair<unsigned int, const interface*>>& upstreams);
+    void process_upstream_in_mutex(const mc_addr& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data, const filter_cache& filters);
 
 public:
-    interface_memberships(rb_rule_matching_type upstream_in_rule_matching_type, const addr_storage& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data);
+    interface_memberships(rb_rule_matching_type upstream_in_rule_matching_type, const mc_addr& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data, const filter_cache& filters);
 
     source_state get_group_memberships(unsigned int upstream_if_index);
 
+    /**
+     * @brief Score of an upstream for a group or an (S,G) pair (weighted rendezvous hashing), the upstream
+     *        with the highest score gets it. An upstream that is removed moves only its own share.
+     */
+    static double get_hash_score(unsigned int upstream_if_index, unsigned int weight, const mc_addr& gaddr, const mc_addr& saddr);
+
     std::string to_string() const;
 
     static void print(const state_list& sl);
@@ -72,35 +125,125 @@ public:
 class simple_mc_proxy_routing : public routing_management
 {
 private:
+    struct forwarding_verdict {
+        unsigned int m_input_if_index;
+        bool m_forward;
+    };
+
+    //forwarding suggestions of one downstream for one group, valid as long as the group version of the querier and the interface do not change
+    struct downstream_verdicts {
+        unsigned long long m_version;
+        std::shared_ptr<interface> m_interface;
+        std::map<mc_addr, forwarding_verdict> m_verdicts; //source address, verdict
+    };
+
     simple_routing_data m_data;
 
+    //the last snapshot of the sources and the version of m_data it was taken from
+    std::shared_ptr<const route_snapshot_list> m_snapshot;
+    unsigned long long m_snapshot_version;
+
+    //group address, downstream if_index, cached forwarding suggestions
+    mutable std::map<mc_addr, std::map<unsigned int, downstream_verdicts>> m_forwarding_cache;
+
+    //forget the cached suggestions of a deleted source
+    void del_forwarding_verdicts(const mc_addr& gaddr, const mc_addr& saddr);
+
     std::chrono::seconds get_source_life_time();
 
     bool is_rule_matching_type(rb_interface_type interface_type, rb_interface_direction interface_direction, rb_rule_matching_type rule_matching_type) const;
 
-    std::list<std::pair<source, std::list<unsigned int>>> collect_interested_interfaces(const addr_storage& gaddr, const source_list<source>& slist) const;
+    std::list<std::pair<source, std::list<unsigned int>>> collect_interested_interfaces(const mc_addr& gaddr, const source_list<source>& slist) const;
+
+    void set_routes(const mc_addr& gaddr, const std::list<std::pair<source, std::list<unsigned int>>>& output_if_index) const;
 
-    void set_routes(const addr_storage& gaddr, const std::list<std::pair<source, std::list<unsigned int>>>& output_if_index) const;
+    void del_route(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
 
-    void del_route(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr) const;
+    void send_record(unsigned int upstream_if_index, const mc_addr& gaddr, const source_state& sstate) const;
 
-    void send_record(unsigned int upstream_if_index, const addr_storage& gaddr, const source_state& sstate) const;
+    //(*,G) routes of the groups whose forwarding does not depend on the source (group address, upstream if_index)
+    const bool m_wildcard_routes_supported;
+    std::map<mc_addr, unsigned int> m_wildcard_routes;
 
-    std::shared_ptr<new_source_timer_msg> set_source_timer(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr);
+    //set, update or delete the (*,G) route of gaddr, upstream sources of such a group need no route of their own
+    void set_wildcard_route(const mc_addr& gaddr);
 
-    bool check_interface(rb_interface_type interface_type, rb_interface_direction interface_direction, unsigned int checking_if_index, unsigned int input_if_index, const addr_storage& gaddr, const addr_storage& saddr) const;
+    //one timer checks all sources and decays the join counts once per source life time, it runs only as long as
+    //sources or join counts exist
+    std::shared_ptr<new_source_timer_msg> m_aging_timer;
+    void start_aging_timer();
 
-    void process_membership_aggregation(rb_rule_matching_type rule_matching_type, const addr_storage& gaddr);
+    //decisions of check_interface() and interface_memberships
+    filter_cache m_filter_cache;
+
+    bool check_interface(rb_interface_type interface_type, rb_interface_direction interface_direction, unsigned int checking_if_index, unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const;
+
+    void process_membership_aggregation(rb_rule_matching_type rule_matching_type, const mc_addr& gaddr);
+
+    //number of downstreams of a group requesting (INCLUDE mode) or excluding (EXCLUDE mode) a source
+    struct source_refs {
+        unsigned int m_include;
+        unsigned int m_exclude;
+    };
+
+    //membership of all downstreams of a group merged like interface_memberships does, kept up to date by the
+    //changes of the downstreams since the last aggregation (only without filters and with rule matching first)
+    struct group_aggregate {
+        std::map<unsigned int, std::pair<unsigned long long, source_state>> m_downstreams; //if_index, group version and counted membership
+        unsigned int m_exclude_count; //downstreams in EXCLUDE mode
+        addr_hash_map<source_refs> m_sources;
+        source_state m_result;
+    };
+
+    std::map<mc_addr, group_aggregate> m_aggregates;
+    const source_state m_no_membership;
+
+    //true if the upstreams can be served from m_aggregates
+    bool is_aggregation_incremental() const;
+
+    //apply the changed downstreams to the aggregate of gaddr and return the merged membership
+    const source_state& update_aggregate(const mc_addr& gaddr);
+    void change_membership(group_aggregate& ga, const source_state& from, const source_state& to);
+    void change_source_refs(group_aggregate& ga, const source_addr& saddr, mc_filter filter_mode, int diff, bool update_result);
+    bool is_aggregated_source(const group_aggregate& ga, const source_refs& refs) const;
+    void rebuild_aggregate_result(group_aggregate& ga);
+
+    //hot groups of the upstreams (prejoin), their membership is EXCLUDE {} and their sources keep a route without
+    //output interfaces even if no downstream wants them
+    const source_state m_hot_membership;
+    std::set<mc_addr> m_prejoined; //groups reported as hot to an upstream
+
+    //joins of each group by the downstreams, counted only if an upstream prejoins the popular groups
+    std::map<mc_addr, double> m_join_counts; //decayed number of joins
+    std::map<mc_addr, std::set<unsigned int>> m_joined_downstreams; //downstreams wanting the group
+    std::map<mc_addr, unsigned int> m_popular_ranks; //most often joined groups, the most popular has the rank 0
+
+    bool is_hot(const interface* upstream, const mc_addr& gaddr) const;
+    bool is_hot(unsigned int upstream_if_index, const mc_addr& gaddr) const;
+
+    //the largest number of popular groups of an upstream, 0 if the joins are not counted
+    unsigned int get_popular_count() const;
+
+    void count_joins(const mc_addr& gaddr);
+
+    //decay the join counts and update the ranks, the groups whose rank changed are reevaluated
+    void update_popular_groups();
 
 public:
     simple_mc_proxy_routing(const proxy_instance* p);
 
     void event_new_source(const std::shared_ptr<proxy_msg>& msg) override;
 
-    void event_querier_state_change(unsigned int if_index, const addr_storage& gaddr) override;
+    void event_querier_state_change(unsigned int if_index, const mc_addr& gaddr) override;
 
     void timer_triggerd_maintain_routing_table(const std::shared_ptr<proxy_msg>& msg) override;
 
+    void event_config_change() override;
+
+    std::shared_ptr<const route_snapshot_list> get_snapshot() override;
+
+    std::vector<mc_addr> get_prejoined_groups() const override;
+
     std::string to_string() const override;
 };
 
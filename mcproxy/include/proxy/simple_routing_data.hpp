@@ -24,29 +24,30 @@
 #define SIMPLE_ROUTING_DATA_HPP
 
 #include "include/proxy/def.hpp"
+#include "include/utils/mc_addr.hpp"
+#include "include/proxy/proxy_snapshot.hpp"
 #include <map>
 #include <memory>
 #include <string>
 #include <set>
 
-class addr_storage;
 struct source;
 struct timer_msg;
 class mroute_socket;
 
 struct sr_data_value {
-    sr_data_value(const source_list<source>& slist, std::map<addr_storage, unsigned int> if_map)
+    sr_data_value(const source_list<source>& slist, std::map<mc_addr, unsigned int> if_map)
         : m_source_list(slist)
         , m_if_map(if_map) {}
 
     source_list<source> m_source_list;
 
     //source address, interface index
-    std::map<addr_storage, unsigned int> m_if_map;
+    std::map<mc_addr, unsigned int> m_if_map;
 };
 
-using s_routing_data = std::map<addr_storage, sr_data_value>;
-using s_routing_data_pair = std::pair<addr_storage,sr_data_value>;
+using s_routing_data = std::map<mc_addr, sr_data_value>;
+using s_routing_data_pair = std::pair<mc_addr, sr_data_value>;
 
 /**
  * @brief a small database for saving and maintaining multicast sources 
@@ -57,22 +58,31 @@ private:
     s_routing_data m_data;
     group_mem_protocol m_group_mem_protocol;
     const std::shared_ptr<const mroute_socket> m_mrt_sock;
-    unsigned long get_current_packet_count(const addr_storage& gaddr, const addr_storage& saddr);
+    unsigned long long m_version; //changes if a source is added or removed
+    unsigned long get_current_packet_count(const mc_addr& gaddr, const mc_addr& saddr);
 
 public:
     simple_routing_data(group_mem_protocol group_mem_protocol, const std::shared_ptr<const mroute_socket>& mrt_sock);
 
-    void set_source(unsigned int if_index, const addr_storage& gaddr, const source& saddr);
+    void set_source(unsigned int if_index, const mc_addr& gaddr, const source& saddr);
 
-    void del_source(const addr_storage& gaddr, const addr_storage& saddr);
+    void del_source(const mc_addr& gaddr, const mc_addr& saddr);
 
-    //return true if the source has been refreshed 
-    //iterator of the refrehed source
-    std::pair<source_list<source>::iterator, bool> refresh_source_or_del_it_if_unused(const addr_storage& gaddr, const addr_storage& saddr);
+    //refresh the packet counters of all sources and delete the sources which have not forwarded any packet since the last call
+    //return the deleted sources
+    route_snapshot_list refresh_sources_or_del_unused();
 
-    const source_list<source>& get_available_sources(const addr_storage& gaddr) const;
+    const source_list<source>& get_available_sources(const mc_addr& gaddr) const;
 
-    const std::map<addr_storage, unsigned int>& get_interface_map(const addr_storage& gaddr) const;
+    const std::map<mc_addr, unsigned int>& get_interface_map(const mc_addr& gaddr) const;
+
+    bool empty() const;
+
+    //the sources change only if the version changes
+    unsigned long long get_version() const;
+
+    //all sources ordered by group and source address
+    route_snapshot_list get_routes() const;
 
     std::string to_string() const;
     friend std::ostream& operator<<(std::ostream& stream, const simple_routing_data& srd); 
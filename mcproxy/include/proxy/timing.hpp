@@ -30,39 +30,76 @@
 #define TIME_HPP
 
 #include "include/proxy/message_format.hpp"
+#include "include/proxy/timing_wheel.hpp"
 
 #include <list>
 #include <thread>
 #include <memory>
-#include <condition_variable>
 #include <mutex>
 #include <chrono>
 #include <tuple>
 #include <map>
 
-#define TIMING_IDLE_POLLING_INTERVAL 1 //sec
+/**
+ * @brief Delay until the timer thread retries the reminders a full job queue did not accept.
+ */
+#define TIMING_RETRY_DELAY std::chrono::milliseconds(10)
 
 class worker;
 
-using timing_db_value = std::tuple<const worker*, std::shared_ptr<proxy_msg>>;
-using timing_db_key = std::chrono::time_point<std::chrono::steady_clock>;
-using timing_db = std::map<timing_db_key, timing_db_value>; 
-using timing_db_pair = std::pair<timing_db_key, timing_db_value>;
-
 /**
- * @brief Organizes timer events.
+ * @brief Organizes timer events. The timer thread sleeps in epoll_wait until
+ *        the timerfd expires at the next deadline or the eventfd wakes it up.
  */
 class timing
 {
 private:
-    timing_db m_db;
+    timing_wheel m_db;
+
+    //the reminders expire only by advance(), no timer thread is started
+    bool m_is_virtual;
 
     bool m_running;
     std::unique_ptr<std::thread> m_thread;
     void worker_thread();
 
     std::mutex m_global_lock;
-    std::condition_variable m_con_var;
+
+    //reminders of a worker with a timer slack are rounded up to a multiple of the slack
+    std::map<const worker*, std::chrono::milliseconds> m_slack;
+    timing_db_key apply_slack(const worker* msg_worker, const timing_db_key& until) const;
+
+    //the reminders a full job queue did not accept, delivered as one timer_batch_msg per worker before the next ones
+    std::map<const worker*, std::shared_ptr<timer_batch_msg>> m_deferred;
+
+    //deliver expired reminders without waiting for the workers, those of a worker with a timer slack
+    //or deferred reminders as one timer_batch_msg, m_global_lock has to be locked
+    void deliver(timing_wheel_bucket& expired);
+
+    int m_timer_fd;
+    int m_event_fd;
+    int m_epoll_fd;
+
+    //deadline the timerfd is armed with, only valid if m_is_armed is set
+    bool m_is_armed;
+    timing_db_key m_armed_until;
+
+    //arm the timerfd if the next deadline of m_db or the retry of the deferred reminders is earlier
+    //than the armed one, m_global_lock has to be locked
+    void arm_timer();
+
+    //arm the timerfd for a reminder just added to m_db with the deadline until, only compares it with the armed
+    //deadline instead of searching the next one, m_global_lock has to be locked
+    void arm_timer(const timing_db_key& until);
+
+    //set the timerfd to until, m_global_lock has to be locked
+    void set_timer(const timing_db_key& until);
+
+    //read the expiration counter of a file descriptor
+    void drain(int fd) const;
+
+    void init_fds();
+    void close_fds();
 
     void start();
     void stop();
@@ -74,15 +111,40 @@ private:
     timing& operator=(const timing&&) = delete;
 
 public:
-    timing();
+    /**
+     * @param virtual_clock replace the steady clock of all timers by a virtual clock (see timer_clock),
+     *        which only moves by advance(), e.g. to run timer-heavy tests faster than real time
+     */
+    explicit timing(bool virtual_clock = false);
 
     /**
      * @brief Add a new reminder with an predefined time.
      * @param msec predefined time in millisecond
      * @param proxy_instance* pointer to the owner of the reminder
      * @param pr_msg message of the reminder
+     * @return handle to cancel or reschedule the reminder
+     */
+    timer_handle add_time(std::chrono::milliseconds delay, const worker* msg_worker, const std::shared_ptr<proxy_msg>& pr_msg);
+
+    /**
+     * @brief Delete a pending reminder, its message will not be delivered.
+     * @return false if the reminder is already triggered or deleted
+     */
+    bool cancel_time(const timer_handle& handle);
+
+    /**
+     * @brief Set a new delay for a pending reminder.
+     * @return false if the reminder is already triggered or deleted
+     */
+    bool reschedule_time(const timer_handle& handle, std::chrono::milliseconds delay);
+
+    /**
+     * @brief Coalesce the reminders of a worker. Their deadlines are rounded up to a multiple
+     *        of @p slack and all reminders of the worker that expire together are delivered
+     *        as one timer_batch_msg.
+     * @param slack a slack of zero disables the coalescing
      */
-    void add_time(std::chrono::milliseconds delay, const worker* msg_worker, const std::shared_ptr<proxy_msg>& pr_msg);
+    void set_slack(const worker* msg_worker, std::chrono::milliseconds slack);
 
     /**
      * @brief Delete all reminder from a specific proxy instance.
@@ -90,6 +152,13 @@ public:
      */
     void stop_all_time(const worker* msg_worker);
 
+    /**
+     * @brief Move the virtual clock to the next deadline up to @p until and move the reminders that expire there to
+     *        @p expired instead of delivering them. Only a timing with a virtual clock can be advanced.
+     * @return false if no reminder is pending up to @p until, the virtual clock stands at @p until
+     */
+    bool advance(const timing_db_key& until, timing_wheel_bucket& expired);
+
     virtual ~timing();
     
         /**
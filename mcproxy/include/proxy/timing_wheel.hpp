@@ -0,0 +1,206 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @addtogroup mod_timer Timer
+ * @{
+ */
+
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <list>
+#include <array>
+#include <memory>
+#include <chrono>
+#include <tuple>
+#include <atomic>
+#include <cstdint>
+
+#define TIMING_WHEEL_TICK 1 //msec
+#define TIMING_WHEEL_ROOT_BITS 8
+#define TIMING_WHEEL_LEVEL_BITS 6
+#define TIMING_WHEEL_LEVELS 4 //levels above the root level
+
+#define TIMING_WHEEL_ROOT_SIZE (1 << TIMING_WHEEL_ROOT_BITS)
+#define TIMING_WHEEL_LEVEL_SIZE (1 << TIMING_WHEEL_LEVEL_BITS)
+#define TIMING_WHEEL_ROOT_MASK (TIMING_WHEEL_ROOT_SIZE - 1)
+#define TIMING_WHEEL_LEVEL_MASK (TIMING_WHEEL_LEVEL_SIZE - 1)
+#define TIMING_WHEEL_MAX_TICKS ((static_cast<std::uint64_t>(1) << (TIMING_WHEEL_ROOT_BITS + TIMING_WHEEL_LEVELS * TIMING_WHEEL_LEVEL_BITS)) - 1)
+
+class worker;
+struct proxy_msg;
+
+using timing_db_value = std::tuple<const worker*, std::shared_ptr<proxy_msg>>;
+using timing_db_key = std::chrono::time_point<std::chrono::steady_clock>;
+
+struct timing_wheel_token;
+
+/**
+ * @brief Clock of the reminders and timers. It reads the steady clock until a virtual clock is
+ *        started, which stands still until it is set (e.g. by a timing with a virtual clock).
+ */
+class timer_clock
+{
+private:
+    static std::atomic<bool> m_is_virtual;
+    static std::atomic<timing_db_key::rep> m_virtual_now; //since the epoch of the steady clock
+
+public:
+    static timing_db_key now() {
+        if (m_is_virtual.load(std::memory_order_relaxed)) {
+            return timing_db_key(timing_db_key::duration(m_virtual_now.load(std::memory_order_relaxed)));
+        } else {
+            return std::chrono::steady_clock::now();
+        }
+    }
+
+    /**
+     * @brief Replace the steady clock by a virtual clock for the rest of the process, it starts at the current time.
+     */
+    static void start_virtual();
+
+    /**
+     * @brief Set the virtual clock, it never moves backwards.
+     */
+    static void set_virtual(const timing_db_key& now);
+
+    static bool is_virtual();
+};
+
+/**
+ * @brief Handle to cancel or reschedule a reminder.
+ */
+using timer_handle = std::shared_ptr<timing_wheel_token>;
+
+/**
+ * @brief A pending reminder of the timing wheel.
+ */
+struct timing_wheel_entry {
+    timing_wheel_entry(std::uint64_t expire_tick, const timing_db_value& value, const timer_handle& token)
+        : m_expire_tick(expire_tick)
+        , m_value(value)
+        , m_token(token) {}
+
+    std::uint64_t m_expire_tick;
+    timing_db_value m_value;
+    timer_handle m_token;
+};
+
+using timing_wheel_bucket = std::list<timing_wheel_entry>;
+
+/**
+ * @brief Position of a reminder in the timing wheel, the list iterator stays valid while the reminder is moved between buckets.
+ */
+struct timing_wheel_token {
+    timing_wheel_token()
+        : m_bucket(nullptr) {}
+
+    //nullptr if the reminder expired or was canceled
+    timing_wheel_bucket* m_bucket;
+    timing_wheel_bucket::iterator m_it;
+
+    bool is_pending() const {
+        return m_bucket != nullptr;
+    }
+};
+
+/**
+ * @brief Hierarchical timing wheel (cascading, one bucket per tick on the root level).
+ *
+ * Adding, expiring, canceling and rescheduling a reminder costs O(1).
+ * Reminders with equal deadlines share a bucket and are expired in the order they were added.
+ * The wheel is not thread safe.
+ */
+class timing_wheel
+{
+private:
+    const timing_db_key m_epoch;
+
+    //the next tick to process
+    std::uint64_t m_next_tick;
+    std::size_t m_size;
+
+    std::array<timing_wheel_bucket, TIMING_WHEEL_ROOT_SIZE> m_root;
+    std::array<std::array<timing_wheel_bucket, TIMING_WHEEL_LEVEL_SIZE>, TIMING_WHEEL_LEVELS> m_levels;
+
+    timing_wheel_bucket& get_bucket(std::uint64_t& expire_tick);
+
+    //moves a reminder to the bucket of its expire tick
+    void place(timing_wheel_bucket& from, timing_wheel_bucket::iterator it);
+
+    //moves all reminders of a bucket from a higher level to a lower level, returns the bucket index
+    unsigned int cascade(unsigned int level);
+
+    std::uint64_t get_tick(const timing_db_key& time_point) const;
+    timing_db_key get_time_point(std::uint64_t tick) const;
+
+public:
+    timing_wheel();
+
+    /**
+     * @brief Add a reminder which expires at the time point @p until.
+     * @return handle to cancel or reschedule the reminder
+     */
+    timer_handle add(const timing_db_key& until, const timing_db_value& value);
+
+    /**
+     * @brief Delete a pending reminder.
+     * @return false if the reminder already expired or was canceled
+     */
+    bool cancel(const timer_handle& handle);
+
+    /**
+     * @brief Move a pending reminder to the new deadline @p until.
+     * @return false if the reminder already expired or was canceled
+     */
+    bool reschedule(const timer_handle& handle, const timing_db_key& until);
+
+    /**
+     * @brief Move all reminders that expired before or at @p now to @p expired.
+     */
+    void expire(const timing_db_key& now, timing_wheel_bucket& expired);
+
+    /**
+     * @brief Delete all reminders of a specific worker.
+     */
+    void remove(const worker* msg_worker);
+
+    /**
+     * @brief Time point at which expire() has to be called next. Reminders
+     *        of the higher levels can enforce an earlier wakeup to cascade them.
+     */
+    timing_db_key get_next_wakeup() const;
+
+    /**
+     * @brief Time point at which expire() returns a reminder added with the deadline @p until,
+     *        without searching the buckets.
+     */
+    timing_db_key get_wakeup(const timing_db_key& until) const;
+
+    bool empty() const;
+
+    std::size_t size() const;
+};
+
+#endif // TIMING_WHEEL_HPP
+/** @} */
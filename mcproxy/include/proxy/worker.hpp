@@ -30,11 +30,16 @@
 
 #include "include/proxy/message_queue.hpp"
 #include "include/proxy/message_format.hpp"
+#include "include/utils/thread_settings.hpp"
 
 #include <thread>
 #include <memory>
+#include <map>
+#include <string>
 
-#define WORKER_MESSAGE_QUEUE_DEFAULT_SIZE 150
+#define WORKER_MESSAGE_QUEUE_DEFAULT_SIZE 150 //loseable messages
+#define WORKER_MESSAGE_QUEUE_SYSTEMIC_SIZE 4096
+#define WORKER_MESSAGE_QUEUE_USER_INPUT_SIZE 64
 
 /**
  * @brief Wraps a priority job queue like a very simple actor pattern.
@@ -58,11 +63,42 @@ protected:
     /**
      * @brief Job queue to process proxy_msg.
      */
-    mutable message_queue<std::shared_ptr<proxy_msg>,comp_proxy_msg> m_job_queue;
+    mutable message_queue<std::shared_ptr<proxy_msg>, lane_proxy_msg> m_job_queue;
     void join() const;
-    void start();
+
+    /**
+     * @brief Start the worker thread with the name and the settings of its role.
+     */
+    void start(thread_role role = TR_INSTANCE, const std::string& thread_name = "mcproxy");
     void stop();
 
+    /**
+     * @brief Policy of each message type for a full job queue lane. Without an entry
+     *        loseable messages are dropped (MQ_DROP_NEWEST) and all others wait (MQ_BLOCK).
+     */
+    std::map<proxy_msg::message_type, message_queue_policy> m_queue_policies;
+
+    /**
+     * @brief Number of messages merged by the worker thread (MQ_MERGE), only accessed by the worker thread.
+     */
+    unsigned long long m_merged_msgs;
+
+    /**
+     * @brief Set the policy of a message type, must be called before the worker receives messages.
+     */
+    void set_queue_policy(proxy_msg::message_type type, message_queue_policy policy);
+    message_queue_policy get_queue_policy(const std::shared_ptr<proxy_msg>& msg) const;
+
+    /**
+     * @brief Set the maximum number of queued messages of a priority.
+     */
+    void set_queue_bound(proxy_msg::message_priority prio, unsigned int bound);
+
+    /**
+     * @brief Print the counters of the job queue.
+     */
+    std::string queue_stats_to_string() const;
+
 public:
     /**
      * @brief Create a worker with a maximum job queue size.
@@ -83,6 +119,17 @@ public:
      */
     void add_msg(const std::shared_ptr<proxy_msg>& msg) const;
 
+    /**
+     * @brief Add a message to the job queue with the given policy instead of the policy of its message type.
+     */
+    void add_msg_with_policy(const std::shared_ptr<proxy_msg>& msg, message_queue_policy policy) const;
+
+    /**
+     * @brief Add a message to the job queue without waiting (MQ_TRY).
+     * @return false if the lane of the message is full, the caller has to retry it
+     */
+    bool try_add_msg(const std::shared_ptr<proxy_msg>& msg) const;
+
     static void test_worker();
 };
 
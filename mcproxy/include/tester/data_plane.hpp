@@ -0,0 +1,157 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef DATA_PLANE_HPP
+#define DATA_PLANE_HPP
+
+#include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_socket.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define DATA_PLANE_MAGIC 0x6d637064 //"mcpd"
+#define DATA_PLANE_LATENCY_BUCKETS 100000 //one microsecond each, the last one counts all longer latencies
+#define SEQUENCE_WINDOW_SIZE 1024 //sequence numbers, a multiple of 64
+
+/**
+ * @brief Head of each packet of the data plane mode, all fields in network byte order.
+ */
+struct data_plane_header {
+    uint32_t magic;
+    uint32_t group; //index of the group, counted from the first group
+    uint64_t sequence; //per group, starts at 0
+    uint64_t send_time; //CLOCK_REALTIME in nanoseconds
+} __attribute__((packed));
+
+/**
+ * @brief Classifies the sequence numbers of one stream with a bitmap of the last
+ *        SEQUENCE_WINDOW_SIZE numbers. A number is lost if it has not been seen before it
+ *        leaves the window, the losses start at the first received number.
+ */
+class sequence_window
+{
+private:
+    std::array<uint64_t, SEQUENCE_WINDOW_SIZE / 64> m_bits;
+    bool m_is_started;
+    uint64_t m_first;
+    uint64_t m_highest;
+
+    unsigned long long m_lost; //numbers that left the window unseen
+    unsigned long long m_reordered;
+    unsigned long long m_duplicated;
+
+    bool is_set(uint64_t sequence) const;
+    void set(uint64_t sequence);
+    void clear(uint64_t sequence);
+
+public:
+    enum result {SW_NEW, SW_REORDERED, SW_DUPLICATED};
+
+    sequence_window();
+
+    result add(uint64_t sequence);
+
+    /**
+     * @brief Lost numbers including the gaps in the current window.
+     */
+    unsigned long long get_lost() const;
+    unsigned long long get_reordered() const;
+    unsigned long long get_duplicated() const;
+};
+
+/**
+ * @brief Settings of the data plane mode, read from a to do of the tester.ini.
+ */
+struct data_plane_settings {
+    std::string if_name;
+    addr_storage first_group; //groups are numbered upwards from the first group
+    unsigned int group_count = 1;
+    int port = 1234;
+    unsigned int payload_size = 64; //bytes, at least the header
+    unsigned int rate = 10000; //packets per second over all groups, 0 = as fast as possible
+    unsigned int batch = 32; //packets per sendmmsg/recvmmsg
+    unsigned long max_count = 0; //packets per group, 0 = endless
+    int ttl = 10;
+    bool print_status_msg = false;
+};
+
+/**
+ * @brief Measures the forwarding of a proxy with numbered and time stamped packets to many
+ * groups. The sender sends the groups round robin over one socket in batches at a fixed rate.
+ * The receiver joins all groups on one socket and reports per group the throughput, the loss,
+ * the reordering, the time from the join to the first packet and the one-way latency. The
+ * latency compares the send time with the receive time stamp of the kernel, so sender and
+ * receiver need synchronized clocks (e.g. the same host).
+ */
+class data_plane
+{
+private:
+    struct group_stats {
+        sequence_window window;
+        unsigned long long packets = 0;
+        unsigned long long bytes = 0;
+        std::chrono::steady_clock::time_point joined;
+        std::chrono::steady_clock::time_point first;
+        std::chrono::steady_clock::time_point last;
+        long long latency_min = 0; //nanoseconds
+        long long latency_max = 0;
+        long long latency_sum = 0;
+    };
+
+    data_plane_settings m_settings;
+    int m_addr_family;
+    const bool& m_running;
+    mc_socket m_sock;
+
+    std::vector<group_stats> m_groups;
+    std::vector<unsigned long long> m_latencies; //histogram of all groups
+    unsigned long long m_invalid;
+
+    addr_storage get_group_addr(unsigned int group) const;
+    static uint64_t get_real_time();
+
+    void receive_packet(const unsigned char* buf, unsigned int size, uint64_t receive_time, std::chrono::steady_clock::time_point now);
+    long long get_latency_percentile(double p) const;
+    void print_receive_summary() const;
+
+public:
+    /**
+     * @param running cleared by the tester on SIGINT, SIGTERM or at the end of the lifetime
+     */
+    data_plane(const data_plane_settings& settings, const bool& running);
+
+    /**
+     * @brief Send the packets and print the achieved rate.
+     */
+    void send();
+
+    /**
+     * @brief Join the groups, receive until the tester stops and print the summary.
+     */
+    void receive();
+};
+
+#endif // DATA_PLANE_HPP
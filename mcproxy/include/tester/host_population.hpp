@@ -0,0 +1,161 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef HOST_POPULATION_HPP
+#define HOST_POPULATION_HPP
+
+#include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_socket.hpp"
+#include "include/proxy/def.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum host_pattern {HP_JOIN, HP_ZAPPING, HP_LEAVE_STORM};
+
+/**
+ * @brief Settings of a host population, read from a to do of the tester.ini.
+ */
+struct host_population_settings {
+    std::string if_name;
+    group_mem_protocol version = IGMPv3;
+    addr_storage first_group; //groups are numbered upwards from the first group
+    addr_storage first_host; //spoofed host addresses are numbered upwards from the first host
+    unsigned int host_count = 1000;
+    unsigned int group_count = 100;
+    unsigned int groups_per_host = 1;
+    unsigned int rate = 1000; //reports per second, 0 = as fast as possible
+    host_pattern pattern = HP_JOIN;
+    unsigned long max_count = 0; //zaps or leave storm cycles, 0 = endless
+    std::chrono::milliseconds hold_time = std::chrono::milliseconds(5000);
+    bool answer_queries = true;
+    std::chrono::milliseconds poll_interval = std::chrono::milliseconds(10);
+    std::string source_if_name; //empty = no traffic, only routes of foreign traffic are observed
+    std::chrono::milliseconds source_interval = std::chrono::milliseconds(100);
+    int ttl = 10;
+    int port = 1234;
+    unsigned int seed = 1;
+    bool print_status_msg = false;
+};
+
+/**
+ * @brief Emulates many group members behind one interface. It sends IGMPv2/v3
+ * or MLDv1/v2 reports from spoofed host addresses over a raw socket at a
+ * fixed rate and measures how long the proxy takes to install and remove the
+ * expected multicast forwarding entries. The entries are polled from
+ * /proc/net/ip_mr_cache and /proc/net/ip6_mr_cache, which only list the
+ * default multicast routing table.
+ */
+class host_population
+{
+private:
+    struct group_state {
+        unsigned int members = 0;
+        bool observed = false; //forwarded to at least one interface at the last poll
+        bool pending = false; //members and observed disagree since changed
+        std::chrono::steady_clock::time_point changed;
+    };
+
+    host_population_settings m_settings;
+    int m_addr_family;
+    const bool& m_running;
+
+    int m_send_fd;
+    int m_query_fd;
+    mc_socket m_send_sock;
+    std::atomic<bool> m_stop;
+
+    std::mt19937 m_rand;
+    std::vector<std::vector<unsigned int>> m_host_groups; //joined groups per host
+    std::chrono::steady_clock::time_point m_next_send;
+
+    std::mutex m_lock; //m_groups and the latencies are shared with the route monitor
+    std::vector<group_state> m_groups;
+    std::vector<double> m_install_latencies; //milliseconds
+    std::vector<double> m_removal_latencies; //milliseconds
+    unsigned long m_active_groups;
+
+    //general queries, set by the query listener and served by the send loop
+    std::atomic<bool> m_query_received;
+    std::atomic<long long> m_query_max_resp; //milliseconds
+    std::chrono::steady_clock::time_point m_response_deadline;
+    unsigned int m_response_cursor; //next host to answer, host_count = idle
+
+    std::atomic<unsigned long long> m_reports_sent; //read by the route monitor for the status message
+    unsigned long long m_send_failures;
+    unsigned long long m_queries;
+    unsigned long long m_late_responses;
+
+    std::thread m_monitor_thread;
+    std::thread m_query_thread;
+    std::thread m_source_thread;
+
+    addr_storage get_host_addr(unsigned int host) const;
+    addr_storage get_group_addr(unsigned int group) const;
+    int get_group_index(const addr_storage& gaddr) const;
+
+    bool is_active() const;
+    void wait_for_send_slot();
+    void serve_queries();
+    void idle(std::chrono::milliseconds duration);
+
+    void set_members(unsigned int group, bool join);
+    void join(unsigned int host, unsigned int group);
+    void leave(unsigned int host, unsigned int group);
+    void zap(unsigned int host, unsigned int from, unsigned int to);
+    void join_all();
+    void leave_all();
+    void report_current_state(unsigned int host);
+
+    //records of one host, split into several reports if necessary
+    void send_report(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records);
+    bool send_igmp(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records);
+    bool send_mld(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records);
+
+    void monitor_routes();
+    bool read_routes(std::vector<bool>& forwarded) const;
+    void listen_queries();
+    void send_traffic();
+
+    void print_latencies(const std::string& name, std::vector<double>& latencies, unsigned long pending) const;
+
+public:
+    /**
+     * @brief Open the raw sockets of the population.
+     * @param running cleared by the tester on SIGINT, SIGTERM or at the end of the lifetime
+     */
+    host_population(const host_population_settings& settings, const bool& running);
+
+    virtual ~host_population();
+
+    /**
+     * @brief Run the configured pattern and print the summary.
+     */
+    void run();
+};
+
+#endif // HOST_POPULATION_HPP
@@ -27,20 +27,23 @@
 #include "include/utils/addr_storage.hpp"
 #include "include/proxy/def.hpp"
 #include "include/utils/mc_socket.hpp"
+#include "include/tester/data_plane.hpp"
 
 #include <memory>
 #include <list>
 #include <chrono>
 
+struct host_population_settings;
+
 #define TESTER_DEFAULT_CONIG_PATH "tester.ini"
 
+//detects duplicated packets within the last SEQUENCE_WINDOW_SIZE packet numbers
 class packet_manager
 {
 private:
-    unsigned int m_max_count;
-    std::set<long> m_data;
+    sequence_window m_window;
 public:
-    packet_manager(unsigned int max_count);     
+    packet_manager();
     bool is_packet_new(long packet_number);
 };
 
@@ -69,6 +72,8 @@ private:
     std::string get_file_name(const std::string& to_do, const std::string& proposal);
     std::string get_file_operation_mode(const std::string& to_do);
     std::string get_to_do_next(const std::string& to_do);
+    host_population_settings get_host_population_settings(const std::string& to_do, const std::string& if_name, const addr_storage& gaddr);
+    data_plane_settings get_data_plane_settings(const std::string& to_do, const std::string& if_name, const addr_storage& gaddr);
 
     void send_data(const std::unique_ptr<const mc_socket>& ms, addr_storage& gaddr, int port, int ttl, unsigned long max_count, unsigned int& current_packet_number, bool include_time_stamp, const std::chrono::milliseconds& interval, int busy_waiting_counter,  const std::string& msg, bool print_status_msg);
     void receive_data(const std::unique_ptr<const mc_socket>& ms, int port, const addr_storage& gaddr, unsigned long max_count, bool parse_time_stamp, bool print_status_msg, bool save_to_file, const std::string& file_name, bool include_file_header, bool include_data, bool include_summary, bool ignore_duplicated_packets, packet_manager& pmanager, const std::string& file_operation_mode);
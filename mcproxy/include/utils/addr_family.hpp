@@ -0,0 +1,106 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+#ifndef ADDR_FAMILY_HPP
+#define ADDR_FAMILY_HPP
+
+#include "include/utils/mc_addr.hpp"
+
+#include <cstring>
+
+#include <netinet/in.h>
+#include <linux/mroute.h>
+#include <linux/mroute6.h>
+
+/**
+ * @brief Kernel structures and constants of the IPv4 multicast routing. The routing code is written once
+ *        as a template over the family traits, each instantiation works on the fixed-size addresses of
+ *        its family without checking the address family.
+ */
+struct ipv4_family {
+    static constexpr int family = AF_INET;
+    static constexpr int level = IPPROTO_IP;
+    static constexpr int add_mfc = MRT_ADD_MFC;
+    static constexpr int del_mfc = MRT_DEL_MFC;
+    static constexpr unsigned long sg_count = SIOCGETSGCNT;
+    static constexpr unsigned int max_vifs = MAXVIFS;
+
+    using mfc_ctl = struct mfcctl;
+    using sg_req = struct sioc_sg_req;
+
+    static void set_mfc(mfc_ctl& mc, int vif_index, const mc_addr& saddr, const mc_addr& gaddr) {
+        memset(&mc, 0, sizeof(mc));
+        mc.mfcc_origin = saddr.get_in_addr();
+        mc.mfcc_mcastgrp = gaddr.get_in_addr();
+        mc.mfcc_parent = vif_index;
+    }
+
+    static void set_output_vif(mfc_ctl& mc, int vif_index, unsigned char ttl) {
+        mc.mfcc_ttls[vif_index] = ttl;
+    }
+
+    static void set_sg(sg_req& req, const mc_addr& saddr, const mc_addr& gaddr) {
+        memset(&req, 0, sizeof(req));
+        req.src = saddr.get_in_addr();
+        req.grp = gaddr.get_in_addr();
+    }
+};
+
+/**
+ * @brief Kernel structures and constants of the IPv6 multicast routing.
+ */
+struct ipv6_family {
+    static constexpr int family = AF_INET6;
+    static constexpr int level = IPPROTO_IPV6;
+    static constexpr int add_mfc = MRT6_ADD_MFC;
+    static constexpr int del_mfc = MRT6_DEL_MFC;
+    static constexpr unsigned long sg_count = SIOCGETSGCNT_IN6;
+    static constexpr unsigned int max_vifs = MAXMIFS;
+
+    using mfc_ctl = struct mf6cctl;
+    using sg_req = struct sioc_sg_req6;
+
+    static void set_mfc(mfc_ctl& mc, int vif_index, const mc_addr& saddr, const mc_addr& gaddr) {
+        memset(&mc, 0, sizeof(mc));
+        mc.mf6cc_origin.sin6_family = AF_INET6;
+        mc.mf6cc_origin.sin6_addr = saddr.get_in6_addr();
+        mc.mf6cc_mcastgrp.sin6_family = AF_INET6;
+        mc.mf6cc_mcastgrp.sin6_addr = gaddr.get_in6_addr();
+        mc.mf6cc_parent = vif_index;
+    }
+
+    //the kernel forwards to every interface of the set, there is no ttl threshold per interface
+    static void set_output_vif(mfc_ctl& mc, int vif_index, unsigned char) {
+        IF_SET(vif_index, &mc.mf6cc_ifset);
+    }
+
+    static void set_sg(sg_req& req, const mc_addr& saddr, const mc_addr& gaddr) {
+        memset(&req, 0, sizeof(req));
+        req.src.sin6_family = AF_INET6;
+        req.src.sin6_addr = saddr.get_in6_addr();
+        req.grp.sin6_family = AF_INET6;
+        req.grp.sin6_addr = gaddr.get_in6_addr();
+    }
+};
+
+#endif // ADDR_FAMILY_HPP
@@ -0,0 +1,202 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef ADDR_HASH_MAP_HPP
+#define ADDR_HASH_MAP_HPP
+
+#include "include/utils/mc_addr.hpp"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#define ADDR_HASH_MAP_MIN_SLOTS 8
+
+/**
+ * @brief Hash table with an IP address as key (open addressing, linear probing, backward shift deletion).
+ *        The values are stored densely, erase moves the last value into the gap. Insert and erase
+ *        invalidate all iterators. The order of the iteration is undefined.
+ */
+template <typename T>
+class addr_hash_map
+{
+public:
+    using value_type = std::pair<mc_addr, T>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+private:
+    struct slot {
+        uint32_t hash;
+        uint32_t pos; //position in m_values + 1, 0 marks an empty slot
+    };
+
+    std::vector<value_type> m_values;
+    std::vector<slot> m_slots; //the size is zero or a power of two
+
+    static uint32_t hash_addr(const mc_addr& addr) {
+        return addr.hash();
+    }
+
+    std::size_t mask() const {
+        return m_slots.size() - 1;
+    }
+
+    //return the slot index of the value at pos
+    std::size_t find_slot(uint32_t hash, std::size_t pos) const {
+        std::size_t i = hash & mask();
+        while (m_slots[i].pos != pos + 1) {
+            i = (i + 1) & mask();
+        }
+        return i;
+    }
+
+    void place(uint32_t hash, std::size_t pos) {
+        std::size_t i = hash & mask();
+        while (m_slots[i].pos != 0) {
+            i = (i + 1) & mask();
+        }
+        m_slots[i].hash = hash;
+        m_slots[i].pos = pos + 1;
+    }
+
+    void rehash(std::size_t slots) {
+        m_slots.assign(slots, slot{0, 0});
+        for (std::size_t i = 0; i < m_values.size(); ++i) {
+            place(hash_addr(m_values[i].first), i);
+        }
+    }
+
+public:
+    iterator begin() {
+        return m_values.begin();
+    }
+
+    iterator end() {
+        return m_values.end();
+    }
+
+    const_iterator begin() const {
+        return m_values.begin();
+    }
+
+    const_iterator end() const {
+        return m_values.end();
+    }
+
+    std::size_t size() const {
+        return m_values.size();
+    }
+
+    bool empty() const {
+        return m_values.empty();
+    }
+
+    void clear() {
+        m_values.clear();
+        m_slots.clear();
+    }
+
+    iterator find(const mc_addr& key) {
+        if (m_slots.empty()) {
+            return end();
+        }
+
+        uint32_t hash = hash_addr(key);
+        for (std::size_t i = hash & mask(); m_slots[i].pos != 0; i = (i + 1) & mask()) {
+            if (m_slots[i].hash == hash && m_values[m_slots[i].pos - 1].first == key) {
+                return begin() + (m_slots[i].pos - 1);
+            }
+        }
+
+        return end();
+    }
+
+    const_iterator find(const mc_addr& key) const {
+        return const_cast<addr_hash_map*>(this)->find(key);
+    }
+
+    /**
+     * @brief Insert the value if its key does not exist.
+     * @return iterator to the value with the key and true if the value was inserted
+     */
+    std::pair<iterator, bool> insert(value_type&& value) {
+        auto it = find(value.first);
+        if (it != end()) {
+            return std::make_pair(it, false);
+        }
+
+        //load factor of at most 0.5
+        if ((m_values.size() + 1) * 2 > m_slots.size()) {
+            rehash(m_slots.empty() ? ADDR_HASH_MAP_MIN_SLOTS : m_slots.size() * 2);
+        }
+
+        m_values.push_back(std::move(value));
+        place(hash_addr(m_values.back().first), m_values.size() - 1);
+        return std::make_pair(end() - 1, true);
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return insert(value_type(value));
+    }
+
+    /**
+     * @brief Erase the value of it.
+     * @return iterator to the value that has taken the place of the erased one
+     */
+    iterator erase(const_iterator it) {
+        std::size_t pos = it - m_values.begin();
+        std::size_t hole = find_slot(hash_addr(it->first), pos);
+
+        //backward shift, move the following values of the probe sequence into the hole if they do not pass their home slot
+        for (std::size_t i = (hole + 1) & mask(); m_slots[i].pos != 0; i = (i + 1) & mask()) {
+            std::size_t home = m_slots[i].hash & mask();
+            if (((i - home) & mask()) >= ((i - hole) & mask())) {
+                m_slots[hole] = m_slots[i];
+                hole = i;
+            }
+        }
+        m_slots[hole].pos = 0;
+
+        //fill the gap with the last value
+        std::size_t last = m_values.size() - 1;
+        if (pos != last) {
+            m_slots[find_slot(hash_addr(m_values[last].first), last)].pos = pos + 1;
+            m_values[pos] = std::move(m_values[last]);
+        }
+        m_values.pop_back();
+
+        return begin() + pos;
+    }
+
+    std::size_t erase(const mc_addr& key) {
+        auto it = find(key);
+        if (it == end()) {
+            return 0;
+        }
+
+        erase(it);
+        return 1;
+    }
+};
+
+#endif // ADDR_HASH_MAP_HPP
@@ -0,0 +1,321 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef FLAT_SET_HPP
+#define FLAT_SET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+#include <utility>
+
+/**
+ * @brief Sorted set stored in a contiguous vector. The interface follows std::set, the elements
+ *        are only accessible as const (members that do not change the order have to be mutable).
+ *        Insert and erase invalidate all iterators.
+ */
+template <typename T>
+class flat_set
+{
+public:
+    using value_type = T;
+    using key_type = T;
+    using size_type = typename std::vector<T>::size_type;
+    using const_iterator = typename std::vector<T>::const_iterator;
+    using iterator = const_iterator;
+
+private:
+    std::vector<T> m_data;
+
+    //sort and remove duplicates, the first of equal elements is kept (like std::set::insert)
+    void normalize() {
+        std::stable_sort(m_data.begin(), m_data.end());
+        m_data.erase(std::unique(m_data.begin(), m_data.end(), [](const T & l, const T & r) {
+            return !(l < r) && !(r < l);
+        }), m_data.end());
+    }
+
+public:
+    flat_set() = default;
+    flat_set(const flat_set&) = default;
+    flat_set& operator=(const flat_set&) = default;
+    flat_set(flat_set&&) = default;
+    flat_set& operator=(flat_set &&) = default;
+
+    flat_set(std::initializer_list<T> il)
+        : m_data(il) {
+        normalize();
+    }
+
+    template <typename InputIt>
+    flat_set(InputIt first, InputIt last)
+        : m_data(first, last) {
+        normalize();
+    }
+
+    const_iterator begin() const {
+        return m_data.cbegin();
+    }
+
+    const_iterator end() const {
+        return m_data.cend();
+    }
+
+    const_iterator cbegin() const {
+        return m_data.cbegin();
+    }
+
+    const_iterator cend() const {
+        return m_data.cend();
+    }
+
+    size_type size() const {
+        return m_data.size();
+    }
+
+    bool empty() const {
+        return m_data.empty();
+    }
+
+    void clear() {
+        m_data.clear();
+    }
+
+    void reserve(size_type n) {
+        m_data.reserve(n);
+    }
+
+    size_type capacity() const {
+        return m_data.capacity();
+    }
+
+    void shrink_to_fit() {
+        m_data.shrink_to_fit();
+    }
+
+    const_iterator lower_bound(const T& value) const {
+        return std::lower_bound(m_data.cbegin(), m_data.cend(), value);
+    }
+
+    const_iterator find(const T& value) const {
+        auto it = lower_bound(value);
+        if (it != end() && !(value < *it)) {
+            return it;
+        } else {
+            return end();
+        }
+    }
+
+    size_type count(const T& value) const {
+        return find(value) != end() ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const T& value) {
+        return insert(T(value));
+    }
+
+    std::pair<iterator, bool> insert(T&& value) {
+        //sorted input is appended without a search
+        if (m_data.empty() || m_data.back() < value) {
+            m_data.push_back(std::move(value));
+            return std::make_pair(end() - 1, true);
+        }
+
+        auto it = lower_bound(value);
+        if (!(value < *it)) {
+            return std::make_pair(it, false);
+        }
+
+        return std::make_pair(m_data.insert(it, std::move(value)), true);
+    }
+
+    /**
+     * @brief Insert with a hint, constant time if the value belongs directly before the hint.
+     */
+    iterator insert(const_iterator hint, const T& value) {
+        return insert(hint, T(value));
+    }
+
+    iterator insert(const_iterator hint, T&& value) {
+        if ((hint == end() || value < *hint) && (hint == begin() || *(hint - 1) < value)) {
+            return m_data.insert(hint, std::move(value));
+        } else {
+            return insert(std::move(value)).first;
+        }
+    }
+
+    template <typename InputIt>
+    void insert(InputIt first, InputIt last) {
+        unite(flat_set(first, last));
+    }
+
+    iterator erase(const_iterator pos) {
+        return m_data.erase(pos);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        return m_data.erase(first, last);
+    }
+
+    size_type erase(const T& value) {
+        auto it = find(value);
+        if (it == end()) {
+            return 0;
+        }
+
+        m_data.erase(it);
+        return 1;
+    }
+
+    /**
+     * @brief Union by merging, of equal elements the one of this set is kept.
+     */
+    flat_set& unite(const flat_set& r) {
+        if (r.empty()) {
+            return *this;
+        } else if (empty()) {
+            m_data = r.m_data;
+        } else if (m_data.back() < r.m_data.front()) {
+            m_data.insert(m_data.end(), r.m_data.begin(), r.m_data.end());
+        } else {
+            //count the new elements first, a refresh of known elements changes nothing
+            size_type added = 0;
+            auto cur_l = m_data.cbegin();
+            auto cur_r = r.m_data.cbegin();
+            while (cur_r != r.m_data.cend()) {
+                if (cur_l == m_data.cend() || *cur_r < *cur_l) {
+                    ++added;
+                    ++cur_r;
+                } else if (*cur_l < *cur_r) {
+                    ++cur_l;
+                } else {
+                    ++cur_l;
+                    ++cur_r;
+                }
+            }
+
+            if (added == 0) {
+                return *this;
+            }
+
+            //merge from the back into the grown vector, no temporary vector is allocated
+            size_type old_size = m_data.size();
+            m_data.resize(old_size + added, r.m_data.front());
+            auto w = m_data.end();
+            auto l = m_data.begin() + old_size;
+            auto rr = r.m_data.cend();
+            while (rr != r.m_data.cbegin()) {
+                if (l != m_data.begin() && *(rr - 1) < *(l - 1)) {
+                    *--w = std::move(*--l);
+                } else if (l != m_data.begin() && !(*(l - 1) < *(rr - 1))) {
+                    *--w = std::move(*--l);
+                    --rr;
+                } else {
+                    *--w = *--rr;
+                }
+            }
+        }
+
+        return *this;
+    }
+
+    flat_set& unite(flat_set&& r) {
+        if (empty()) {
+            m_data.swap(r.m_data);
+            return *this;
+        } else {
+            return unite(static_cast<const flat_set&>(r));
+        }
+    }
+
+    /**
+     * @brief Intersection in place, the elements of this set are kept.
+     */
+    flat_set& intersect(const flat_set& r) {
+        auto w = m_data.begin();
+        auto cur_l = m_data.begin();
+        auto cur_r = r.m_data.cbegin();
+
+        while (cur_l != m_data.end() && cur_r != r.m_data.cend()) {
+            if (*cur_l < *cur_r) {
+                ++cur_l;
+            } else if (*cur_r < *cur_l) {
+                ++cur_r;
+            } else {
+                if (w != cur_l) {
+                    *w = std::move(*cur_l);
+                }
+                ++w;
+                ++cur_l;
+                ++cur_r;
+            }
+        }
+
+        m_data.erase(w, m_data.end());
+        return *this;
+    }
+
+    /**
+     * @brief Difference in place, removes all elements of r.
+     */
+    flat_set& subtract(const flat_set& r) {
+        if (r.empty() || empty() || r.m_data.back() < m_data.front() || m_data.back() < r.m_data.front()) {
+            return *this;
+        }
+
+        auto cur_l = std::lower_bound(m_data.begin(), m_data.end(), r.m_data.front());
+        auto w = cur_l;
+        auto cur_r = r.m_data.cbegin();
+
+        while (cur_l != m_data.end()) {
+            if (cur_r == r.m_data.cend() || *cur_l < *cur_r) {
+                if (w != cur_l) {
+                    *w = std::move(*cur_l);
+                }
+                ++w;
+                ++cur_l;
+            } else if (*cur_r < *cur_l) {
+                ++cur_r;
+            } else {
+                ++cur_l;
+                ++cur_r;
+            }
+        }
+
+        m_data.erase(w, m_data.end());
+        return *this;
+    }
+
+    friend bool operator==(const flat_set& l, const flat_set& r) {
+        return l.m_data == r.m_data;
+    }
+
+    friend bool operator!=(const flat_set& l, const flat_set& r) {
+        return !(l == r);
+    }
+
+    friend bool operator<(const flat_set& l, const flat_set& r) {
+        return l.m_data < r.m_data;
+    }
+};
+
+#endif // FLAT_SET_HPP
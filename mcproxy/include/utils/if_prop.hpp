@@ -23,9 +23,12 @@
 #ifndef IF_PROP_NEW_HPP
 #define IF_PROP_NEW_HPP
 
+#include "include/utils/addr_storage.hpp"
+
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <ifaddrs.h>
 
 //typedef pair<struct ifaddrs*, list<struct ifaddrs*> > ipv4_6_pair;
@@ -44,6 +47,27 @@ struct ipv4_6_pair {
 typedef std::map<std::string, ipv4_6_pair > if_prop_map;
 typedef std::pair<std::string, ipv4_6_pair >if_prop_pair;
 
+//one address of an interface copied from the getifaddrs list
+struct if_addr_prop {
+    addr_storage addr;
+    addr_storage netmask;
+    addr_storage dstaddr; //peer address of a point to point interface, otherwise invalid
+};
+
+//the interface properties of one if_index copied from the getifaddrs list
+struct if_index_prop {
+    std::string name; //empty if the if_index is not used
+    unsigned int flags;
+    bool has_ip4;
+    if_addr_prop ip4; //the first ipv4 address like in if_prop_map
+    std::vector<if_addr_prop> ip6;
+
+    if_index_prop()
+        : flags(0)
+        , has_ip4(false) {
+    }
+};
+
 /**
  * @brief Prepare and organized the interface properties to a map data structure.
  */
@@ -53,6 +77,11 @@ private:
     if_prop_map m_if_map;
     struct ifaddrs* m_if_addrs;
 
+    //dense table indexed by if_index, it does not point into m_if_addrs
+    std::vector<if_index_prop> m_if_index_props;
+
+    void add_if_index_prop(unsigned int if_index, const struct ifaddrs* if_p);
+
 public:
     /**
      * @brief Create the class if_prop.
@@ -80,6 +109,25 @@ public:
      */
     const std::list<const struct ifaddrs* >* get_ip6_if(const std::string& if_name) const;
 
+    /**
+     * @brief Get the preextracted properties of an interface without a name lookup.
+     * @return Return nullptr if the if_index is unknown.
+     */
+    const if_index_prop* get_if_prop(unsigned int if_index) const {
+        if (if_index < m_if_index_props.size() && !m_if_index_props[if_index].name.empty()) {
+            return &m_if_index_props[if_index];
+        } else {
+            return nullptr;
+        }
+    }
+
+    /**
+     * @brief Return the table indexed by if_index, unused entries have an empty name.
+     */
+    const std::vector<if_index_prop>& get_if_index_props() const {
+        return m_if_index_props;
+    }
+
     /**
      * @brief Release all allocated resources.
      */
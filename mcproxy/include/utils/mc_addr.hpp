@@ -0,0 +1,173 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef MC_ADDR_HPP
+#define MC_ADDR_HPP
+
+#include "include/utils/addr_storage.hpp"
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <ostream>
+
+/**
+ * @brief Compact IPv4 or IPv6 address (20 bytes) for the keys and elements of the proxy
+ *        data structures. addr_storage is only needed at the socket boundary, both types
+ *        convert implicitly into each other.
+ */
+class mc_addr
+{
+private:
+    uint32_t m_family;
+
+    //an IPv4 address leaves the remaining words zero
+    union {
+        in_addr m_in;
+        in6_addr m_in6;
+        uint32_t m_words[4];
+    };
+
+public:
+    /**
+     * @brief Create an empty and invalid address.
+     */
+    mc_addr()
+        : m_family(AF_UNSPEC) {
+        std::memset(m_words, 0, sizeof(m_words));
+    }
+
+    mc_addr(const addr_storage& addr);
+
+    explicit mc_addr(const in_addr& addr);
+
+    explicit mc_addr(const in6_addr& addr);
+
+    explicit mc_addr(const std::string& addr);
+
+    mc_addr(const mc_addr&) = default;
+    mc_addr& operator=(const mc_addr&) = default;
+
+    /**
+     * @brief Convert the address into an addr_storage for the socket calls.
+     */
+    operator addr_storage() const;
+
+    int get_addr_family() const {
+        return m_family;
+    }
+
+    const in_addr& get_in_addr() const {
+        return m_in;
+    }
+
+    const in6_addr& get_in6_addr() const {
+        return m_in6;
+    }
+
+    bool is_valid() const {
+        return m_family == AF_INET || m_family == AF_INET6;
+    }
+
+    bool is_multicast_addr() const;
+
+    /**
+     * @brief Hash over the family and the address words.
+     */
+    uint32_t hash() const {
+        uint32_t h = m_family ^ m_words[0] ^ (m_words[1] * 0x9e3779b1) ^ (m_words[2] * 0x85ebca77) ^ (m_words[3] * 0xc2b2ae3d);
+
+        //murmur3 finalizer, group addresses differ mostly in the low order bytes
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        return h;
+    }
+
+    bool operator==(const mc_addr& addr) const {
+        return m_family == addr.m_family && m_words[0] == addr.m_words[0] && m_words[1] == addr.m_words[1] && m_words[2] == addr.m_words[2] && m_words[3] == addr.m_words[3];
+    }
+
+    bool operator!=(const mc_addr& addr) const {
+        return !(*this == addr);
+    }
+
+    /**
+     * @brief Order by the address family and then by the address in network byte order (same as addr_storage).
+     */
+    friend bool operator<(const mc_addr& l, const mc_addr& r) {
+        if (l.m_family != r.m_family) {
+            return l.m_family < r.m_family;
+        } else if (l.m_family == AF_INET) {
+            return ntohl(l.m_in.s_addr) < ntohl(r.m_in.s_addr);
+        } else {
+            return std::memcmp(&l.m_in6, &r.m_in6, sizeof(in6_addr)) < 0;
+        }
+    }
+
+    friend bool operator>(const mc_addr& l, const mc_addr& r) {
+        return r < l;
+    }
+
+    friend bool operator<=(const mc_addr& l, const mc_addr& r) {
+        return !(r < l);
+    }
+
+    friend bool operator>=(const mc_addr& l, const mc_addr& r) {
+        return !(l < r);
+    }
+
+    //mixed comparisons, otherwise both implicit conversions would be ambiguous
+    friend bool operator==(const mc_addr& l, const addr_storage& r) {
+        return l == mc_addr(r);
+    }
+
+    friend bool operator==(const addr_storage& l, const mc_addr& r) {
+        return mc_addr(l) == r;
+    }
+
+    friend bool operator!=(const mc_addr& l, const addr_storage& r) {
+        return !(l == mc_addr(r));
+    }
+
+    friend bool operator!=(const addr_storage& l, const mc_addr& r) {
+        return !(mc_addr(l) == r);
+    }
+
+    friend bool operator<(const mc_addr& l, const addr_storage& r) {
+        return l < mc_addr(r);
+    }
+
+    friend bool operator<(const addr_storage& l, const mc_addr& r) {
+        return mc_addr(l) < r;
+    }
+
+    std::string to_string() const;
+
+    friend std::ostream& operator<<(std::ostream& s, const mc_addr& a);
+};
+
+#endif // MC_ADDR_HPP
@@ -26,6 +26,8 @@
 #include "include/utils/addr_storage.hpp"
 #include <list>
 #include <time.h>
+
+struct sock_fprog;
 #include <string>
 
 ///@author Sebastian Woelke
@@ -199,6 +201,24 @@ public:
      */
     bool receive_msg(struct msghdr* msg, int& sizeOfInfo) const;
 
+    /**
+     * @brief Receive all pending messages up to vlen with the kernel function recvmmsg() without waiting.
+     * @param[out] msgvec received messages, msg_len is set to the size of each message
+     * @param[in] vlen number of elements of msgvec
+     * @param[out] received number of received messages
+     * @return Return true on success.
+     */
+    bool receive_mmsg(struct mmsghdr* msgvec, unsigned int vlen, int& received) const;
+
+    /**
+     * @brief Send several datagrams with one system call (sendmmsg).
+     * @param msgvec messages to send, their destinations and ancillary data
+     * @param vlen number of messages in msgvec
+     * @param[out] sent number of messages sent, the first failed message follows them
+     * @return Return true on success.
+     */
+    bool send_mmsg(struct mmsghdr* msgvec, unsigned int vlen, int& sent) const;
+
     /**
      * @brief Set a receive timeout.
      * @param msec timeout in millisecond
@@ -206,12 +226,25 @@ public:
      */
     bool set_receive_timeout(long msec) const;
 
+    /**
+     * @brief Attach a classic BPF program to the socket, replaces an attached one.
+     * @param prog packets not accepted by the program are dropped in the kernel
+     * @return Return true on success.
+     */
+    bool attach_filter(const struct sock_fprog* prog) const;
+
     /**
      * @brief Choose a specific network interface
      * @return Return true on success.
      */
     bool choose_if(uint32_t if_index) const;
 
+    /**
+     * @brief Get the maximum transmission unit of a network interface.
+     * @return Return true on success.
+     */
+    bool get_mtu(uint32_t if_index, unsigned int& mtu) const;
+
     /**
      * @brief set the ttl
      * @return Return true on success.
@@ -296,6 +329,13 @@ public:
         return m_sock > 0;
     }
 
+    /**
+     * @brief Get the socket descriptor, e.g. to wait for it with epoll.
+     */
+    int get_sock() const {
+        return m_sock;
+    }
+
     /**
      * @brief Test a part of the class mc_socket.
      * @param ipverion "AF_INET" or "AF_INET6"
@@ -0,0 +1,187 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+/**
+ * @brief Number of labels of a metric, the interface indexes beyond share the last label.
+ */
+#define METRICS_MAX_LABELS 256
+
+/**
+ * @brief Number of latency histogram buckets, two per power of two from 1 usec to about 100 sec.
+ */
+#define METRICS_LATENCY_BUCKETS 54
+
+/**
+ * @brief Counters and gauges of the proxy. The label of a metric is an interface index
+ *        or zero for metrics without label.
+ */
+enum metric_id {
+    METRIC_PACKETS_RECEIVED,    //received membership reports, queries and kernel upcalls
+    METRIC_RECORDS_IS_IN,       //received group records per interface
+    METRIC_RECORDS_IS_EX,
+    METRIC_RECORDS_TO_IN,
+    METRIC_RECORDS_TO_EX,
+    METRIC_RECORDS_ALLOW,
+    METRIC_RECORDS_BLOCK,
+    METRIC_RECORDS_SUPPRESSED,  //duplicate current state records per interface
+    METRIC_RECORDS_LIMITED,     //records truncated or rejected by the membership limits per interface
+    METRIC_UPCALLS,             //kernel upcalls of new sources per interface
+    METRIC_UPCALLS_DROPPED,     //pending or rate limited kernel upcalls per interface
+    METRIC_QUEUE_ENQUEUED,
+    METRIC_QUEUE_DROPPED,
+    METRIC_QUEUE_DEPTH,         //gauge
+    METRIC_TIMERS_PENDING,      //gauge
+    METRIC_TIMERS_EXPIRED,
+    METRIC_TIMERS_DEFERRED,     //expired reminders a full job queue did not accept, per delivery attempt
+    METRIC_ROUTES_ADDED,
+    METRIC_ROUTES_DELETED,
+    METRIC_ROUTES_FAILED,
+    METRIC_ROUTE_SYSCALLS,      //system calls to change the kernel routes
+    METRIC_PACKETS_SENT,        //sent reports and queries per interface
+    METRIC_SEND_FAILURES,       //per interface
+    METRIC_MEMBERSHIP_GROUPS,   //gauge per interface
+    METRIC_MEMBERSHIP_SOURCES,  //gauge per interface
+    METRIC_MEMBERSHIP_BYTES,    //gauge per interface, estimated memory of the membership state
+    METRIC_COUNT
+};
+
+/**
+ * @brief Stages of a group record from its receipt until the kernel forwards the group,
+ *        each latency is measured from the receipt of the record.
+ */
+enum latency_stage {
+    LATENCY_QUEUE,    //the querier worker dequeued the record
+    LATENCY_QUERIER,  //the querier reported the state change
+    LATENCY_ROUTING,  //the routing matched the rules and set the routes
+    LATENCY_KERNEL,   //the kernel installed the route
+    LATENCY_UPSTREAM, //the report is handed to the upstream sender
+    LATENCY_STAGE_COUNT
+};
+
+/**
+ * @brief Lock-free registry of the metrics. Every thread updates its own block of values
+ *        without atomic read-modify-write operations, the blocks are summed up on read.
+ *        The blocks of terminated threads are kept, the counters never decrease.
+ */
+class metrics
+{
+private:
+    struct block {
+        block();
+        std::atomic<long long> m_values[METRIC_COUNT][METRICS_MAX_LABELS];
+
+        //the last bucket counts the latencies beyond all bounds
+        std::atomic<long long> m_latencies[LATENCY_STAGE_COUNT][METRICS_LATENCY_BUCKETS + 1];
+        std::atomic<long long> m_latency_sums[LATENCY_STAGE_COUNT]; //nsec
+    };
+
+    static thread_local block* m_block;
+
+    //receive time of the group record processed by the calling thread
+    static thread_local std::chrono::steady_clock::time_point m_origin;
+
+    //upper bounds of the latency buckets in nsec
+    static const long long m_latency_bounds[METRICS_LATENCY_BUCKETS];
+
+    //blocks of all threads, never freed since threads may exit after main()
+    static std::mutex m_blocks_lock;
+    static std::vector<std::unique_ptr<block>>* m_blocks;
+
+    //create and register the block of the calling thread
+    static block* create_block();
+
+    static long long get_value(metric_id id, unsigned int label);
+
+public:
+    /**
+     * @brief Add @p value to a metric of the calling thread, gauges are decreased by a negative value.
+     */
+    static void add(metric_id id, long long value = 1, unsigned int label = 0) {
+        block* b = m_block != nullptr ? m_block : create_block();
+        std::atomic<long long>& v = b->m_values[id][label < METRICS_MAX_LABELS ? label : METRICS_MAX_LABELS - 1];
+
+        //only the calling thread writes its block
+        v.store(v.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record the latency of a stage in the histogram of the calling thread.
+     */
+    static void add_latency(latency_stage stage, std::chrono::steady_clock::duration latency);
+
+    /**
+     * @brief Record the time since the origin of the calling thread, nothing is done without an origin.
+     */
+    static void add_latency(latency_stage stage) {
+        if (m_origin != std::chrono::steady_clock::time_point()) {
+            add_latency(stage, std::chrono::steady_clock::now() - m_origin);
+        }
+    }
+
+    /**
+     * @brief Set the receive time of the group record the calling thread processes now,
+     *        the default time point marks events that are not traced (e.g. timers).
+     */
+    static void set_origin(const std::chrono::steady_clock::time_point& origin) {
+        m_origin = origin;
+    }
+
+    static const std::chrono::steady_clock::time_point& get_origin() {
+        return m_origin;
+    }
+
+    /**
+     * @brief Return the earlier of two origins, an unset origin is ignored.
+     */
+    static std::chrono::steady_clock::time_point earliest_origin(const std::chrono::steady_clock::time_point& l, const std::chrono::steady_clock::time_point& r) {
+        if (l == std::chrono::steady_clock::time_point()) {
+            return r;
+        } else if (r == std::chrono::steady_clock::time_point()) {
+            return l;
+        } else {
+            return std::min(l, r);
+        }
+    }
+
+    /**
+     * @brief Return the sum of a metric over all threads and labels.
+     */
+    static long long get(metric_id id);
+
+    /**
+     * @brief Format all metrics in the Prometheus text exposition format.
+     */
+    static std::string to_string();
+};
+
+#endif // METRICS_HPP
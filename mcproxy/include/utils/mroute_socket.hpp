@@ -24,20 +24,26 @@
 #define MROUTE_SOCKET_HPP
 
 #include "include/utils/mc_socket.hpp"
+#include "include/utils/mc_addr.hpp"
 #include <sys/types.h>
 #include <linux/mroute.h>
 #include <linux/mroute6.h>
 
 #include <list>
+#include <map>
+#include <vector>
+#include <mutex>
 
 #define MROUTE_RATE_LIMIT_ENDLESS 0
 #define MROUTE_TTL_THRESHOLD 1
 #define MROUTE_DEFAULT_TTL 1
+#define MROUTE_NETLINK_BUFFER_SIZE 32768 //maximum size of one netlink request with queued route changes
 
 #define ADD_SIGNED_NUM_U16(r,a) (r)+= (a); (r)+= ((r)>>16)
 
 /**
  * @brief Wrapper for a multicast socket with additional functions to manipulate Linux kernel tables.
+ *        The kernel calls of a proxy instance are virtual to replace the kernel (e.g. by the pcap replay).
  */
 class mroute_socket: public mc_socket
 {
@@ -52,6 +58,49 @@ private:
         return false;
     }
 
+    //a route change queued by queue_add_mroute or queue_del_mroute
+    struct mroute_op {
+        bool m_add;
+        int m_vif_index;
+        mc_addr m_source_addr;
+        mc_addr m_group_addr;
+        std::list<int> m_output_vif;
+    };
+
+    //the route changes and statistics of one address family (ipv4_family or ipv6_family), selected once per call
+    template<typename Family>
+    bool add_family_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const;
+
+    template<typename Family>
+    bool del_family_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const;
+
+    template<typename Family>
+    bool get_family_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const;
+
+    mutable std::vector<mroute_op> m_mroute_ops;
+
+    //rtnetlink socket to send the queued route changes in batches and to dump the routes, -1 if not available
+    mutable int m_nl_sock;
+    mutable bool m_nl_route_changes; //false if the kernel does not support route changes over rtnetlink
+    mutable unsigned int m_nl_seq;
+    mutable std::mutex m_nl_lock; //the route changes and the dumps can be sent by different threads
+    mutable int m_table; //multicast routing table of this socket
+    mutable std::map<int, uint32_t> m_vif_if_index; //virtual interface index, interface index
+
+    //create the rtnetlink socket, route changes are sent over it only for IPv4 (ip6mr does not support RTM_NEWROUTE)
+    void open_route_netlink();
+    void close_route_netlink() const;
+
+    //append the RTM_NEWROUTE or RTM_DELROUTE message of op to buf, false if the route cannot be expressed
+    bool append_route_msg(std::vector<char>& buf, unsigned int seq, const mroute_op& op) const;
+
+    //send one netlink request and wait for the acknowledgements of its messages (sequence numbers first_seq, first_seq + 1, ...)
+    //return false if the kernel does not support multicast routes over rtnetlink
+    bool send_route_msgs(const std::vector<char>& buf, unsigned int first_seq, const std::vector<const mroute_op*>& msgs, std::list<std::pair<mc_addr, mc_addr>>& failed) const;
+
+    //apply a route change with setsockopt
+    bool apply_mroute_op(const mroute_op& op) const;
+
 public:
     /**
      * @brief Create a mroute_socket.
@@ -89,7 +138,7 @@ public:
      * @brief Create IPv6 raw socket (RFC 3542 Section 3).
      * @return Return true on success.
      */
-    bool set_kernel_table(int table) const;
+    virtual bool set_kernel_table(int table) const;
 
     /**
      * @brief The IPv4 layer generates an IP header when
@@ -108,6 +157,24 @@ public:
      */
     u_int16_t calc_checksum(const unsigned char* buf, int buf_size) const;
 
+    /**
+     * @brief Add the 16 bit words of buf to an unfolded ones' complement sum (RFC 1071). Parts of a packet
+     *        can be summed separately, a buffer of an odd size has to be the last part.
+     */
+    static uint64_t checksum_add(uint64_t sum, const unsigned char* buf, int buf_size);
+
+    /**
+     * @brief Fold an unfolded ones' complement sum and return the internet checksum.
+     */
+    static u_int16_t checksum_fold(uint64_t sum);
+
+    /**
+     * @brief Compare the checksums of the simd kernels and the dispatched one with a bytewise ones' complement
+     *        sum over random, odd and misaligned buffers, the differences are logged as errors.
+     * @return Return true if all checksums are equal.
+     */
+    static bool test_checksum();
+
     /**
      * @brief Calculate the ICMPv6 header checksum by sending an ICMPv6 packet.
      *        Per default the ICMP6 checksum (RFC 3542 Section 3.1) will be calculate.
@@ -127,10 +194,10 @@ public:
     bool set_ipv4_receive_packets_with_router_alert_header(bool enable) const;
 
     /**
-     * @brief Set to pass all icmpv6 packets to userpace.
+     * @brief Set to pass the MLD reports and dones (and queries if queries is true) to userpace.
      * @return Return true on success.
      */
-    bool set_ipv6_recv_icmpv6_msg() const;
+    virtual bool set_ipv6_recv_icmpv6_msg(bool queries = false) const;
 
     /**
      * @brief Set to pass the Hob-by-Hob header to userpace.
@@ -142,14 +209,26 @@ public:
      * @brief Set to pass the receive packet information to userpace.
      * @return Return true on success
      */
-    bool set_ipv6_recv_pkt_info() const;
+    virtual bool set_ipv6_recv_pkt_info() const;
 
     /**
      * @brief Enable or disable MRT flag to manipulate the multicast routing tables.
      *        - sysctl net.ipv4.conf.all.mc_forwarding will be set/reset
      * @return Return true on success.
      */
-    bool set_mrt_flag(bool enable) const;
+    virtual bool set_mrt_flag(bool enable) const;
+
+    /**
+     * @brief Report packets received on an interface which is not the input interface of their route (IGMPMSG_WRONGVIF/MRT6MSG_WRONGMIF).
+     * @return Return true on success.
+     */
+    virtual bool set_assert(bool enable) const;
+
+    /**
+     * @brief Wildcard routes (source address 0.0.0.0 or ::) forward the traffic of all
+     *        sources of a group without a route per source (Linux 3.8 or newer).
+     */
+    virtual bool is_wildcard_mroute_supported() const;
 
     /**
      * @brief Adds the virtual interface to the mrouted API
@@ -161,7 +240,7 @@ public:
      * @param ip_tunnel_remote_addr if the interface is a tunnel interface the remote address has to set else it has to be an empty addr_storage
      * @return Return true on success.
      */
-    bool add_vif(int vifNum, uint32_t if_index, const addr_storage& ip_tunnel_remote_addr) const;
+    virtual bool add_vif(int vifNum, uint32_t if_index, const addr_storage& ip_tunnel_remote_addr) const;
 
     /**
      * @brief Bind the interface to a spezific table as output and input interface
@@ -169,7 +248,17 @@ public:
      * @param table is the spezific table
      * @return Return true on success.
      */
-    bool bind_vif_to_table(uint32_t if_index, int table) const;
+    virtual bool bind_vif_to_table(uint32_t if_index, int table) const;
+
+    /**
+     * @brief Bind several interfaces to a spezific table as output and input interfaces with one
+     *        rtnetlink request instead of two ip processes per interface.
+     * @param if_indexes are the interface indexes, the interfaces that could not be bound are left
+     *        (without any of their rules), so they can be bound again
+     * @param table is the spezific table
+     * @return Return true on success.
+     */
+    virtual bool bind_vifs_to_table(std::list<uint32_t>& if_indexes, int table) const;
 
     /**
      * @brief unbind the interface from a spezific table as output and input interface
@@ -177,14 +266,14 @@ public:
      * @param table is the spezific table
      * @return Return true on success.
      */
-    bool unbind_vif_form_table(uint32_t if_index, int table) const;
+    virtual bool unbind_vif_form_table(uint32_t if_index, int table) const;
 
     /**
      * @brief Delete the virtual interface from the multicast routing table.
      * @param vif_index virtual index of the interface
      * @return Return true on success.
      */
-    bool del_vif(int vif_index) const;
+    virtual bool del_vif(int vif_index) const;
 
     /**
      * @brief Adds a multicast route to the kernel.
@@ -208,6 +297,24 @@ public:
      */
     bool del_mroute(int vif_index, const addr_storage& source_addr, const addr_storage& group_addr) const;
 
+    /**
+     * @brief Queue the addition of a multicast route until flush_mroutes() is called. The parameters are the same as for add_mroute().
+     */
+    virtual void queue_add_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const;
+
+    /**
+     * @brief Queue the deletion of a multicast route until flush_mroutes() is called. The parameters are the same as for del_mroute().
+     */
+    virtual void queue_del_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const;
+
+    /**
+     * @brief Apply all queued route changes in their order. If the kernel supports it the changes are sent
+     *        as batches of rtnetlink messages (RTNL_FAMILY_IPMR), otherwise each with its own setsockopt call.
+     * @param failed returns the group and source addresses of the changes that failed
+     * @return Return true if all changes succeeded.
+     */
+    virtual bool flush_mroutes(std::list<std::pair<mc_addr, mc_addr>>& failed) const;
+
     /**
      * @brief Get various statistics per interface.
      * @param vif_index is the virtual interface index for an interface
@@ -227,6 +334,19 @@ public:
      */
     bool get_mroute_stats(const addr_storage& source_addr, const addr_storage& group_addr, struct sioc_sg_req* sgreq_v4, struct sioc_sg_req6* sgreq_v6) const;
 
+    /**
+     * @brief Get the packet counter of a multicast route of the address family of this socket.
+     * @return Return true on success.
+     */
+    virtual bool get_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const;
+
+    /**
+     * @brief Get the packet counters of all multicast routes of the table of this socket with one rtnetlink dump.
+     * @param pkt_counts returns the packet count per group and source address
+     * @return Return false if the dump is not supported or failed, the counters have to be requested per route then.
+     */
+    virtual bool get_all_mroute_pkt_counts(std::map<std::pair<mc_addr, mc_addr>, unsigned long>& pkt_counts) const;
+
     /**
      * @brief simple test outputs
      */
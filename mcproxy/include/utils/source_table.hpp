@@ -0,0 +1,197 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef SOURCE_TABLE_HPP
+#define SOURCE_TABLE_HPP
+
+#include "include/utils/mc_addr.hpp"
+#include "include/utils/addr_hash_map.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#define SOURCE_TABLE_CHUNK_SIZE 1024 //entries per chunk
+#define SOURCE_TABLE_MAX_CHUNKS 16384 //at most 16M interned addresses
+
+/**
+ * @brief Interns the source addresses of all proxy instances. Each distinct address is stored once and
+ *        identified by a small id, the id 0 is the invalid address. The ids are reference counted by
+ *        source_addr and reused after the last reference is released.
+ *
+ * The entries are allocated in chunks that are never moved or freed, so the address of a referenced id
+ * is read without the lock. Only interning and the release of the last reference take the lock.
+ */
+class source_table
+{
+private:
+    struct entry {
+        mc_addr m_addr;
+        std::atomic<uint32_t> m_refs;
+        bool m_used;
+    };
+
+    std::mutex m_lock;
+    addr_hash_map<uint32_t> m_ids;
+    std::vector<uint32_t> m_free_ids;
+    std::atomic<entry*> m_chunks[SOURCE_TABLE_MAX_CHUNKS];
+    uint32_t m_next_id; //first id that has never been used
+
+    source_table();
+
+    source_table(const source_table&) = delete;
+    source_table& operator=(const source_table&) = delete;
+
+    entry& get_entry(uint32_t id) const {
+        return m_chunks[id / SOURCE_TABLE_CHUNK_SIZE].load(std::memory_order_acquire)[id % SOURCE_TABLE_CHUNK_SIZE];
+    }
+
+    uint32_t get_free_id();
+
+public:
+    /**
+     * @brief The table lives until the end of the process, so sources can be released during exit.
+     */
+    static source_table& get_instance() {
+        static source_table* const instance = new source_table();
+        return *instance;
+    }
+
+    /**
+     * @brief Return the id of the address with one reference added, an invalid address has the id 0.
+     */
+    uint32_t intern(const mc_addr& addr);
+
+    void add_ref(uint32_t id) {
+        if (id != 0) {
+            get_entry(id).m_refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void release(uint32_t id) {
+        if (id != 0 && get_entry(id).m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release_last(id);
+        }
+    }
+
+    //erase the address of the id if no reference has been added in the meantime
+    void release_last(uint32_t id);
+
+    const mc_addr& get_addr(uint32_t id) const {
+        return get_entry(id).m_addr;
+    }
+
+    /**
+     * @brief Number of interned addresses.
+     */
+    std::size_t size();
+
+    /**
+     * @brief Estimated memory of the table in bytes.
+     */
+    std::size_t get_memory();
+};
+
+/**
+ * @brief Reference to an interned source address. Copies share the id, so source lists store four
+ *        bytes per address and compare integers. The order is the order of the ids, not of the addresses.
+ */
+class source_addr
+{
+private:
+    uint32_t m_id;
+
+public:
+    /**
+     * @brief Create an invalid address.
+     */
+    source_addr()
+        : m_id(0) {}
+
+    source_addr(const mc_addr& addr)
+        : m_id(source_table::get_instance().intern(addr)) {}
+
+    source_addr(const addr_storage& addr)
+        : source_addr(mc_addr(addr)) {}
+
+    source_addr(const source_addr& s)
+        : m_id(s.m_id) {
+        source_table::get_instance().add_ref(m_id);
+    }
+
+    source_addr(source_addr&& s)
+        : m_id(s.m_id) {
+        s.m_id = 0;
+    }
+
+    source_addr& operator=(const source_addr& s) {
+        source_table::get_instance().add_ref(s.m_id);
+        source_table::get_instance().release(m_id);
+        m_id = s.m_id;
+        return *this;
+    }
+
+    source_addr& operator=(source_addr&& s) {
+        if (this != &s) {
+            source_table::get_instance().release(m_id);
+            m_id = s.m_id;
+            s.m_id = 0;
+        }
+        return *this;
+    }
+
+    ~source_addr() {
+        source_table::get_instance().release(m_id);
+    }
+
+    uint32_t get_id() const {
+        return m_id;
+    }
+
+    const mc_addr& get() const {
+        return source_table::get_instance().get_addr(m_id);
+    }
+
+    operator const mc_addr&() const {
+        return get();
+    }
+
+    friend bool operator<(const source_addr& l, const source_addr& r) {
+        return l.m_id < r.m_id;
+    }
+
+    friend bool operator==(const source_addr& l, const source_addr& r) {
+        return l.m_id == r.m_id;
+    }
+
+    friend bool operator!=(const source_addr& l, const source_addr& r) {
+        return l.m_id != r.m_id;
+    }
+
+    friend std::ostream& operator<<(std::ostream& s, const source_addr& a) {
+        return s << a.get();
+    }
+};
+
+#endif // SOURCE_TABLE_HPP
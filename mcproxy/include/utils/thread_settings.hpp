@@ -0,0 +1,95 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef THREAD_SETTINGS_HPP
+#define THREAD_SETTINGS_HPP
+
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+/**
+ * @brief Maximum length of a thread name without the terminating zero (limit of the kernel).
+ */
+#define THREAD_NAME_MAX_LEN 15
+
+/**
+ * @brief Roles of the threads of the proxy, each role can be pinned and scheduled separately.
+ */
+enum thread_role {
+    TR_RECEIVER,    //shared socket thread of the receivers
+    TR_INSTANCE,    //worker of a proxy instance
+    TR_QUERIER,     //querier threads of the proxy instances (option -q)
+    TR_TIMING,      //timer threads
+    TR_ROUTING,     //route writer threads
+    TR_MONITOR,     //interface monitor
+    TR_COUNT
+};
+
+/**
+ * @brief CPU set and scheduling class of a thread role.
+ */
+struct thread_role_settings {
+    bool pinned = false;
+    cpu_set_t cpus;
+    bool scheduled = false;
+    int policy = SCHED_OTHER;
+    int priority = 0; //real time priority of SCHED_FIFO and SCHED_RR, nice value of SCHED_OTHER
+
+    std::string to_string() const;
+};
+
+/**
+ * @brief Affinity, scheduling class and name of the proxy threads. The settings are parsed before
+ *        the first thread is started and applied by each thread to itself.
+ */
+class thread_settings
+{
+private:
+    static thread_role_settings m_roles[TR_COUNT];
+
+    static bool parse_cpus(const std::string& list, cpu_set_t& cpus);
+    static bool parse_scheduling(const std::string& sched, thread_role_settings& settings);
+
+public:
+    static std::string get_role_name(thread_role role);
+
+    /**
+     * @brief Parse the setting of the option -A: <role>=[<cpu list>][/<policy>[:<priority>]].
+     *        The role "all" sets every role, the cpu list uses the format of taskset -c
+     *        (e.g. 2-3,6) and the policies are other (priority = nice value), fifo and rr.
+     * @return false if the setting is invalid
+     */
+    static bool parse(const std::string& arg);
+
+    /**
+     * @brief Name the calling thread and apply the settings of its role. A failure is logged,
+     *        the thread keeps running with the inherited settings.
+     * @param name is shortened to THREAD_NAME_MAX_LEN characters
+     */
+    static void apply(thread_role role, const std::string& name);
+
+    static std::string to_string();
+};
+
+#endif // THREAD_SETTINGS_HPP
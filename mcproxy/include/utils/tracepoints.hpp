@@ -0,0 +1,67 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef TRACEPOINTS_HPP
+#define TRACEPOINTS_HPP
+
+/**
+ * @brief Static tracepoints (USDT) of the provider "mcproxy", compiled in with CONFIG+=usdt.
+ *        A disabled probe costs a nop, the arguments are only evaluated by an attached tracer.
+ *        Addresses are passed as pointer to an mc_addr, i.e. the family as 32 bit word
+ *        followed by 16 address bytes (an IPv4 address uses the first 4 bytes).
+ *
+ * probes:
+ *  - packet_received(count)                                        a batch of packets was received
+ *  - record_parsed(if_index, record_type, gaddr, source_count)     a group record was parsed
+ *  - record_dispatched(if_index, record_type, gaddr, source_count) a querier starts to process a group record
+ *  - timer_armed(delay_msec, worker)                               a reminder was added
+ *  - timer_fired(count)                                            reminders expired
+ *  - timer_stale(if_index, msg_type)                               an expired reminder was already replaced
+ *  - route_add(input_vif, gaddr, saddr, output_vif_mask)           a route is sent to the kernel
+ *  - route_del(input_vif, gaddr, saddr)
+ *  - report_sent(if_index, filter_mode, gaddr, source_count)       an upstream report was handed to the sender
+ *
+ * e.g.: bpftrace -e 'usdt:/usr/local/bin/mcproxy:mcproxy:route_add { @[arg0] = count(); }'
+ */
+#ifdef MCPROXY_USDT
+#include <sys/sdt.h>
+#define MCPROXY_PROBE(name, ...) STAP_PROBEV(mcproxy, name, __VA_ARGS__)
+#else
+#define MCPROXY_PROBE(name, ...) do { } while (0)
+#endif
+
+/**
+ * @brief Build a bitmask of the output vifs of a route for the probes, vifs beyond 63 are left out.
+ */
+template <typename Container>
+unsigned long long probe_vif_mask(const Container& vifs)
+{
+    unsigned long long mask = 0;
+    for (int vif : vifs) {
+        if (vif >= 0 && vif < 64) {
+            mask |= 1ULL << vif;
+        }
+    }
+    return mask;
+}
+
+#endif // TRACEPOINTS_HPP
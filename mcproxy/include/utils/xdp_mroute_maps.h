@@ -0,0 +1,90 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/**
+ * @defgroup mod_xdp_maps XDP forwarding maps
+ * @brief Layout of the BPF maps shared by the proxy (xdp_mroute_socket) and the
+ *        XDP program (xdp/mcproxy_xdp.c). Plain C, both sides include it.
+ */
+
+#ifndef XDP_MROUTE_MAPS_H
+#define XDP_MROUTE_MAPS_H
+
+#include <linux/types.h>
+
+/**
+ * @brief Names of the objects pinned in the directory given with -X.
+ */
+#define XDP_MROUTE_ROUTES_MAP "mcproxy_routes"
+#define XDP_MROUTE_IFS_MAP "mcproxy_ifs"
+#define XDP_MROUTE_DEVS_MAP "mcproxy_devs"
+#define XDP_MROUTE_INGRESS_PROG "mcproxy_ingress"
+#define XDP_MROUTE_EGRESS_PROG "mcproxy_egress"
+
+/**
+ * @brief Maximum number of output interfaces of one route.
+ */
+#define XDP_MROUTE_MAX_OUTPUT_IFS 64
+
+/**
+ * @brief Maximum number of proxy instances (tables) an interface belongs to.
+ */
+#define XDP_MROUTE_MAX_TABLES 8
+
+/**
+ * @brief Key of the (S,G) routes (map mcproxy_routes, hash). Each proxy instance writes its routes
+ *        with its table number, so the instances sharing an upstream do not overwrite each other.
+ *        IPv4 addresses use the first 4 bytes of the address fields, the other bytes are zero.
+ */
+struct xdp_mroute_key {
+    __u32 table;
+    __u32 input_if_index;
+    __u32 family; //AF_INET or AF_INET6
+    __u32 reserved;
+    __u8 source[16];
+    __u8 group[16];
+};
+
+/**
+ * @brief Value of the (S,G) routes, the XDP program sends a copy of the packet to each
+ *        output interface and counts the packets for the source timeout of the proxy.
+ */
+struct xdp_mroute_value {
+    __u32 output_count;
+    __u32 reserved;
+    __u64 pkt_count; //incremented by the XDP program
+    __u32 output_if_index[XDP_MROUTE_MAX_OUTPUT_IFS];
+};
+
+/**
+ * @brief Interfaces of the proxy instances (map mcproxy_ifs, hash, key interface index). The XDP
+ *        program looks up the routes of a packet in each table of its input interface and sets the
+ *        source MAC address of the copies to the one of the output interface.
+ */
+struct xdp_mroute_if {
+    __u32 table_count;
+    __u32 table[XDP_MROUTE_MAX_TABLES];
+    __u8 mac[6];
+    __u8 reserved[2];
+};
+
+#endif // XDP_MROUTE_MAPS_H
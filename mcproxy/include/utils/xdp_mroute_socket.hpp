@@ -0,0 +1,108 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#ifndef XDP_MROUTE_SOCKET_HPP
+#define XDP_MROUTE_SOCKET_HPP
+
+#include "include/utils/mroute_socket.hpp"
+#include "include/utils/xdp_mroute_maps.h"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Forwards the multicast data with an XDP program instead of the multicast forwarding cache
+ *        of the kernel. The program xdp/mcproxy_xdp.c and its maps are pinned in one directory
+ *        (layout in xdp_mroute_maps.h), the socket attaches the program to the interfaces of its
+ *        instance and writes the routes to the maps. The routes of an instance are keyed with its
+ *        table number, so instances sharing an upstream keep their own routes. The virtual interfaces and the socket stay in the kernel, the first packets
+ *        of a new source pass the XDP program and are reported by the kernel as before.
+ */
+class xdp_mroute_socket : public mroute_socket
+{
+private:
+    std::string m_pin_path;
+    uint32_t m_table;
+
+    int m_routes_fd;
+    int m_ifs_fd;
+    int m_devs_fd;
+    int m_ingress_fd;
+    int m_egress_fd;
+
+    //a route change queued until flush_mroutes()
+    struct route_op {
+        bool m_add;
+        int m_vif_index;
+        mc_addr m_source_addr;
+        mc_addr m_group_addr;
+        std::list<int> m_output_vif;
+    };
+
+    mutable std::mutex m_lock;
+    mutable std::map<int, uint32_t> m_vif_if_index; //virtual interface index, interface index
+    mutable std::vector<route_op> m_ops;
+
+    //input interface of the installed routes (group address, source address)
+    mutable std::map<std::pair<mc_addr, mc_addr>, uint32_t> m_installed;
+
+    void close_fds();
+
+    int open_map(const std::string& name, uint32_t type, uint32_t key_size, uint32_t value_size) const;
+    int open_prog(const std::string& name) const;
+
+    void set_key(xdp_mroute_key& key, uint32_t input_if_index, const mc_addr& source_addr, const mc_addr& group_addr) const;
+
+    //add the table of this instance to an interface, the first instance attaches the program to it
+    bool register_if(uint32_t if_index) const;
+
+    //remove the table of this instance from an interface, the last instance detaches the program
+    void unregister_if(uint32_t if_index) const;
+
+    //write or delete a route in the map, a changed route keeps its packet counter
+    bool apply_op(const route_op& op) const;
+
+public:
+    /**
+     * @brief Open the pinned maps and programs, throws if one of them does not exist or has another layout.
+     * @param pin_path directory the programs and maps of xdp/mcproxy_xdp.c are pinned in
+     * @param table table number of the proxy instance
+     */
+    xdp_mroute_socket(const std::string& pin_path, uint32_t table);
+
+    virtual ~xdp_mroute_socket();
+
+    bool add_vif(int vif_index, uint32_t if_index, const addr_storage& ip_tunnel_remote_addr) const override;
+    bool del_vif(int vif_index) const override;
+
+    //the map has no wildcard routes
+    bool is_wildcard_mroute_supported() const override;
+
+    void queue_add_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const override;
+    void queue_del_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const override;
+    bool flush_mroutes(std::list<std::pair<mc_addr, mc_addr>>& failed) const override;
+
+    bool get_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const override;
+    bool get_all_mroute_pkt_counts(std::map<std::pair<mc_addr, mc_addr>, unsigned long>& pkt_counts) const override;
+};
+
+#endif // XDP_MROUTE_SOCKET_HPP
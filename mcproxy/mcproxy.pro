@@ -10,14 +10,35 @@ tester {
     DEFINES += TESTER
 
     SOURCES += src/tester/config_map.cpp \
-           src/tester/tester.cpp
+           src/tester/tester.cpp \
+           src/tester/host_population.cpp \
+           src/tester/data_plane.cpp
 
     HEADERS += include/tester/config_map.hpp \
-           include/tester/tester.hpp
+           include/tester/tester.hpp \
+           include/tester/host_population.hpp \
+           include/tester/data_plane.hpp
 
     LIBS += -L/usr/lib -lboost_regex
 }
 
+bench {
+    CONFIG-=mcproxy #removes default mode
+    message("target bench")
+    TARGET = bench
+    DEFINES += BENCH
+
+    SOURCES += src/bench/bench.cpp \
+           src/bench/bench_querier.cpp \
+           src/bench/bench_timing.cpp \
+           src/bench/bench_interface.cpp \
+           src/bench/bench_report.cpp
+
+    HEADERS += include/bench/bench.hpp
+
+    LIBS += -L/usr/lib -lbenchmark
+}
+
 mcproxy { #default mode
     message("target mcproxy")
     TARGET = mcproxy
@@ -32,6 +53,11 @@ CONFIG(release, debug|release) { #default mode
     message("release mode")
 }
 
+usdt { #static tracepoints for bpftrace/systemtap, requires sys/sdt.h (systemtap-sdt-dev)
+    message("usdt probes enabled")
+    DEFINES += MCPROXY_USDT
+}
+
 CONFIG -= qt
 QMAKE_CXXFLAGS += -std=c++11
 
@@ -52,13 +78,27 @@ SOURCES += src/main.cpp \
                #utils
            src/utils/mc_socket.cpp \
            src/utils/addr_storage.cpp \
+           src/utils/mc_addr.cpp \
            src/utils/mroute_socket.cpp \
+           src/utils/xdp_mroute_socket.cpp \
            src/utils/if_prop.cpp \
            src/utils/reverse_path_filter.cpp \
+           src/utils/metrics.cpp \
+           src/utils/source_table.cpp \
+           src/utils/thread_settings.cpp \
                #proxy
            src/proxy/proxy.cpp \
            src/proxy/sender.cpp \
+           src/proxy/report_pacer.cpp \
            src/proxy/receiver.cpp \
+           src/proxy/receiver_io.cpp \
+           src/proxy/querier_shard.cpp \
+           src/proxy/proxy_snapshot.cpp \
+           src/proxy/checkpoint.cpp \
+           src/proxy/event_trace.cpp \
+           src/proxy/pcap_replay.cpp \
+           src/proxy/scale_suite.cpp \
+           src/proxy/control_socket.cpp \
            src/proxy/mld_receiver.cpp \
            src/proxy/igmp_receiver.cpp \
            src/proxy/mld_sender.cpp \
@@ -67,12 +107,14 @@ SOURCES += src/main.cpp \
            src/proxy/routing.cpp \
            src/proxy/worker.cpp \
            src/proxy/timing.cpp \
+           src/proxy/timing_wheel.cpp \
            src/proxy/check_if.cpp \
            src/proxy/check_kernel.cpp \
            src/proxy/membership_db.cpp \
            src/proxy/querier.cpp \
            src/proxy/timers_values.cpp \
            src/proxy/interfaces.cpp \
+           src/proxy/interface_monitor.cpp \
            src/proxy/def.cpp \
            src/proxy/simple_mc_proxy_routing.cpp \
            src/proxy/simple_routing_data.cpp \
@@ -81,31 +123,56 @@ SOURCES += src/main.cpp \
            src/parser/token.cpp \
            src/parser/configuration.cpp \
            src/parser/parser.cpp \
-           src/parser/interface.cpp
+           src/parser/interface.cpp \
+           src/parser/compiled_table.cpp
 
 HEADERS += include/hamcast_logging.h \
                 #utils
            include/utils/mc_socket.hpp \
            include/utils/addr_storage.hpp \
+           include/utils/mc_addr.hpp \
+           include/utils/flat_set.hpp \
+           include/utils/addr_hash_map.hpp \
+           include/utils/source_table.hpp \
+           include/utils/thread_settings.hpp \
            include/utils/reverse_path_filter.hpp \
+           include/utils/metrics.hpp \
+           include/utils/tracepoints.hpp \
            include/utils/mroute_socket.hpp \
+           include/utils/addr_family.hpp \
+           include/utils/xdp_mroute_socket.hpp \
+           include/utils/xdp_mroute_maps.h \
            include/utils/if_prop.hpp \
            include/utils/extended_mld_defines.hpp \
            include/utils/extended_igmp_defines.hpp \
                #proxy
            include/proxy/proxy.hpp \
            include/proxy/sender.hpp \
+           include/proxy/report_pacer.hpp \
            include/proxy/receiver.hpp \
+           include/proxy/receiver_io.hpp \
+           include/proxy/querier_shard.hpp \
+           include/proxy/proxy_snapshot.hpp \
+           include/proxy/checkpoint.hpp \
+           include/proxy/event_trace.hpp \
+           include/proxy/pcap_replay.hpp \
+           include/proxy/recording_sender.hpp \
+           include/proxy/scale_suite.hpp \
+           include/proxy/control_socket.hpp \
+           include/proxy/report_view.hpp \
            include/proxy/mld_receiver.hpp \
            include/proxy/igmp_receiver.hpp \
            include/proxy/mld_sender.hpp \
            include/proxy/igmp_sender.hpp \
            include/proxy/proxy_instance.hpp \
            include/proxy/message_queue.hpp \
+           include/proxy/mpsc_ring.hpp \
+           include/proxy/message_pool.hpp \
            include/proxy/message_format.hpp \
            include/proxy/routing.hpp \
            include/proxy/worker.hpp \
            include/proxy/timing.hpp \
+           include/proxy/timing_wheel.hpp \
            include/proxy/check_if.hpp \
            include/proxy/check_kernel.hpp \
            include/proxy/membership_db.hpp \
@@ -113,6 +180,7 @@ HEADERS += include/hamcast_logging.h \
            include/proxy/querier.hpp \
            include/proxy/timers_values.hpp \
            include/proxy/interfaces.hpp \
+           include/proxy/interface_monitor.hpp \
            include/proxy/routing_management.hpp \
            include/proxy/simple_mc_proxy_routing.hpp \
            include/proxy/simple_routing_data.hpp \
@@ -121,7 +189,11 @@ HEADERS += include/hamcast_logging.h \
            include/parser/token.hpp \
            include/parser/configuration.hpp \
            include/parser/parser.hpp \
-           include/parser/interface.hpp
+           include/parser/interface.hpp \
+           include/parser/compiled_table.hpp
+
+#built with clang -target bpf, see the file
+OTHER_FILES += xdp/mcproxy_xdp.c
 
 LIBS += -L/usr/lib -lpthread 
 
@@ -0,0 +1,195 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/bench/bench.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <cstring>
+
+#include <arpa/inet.h>
+
+int run_benchmarks(int arg_count, char* args[])
+{
+    benchmark::Initialize(&arg_count, args);
+    if (benchmark::ReportUnrecognizedArguments(arg_count, args)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
+
+addr_storage bench_addr(int addr_family, bool group, unsigned int n)
+{
+    if (addr_family == AF_INET) {
+        in_addr addr;
+        addr.s_addr = htonl((group ? 0xef010000 : 0x0a000001) + n);
+        return addr_storage(addr);
+    } else {
+        in6_addr addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.s6_addr[0] = group ? 0xff : 0xfd;
+        addr.s6_addr[1] = group ? 0x05 : 0x00;
+        uint32_t low = htonl((group ? 0x00010000 : 0x00000001) + n);
+        memcpy(&addr.s6_addr[12], &low, sizeof(low));
+        return addr_storage(addr);
+    }
+}
+
+source_list<source> bench_slist(int addr_family, unsigned int first, unsigned int count)
+{
+    source_list<source> result;
+    for (unsigned int i = first; i < first + count; ++i) {
+        result.insert(source(bench_addr(addr_family, false, i)));
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------
+//source_list set algebra of range(0) addresses, both lists have range(1) sources and overlap by half
+
+namespace
+{
+void set_algebra_args(benchmark::internal::Benchmark* b)
+{
+    for (int af : {AF_INET, AF_INET6}) {
+        for (int size : {1, 8, 64, 512, 4096}) {
+            b->Args({af, size});
+        }
+    }
+}
+}
+
+static void BM_source_list_merge(benchmark::State& state)
+{
+    auto a = bench_slist(state.range(0), 0, state.range(1));
+    auto b = bench_slist(state.range(0), state.range(1) / 2, state.range(1));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a + b);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1) * 2);
+}
+BENCHMARK(BM_source_list_merge)->Apply(set_algebra_args);
+
+static void BM_source_list_intersect(benchmark::State& state)
+{
+    auto a = bench_slist(state.range(0), 0, state.range(1));
+    auto b = bench_slist(state.range(0), state.range(1) / 2, state.range(1));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a * b);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1) * 2);
+}
+BENCHMARK(BM_source_list_intersect)->Apply(set_algebra_args);
+
+static void BM_source_list_subtract(benchmark::State& state)
+{
+    auto a = bench_slist(state.range(0), 0, state.range(1));
+    auto b = bench_slist(state.range(0), state.range(1) / 2, state.range(1));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a - b);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1) * 2);
+}
+BENCHMARK(BM_source_list_subtract)->Apply(set_algebra_args);
+
+//in place update of a list as done by the querier for ALLOW and BLOCK records
+static void BM_source_list_update(benchmark::State& state)
+{
+    auto a = bench_slist(state.range(0), 0, state.range(1));
+    auto b = bench_slist(state.range(0), state.range(1) / 2, state.range(1));
+
+    for (auto _ : state) {
+        a += b;
+        a -= b;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1) * 2);
+}
+BENCHMARK(BM_source_list_update)->Apply(set_algebra_args);
+
+//------------------------------------------------------------------------
+//address comparison, the addresses differ in the last byte like the sources of a group
+
+template<typename Addr>
+static void BM_addr_less(benchmark::State& state)
+{
+    std::vector<Addr> addrs;
+    for (unsigned int i = 0; i < 1024; ++i) {
+        addrs.push_back(Addr(bench_addr(state.range(0), false, (i * 7919) % 1024)));
+    }
+
+    unsigned int i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(addrs[i % 1024] < addrs[(i + 1) % 1024]);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_addr_less, addr_storage)->Arg(AF_INET)->Arg(AF_INET6);
+BENCHMARK_TEMPLATE(BM_addr_less, mc_addr)->Arg(AF_INET)->Arg(AF_INET6);
+
+template<typename Addr>
+static void BM_addr_equal(benchmark::State& state)
+{
+    std::vector<Addr> addrs;
+    for (unsigned int i = 0; i < 1024; ++i) {
+        addrs.push_back(Addr(bench_addr(state.range(0), false, i % 2)));
+    }
+
+    unsigned int i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(addrs[i % 1024] == addrs[(i + 1) % 1024]);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_addr_equal, addr_storage)->Arg(AF_INET)->Arg(AF_INET6);
+BENCHMARK_TEMPLATE(BM_addr_equal, mc_addr)->Arg(AF_INET)->Arg(AF_INET6);
+
+//sort group addresses, e.g. to build the snapshots and the checkpoints
+static void BM_addr_storage_sort(benchmark::State& state)
+{
+    std::vector<addr_storage> addrs;
+    std::mt19937 rand(1);
+    for (int i = 0; i < state.range(1); ++i) {
+        addrs.push_back(bench_addr(state.range(0), true, rand() % 65536));
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto tmp = addrs;
+        state.ResumeTiming();
+        std::sort(std::begin(tmp), std::end(tmp));
+        benchmark::DoNotOptimize(tmp.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_addr_storage_sort)->ArgsProduct({{AF_INET, AF_INET6}, {64, 4096}});
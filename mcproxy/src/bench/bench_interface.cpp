@@ -0,0 +1,116 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/bench/bench.hpp"
+#include "include/parser/parser.hpp"
+#include "include/parser/interface.hpp"
+#include "include/utils/mc_addr.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <sstream>
+
+namespace
+{
+//the output filter of the downstream "down" is a whitelist of the given number of rules, each rule
+//allows a /28 of groups from a /28 of sources
+std::shared_ptr<interface> get_filtered_interface(int addr_family, unsigned int rules)
+{
+    const group_mem_protocol gmp = addr_family == AF_INET ? IGMPv3 : MLDv2;
+    const unsigned int prefix = addr_family == AF_INET ? 28 : 124;
+
+    std::ostringstream table;
+    table << "pinstance bench downstream \"down\" out whitelist table {";
+    for (unsigned int i = 0; i < rules; ++i) {
+        table << " (" << bench_addr(addr_family, true, i * 16) << "/" << prefix << " | " << bench_addr(addr_family, false, i * 16) << "/" << prefix << ")";
+    }
+    table << " }";
+
+    inst_def_set ids;
+    parser instance(0, "pinstance bench: \"up\" ==> \"down\"");
+    instance.get_parser_type();
+    instance.parse_instance_definition(ids);
+
+    parser binding(1, table.str());
+    binding.get_parser_type();
+    binding.parse_interface_rule_binding(std::make_shared<global_table_set>(), gmp, ids);
+
+    auto result = (*ids.find("bench"))->get_downstreams().front();
+    result->compile_filters(addr_family);
+    return result;
+}
+
+//(group, source) pairs of which about half match a rule
+std::vector<std::pair<addr_storage, addr_storage>> get_lookups(int addr_family, unsigned int rules)
+{
+    std::mt19937 rand(1);
+    std::vector<std::pair<addr_storage, addr_storage>> result;
+    for (unsigned int i = 0; i < 1024; ++i) {
+        unsigned int g = rand() % (rules * 16);
+        unsigned int s = (rand() % 2 == 0) ? g : rand() % (rules * 16);
+        result.push_back(std::make_pair(bench_addr(addr_family, true, g), bench_addr(addr_family, false, s)));
+    }
+    return result;
+}
+}
+
+//match_output_filter() by interface name, the rules are matched one after the other
+static void BM_interface_match_filter(benchmark::State& state)
+{
+    auto iface = get_filtered_interface(state.range(0), state.range(1));
+    auto lookups = get_lookups(state.range(0), state.range(1));
+
+    unsigned int i = 0;
+    unsigned long long matched = 0;
+    for (auto _ : state) {
+        auto& e = lookups[i++ % lookups.size()];
+        matched += iface->match_output_filter("up", e.first, e.second); //the group is passed first like by the compiled fallback
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["matched"] = benchmark::Counter(matched, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_interface_match_filter)->ArgsProduct({{AF_INET, AF_INET6}, {16, 256, 4096}});
+
+//match_output_filter() by interface index with the compiled table
+static void BM_interface_match_compiled_filter(benchmark::State& state)
+{
+    auto iface = get_filtered_interface(state.range(0), state.range(1));
+
+    std::vector<std::pair<mc_addr, mc_addr>> lookups;
+    for (auto & e : get_lookups(state.range(0), state.range(1))) {
+        lookups.push_back(std::make_pair(mc_addr(e.first), mc_addr(e.second)));
+    }
+
+    unsigned int i = 0;
+    unsigned long long matched = 0;
+    for (auto _ : state) {
+        auto& e = lookups[i++ % lookups.size()];
+        matched += iface->match_output_filter(1, e.first, e.second);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["matched"] = benchmark::Counter(matched, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_interface_match_compiled_filter)->ArgsProduct({{AF_INET, AF_INET6}, {16, 256, 4096}});
@@ -0,0 +1,122 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/bench/bench.hpp"
+#include "include/proxy/querier.hpp"
+#include "include/proxy/sender.hpp"
+#include "include/proxy/timing.hpp"
+#include "include/proxy/interfaces.hpp"
+#include "include/proxy/message_pool.hpp"
+
+#include <benchmark/benchmark.h>
+
+#define BENCH_QUERIER_GROUPS 256 //groups updated by one benchmark iteration
+
+namespace
+{
+//measures the querier only, the queries are dropped
+class bench_sender : public sender
+{
+public:
+    bench_sender(group_mem_protocol gmp)
+        : sender(std::make_shared<interfaces>(get_addr_family(gmp), false), gmp) {
+    }
+
+    bool send_record(unsigned int, mc_filter, const addr_storage&, const source_list<source>&) const override {
+        return true;
+    }
+
+    bool send_general_query(unsigned int, const timers_values&) const override {
+        return true;
+    }
+
+    bool send_mc_addr_specific_query(unsigned int, const timers_values&, const addr_storage&, bool) const override {
+        return true;
+    }
+
+    bool send_mc_addr_and_src_specific_query(unsigned int, const timers_values&, const addr_storage&, source_list<source>&) const override {
+        return true;
+    }
+};
+
+std::shared_ptr<group_record_msg> make_record(unsigned int if_index, mcast_addr_record_type record_type, unsigned int group, source_list<source>&& slist)
+{
+    return make_pooled_msg<group_record_msg>(if_index, record_type, mc_addr(bench_addr(AF_INET, true, group)), std::move(slist), IGMPv3);
+}
+}
+
+//receive_record(): a record of type range(0) to BENCH_QUERIER_GROUPS groups in filter mode range(1) with range(2) sources,
+//the record sources overlap the current sources by half
+static void BM_querier_receive_record(benchmark::State& state)
+{
+    const auto record_type = static_cast<mcast_addr_record_type>(state.range(0));
+    const auto filter_mode = static_cast<mc_filter>(state.range(1));
+    const unsigned int sources = state.range(2);
+    const unsigned int if_index = interfaces::get_if_index("lo");
+
+    auto t = std::make_shared<timing>();
+    std::shared_ptr<const sender> s;
+    try {
+        s = std::make_shared<bench_sender>(IGMPv3);
+    } catch (const char* e) {
+        state.SkipWithError(e);
+        return;
+    }
+
+    unsigned long long state_changes = 0;
+    unsigned long long measured_state_changes = 0;
+    auto cb_state_change = [&state_changes](unsigned int, const mc_addr&) {
+        ++state_changes;
+    };
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<querier> q(new querier(nullptr, IGMPv3, if_index, s, t, timers_values(), cb_state_change, false, false));
+        std::vector<std::shared_ptr<group_record_msg>> records;
+        for (unsigned int g = 0; g < BENCH_QUERIER_GROUPS; ++g) {
+            q->receive_record(make_record(if_index, filter_mode == INCLUDE_MODE ? MODE_IS_INCLUDE : MODE_IS_EXCLUDE, g, bench_slist(AF_INET, 0, sources)));
+            records.push_back(make_record(if_index, record_type, g, bench_slist(AF_INET, sources / 2, sources)));
+        }
+        unsigned long long primed = state_changes;
+        state.ResumeTiming();
+
+        for (auto & e : records) {
+            q->receive_record(e);
+        }
+
+        state.PauseTiming();
+        measured_state_changes += state_changes - primed;
+        records.clear();
+        q.reset();
+        t->stop_all_time(nullptr); //the reminders of the querier
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * BENCH_QUERIER_GROUPS);
+    state.counters["state_changes"] = benchmark::Counter(measured_state_changes, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_querier_receive_record)->ArgsProduct({
+    {MODE_IS_INCLUDE, MODE_IS_EXCLUDE, CHANGE_TO_INCLUDE_MODE, CHANGE_TO_EXCLUDE_MODE, ALLOW_NEW_SOURCES, BLOCK_OLD_SOURCES},
+    {INCLUDE_MODE, EXCLUDE_MODE},
+    {0, 8, 64}
+});
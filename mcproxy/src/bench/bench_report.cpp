@@ -0,0 +1,101 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/bench/bench.hpp"
+#include "include/proxy/report_view.hpp"
+#include "include/utils/extended_igmp_defines.hpp"
+#include "include/utils/extended_mld_defines.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace
+{
+void get_addr(const addr_storage& addr, in_addr& result)
+{
+    result = addr.get_in_addr();
+}
+
+void get_addr(const addr_storage& addr, in6_addr& result)
+{
+    result = addr.get_in6_addr();
+}
+
+//a report of the given number of records with the given number of sources each, the sources are in random order
+template<typename Report, typename Record, typename Addr>
+std::vector<unsigned char> get_report(int addr_family, unsigned int records, unsigned int sources)
+{
+    std::mt19937 rand(1);
+    std::vector<unsigned char> result(sizeof(Report) + records * (sizeof(Record) + sources * sizeof(Addr)));
+
+    Report* report = reinterpret_cast<Report*>(result.data());
+    report->num_of_mc_records = htons(records);
+
+    unsigned char* pos = result.data() + sizeof(Report);
+    for (unsigned int r = 0; r < records; ++r) {
+        Record* rec = reinterpret_cast<Record*>(pos);
+        rec->type = MODE_IS_INCLUDE + r % 6;
+        rec->aux_data_len = 0;
+        rec->num_of_srcs = htons(sources);
+        Addr gaddr;
+        get_addr(bench_addr(addr_family, true, r), gaddr);
+        memcpy(&rec->gaddr, &gaddr, sizeof(gaddr));
+        pos += sizeof(Record);
+
+        for (unsigned int s = 0; s < sources; ++s) {
+            Addr saddr;
+            get_addr(bench_addr(addr_family, false, rand() % 65536), saddr);
+            memcpy(pos, &saddr, sizeof(saddr));
+            pos += sizeof(Addr);
+        }
+    }
+
+    return result;
+}
+}
+
+//parse an IGMPv3 or MLDv2 report of range(0) records with range(1) sources each into group addresses and source lists like the receivers
+template<typename Report, typename Record, typename Addr>
+static void BM_report_parse(benchmark::State& state)
+{
+    const int addr_family = std::is_same<Addr, in_addr>::value ? AF_INET : AF_INET6;
+    auto buf = get_report<Report, Record, Addr>(addr_family, state.range(0), state.range(1));
+
+    for (auto _ : state) {
+        report_view<Report, Record, Addr> report(buf.data(), buf.size());
+        typename report_view<Report, Record, Addr>::record rec;
+        while (report.next(rec)) {
+            addr_storage gaddr = rec.get_gaddr();
+            source_list<source> slist;
+            report.get_slist(rec, slist);
+            benchmark::DoNotOptimize(gaddr);
+            benchmark::DoNotOptimize(slist.size());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetBytesProcessed(state.iterations() * buf.size());
+}
+BENCHMARK_TEMPLATE(BM_report_parse, igmpv3_mc_report, igmpv3_mc_record, in_addr)->ArgsProduct({{1, 16, 64}, {0, 8, 64}});
+BENCHMARK_TEMPLATE(BM_report_parse, mldv2_mc_report, mldv2_mc_record, in6_addr)->ArgsProduct({{1, 16, 64}, {0, 8, 64}});
@@ -0,0 +1,116 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/bench/bench.hpp"
+#include "include/proxy/timing.hpp"
+#include "include/proxy/timing_wheel.hpp"
+#include "include/proxy/message_pool.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace
+{
+//deadlines spread like the querier timers, from the retransmissions to the older host present timers
+std::vector<std::chrono::milliseconds> get_delays(unsigned int count)
+{
+    std::mt19937 rand(1);
+    std::uniform_int_distribution<int> dist(100, 300000);
+    std::vector<std::chrono::milliseconds> result;
+    for (unsigned int i = 0; i < count; ++i) {
+        result.push_back(std::chrono::milliseconds(dist(rand)));
+    }
+    return result;
+}
+}
+
+//timing::add_time() and cancel_time() with range(0) pending reminders, including the lock and the timerfd rearm
+static void BM_timing_add_cancel(benchmark::State& state)
+{
+    timing t;
+    auto msg = std::make_shared<debug_msg>();
+    auto delays = get_delays(1024);
+
+    std::vector<timer_handle> pending;
+    for (int i = 0; i < state.range(0); ++i) {
+        pending.push_back(t.add_time(delays[i % delays.size()], nullptr, msg));
+    }
+
+    unsigned int i = 0;
+    for (auto _ : state) {
+        timer_handle h = t.add_time(delays[i++ % delays.size()], nullptr, msg);
+        t.cancel_time(h);
+    }
+
+    t.stop_all_time(nullptr);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_timing_add_cancel)->RangeMultiplier(16)->Range(1, 1 << 20);
+
+//timing::reschedule_time() of a pending reminder, e.g. a filter timer refreshed by a current state record
+static void BM_timing_reschedule(benchmark::State& state)
+{
+    timing t;
+    auto msg = std::make_shared<debug_msg>();
+    auto delays = get_delays(1024);
+
+    std::vector<timer_handle> pending;
+    for (int i = 0; i < state.range(0); ++i) {
+        pending.push_back(t.add_time(delays[i % delays.size()], nullptr, msg));
+    }
+
+    unsigned int i = 0;
+    for (auto _ : state) {
+        t.reschedule_time(pending[i % pending.size()], delays[(i + 1) % delays.size()]);
+        ++i;
+    }
+
+    t.stop_all_time(nullptr);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_timing_reschedule)->RangeMultiplier(16)->Range(1, 1 << 20);
+
+//timing_wheel::add() and expire() of range(0) reminders, the expiry of the timer thread without the delivery
+static void BM_timing_wheel_expire(benchmark::State& state)
+{
+    auto msg = std::make_shared<debug_msg>();
+    auto delays = get_delays(1024);
+
+    for (auto _ : state) {
+        timing_wheel w;
+        auto now = std::chrono::steady_clock::now();
+        for (int i = 0; i < state.range(0); ++i) {
+            w.add(now + delays[i % delays.size()], std::make_tuple(nullptr, msg));
+        }
+
+        timing_wheel_bucket expired;
+        for (auto until = now; !w.empty(); until += std::chrono::seconds(1)) {
+            w.expire(until, expired);
+        }
+        benchmark::DoNotOptimize(expired.size());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_timing_wheel_expire)->RangeMultiplier(16)->Range(16, 1 << 20);
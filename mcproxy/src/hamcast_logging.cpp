@@ -23,19 +23,32 @@
 #include <thread>
 #include <mutex>
 #include <cstdint>
+#include <cstring>
+#include <climits>
 #include <chrono>
 #include <atomic>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
 //#include <boost/thread.hpp>
 //#include <boost/date_time.hpp>
 
 #include "include/hamcast_logging.h"
 
+#define HC_LOG_RING_SIZE (1 << 20) //byte per thread
+#define HC_LOG_MAX_MSG_SIZE 8192 //byte, longer messages are truncated
+#define HC_LOG_WRITER_INTERVAL 10 //msec, sleep time of the writer thread if no record is queued
+
 #ifdef DEBUG_MODE
 
 namespace
 {
 std::atomic<hc_log_fun_t> m_log_fun(nullptr);
 
+//lowest level logged by m_log_fun
+std::atomic<int> m_log_lvl(INT_MAX);
+
 std::mutex m_next_id_mtx;
 std::uint32_t m_next_id = 0;
 
@@ -45,83 +58,270 @@ std::uint32_t next_session_id()
     return m_next_id++;
 }
 
-class logger
+//header of a message in a log_ring, the message follows without a terminating null
+struct log_record {
+    std::uint64_t time_stamp; //usec
+    const char* fun;
+    std::int32_t lvl;
+    std::uint32_t size;
+};
+
+#define HC_LOG_SKIP_RECORD UINT32_MAX //the next record starts at the begin of the buffer
+
+/**
+ * @brief Single producer single consumer byte ring of one thread, the thread
+ *        appends without a lock and the writer thread consumes.
+ */
+class log_ring
 {
-    bool m_enabled;
-    std::uint32_t m_id;
-    std::fstream m_stream;
+    std::vector<char> m_buf;
+    std::atomic<std::size_t> m_head; //bytes written, changed by the producer
+    std::atomic<std::size_t> m_tail; //bytes read, changed by the consumer
+
+    static std::size_t align(std::size_t size) {
+        return (size + alignof(log_record) - 1) & ~(alignof(log_record) - 1);
+    }
 
 public:
-    logger(bool enabled = true)
-        : m_enabled(enabled), m_id(next_session_id()) {
-        std::ostringstream oss;
-        oss << "thread" << m_id << ".log";
-        std::string filename = oss.str();
-        m_stream.open(filename.c_str(), std::fstream::out);
+    std::uint32_t m_id;
+    std::atomic<unsigned long> m_lost;
+    std::atomic<bool> m_closed;
+
+    log_ring()
+        : m_buf(HC_LOG_RING_SIZE), m_head(0), m_tail(0), m_id(next_session_id()), m_lost(0), m_closed(false) {
+    }
+
+    void push(int lvl, const char* fun, const char* what) {
+        std::size_t len = std::min<std::size_t>(std::strlen(what), HC_LOG_MAX_MSG_SIZE);
+        std::size_t need = align(sizeof(log_record) + len);
+
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        std::size_t free = m_buf.size() - (head - m_tail.load(std::memory_order_acquire));
+        std::size_t pos = head % m_buf.size();
+        std::size_t contiguous = m_buf.size() - pos;
+        std::size_t skip = contiguous < need ? contiguous : 0;
+
+        if (free < skip + need) {
+            m_lost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (skip > 0) {
+            if (skip >= sizeof(log_record)) {
+                reinterpret_cast<log_record*>(&m_buf[pos])->size = HC_LOG_SKIP_RECORD;
+            }
+            head += skip;
+            pos = 0;
+        }
+
+        log_record* r = reinterpret_cast<log_record*>(&m_buf[pos]);
+        r->time_stamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        r->fun = fun;
+        r->lvl = lvl;
+        r->size = len;
+        std::memcpy(&m_buf[pos + sizeof(log_record)], what, len);
+
+        m_head.store(head + need, std::memory_order_release);
     }
 
-    inline void enable() {
-        m_enabled = true;
+    //call f(record, message) for all queued records, return false if the ring was empty
+    template<typename F>
+    bool pop_all(F f) {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        std::size_t head = m_head.load(std::memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+
+        while (tail != head) {
+            std::size_t pos = tail % m_buf.size();
+            std::size_t contiguous = m_buf.size() - pos;
+            const log_record* r = reinterpret_cast<const log_record*>(&m_buf[pos]);
+            if (contiguous < sizeof(log_record) || r->size == HC_LOG_SKIP_RECORD) {
+                tail += contiguous;
+                continue;
+            }
+
+            f(*r, &m_buf[pos + sizeof(log_record)]);
+            tail += align(sizeof(log_record) + r->size);
+        }
+
+        m_tail.store(tail, std::memory_order_release);
+        return true;
     }
+};
 
-    inline void disable() {
-        m_enabled = false;
+/**
+ * @brief Format the records of all log_rings and write them to one logfile per thread.
+ */
+class log_writer
+{
+    std::mutex m_lock;
+    std::vector<std::shared_ptr<log_ring>> m_rings;
+
+    //ring id, logfile, only used by the writer thread
+    std::map<std::uint32_t, std::unique_ptr<std::fstream>> m_streams;
+    std::string m_out;
+
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+
+    //append a left aligned column of at least width characters
+    static void append_column(std::string& out, const char* str, std::size_t size, std::size_t width) {
+        out.append(str, size);
+        if (size < width) {
+            out.append(width - size, ' ');
+        }
     }
 
-    void log(int lvl, const char* fun, const char* what) {
-        //using boost::get_system_time;
-        //using boost::posix_time::to_iso_extended_string;
-        //std::string time_stamp = to_iso_extended_string(get_system_time());
-       
-        unsigned long long time_stamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        std::ostringstream os;
-        os.width(28);
-        os << std::left << time_stamp;
-        os.width(7);
-        os << std::left;
+    //same layout as the former synchronous logger: time stamp, level, function, message
+    static void format(std::string& out, std::uint64_t time_stamp, int lvl, const char* fun, const char* what, std::size_t size) {
+        std::string ts = std::to_string(time_stamp);
+        append_column(out, ts.c_str(), ts.size(), 28);
+
+        const char* lvl_name;
         switch (lvl) {
         case HC_LOG_TRACE_LVL:
-            os << "TRACE";
+            lvl_name = "TRACE";
             break;
         case HC_LOG_DEBUG_LVL:
-            os << "DEBUG";
+            lvl_name = "DEBUG";
             break;
         case HC_LOG_INFO_LVL:
-            os << "INFO";
+            lvl_name = "INFO";
             break;
         case HC_LOG_WARN_LVL:
-            os << "WARN";
+            lvl_name = "WARN";
             break;
         case HC_LOG_ERROR_LVL:
-            os << "ERROR";
+            lvl_name = "ERROR";
             break;
         case HC_LOG_FATAL_LVL:
-            os << "FATAL";
+            lvl_name = "FATAL";
             break;
         default:
+            lvl_name = "";
             break;
         }
-        os.width(80);
-        os << std::left << fun;
-        os.width(0);
-        os << what;
-        os << "\n";
-        std::string oss = os.str();
-        m_stream << oss;
-        m_stream.flush();
+        append_column(out, lvl_name, std::strlen(lvl_name), 7);
+        append_column(out, fun, std::strlen(fun), 80);
+        out.append(what, size);
+        out += '\n';
     }
 
-    ~logger() {
-        m_stream.flush();
-        m_stream.close();
+    std::fstream& get_stream(std::uint32_t id) {
+        auto& stream = m_streams[id];
+        if (stream == nullptr) {
+            std::ostringstream oss;
+            oss << "thread" << id << ".log";
+            stream.reset(new std::fstream(oss.str().c_str(), std::fstream::out));
+        }
+        return *stream;
+    }
+
+    //return true if any record was written
+    bool drain() {
+        bool result = false;
+        std::vector<std::shared_ptr<log_ring>> rings;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            rings = m_rings;
+        }
+
+        for (auto & r : rings) {
+            //a closed ring is removed after its last records are written
+            bool closed = r->m_closed.load(std::memory_order_acquire);
+
+            m_out.clear();
+            bool written = r->pop_all([&](const log_record & rec, const char* what) {
+                format(m_out, rec.time_stamp, rec.lvl, rec.fun, what, rec.size);
+            });
+
+            unsigned long lost = r->m_lost.exchange(0);
+            if (lost > 0) {
+                std::string msg = std::to_string(lost) + " log messages lost";
+                format(m_out, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count(), HC_LOG_WARN_LVL, HC_FUN, msg.c_str(), msg.size());
+            }
+
+            if (written || lost > 0) {
+                std::fstream& stream = get_stream(r->m_id);
+                stream.write(m_out.data(), m_out.size());
+                stream.flush();
+                result = true;
+            }
+
+            if (closed) {
+                m_streams.erase(r->m_id);
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_rings.erase(std::find(std::begin(m_rings), std::end(m_rings), r));
+            }
+        }
+
+        return result;
+    }
+
+    void run() {
+        //sleep only if the rings are empty, the producers never wake up the writer
+        while (m_running) {
+            if (!drain()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(HC_LOG_WRITER_INTERVAL));
+            }
+        }
+        drain();
+    }
+
+public:
+    //set at the exit of the process, the writer thread is gone
+    static std::atomic<bool> m_destroyed;
+
+    log_writer()
+        : m_running(true), m_thread(&log_writer::run, this) {
+    }
+
+    static log_writer& get_instance() {
+        static log_writer instance;
+        return instance;
+    }
+
+    std::shared_ptr<log_ring> add_ring() {
+        auto ring = std::make_shared<log_ring>();
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_rings.push_back(ring);
+        return ring;
+    }
+
+    ~log_writer() {
+        m_destroyed = true;
+        m_running = false;
+        m_thread.join();
+    }
+};
+
+std::atomic<bool> log_writer::m_destroyed(false);
+
+//the ring of the current thread, registered at the writer on the first log message
+struct ring_holder {
+    std::shared_ptr<log_ring> m_ring;
+
+    ring_holder() {
+        if (log_writer::m_destroyed) {
+            //the process is exiting, the messages are not written anymore
+            m_ring = std::make_shared<log_ring>();
+        } else {
+            m_ring = log_writer::get_instance().add_ring();
+        }
+    }
+
+    ~ring_holder() {
+        m_ring->m_closed.store(true, std::memory_order_release);
     }
 };
 
-thread_local logger m_logger;
+thread_local ring_holder m_ring_holder;
 
 void log_all_fun(int lvl, const char* fun_name, const char* line)
 {
-    m_logger.log(lvl, fun_name, line);
+    m_ring_holder.m_ring->push(lvl, fun_name, line);
 }
 
 void log_debug_fun(int lvl, const char* fun_name, const char* line)
@@ -168,6 +368,7 @@ extern "C" hc_log_fun_t hc_get_log_fun()
 
 extern "C" void hc_set_log_fun(hc_log_fun_t function_ptr)
 {
+    m_log_lvl = function_ptr != nullptr ? HC_LOG_TRACE_LVL : INT_MAX;
     m_log_fun = function_ptr;
 }
 
@@ -178,23 +379,34 @@ extern "C" void hc_log(int loglvl, const char* func_name, const char* msg)
     }
 }
 
+extern "C" int hc_log_lvl_enabled(int log_lvl)
+{
+    return log_lvl >= m_log_lvl.load(std::memory_order_relaxed);
+}
+
 extern "C" void hc_set_default_log_fun(int log_lvl)
 {
+    //the levels filtered by the log functions are not formatted at all
     switch (log_lvl) {
     case HC_LOG_DEBUG_LVL:
         hc_set_log_fun(log_debug_fun);
+        m_log_lvl = HC_LOG_DEBUG_LVL;
         break;
     case HC_LOG_INFO_LVL:
         hc_set_log_fun(log_info_fun);
+        m_log_lvl = HC_LOG_INFO_LVL;
         break;
     case HC_LOG_WARN_LVL:
         hc_set_log_fun(log_warn_fun);
+        m_log_lvl = HC_LOG_INFO_LVL;
         break;
     case HC_LOG_ERROR_LVL:
         hc_set_log_fun(log_error_fun);
+        m_log_lvl = HC_LOG_ERROR_LVL;
         break;
     case HC_LOG_FATAL_LVL:
         hc_set_log_fun(log_fatal_fun);
+        m_log_lvl = HC_LOG_FATAL_LVL;
         break;
     default:
         hc_set_log_fun(log_all_fun);
@@ -226,6 +438,11 @@ extern "C" void hc_log(int, const char*, const char*)
 {
 }
 
+extern "C" int hc_log_lvl_enabled(int)
+{
+    return 0;
+}
+
 extern "C" void hc_set_default_log_fun(int)
 {
 }
@@ -37,6 +37,7 @@
 #include "include/proxy/igmp_sender.hpp"
 #include "include/parser/configuration.hpp"
 #include "include/tester/tester.hpp"
+#include "include/bench/bench.hpp"
 
 #include <iostream>
 #include <unistd.h>
@@ -52,6 +53,12 @@ int main(int arg_count, char* args[])
     } catch (const char* e) {
         std::cout << e << std::endl;
     }
+#elif defined(BENCH)
+    try {
+        return run_benchmarks(arg_count, args);
+    } catch (const char* e) {
+        std::cout << e << std::endl;
+    }
 #else
     try {
         proxy p(arg_count, args);
@@ -89,7 +96,6 @@ void test_test()
     //timers_values::test_timers_values_copy();
     //timing::test_timing();
     //worker::test_worker();
-    //proxy_instance::test_querier("lo");
     //simple_routing_data::test_simple_routing_data();
     //igmp_sender::test_igmp_sender();
     //mroute_socket::quick_test();
@@ -0,0 +1,265 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+#include "include/hamcast_logging.h"
+#include "include/parser/compiled_table.hpp"
+#include "include/proxy/interfaces.hpp"
+
+#include <algorithm>
+#include <set>
+
+namespace
+{
+addr_storage get_max_addr(int addr_family)
+{
+    if (addr_family == AF_INET) {
+        return addr_storage("255.255.255.255");
+    } else {
+        return addr_storage("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff");
+    }
+}
+
+addr_storage get_next_addr(const addr_storage& addr)
+{
+    addr_storage result = addr;
+    return ++result;
+}
+
+//replace the wildcard address by the lowest or highest address
+addr_storage get_bound(const addr_storage& addr, int addr_family, bool is_from)
+{
+    if (addr == addr_storage(addr_family)) {
+        return is_from ? addr_storage(addr_family) : get_max_addr(addr_family);
+    } else {
+        return addr;
+    }
+}
+}
+
+compiled_table::compiled_table(int addr_family)
+    : m_addr_family(addr_family)
+    , m_if_index_map(nullptr)
+{
+    HC_LOG_TRACE("");
+}
+
+int compiled_table::get_addr_family() const
+{
+    return m_addr_family;
+}
+
+compiled_table::rule_set& compiled_table::get_rule_set(const std::string& if_name)
+{
+    auto it = std::lower_bound(std::begin(m_if_rules), std::end(m_if_rules), if_name, [](const std::pair<std::string, rule_set>& e, const std::string & n) {
+        return e.first < n;
+    });
+
+    if (it == std::end(m_if_rules) || it->first != if_name) {
+        it = m_if_rules.insert(it, std::make_pair(if_name, rule_set()));
+    }
+
+    return it->second;
+}
+
+bool compiled_table::add_rule(const std::string& if_name, const addr_storage& gaddr_from, const addr_storage& gaddr_to, const addr_storage& saddr_from, const addr_storage& saddr_to)
+{
+    HC_LOG_TRACE("");
+
+    rule_set* rs = &m_any_if_rules;
+    if (!if_name.empty()) {
+        rs = &get_rule_set(if_name);
+    }
+
+    rs->m_groups.push_back(std::make_pair(get_bound(gaddr_from, m_addr_family, true), get_bound(gaddr_to, m_addr_family, false)));
+    rs->m_sources.push_back(std::make_pair(get_bound(saddr_from, m_addr_family, true), get_bound(saddr_to, m_addr_family, false)));
+    return if_name.empty() || interfaces::get_if_index(if_name) != 0;
+}
+
+void compiled_table::build()
+{
+    HC_LOG_TRACE("");
+
+    m_any_if_rules.build(m_addr_family);
+    for (auto & e : m_if_rules) {
+        e.second.build(m_addr_family);
+    }
+
+    resolve();
+}
+
+const compiled_table::if_index_map* compiled_table::resolve() const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_resolve_lock);
+
+    const if_index_map* current = m_if_index_map.load(std::memory_order_acquire);
+    if (current != nullptr && current->m_generation == interfaces::get_if_names_generation()) {
+        return current;
+    }
+
+    //get_if_index() caches the interfaces unknown since the last refresh, which changes the generation again
+    std::unique_ptr<if_index_map> map;
+    do {
+        map.reset(new if_index_map());
+        map->m_generation = interfaces::get_if_names_generation();
+        for (auto & e : m_if_rules) {
+            unsigned int if_index = interfaces::get_if_index(e.first);
+            if (if_index != 0) {
+                map->m_rules.push_back(std::make_pair(if_index, &e.second));
+            }
+        }
+    } while (map->m_generation != interfaces::get_if_names_generation());
+    std::sort(std::begin(map->m_rules), std::end(map->m_rules));
+
+    current = map.get();
+    m_if_index_maps.push_back(std::move(map));
+    m_if_index_map.store(current, std::memory_order_release);
+    return current;
+}
+
+void compiled_table::rule_set::build(int addr_family)
+{
+    HC_LOG_TRACE("");
+
+    using interval = std::pair<mc_addr, mc_addr>;
+    const mc_addr max_addr = get_max_addr(addr_family);
+
+    //the rules sorted by the begin of their group interval and by the address behind the end
+    std::vector<std::pair<mc_addr, std::size_t>> begins;
+    std::vector<std::pair<mc_addr, std::size_t>> ends;
+    for (std::size_t i = 0; i < m_groups.size(); ++i) {
+        if (m_groups[i].second < m_groups[i].first || m_sources[i].second < m_sources[i].first) {
+            continue; //empty range
+        }
+
+        begins.push_back(std::make_pair(m_groups[i].first, i));
+        if (m_groups[i].second != max_addr) {
+            ends.push_back(std::make_pair(get_next_addr(m_groups[i].second), i));
+        }
+    }
+    std::sort(std::begin(begins), std::end(begins));
+    std::sort(std::begin(ends), std::end(ends));
+
+    //source intervals of the rules covering the current group interval, a source interval
+    //starting at the same address as a longer one follows it
+    auto comp = [](const interval & l, const interval & r) {
+        return l.first < r.first || (l.first == r.first && r.second < l.second);
+    };
+    std::multiset<interval, decltype(comp)> active(comp);
+
+    m_bounds.clear();
+    m_offsets.clear();
+    m_source_set.clear();
+
+    //sweep over the begins and the ends (behind the last address) of the group intervals
+    auto b = std::begin(begins);
+    auto e = std::begin(ends);
+    mc_addr pos = addr_storage(addr_family);
+    while (true) {
+        while (e != std::end(ends) && e->first == pos) {
+            active.erase(active.find(m_sources[e->second]));
+            ++e;
+        }
+
+        while (b != std::end(begins) && b->first == pos) {
+            active.insert(m_sources[b->second]);
+            ++b;
+        }
+
+        //merge overlapping and adjacent source intervals
+        std::size_t offset = m_source_set.size();
+        for (auto & s : active) {
+            if (m_source_set.size() > offset && (s.first <= m_source_set.back().second || s.first == get_next_addr(m_source_set.back().second))) {
+                m_source_set.back().second = std::max(m_source_set.back().second, s.second);
+            } else {
+                m_source_set.push_back(s);
+            }
+
+            if (m_source_set.back().second == max_addr) {
+                break; //covers all remaining source intervals
+            }
+        }
+
+        //neighbouring group intervals with the same source intervals are joined
+        if (!m_bounds.empty() && m_source_set.size() - offset == offset - m_offsets.back() && std::equal(std::begin(m_source_set) + offset, std::end(m_source_set), std::begin(m_source_set) + m_offsets.back())) {
+            m_source_set.resize(offset);
+        } else {
+            m_bounds.push_back(pos);
+            m_offsets.push_back(offset);
+        }
+
+        //next begin or end
+        if (b == std::end(begins) && e == std::end(ends)) {
+            break;
+        } else if (e == std::end(ends) || (b != std::end(begins) && b->first < e->first)) {
+            pos = b->first;
+        } else {
+            pos = e->first;
+        }
+    }
+    m_offsets.push_back(m_source_set.size());
+
+    m_groups.clear();
+    m_groups.shrink_to_fit();
+    m_sources.clear();
+    m_sources.shrink_to_fit();
+    m_source_set.shrink_to_fit();
+}
+
+bool compiled_table::rule_set::match(const mc_addr& gaddr, const mc_addr& saddr) const
+{
+    auto it = std::upper_bound(std::begin(m_bounds), std::end(m_bounds), gaddr);
+    if (it == std::begin(m_bounds)) {
+        return false;
+    }
+
+    std::size_t i = it - std::begin(m_bounds) - 1;
+    auto first = std::begin(m_source_set) + m_offsets[i];
+    auto last = std::begin(m_source_set) + m_offsets[i + 1];
+
+    //last source interval starting at or before the source address
+    auto s = std::upper_bound(first, last, saddr, [](const mc_addr & addr, const std::pair<mc_addr, mc_addr>& e) {
+        return addr < e.first;
+    });
+
+    return s != first && !((s - 1)->second < saddr);
+}
+
+bool compiled_table::match(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
+{
+    if (m_any_if_rules.match(gaddr, saddr)) {
+        return true;
+    }
+
+    const if_index_map* map = m_if_index_map.load(std::memory_order_acquire);
+    if (map == nullptr || map->m_generation != interfaces::get_if_names_generation()) {
+        map = resolve();
+    }
+
+    auto it = std::lower_bound(std::begin(map->m_rules), std::end(map->m_rules), input_if_index, [](const std::pair<unsigned int, const rule_set*>& e, unsigned int i) {
+        return e.first < i;
+    });
+
+    return it != std::end(map->m_rules) && it->first == input_if_index && it->second->match(gaddr, saddr);
+}
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <set>
 
 configuration::configuration(const std::string& path, bool reset_reverse_path_filter)
     : m_reset_reverse_path_filter(reset_reverse_path_filter)
@@ -74,17 +75,13 @@ std::string configuration::load_file(const std::string& path)
     HC_LOG_TRACE("");
     std::ifstream file;
     std::ostringstream result;
-    std::string line;
     file.open (path, std::ifstream::in);
     if (!file) {
         HC_LOG_ERROR("failed to open config file: " << path);
         throw "failed to open config file";
     }
 
-    while (std::getline(file, line)) {
-        result << line << std::endl;
-    }
-
+    result << file.rdbuf();
     return result.str();
 }
 
@@ -95,19 +92,27 @@ std::string configuration::delete_comments(std::string&& script_file)
     const char comment_char = '#';
     const char end_of_comment = '\n';
     std::string::size_type cc = script_file.find(comment_char);
-    std::string::size_type eoc;
+    if (cc == std::string::npos) {
+        return std::move(script_file);
+    }
 
+    //copy the text between the comments, erasing every comment in place is quadratic for large files
+    std::string result;
+    result.reserve(script_file.size());
+    std::string::size_type pos = 0;
     while (cc != std::string::npos) {
-        eoc = script_file.find(end_of_comment, cc + 1);
-        if (eoc == std::string::npos) {
-            return script_file.substr(0, cc);
-        } else {
-            script_file.erase(cc, eoc - cc);
+        result.append(script_file, pos, cc - pos);
+
+        pos = script_file.find(end_of_comment, cc + 1);
+        if (pos == std::string::npos) {
+            return result;
         }
 
-        cc = script_file.find(comment_char, cc);
+        cc = script_file.find(comment_char, pos);
     }
-    return script_file;
+
+    result.append(script_file, pos, std::string::npos);
+    return result;
 }
 
 std::vector<std::pair<unsigned int, std::string>> configuration::separate_commands(std::string&& script_file)
@@ -176,6 +181,12 @@ void configuration::initalize_interfaces()
 
     unsigned int if_index;
 
+    //one scan of the network interfaces shared by the interfaces of all instances
+    if (!interfaces::refresh_network_interfaces()) {
+        throw "failed to refresh network interfaces";
+    }
+    interfaces::refresh_if_names();
+
     for (auto & inst : m_inst_def_set) {
         auto result = std::make_shared<interfaces>(get_addr_family(m_gmp), m_reset_reverse_path_filter);
         auto add = [&](const std::shared_ptr<interface>& interf) {
@@ -188,8 +199,26 @@ void configuration::initalize_interfaces()
             if (!result->add_interface(if_index)) {
                 throw "failed to add interface";
             }
+
+            //all tables are known now
+            interf->compile_filters(get_addr_family(m_gmp));
         };
 
+        //the kernel forwards a packet only to the virtual interfaces of the table it arrived in,
+        //so the upstreams and downstreams of an instance cannot be spread over several tables
+        std::set<std::string> if_names;
+        for (auto & downstream : inst->get_downstreams()) {
+            if_names.insert(downstream->get_if_name());
+        }
+        for (auto & upstream : inst->get_upstreams()) {
+            if_names.insert(upstream->get_if_name());
+        }
+
+        if (static_cast<int>(if_names.size()) > result->get_max_vifs()) {
+            HC_LOG_ERROR("proxy instance " << inst->get_instance_name() << " has " << if_names.size() << " interfaces, but a multicast routing table supports only " << result->get_max_vifs() << " virtual interfaces; split the downstreams over several proxy instances");
+            throw "too many interfaces";
+        }
+
         for (auto & downstream : inst->get_downstreams()) {
             add(downstream);
         }
@@ -266,6 +295,55 @@ const inst_def_set& configuration::get_inst_def_set() const
     return m_inst_def_set;
 }
 
+const std::shared_ptr<global_table_set>& configuration::get_global_table_set() const
+{
+    HC_LOG_TRACE("");
+    return m_global_table_set;
+}
+
+bool configuration::adopt_interfaces(const configuration& running)
+{
+    HC_LOG_TRACE("");
+
+    for (auto & e : m_interfaces_map) {
+        auto it = running.m_interfaces_map.find(e.first);
+        if (it == running.m_interfaces_map.end()) {
+            HC_LOG_ERROR("proxy instance " << e.first << " is not running");
+            return false;
+        }
+    }
+
+    for (auto & e : m_interfaces_map) {
+        auto& result = running.m_interfaces_map.find(e.first)->second;
+        auto inst = m_inst_def_set.find(e.first);
+
+        //the virtual interfaces of deleted interfaces stay mapped, the proxy instance may still delete them
+        auto add = [&](const std::shared_ptr<interface>& interf) {
+            if (!result->add_interface(interfaces::get_if_index(interf->get_if_name()))) {
+                HC_LOG_ERROR("failed to add interface " << interf->get_if_name() << " to the running proxy instance " << e.first);
+                return false;
+            }
+            return true;
+        };
+
+        for (auto & downstream : (*inst)->get_downstreams()) {
+            if (!add(downstream)) {
+                return false;
+            }
+        }
+
+        for (auto & upstream : (*inst)->get_upstreams()) {
+            if (!add(upstream)) {
+                return false;
+            }
+        }
+
+        e.second = result;
+    }
+
+    return true;
+}
+
 std::string configuration::to_string() const
 {
     HC_LOG_TRACE("");
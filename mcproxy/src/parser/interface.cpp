@@ -44,6 +44,12 @@ bool single_addr::match(const addr_storage& addr) const
     return addr == m_addr || is_wildcard(m_addr, addr.get_addr_family());
 }
 
+void single_addr::get_interval(addr_storage& from, addr_storage& to) const
+{
+    from = m_addr;
+    to = m_addr;
+}
+
 std::string single_addr::to_string() const
 {
     return m_addr.to_string();
@@ -61,6 +67,12 @@ bool addr_range::match(const addr_storage& addr) const
     return (addr >= m_from || is_wildcard(m_from, addr.get_addr_family())) && (addr <= m_to || is_wildcard(m_to, addr.get_addr_family()) );
 }
 
+void addr_range::get_interval(addr_storage& from, addr_storage& to) const
+{
+    from = m_from;
+    to = m_to;
+}
+
 std::string addr_range::to_string() const
 {
     std::ostringstream s;
@@ -85,6 +97,24 @@ bool rule_addr::match(const std::string& if_name, const addr_storage& gaddr, con
     }
 }
 
+bool rule_addr::compile(compiled_table& ct, unsigned int) const
+{
+    HC_LOG_TRACE("");
+
+    addr_storage gaddr_from;
+    addr_storage gaddr_to;
+    addr_storage saddr_from;
+    addr_storage saddr_to;
+    m_group->get_interval(gaddr_from, gaddr_to);
+    m_source->get_interval(saddr_from, saddr_to);
+
+    if (!ct.add_rule(m_if_name, gaddr_from, gaddr_to, saddr_from, saddr_to)) {
+        HC_LOG_WARN("interface " << m_if_name << " of rule " << to_string() << " not found, the rule matches as soon as it exists");
+    }
+
+    return true;
+}
+
 std::string rule_addr::to_string() const
 {
     std::ostringstream s;
@@ -121,6 +151,24 @@ bool table::match(const std::string& if_name, const addr_storage& gaddr, const a
     return false;
 }
 
+bool table::compile(compiled_table& ct, unsigned int depth) const
+{
+    HC_LOG_TRACE("");
+
+    if (depth > COMPILED_TABLE_MAX_DEPTH) {
+        HC_LOG_ERROR("table " << m_name << " is nested too deep, recursive table references?");
+        return false;
+    }
+
+    for (auto & e : m_rule_box_list) {
+        if (!e->compile(ct, depth + 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 std::string table::to_string() const
 {
     std::ostringstream s;
@@ -187,6 +235,11 @@ bool rule_table::match(const std::string& if_name, const addr_storage& gaddr, co
     return m_table->match(if_name, gaddr, saddr);
 }
 
+bool rule_table::compile(compiled_table& ct, unsigned int depth) const
+{
+    return m_table->compile(ct, depth);
+}
+
 std::string rule_table::to_string() const
 {
     return m_table->to_string();
@@ -209,6 +262,16 @@ bool rule_table_ref::match(const std::string& if_name, const addr_storage& gaddr
     }
 }
 
+bool rule_table_ref::compile(compiled_table& ct, unsigned int depth) const
+{
+    auto t = m_global_table_set->get_table(m_table_name);
+    if (t == nullptr) {
+        return true; //matches nothing
+    } else {
+        return t->compile(ct, depth);
+    }
+}
+
 std::string rule_table_ref::to_string() const
 {
     std::ostringstream s;
@@ -312,6 +375,41 @@ bool rule_binding::match(const std::string& if_name, const addr_storage& saddr,
     return false;
 }
 
+void rule_binding::compile(int addr_family)
+{
+    HC_LOG_TRACE("");
+
+    if (m_table == nullptr) {
+        return;
+    }
+
+    std::unique_ptr<compiled_table> ct(new compiled_table(addr_family));
+    if (m_table->compile(*ct, 0)) {
+        ct->build();
+        m_compiled_table = std::move(ct);
+    } else {
+        HC_LOG_WARN("failed to compile table " << m_table->get_name() << ", the table is matched by interface name");
+        m_compiled_table.reset();
+    }
+}
+
+bool rule_binding::match(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_compiled_table == nullptr || m_compiled_table->get_addr_family() != gaddr.get_addr_family()) {
+        return match(interfaces::get_if_name(input_if_index), gaddr, saddr);
+    }
+
+    if (m_filter_type == FT_BLACKLIST) {
+        return !m_compiled_table->match(input_if_index, gaddr, saddr);
+    } else if (m_filter_type == FT_WHITELIST) {
+        return m_compiled_table->match(input_if_index, gaddr, saddr);
+    }
+
+    return false;
+}
+
 std::string rule_binding::to_string() const
 {
     HC_LOG_TRACE("");
@@ -394,6 +492,8 @@ std::string rule_binding::to_string_rule_matching() const
         s << "first ";
     } else if (m_rule_matching_type == RMT_MUTEX) {
         s << "mutex " << m_timeout.count();
+    } else if (m_rule_matching_type == RMT_HASH) {
+        s << "hash ";
     } else {
         HC_LOG_ERROR("unkown rule matching type");
         s << "???";
@@ -406,6 +506,8 @@ interface::interface(const std::string& if_name)
     : m_if_name(if_name)
     , m_output_filter(nullptr)
     , m_input_filter(nullptr)
+    , m_fast_leave(false)
+    , m_weight(0)
 {
     HC_LOG_TRACE("");
     //unsigned int if_index = interfaces::get_if_index(if_name);
@@ -449,15 +551,104 @@ std::string interface::to_string_rule_binding() const
             s << m_input_filter->to_string();
         }
     }
+
+    if (m_limits.is_limited()) {
+        if (m_output_filter != nullptr || m_input_filter != nullptr) {
+            s << endl;
+        }
+        s << m_if_name << " " << m_limits.to_string();
+    }
+
+    if (m_fast_leave) {
+        if (m_output_filter != nullptr || m_input_filter != nullptr || m_limits.is_limited()) {
+            s << endl;
+        }
+        s << m_if_name << " fast-leave";
+    }
+
+    if (m_prejoin.is_enabled()) {
+        if (m_output_filter != nullptr || m_input_filter != nullptr || m_limits.is_limited() || m_fast_leave) {
+            s << endl;
+        }
+        s << m_if_name << " " << m_prejoin.to_string();
+    }
+
+    if (m_weight != 0) {
+        if (m_output_filter != nullptr || m_input_filter != nullptr || m_limits.is_limited() || m_fast_leave || m_prejoin.is_enabled()) {
+            s << endl;
+        }
+        s << m_if_name << " weight " << m_weight;
+    }
     return s.str();
 }
 
+const membership_limits& interface::get_limits() const
+{
+    return m_limits;
+}
+
+bool interface::is_fast_leave() const
+{
+    return m_fast_leave;
+}
+
+const prejoin_groups& interface::get_prejoin() const
+{
+    return m_prejoin;
+}
+
+unsigned int interface::get_weight() const
+{
+    return m_weight != 0 ? m_weight : 1;
+}
+
 std::string interface::to_string_interface() const
 {
     HC_LOG_TRACE("");
     return m_if_name;
 }
 
+void interface::compile_filters(int addr_family)
+{
+    HC_LOG_TRACE("");
+
+    if (m_output_filter != nullptr) {
+        m_output_filter->compile(addr_family);
+    }
+
+    if (m_input_filter != nullptr) {
+        m_input_filter->compile(addr_family);
+    }
+}
+
+bool interface::match_output_filter(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_output_filter != nullptr) {
+        return m_output_filter->match(input_if_index, gaddr, saddr);
+    } else {
+        return true; //default behaviour
+    }
+}
+
+bool interface::match_input_filter(unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_input_filter != nullptr) {
+        return m_input_filter->match(input_if_index, gaddr, saddr);
+    } else {
+        return true; //default behaviour
+    }
+}
+
+bool interface::has_filter() const
+{
+    HC_LOG_TRACE("");
+    return m_output_filter != nullptr || m_input_filter != nullptr;
+}
+
 bool interface::match_filter(const std::string& input_if_name, const addr_storage& saddr, const addr_storage& gaddr, const std::unique_ptr<rule_binding>& filter) const
 {
     if (filter != nullptr) {
@@ -480,6 +671,61 @@ bool operator==(const std::shared_ptr<interface>& i1, const std::shared_ptr<inte
 {
     return *i1 == *i2;
 }
+//-----------------------------------------------------
+bool prejoin_groups::is_enabled() const
+{
+    return !ranges.empty() || popular > 0;
+}
+
+bool prejoin_groups::is_configured(const mc_addr& gaddr) const
+{
+    for (auto & e : ranges) {
+        if (e.first <= gaddr && gaddr <= e.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<mc_addr> prejoin_groups::get_configured_groups() const
+{
+    HC_LOG_TRACE("");
+
+    std::set<mc_addr> groups;
+    for (auto & e : ranges) {
+        for (addr_storage a = e.first; groups.size() < PREJOIN_MAX_GROUPS; ++a) {
+            groups.insert(a);
+            if (mc_addr(a) == e.second) {
+                break;
+            }
+        }
+    }
+    return std::vector<mc_addr>(std::begin(groups), std::end(groups));
+}
+
+std::string prejoin_groups::to_string() const
+{
+    std::ostringstream s;
+    s << "prejoin";
+    if (!ranges.empty()) {
+        s << " (";
+        for (auto it = std::begin(ranges); it != std::end(ranges); ++it) {
+            if (it != std::begin(ranges)) {
+                s << " | ";
+            }
+            s << it->first;
+            if (it->first != it->second) {
+                s << " - " << it->second;
+            }
+        }
+        s << ")";
+    }
+    if (popular > 0) {
+        s << " popular " << popular;
+    }
+    return s.str();
+}
+
 //-----------------------------------------------------
 instance_definition::instance_definition(const std::string& instance_name)
     : m_instance_name(instance_name)
@@ -345,31 +345,31 @@ std::unique_ptr<addr_match> parser::parse_rule_part(group_mem_protocol gmp)
 addr_storage parser::get_addr(group_mem_protocol gmp)
 {
     HC_LOG_TRACE("");
-    std::ostringstream s;
+    std::string s;
 
     while (true) {
         if (m_current_token.get_type() == TT_STRING) {
-            s << m_current_token.get_string();
+            s += m_current_token.get_string();
         } else if (m_current_token.get_type() == TT_DOT) {
-            s << ".";
+            s += '.';
         } else if (m_current_token.get_type() == TT_DOUBLE_DOT) {
-            s << ":";
+            s += ':';
         } else {
             break;
         }
         get_next_token();
     }
 
-    addr_storage result(s.str());
+    addr_storage result(s);
     if (result.is_valid()) {
         if (result.get_addr_family() == get_addr_family(gmp)) {
             return result;
         } else {
-            HC_LOG_ERROR("failed to parse line " << m_current_line << " ip address: " << s.str() << " has a wrong IP version");
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " ip address: " << s << " has a wrong IP version");
             throw "failed to parse config file";
         }
     } else {
-        HC_LOG_ERROR("failed to parse line " << m_current_line << " ip address: " << s.str() << " is invalid");
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " ip address: " << s << " is invalid");
         throw "failed to parse config file";
     }
 }
@@ -379,6 +379,8 @@ void parser::parse_interface_rule_binding(const std::shared_ptr<const global_tab
     HC_LOG_TRACE("");
 
     //pinstance split downstream tunD1 out whitelist table {tunU1(* | *)};
+    //pinstance split downstream tunD1 limit groups 1000 sources 64 total_sources 10000 policy reject;
+    //pinstance split upstream tunU1 prejoin (239.1.1.1 | 239.2.0.0 - 239.2.0.15) popular 8;
 
     std::string instance_name;
     rb_interface_type interface_type;
@@ -422,7 +424,31 @@ void parser::parse_interface_rule_binding(const std::shared_ptr<const global_tab
         }
 
         get_next_token();
-        if (m_current_token.get_type() == TT_IN) {
+        if (m_current_token.get_type() == TT_LIMIT) {
+            if (interface_type != IT_DOWNSTREAM) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " limits are only defined for downstreams");
+                throw "failed to parse config file";
+            }
+            return parse_interface_limit(std::move(instance_name), std::move(if_name), ids);
+        } else if (m_current_token.get_type() == TT_FAST_LEAVE) {
+            if (interface_type != IT_DOWNSTREAM) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " fast-leave is only defined for downstreams");
+                throw "failed to parse config file";
+            }
+            return parse_interface_fast_leave(std::move(instance_name), std::move(if_name), ids);
+        } else if (m_current_token.get_type() == TT_PREJOIN) {
+            if (interface_type != IT_UPSTREAM) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " prejoin is only defined for upstreams");
+                throw "failed to parse config file";
+            }
+            return parse_interface_prejoin(std::move(instance_name), std::move(if_name), gmp, ids);
+        } else if (m_current_token.get_type() == TT_WEIGHT) {
+            if (interface_type != IT_UPSTREAM) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " weights are only defined for upstreams");
+                throw "failed to parse config file";
+            }
+            return parse_interface_weight(std::move(instance_name), std::move(if_name), ids);
+        } else if (m_current_token.get_type() == TT_IN) {
             filter_direction = ID_IN;
         } else if (m_current_token.get_type() == TT_OUT) {
             filter_direction = ID_OUT;
@@ -555,6 +581,12 @@ void parser::parse_interface_rule_match_binding(
             rule_matching_type = RMT_ALL;
         } else if (m_current_token.get_type() == TT_FIRST) {
             rule_matching_type = RMT_FIRST;
+        } else if (m_current_token.get_type() == TT_HASH) {
+            if (interface_type != IT_UPSTREAM) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " rule matching hash is only defined for upstreams");
+                throw "failed to parse config file";
+            }
+            rule_matching_type = RMT_HASH;
         } else if (m_current_token.get_type() == TT_MUTEX) {
             rule_matching_type = RMT_MUTEX;
 
@@ -613,6 +645,281 @@ void parser::parse_interface_rule_match_binding(
     //}
 }
 
+void parser::parse_interface_limit(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids)
+{
+    HC_LOG_TRACE("");
+    auto error_notification = [&]() {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " unknown token " << get_token_type_name(m_current_token.get_type()) << " with value " << m_current_token.get_string() << " in this context");
+        throw "failed to parse config file";
+    };
+
+    //limit = "limit" limit_value {limit_value};
+    //limit_value = ("groups" | "sources" | "total_sources") @number@ | "policy" ("truncate" | "reject");
+    membership_limits limits;
+    bool has_value = false;
+
+    get_next_token();
+    while (m_current_token.get_type() == TT_STRING) {
+        std::string key = m_current_token.get_string();
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+        get_next_token();
+        if (m_current_token.get_type() != TT_STRING) {
+            error_notification();
+        }
+        std::string value = m_current_token.get_string();
+
+        if (key.compare("policy") == 0) {
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            if (value.compare("truncate") == 0) {
+                limits.policy = LP_TRUNCATE;
+            } else if (value.compare("reject") == 0) {
+                limits.policy = LP_REJECT;
+            } else {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " limit policy " << value << " is unknown, expected \"truncate\" or \"reject\"");
+                throw "failed to parse config file";
+            }
+        } else {
+            unsigned int number;
+            try {
+                if (value.empty() || value[0] == '-') {
+                    throw std::invalid_argument(value);
+                }
+                number = std::stoul(value);
+            } catch (std::logic_error& e) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " limit " << key << ": " << value << " is not a number");
+                throw "failed to parse config file";
+            }
+
+            if (key.compare("groups") == 0) {
+                limits.max_groups = number;
+            } else if (key.compare("sources") == 0) {
+                limits.max_sources = number;
+            } else if (key.compare("total_sources") == 0) {
+                limits.max_total_sources = number;
+            } else {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " limit " << key << " is unknown, expected \"groups\", \"sources\", \"total_sources\" or \"policy\"");
+                throw "failed to parse config file";
+            }
+        }
+
+        has_value = true;
+        get_next_token();
+    }
+
+    if (!has_value || m_current_token.get_type() != TT_NIL) {
+        error_notification();
+    }
+
+    auto instance_it = ids.find(instance_name);
+    if (instance_it != ids.end()) {
+        auto interface_it = std::find((*instance_it)->m_downstreams.begin(), (*instance_it)->m_downstreams.end(), std::make_shared<interface>(if_name));
+        if (interface_it == (*instance_it)->m_downstreams.end()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " downstream interface " << if_name << " not defined");
+            throw "failed to parse config file";
+        }
+
+        if ((*interface_it)->m_limits.is_limited()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " limits for interface " << if_name << " already defined");
+            throw "failed to parse config file";
+        }
+
+        (*interface_it)->m_limits = limits;
+    } else {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " proxy instance " << instance_name << " not defined");
+        throw "failed to parse config file";
+    }
+}
+
+void parser::parse_interface_fast_leave(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids)
+{
+    HC_LOG_TRACE("");
+
+    //fast_leave = "fast-leave";
+    get_next_token();
+    if (m_current_token.get_type() != TT_NIL) {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " unknown token " << get_token_type_name(m_current_token.get_type()) << " with value " << m_current_token.get_string() << " in this context");
+        throw "failed to parse config file";
+    }
+
+    auto instance_it = ids.find(instance_name);
+    if (instance_it != ids.end()) {
+        auto interface_it = std::find((*instance_it)->m_downstreams.begin(), (*instance_it)->m_downstreams.end(), std::make_shared<interface>(if_name));
+        if (interface_it == (*instance_it)->m_downstreams.end()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " downstream interface " << if_name << " not defined");
+            throw "failed to parse config file";
+        }
+
+        if ((*interface_it)->m_fast_leave) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " fast-leave for interface " << if_name << " already defined");
+            throw "failed to parse config file";
+        }
+
+        (*interface_it)->m_fast_leave = true;
+    } else {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " proxy instance " << instance_name << " not defined");
+        throw "failed to parse config file";
+    }
+}
+
+void parser::parse_interface_prejoin(std::string&& instance_name, std::string&& if_name, group_mem_protocol gmp, const inst_def_set& ids)
+{
+    HC_LOG_TRACE("");
+    auto error_notification = [&]() {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " unknown token " << get_token_type_name(m_current_token.get_type()) << " with value " << m_current_token.get_string() << " in this context");
+        throw "failed to parse config file";
+    };
+
+    //prejoin = "prejoin" ["(" group {"|" group} ")"] ["popular" @number@];
+    //group = address | address "-" address | address "/" prefix;
+    prejoin_groups prejoin;
+    std::size_t group_count = 0;
+
+    get_next_token();
+    if (m_current_token.get_type() == TT_LEFT_BRACKET) {
+        do {
+            get_next_token();
+            auto group = parse_rule_part(gmp);
+
+            addr_storage from;
+            addr_storage to;
+            group->get_interval(from, to);
+            if (!from.is_multicast_addr() || !to.is_multicast_addr() || to < from) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " prejoin group " << group->to_string() << " is not a multicast address or range");
+                throw "failed to parse config file";
+            }
+
+            for (addr_storage a = from; group_count <= PREJOIN_MAX_GROUPS; ++a) {
+                ++group_count;
+                if (a == to) {
+                    break;
+                }
+            }
+
+            if (group_count > PREJOIN_MAX_GROUPS) {
+                HC_LOG_ERROR("failed to parse line " << m_current_line << " more than " << PREJOIN_MAX_GROUPS << " prejoin groups");
+                throw "failed to parse config file";
+            }
+
+            prejoin.ranges.push_back(std::make_pair(mc_addr(from), mc_addr(to)));
+        } while (m_current_token.get_type() == TT_PIPE);
+
+        if (m_current_token.get_type() != TT_RIGHT_BRACKET) {
+            error_notification();
+        }
+        get_next_token();
+    }
+
+    if (m_current_token.get_type() == TT_STRING) {
+        std::string key = m_current_token.get_string();
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        if (key.compare("popular") != 0) {
+            error_notification();
+        }
+
+        get_next_token();
+        if (m_current_token.get_type() != TT_STRING) {
+            error_notification();
+        }
+
+        std::string value = m_current_token.get_string();
+        try {
+            if (value.empty() || value[0] == '-') {
+                throw std::invalid_argument(value);
+            }
+            prejoin.popular = std::stoul(value);
+        } catch (std::logic_error& e) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " prejoin popular: " << value << " is not a number");
+            throw "failed to parse config file";
+        }
+
+        if (prejoin.popular == 0 || prejoin.popular > PREJOIN_MAX_GROUPS) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " prejoin popular has to be between 1 and " << PREJOIN_MAX_GROUPS);
+            throw "failed to parse config file";
+        }
+        get_next_token();
+    }
+
+    if (!prejoin.is_enabled() || m_current_token.get_type() != TT_NIL) {
+        error_notification();
+    }
+
+    auto instance_it = ids.find(instance_name);
+    if (instance_it != ids.end()) {
+        auto interface_it = std::find((*instance_it)->m_upstreams.begin(), (*instance_it)->m_upstreams.end(), std::make_shared<interface>(if_name));
+        if (interface_it == (*instance_it)->m_upstreams.end()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " upstream interface " << if_name << " not defined");
+            throw "failed to parse config file";
+        }
+
+        if ((*interface_it)->m_prejoin.is_enabled()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " prejoin for interface " << if_name << " already defined");
+            throw "failed to parse config file";
+        }
+
+        (*interface_it)->m_prejoin = std::move(prejoin);
+    } else {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " proxy instance " << instance_name << " not defined");
+        throw "failed to parse config file";
+    }
+}
+
+void parser::parse_interface_weight(std::string&& instance_name, std::string&& if_name, const inst_def_set& ids)
+{
+    HC_LOG_TRACE("");
+    auto error_notification = [&]() {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " unknown token " << get_token_type_name(m_current_token.get_type()) << " with value " << m_current_token.get_string() << " in this context");
+        throw "failed to parse config file";
+    };
+
+    //weight = "weight" number;
+    get_next_token();
+    if (m_current_token.get_type() != TT_STRING) {
+        error_notification();
+    }
+
+    std::string value = m_current_token.get_string();
+    unsigned long weight;
+    try {
+        if (value.empty() || value[0] == '-') {
+            throw std::invalid_argument(value);
+        }
+        weight = std::stoul(value);
+    } catch (std::logic_error& e) {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " weight: " << value << " is not a number");
+        throw "failed to parse config file";
+    }
+
+    if (weight == 0 || weight > UPSTREAM_MAX_WEIGHT) {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " weight has to be between 1 and " << UPSTREAM_MAX_WEIGHT);
+        throw "failed to parse config file";
+    }
+
+    get_next_token();
+    if (m_current_token.get_type() != TT_NIL) {
+        error_notification();
+    }
+
+    auto instance_it = ids.find(instance_name);
+    if (instance_it != ids.end()) {
+        auto interface_it = std::find((*instance_it)->m_upstreams.begin(), (*instance_it)->m_upstreams.end(), std::make_shared<interface>(if_name));
+        if (interface_it == (*instance_it)->m_upstreams.end()) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " upstream interface " << if_name << " not defined");
+            throw "failed to parse config file";
+        }
+
+        if ((*interface_it)->m_weight != 0) {
+            HC_LOG_ERROR("failed to parse line " << m_current_line << " weight for interface " << if_name << " already defined");
+            throw "failed to parse config file";
+        }
+
+        (*interface_it)->m_weight = weight;
+    } else {
+        HC_LOG_ERROR("failed to parse line " << m_current_line << " proxy instance " << instance_name << " not defined");
+        throw "failed to parse config file";
+    }
+}
+
 void parser::get_next_token()
 {
     m_current_token = m_scanner.get_next_token();
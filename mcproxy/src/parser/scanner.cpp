@@ -27,27 +27,51 @@
 #include <algorithm>
 #include <fstream>
 
+namespace
+{
+//character classes of the C locale, the library functions are not inlined
+inline bool is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool is_string(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+}
+}
+
 scanner::scanner(unsigned int current_line, const std::string& cmd)
     : m_current_line(current_line)
     , m_cmd(cmd)
     , m_current_cmd_pos(0)
-    , m_token_pos(0)
 {
     HC_LOG_TRACE("");
 
     read_next_char();
-    fill_token_vec();
 }
 
 token scanner::get_next_token(bool peek, int token_count)
 {
-    if (peek && m_token_pos + token_count < m_token_vec.size()) {
-        return m_token_vec[m_token_pos + token_count];
-    } else if (!peek && m_token_pos < m_token_vec.size()) {
-        return m_token_vec[m_token_pos++];
+    if (peek) {
+        fill_lookahead(token_count + 1);
+        if (static_cast<unsigned int>(token_count) < m_lookahead.size()) {
+            return m_lookahead[token_count];
+        }
+    } else if (m_lookahead.empty()) {
+        return read_next_token();
     } else {
-        return token(TT_NIL);
+        token result = std::move(m_lookahead.front());
+        m_lookahead.pop_front();
+        return result;
     }
+
+    return token(TT_NIL);
 }
 
 void scanner::read_next_char()
@@ -61,27 +85,45 @@ void scanner::read_next_char()
 
 void scanner::skip_spaces()
 {
-    while (std::isspace(m_current_cmd_char)) {
+    while (is_space(m_current_cmd_char)) {
         read_next_char();
     }
 }
 
-void scanner::fill_token_vec()
+bool scanner::is_keyword_continued(const std::string& word)
 {
-    token tok = read_next_token();
+    std::size_t end = m_current_cmd_pos + word.length();
+    if (end > m_cmd.length() || (end < m_cmd.length() && is_string(m_cmd[end]))) {
+        return false;
+    }
 
-    while (tok.get_type() != TT_NIL) {
-        m_token_vec.push_back(tok);
-        tok = read_next_token();
+    for (std::size_t i = 0; i < word.length(); ++i) {
+        if (::tolower(m_cmd[m_current_cmd_pos + i]) != word[i]) {
+            return false;
+        }
     }
+
+    //the dash is the current char
+    for (std::size_t i = 0; i <= word.length(); ++i) {
+        read_next_char();
+    }
+    return true;
 }
 
-token scanner::read_next_token()
+void scanner::fill_lookahead(unsigned int count)
 {
-    auto is_string = [] (char cmp) {
-        return std::isalpha(cmp) || std::isdigit(cmp) || cmp == '_';
-    };
+    while (m_lookahead.size() < count) {
+        token tok = read_next_token();
+        if (tok.get_type() == TT_NIL) {
+            return;
+        }
 
+        m_lookahead.push_back(std::move(tok));
+    }
+}
+
+token scanner::read_next_token()
+{
     skip_spaces();
 
     switch (m_current_cmd_char) {
@@ -128,29 +170,33 @@ token scanner::read_next_token()
         read_next_char();
         return token(TT_PIPE);
     case '"': {
-        std::ostringstream s;
+        std::string s;
 
         read_next_char();
         while (m_current_cmd_char != 0 && m_current_cmd_char != '"') {
-            s << m_current_cmd_char;
+            s.push_back(m_current_cmd_char);
             read_next_char();
         }
         read_next_char();
 
-        return token(TT_STRING, s.str());
+        return token(TT_STRING, std::move(s));
     }
     default:
         if (is_string(m_current_cmd_char)) {
-            std::ostringstream s;
-            s << m_current_cmd_char;
+            std::string s(1, m_current_cmd_char);
 
             read_next_char();
             while (is_string(m_current_cmd_char)) {
-                s << m_current_cmd_char;
+                s.push_back(m_current_cmd_char);
                 read_next_char();
             }
 
-            std::string cmp_str = s.str();
+            //addresses and numbers are no keywords
+            if (is_digit(s[0])) {
+                return token(TT_STRING, std::move(s));
+            }
+
+            std::string cmp_str = s;
             std::transform(cmp_str.begin(), cmp_str.end(), cmp_str.begin(), ::tolower);
             if (cmp_str.compare("protocol") == 0) {
                 return TT_PROTOCOL;
@@ -188,10 +234,20 @@ token scanner::read_next_token()
                 return TT_FIRST;
             } else if (cmp_str.compare("mutex") == 0) {
                 return TT_MUTEX;
+            } else if (cmp_str.compare("hash") == 0) {
+                return TT_HASH;
             } else if (cmp_str.compare("disable") == 0) {
                 return TT_DISABLE;
+            } else if (cmp_str.compare("limit") == 0) {
+                return TT_LIMIT;
+            } else if (cmp_str.compare("prejoin") == 0) {
+                return TT_PREJOIN;
+            } else if (cmp_str.compare("weight") == 0) {
+                return TT_WEIGHT;
+            } else if (cmp_str.compare("fast") == 0 && m_current_cmd_char == '-' && is_keyword_continued("leave")) {
+                return TT_FAST_LEAVE;
             } else {
-                return token(TT_STRING, s.str());
+                return token(TT_STRING, std::move(s));
             }
         } else {
             HC_LOG_ERROR("failed to scan config file. Unsupported char <" << m_current_cmd_char << "> in line " << m_current_line << " and postion " << m_current_cmd_pos);
@@ -213,7 +269,8 @@ std::string scanner::to_string() const
     s << m_current_line << ": " << m_cmd << endl;
     s << " ==> ";
     int i = 1;
-    for (auto e : m_token_vec) {
+    scanner scan(m_current_line, m_cmd);
+    for (token e = scan.get_next_token(); e.get_type() != TT_NIL; e = scan.get_next_token()) {
         if (i % 5 == 0) {
             s << endl;
         }
@@ -51,6 +51,11 @@ std::string get_token_type_name(token_type tt)
         {TT_ALL, "TT_ALL"},
         {TT_FIRST, "TT_FIRST"},
         {TT_MUTEX, "TT_MUTEX"},
+        {TT_HASH, "TT_HASH"},
+        {TT_LIMIT, "TT_LIMIT"},
+        {TT_FAST_LEAVE, "TT_FAST_LEAVE"},
+        {TT_PREJOIN, "TT_PREJOIN"},
+        {TT_WEIGHT, "TT_WEIGHT"},
         //{TT_MILLISECONDS, "TT_MILLISECONDS"},
         //{TT_TABLE_NAME, "TT_TABLE_NAME"},
         //{TT_PATH, "TT_PATH"},
@@ -82,8 +87,8 @@ const std::string& token::get_string() const
     return m_string;
 }
 
-token::token(token_type type, const std::string str)
+token::token(token_type type, std::string str)
     : m_type(type)
-    , m_string(str)
+    , m_string(std::move(str))
 {
 }
@@ -0,0 +1,381 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/checkpoint.hpp"
+#include "include/proxy/interfaces.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+const char checkpoint_magic[4] = {'M', 'C', 'P', 'C'};
+}
+
+//the file is only read by the same host, the values are stored in host byte order
+class checkpoint::writer
+{
+private:
+    char* m_buf;
+    size_t m_size;
+
+public:
+    //serialize into buf or only count the bytes if buf is nullptr
+    writer(char* buf)
+        : m_buf(buf)
+        , m_size(0) {}
+
+    void put_bytes(const void* data, size_t size) {
+        if (m_buf != nullptr) {
+            std::memcpy(m_buf + m_size, data, size);
+        }
+        m_size += size;
+    }
+
+    template<typename T>
+    void put(T value) {
+        put_bytes(&value, sizeof(value));
+    }
+
+    void put_string(const std::string& s) {
+        put<uint16_t>(s.size());
+        put_bytes(s.data(), s.size());
+    }
+
+    void put_addr(const mc_addr& addr) {
+        if (addr.get_addr_family() == AF_INET) {
+            put<uint8_t>(4);
+            put_bytes(&addr.get_in_addr(), sizeof(in_addr));
+        } else {
+            put<uint8_t>(6);
+            put_bytes(&addr.get_in6_addr(), sizeof(in6_addr));
+        }
+    }
+
+    size_t size() const {
+        return m_size;
+    }
+};
+
+class checkpoint::reader
+{
+private:
+    const char* m_buf;
+    size_t m_size;
+    size_t m_pos;
+    bool m_ok;
+
+public:
+    reader(const char* buf, size_t size)
+        : m_buf(buf)
+        , m_size(size)
+        , m_pos(0)
+        , m_ok(true) {}
+
+    void get_bytes(void* data, size_t size) {
+        if (!m_ok || size > m_size - m_pos) {
+            m_ok = false;
+            std::memset(data, 0, size);
+            return;
+        }
+        std::memcpy(data, m_buf + m_pos, size);
+        m_pos += size;
+    }
+
+    template<typename T>
+    T get() {
+        T value;
+        get_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string get_string() {
+        uint16_t size = get<uint16_t>();
+        if (!m_ok || size > m_size - m_pos) {
+            m_ok = false;
+            return std::string();
+        }
+        std::string s(m_buf + m_pos, size);
+        m_pos += size;
+        return s;
+    }
+
+    mc_addr get_addr() {
+        uint8_t family = get<uint8_t>();
+        if (family == 4) {
+            in_addr addr;
+            get_bytes(&addr, sizeof(addr));
+            return mc_addr(addr);
+        } else if (family == 6) {
+            in6_addr addr;
+            get_bytes(&addr, sizeof(addr));
+            return mc_addr(addr);
+        } else {
+            m_ok = false;
+            return mc_addr();
+        }
+    }
+
+    //false if the data was truncated or malformed
+    bool is_ok() const {
+        return m_ok;
+    }
+
+    bool is_end() const {
+        return m_pos == m_size;
+    }
+};
+
+void checkpoint::write_snapshot(writer& w, const proxy_snapshot& s)
+{
+    HC_LOG_TRACE("");
+
+    w.put_string(s.instance_name);
+    w.put<int32_t>(s.table_number);
+
+    w.put<uint32_t>(s.downstreams.size());
+    for (auto & d : s.downstreams) {
+        w.put_string(interfaces::get_if_name(d->if_index));
+        w.put<uint8_t>(d->querier_version_mode);
+        w.put<uint8_t>(d->is_querier);
+
+        w.put<uint32_t>(d->groups.size());
+        for (auto & g : d->groups) {
+            w.put_addr(g->gaddr);
+            w.put<uint8_t>(g->filter_mode);
+            w.put<uint8_t>(g->compatibility_mode);
+
+            w.put<uint32_t>(g->include_requested_list.size());
+            for (auto & e : g->include_requested_list) {
+                w.put_addr(e);
+            }
+
+            w.put<uint32_t>(g->exclude_list.size());
+            for (auto & e : g->exclude_list) {
+                w.put_addr(e);
+            }
+        }
+    }
+
+    w.put<uint32_t>(s.routes != nullptr ? s.routes->size() : 0);
+    if (s.routes != nullptr) {
+        for (auto & r : *s.routes) {
+            w.put_addr(r.gaddr);
+            w.put_addr(r.saddr);
+            w.put_string(interfaces::get_if_name(r.input_if_index));
+        }
+    }
+}
+
+std::shared_ptr<proxy_snapshot> checkpoint::read_snapshot(reader& r)
+{
+    HC_LOG_TRACE("");
+
+    auto s = std::make_shared<proxy_snapshot>();
+    s->version = 0;
+    s->time = std::chrono::steady_clock::now();
+    s->instance_name = r.get_string();
+    s->table_number = r.get<int32_t>();
+
+    uint32_t downstreams = r.get<uint32_t>();
+    for (uint32_t i = 0; i < downstreams && r.is_ok(); ++i) {
+        auto d = std::make_shared<downstream_snapshot>();
+        std::string if_name = r.get_string();
+        d->if_index = interfaces::get_if_index(if_name);
+        d->version = 0;
+        d->querier_version_mode = static_cast<group_mem_protocol>(r.get<uint8_t>());
+        d->is_querier = r.get<uint8_t>() != 0;
+
+        uint32_t groups = r.get<uint32_t>();
+        for (uint32_t j = 0; j < groups && r.is_ok(); ++j) {
+            auto g = std::make_shared<group_snapshot>();
+            g->gaddr = r.get_addr();
+            g->version = 0;
+
+            uint8_t filter_mode = r.get<uint8_t>();
+            uint8_t compatibility_mode = r.get<uint8_t>();
+            if ((filter_mode != INCLUDE_MODE && filter_mode != EXCLUDE_MODE) || (compatibility_mode != IGMPv1 && compatibility_mode != IGMPv2 && compatibility_mode != IGMPv3 && compatibility_mode != MLDv1 && compatibility_mode != MLDv2)) {
+                HC_LOG_ERROR("unknown filter mode or protocol in checkpoint");
+                return nullptr;
+            }
+            g->filter_mode = static_cast<mc_filter>(filter_mode);
+            g->compatibility_mode = static_cast<group_mem_protocol>(compatibility_mode);
+
+            uint32_t sources = r.get<uint32_t>();
+            for (uint32_t k = 0; k < sources && r.is_ok(); ++k) {
+                g->include_requested_list.insert(r.get_addr());
+            }
+
+            sources = r.get<uint32_t>();
+            for (uint32_t k = 0; k < sources && r.is_ok(); ++k) {
+                g->exclude_list.insert(r.get_addr());
+            }
+
+            d->groups.push_back(g);
+        }
+
+        if (d->if_index == INTERFACES_UNKOWN_IF_INDEX) {
+            HC_LOG_WARN("failed to restore the interface " << if_name << " of proxy instance " << s->instance_name << ", interface not found");
+        } else {
+            s->downstreams.push_back(d);
+        }
+    }
+
+    auto routes = std::make_shared<route_snapshot_list>();
+    uint32_t count = r.get<uint32_t>();
+    for (uint32_t i = 0; i < count && r.is_ok(); ++i) {
+        route_snapshot rs;
+        rs.gaddr = r.get_addr();
+        rs.saddr = r.get_addr();
+        rs.input_if_index = interfaces::get_if_index(r.get_string());
+        if (rs.input_if_index != INTERFACES_UNKOWN_IF_INDEX) {
+            routes->push_back(rs);
+        }
+    }
+    s->routes = routes;
+
+    return r.is_ok() ? s : nullptr;
+}
+
+bool checkpoint::write(const std::string& path, const std::vector<std::shared_ptr<const proxy_snapshot>>& snapshots)
+{
+    HC_LOG_TRACE("");
+
+    int64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    auto serialize = [&](writer & w) {
+        w.put_bytes(checkpoint_magic, sizeof(checkpoint_magic));
+        w.put<uint32_t>(CHECKPOINT_FORMAT_VERSION);
+        w.put<int64_t>(time);
+        w.put<uint32_t>(snapshots.size());
+        for (auto & e : snapshots) {
+            write_snapshot(w, *e);
+        }
+    };
+
+    writer counter(nullptr);
+    serialize(counter);
+
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        HC_LOG_ERROR("failed to open checkpoint file: " << tmp_path << "; Error: " << strerror(errno));
+        return false;
+    }
+
+    if (ftruncate(fd, counter.size()) < 0) {
+        HC_LOG_ERROR("failed to resize checkpoint file: " << tmp_path << "; Error: " << strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void* buf = mmap(nullptr, counter.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (buf == MAP_FAILED) {
+        HC_LOG_ERROR("failed to map checkpoint file: " << tmp_path << "; Error: " << strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    writer w(static_cast<char*>(buf));
+    serialize(w);
+
+    bool rc = msync(buf, counter.size(), MS_SYNC) == 0;
+    munmap(buf, counter.size());
+    close(fd);
+
+    if (!rc || rename(tmp_path.c_str(), path.c_str()) < 0) {
+        HC_LOG_ERROR("failed to write checkpoint file: " << path << "; Error: " << strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool checkpoint::read(const std::string& path, std::vector<std::shared_ptr<const proxy_snapshot>>& snapshots, std::chrono::milliseconds& elapsed)
+{
+    HC_LOG_TRACE("");
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        HC_LOG_DEBUG("no checkpoint file: " << path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        HC_LOG_ERROR("failed to read checkpoint file: " << path);
+        close(fd);
+        return false;
+    }
+
+    void* buf = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        HC_LOG_ERROR("failed to map checkpoint file: " << path << "; Error: " << strerror(errno));
+        return false;
+    }
+
+    reader r(static_cast<const char*>(buf), st.st_size);
+    bool rc = false;
+
+    char magic[sizeof(checkpoint_magic)];
+    r.get_bytes(magic, sizeof(magic));
+    uint32_t version = r.get<uint32_t>();
+    int64_t time = r.get<int64_t>();
+    if (!r.is_ok() || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0 || version != CHECKPOINT_FORMAT_VERSION) {
+        HC_LOG_ERROR("failed to read checkpoint file: " << path << "; unknown format");
+    } else {
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        elapsed = std::chrono::milliseconds(now - time);
+
+        std::vector<std::shared_ptr<const proxy_snapshot>> result;
+        uint32_t count = r.get<uint32_t>();
+        for (uint32_t i = 0; i < count && r.is_ok(); ++i) {
+            auto s = read_snapshot(r);
+            if (s == nullptr) {
+                break;
+            }
+            result.push_back(s);
+        }
+
+        if (!r.is_ok() || result.size() != count || !r.is_end()) {
+            HC_LOG_ERROR("failed to read checkpoint file: " << path << "; file is corrupt");
+        } else if (elapsed < std::chrono::milliseconds(0)) {
+            //the wall clock was set back, the age of the checkpoint is unknown
+            HC_LOG_WARN("checkpoint file " << path << " is from the future, it is ignored");
+        } else {
+            snapshots = std::move(result);
+            rc = true;
+        }
+    }
+
+    munmap(buf, st.st_size);
+    return rc;
+}
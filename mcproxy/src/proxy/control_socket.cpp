@@ -0,0 +1,133 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/control_socket.hpp"
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+control_socket::control_socket(const std::string& path, const control_handler& handler)
+    : m_path(path)
+    , m_fd(-1)
+    , m_handler(handler)
+{
+    HC_LOG_TRACE("");
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        HC_LOG_ERROR("failed to create control socket, path too long: " << path);
+        throw "failed to create control socket";
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd < 0) {
+        HC_LOG_ERROR("failed to create control socket! Error: " << strerror(errno) << " errno: " << errno);
+        throw "failed to create control socket";
+    }
+
+    unlink(path.c_str());
+    if (bind(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || chmod(path.c_str(), S_IRUSR | S_IWUSR) < 0 || listen(m_fd, 8) < 0) {
+        HC_LOG_ERROR("failed to bind control socket " << path << "! Error: " << strerror(errno) << " errno: " << errno);
+        close(m_fd);
+        throw "failed to bind control socket";
+    }
+}
+
+control_socket::~control_socket()
+{
+    HC_LOG_TRACE("");
+
+    close(m_fd);
+    unlink(m_path.c_str());
+}
+
+int control_socket::get_fd() const
+{
+    HC_LOG_TRACE("");
+    return m_fd;
+}
+
+void control_socket::handle_requests() const
+{
+    HC_LOG_TRACE("");
+
+    for (int fd; (fd = accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0;) {
+        handle_connection(fd);
+        close(fd);
+    }
+}
+
+void control_socket::handle_connection(int fd) const
+{
+    HC_LOG_TRACE("");
+
+    //a slow client gets no or a truncated answer instead of stalling the main loop
+    struct timeval tv = {CONTROL_SOCKET_TIMEOUT, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    std::string line;
+    char buf[256];
+    while (line.find('\n') == std::string::npos && line.size() < CONTROL_SOCKET_MAX_COMMAND) {
+        ssize_t rc = recv(fd, buf, sizeof(buf), 0);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        } else if (rc <= 0) {
+            break;
+        }
+        line.append(buf, rc);
+    }
+
+    std::vector<std::string> args;
+    std::istringstream is(line.substr(0, line.find('\n')));
+    for (std::string arg; is >> arg;) {
+        args.push_back(arg);
+    }
+
+    if (args.empty()) {
+        return;
+    }
+
+    std::string answer = m_handler(args);
+
+    std::size_t pos = 0;
+    while (pos < answer.size()) {
+        ssize_t rc = send(fd, answer.data() + pos, answer.size() - pos, MSG_NOSIGNAL);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        } else if (rc <= 0) {
+            HC_LOG_WARN("failed to answer control command " << args.front());
+            break;
+        }
+        pos += rc;
+    }
+}
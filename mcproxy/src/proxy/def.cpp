@@ -77,6 +77,37 @@ std::string get_mc_filter_name(mc_filter mf)
     return name_map[mf];
 }
 
+std::string get_limit_policy_name(limit_policy lp)
+{
+    std::map<limit_policy, std::string> name_map = {
+        {LP_TRUNCATE, "truncate"},
+        {LP_REJECT,   "reject"  }
+    };
+    return name_map[lp];
+}
+
+bool membership_limits::is_limited() const
+{
+    return max_groups > 0 || max_sources > 0 || max_total_sources > 0;
+}
+
+std::string membership_limits::to_string() const
+{
+    std::ostringstream s;
+    s << "limit";
+    if (max_groups > 0) {
+        s << " groups " << max_groups;
+    }
+    if (max_sources > 0) {
+        s << " sources " << max_sources;
+    }
+    if (max_total_sources > 0) {
+        s << " total_sources " << max_total_sources;
+    }
+    s << " policy " << get_limit_policy_name(policy);
+    return s.str();
+}
+
 std::string get_group_mem_protocol_name(group_mem_protocol gmp)
 {
     std::map<group_mem_protocol, std::string> name_map = {
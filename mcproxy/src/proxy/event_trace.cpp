@@ -0,0 +1,518 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/event_trace.hpp"
+#include "include/proxy/message_format.hpp"
+#include "include/proxy/message_pool.hpp"
+#include "include/proxy/proxy_instance.hpp"
+#include "include/proxy/interfaces.hpp"
+#include "include/proxy/timing.hpp"
+#include "include/parser/interface.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <future>
+#include <map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+const char event_trace_magic[4] = {'M', 'C', 'P', 'T'};
+
+//the trace is replayed on the same kind of host, the values are stored in host byte order
+template<typename T>
+void put(std::vector<char>& buf, T value)
+{
+    const char* p = reinterpret_cast<const char*>(&value);
+    buf.insert(buf.end(), p, p + sizeof(value));
+}
+
+void put_string(std::vector<char>& buf, const std::string& s)
+{
+    put<uint16_t>(buf, s.size());
+    buf.insert(buf.end(), s.begin(), s.end());
+}
+
+void put_addr(std::vector<char>& buf, const mc_addr& addr)
+{
+    if (!addr.is_valid()) {
+        put<uint8_t>(buf, 0);
+    } else if (addr.get_addr_family() == AF_INET) {
+        put<uint8_t>(buf, 4);
+        put(buf, addr.get_in_addr());
+    } else {
+        put<uint8_t>(buf, 6);
+        put(buf, addr.get_in6_addr());
+    }
+}
+
+//bounds checked access to a record
+class trace_reader
+{
+private:
+    const char* m_buf;
+    size_t m_size;
+    size_t m_pos;
+    bool m_ok;
+
+public:
+    trace_reader(const char* buf, size_t size)
+        : m_buf(buf)
+        , m_size(size)
+        , m_pos(0)
+        , m_ok(true) {}
+
+    void get_bytes(void* data, size_t size) {
+        if (!m_ok || size > m_size - m_pos) {
+            m_ok = false;
+            std::memset(data, 0, size);
+            return;
+        }
+        std::memcpy(data, m_buf + m_pos, size);
+        m_pos += size;
+    }
+
+    template<typename T>
+    T get() {
+        T value;
+        get_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::string get_string() {
+        uint16_t size = get<uint16_t>();
+        if (!m_ok || size > m_size - m_pos) {
+            m_ok = false;
+            return std::string();
+        }
+        std::string s(m_buf + m_pos, size);
+        m_pos += size;
+        return s;
+    }
+
+    mc_addr get_addr() {
+        uint8_t family = get<uint8_t>();
+        if (family == 4) {
+            return mc_addr(get<in_addr>());
+        } else if (family == 6) {
+            return mc_addr(get<in6_addr>());
+        } else if (family != 0) {
+            m_ok = false;
+        }
+        return mc_addr();
+    }
+
+    //a sub reader for the next length bytes
+    trace_reader get_reader(size_t length) {
+        if (!m_ok || length > m_size - m_pos) {
+            m_ok = false;
+            return trace_reader(nullptr, 0);
+        }
+        trace_reader r(m_buf + m_pos, length);
+        m_pos += length;
+        return r;
+    }
+
+    bool is_ok() const {
+        return m_ok;
+    }
+
+    bool at_end() const {
+        return m_pos == m_size;
+    }
+};
+
+//signals the replay that all events before it are handled
+struct replay_done_msg : public proxy_msg {
+    replay_done_msg(std::promise<void>& done)
+        : proxy_msg(TEST_MSG, LOSEABLE)
+        , m_done(done) {
+    }
+
+    virtual void operator()() override {
+        m_done.set_value();
+    }
+
+private:
+    std::promise<void>& m_done;
+};
+}
+
+event_trace::event_trace(const std::string& path, group_mem_protocol gmp)
+    : m_fd(-1)
+    , m_start(std::chrono::steady_clock::now())
+{
+    HC_LOG_TRACE("");
+
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        HC_LOG_ERROR("failed to create event trace " << path << "! Error: " << strerror(errno) << " errno: " << errno);
+        throw "failed to create event trace";
+    }
+
+    m_buf.reserve(EVENT_TRACE_BUFFER_SIZE * 2);
+    m_buf.insert(m_buf.end(), event_trace_magic, event_trace_magic + sizeof(event_trace_magic));
+    put<uint16_t>(m_buf, EVENT_TRACE_FORMAT_VERSION);
+    put<uint8_t>(m_buf, gmp);
+}
+
+event_trace::~event_trace()
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    flush();
+    close(m_fd);
+}
+
+void event_trace::flush()
+{
+    HC_LOG_TRACE("");
+
+    size_t pos = 0;
+    while (pos < m_buf.size()) {
+        ssize_t rc = write(m_fd, m_buf.data() + pos, m_buf.size() - pos);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to write event trace! Error: " << strerror(errno) << " errno: " << errno);
+            break;
+        }
+        pos += rc;
+    }
+    m_buf.clear();
+}
+
+void event_trace::record(const std::shared_ptr<proxy_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    //length (without itself), event type, time since the start of the trace in usec, event data
+    size_t begin = m_buf.size();
+    put<uint32_t>(m_buf, 0);
+    put<uint8_t>(m_buf, 0);
+    put<uint64_t>(m_buf, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+
+    event_type type;
+    switch (msg->get_type()) {
+    case proxy_msg::GROUP_RECORD_MSG: {
+        auto r = std::static_pointer_cast<group_record_msg>(msg);
+        type = ET_GROUP_RECORD;
+        put<uint32_t>(m_buf, r->get_if_index());
+        put<uint8_t>(m_buf, r->get_record_type());
+        put<uint8_t>(m_buf, r->get_grp_mem_proto());
+        put_addr(m_buf, r->get_gaddr());
+        put_addr(m_buf, r->get_host());
+        put<uint32_t>(m_buf, r->get_slist().size());
+        for (auto & e : r->get_slist()) {
+            put_addr(m_buf, e.saddr);
+        }
+    }
+    break;
+    case proxy_msg::NEW_SOURCE_MSG: {
+        auto s = std::static_pointer_cast<new_source_msg>(msg);
+        type = ET_NEW_SOURCE;
+        put<uint32_t>(m_buf, s->get_if_index());
+        put_addr(m_buf, s->get_gaddr());
+        put_addr(m_buf, s->get_saddr());
+    }
+    break;
+    case proxy_msg::CONFIG_MSG: {
+        auto c = std::static_pointer_cast<config_msg>(msg);
+        type = ET_CONFIG;
+        bool global = c->get_instruction() == config_msg::SET_GLOBAL_RULE_BINDING;
+        unsigned int if_index = global ? 0 : c->get_if_index();
+        put<uint8_t>(m_buf, c->get_instruction());
+        put<uint32_t>(m_buf, if_index);
+        put<uint32_t>(m_buf, c->get_instruction() == config_msg::ADD_UPSTREAM || c->get_instruction() == config_msg::SET_UPSTREAM ? c->get_upstream_priority() : 0);
+        put_string(m_buf, global ? std::string() : interfaces::get_if_name(if_index));
+
+        const timers_values& tv = c->get_timers_values();
+        put<uint32_t>(m_buf, tv.get_robustness_variable());
+        put<uint32_t>(m_buf, tv.get_query_interval().count());
+        put<uint32_t>(m_buf, tv.get_query_response_interval().count());
+        put<uint32_t>(m_buf, tv.get_startup_query_interval().count());
+        put<uint32_t>(m_buf, tv.get_startup_query_count());
+        put<uint32_t>(m_buf, tv.get_last_listener_query_interval().count());
+        put<uint32_t>(m_buf, tv.get_last_listener_query_count());
+        put<uint32_t>(m_buf, tv.get_unsolicited_report_interval().count());
+    }
+    break;
+    case proxy_msg::UPSTREAM_QUERY_MSG: {
+        auto q = std::static_pointer_cast<upstream_query_msg>(msg);
+        type = ET_UPSTREAM_QUERY;
+        put<uint32_t>(m_buf, q->get_if_index());
+        put_addr(m_buf, q->get_gaddr());
+        put<uint32_t>(m_buf, q->get_max_resp_time().count());
+    }
+    break;
+    case proxy_msg::QUERIER_QUERY_MSG: {
+        auto q = std::static_pointer_cast<querier_query_msg>(msg);
+        type = ET_QUERIER_QUERY;
+        put<uint32_t>(m_buf, q->get_if_index());
+        put_addr(m_buf, q->get_querier());
+        put_addr(m_buf, q->get_gaddr());
+        put<uint8_t>(m_buf, q->is_suppressed());
+    }
+    break;
+    case proxy_msg::TIMER_BATCH_MSG:
+        m_buf.resize(begin);
+        for (auto & e : std::static_pointer_cast<timer_batch_msg>(msg)->get_timers()) {
+            record_timer(e);
+        }
+        return;
+    default:
+        m_buf.resize(begin);
+        record_timer(msg);
+        return;
+    }
+
+    uint32_t length = m_buf.size() - begin - sizeof(uint32_t);
+    std::memcpy(m_buf.data() + begin, &length, sizeof(length));
+    m_buf[begin + sizeof(uint32_t)] = type;
+
+    if (m_buf.size() >= EVENT_TRACE_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void event_trace::record_timer(const std::shared_ptr<proxy_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    switch (msg->get_type()) {
+    case proxy_msg::FILTER_TIMER_MSG:
+    case proxy_msg::SOURCE_TIMER_MSG:
+    case proxy_msg::NEW_SOURCE_TIMER_MSG:
+    case proxy_msg::RET_GROUP_TIMER_MSG:
+    case proxy_msg::RET_SOURCE_TIMER_MSG:
+    case proxy_msg::OLDER_HOST_PRESENT_TIMER_MSG:
+    case proxy_msg::GENERAL_QUERY_TIMER_MSG:
+    case proxy_msg::UPSTREAM_REPORT_TIMER_MSG:
+        break;
+    default:
+        return;
+    }
+
+    auto t = std::static_pointer_cast<timer_msg>(msg);
+    uint32_t length = sizeof(uint8_t) + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint32_t);
+    size_t begin = m_buf.size();
+    put<uint32_t>(m_buf, 0);
+    put<uint8_t>(m_buf, ET_TIMER);
+    put<uint64_t>(m_buf, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+    put<uint8_t>(m_buf, t->get_type());
+    put<uint32_t>(m_buf, t->get_if_index());
+    put_addr(m_buf, t->get_gaddr());
+    length = m_buf.size() - begin - sizeof(uint32_t);
+    std::memcpy(m_buf.data() + begin, &length, sizeof(length));
+
+    if (m_buf.size() >= EVENT_TRACE_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+bool event_trace::replay(const std::string& path)
+{
+    HC_LOG_TRACE("");
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        HC_LOG_ERROR("failed to open event trace " << path);
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    std::string data = content.str();
+
+    trace_reader r(data.data(), data.size());
+    char magic[sizeof(event_trace_magic)];
+    r.get_bytes(magic, sizeof(magic));
+    uint16_t version = r.get<uint16_t>();
+    auto gmp = static_cast<group_mem_protocol>(r.get<uint8_t>());
+    if (!r.is_ok() || std::memcmp(magic, event_trace_magic, sizeof(magic)) != 0 || version != EVENT_TRACE_FORMAT_VERSION) {
+        HC_LOG_ERROR("failed to read event trace " << path << ", unknown format");
+        return false;
+    }
+
+    proxy_instance pr_i(gmp, "replay", 0, std::make_shared<interfaces>(get_addr_family(gmp), false), std::make_shared<timing>(), true);
+
+    //the debug output of the proxy instance would dominate the measurement
+    std::streambuf* cout_buf = std::cout.rdbuf(nullptr);
+
+    //recorded if_index, if_index of this host
+    std::map<unsigned int, unsigned int> if_indexes;
+    auto get_if_index = [&](unsigned int recorded) {
+        auto it = if_indexes.find(recorded);
+        return it != std::end(if_indexes) ? it->second : INTERFACES_UNKOWN_IF_INDEX;
+    };
+
+    std::map<event_type, unsigned long long> replayed;
+    unsigned long long skipped = 0;
+    uint64_t trace_time = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (r.is_ok() && !r.at_end()) {
+        uint32_t length = r.get<uint32_t>();
+        trace_reader e = r.get_reader(length);
+        auto type = static_cast<event_type>(e.get<uint8_t>());
+        trace_time = e.get<uint64_t>();
+
+        std::shared_ptr<proxy_msg> msg;
+        const worker* target = &pr_i;
+
+        switch (type) {
+        case ET_GROUP_RECORD: {
+            unsigned int if_index = get_if_index(e.get<uint32_t>());
+            auto record_type = static_cast<mcast_addr_record_type>(e.get<uint8_t>());
+            auto grp_mem_proto = static_cast<group_mem_protocol>(e.get<uint8_t>());
+            mc_addr gaddr = e.get_addr();
+            mc_addr host = e.get_addr();
+            source_list<source> slist;
+            for (uint32_t i = e.get<uint32_t>(); i > 0 && e.is_ok(); --i) {
+                slist.insert(source(e.get_addr()));
+            }
+            if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
+                target = pr_i.get_querier_worker(if_index, gaddr);
+                msg = make_pooled_msg<group_record_msg>(if_index, record_type, gaddr, std::move(slist), grp_mem_proto, host);
+
+                //the latencies of the pipeline stages are measured from the injection
+                msg->set_origin(std::chrono::steady_clock::now());
+            }
+        }
+        break;
+        case ET_NEW_SOURCE: {
+            unsigned int if_index = get_if_index(e.get<uint32_t>());
+            mc_addr gaddr = e.get_addr();
+            mc_addr saddr = e.get_addr();
+            if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
+                msg = make_pooled_msg<new_source_msg>(if_index, gaddr, saddr);
+            }
+        }
+        break;
+        case ET_CONFIG: {
+            auto instruction = static_cast<config_msg::config_instruction>(e.get<uint8_t>());
+            unsigned int recorded = e.get<uint32_t>();
+            unsigned int priority = e.get<uint32_t>();
+            std::string if_name = e.get_string();
+
+            timers_values tv;
+            tv.set_robustness_variable(e.get<uint32_t>());
+            tv.set_query_interval(std::chrono::seconds(e.get<uint32_t>()));
+            tv.set_query_response_interval(std::chrono::milliseconds(e.get<uint32_t>()));
+            tv.set_startup_query_interval(std::chrono::seconds(e.get<uint32_t>()));
+            tv.set_startup_query_count(e.get<uint32_t>());
+            tv.set_last_listener_query_interval(std::chrono::milliseconds(e.get<uint32_t>()));
+            tv.set_last_listener_query_count(e.get<uint32_t>());
+            tv.set_unsolicited_report_interval(std::chrono::milliseconds(e.get<uint32_t>()));
+
+            //the rule bindings are not recorded
+            unsigned int if_index = if_name.empty() ? INTERFACES_UNKOWN_IF_INDEX : interfaces::get_if_index(if_name);
+            if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
+                if_indexes[recorded] = if_index;
+                if (instruction == config_msg::ADD_DOWNSTREAM) {
+                    msg = std::make_shared<config_msg>(instruction, if_index, std::make_shared<interface>(if_name), tv);
+                } else {
+                    msg = std::make_shared<config_msg>(instruction, if_index, priority, std::make_shared<interface>(if_name));
+                }
+            }
+        }
+        break;
+        case ET_UPSTREAM_QUERY: {
+            unsigned int if_index = get_if_index(e.get<uint32_t>());
+            mc_addr gaddr = e.get_addr();
+            std::chrono::milliseconds max_resp_time(e.get<uint32_t>());
+            if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
+                msg = make_pooled_msg<upstream_query_msg>(if_index, gaddr, max_resp_time);
+            }
+        }
+        break;
+        case ET_QUERIER_QUERY: {
+            unsigned int if_index = get_if_index(e.get<uint32_t>());
+            mc_addr querier = e.get_addr();
+            mc_addr gaddr = e.get_addr();
+            bool suppress = e.get<uint8_t>() != 0;
+            if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
+                msg = make_pooled_msg<querier_query_msg>(if_index, querier, gaddr, suppress);
+            }
+        }
+        break;
+        case ET_TIMER:
+            //the queriers detect their timers by identity, the timing of the replay starts them
+            replayed[type]++;
+            continue;
+        default:
+            HC_LOG_WARN("unknown event type in event trace: " << static_cast<int>(type));
+            break;
+        }
+
+        if (!e.is_ok()) {
+            break;
+        }
+
+        if (msg != nullptr) {
+            //wait for a full job queue instead of dropping the event
+            target->add_msg_with_policy(msg, MQ_BLOCK);
+            replayed[type]++;
+        } else {
+            ++skipped;
+        }
+    }
+
+    std::promise<void> done;
+    pr_i.add_msg_with_policy(std::make_shared<replay_done_msg>(done), MQ_BLOCK);
+    done.get_future().wait();
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    std::cout.rdbuf(cout_buf);
+
+    if (!r.is_ok()) {
+        HC_LOG_ERROR("event trace " << path << " is truncated");
+        std::cout << "event trace is truncated" << std::endl;
+    }
+
+    unsigned long long events = 0;
+    for (auto & e : replayed) {
+        if (e.first != ET_TIMER) {
+            events += e.second;
+        }
+    }
+
+    double sec = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000000.0;
+    std::cout << "replayed events: " << events << " (group records: " << replayed[ET_GROUP_RECORD] << ", new sources: " << replayed[ET_NEW_SOURCE] << ", config: " << replayed[ET_CONFIG] << ", upstream queries: " << replayed[ET_UPSTREAM_QUERY] << ", querier queries: " << replayed[ET_QUERIER_QUERY] << ")" << std::endl;
+    std::cout << "skipped events: " << skipped << ", recorded timer expiries: " << replayed[ET_TIMER] << std::endl;
+    std::cout << "trace duration: " << trace_time / 1000000.0 << " sec, replay duration: " << sec << " sec" << std::endl;
+    if (sec > 0) {
+        std::cout << "throughput: " << static_cast<unsigned long long>(events / sec) << " events/sec, mean time per event: " << sec * 1000000000.0 / std::max(events, 1ULL) << " nsec" << std::endl;
+    }
+
+    return r.is_ok();
+}
@@ -24,6 +24,8 @@
 #include "include/proxy/igmp_receiver.hpp"
 #include "include/proxy/proxy_instance.hpp"
 #include "include/proxy/message_format.hpp"
+#include "include/proxy/report_view.hpp"
+#include "include/proxy/timers_values.hpp"
 #include "include/utils/extended_igmp_defines.hpp"
 
 #include <net/if.h>
@@ -31,6 +33,8 @@
 #include <netinet/igmp.h>
 #include <netinet/ip.h>
 
+using igmpv3_report_view = report_view<igmpv3_mc_report, igmpv3_mc_record, in_addr>;
+
 #ifdef DEBUG_MODE
 extern "C" {
 void print_buf(const unsigned char * buf, unsigned int size)
@@ -81,6 +85,12 @@ igmp_receiver::igmp_receiver(proxy_instance* pr_i, const std::shared_ptr<const m
     start();
 }
 
+igmp_receiver::~igmp_receiver()
+{
+    HC_LOG_TRACE("");
+    stop();
+}
+
 int igmp_receiver::get_iov_min_size()
 {
     HC_LOG_TRACE("");
@@ -96,7 +106,38 @@ int igmp_receiver::get_ctrl_min_size()
     return 0;
 }
 
-void igmp_receiver::analyse_packet(struct msghdr* msg, int)
+void igmp_receiver::get_socket_filter(std::vector<struct sock_filter>& filter)
+{
+    HC_LOG_TRACE("");
+
+    //accept kernel messages, IGMP reports and leaves and the queries (querier election, native upstream reports)
+    filter = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9), //ip_p
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IGMP_RECEIVER_KERNEL_MSG, FILTER_ACCEPT, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_IGMP, 0, FILTER_DROP),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0), //ip_hl * 4
+        BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0), //igmp_type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IGMP_V2_MEMBERSHIP_REPORT, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IGMP_V2_LEAVE_GROUP, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IGMP_V3_MEMBERSHIP_REPORT, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IGMP_MEMBERSHIP_QUERY, FILTER_CHECK_INTERFACE, FILTER_DROP)
+    };
+}
+
+unsigned int igmp_receiver::get_if_index(struct msghdr* msg, const addr_storage& saddr) const
+{
+    HC_LOG_TRACE("");
+
+    for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != nullptr; cmsgptr = CMSG_NXTHDR(msg, cmsgptr)) {
+        if (cmsgptr->cmsg_len > 0 && cmsgptr->cmsg_level == IPPROTO_IP && cmsgptr->cmsg_type == IP_PKTINFO) {
+            return reinterpret_cast<struct in_pktinfo*>(CMSG_DATA(cmsgptr))->ipi_ifindex;
+        }
+    }
+
+    return m_interfaces->get_if_index(saddr);
+}
+
+void igmp_receiver::analyse_packet(struct msghdr* msg, int info_size)
 {
     HC_LOG_TRACE("");
 
@@ -115,7 +156,8 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
         struct igmpmsg *igmpctl = (struct igmpmsg *) msg->msg_iov->iov_base;
 
         switch (igmpctl->im_msgtype) {
-        case IGMPMSG_NOCACHE: {
+        case IGMPMSG_NOCACHE:
+        case IGMPMSG_WRONGVIF: { //a source on a downstream matching the wildcard route of an upstream
             saddr = igmpctl->im_src;
             HC_LOG_DEBUG("\tsaddr: " << saddr);
 
@@ -133,7 +175,7 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
                 return;
             }
 
-            m_proxy_instance->add_msg(std::make_shared<new_source_msg>(if_index, gaddr, saddr));
+            send_new_source(if_index, gaddr, saddr);
             break;
         }
         default:
@@ -146,7 +188,7 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
             saddr = ip_hdr->ip_src;
             HC_LOG_DEBUG("\tsrc: " << saddr);
 
-            if ((if_index = m_interfaces->get_if_index(saddr)) == 0) {
+            if ((if_index = get_if_index(msg, saddr)) == 0) {
                 return;
             }
 
@@ -162,26 +204,23 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
 
             if (igmp_hdr->igmp_type == IGMP_V2_MEMBERSHIP_REPORT) {
                 HC_LOG_DEBUG("\treport received");
-                m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, MODE_IS_EXCLUDE, gaddr, source_list<source>(), IGMPv2));
+                send_record(if_index, MODE_IS_EXCLUDE, gaddr, source_list<source>(), IGMPv2, saddr);
             } else if (igmp_hdr->igmp_type == IGMP_V2_LEAVE_GROUP) {
                 HC_LOG_DEBUG("\tleave group received");
-                m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, CHANGE_TO_INCLUDE_MODE, gaddr, source_list<source>(), IGMPv2));
+                send_record(if_index, CHANGE_TO_INCLUDE_MODE, gaddr, source_list<source>(), IGMPv2, saddr);
             } else {
                 HC_LOG_ERROR("unkown igmp type: " << igmp_hdr->igmp_type); 
             }
         } else if (igmp_hdr->igmp_type == IGMP_V3_MEMBERSHIP_REPORT) {
             HC_LOG_DEBUG("IGMP_V3_MEMBERSHIP_REPORT received");
 
-            igmpv3_mc_report* v3_report = reinterpret_cast<igmpv3_mc_report*>(igmp_hdr);
-            igmpv3_mc_record* rec = reinterpret_cast<igmpv3_mc_record*>(reinterpret_cast<unsigned char*>(v3_report) + sizeof(igmpv3_mc_report));
-
-            int num_records = ntohs(v3_report->num_of_mc_records);
-            HC_LOG_DEBUG("\tnum of multicast records: " << num_records);
+            int report_size = info_size - ip_hdr->ip_hl * 4;
+            igmpv3_report_view report(igmp_hdr, report_size < 0 ? 0 : report_size);
 
             saddr = ip_hdr->ip_src;
             HC_LOG_DEBUG("\tsaddr: " << saddr);
 
-            if ((if_index = m_interfaces->get_if_index(saddr)) == 0) {
+            if ((if_index = get_if_index(msg, saddr)) == 0) {
                 HC_LOG_DEBUG("no if_index found");
                 return;
             }
@@ -192,27 +231,19 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
                 return;
             }
 
-            for (int i = 0; i < num_records; ++i) {
-                mcast_addr_record_type rec_type = static_cast<mcast_addr_record_type>(rec->type);
-                unsigned int aux_size = rec->aux_data_len * 4; //RFC 3376 Section 4.2.6 Aux Data Len
-                int nos = ntohs(rec->num_of_srcs);
+            igmpv3_report_view::record rec;
+            while (report.next(rec)) {
+                mcast_addr_record_type rec_type = rec.get_record_type();
 
-                gaddr = addr_storage(rec->gaddr);
+                gaddr = rec.get_gaddr();
                 source_list<source> slist;
-
-                in_addr* src = reinterpret_cast<in_addr*>(reinterpret_cast<unsigned char*>(rec) + sizeof(igmpv3_mc_record));
-                for (int j = 0; j < nos; ++j) {
-                    slist.insert(addr_storage(*src));
-                    ++src;
-                }
+                report.get_slist(rec, slist);
 
                 HC_LOG_DEBUG("\trecord type: " << get_mcast_addr_record_type_name(rec_type));
                 HC_LOG_DEBUG("\tgaddr: " << gaddr);
                 HC_LOG_DEBUG("\tnumber of sources: " << slist.size());
                 HC_LOG_DEBUG("\tsource_list: " << slist);
-                m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, rec_type, gaddr, move(slist), IGMPv3));
-
-                rec = reinterpret_cast<igmpv3_mc_record*>(reinterpret_cast<unsigned char*>(rec) + sizeof(igmpv3_mc_record) + nos * sizeof(in_addr) + aux_size);
+                send_record(if_index, rec_type, gaddr, std::move(slist), IGMPv3, saddr);
             }
 
         } else if (igmp_hdr->igmp_type == IGMP_V1_MEMBERSHIP_REPORT) {
@@ -220,7 +251,42 @@ void igmp_receiver::analyse_packet(struct msghdr* msg, int)
             HC_LOG_WARN("protocol not supported");
         } else if (igmp_hdr->igmp_type == IGMP_MEMBERSHIP_QUERY) {
             HC_LOG_DEBUG("IGMP_MEMBERSHIP_QUERY received");
-            HC_LOG_WARN("querier election is not implemented");
+
+            saddr = ip_hdr->ip_src;
+            HC_LOG_DEBUG("\tsaddr: " << saddr);
+
+            if ((if_index = get_if_index(msg, saddr)) == 0) {
+                HC_LOG_DEBUG("no if_index found");
+                return;
+            }
+            HC_LOG_DEBUG("\treceived on interface:" << interfaces::get_if_name(if_index));
+
+            if (!is_if_index_relevant(if_index)) {
+                HC_LOG_DEBUG("interface is not relevant");
+                return;
+            }
+
+            //IGMPv3 queries are longer than 8 bytes, IGMPv2 queries carry the maximum response time
+            //in 1/10 seconds and IGMPv1 queries have none (10 seconds)
+            std::chrono::milliseconds max_resp_time(igmp_hdr->igmp_code * 100);
+            bool suppress = false;
+            if (info_size - ip_hdr->ip_hl * 4 >= static_cast<int>(sizeof(igmpv3_query))) {
+                max_resp_time = timers_values().maxrespc_igmpv3_to_maxrespi(igmp_hdr->igmp_code);
+
+                //the sources of a group-and-source-specific query are not evaluated, it keeps the group timer
+                auto v3_hdr = reinterpret_cast<struct igmpv3_query*>(igmp_hdr);
+                suppress = v3_hdr->suppress || ntohs(v3_hdr->num_of_srcs) > 0;
+            } else if (igmp_hdr->igmp_code == 0) {
+                max_resp_time = std::chrono::milliseconds(10000);
+            }
+
+            gaddr = igmp_hdr->igmp_group;
+            HC_LOG_DEBUG("\tgroup: " << gaddr);
+            send_querier_query(if_index, saddr, gaddr, suppress);
+
+            if (m_proxy_instance->has_native_reports()) {
+                send_upstream_query(if_index, gaddr, max_resp_time);
+            }
         } else {
             HC_LOG_WARN("unknown IGMP-packet");
             HC_LOG_WARN("type: " << igmp_hdr->igmp_type);
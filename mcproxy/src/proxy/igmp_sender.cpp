@@ -31,8 +31,10 @@
 #include <net/if.h>
 
 #include <memory>
+#include <cstring>
+#include <algorithm>
 
-igmp_sender::igmp_sender(const std::shared_ptr<const interfaces>& interfaces): sender(interfaces, IGMPv3)
+igmp_sender::igmp_sender(const std::shared_ptr<const interfaces>& interfaces, bool native_reports): sender(interfaces, IGMPv3, native_reports)
 {
     HC_LOG_TRACE("");
 
@@ -50,20 +52,10 @@ bool igmp_sender::send_record(unsigned int if_index, mc_filter filter_mode, cons
 {
     HC_LOG_TRACE("");
 
-    if (filter_mode == INCLUDE_MODE && slist.empty() ) {
-        m_sock.leave_group(gaddr, if_index);
-        return true;
-    } else if (filter_mode == EXCLUDE_MODE || filter_mode == INCLUDE_MODE) {
-        m_sock.join_group(gaddr, if_index);
-        std::list<addr_storage> src_list;
-        for (auto & e : slist) {
-            src_list.push_back(e.saddr);
-        }
-
-        return m_sock.set_source_filter(if_index, gaddr, filter_mode, src_list);
+    if (m_native_reports) {
+        return set_report_state(if_index, filter_mode, gaddr, slist);
     } else {
-        HC_LOG_ERROR("unknown filter mode");
-        return false;
+        return set_socket_filter(if_index, filter_mode, gaddr, slist);
     }
 }
 
@@ -119,21 +111,77 @@ bool igmp_sender::send_mc_addr_and_src_specific_query(unsigned int if_index, con
     return rc;
 }
 
+uint64_t igmp_sender::fill_query_template(unsigned int if_index, unsigned char* packet) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_query_templates_lock);
+
+    query_template& t = m_query_templates[if_index];
+    if (t.m_header.empty() || t.m_generation != m_interfaces->get_generation()) {
+        t.m_generation = m_interfaces->get_generation();
+        t.m_header.assign(sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query), 0);
+
+        ip* ip_hdr = reinterpret_cast<ip*>(t.m_header.data());
+        ip_hdr->ip_v = 4;
+        ip_hdr->ip_hl = (sizeof(ip) + sizeof(router_alert_option)) / 4;
+        ip_hdr->ip_off = htons(0 | IP_DF); //dont fragment flag
+        ip_hdr->ip_ttl = 1;
+        ip_hdr->ip_p = IPPROTO_IGMP;
+        ip_hdr->ip_src = m_interfaces->get_saddr(if_index).get_in_addr();
+
+        router_alert_option* ra_hdr = reinterpret_cast<router_alert_option*>(t.m_header.data() + sizeof(ip));
+        *ra_hdr = router_alert_option();
+
+        t.m_ip_sum = mroute_socket::checksum_add(0, t.m_header.data(), sizeof(ip) + sizeof(router_alert_option));
+
+        igmpv3_query* query = reinterpret_cast<igmpv3_query*>(t.m_header.data() + sizeof(ip) + sizeof(router_alert_option));
+        query->igmp_type = IGMP_MEMBERSHIP_QUERY;
+    }
+
+    memcpy(packet, t.m_header.data(), t.m_header.size());
+    return t.m_ip_sum;
+}
+
+void igmp_sender::complete_ip_header(unsigned char* packet, unsigned int size, const addr_storage& dst_addr, uint64_t ip_sum) const
+{
+    HC_LOG_TRACE("");
+
+    ip* ip_hdr = reinterpret_cast<ip*>(packet);
+    ip_hdr->ip_len = htons(size);
+    ip_hdr->ip_dst = dst_addr.get_in_addr();
+
+    ip_sum = mroute_socket::checksum_add(ip_sum, reinterpret_cast<unsigned char*>(&ip_hdr->ip_len), sizeof(ip_hdr->ip_len));
+    ip_sum = mroute_socket::checksum_add(ip_sum, reinterpret_cast<unsigned char*>(&ip_hdr->ip_dst), sizeof(ip_hdr->ip_dst));
+    ip_hdr->ip_sum = mroute_socket::checksum_fold(ip_sum);
+}
+
 bool igmp_sender::send_igmpv3_query(unsigned int if_index, const timers_values& tv, const addr_storage& gaddr, bool s_flag, const source_list<source>& slist) const
 {
     HC_LOG_TRACE("");
 
-    std::unique_ptr<unsigned char[]> packet;
-    unsigned int size;
+    //the ip header sets the dont fragment flag, split long source lists into packets of the interface mtu
+    unsigned int max_sources = get_max_sources(if_index, sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query), sizeof(in_addr));
+    if (slist.size() > max_sources) {
+        bool rc = true;
+        source_list<source> part;
+        for (auto & e : slist) {
+            part.insert(part.end(), e);
+            if (part.size() == max_sources) {
+                rc = send_igmpv3_query(if_index, tv, gaddr, s_flag, part) && rc;
+                part.clear();
+            }
+        }
 
-    if (slist.empty()) {
-        size = sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query);
-        packet.reset(new unsigned char[size]);
-    } else { //all other types of queries
-        size = sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query) + (slist.size() * sizeof(in_addr));
-        packet.reset(new unsigned char[size]);
+        if (!part.empty()) {
+            rc = send_igmpv3_query(if_index, tv, gaddr, s_flag, part) && rc;
+        }
+        return rc;
     }
 
+    unsigned int size = sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query) + (slist.size() * sizeof(in_addr));
+    std::vector<unsigned char> packet(size);
+
     addr_storage dst_addr;
 
     if (gaddr == addr_storage(AF_INET)) { //is general query
@@ -143,33 +191,12 @@ bool igmp_sender::send_igmpv3_query(unsigned int if_index, const timers_values&
     }
 
     //-------------------------------------------------------------------
-    //fill ip header
-    ip* ip_hdr = reinterpret_cast<ip*>(packet.get());
-
-    ip_hdr->ip_v = 4;
-    ip_hdr->ip_hl = (sizeof(ip) + sizeof(router_alert_option)) / 4;
-    ip_hdr->ip_tos = 0;
-    ip_hdr->ip_len = htons(size);
-    ip_hdr->ip_id = 0;
-    ip_hdr->ip_off = htons(0 | IP_DF); //dont fragment flag
-    ip_hdr->ip_ttl = 1;
-    ip_hdr->ip_p = IPPROTO_IGMP;
-    ip_hdr->ip_sum = 0;
-    ip_hdr->ip_src = m_interfaces->get_saddr(interfaces::get_if_name(if_index)).get_in_addr();
-    ip_hdr->ip_dst = dst_addr.get_in_addr();
-
-    //-------------------------------------------------------------------
-    //fill router_alert_option header
-    router_alert_option* ra_hdr = reinterpret_cast<router_alert_option*>(reinterpret_cast<unsigned char*>(ip_hdr) + sizeof(ip));
-    *ra_hdr = router_alert_option();
-
-    ip_hdr->ip_sum = m_sock.calc_checksum(reinterpret_cast<unsigned char*>(ip_hdr), sizeof(ip) + sizeof(router_alert_option));
+    //ip header and router alert option of the template, add total length and destination address
+    complete_ip_header(packet.data(), size, dst_addr, fill_query_template(if_index, packet.data()));
 
     //-------------------------------------------------------------------
     //fill igmpv3 query
-    igmpv3_query* query = reinterpret_cast<igmpv3_query*>(reinterpret_cast<unsigned char*>(ra_hdr) + sizeof(router_alert_option));
-
-    query->igmp_type = IGMP_MEMBERSHIP_QUERY;
+    igmpv3_query* query = reinterpret_cast<igmpv3_query*>(packet.data() + sizeof(ip) + sizeof(router_alert_option));
 
     if (gaddr == addr_storage(AF_INET)) { //general query
         query->igmp_code = tv.maxrespi_to_maxrespc_igmpv3(tv.get_query_response_interval());
@@ -196,17 +223,64 @@ bool igmp_sender::send_igmpv3_query(unsigned int if_index, const timers_values&
     if (!slist.empty()) {
         in_addr* source_ptr = reinterpret_cast<in_addr*>(reinterpret_cast<unsigned char*>(query) + sizeof(igmpv3_query));
         for (auto & e : slist) {
-            *source_ptr = e.saddr.get_in_addr();
+            *source_ptr = e.saddr.get().get_in_addr();
             source_ptr++;
         }
     }
 
-    query->igmp_cksum = m_sock.calc_checksum(reinterpret_cast<unsigned char*>(query), (sizeof(igmpv3_query) + (slist.size() * sizeof(in_addr))));
+    query->igmp_cksum = mroute_socket::checksum_fold(mroute_socket::checksum_add(0, reinterpret_cast<unsigned char*>(query), (sizeof(igmpv3_query) + (slist.size() * sizeof(in_addr)))));
 
-    if (!m_sock.choose_if(if_index)) {
-        return false;
-    }
+    queue_packet(if_index, dst_addr, std::move(packet));
+    return true;
+}
 
-    return m_sock.send_packet(dst_addr, reinterpret_cast<unsigned char*>(ip_hdr), size);
+void igmp_sender::get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const
+{
+    HC_LOG_TRACE("");
+    header_size = sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_mc_report);
+    record_size = sizeof(igmpv3_mc_record);
+    addr_size = sizeof(in_addr);
 }
 
+void igmp_sender::queue_report(unsigned int if_index, std::vector<report_record>::const_iterator begin, std::vector<report_record>::const_iterator end) const
+{
+    HC_LOG_TRACE("");
+
+    unsigned int size = sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_mc_report);
+    for (auto it = begin; it != end; ++it) {
+        size += sizeof(igmpv3_mc_record) + it->m_slist.size() * sizeof(in_addr);
+    }
+
+    //the ip header and router alert option of the query template are the same for reports, the template
+    //is longer than the report header but a report contains at least one record
+    std::vector<unsigned char> packet(std::max<std::size_t>(size, sizeof(ip) + sizeof(router_alert_option) + sizeof(igmpv3_query)));
+    addr_storage dst_addr(IPV4_IGMPV3_ADDR);
+    complete_ip_header(packet.data(), size, dst_addr, fill_query_template(if_index, packet.data()));
+    packet.resize(size);
+
+    igmpv3_mc_report* report = reinterpret_cast<igmpv3_mc_report*>(packet.data() + sizeof(ip) + sizeof(router_alert_option));
+    report->type = IGMP_V3_MEMBERSHIP_REPORT;
+    report->reservedA = 0;
+    report->checksum = 0;
+    report->reservedB = 0;
+    report->num_of_mc_records = htons(end - begin);
+
+    unsigned char* pos = reinterpret_cast<unsigned char*>(report) + sizeof(igmpv3_mc_report);
+    for (auto it = begin; it != end; ++it) {
+        igmpv3_mc_record* rec = reinterpret_cast<igmpv3_mc_record*>(pos);
+        rec->type = it->m_type;
+        rec->aux_data_len = 0;
+        rec->num_of_srcs = htons(it->m_slist.size());
+        rec->gaddr = it->m_gaddr.get_in_addr();
+        pos += sizeof(igmpv3_mc_record);
+
+        for (auto & e : it->m_slist) {
+            memcpy(pos, &e.saddr.get().get_in_addr(), sizeof(in_addr));
+            pos += sizeof(in_addr);
+        }
+    }
+
+    report->checksum = mroute_socket::checksum_fold(mroute_socket::checksum_add(0, reinterpret_cast<unsigned char*>(report), size - sizeof(ip) - sizeof(router_alert_option)));
+
+    queue_packet(if_index, dst_addr, std::move(packet));
+}
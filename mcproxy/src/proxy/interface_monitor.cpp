@@ -0,0 +1,324 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/interface_monitor.hpp"
+#include "include/utils/thread_settings.hpp"
+
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+interface_monitor::interface_monitor(const change_callback& cb)
+    : m_running(false)
+    , m_thread(nullptr)
+    , m_cb(cb)
+    , m_event_fd(-1)
+    , m_netlink_fd(-1)
+    , m_seq(0)
+    , m_addresses_changed(false)
+    , m_pending(false)
+{
+    HC_LOG_TRACE("");
+    init_fds();
+
+    if (!request_links()) {
+        close_fds();
+        throw "failed to request the link states";
+    }
+
+    start();
+}
+
+interface_monitor::~interface_monitor()
+{
+    HC_LOG_TRACE("");
+    stop();
+    join();
+    close_fds();
+}
+
+void interface_monitor::init_fds()
+{
+    HC_LOG_TRACE("");
+
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_event_fd < 0) {
+        HC_LOG_ERROR("failed to create eventfd! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create eventfd";
+    }
+
+    m_netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_netlink_fd < 0) {
+        HC_LOG_ERROR("failed to create netlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create netlink socket";
+    }
+
+    sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(m_netlink_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        HC_LOG_ERROR("failed to bind netlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to bind netlink socket";
+    }
+}
+
+void interface_monitor::close_fds()
+{
+    HC_LOG_TRACE("");
+
+    for (int* fd : {&m_netlink_fd, &m_event_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool interface_monitor::request_links()
+{
+    HC_LOG_TRACE("");
+
+    struct {
+        nlmsghdr nh;
+        ifinfomsg ifi;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++m_seq;
+    req.ifi.ifi_family = AF_UNSPEC;
+
+    sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    if (sendto(m_netlink_fd, &req, req.nh.nlmsg_len, 0, reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        HC_LOG_ERROR("failed to request the link states! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    return true;
+}
+
+void interface_monitor::receive()
+{
+    HC_LOG_TRACE("");
+
+    alignas(nlmsghdr) char buf[INTERFACE_MONITOR_BUFFER_SIZE];
+
+    while (true) {
+        ssize_t len = recv(m_netlink_fd, buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            } else if (errno == ENOBUFS) {
+                //events are lost, the link states are requested again and the addresses are read again anyway
+                HC_LOG_WARN("netlink events are lost, request the link states again");
+                m_addresses_changed = true;
+                set_pending();
+                request_links();
+                continue;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                HC_LOG_ERROR("failed to receive netlink message! Error: " << strerror(errno) << " errno: " << errno);
+            }
+            return;
+        }
+
+        for (auto nh = reinterpret_cast<const nlmsghdr*>(buf); NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            handle_msg(nh);
+        }
+    }
+}
+
+void interface_monitor::handle_msg(const struct nlmsghdr* nh)
+{
+    HC_LOG_TRACE("");
+
+    switch (nh->nlmsg_type) {
+    case RTM_NEWLINK: {
+        //a new interface (an event, not an answer to request_links()) changes the interface names
+        auto ifi = reinterpret_cast<const ifinfomsg*>(NLMSG_DATA(nh));
+        if (nh->nlmsg_seq == 0 && m_links.find(ifi->ifi_index) == std::end(m_links)) {
+            set_pending();
+        }
+        set_link(ifi->ifi_index, (ifi->ifi_flags & IFF_UP) && (ifi->ifi_flags & IFF_RUNNING));
+    }
+    break;
+    case RTM_DELLINK: {
+        //a deleted interface is not recreated with the same index, it needs a reload of the configuration
+        auto ifi = reinterpret_cast<const ifinfomsg*>(NLMSG_DATA(nh));
+        set_link(ifi->ifi_index, false);
+        m_links.erase(ifi->ifi_index);
+        set_pending();
+    }
+    break;
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+        m_addresses_changed = true;
+        set_pending();
+        break;
+    case NLMSG_ERROR: {
+        auto err = reinterpret_cast<const nlmsgerr*>(NLMSG_DATA(nh));
+        if (err->error != 0) {
+            HC_LOG_ERROR("netlink request failed! Error: " << strerror(-err->error) << " errno: " << -err->error);
+        }
+    }
+    break;
+    default:
+        break;
+    }
+}
+
+void interface_monitor::set_link(unsigned int if_index, bool running)
+{
+    HC_LOG_TRACE("");
+
+    //the first state of a link is only recorded
+    auto it = m_links.find(if_index);
+    if (it == std::end(m_links)) {
+        m_links[if_index] = running;
+        return;
+    }
+
+    if (it->second == running) {
+        return;
+    }
+    it->second = running;
+
+    //only the last transition of a burst is reported
+    if (running) {
+        m_down.erase(if_index);
+        m_up.insert(if_index);
+    } else {
+        m_up.erase(if_index);
+        m_down.insert(if_index);
+    }
+    set_pending();
+}
+
+void interface_monitor::set_pending()
+{
+    HC_LOG_TRACE("");
+
+    if (!m_pending) {
+        m_pending = true;
+        m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(INTERFACE_MONITOR_SETTLE_TIME);
+    }
+}
+
+void interface_monitor::worker_thread()
+{
+    HC_LOG_TRACE("");
+
+    pollfd fds[2];
+    fds[0].fd = m_event_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_netlink_fd;
+    fds[1].events = POLLIN;
+
+    while (m_running) {
+        int timeout = -1;
+        if (m_pending) {
+            auto now = std::chrono::steady_clock::now();
+            timeout = now < m_deadline ? std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - now).count() + 1 : 0;
+        }
+
+        int rc = poll(fds, 2, timeout);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to wait for netlink events! Error: " << strerror(errno) << " errno: " << errno);
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            std::uint64_t count;
+            if (read(m_event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                HC_LOG_ERROR("failed to read eventfd! Error: " << strerror(errno) << " errno: " << errno);
+            }
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            receive();
+        }
+
+        if (m_pending && std::chrono::steady_clock::now() >= m_deadline) {
+            HC_LOG_DEBUG("interface changes: " << m_up.size() << " links up, " << m_down.size() << " links down, addresses changed: " << m_addresses_changed);
+            m_cb(m_up, m_down, m_addresses_changed);
+            m_up.clear();
+            m_down.clear();
+            m_addresses_changed = false;
+            m_pending = false;
+        }
+    }
+}
+
+void interface_monitor::start()
+{
+    HC_LOG_TRACE("");
+
+    if (m_thread.get() == nullptr) {
+        m_running = true;
+        m_thread.reset(new std::thread([this]() {
+            thread_settings::apply(TR_MONITOR, "mcp-monitor");
+            worker_thread();
+        }));
+    } else {
+        HC_LOG_WARN("interface_monitor is already running");
+    }
+}
+
+void interface_monitor::stop()
+{
+    HC_LOG_TRACE("");
+
+    m_running = false;
+
+    std::uint64_t one = 1;
+    if (m_event_fd >= 0 && write(m_event_fd, &one, sizeof(one)) < 0) {
+        HC_LOG_ERROR("failed to wake up interface_monitor thread! Error: " << strerror(errno) << " errno: " << errno);
+    }
+}
+
+void interface_monitor::join() const
+{
+    HC_LOG_TRACE("");
+
+    if (m_thread.get() != nullptr) {
+        m_thread->join();
+    }
+}
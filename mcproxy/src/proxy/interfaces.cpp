@@ -26,7 +26,50 @@
 #include <linux/mroute6.h>
 
 #include <net/if.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
 #include <vector>
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+//interface index <-> name of the network interfaces, shared by all instances and refreshed on interface changes
+struct if_name_table {
+    std::mutex m_lock;
+    std::map<unsigned int, std::string> m_names;
+    std::map<std::string, unsigned int> m_indexes;
+
+    //incremented whenever a name or an index has changed
+    std::atomic<unsigned int> m_generation;
+};
+
+if_name_table& get_if_name_table()
+{
+    static if_name_table table;
+    return table;
+}
+
+//addresses of all interfaces, the source addresses of the senders depend only on them
+std::string get_addresses(const if_prop& prop)
+{
+    std::ostringstream s;
+    auto& props = prop.get_if_index_props();
+    for (unsigned int i = 0; i < props.size(); ++i) {
+        s << i << ":";
+        if (props[i].has_ip4) {
+            s << props[i].ip4.addr << ";";
+        }
+        for (auto & a : props[i].ip6) {
+            s << a.addr << ";";
+        }
+    }
+    return s.str();
+}
+}
+
+std::shared_ptr<const interfaces::if_state> interfaces::m_state;
+std::atomic<unsigned int> interfaces::m_generation(0);
 
 interfaces::interfaces(int addr_family, bool reset_reverse_path_filter)
     : m_addr_family(addr_family)
@@ -42,8 +85,13 @@ interfaces::interfaces(int addr_family, bool reset_reverse_path_filter)
         }
     }
 
-    if (!m_if_prop.refresh_network_interfaces()) {
-        throw "failed to refresh network interfaces";
+    //the interfaces are scanned once for all instances, the configuration scans them again before a reload
+    if (get_state() == nullptr) {
+        if (!refresh_network_interfaces()) {
+            throw "failed to refresh network interfaces";
+        }
+
+        refresh_if_names();
     }
 }
 
@@ -62,6 +110,7 @@ bool interfaces::add_interface(const std::string& if_name)
 bool interfaces::add_interface(unsigned int if_index)
 {
     HC_LOG_TRACE("");
+    std::lock_guard<std::mutex> lock(m_vif_lock);
     int free_vif =  get_free_vif_number();
     HC_LOG_DEBUG("if_index: " << if_index << " (" << interfaces::get_if_name(if_index) << ")" << " free_vif: " << free_vif);
     if (free_vif > INTERFACES_UNKOWN_VIF_INDEX) {
@@ -102,9 +151,12 @@ bool interfaces::del_interface(unsigned int if_index)
 {
     HC_LOG_TRACE("");
     if (if_index != INTERFACES_UNKOWN_IF_INDEX) {
-        int vif = get_virtual_if_index(if_index);
-        m_vif_if.erase(vif);
-        m_if_vif.erase(if_index);
+        std::lock_guard<std::mutex> lock(m_vif_lock);
+        auto it = m_if_vif.find(if_index);
+        if (it != std::end(m_if_vif)) {
+            m_vif_if.erase(it->second);
+            m_if_vif.erase(it);
+        }
 
         if (m_reset_reverse_path_filter) {
             m_reverse_path_filter.restore_rp_filter(get_if_name(if_index));
@@ -119,7 +171,109 @@ bool interfaces::del_interface(unsigned int if_index)
 bool interfaces::refresh_network_interfaces()
 {
     HC_LOG_TRACE("");
-    return m_if_prop.refresh_network_interfaces();
+
+    static std::mutex refresh_lock;
+    std::lock_guard<std::mutex> lock(refresh_lock);
+
+    auto state = std::make_shared<if_state>();
+    if (!state->m_if_prop.refresh_network_interfaces()) {
+        return false;
+    }
+
+    build_ipv4_subnets(*state);
+
+    //a link change keeps the cached source addresses
+    auto last = get_state();
+    if (last == nullptr || get_addresses(last->m_if_prop) != get_addresses(state->m_if_prop)) {
+        ++m_generation;
+    }
+
+    std::atomic_store(&m_state, std::shared_ptr<const if_state>(std::move(state)));
+    return true;
+}
+
+std::shared_ptr<const interfaces::if_state> interfaces::get_state()
+{
+    return std::atomic_load(&m_state);
+}
+
+unsigned int interfaces::get_generation() const
+{
+    HC_LOG_TRACE("");
+    return m_generation;
+}
+
+void interfaces::refresh_if_names()
+{
+    HC_LOG_TRACE("");
+
+    struct if_nameindex* if_ni = if_nameindex();
+    if (if_ni == nullptr) {
+        HC_LOG_WARN("failed to get the interface names");
+        return;
+    }
+
+    std::map<unsigned int, std::string> names;
+    std::map<std::string, unsigned int> indexes;
+    for (auto i = if_ni; i->if_index != 0 && i->if_name != nullptr; ++i) {
+        names[i->if_index] = i->if_name;
+        indexes[i->if_name] = i->if_index;
+    }
+
+    if_freenameindex(if_ni);
+
+    auto& t = get_if_name_table();
+    std::lock_guard<std::mutex> lock(t.m_lock);
+    if (names != t.m_names) {
+        t.m_names.swap(names);
+        t.m_indexes.swap(indexes);
+        ++t.m_generation;
+    }
+}
+
+unsigned int interfaces::get_if_names_generation()
+{
+    return get_if_name_table().m_generation.load(std::memory_order_acquire);
+}
+
+void interfaces::build_ipv4_subnets(if_state& state)
+{
+    HC_LOG_TRACE("");
+
+    auto& subnets = state.m_ipv4_subnets;
+    subnets.clear();
+
+    auto& props = state.m_if_prop.get_if_index_props();
+    for (unsigned int if_index = 0; if_index < props.size(); ++if_index) {
+        const if_index_prop& prop = props[if_index];
+        if (!prop.has_ip4 || prop.ip4.netmask.get_addr_family() != AF_INET) {
+            continue;
+        }
+
+        uint32_t netmask = ntohl(prop.ip4.netmask.get_in_addr().s_addr);
+        uint32_t subnet = ntohl(prop.ip4.addr.get_in_addr().s_addr) & netmask;
+
+        auto it = std::find_if(std::begin(subnets), std::end(subnets), [netmask](const ipv4_subnet_group & g) {
+            return g.m_netmask == netmask;
+        });
+        if (it == std::end(subnets)) {
+            subnets.push_back(ipv4_subnet_group {netmask, {}});
+            it = std::end(subnets) - 1;
+        }
+        it->m_subnets.push_back(ipv4_subnet {subnet, if_index});
+    }
+
+    //longest prefix first
+    std::sort(std::begin(subnets), std::end(subnets), [](const ipv4_subnet_group & l, const ipv4_subnet_group & r) {
+        return l.m_netmask > r.m_netmask;
+    });
+
+    //equal subnets are resolved to the interface with the lowest index
+    for (auto & g : subnets) {
+        std::stable_sort(std::begin(g.m_subnets), std::end(g.m_subnets), [](const ipv4_subnet & l, const ipv4_subnet & r) {
+            return l.m_subnet < r.m_subnet;
+        });
+    }
 }
 
 unsigned int interfaces::get_if_index(const std::string& if_name)
@@ -131,12 +285,32 @@ unsigned int interfaces::get_if_index(const std::string& if_name)
 unsigned int interfaces::get_if_index(const char* if_name)
 {
     HC_LOG_TRACE("");
-    return if_nametoindex(if_name);
+
+    auto& t = get_if_name_table();
+    {
+        std::lock_guard<std::mutex> lock(t.m_lock);
+        auto it = t.m_indexes.find(if_name);
+        if (it != std::end(t.m_indexes)) {
+            return it->second;
+        }
+    }
+
+    //unknown since the last refresh
+    unsigned int if_index = if_nametoindex(if_name);
+    if (if_index != 0) {
+        std::lock_guard<std::mutex> lock(t.m_lock);
+        t.m_names[if_index] = if_name;
+        t.m_indexes[if_name] = if_index;
+        ++t.m_generation;
+    }
+
+    return if_index;
 }
 
 unsigned int interfaces::get_if_index(int virtual_if_index) const
 {
     HC_LOG_TRACE("");
+    std::lock_guard<std::mutex> lock(m_vif_lock);
     auto rc = m_vif_if.find(virtual_if_index);
     if (rc != end(m_vif_if)) {
         return rc->second;
@@ -148,6 +322,7 @@ unsigned int interfaces::get_if_index(int virtual_if_index) const
 
 int interfaces::get_virtual_if_index(unsigned int if_index) const
 {
+    std::lock_guard<std::mutex> lock(m_vif_lock);
     auto rc = m_if_vif.find(if_index);
     if (rc != end(m_if_vif)) {
         return rc->second;
@@ -160,17 +335,44 @@ int interfaces::get_virtual_if_index(unsigned int if_index) const
 }
 
 addr_storage interfaces::get_saddr(const std::string& if_name) const
+{
+    HC_LOG_TRACE("");
+    return get_saddr(get_if_index(if_name));
+}
+
+bool interfaces::get_if_prop(unsigned int if_index, if_index_prop& prop) const
+{
+    HC_LOG_TRACE("");
+
+    auto state = get_state();
+    const if_index_prop* p = state->m_if_prop.get_if_prop(if_index);
+    if (p == nullptr) {
+        return false;
+    }
+
+    prop = *p;
+    return true;
+}
+
+addr_storage interfaces::get_saddr(unsigned int if_index) const
 {
     HC_LOG_TRACE("");
 
+    auto state = get_state();
+    const if_index_prop* prop = state->m_if_prop.get_if_prop(if_index);
+    if (prop == nullptr) {
+        return addr_storage(); //the interface has been removed
+    }
+
     if (m_addr_family == AF_INET) {
-        auto tmp = m_if_prop.get_ip4_if(if_name);
-        return addr_storage(*tmp->ifa_addr);
+        if (prop->has_ip4) {
+            return prop->ip4.addr;
+        } else {
+            return addr_storage(); //the address has been removed
+        }
     } else if  (m_addr_family == AF_INET6) {
-        auto addr_list = m_if_prop.get_ip6_if(if_name);
-        if (addr_list->begin() != addr_list->end()) {
-            const struct ifaddrs* addr = *addr_list->begin();
-            return addr_storage(*addr->ifa_addr);
+        if (!prop->ip6.empty()) {
+            return prop->ip6.front().addr;
         } else {
             return addr_storage();
         }
@@ -180,39 +382,73 @@ addr_storage interfaces::get_saddr(const std::string& if_name) const
     }
 }
 
+addr_storage interfaces::get_link_local_saddr(unsigned int if_index) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_addr_family != AF_INET6) {
+        return get_saddr(if_index);
+    }
+
+    auto state = get_state();
+    const if_index_prop* prop = state->m_if_prop.get_if_prop(if_index);
+    if (prop == nullptr) {
+        return addr_storage(); //the interface has been removed
+    }
+
+    for (auto & e : prop->ip6) {
+        if (IN6_IS_ADDR_LINKLOCAL(&e.addr.get_in6_addr())) {
+            return e.addr;
+        }
+    }
+
+    return addr_storage();
+}
+
 std::string interfaces::get_if_name(unsigned int if_index)
 {
     HC_LOG_TRACE("");
+
+    auto& t = get_if_name_table();
+    {
+        std::lock_guard<std::mutex> lock(t.m_lock);
+        auto it = t.m_names.find(if_index);
+        if (it != std::end(t.m_names)) {
+            return it->second;
+        }
+    }
+
+    //unknown since the last refresh
     char tmp[IF_NAMESIZE];
     const char* if_name = if_indextoname(if_index, tmp);
     if (if_name == nullptr) {
         HC_LOG_WARN("cannot map if_index (#" << if_index << ") to if_name");
         return std::string();
-    } else {
-        return std::string(if_name);
     }
 
+    std::lock_guard<std::mutex> lock(t.m_lock);
+    t.m_names[if_index] = if_name;
+    t.m_indexes[if_name] = if_index;
+    ++t.m_generation;
+    return std::string(if_name);
 }
 
 unsigned int interfaces::get_if_index(const addr_storage& saddr) const
 {
     HC_LOG_TRACE("");
 
-    addr_storage recv_subnet;
-    addr_storage src_subnet;
-
-    const if_prop_map* prop_map;
-
     if (saddr.get_addr_family() == AF_INET) {
-        prop_map = m_if_prop.get_if_props();
-        for (auto & e : *prop_map) {
-            if (e.second.ip4_addr != nullptr && e.second.ip4_addr->ifa_netmask != nullptr && e.second.ip4_addr->ifa_addr != nullptr) {
-                recv_subnet = *e.second.ip4_addr->ifa_netmask;
-                src_subnet = *e.second.ip4_addr->ifa_addr;
-                src_subnet.mask_ipv4(recv_subnet);
-                if (src_subnet == recv_subnet.mask_ipv4(saddr)) {
-                    return get_if_index(e.second.ip4_addr->ifa_name);
-                }
+        uint32_t addr = ntohl(saddr.get_in_addr().s_addr);
+
+        //longest prefix match
+        auto state = get_state();
+        for (auto & g : state->m_ipv4_subnets) {
+            uint32_t subnet = addr & g.m_netmask;
+            auto it = std::lower_bound(std::begin(g.m_subnets), std::end(g.m_subnets), subnet, [](const ipv4_subnet & l, uint32_t r) {
+                return l.m_subnet < r;
+            });
+            if (it != std::end(g.m_subnets) && it->m_subnet == subnet) {
+                return it->m_if_index;
             }
         }
     }else{
@@ -222,18 +458,26 @@ unsigned int interfaces::get_if_index(const addr_storage& saddr) const
     return INTERFACES_UNKOWN_IF_INDEX;
 }
 
-int interfaces::get_free_vif_number() const
+int interfaces::get_max_vifs() const
 {
     HC_LOG_TRACE("");
 
-    int vifs_elements;
-
     if (m_addr_family == AF_INET) {
-        vifs_elements = MAXVIFS;
+        return MAXVIFS;
     } else if (m_addr_family == AF_INET6) {
-        vifs_elements = MAXMIFS;
+        return MAXMIFS;
     } else {
         HC_LOG_ERROR("wrong addr_family: " << m_addr_family);
+        return 0;
+    }
+}
+
+int interfaces::get_free_vif_number() const
+{
+    HC_LOG_TRACE("");
+
+    int vifs_elements = get_max_vifs();
+    if (vifs_elements == 0) {
         return INTERFACES_UNKOWN_VIF_INDEX;
     }
 
@@ -262,18 +506,18 @@ int interfaces::get_free_vif_number() const
 bool interfaces::is_interface(unsigned if_index, unsigned int interface_flags) const
 {
     HC_LOG_TRACE("");
+    auto state = get_state();
+    const if_index_prop* prop = state->m_if_prop.get_if_prop(if_index);
     if (m_addr_family == AF_INET) {
-        const struct ifaddrs* prop = m_if_prop.get_ip4_if(get_if_name(if_index));
-        if (prop != nullptr) {
-            return prop->ifa_flags & interface_flags;
+        if (prop != nullptr && prop->has_ip4) {
+            return prop->flags & interface_flags;
         } else {
             HC_LOG_WARN("failed to get interface ipv4 properties of interface: " << get_if_name(if_index));
             return false;
         }
     } else if (m_addr_family == AF_INET6) {
-        const std::list<const struct ifaddrs*>* prop = m_if_prop.get_ip6_if(get_if_name(if_index));
-        if (prop != nullptr && !prop->empty()) {
-            return (*(begin(*prop)))->ifa_flags & interface_flags;
+        if (prop != nullptr && !prop->ip6.empty()) {
+            return prop->flags & interface_flags;
         } else {
             HC_LOG_WARN("failed to get interface ipv6 properties of interface: " << get_if_name(if_index));
             return false;
@@ -290,6 +534,7 @@ std::string interfaces::to_string() const
     std::ostringstream s;
     s << "##-- interfaces --##" << std::endl;
     s << "virtual interface index mapped to interface:" << std::endl;
+    std::unique_lock<std::mutex> lock(m_vif_lock);
     for (auto e : m_vif_if) {
         s << "vif:" << e.first << " ==> " << "if:" << interfaces::get_if_name(e.second) << " (index:" << e.second <<  ")" << std::endl;
     }
@@ -299,6 +544,7 @@ std::string interfaces::to_string() const
     for (auto e : m_vif_if) {
         s << "if:" << interfaces::get_if_name(e.second) << " (index:" << e.second << ")" <<  " ==> " << "vif:" << e.first <<  std::endl;
     }
+    lock.unlock();
 
     s << std::endl;
     s << "reset reverse path filter: " << m_reset_reverse_path_filter << std::endl;
@@ -28,6 +28,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <algorithm>
 
 #ifdef DEBUG_MODE
 void membership_db::test_arithmetic()
@@ -82,6 +83,133 @@ void membership_db::test_arithmetic()
 }
 #endif /* DEBUG_MODE */
 
+host_tracking::host_tracking()
+    : exclude_hosts(0)
+{
+    HC_LOG_TRACE("");
+}
+
+void host_tracking::update(const mc_addr& host, mcast_addr_record_type record_type, const source_list<source>& slist, std::chrono::steady_clock::time_point expiry)
+{
+    HC_LOG_TRACE("");
+
+    auto it = hosts.find(host);
+    if (it == hosts.end()) {
+        it = hosts.insert(addr_hash_map<host_state>::value_type(host, host_state {INCLUDE_MODE, {}, expiry})).first;
+    } else {
+        del_refs(it->second);
+    }
+
+    host_state& hs = it->second;
+    hs.expiry = expiry;
+
+    source_list<mc_addr> b;
+    b.reserve(slist.size());
+    for (auto & e : slist) {
+        b.insert(b.end(), e.saddr);
+    }
+
+    switch (record_type) {
+    case MODE_IS_INCLUDE:
+    case CHANGE_TO_INCLUDE_MODE:
+        hs.filter_mode = INCLUDE_MODE;
+        hs.slist = std::move(b);
+        break;
+    case MODE_IS_EXCLUDE:
+    case CHANGE_TO_EXCLUDE_MODE:
+        hs.filter_mode = EXCLUDE_MODE;
+        hs.slist = std::move(b);
+        break;
+    case ALLOW_NEW_SOURCES:
+        if (hs.filter_mode == INCLUDE_MODE) {
+            hs.slist.unite(b);
+        } else {
+            hs.slist.subtract(b);
+        }
+        break;
+    case BLOCK_OLD_SOURCES:
+        if (hs.filter_mode == INCLUDE_MODE) {
+            hs.slist.subtract(b);
+        } else {
+            hs.slist.unite(b);
+        }
+        break;
+    default:
+        HC_LOG_ERROR("unknown multicast record type: " << record_type);
+    }
+
+    //the host left the group
+    if (hs.filter_mode == INCLUDE_MODE && hs.slist.empty()) {
+        hosts.erase(it);
+    } else {
+        add_refs(hs);
+    }
+}
+
+void host_tracking::purge(std::chrono::steady_clock::time_point now)
+{
+    HC_LOG_TRACE("");
+
+    for (auto it = hosts.begin(); it != hosts.end();) {
+        if (it->second.expiry <= now) {
+            del_refs(it->second);
+            it = hosts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool host_tracking::is_group_wanted() const
+{
+    HC_LOG_TRACE("");
+    return exclude_hosts > 0;
+}
+
+bool host_tracking::is_source_wanted(const mc_addr& saddr) const
+{
+    HC_LOG_TRACE("");
+
+    if (include_refs.find(saddr) != include_refs.end()) {
+        return true;
+    }
+
+    //a host in EXCLUDE_MODE wants all sources it does not block
+    auto it = exclude_refs.find(saddr);
+    return exclude_hosts > (it != exclude_refs.end() ? it->second : 0);
+}
+
+void host_tracking::add_refs(const host_state& hs)
+{
+    HC_LOG_TRACE("");
+
+    auto& refs = hs.filter_mode == INCLUDE_MODE ? include_refs : exclude_refs;
+    if (hs.filter_mode == EXCLUDE_MODE) {
+        ++exclude_hosts;
+    }
+
+    for (auto & e : hs.slist) {
+        ++refs.insert(addr_hash_map<unsigned int>::value_type(e, 0)).first->second;
+    }
+}
+
+void host_tracking::del_refs(const host_state& hs)
+{
+    HC_LOG_TRACE("");
+
+    auto& refs = hs.filter_mode == INCLUDE_MODE ? include_refs : exclude_refs;
+    if (hs.filter_mode == EXCLUDE_MODE) {
+        --exclude_hosts;
+    }
+
+    for (auto & e : hs.slist) {
+        auto it = refs.find(e);
+        if (it != refs.end() && --it->second == 0) {
+            refs.erase(it);
+        }
+    }
+}
+
 gaddr_info::gaddr_info(group_mem_protocol compatibility_mode_variable)
     : filter_mode(INCLUDE_MODE)
     , shared_filter_timer(nullptr)
@@ -90,11 +218,69 @@ gaddr_info::gaddr_info(group_mem_protocol compatibility_mode_variable)
     , group_retransmission_timer(nullptr)
     , group_retransmission_count(-1) //not in a retransmission state
     , source_retransmission_timer(nullptr)
+    , version(0)
 {
     HC_LOG_TRACE("");
 }
 
 
+membership_size& membership_size::operator+=(const membership_size& r)
+{
+    groups += r.groups;
+    sources += r.sources;
+    bytes += r.bytes;
+    return *this;
+}
+
+membership_size& membership_size::operator-=(const membership_size& r)
+{
+    groups -= r.groups;
+    sources -= r.sources;
+    bytes -= r.bytes;
+    return *this;
+}
+
+downstream_usage::downstream_usage()
+    : groups(0)
+    , sources(0)
+{
+}
+
+membership_size gaddr_info::get_size() const
+{
+    //each value of a hash map has about two slots of 8 bytes
+    membership_size result;
+    result.groups = 1;
+    result.sources = include_requested_list.size() + exclude_list.size();
+    result.bytes = sizeof(gaddr_pair) + 16;
+    result.bytes += (include_requested_list.capacity() + exclude_list.capacity()) * sizeof(source);
+    result.bytes += tracking.hosts.size() * (sizeof(addr_hash_map<host_tracking::host_state>::value_type) + 16);
+    result.bytes += (tracking.include_refs.size() + tracking.exclude_refs.size()) * (sizeof(addr_hash_map<unsigned int>::value_type) + 16);
+    return result;
+}
+
+void gaddr_info::reset(group_mem_protocol compatibility_mode_variable)
+{
+    HC_LOG_TRACE("");
+
+    filter_mode = INCLUDE_MODE;
+    shared_filter_timer.reset();
+    this->compatibility_mode_variable = compatibility_mode_variable;
+    older_host_present_timer.reset();
+    group_retransmission_timer.reset();
+    group_retransmission_count = -1;
+    source_retransmission_timer.reset();
+    source_timer_bucket.reset();
+    include_requested_list.clear();
+    exclude_list.clear();
+    version = 0;
+
+    tracking.hosts.clear();
+    tracking.exclude_hosts = 0;
+    tracking.include_refs.clear();
+    tracking.exclude_refs.clear();
+}
+
 bool gaddr_info::is_in_backward_compatibility_mode() const{
     return !is_newest_version(compatibility_mode_variable);
 }
@@ -145,6 +331,18 @@ std::string gaddr_info::to_string() const
             HC_LOG_ERROR("unknown filter mode");
         }
     }
+
+    if (!tracking.hosts.empty()) {
+        if (filter_mode == EXCLUDE_MODE) {
+            s << endl;
+        }
+
+        s << "tracked hosts(#" << tracking.hosts.size() << ", " << tracking.exclude_hosts << " in exclude mode)";
+
+        if (filter_mode == INCLUDE_MODE) {
+            s << endl;
+        }
+    }
     return s.str();
 }
 
@@ -153,9 +351,71 @@ membership_db::membership_db(group_mem_protocol querier_version_mode)
     , startup_query_count(0)
     , querier_version_mode(querier_version_mode)
     , is_querier(true)
+    , explicit_tracking(false)
+
+{
+    HC_LOG_TRACE("");
+}
+
+gaddr_map::iterator membership_db::add_group(const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+    return group_info.insert(gaddr_pair(gaddr, group_pool.acquire(querier_version_mode))).first;
+}
+
+void membership_db::erase_group(gaddr_map::iterator it)
+{
+    HC_LOG_TRACE("");
+    group_pool.release(std::move(it->second));
+    group_info.erase(it);
+}
+
+gaddr_info gaddr_info_pool::acquire(group_mem_protocol compatibility_mode_variable)
+{
+    HC_LOG_TRACE("");
+
+    if (m_spare.empty()) {
+        return gaddr_info(compatibility_mode_variable);
+    }
+
+    gaddr_info result(std::move(m_spare.back()));
+    m_spare.pop_back();
+    result.compatibility_mode_variable = compatibility_mode_variable;
+    return result;
+}
+
+void gaddr_info_pool::release(gaddr_info&& ginfo)
+{
+    HC_LOG_TRACE("");
 
+    if (m_spare.size() >= GADDR_INFO_POOL_MAX_SPARE) {
+        return; //freed by the caller
+    }
+
+    //the timers are released here, the expired reminders find no group that refers to them
+    ginfo.reset(ginfo.compatibility_mode_variable);
+
+    if (ginfo.include_requested_list.capacity() > GADDR_INFO_POOL_MAX_CAPACITY) {
+        ginfo.include_requested_list.shrink_to_fit();
+    }
+
+    if (ginfo.exclude_list.capacity() > GADDR_INFO_POOL_MAX_CAPACITY) {
+        ginfo.exclude_list.shrink_to_fit();
+    }
+
+    m_spare.push_back(std::move(ginfo));
+}
+
+void gaddr_info_pool::clear()
 {
     HC_LOG_TRACE("");
+    m_spare.clear();
+    m_spare.shrink_to_fit();
+}
+
+std::size_t gaddr_info_pool::size() const
+{
+    return m_spare.size();
 }
 
 std::string membership_db::to_string() const
@@ -170,9 +430,20 @@ std::string membership_db::to_string() const
     s << "startup query count: " << startup_query_count << endl;
 
     s << "subscribed groups: " << group_info.size();
+
+    //the hash map is unordered, sort the groups for a readable output
+    vector<const gaddr_pair*> groups;
+    groups.reserve(group_info.size());
     for (auto & e : group_info) {
-        s << endl << "-- group address: " << e.first << endl;
-        s << indention(e.second.to_string());
+        groups.push_back(&e);
+    }
+    sort(begin(groups), end(groups), [](const gaddr_pair * l, const gaddr_pair * r) {
+        return l->first < r->first;
+    });
+
+    for (auto e : groups) {
+        s << endl << "-- group address: " << e->first << endl;
+        s << indention(e->second.to_string());
     }
 
     return s.str();
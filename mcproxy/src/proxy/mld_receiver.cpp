@@ -24,6 +24,8 @@
 #include "include/hamcast_logging.h"
 #include "include/proxy/mld_receiver.hpp"
 #include "include/proxy/proxy_instance.hpp"
+#include "include/proxy/report_view.hpp"
+#include "include/proxy/timers_values.hpp"
 #include "include/utils/extended_mld_defines.hpp"
 
 #include <linux/mroute6.h>
@@ -34,11 +36,14 @@
 //DEBUG
 #include <net/if.h>
 
+using mldv2_report_view = report_view<mldv2_mc_report, mldv2_mc_record, in6_addr>;
+
 mld_receiver::mld_receiver(proxy_instance* pr_i, const std::shared_ptr<const mroute_socket> mrt_sock, const std::shared_ptr<const interfaces> interfaces, bool in_debug_testing_mode)
     : receiver(pr_i, AF_INET6, mrt_sock, interfaces, in_debug_testing_mode)
 {
     HC_LOG_TRACE("");
-    if (!m_mrt_sock->set_ipv6_recv_icmpv6_msg()) {
+    //the queries are needed for the querier election
+    if (!m_mrt_sock->set_ipv6_recv_icmpv6_msg(true)) {
         throw "failed to set receive icmpv6 message";
     }
 
@@ -49,6 +54,12 @@ mld_receiver::mld_receiver(proxy_instance* pr_i, const std::shared_ptr<const mro
     start();
 }
 
+mld_receiver::~mld_receiver()
+{
+    HC_LOG_TRACE("");
+    stop();
+}
+
 int mld_receiver::get_iov_min_size()
 {
     HC_LOG_TRACE("");
@@ -64,7 +75,22 @@ int mld_receiver::get_ctrl_min_size()
     return sizeof(struct cmsghdr) + sizeof(struct in6_pktinfo);
 }
 
-void mld_receiver::analyse_packet(struct msghdr* msg, int)
+void mld_receiver::get_socket_filter(std::vector<struct sock_filter>& filter)
+{
+    HC_LOG_TRACE("");
+
+    //accept kernel messages, MLD reports and dones and the queries (querier election, native upstream reports)
+    filter = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0), //mld_type
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MLD_RECEIVER_KERNEL_MSG, FILTER_ACCEPT, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MLD_LISTENER_REPORT, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MLD_LISTENER_REDUCTION, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MLD_V2_LISTENER_REPORT, FILTER_CHECK_INTERFACE, 0),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MLD_LISTENER_QUERY, FILTER_CHECK_INTERFACE, FILTER_DROP)
+    };
+}
+
+void mld_receiver::analyse_packet(struct msghdr* msg, int info_size)
 {
     HC_LOG_TRACE("");
 
@@ -82,7 +108,8 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
         struct mrt6msg* mldctl = (struct mrt6msg*)msg->msg_iov->iov_base;
 
         switch (mldctl->im6_msgtype) {
-        case MRT6MSG_NOCACHE: {
+        case MRT6MSG_NOCACHE:
+        case MRT6MSG_WRONGMIF: { //a source on a downstream matching the wildcard route of an upstream
             saddr = mldctl->im6_src;
             HC_LOG_DEBUG("\tsaddr: " << saddr);
 
@@ -99,7 +126,7 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
                 return;
             }
 
-            m_proxy_instance->add_msg(std::make_shared<new_source_msg>(if_index, gaddr, saddr));
+            send_new_source(if_index, gaddr, saddr);
             break;
         }
         default:
@@ -119,6 +146,11 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
             return;
         }
 
+        //address of the reporting host
+        if (msg->msg_name != nullptr && msg->msg_namelen >= sizeof(struct sockaddr_in6)) {
+            saddr = addr_storage(*reinterpret_cast<struct sockaddr_in6*>(msg->msg_name));
+        }
+
         HC_LOG_DEBUG("\tsaddr: " << addr_storage(packet_info->ipi6_addr));
         if_index = packet_info->ipi6_ifindex;
         HC_LOG_DEBUG("\treceived on interface:" << interfaces::get_if_name(if_index));
@@ -133,10 +165,10 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
 
         if (hdr->mld_type == MLD_LISTENER_REPORT) {
             HC_LOG_DEBUG("\treport received");
-            m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, MODE_IS_EXCLUDE, gaddr, source_list<source>(), MLDv1));
+            send_record(if_index, MODE_IS_EXCLUDE, gaddr, source_list<source>(), MLDv1, saddr);
         } else if (hdr->mld_type == MLD_LISTENER_REDUCTION) {
             HC_LOG_DEBUG("\tlistener reduction received");
-            m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, CHANGE_TO_INCLUDE_MODE, gaddr, source_list<source>(), MLDv1));
+            send_record(if_index, CHANGE_TO_INCLUDE_MODE, gaddr, source_list<source>(), MLDv1, saddr);
         } else {
             HC_LOG_ERROR("unkown mld type: " << hdr->mld_type);
         }
@@ -154,11 +186,12 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
             return;
         }
 
-        mldv2_mc_report* v3_report = reinterpret_cast<mldv2_mc_report*>(hdr);
-        mldv2_mc_record* rec = reinterpret_cast<mldv2_mc_record*>(reinterpret_cast<unsigned char*>(v3_report) + sizeof(mldv2_mc_report));
+        //address of the reporting host
+        if (msg->msg_name != nullptr && msg->msg_namelen >= sizeof(struct sockaddr_in6)) {
+            saddr = addr_storage(*reinterpret_cast<struct sockaddr_in6*>(msg->msg_name));
+        }
 
-        int num_records = ntohs(v3_report->num_of_mc_records);
-        HC_LOG_DEBUG("\tnum of multicast records: " << num_records);
+        mldv2_report_view report(hdr, info_size);
 
         if_index = packet_info->ipi6_ifindex;
         HC_LOG_DEBUG("\treceived on interface:" << interfaces::get_if_name(if_index));
@@ -168,31 +201,67 @@ void mld_receiver::analyse_packet(struct msghdr* msg, int)
             return;
         }
 
-        for (int i = 0; i < num_records; ++i) {
-            mcast_addr_record_type rec_type = static_cast<mcast_addr_record_type>(rec->type);
-            unsigned int aux_size = rec->aux_data_len * 4; //RFC 3810 Section 5.2.6 Aux Data Len
-            int nos = ntohs(rec->num_of_srcs);
+        mldv2_report_view::record rec;
+        while (report.next(rec)) {
+            mcast_addr_record_type rec_type = rec.get_record_type();
 
-            gaddr = addr_storage(rec->gaddr);
+            gaddr = rec.get_gaddr();
             source_list<source> slist;
-
-            in6_addr* src = reinterpret_cast<in6_addr*>(reinterpret_cast<unsigned char*>(rec) + sizeof(mldv2_mc_record));
-            for (int j = 0; j < nos; ++j) {
-                slist.insert(addr_storage(*src));
-                ++src;
-            }
+            report.get_slist(rec, slist);
 
             HC_LOG_DEBUG("\trecord type: " << get_mcast_addr_record_type_name(rec_type));
             HC_LOG_DEBUG("\tgaddr: " << gaddr);
             HC_LOG_DEBUG("\tnumber of sources: " << slist.size());
             HC_LOG_DEBUG("\tsource_list: " << slist);
-            m_proxy_instance->add_msg(std::make_shared<group_record_msg>(if_index, rec_type, gaddr, move(slist), MLDv2));
-
-            rec = reinterpret_cast<mldv2_mc_record*>(reinterpret_cast<unsigned char*>(rec) + sizeof(mldv2_mc_record) + nos * sizeof(in6_addr) + aux_size);
+            send_record(if_index, rec_type, gaddr, std::move(slist), MLDv2, saddr);
         }
     } else if (hdr->mld_type == MLD_LISTENER_QUERY) {
         HC_LOG_DEBUG("MLD_LISTENER_QUERY received");
-        HC_LOG_WARN("querier election is not implemented");
+
+        struct in6_pktinfo* packet_info = nullptr;
+
+        for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != nullptr; cmsgptr = CMSG_NXTHDR(msg, cmsgptr)) {
+            if (cmsgptr->cmsg_len > 0 && cmsgptr->cmsg_level == IPPROTO_IPV6 && cmsgptr->cmsg_type == IPV6_PKTINFO ) {
+                packet_info = (struct in6_pktinfo*)CMSG_DATA(cmsgptr);
+            }
+        }
+        if (packet_info == nullptr || info_size < static_cast<int>(sizeof(mldv1))) {
+            return;
+        }
+
+        //address of the querier
+        if (msg->msg_name != nullptr && msg->msg_namelen >= sizeof(struct sockaddr_in6)) {
+            saddr = addr_storage(*reinterpret_cast<struct sockaddr_in6*>(msg->msg_name));
+        }
+
+        if_index = packet_info->ipi6_ifindex;
+        HC_LOG_DEBUG("\treceived on interface:" << interfaces::get_if_name(if_index));
+
+        if (!is_if_index_relevant(if_index)) {
+            HC_LOG_DEBUG("interface is not relevant");
+            return;
+        }
+
+        //MLDv1 queries carry the maximum response delay in milliseconds
+        std::chrono::milliseconds max_resp_time(ntohs(hdr->mld_maxdelay));
+        bool suppress = false;
+        if (info_size >= static_cast<int>(sizeof(mldv2_query))) {
+            max_resp_time = timers_values().maxrespc_mldv2_to_maxrespi(ntohs(hdr->mld_maxdelay));
+
+            //the sources of a multicast address and source specific query are not evaluated, it keeps the filter timer
+            auto v2_hdr = reinterpret_cast<struct mldv2_query*>(hdr);
+            suppress = v2_hdr->suppress || ntohs(v2_hdr->num_of_srcs) > 0;
+        }
+
+        gaddr = hdr->mld_addr;
+        HC_LOG_DEBUG("\tgroup: " << gaddr);
+        if (saddr.is_valid()) {
+            send_querier_query(if_index, saddr, gaddr, suppress);
+        }
+
+        if (m_proxy_instance->has_native_reports()) {
+            send_upstream_query(if_index, gaddr, max_resp_time);
+        }
     } else {
         HC_LOG_DEBUG("unknown MLD-packet: " << (int)(hdr->mld_type));
     }
@@ -30,8 +30,9 @@
 #include <netinet/ip6.h>
 
 #include <memory>
+#include <cstring>
 
-mld_sender::mld_sender(const std::shared_ptr<const interfaces>& interfaces): sender(interfaces, MLDv2)
+mld_sender::mld_sender(const std::shared_ptr<const interfaces>& interfaces, bool native_reports): sender(interfaces, MLDv2, native_reports)
 {
     HC_LOG_TRACE("");
 
@@ -52,20 +53,10 @@ bool mld_sender::send_record(unsigned int if_index, mc_filter filter_mode, const
 {
     HC_LOG_TRACE("");
 
-    if (filter_mode == INCLUDE_MODE && slist.empty() ) {
-        m_sock.leave_group(gaddr, if_index);
-        return true;
-    } else if (filter_mode == EXCLUDE_MODE || filter_mode == EXCLUDE_MODE) {
-        m_sock.join_group(gaddr, if_index);
-        std::list<addr_storage> src_list;
-        for (auto & e : slist) {
-            src_list.push_back(e.saddr);
-        }
-
-        return m_sock.set_source_filter(if_index, gaddr, filter_mode, src_list);
+    if (m_native_reports) {
+        return set_report_state(if_index, filter_mode, gaddr, slist);
     } else {
-        HC_LOG_ERROR("unknown filter mode");
-        return false;
+        return set_socket_filter(if_index, filter_mode, gaddr, slist);
     }
 }
 
@@ -125,17 +116,29 @@ bool mld_sender::send_mldv2_query(unsigned int if_index, const timers_values& tv
 {
     HC_LOG_TRACE("");
 
-    std::unique_ptr<mldv2_query> q;
-    unsigned int size;
+    //split long source lists into packets of the interface mtu, the ipv6 header carries the router alert option
+    unsigned int max_sources = get_max_sources(if_index, sizeof(struct ip6_hdr) + sizeof(struct ip6_hbh) + sizeof(struct ip6_opt_router) + sizeof(pad2) + sizeof(mldv2_query), sizeof(in6_addr));
+    if (slist.size() > max_sources) {
+        bool rc = true;
+        source_list<source> part;
+        for (auto & e : slist) {
+            part.insert(part.end(), e);
+            if (part.size() == max_sources) {
+                rc = send_mldv2_query(if_index, tv, gaddr, s_flag, part) && rc;
+                part.clear();
+            }
+        }
 
-    if (slist.empty()) {
-        size = sizeof(mldv2_query);
-        q.reset(new mldv2_query);
-    } else {
-        size = sizeof(mldv2_query) + (slist.size() * sizeof(in6_addr));
-        q.reset(reinterpret_cast<mldv2_query*>(new unsigned char[size]));
+        if (!part.empty()) {
+            rc = send_mldv2_query(if_index, tv, gaddr, s_flag, part) && rc;
+        }
+        return rc;
     }
 
+    unsigned int size = sizeof(mldv2_query) + (slist.size() * sizeof(in6_addr));
+    std::vector<unsigned char> packet(size);
+    mldv2_query* q = reinterpret_cast<mldv2_query*>(packet.data());
+
     q->type = MLD_LISTENER_QUERY;
     q->code = 0;
     q->checksum = MC_MASSAGES_AUTO_FILL;
@@ -165,18 +168,59 @@ bool mld_sender::send_mldv2_query(unsigned int if_index, const timers_values& tv
     q->num_of_srcs = ntohs(slist.size());
 
     if (!slist.empty()) {
-        in6_addr* source_ptr = reinterpret_cast<in6_addr*>(reinterpret_cast<unsigned char*>(q.get()) + sizeof(mldv2_query));
+        in6_addr* source_ptr = reinterpret_cast<in6_addr*>(packet.data() + sizeof(mldv2_query));
         for (auto & e : slist) {
-            *source_ptr = e.saddr.get_in6_addr();
+            *source_ptr = e.saddr.get().get_in6_addr();
             source_ptr++;
         }
     }
 
-    if (!m_sock.choose_if(if_index)) {
-        return false;
+    queue_packet(if_index, dst_addr, std::move(packet));
+    return true;
+}
+
+void mld_sender::get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const
+{
+    HC_LOG_TRACE("");
+    header_size = sizeof(struct ip6_hdr) + sizeof(struct ip6_hbh) + sizeof(struct ip6_opt_router) + sizeof(pad2) + sizeof(mldv2_mc_report);
+    record_size = sizeof(mldv2_mc_record);
+    addr_size = sizeof(in6_addr);
+}
+
+void mld_sender::queue_report(unsigned int if_index, std::vector<report_record>::const_iterator begin, std::vector<report_record>::const_iterator end) const
+{
+    HC_LOG_TRACE("");
+
+    //the kernel adds the ipv6 header with the router alert option and the checksum
+    unsigned int size = sizeof(mldv2_mc_report);
+    for (auto it = begin; it != end; ++it) {
+        size += sizeof(mldv2_mc_record) + it->m_slist.size() * sizeof(in6_addr);
+    }
+
+    std::vector<unsigned char> packet(size);
+    mldv2_mc_report* report = reinterpret_cast<mldv2_mc_report*>(packet.data());
+    report->type = MLD_V2_LISTENER_REPORT;
+    report->reservedA = 0;
+    report->checksum = MC_MASSAGES_AUTO_FILL;
+    report->reservedB = 0;
+    report->num_of_mc_records = htons(end - begin);
+
+    unsigned char* pos = packet.data() + sizeof(mldv2_mc_report);
+    for (auto it = begin; it != end; ++it) {
+        mldv2_mc_record* rec = reinterpret_cast<mldv2_mc_record*>(pos);
+        rec->type = it->m_type;
+        rec->aux_data_len = 0;
+        rec->num_of_srcs = htons(it->m_slist.size());
+        rec->gaddr = it->m_gaddr.get_in6_addr();
+        pos += sizeof(mldv2_mc_record);
+
+        for (auto & e : it->m_slist) {
+            memcpy(pos, &e.saddr.get().get_in6_addr(), sizeof(in6_addr));
+            pos += sizeof(in6_addr);
+        }
     }
 
-    return m_sock.send_packet(dst_addr, reinterpret_cast<unsigned char*>(q.get()), size);
+    queue_packet(if_index, addr_storage(IPV6_ALL_MLDv2_CAPABLE_ROUTERS), std::move(packet));
 }
 
 bool mld_sender::add_hbh_opt_header() const
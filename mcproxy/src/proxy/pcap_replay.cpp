@@ -0,0 +1,769 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/pcap_replay.hpp"
+#include "include/proxy/proxy_instance.hpp"
+#include "include/proxy/receiver.hpp"
+#include "include/proxy/routing.hpp"
+#include "include/proxy/recording_sender.hpp"
+#include "include/proxy/interfaces.hpp"
+#include "include/proxy/timing.hpp"
+#include "include/proxy/timers_values.hpp"
+#include "include/parser/configuration.hpp"
+#include "include/parser/interface.hpp"
+#include "include/utils/mroute_socket.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/source_table.hpp"
+#include "include/utils/extended_igmp_defines.hpp"
+#include "include/utils/extended_mld_defines.hpp"
+
+#include <iostream>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <cstring>
+
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
+#include <netinet/igmp.h>
+#include <linux/mroute.h>
+#include <linux/mroute6.h>
+#include <sys/resource.h>
+#include <byteswap.h>
+
+/**
+ * @brief Kernel of the pcap replay, records the calls of the proxy instance and keeps the
+ *        multicast routes to forward the data of the capture and to count its packets.
+ */
+class recording_kernel : public mroute_socket
+{
+private:
+    struct route {
+        int m_input_vif;
+        unsigned long m_pkt_count;
+    };
+
+    mutable std::mutex m_lock;
+    mutable std::map<std::string, unsigned long long> m_calls;
+    mutable std::map<std::pair<mc_addr, mc_addr>, route> m_routes; //group address, source address
+    mutable std::vector<std::pair<bool, std::pair<std::pair<mc_addr, mc_addr>, int>>> m_queued; //add, route, input vif
+
+    //capture time of the upcalls of new sources without a route, the kernel queues their packets meanwhile
+    mutable std::map<std::pair<mc_addr, mc_addr>, uint64_t> m_unresolved;
+
+    bool call(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ++m_calls[name];
+        return true;
+    }
+
+public:
+    unsigned long long m_forwarded = 0;
+    unsigned long long m_queued_pkts = 0;
+    unsigned long long m_wrong_if = 0;
+
+    bool set_kernel_table(int) const override {
+        return call("set_kernel_table");
+    }
+
+    bool set_ipv6_recv_icmpv6_msg(bool) const override {
+        return true;
+    }
+
+    bool set_ipv6_recv_pkt_info() const override {
+        return true;
+    }
+
+    bool set_mrt_flag(bool) const override {
+        return call("set_mrt_flag");
+    }
+
+    bool set_assert(bool) const override {
+        return call("set_assert");
+    }
+
+    //the routes are installed per source, the wildcard routes would need the assert upcalls of the downstreams
+    bool is_wildcard_mroute_supported() const override {
+        return false;
+    }
+
+    bool add_vif(int, uint32_t, const addr_storage&) const override {
+        return call("add_vif");
+    }
+
+    bool bind_vif_to_table(uint32_t, int) const override {
+        return call("bind_vif_to_table");
+    }
+
+    bool bind_vifs_to_table(std::list<uint32_t>& if_indexes, int) const override {
+        if_indexes.clear();
+        return call("bind_vifs_to_table");
+    }
+
+    bool unbind_vif_form_table(uint32_t, int) const override {
+        return call("unbind_vif_from_table");
+    }
+
+    bool del_vif(int) const override {
+        return call("del_vif");
+    }
+
+    void queue_add_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>&) const override {
+        call("add_mroute");
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_queued.push_back(std::make_pair(true, std::make_pair(std::make_pair(group_addr, source_addr), vif_index)));
+    }
+
+    void queue_del_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const override {
+        call("del_mroute");
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_queued.push_back(std::make_pair(false, std::make_pair(std::make_pair(group_addr, source_addr), vif_index)));
+    }
+
+    bool flush_mroutes(std::list<std::pair<mc_addr, mc_addr>>&) const override {
+        call("flush_mroutes");
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto & e : m_queued) {
+            if (e.first) {
+                //a changed route keeps its counter
+                auto rc = m_routes.insert(std::make_pair(e.second.first, route {e.second.second, 0}));
+                rc.first->second.m_input_vif = e.second.second;
+                m_unresolved.erase(e.second.first);
+            } else {
+                m_routes.erase(e.second.first);
+            }
+        }
+        m_queued.clear();
+        return true;
+    }
+
+    bool get_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const override {
+        call("get_mroute_pkt_count");
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_routes.find(std::make_pair(group_addr, source_addr));
+        if (it == std::end(m_routes)) {
+            return false;
+        }
+
+        pkt_count = it->second.m_pkt_count;
+        return true;
+    }
+
+    bool get_all_mroute_pkt_counts(std::map<std::pair<mc_addr, mc_addr>, unsigned long>& pkt_counts) const override {
+        call("get_all_mroute_pkt_counts");
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto & e : m_routes) {
+            pkt_counts[e.first] = e.second.m_pkt_count;
+        }
+        return true;
+    }
+
+    /**
+     * @brief A multicast data packet of saddr to gaddr arrived on vif at the capture time time (usec).
+     * @return true if the packet has no route and the kernel reports the new source
+     */
+    bool receive_data(int vif, const mc_addr& gaddr, const mc_addr& saddr, uint64_t time) {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        auto key = std::make_pair(gaddr, saddr);
+        auto it = m_routes.find(key);
+        if (it != std::end(m_routes)) {
+            if (it->second.m_input_vif == vif) {
+                ++it->second.m_pkt_count;
+                ++m_forwarded;
+            } else {
+                ++m_wrong_if;
+            }
+            return false;
+        }
+
+        auto rc = m_unresolved.insert(std::make_pair(key, time));
+        if (!rc.second) {
+            if (time - rc.first->second < PCAP_REPLAY_UNRESOLVED_MSEC * 1000ULL) {
+                ++m_queued_pkts;
+                return false;
+            }
+            rc.first->second = time;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Number of calls of each kernel function.
+     */
+    std::map<std::string, unsigned long long> get_calls() const {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_calls;
+    }
+};
+
+namespace
+{
+//signals the replay that all messages before it are handled
+struct replay_done_msg : public proxy_msg {
+    replay_done_msg(std::promise<void>& done)
+        : proxy_msg(TEST_MSG, LOSEABLE)
+        , m_done(done) {
+    }
+
+    virtual void operator()() override {
+        m_done.set_value();
+    }
+
+private:
+    std::promise<void>& m_done;
+};
+
+//peak resident set size of the process in kB
+long get_peak_rss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+}
+
+pcap_replay::pcap_replay()
+    : m_swapped(false)
+    , m_nsec(false)
+    , m_link_type(0)
+    , m_group_mem_protocol(IGMPv3)
+    , m_upstream(INTERFACES_UNKOWN_IF_INDEX)
+    , m_downstream(INTERFACES_UNKOWN_IF_INDEX)
+    , m_time(0)
+    , m_packets(0)
+    , m_reports(0)
+    , m_leaves(0)
+    , m_queries(0)
+    , m_data(0)
+    , m_upcalls(0)
+    , m_skipped(0)
+{
+    HC_LOG_TRACE("");
+}
+
+pcap_replay::~pcap_replay()
+{
+    HC_LOG_TRACE("");
+}
+
+uint32_t pcap_replay::get_uint32(const unsigned char* buf) const
+{
+    uint32_t value;
+    std::memcpy(&value, buf, sizeof(value));
+    return m_swapped ? bswap_32(value) : value;
+}
+
+bool pcap_replay::read_header()
+{
+    HC_LOG_TRACE("");
+
+    unsigned char header[24];
+    if (!m_file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+
+    uint32_t magic;
+    std::memcpy(&magic, header, sizeof(magic));
+    if (magic == bswap_32(PCAP_MAGIC_USEC) || magic == bswap_32(PCAP_MAGIC_NSEC)) {
+        m_swapped = true;
+        magic = bswap_32(magic);
+    }
+
+    if (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC) {
+        return false;
+    }
+
+    m_nsec = magic == PCAP_MAGIC_NSEC;
+    m_link_type = get_uint32(header + 20) & 0x0FFFFFFF; //the upper bits are flags
+    return true;
+}
+
+bool pcap_replay::read_packet(bool& truncated)
+{
+    HC_LOG_TRACE("");
+
+    truncated = false;
+
+    unsigned char header[16];
+    if (!m_file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        truncated = m_file.gcount() != 0;
+        return false;
+    }
+
+    uint64_t sec = get_uint32(header);
+    uint64_t fraction = get_uint32(header + 4);
+    uint32_t incl_len = get_uint32(header + 8);
+    m_time = sec * 1000000 + (m_nsec ? fraction / 1000 : fraction);
+
+    if (incl_len > PCAP_MAX_PACKET_SIZE) {
+        truncated = true;
+        return false;
+    }
+
+    m_frame.resize(incl_len);
+    if (!m_file.read(reinterpret_cast<char*>(m_frame.data()), incl_len)) {
+        truncated = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool pcap_replay::get_ip_packet(std::size_t& offset, int& addr_family) const
+{
+    HC_LOG_TRACE("");
+
+    const unsigned char* buf = m_frame.data();
+    const std::size_t size = m_frame.size();
+    unsigned int ether_type = 0;
+
+    switch (m_link_type) {
+    case PCAP_LINKTYPE_EN10MB:
+        offset = 12;
+        while (offset + 2 <= size) {
+            ether_type = (buf[offset] << 8) | buf[offset + 1];
+            if (ether_type != 0x8100 && ether_type != 0x88a8) { //VLAN tags
+                break;
+            }
+            offset += 4;
+        }
+        offset += 2;
+        break;
+    case PCAP_LINKTYPE_LINUX_SLL:
+        if (size < 16) {
+            return false;
+        }
+        ether_type = (buf[14] << 8) | buf[15];
+        offset = 16;
+        break;
+    case PCAP_LINKTYPE_LINUX_SLL2:
+        if (size < 20) {
+            return false;
+        }
+        ether_type = (buf[0] << 8) | buf[1];
+        offset = 20;
+        break;
+    case PCAP_LINKTYPE_NULL:
+        offset = 4; //the address family is in the byte order of the capturing host, the ip version decides
+        break;
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_IPV4:
+    case PCAP_LINKTYPE_IPV6:
+        offset = 0;
+        break;
+    default:
+        return false;
+    }
+
+    if (offset >= size) {
+        return false;
+    }
+
+    if (ether_type == 0) {
+        ether_type = (buf[offset] >> 4) == 4 ? 0x0800 : ((buf[offset] >> 4) == 6 ? 0x86DD : 0);
+    }
+
+    if (ether_type == 0x0800) {
+        addr_family = AF_INET;
+    } else if (ether_type == 0x86DD) {
+        addr_family = AF_INET6;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void pcap_replay::analyse_ipv4(const unsigned char* buf, std::size_t size)
+{
+    HC_LOG_TRACE("");
+
+    struct ip ip_hdr;
+    if (size < sizeof(ip_hdr)) {
+        ++m_skipped;
+        return;
+    }
+    std::memcpy(&ip_hdr, buf, sizeof(ip_hdr));
+
+    std::size_t hdr_size = ip_hdr.ip_hl * 4;
+    std::size_t ip_size = std::min<std::size_t>(ntohs(ip_hdr.ip_len), size);
+    if (hdr_size < sizeof(ip_hdr) || ip_size < hdr_size) {
+        ++m_skipped;
+        return;
+    }
+
+    addr_storage daddr(ip_hdr.ip_dst);
+    if (!daddr.is_multicast_addr()) {
+        ++m_skipped;
+        return;
+    }
+
+    if (ip_hdr.ip_p == IPPROTO_IGMP) {
+        if (ip_size < hdr_size + sizeof(struct igmp)) {
+            ++m_skipped;
+            return;
+        }
+
+        switch (buf[hdr_size]) {
+        case IGMP_V2_MEMBERSHIP_REPORT:
+        case IGMP_V3_MEMBERSHIP_REPORT:
+            ++m_reports;
+            inject_ipv4(buf, ip_size);
+            break;
+        case IGMP_V2_LEAVE_GROUP:
+            ++m_leaves;
+            inject_ipv4(buf, ip_size);
+            break;
+        case IGMP_MEMBERSHIP_QUERY:
+            ++m_queries;
+            break;
+        default:
+            ++m_skipped;
+        }
+    } else if ((ntohl(ip_hdr.ip_dst.s_addr) & 0xFFFFFF00) != 0xE0000000) { //224.0.0.0/24 is not forwarded
+        ++m_data;
+        forward(mc_addr(daddr), mc_addr(addr_storage(ip_hdr.ip_src)));
+    } else {
+        ++m_skipped;
+    }
+}
+
+void pcap_replay::analyse_ipv6(const unsigned char* buf, std::size_t size)
+{
+    HC_LOG_TRACE("");
+
+    struct ip6_hdr ip6;
+    if (size < sizeof(ip6)) {
+        ++m_skipped;
+        return;
+    }
+    std::memcpy(&ip6, buf, sizeof(ip6));
+
+    size = std::min<std::size_t>(sizeof(ip6) + ntohs(ip6.ip6_plen), size);
+    addr_storage daddr(ip6.ip6_dst);
+    if (!daddr.is_multicast_addr()) {
+        ++m_skipped;
+        return;
+    }
+
+    //skip the extension headers
+    std::size_t offset = sizeof(ip6);
+    uint8_t next = ip6.ip6_nxt;
+    while (next == IPPROTO_HOPOPTS || next == IPPROTO_ROUTING || next == IPPROTO_DSTOPTS) {
+        if (offset + 2 > size) {
+            ++m_skipped;
+            return;
+        }
+        next = buf[offset];
+        offset += (buf[offset + 1] + 1) * 8;
+    }
+
+    if (offset > size || next == IPPROTO_FRAGMENT) {
+        ++m_skipped;
+        return;
+    }
+
+    if (next == IPPROTO_ICMPV6 && offset + sizeof(struct mld_hdr) <= size) {
+        switch (buf[offset]) {
+        case MLD_LISTENER_REPORT:
+        case MLD_V2_LISTENER_REPORT:
+            ++m_reports;
+            inject_ipv6(buf + offset, size - offset, addr_storage(ip6.ip6_src), daddr);
+            return;
+        case MLD_LISTENER_REDUCTION:
+            ++m_leaves;
+            inject_ipv6(buf + offset, size - offset, addr_storage(ip6.ip6_src), daddr);
+            return;
+        case MLD_LISTENER_QUERY:
+            ++m_queries;
+            return;
+        default:
+            break;
+        }
+    }
+
+    if ((ip6.ip6_dst.s6_addr[1] & 0x0F) > 2) { //the link-local scope is not forwarded
+        ++m_data;
+        forward(mc_addr(daddr), mc_addr(addr_storage(ip6.ip6_src)));
+    } else {
+        ++m_skipped;
+    }
+}
+
+void pcap_replay::inject_ipv4(const unsigned char* buf, std::size_t size)
+{
+    HC_LOG_TRACE("");
+
+    m_packet.assign(buf, buf + size);
+
+    struct iovec iov;
+    iov.iov_base = m_packet.data();
+    iov.iov_len = m_packet.size();
+
+    union {
+        struct cmsghdr align;
+        unsigned char buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
+    } ctrl;
+    std::memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct in_pktinfo info;
+    std::memset(&info, 0, sizeof(info));
+    info.ipi_ifindex = m_downstream;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(info));
+    std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+
+    m_proxy_instance->m_receiver->inject_packet(&msg, m_packet.size());
+}
+
+void pcap_replay::inject_ipv6(const unsigned char* buf, std::size_t size, const addr_storage& saddr, const addr_storage& daddr)
+{
+    HC_LOG_TRACE("");
+
+    m_packet.assign(buf, buf + size);
+
+    struct iovec iov;
+    iov.iov_base = m_packet.data();
+    iov.iov_len = m_packet.size();
+
+    struct sockaddr_in6 name = saddr.get_sockaddr_in6();
+    name.sin6_scope_id = m_downstream;
+
+    union {
+        struct cmsghdr align;
+        unsigned char buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
+    } ctrl;
+    std::memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &name;
+    msg.msg_namelen = sizeof(name);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    struct in6_pktinfo info;
+    std::memset(&info, 0, sizeof(info));
+    info.ipi6_addr = daddr.get_in6_addr();
+    info.ipi6_ifindex = m_downstream;
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(info));
+    std::memcpy(CMSG_DATA(cmsg), &info, sizeof(info));
+
+    m_proxy_instance->m_receiver->inject_packet(&msg, m_packet.size());
+}
+
+void pcap_replay::forward(const mc_addr& gaddr, const mc_addr& saddr)
+{
+    HC_LOG_TRACE("");
+
+    int vif = m_interfaces->get_virtual_if_index(m_upstream);
+    if (!m_kernel->receive_data(vif, gaddr, saddr, m_time)) {
+        return;
+    }
+
+    ++m_upcalls;
+
+    //the kernel message is received on the same socket as the membership messages
+    struct iovec iov;
+    if (is_IPv4(m_group_mem_protocol)) {
+        struct igmpmsg upcall;
+        std::memset(&upcall, 0, sizeof(upcall));
+        upcall.im_msgtype = IGMPMSG_NOCACHE;
+        upcall.im_vif = vif;
+        upcall.im_src = saddr.get_in_addr();
+        upcall.im_dst = gaddr.get_in_addr();
+        m_packet.assign(reinterpret_cast<unsigned char*>(&upcall), reinterpret_cast<unsigned char*>(&upcall) + sizeof(upcall));
+    } else {
+        struct mrt6msg upcall;
+        std::memset(&upcall, 0, sizeof(upcall));
+        upcall.im6_msgtype = MRT6MSG_NOCACHE;
+        upcall.im6_mif = vif;
+        upcall.im6_src = saddr.get_in6_addr();
+        upcall.im6_dst = gaddr.get_in6_addr();
+        m_packet.assign(reinterpret_cast<unsigned char*>(&upcall), reinterpret_cast<unsigned char*>(&upcall) + sizeof(upcall));
+    }
+    iov.iov_base = m_packet.data();
+    iov.iov_len = m_packet.size();
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    m_proxy_instance->m_receiver->inject_packet(&msg, m_packet.size());
+}
+
+void pcap_replay::wait_until_processed()
+{
+    HC_LOG_TRACE("");
+
+    //the routes and reports of a batch are flushed after its messages, the second message is handled in the next batch
+    for (int i = 0; i < 2; ++i) {
+        std::promise<void> done;
+        m_proxy_instance->add_msg_with_policy(std::make_shared<replay_done_msg>(done), MQ_BLOCK);
+        done.get_future().wait();
+    }
+
+    m_proxy_instance->m_routing->wait_for_routes();
+}
+
+bool pcap_replay::replay(const std::string& pcap_path, const std::string& config_path, bool explicit_tracking)
+{
+    HC_LOG_TRACE("");
+
+    pcap_replay r;
+    r.m_file.open(pcap_path, std::ios::binary);
+    if (!r.m_file) {
+        HC_LOG_ERROR("failed to open capture " << pcap_path);
+        return false;
+    }
+
+    if (!r.read_header()) {
+        HC_LOG_ERROR("failed to read capture " << pcap_path << ", only the classic pcap format is supported");
+        return false;
+    }
+
+    //the interfaces of the configuration have to exist
+    configuration config(config_path, false);
+    auto& inst_set = config.get_inst_def_set();
+    if (inst_set.size() == 0) {
+        HC_LOG_ERROR("no proxy instance defined in " << config_path);
+        return false;
+    }
+
+    auto& pinstance = *std::begin(inst_set);
+    r.m_group_mem_protocol = config.get_group_mem_protocol();
+    r.m_interfaces = config.get_interfaces_for_pinstance(pinstance->get_instance_name());
+    r.m_kernel = std::make_shared<recording_kernel>();
+    r.m_sender = std::make_shared<recording_sender>(r.m_interfaces, r.m_group_mem_protocol);
+    r.m_proxy_instance.reset(new proxy_instance(r.m_group_mem_protocol, pinstance->get_instance_name(), 0, r.m_interfaces, std::make_shared<timing>(), true, 0, explicit_tracking, false, false, nullptr, r.m_kernel, r.m_sender));
+
+    //the debug output of the proxy instance would dominate the measurement
+    std::streambuf* cout_buf = std::cout.rdbuf(nullptr);
+
+    for (auto & e : pinstance->get_global_settings()) {
+        r.m_proxy_instance->add_msg(std::make_shared<config_msg>(config_msg::SET_GLOBAL_RULE_BINDING, e));
+    }
+
+    unsigned int upstream_priority = 0;
+    for (auto & e : pinstance->get_upstreams()) {
+        unsigned int if_index = interfaces::get_if_index(e->get_if_name());
+        if (r.m_upstream == INTERFACES_UNKOWN_IF_INDEX) {
+            r.m_upstream = if_index;
+        }
+        r.m_proxy_instance->add_msg(std::make_shared<config_msg>(config_msg::ADD_UPSTREAM, if_index, upstream_priority, e));
+        upstream_priority += 100;
+    }
+
+    for (auto & e : pinstance->get_downstreams()) {
+        unsigned int if_index = interfaces::get_if_index(e->get_if_name());
+        if (r.m_downstream == INTERFACES_UNKOWN_IF_INDEX) {
+            r.m_downstream = if_index;
+        }
+        r.m_proxy_instance->add_msg(std::make_shared<config_msg>(config_msg::ADD_DOWNSTREAM, if_index, e, timers_values()));
+    }
+
+    r.wait_until_processed();
+    long start_rss = get_peak_rss();
+
+    uint64_t first_time = 0;
+    bool truncated = false;
+    auto start = std::chrono::steady_clock::now();
+    while (r.read_packet(truncated)) {
+        if (r.m_packets++ == 0) {
+            first_time = r.m_time;
+        }
+
+        std::size_t offset;
+        int addr_family;
+        if (!r.get_ip_packet(offset, addr_family) || addr_family != get_addr_family(r.m_group_mem_protocol)) {
+            ++r.m_skipped;
+        } else if (addr_family == AF_INET) {
+            r.analyse_ipv4(r.m_frame.data() + offset, r.m_frame.size() - offset);
+        } else {
+            r.analyse_ipv6(r.m_frame.data() + offset, r.m_frame.size() - offset);
+        }
+    }
+
+    r.wait_until_processed();
+    auto duration = std::chrono::steady_clock::now() - start;
+
+    std::cout.rdbuf(cout_buf);
+
+    if (truncated) {
+        HC_LOG_ERROR("capture " << pcap_path << " is truncated");
+        std::cout << "capture is truncated" << std::endl;
+    }
+
+    double capture_sec = r.m_packets > 0 ? (r.m_time - first_time) / 1000000.0 : 0;
+    r.print_summary(capture_sec, std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / 1000000.0, start_rss);
+
+    return !truncated;
+}
+
+void pcap_replay::print_summary(double capture_sec, double replay_sec, long start_rss) const
+{
+    HC_LOG_TRACE("");
+
+    std::cout << "proxy instance: " << m_proxy_instance->m_instance_name << " (upstream: " << interfaces::get_if_name(m_upstream) << ", downstream: " << interfaces::get_if_name(m_downstream) << ")" << std::endl;
+    std::cout << "replayed packets: " << m_packets << " (reports: " << m_reports << ", leaves: " << m_leaves << ", multicast data: " << m_data << ", queries: " << m_queries << ", skipped: " << m_skipped << ")" << std::endl;
+    std::cout << "capture duration: " << capture_sec << " sec, replay duration: " << replay_sec << " sec" << std::endl;
+    if (replay_sec > 0) {
+        std::cout << "throughput: " << static_cast<unsigned long long>(m_packets / replay_sec) << " packets/sec, mean time per packet: " << replay_sec * 1000000000.0 / std::max(m_packets, 1ULL) << " nsec" << std::endl;
+    }
+    std::cout << "peak memory: " << get_peak_rss() << " kB (" << start_rss << " kB before the replay)" << std::endl;
+
+    std::cout << "kernel calls:";
+    for (auto & e : m_kernel->get_calls()) {
+        std::cout << " " << e.first << ": " << e.second;
+    }
+    std::cout << std::endl;
+    std::cout << "kernel upcalls: " << m_upcalls << " (forwarded packets: " << m_kernel->m_forwarded << ", queued packets of new sources: " << m_kernel->m_queued_pkts << ", wrong input interface: " << m_kernel->m_wrong_if << ")" << std::endl;
+
+    std::cout << "sender calls: records: " << m_sender->m_records << ", general queries: " << m_sender->m_general_queries << ", group specific queries: " << m_sender->m_group_queries << ", group and source specific queries: " << m_sender->m_source_queries << std::endl;
+    std::cout << "suppressed records: " << metrics::get(METRIC_RECORDS_SUPPRESSED) << ", limited records: " << metrics::get(METRIC_RECORDS_LIMITED) << ", dropped upcalls: " << metrics::get(METRIC_UPCALLS_DROPPED) << ", dropped messages: " << metrics::get(METRIC_QUEUE_DROPPED) << std::endl;
+    std::cout << "membership state: groups: " << metrics::get(METRIC_MEMBERSHIP_GROUPS) << ", sources: " << metrics::get(METRIC_MEMBERSHIP_SOURCES) << ", estimated memory: " << metrics::get(METRIC_MEMBERSHIP_BYTES) << " bytes" << std::endl;
+    std::cout << "interned source addresses: " << source_table::get_instance().size() << ", table memory: " << source_table::get_instance().get_memory() << " bytes" << std::endl;
+}
@@ -27,30 +27,62 @@
 #include "include/proxy/check_kernel.hpp"
 #include "include/proxy/timing.hpp"
 #include "include/proxy/proxy_instance.hpp"
+#include "include/proxy/checkpoint.hpp"
+#include "include/proxy/interface_monitor.hpp"
+#include "include/proxy/event_trace.hpp"
+#include "include/proxy/pcap_replay.hpp"
+#include "include/proxy/scale_suite.hpp"
+#include "include/proxy/control_socket.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/thread_settings.hpp"
+#include "include/utils/xdp_mroute_socket.hpp"
 //#include "include/proxy/proxy_configuration.hpp"
 #include "include/parser/configuration.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 
 bool proxy::m_running = false;
+bool proxy::m_reload = false;
+int proxy::m_signal_pipe[2] = { -1, -1};
 
 proxy::proxy(int arg_count, char* args[])
     : m_verbose_lvl(0)
     , m_print_proxy_status(false)
     , m_reset_rp_filter(false)
     , m_config_path(CONFIGURATION_DEFAULT_CONIG_PATH)
+    , m_timer_slack(0)
+    , m_querier_shards(0)
+    , m_group_sharding(false)
+    , m_explicit_tracking(false)
+    , m_native_reports(false)
+    , m_timing_threads(1)
+    , m_last_checkpoint(std::chrono::steady_clock::now())
+    , m_start_time(std::chrono::steady_clock::now())
+    , m_control_socket(nullptr)
     , m_configuration(nullptr)
-    , m_timing(std::make_shared<timing>())
+    , m_interface_monitor(nullptr)
 {
     HC_LOG_TRACE("");
 
+    if (m_signal_pipe[0] < 0 && pipe2(m_signal_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        HC_LOG_ERROR("failed to create signal pipe! Error: " << strerror(errno) << " errno: " << errno);
+        throw "failed to create signal pipe";
+    }
+
     signal(SIGINT, proxy::signal_handler);
     signal(SIGTERM, proxy::signal_handler);
+    signal(SIGHUP, proxy::signal_handler);
 
     prozess_commandline_args(arg_count, args);
 
@@ -65,6 +97,18 @@ proxy::proxy(int arg_count, char* args[])
 
     start_proxy_instances();
 
+    restore_checkpoint();
+
+    if (!m_control_path.empty()) {
+        m_control_socket.reset(new control_socket(m_control_path, std::bind(&proxy::handle_control_command, this, std::placeholders::_1)));
+    }
+
+    try {
+        m_interface_monitor.reset(new interface_monitor(std::bind(&proxy::handle_interface_changes, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3)));
+    } catch (const char* e) {
+        HC_LOG_WARN("link and address changes of the interfaces are not tracked: " << e);
+    }
+
     start();
 }
 
@@ -91,7 +135,10 @@ void proxy::help_output()
     cout << "Usage:" << endl;
     cout << "  mcproxy [-h]" << endl;
     cout << "  mcproxy [-c]" << endl;
-    cout << "  mcproxy [-r] [-d] [-s] [-v [-v]] [-f <config file>]" << endl;
+    cout << "  mcproxy [-R <trace file>]" << endl;
+    cout << "  mcproxy [-e] [-f <config file>] -P <pcap file>" << endl;
+    cout << "  mcproxy -S <key=value,...>" << endl;
+    cout << "  mcproxy [-r] [-d] [-s] [-v [-v]] [-t <msec>] [-q <threads> [-g]] [-w <threads>] [-e] [-n] [-u <msec>[:<records per second>]] [-p <checkpoint file>] [-T <trace file>] [-C <control socket>] [-X <pinned map>] [-A <role>=<cpus>[/<policy>[:<priority>]] ...] [-f <config file>]" << endl;
     cout << endl;
     cout << "\t-h" << endl;
     cout << "\t\tDisplay this help screen." << endl;
@@ -110,8 +157,82 @@ void proxy::help_output()
     cout << "\t-v" << endl;
     cout << "\t\tBe verbose. Give twice to see even more messages" << endl;
 
+    cout << "\t-t" << endl;
+    cout << "\t\tCoalesce timer events that expire within the given" << endl;
+    cout << "\t\ttimer slack in milliseconds (e.g. 10 to 50)." << endl;
+
+    cout << "\t-q" << endl;
+    cout << "\t\tDistribute the queriers of the downstream interfaces of each" << endl;
+    cout << "\t\tproxy instance to the given number of threads." << endl;
+
+    cout << "\t-g" << endl;
+    cout << "\t\tDistribute the group addresses of all downstream interfaces" << endl;
+    cout << "\t\tto the querier threads instead of whole interfaces." << endl;
+
+    cout << "\t-w" << endl;
+    cout << "\t\tNumber of timer threads the proxy instances are distributed to" << endl;
+    cout << "\t\t(default 1), 0 runs one timer thread per proxy instance." << endl;
+
+    cout << "\t-e" << endl;
+    cout << "\t\tTrack the membership of each host (IGMPv3/MLDv2 only) and" << endl;
+    cout << "\t\tprune immediately when the last host leaves a group or source." << endl;
+
+    cout << "\t-n" << endl;
+    cout << "\t\tBuild the IGMPv3/MLDv2 reports to the upstream interfaces in the" << endl;
+    cout << "\t\tproxy and answer the queries of the upstream routers itself." << endl;
+
+    cout << "\t-u" << endl;
+    cout << "\t\tMerge the changes of a group to the upstream interfaces within the" << endl;
+    cout << "\t\tgiven milliseconds and send at most the given records per second" << endl;
+    cout << "\t\tto each upstream (e.g. 200:100). The first join of a group is" << endl;
+    cout << "\t\tsent immediately." << endl;
+
+    cout << "\t-p" << endl;
+    cout << "\t\tRestore the memberships and multicast sources from the given" << endl;
+    cout << "\t\tcheckpoint file on startup and update it while running." << endl;
+
+    cout << "\t-T" << endl;
+    cout << "\t\tRecord the received group records, multicast sources, timer" << endl;
+    cout << "\t\tevents and configuration changes to the given trace file." << endl;
+
+    cout << "\t-R" << endl;
+    cout << "\t\tReplay a trace file recorded with -T as fast as possible" << endl;
+    cout << "\t\twithout sending any packets and print the throughput." << endl;
+
+    cout << "\t-P" << endl;
+    cout << "\t\tReplay the membership messages and multicast data of a pcap" << endl;
+    cout << "\t\tfile through the first proxy instance of the configuration as" << endl;
+    cout << "\t\tfast as possible, without sending packets or changing kernel" << endl;
+    cout << "\t\troutes, and print the throughput and the recorded kernel calls." << endl;
+
+    cout << "\t-S" << endl;
+    cout << "\t\tRun the deterministic querier scale suite on a virtual clock and" << endl;
+    cout << "\t\tprint the state digests, the throughput and the memory. Settings:" << endl;
+    cout << "\t\tprotocol (IGMPv3|MLDv2), groups, sources, downstreams, rounds," << endl;
+    cout << "\t\tinterval (msec per round) and seed, e.g. groups=1000,seed=2." << endl;
+
+    cout << "\t-C" << endl;
+    cout << "\t\tServe a control socket at the given path. A client sends one" << endl;
+    cout << "\t\tcommand per connection: status, dump [<instance>], metrics" << endl;
+    cout << "\t\t(Prometheus text format) or reload." << endl;
+
+    cout << "\t-X" << endl;
+    cout << "\t\tForward the multicast data with an XDP program instead of the" << endl;
+    cout << "\t\tkernel. The program xdp/mcproxy_xdp.c and its maps are pinned in" << endl;
+    cout << "\t\tthe given directory (e.g. /sys/fs/bpf/mcproxy), the proxy attaches" << endl;
+    cout << "\t\tit to the interfaces and writes the routes to its maps." << endl;
+
+    cout << "\t-A" << endl;
+    cout << "\t\tPin the threads of a role to a cpu list (e.g. 2-3,6) and set" << endl;
+    cout << "\t\ttheir scheduling policy other (priority = nice value), fifo or" << endl;
+    cout << "\t\trr, e.g. receiver=2/fifo:50 or querier=4-7. Roles: receiver," << endl;
+    cout << "\t\tinstance, querier, timing, routing, monitor and all. Can be" << endl;
+    cout << "\t\tgiven several times. The threads are named mcp-<role>, the" << endl;
+    cout << "\t\tinstance threads mcp-<instance name>." << endl;
+
     cout << "\t-f" << endl;
-    cout << "\t\tTo specify the configuration file." << endl;
+    cout << "\t\tTo specify the configuration file. Send SIGHUP to reload it," << endl;
+    cout << "\t\tthe unchanged interfaces keep their state." << endl;
 
     cout << "\t-c" << endl;
     cout << "\t\tCheck the currently available kernel features." << endl;
@@ -123,11 +244,15 @@ void proxy::prozess_commandline_args(int arg_count, char* args[])
 
     bool is_logging = false;
     bool is_check_kernel = false;
+    std::string replay_path;
+    std::string pcap_path;
+    bool is_scale_suite = false;
+    scale_suite_settings suite_settings;
 
     if (arg_count == 1) {
 
     } else {
-        for (int c; (c = getopt(arg_count, args, "hrdsvcf:")) != -1;) {
+        for (int c; (c = getopt(arg_count, args, "hrdsvcegnq:t:w:u:p:T:R:P:S:C:X:A:f:")) != -1;) {
             switch (c) {
             case 'h':
                 help_output();
@@ -148,6 +273,76 @@ void proxy::prozess_commandline_args(int arg_count, char* args[])
             case 'v':
                 m_verbose_lvl++;
                 break;
+            case 'e':
+                m_explicit_tracking = true;
+                break;
+            case 'g':
+                m_group_sharding = true;
+                break;
+            case 'n':
+                m_native_reports = true;
+                break;
+            case 't': {
+                int slack = atoi(optarg);
+                if (slack < 0) {
+                    HC_LOG_ERROR("Invalid timer slack: " << optarg);
+                    throw "Invalid timer slack";
+                }
+                m_timer_slack = std::chrono::milliseconds(slack);
+            }
+            break;
+            case 'q': {
+                int shards = atoi(optarg);
+                if (shards < 0) {
+                    HC_LOG_ERROR("Invalid number of querier threads: " << optarg);
+                    throw "Invalid number of querier threads";
+                }
+                m_querier_shards = shards;
+            }
+            break;
+            case 'w': {
+                int threads = atoi(optarg);
+                if (threads < 0) {
+                    HC_LOG_ERROR("Invalid number of timer threads: " << optarg);
+                    throw "Invalid number of timer threads";
+                }
+                m_timing_threads = threads;
+            }
+            break;
+            case 'u':
+                if (!m_report_pacing.parse(std::string(optarg))) {
+                    throw "invalid report pacing";
+                }
+                break;
+            case 'p':
+                m_checkpoint_path = std::string(optarg);
+                break;
+            case 'T':
+                m_trace_path = std::string(optarg);
+                break;
+            case 'R':
+                replay_path = std::string(optarg);
+                break;
+            case 'P':
+                pcap_path = std::string(optarg);
+                break;
+            case 'S':
+                if (!scale_suite::parse_settings(std::string(optarg), suite_settings)) {
+                    throw "invalid scale suite settings";
+                }
+                is_scale_suite = true;
+                break;
+            case 'C':
+                m_control_path = std::string(optarg);
+                break;
+            case 'X':
+                m_xdp_pin_path = std::string(optarg);
+                break;
+            case 'A':
+                if (!thread_settings::parse(std::string(optarg))) {
+                    throw "invalid thread settings";
+                }
+                break;
             case 'f':
                 m_config_path = std::string(optarg);
                 //if (args[optind][0] != '-') {
@@ -187,6 +382,33 @@ void proxy::prozess_commandline_args(int arg_count, char* args[])
         ck.check_kernel_features();
         throw "";
     }
+
+    if (!replay_path.empty()) {
+        event_trace::replay(replay_path);
+        throw "";
+    }
+
+    if (!pcap_path.empty()) {
+        pcap_replay::replay(pcap_path, m_config_path, m_explicit_tracking);
+        throw "";
+    }
+
+    if (is_scale_suite) {
+        scale_suite::run(suite_settings);
+        throw "";
+    }
+}
+
+const std::shared_ptr<timing>& proxy::get_timing(unsigned int instance_number)
+{
+    HC_LOG_TRACE("");
+
+    unsigned int i = m_timing_threads == 0 ? instance_number : instance_number % m_timing_threads;
+    while (m_timings.size() <= i) {
+        m_timings.push_back(std::make_shared<timing>());
+    }
+
+    return m_timings[i];
 }
 
 unsigned int proxy::get_default_priority_interval(){
@@ -198,12 +420,23 @@ void proxy::start_proxy_instances()
     HC_LOG_TRACE("");
 
     int table_number = 0;
-    auto inst_set = m_configuration->get_inst_def_set();
-    for (auto & pinstance : inst_set) {
+    unsigned int instance_number = 0;
 
-        const std::string& instance_name = pinstance->get_instance_name();
+    if (!m_trace_path.empty()) {
+        m_event_trace = std::make_shared<event_trace>(m_trace_path, m_configuration->get_group_mem_protocol());
+    }
 
+    //the tables and timers are assigned in the order of the configuration
+    struct instance_setup {
+        std::shared_ptr<instance_definition> m_pinstance;
+        int m_table_number;
+        std::shared_ptr<timing> m_timing;
+        std::unique_ptr<proxy_instance> m_proxy_instance;
+    };
+    std::vector<instance_setup> setups;
 
+    auto inst_set = m_configuration->get_inst_def_set();
+    for (auto & pinstance : inst_set) {
         if (!pinstance->get_user_selected_table_number()) {
             table_number++;
             if (inst_set.size() <= 1) {
@@ -213,12 +446,61 @@ void proxy::start_proxy_instances()
             table_number = pinstance->get_table_number();
         }
 
-        auto& upstreams = pinstance->get_upstreams();
-        auto& downstreams = pinstance->get_downstreams();
+        setups.push_back(instance_setup {pinstance, table_number, get_timing(instance_number++), nullptr});
+    }
 
-        auto& interfaces = m_configuration->get_interfaces_for_pinstance(instance_name);
+    //the mroute sockets, senders, receivers and route writers of the instances are independent of each other
+    std::atomic<unsigned int> next(0);
+    std::mutex error_lock;
+    const char* error = nullptr;
+    auto construct = [&]() {
+        for (unsigned int i = next++; i < setups.size(); i = next++) {
+            auto& e = setups[i];
+            const std::string& instance_name = e.m_pinstance->get_instance_name();
+            try {
+                //the instances share the forwarding maps, their routes are keyed with the table number
+                std::shared_ptr<mroute_socket> mrt_sock;
+                if (!m_xdp_pin_path.empty()) {
+                    mrt_sock = std::make_shared<xdp_mroute_socket>(m_xdp_pin_path, e.m_table_number);
+                    if (!(is_IPv4(m_configuration->get_group_mem_protocol()) ? mrt_sock->create_raw_ipv4_socket() : mrt_sock->create_raw_ipv6_socket())) {
+                        throw "failed to initialize mroute socket";
+                    }
+                }
+
+                e.m_proxy_instance.reset(new proxy_instance(m_configuration->get_group_mem_protocol(), instance_name, e.m_table_number, m_configuration->get_interfaces_for_pinstance(instance_name), e.m_timing, false, m_querier_shards, m_explicit_tracking, m_group_sharding, m_native_reports, m_event_trace, mrt_sock));
+            } catch (const char* err) {
+                HC_LOG_ERROR("failed to start proxy instance " << instance_name << ": " << err);
+                std::lock_guard<std::mutex> lock(error_lock);
+                error = error == nullptr ? err : error;
+            }
+        }
+    };
 
-        std::unique_ptr<proxy_instance> pr_i(new proxy_instance(m_configuration->get_group_mem_protocol(), instance_name, table_number, interfaces, m_timing));
+    unsigned int thread_count = std::min<unsigned int>(setups.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < thread_count; ++i) {
+        threads.push_back(std::thread(construct));
+    }
+    construct();
+    for (auto & t : threads) {
+        t.join();
+    }
+
+    if (error != nullptr) {
+        throw error;
+    }
+
+    //the instance workers set up their interfaces in parallel, each one binds its interfaces to its table in batches
+    for (auto & e : setups) {
+        auto& pr_i = e.m_proxy_instance;
+        auto& pinstance = e.m_pinstance;
+        const std::string& instance_name = pinstance->get_instance_name();
+
+        pr_i->set_timer_slack(m_timer_slack);
+        pr_i->set_report_pacing(m_report_pacing);
+
+        auto& upstreams = pinstance->get_upstreams();
+        auto& downstreams = pinstance->get_downstreams();
 
         //global rule bindung      
         auto& global_settings = pinstance->get_global_settings();
@@ -256,11 +538,210 @@ void proxy::start_proxy_instances()
             pr_i->add_msg(std::make_shared<config_msg>(config_msg::ADD_DOWNSTREAM, if_index, d, tv));
         }
 
-        m_proxy_instances.insert(std::pair<int, std::unique_ptr<proxy_instance>>(table_number, std::move(pr_i)));
+        m_proxy_instances.insert(std::pair<int, std::unique_ptr<proxy_instance>>(e.m_table_number, std::move(pr_i)));
+        m_instance_tables[instance_name] = e.m_table_number;
+    }
+}
+
+bool proxy::reload_configuration()
+{
+    HC_LOG_TRACE("");
+
+    //the reverse path filters of new interfaces are reset by the interfaces of the running configuration
+    std::unique_ptr<configuration> next;
+    try {
+        next.reset(new configuration(m_config_path, false));
+    } catch (const char* e) {
+        HC_LOG_ERROR("failed to reload the configuration file " << m_config_path << ": " << e);
+        return false;
+    }
+
+    if (next->get_group_mem_protocol() != m_configuration->get_group_mem_protocol()) {
+        HC_LOG_ERROR("failed to reload the configuration, the protocol cannot be changed without a restart");
+        return false;
+    }
+
+    auto& running_set = m_configuration->get_inst_def_set();
+    auto& next_set = next->get_inst_def_set();
+    if (running_set.size() != next_set.size()) {
+        HC_LOG_ERROR("failed to reload the configuration, proxy instances cannot be added or deleted without a restart");
+        return false;
+    }
+
+    for (auto & e : next_set) {
+        auto it = running_set.find(e->get_instance_name());
+        if (it == running_set.end()) {
+            HC_LOG_ERROR("failed to reload the configuration, proxy instances cannot be added or deleted without a restart");
+            return false;
+        }
+
+        if ((*it)->get_user_selected_table_number() != e->get_user_selected_table_number() || (e->get_user_selected_table_number() && (*it)->get_table_number() != e->get_table_number())) {
+            HC_LOG_ERROR("failed to reload the configuration, the table of proxy instance " << e->get_instance_name() << " cannot be changed without a restart");
+            return false;
+        }
+    }
+
+    if (!next->adopt_interfaces(*m_configuration)) {
+        HC_LOG_ERROR("failed to reload the configuration, the interfaces cannot be added without a restart");
+        return false;
+    }
+
+    //the rule bindings refer to the tables by name
+    bool tables_changed = next->get_global_table_set()->to_string() != m_configuration->get_global_table_set()->to_string();
+
+    for (auto & e : next_set) {
+        auto& pr_i = m_proxy_instances[m_instance_tables[e->get_instance_name()]];
+        reload_proxy_instance(*pr_i, **running_set.find(e->get_instance_name()), *e, tables_changed);
+    }
+
+    m_configuration = std::move(next);
+    HC_LOG_DEBUG("configuration reloaded: " << m_config_path);
+    return true;
+}
+
+void proxy::reload_proxy_instance(proxy_instance& pr_i, const instance_definition& running, const instance_definition& next, bool tables_changed)
+{
+    HC_LOG_TRACE("");
+
+    using if_list = std::list<std::shared_ptr<interface>>;
+    auto find = [](const if_list& l, const std::shared_ptr<interface>& interf) {
+        return std::find_if(l.begin(), l.end(), [&](const std::shared_ptr<interface>& e) {
+            return e->get_if_name() == interf->get_if_name();
+        });
+    };
+
+    auto is_changed = [&](const std::shared_ptr<interface>& from, const std::shared_ptr<interface>& to) {
+        return from->to_string_rule_binding() != to->to_string_rule_binding() || (tables_changed && (from->has_filter() || to->has_filter()));
+    };
+
+    auto to_string_global_settings = [](const instance_definition& id) {
+        std::ostringstream s;
+        for (auto & e : id.get_global_settings()) {
+            s << e->to_string() << std::endl;
+        }
+        return s.str();
+    };
+
+    //global rule bindings, the defaults of the proxy instance are restored first
+    if (to_string_global_settings(running) != to_string_global_settings(next)) {
+        pr_i.add_msg(std::make_shared<config_msg>(config_msg::SET_GLOBAL_RULE_BINDING, std::make_shared<rule_binding>(next.get_instance_name(), IT_UPSTREAM, "*", ID_IN, RMT_FIRST, std::chrono::milliseconds(0))));
+        pr_i.add_msg(std::make_shared<config_msg>(config_msg::SET_GLOBAL_RULE_BINDING, std::make_shared<rule_binding>(next.get_instance_name(), IT_UPSTREAM, "*", ID_OUT, RMT_ALL, std::chrono::milliseconds(0))));
+        for (auto & r : next.get_global_settings()) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::SET_GLOBAL_RULE_BINDING, r));
+        }
+    }
+
+    //del downstream
+    for (auto & d : running.get_downstreams()) {
+        if (find(next.get_downstreams(), d) == next.get_downstreams().end()) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::DEL_DOWNSTREAM, interfaces::get_if_index(d->get_if_name()), 0, d));
+        }
+    }
+
+    //del upstream
+    for (auto & u : running.get_upstreams()) {
+        if (find(next.get_upstreams(), u) == next.get_upstreams().end()) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::DEL_UPSTREAM, interfaces::get_if_index(u->get_if_name()), 0, u));
+        }
+    }
+
+    //add or set upstream, the priorities follow the new order
+    unsigned int upstream_priority = 0;
+    for (auto & u : next.get_upstreams()) {
+        unsigned int if_index = interfaces::get_if_index(u->get_if_name());
+        auto it = find(running.get_upstreams(), u);
+        if (it == running.get_upstreams().end()) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::ADD_UPSTREAM, if_index, upstream_priority, u));
+        } else if (is_changed(*it, u) || static_cast<unsigned int>(std::distance(running.get_upstreams().begin(), it)) * get_default_priority_interval() != upstream_priority) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::SET_UPSTREAM, if_index, upstream_priority, u));
+        }
+        upstream_priority += get_default_priority_interval();
+    }
+
+    //add or set downstream
+    for (auto & d : next.get_downstreams()) {
+        unsigned int if_index = interfaces::get_if_index(d->get_if_name());
+        auto it = find(running.get_downstreams(), d);
+        if (it == running.get_downstreams().end()) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::ADD_DOWNSTREAM, if_index, d, timers_values()));
+        } else if (is_changed(*it, d)) {
+            pr_i.add_msg(std::make_shared<config_msg>(config_msg::SET_DOWNSTREAM, if_index, 0, d));
+        }
+    }
+}
+
+void proxy::restore_checkpoint()
+{
+    HC_LOG_TRACE("");
+
+    if (m_checkpoint_path.empty()) {
+        return;
+    }
+
+    std::vector<std::shared_ptr<const proxy_snapshot>> snapshots;
+    std::chrono::milliseconds elapsed;
+    if (!checkpoint::read(m_checkpoint_path, snapshots, elapsed)) {
+        return;
+    }
+
+    //the queriers drop the groups whose timers would have expired meanwhile
+    for (auto & e : snapshots) {
+        auto it = m_instance_tables.find(e->instance_name);
+        if (it != std::end(m_instance_tables)) {
+            m_proxy_instances[it->second]->add_msg(std::make_shared<restore_msg>(e, elapsed));
+        } else {
+            HC_LOG_WARN("failed to restore proxy instance " << e->instance_name << " from checkpoint, instance not found");
+        }
+    }
+}
+
+void proxy::write_checkpoint(bool force)
+{
+    HC_LOG_TRACE("");
+
+    if (m_checkpoint_path.empty()) {
+        return;
+    }
 
+    auto now = std::chrono::steady_clock::now();
+    if (!force && now - m_last_checkpoint < std::chrono::seconds(CHECKPOINT_INTERVAL)) {
+        return;
+    }
+
+    //written even if the state has not changed, the age of the checkpoint bounds the restored timers
+    std::vector<std::shared_ptr<const proxy_snapshot>> snapshots;
+    for (auto & e : m_proxy_instances) {
+        auto snapshot = e.second->get_snapshot();
+        if (snapshot != nullptr) {
+            snapshots.push_back(std::move(snapshot));
+        }
     }
 
+    m_last_checkpoint = now;
+    checkpoint::write(m_checkpoint_path, snapshots);
+}
+
+void proxy::handle_interface_changes(const std::set<unsigned int>& up, const std::set<unsigned int>& down, bool addresses_changed)
+{
+    HC_LOG_TRACE("");
+
+    //an interface may have been renamed
+    interfaces::refresh_if_names();
+
+    //the subnets and the source addresses of the senders follow the new addresses
+    if (addresses_changed && !interfaces::refresh_network_interfaces()) {
+        HC_LOG_ERROR("failed to refresh the network interfaces");
+    }
 
+    //the proxy instances are not added or deleted while the monitor is running
+    for (auto & e : m_proxy_instances) {
+        for (auto if_index : down) {
+            e.second->add_msg(std::make_shared<config_msg>(config_msg::LINK_DOWN, if_index, 0, nullptr));
+        }
+        for (auto if_index : up) {
+            e.second->add_msg(std::make_shared<config_msg>(config_msg::LINK_UP, if_index, 0, nullptr));
+        }
+    }
 }
 
 void proxy::start()
@@ -278,16 +759,30 @@ void proxy::start()
     while (m_running) {
 
         if (m_print_proxy_status) {
+            //read the published snapshots, the proxy instances are not interrupted
             for (auto & e : m_proxy_instances) {
-                e.second->add_msg(std::make_shared<debug_msg>());
-                sleep(2);
+                cout << *e.second->get_snapshot() << endl;
+                wait(std::chrono::seconds(2));
             }
         } else {
-            sleep(2);
+            wait(get_checkpoint_timeout());
         }
 
+        if (m_reload) {
+            m_reload = false;
+            reload_configuration();
+        }
+
+        write_checkpoint(false);
     }
 
+    //the last state for a warm restart
+    write_checkpoint(true);
+
+    m_control_socket.reset();
+
+    m_interface_monitor.reset();
+
 
     //kill all proxy_instances
     std::for_each(begin(m_proxy_instances), end(m_proxy_instances), [](pair<const int, std::unique_ptr<proxy_instance>>& e) {
@@ -411,9 +906,168 @@ void proxy::start()
 
 }
 
-void proxy::signal_handler(int)
+std::chrono::milliseconds proxy::get_checkpoint_timeout() const
 {
-    proxy::m_running = false;
+    HC_LOG_TRACE("");
+
+    if (m_checkpoint_path.empty()) {
+        return std::chrono::milliseconds(-1);
+    }
+
+    auto remaining = m_last_checkpoint + std::chrono::seconds(CHECKPOINT_INTERVAL) - std::chrono::steady_clock::now();
+    return std::max(std::chrono::milliseconds(0), std::chrono::duration_cast<std::chrono::milliseconds>(remaining) + std::chrono::milliseconds(1));
+}
+
+void proxy::wait(std::chrono::milliseconds timeout) const
+{
+    HC_LOG_TRACE("");
+
+    auto until = std::chrono::steady_clock::now() + timeout;
+    while (m_running && !m_reload) {
+        int poll_timeout = -1;
+        if (timeout.count() >= 0) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                return;
+            }
+            poll_timeout = remaining.count();
+        }
+
+        struct pollfd pfds[2];
+        pfds[0].fd = m_signal_pipe[0];
+        pfds[0].events = POLLIN;
+        pfds[1].fd = m_control_socket != nullptr ? m_control_socket->get_fd() : -1;
+        pfds[1].events = POLLIN;
+
+        if (poll(pfds, 2, poll_timeout) < 0 && errno != EINTR) {
+            HC_LOG_ERROR("failed to wait in the main loop! Error: " << strerror(errno) << " errno: " << errno);
+            return;
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            char buf[64];
+            while (read(m_signal_pipe[0], buf, sizeof(buf)) > 0) {
+            }
+        }
+
+        if (m_control_socket != nullptr && (pfds[1].revents & POLLIN)) {
+            m_control_socket->handle_requests();
+        }
+    }
+}
+
+std::string proxy::handle_control_command(const std::vector<std::string>& args)
+{
+    HC_LOG_TRACE("");
+
+    const std::string& cmd = args.front();
+    if (cmd == "status" && args.size() == 1) {
+        return control_status();
+    } else if (cmd == "dump" && args.size() <= 2) {
+        return control_dump(args.size() == 2 ? args[1] : std::string());
+    } else if (cmd == "metrics" && args.size() == 1) {
+        return metrics::to_string();
+    } else if (cmd == "reload" && args.size() == 1) {
+        return reload_configuration() ? "ok\n" : "error reload failed, see the log\n";
+    } else {
+        return "error unknown command, use status, dump [<instance>], metrics or reload\n";
+    }
+}
+
+std::string proxy::control_status() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    //one record per line: record type followed by key=value pairs
+    s << "proxy instances=" << m_proxy_instances.size();
+    s << " uptime=" << std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_start_time).count();
+    s << " protocol=" << get_group_mem_protocol_name(m_configuration->get_group_mem_protocol()) << std::endl;
+
+    for (auto & e : m_proxy_instances) {
+        auto snapshot = e.second->get_snapshot();
+        if (snapshot == nullptr) {
+            continue;
+        }
+
+        unsigned int groups = 0;
+        for (auto & d : snapshot->downstreams) {
+            groups += d->groups.size();
+        }
+
+        s << "instance name=" << snapshot->instance_name << " table=" << snapshot->table_number << " version=" << snapshot->version;
+        s << " upstreams=";
+        for (auto it = std::begin(snapshot->upstreams); it != std::end(snapshot->upstreams); ++it) {
+            s << (it != std::begin(snapshot->upstreams) ? "," : "") << interfaces::get_if_name(*it);
+        }
+        s << " downstreams=" << snapshot->downstreams.size() << " groups=" << groups;
+        s << " routes=" << (snapshot->routes != nullptr ? snapshot->routes->size() : 0) << std::endl;
+    }
+
+    s << thread_settings::to_string();
+    return s.str();
+}
+
+std::string proxy::control_dump(const std::string& instance_name) const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    auto to_string = [](const source_list<mc_addr>& slist) {
+        std::ostringstream s;
+        for (auto it = std::begin(slist); it != std::end(slist); ++it) {
+            s << (it != std::begin(slist) ? "," : "") << *it;
+        }
+        return s.str();
+    };
+
+    bool found = false;
+    for (auto & e : m_proxy_instances) {
+        auto snapshot = e.second->get_snapshot();
+        if (snapshot == nullptr || (!instance_name.empty() && snapshot->instance_name != instance_name)) {
+            continue;
+        }
+        found = true;
+
+        for (auto & d : snapshot->downstreams) {
+            s << "downstream instance=" << snapshot->instance_name << " if=" << interfaces::get_if_name(d->if_index);
+            s << " protocol=" << get_group_mem_protocol_name(d->querier_version_mode) << " querier=" << d->is_querier << std::endl;
+
+            for (auto & g : d->groups) {
+                s << "group instance=" << snapshot->instance_name << " if=" << interfaces::get_if_name(d->if_index) << " gaddr=" << g->gaddr;
+                s << " mode=" << get_mc_filter_name(g->filter_mode) << " compatibility=" << get_group_mem_protocol_name(g->compatibility_mode);
+                s << " include=" << to_string(g->include_requested_list) << " exclude=" << to_string(g->exclude_list) << std::endl;
+            }
+        }
+
+        if (snapshot->routes != nullptr) {
+            for (auto & r : *snapshot->routes) {
+                s << "source instance=" << snapshot->instance_name << " if=" << interfaces::get_if_name(r.input_if_index);
+                s << " gaddr=" << r.gaddr << " saddr=" << r.saddr << std::endl;
+            }
+        }
+    }
+
+    if (!found && !instance_name.empty()) {
+        return "error unknown instance " + instance_name + "\n";
+    }
+
+    return s.str();
+}
+
+void proxy::signal_handler(int sig)
+{
+    if (sig == SIGHUP) {
+        proxy::m_reload = true;
+    } else {
+        proxy::m_running = false;
+    }
+
+    //wake the main loop, write() is async-signal-safe
+    int saved_errno = errno;
+    ssize_t rc = write(m_signal_pipe[1], "s", 1);
+    static_cast<void>(rc);
+    errno = saved_errno;
 }
 
 std::string proxy::to_string() const
@@ -427,6 +1081,19 @@ std::string proxy::to_string() const
     s << "print proxy_status information: " << m_print_proxy_status << endl;
     s << "reset all reverse path filter: " << m_reset_rp_filter << endl;
     s << "config path: " << m_config_path << endl;
+    s << "timer slack: " << m_timer_slack.count() << "msec" << endl;
+    s << "querier threads per instance: " << m_querier_shards << endl;
+    s << "explicit tracking: " << m_explicit_tracking << endl;
+    s << "native upstream reports: " << m_native_reports << endl;
+    s << "report pacing: ";
+    if (m_report_pacing.is_enabled()) {
+        s << m_report_pacing.interval.count() << "msec, " << m_report_pacing.rate << " records/sec" << endl;
+    } else {
+        s << "disabled" << endl;
+    }
+    s << "checkpoint file: " << (m_checkpoint_path.empty() ? "disabled" : m_checkpoint_path) << endl;
+    s << "event trace: " << (m_trace_path.empty() ? "disabled" : m_trace_path) << endl;
+    s << "control socket: " << (m_control_path.empty() ? "disabled" : m_control_path) << endl;
 
     s << "-- proxy configuration --" << endl;
     s << m_configuration.get()->to_string() << endl;
@@ -36,6 +36,10 @@
 #include "include/proxy/timing.hpp"
 #include "include/proxy/routing_management.hpp"
 #include "include/proxy/simple_mc_proxy_routing.hpp"
+#include "include/proxy/querier_shard.hpp"
+#include "include/proxy/event_trace.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/proxy/timers_values.hpp"
 
 #include <sstream>
 #include <iostream>
@@ -45,25 +49,37 @@
 #include <unistd.h>
 #include <net/if.h>
 
-proxy_instance::proxy_instance(group_mem_protocol group_mem_protocol, const std::string& instance_name, int table_number, const std::shared_ptr<const interfaces>& interfaces, const std::shared_ptr<timing>& shared_timing, bool in_debug_testing_mode)
+proxy_instance::proxy_instance(group_mem_protocol group_mem_protocol, const std::string& instance_name, int table_number, const std::shared_ptr<const interfaces>& interfaces, const std::shared_ptr<timing>& shared_timing, bool in_debug_testing_mode, unsigned int querier_shards, bool explicit_tracking, bool group_sharding, bool native_reports, const std::shared_ptr<event_trace>& trace, const std::shared_ptr<mroute_socket>& mrt_sock, const std::shared_ptr<sender>& snd)
 : m_group_mem_protocol(group_mem_protocol)
 , m_instance_name(instance_name)
 , m_table_number(table_number)
 , m_in_debug_testing_mode(in_debug_testing_mode)
+, m_explicit_tracking(explicit_tracking)
+, m_group_sharding(group_sharding && querier_shards > 0)
+, m_native_reports(native_reports)
 , m_interfaces(interfaces)
 , m_timing(shared_timing)
-, m_mrt_sock(nullptr)
-, m_sender(nullptr)
+, m_event_trace(trace)
+, m_mrt_sock(mrt_sock)
+, m_sender(snd)
 , m_receiver(nullptr)
 , m_routing(nullptr)
 , m_proxy_start_time(std::chrono::steady_clock::now())
 , m_upstream_input_rule(std::make_shared<rule_binding>(instance_name, IT_UPSTREAM, "*", ID_IN, RMT_FIRST, std::chrono::milliseconds(0)))
 , m_upstream_output_rule(std::make_shared<rule_binding>(instance_name, IT_UPSTREAM, "*", ID_OUT, RMT_ALL, std::chrono::milliseconds(0)))
+, m_query_jitter(std::random_device()())
+, m_route_changes(0)
+, m_route_failures(0)
+, m_route_max_latency_usec(0)
 {
 
     //rule_binding(const std::string& instance_name, rb_interface_type interface_type, const std::string& if_name, rb_interface_direction filter_direction, rb_rule_matching_type rule_matching_type, const std::chrono::milliseconds& timeout);
     HC_LOG_TRACE("");
 
+    //repeated reports and kernel upcalls are merged, a flood of them is dropped
+    set_queue_policy(proxy_msg::GROUP_RECORD_MSG, MQ_MERGE);
+    set_queue_policy(proxy_msg::NEW_SOURCE_MSG, MQ_MERGE);
+
     if (!init_mrt_socket()) {
         throw "failed to initialize mroute socket";
     }
@@ -72,6 +88,10 @@ proxy_instance::proxy_instance(group_mem_protocol group_mem_protocol, const std:
         throw "failed to initialize sender";
     }
 
+    for (unsigned int i = 0; i < querier_shards; ++i) {
+        m_shards.push_back(std::unique_ptr<querier_shard>(new querier_shard(this, m_sender, m_event_trace)));
+    }
+
     if (!init_receiver()) {
         throw "failed to initialise receiver";
     }
@@ -84,20 +104,25 @@ proxy_instance::proxy_instance(group_mem_protocol group_mem_protocol, const std:
         throw "failed to initialise routing";
     }
 
-    start();
+    publish_snapshot();
+    start(TR_INSTANCE, "mcp-" + m_instance_name);
 }
 
 bool proxy_instance::init_mrt_socket()
 {
     HC_LOG_TRACE("");
-    m_mrt_sock = std::make_shared<mroute_socket>();
-    if (is_IPv4(m_group_mem_protocol)) {
-        m_mrt_sock->create_raw_ipv4_socket();
-    } else if (is_IPv6(m_group_mem_protocol)) {
-        m_mrt_sock->create_raw_ipv6_socket();
-    } else {
-        HC_LOG_ERROR("unknown ip version");
-        return false;
+
+    //an injected socket is already created
+    if (m_mrt_sock == nullptr) {
+        m_mrt_sock = std::make_shared<mroute_socket>();
+        if (is_IPv4(m_group_mem_protocol)) {
+            m_mrt_sock->create_raw_ipv4_socket();
+        } else if (is_IPv6(m_group_mem_protocol)) {
+            m_mrt_sock->create_raw_ipv6_socket();
+        } else {
+            HC_LOG_ERROR("unknown ip version");
+            return false;
+        }
     }
 
     if (m_table_number > 0) {
@@ -112,16 +137,25 @@ bool proxy_instance::init_mrt_socket()
         return false;
     }
 
+    //the first packet of a source outside of the input interface of a wildcard route has to be reported
+    if (m_mrt_sock->is_wildcard_mroute_supported() && !m_mrt_sock->set_assert(true)) {
+        return false;
+    }
+
     return true;
 }
 
 bool proxy_instance::init_sender()
 {
     HC_LOG_TRACE("");
+    if (m_sender != nullptr) { //injected
+        return true;
+    }
+
     if (is_IPv4(m_group_mem_protocol)) {
-        m_sender = std::make_shared<igmp_sender>(m_interfaces);
+        m_sender = std::make_shared<igmp_sender>(m_interfaces, m_native_reports);
     } else if (is_IPv6(m_group_mem_protocol)) {
-        m_sender = std::make_shared<mld_sender>(m_interfaces);
+        m_sender = std::make_shared<mld_sender>(m_interfaces, m_native_reports);
     } else {
         HC_LOG_ERROR("unknown ip version");
         return false;
@@ -150,9 +184,26 @@ bool proxy_instance::init_routing()
 {
     HC_LOG_TRACE("");
     m_routing.reset(new routing(get_addr_family(m_group_mem_protocol), m_mrt_sock, m_interfaces, m_table_number));
+    m_routing->set_route_callback(std::bind(&proxy_instance::route_completed, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
     return true;
 }
 
+void proxy_instance::route_completed(const mc_addr& /*gaddr*/, const mc_addr& /*saddr*/, bool /*add*/, bool success, const std::chrono::steady_clock::duration& latency)
+{
+    HC_LOG_TRACE("");
+
+    //the mroute socket logs the refused changes
+    ++m_route_changes;
+    if (!success) {
+        ++m_route_failures;
+    }
+
+    long long usec = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    long long max = m_route_max_latency_usec;
+    while (usec > max && !m_route_max_latency_usec.compare_exchange_weak(max, usec)) {
+    }
+}
+
 bool proxy_instance::init_routing_management()
 {
     HC_LOG_TRACE("");
@@ -163,73 +214,557 @@ bool proxy_instance::init_routing_management()
 proxy_instance::~proxy_instance()
 {
     HC_LOG_TRACE("");
+    set_timer_slack(std::chrono::milliseconds(0));
     add_msg(std::make_shared<exit_cmd>());
+
+    //join here, the worker thread uses the members of this class
+    join();
+    m_thread.reset();
+
+    //the receiver looks up the querier workers in m_shards, no packet is delivered after its socket is removed
+    m_receiver.reset();
+
+    //the timer thread holds the reminders of this instance and its shards, they must not be delivered after the
+    //workers are gone, so the shards are stopped first and cannot arm new timers
+    m_timing->stop_all_time(this);
+    for (auto & e : m_shards) {
+        e->shutdown();
+        m_timing->stop_all_time(e.get());
+    }
+    m_shards.clear();
+}
+
+void proxy_instance::set_timer_slack(const std::chrono::milliseconds& slack)
+{
+    HC_LOG_TRACE("");
+    m_timing->set_slack(this, slack);
+
+    for (auto & e : m_shards) {
+        m_timing->set_slack(e.get(), slack);
+    }
+}
+
+void proxy_instance::set_report_pacing(const report_pacing& pacing)
+{
+    HC_LOG_TRACE("");
+
+    if (pacing.is_enabled()) {
+        m_report_pacer.reset(new report_pacer(m_sender, pacing));
+    } else {
+        m_report_pacer.reset();
+    }
+}
+
+unsigned int proxy_instance::get_slice_count() const
+{
+    HC_LOG_TRACE("");
+    return m_group_sharding ? m_shards.size() : 1;
+}
+
+unsigned int proxy_instance::get_slice(const mc_addr& gaddr) const
+{
+    HC_LOG_TRACE("");
+    return m_group_sharding ? gaddr.hash() % m_shards.size() : 0;
+}
+
+querier_shard* proxy_instance::get_shard(unsigned int if_index, unsigned int slice) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_shards.empty()) {
+        return nullptr;
+    } else if (m_group_sharding) {
+        return m_shards[slice].get();
+    } else {
+        return m_shards[if_index % m_shards.size()].get();
+    }
+}
+
+const worker* proxy_instance::get_querier_worker(unsigned int if_index) const
+{
+    HC_LOG_TRACE("");
+
+    querier_shard* shard = get_shard(if_index);
+    if (shard == nullptr) {
+        return this;
+    } else {
+        return shard;
+    }
+}
+
+const worker* proxy_instance::get_querier_worker(unsigned int if_index, const mc_addr& gaddr) const
+{
+    HC_LOG_TRACE("");
+
+    querier_shard* shard = get_shard(if_index, get_slice(gaddr));
+    if (shard == nullptr) {
+        return this;
+    } else {
+        return shard;
+    }
+}
+
+std::unique_lock<std::mutex> proxy_instance::lock_querier(unsigned int if_index, unsigned int slice) const
+{
+    HC_LOG_TRACE("");
+
+    querier_shard* shard = get_shard(if_index, slice);
+    if (shard == nullptr) {
+        return std::unique_lock<std::mutex>();
+    } else {
+        return std::unique_lock<std::mutex>(shard->get_lock());
+    }
+}
+
+std::unique_lock<std::mutex> proxy_instance::lock_querier(unsigned int if_index, const mc_addr& gaddr) const
+{
+    HC_LOG_TRACE("");
+    return lock_querier(if_index, get_slice(gaddr));
 }
 
 void proxy_instance::worker_thread()
 {
     HC_LOG_TRACE("");
+
+    std::vector<std::shared_ptr<proxy_msg>> batch;
+    batch.reserve(PROXY_INSTANCE_BATCH_SIZE);
+
     while (m_running) {
-        auto msg = m_job_queue.dequeue();
-        switch (msg->get_type()) {
-        case proxy_msg::TEST_MSG:
-            (*msg)();
-            break;
-        case proxy_msg::CONFIG_MSG:
-            handle_config(std::static_pointer_cast<config_msg>(msg));
-            break;
-        case proxy_msg::FILTER_TIMER_MSG:
-        case proxy_msg::SOURCE_TIMER_MSG:
-        case proxy_msg::RET_GROUP_TIMER_MSG:
-        case proxy_msg::RET_SOURCE_TIMER_MSG:
-        case proxy_msg::OLDER_HOST_PRESENT_TIMER_MSG:
-        case proxy_msg::GENERAL_QUERY_TIMER_MSG: {
-            auto it = m_downstreams.find(std::static_pointer_cast<timer_msg>(msg)->get_if_index());
-            if (it != std::end(m_downstreams)) {
-                it->second.m_querier->timer_triggerd(msg);
+        m_job_queue.dequeue_batch(batch, PROXY_INSTANCE_BATCH_SIZE);
+
+        for (auto & msg : batch) {
+            if (!m_running) {
+                break;
+            }
+
+            if (m_event_trace != nullptr) {
+                m_event_trace->record(msg);
+            }
+
+            if (is_merged(msg)) {
+                ++m_merged_msgs;
             } else {
-                HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<timer_msg>(msg)->get_if_index()));
+                metrics::set_origin(msg->get_origin());
+                handle_msg(msg);
             }
         }
-        break;
-        case proxy_msg::GROUP_RECORD_MSG: {
-            auto r =  std::static_pointer_cast<group_record_msg>(msg);
 
-            if (m_in_debug_testing_mode) {
-                std::cout << "!!--ACTION: receive record" << std::endl;
-                std::cout << *r << std::endl;
-                std::cout << std::endl;
-            }
+        metrics::set_origin(std::chrono::steady_clock::time_point());
+
+        batch.clear();
+        m_batch_records.clear();
+        m_batch_sources.clear();
+        flush_queries();
+        flush_state_changes();
+        flush_reports();
+        m_routing->flush_routes();
+        publish_snapshot();
+    }
+
+    HC_LOG_DEBUG("worker thread proxy_instance end");
+}
+
+void proxy_instance::querier_state_change(unsigned int if_index, const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+    metrics::add_latency(LATENCY_QUERIER);
+    add_pending_state_change(if_index, gaddr, metrics::get_origin());
+}
 
-            auto it = m_downstreams.find(r->get_if_index());
-            if (it != std::end(m_downstreams)) {
-                it->second.m_querier->receive_record(msg);
+void proxy_instance::add_pending_state_change(unsigned int if_index, const mc_addr& gaddr, const std::chrono::steady_clock::time_point& origin)
+{
+    HC_LOG_TRACE("");
+
+    auto rc = m_pending_state_changes.insert(std::make_pair(gaddr, std::make_pair(if_index, origin)));
+    if (!rc.second) {
+        rc.first->second.second = metrics::earliest_origin(rc.first->second.second, origin);
+    }
+}
+
+void proxy_instance::flush_queries()
+{
+    HC_LOG_TRACE("");
+
+    //the querier shards flush their queriers themselves
+    for (auto & e : m_downstreams) {
+        if (get_shard(e.first) == nullptr) {
+            e.second.m_queriers.front()->flush_queries();
+        }
+    }
+
+    m_sender->flush_packets();
+}
+
+void proxy_instance::flush_reports()
+{
+    HC_LOG_TRACE("");
+
+    //a pending flush of the pacer is due before the records queued since then
+    if (m_report_pacer != nullptr && m_report_pacing == nullptr && m_report_pacer->has_pending()) {
+        auto delay = m_report_pacer->flush();
+        if (delay.count() > 0) {
+            m_report_pacing = make_pooled_msg<upstream_report_timer_msg>(0, mc_addr(), false, delay);
+            m_report_pacing->set_handle(m_timing->add_time(delay, this, m_report_pacing));
+        }
+    }
+
+    if (!m_native_reports) {
+        return;
+    }
+
+    m_sender->flush_packets();
+
+    if (m_report_retransmission == nullptr && m_sender->has_retransmissions()) {
+        auto delay = timers_values().get_unsolicited_report_interval();
+        m_report_retransmission = make_pooled_msg<upstream_report_timer_msg>(0, mc_addr(), false, delay);
+        m_report_retransmission->set_handle(m_timing->add_time(delay, this, m_report_retransmission));
+    }
+}
+
+void proxy_instance::handle_upstream_query(const std::shared_ptr<upstream_query_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    unsigned int if_index = msg->get_if_index();
+    if (!m_native_reports || !is_upstream(if_index)) {
+        return;
+    }
+
+    //answer after a random delay within the maximum response time (RFC 3376 5.2, RFC 3810 6.2)
+    long long max_resp_time = msg->get_max_resp_time().count();
+    std::chrono::milliseconds delay(max_resp_time > 0 ? std::uniform_int_distribution<long long>(0, max_resp_time - 1)(m_query_jitter) : 0);
+
+    //a pending answer to a general query that is sent before the delay includes every group
+    auto it = m_upstream_reports.find(if_index);
+    if (it != std::end(m_upstream_reports) && !it->second->is_remaining_time_greater_than(delay)) {
+        return;
+    }
+
+    bool general = msg->get_gaddr() == mc_addr(addr_storage(get_addr_family(m_group_mem_protocol)));
+    auto report = make_pooled_msg<upstream_report_timer_msg>(if_index, msg->get_gaddr(), general, delay);
+    if (general) {
+        m_upstream_reports[if_index] = report;
+    }
+
+    report->set_handle(m_timing->add_time(delay, this, report));
+}
+
+void proxy_instance::handle_querier_query(const std::shared_ptr<querier_query_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    auto it = m_downstreams.find(msg->get_if_index());
+    if (it == std::end(m_downstreams)) {
+        return;
+    }
+
+    unsigned int first = 0;
+    unsigned int last = it->second.m_queriers.size();
+    if (msg->get_gaddr().is_multicast_addr()) {
+        first = get_slice(msg->get_gaddr());
+        last = first + 1;
+    }
+
+    for (unsigned int i = first; i < last; ++i) {
+        querier_shard* shard = get_shard(msg->get_if_index(), i);
+        if (shard == nullptr) {
+            it->second.m_queriers[i]->receive_query(msg);
+        } else {
+            shard->add_msg(msg);
+        }
+    }
+}
+
+void proxy_instance::handle_upstream_report(const std::shared_ptr<upstream_report_timer_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    unsigned int if_index = msg->get_if_index();
+
+    if (msg == m_report_retransmission) {
+        m_report_retransmission = nullptr;
+        m_sender->retransmit_state_changes();
+        return;
+    }
+
+    //the paced records are sent by flush_reports() after this batch
+    if (msg == m_report_pacing) {
+        m_report_pacing = nullptr;
+        return;
+    }
+
+    if (!msg->is_general()) {
+        if (is_upstream(if_index)) {
+            m_sender->send_current_state(if_index, addr_storage(msg->get_gaddr()));
+        }
+        return;
+    }
+
+    auto it = m_upstream_reports.find(if_index);
+    if (it == std::end(m_upstream_reports) || it->second != msg) {
+        HC_LOG_DEBUG("outdated upstream report timer");
+        return;
+    }
+
+    //the answer is paced in steps of PROXY_INSTANCE_REPORT_RECORDS, each step continues after the last reported group
+    addr_storage gaddr = msg->get_gaddr();
+    if (is_upstream(if_index) && m_sender->send_current_state(if_index, gaddr, PROXY_INSTANCE_REPORT_RECORDS)) {
+        std::chrono::milliseconds pace(PROXY_INSTANCE_REPORT_PACE_MSEC);
+        it->second = make_pooled_msg<upstream_report_timer_msg>(if_index, gaddr, true, pace);
+        it->second->set_handle(m_timing->add_time(pace, this, it->second));
+    } else {
+        m_upstream_reports.erase(it);
+    }
+}
+
+void proxy_instance::flush_state_changes()
+{
+    HC_LOG_TRACE("");
+
+    //the routes and reports of a state change are traced back to its group record
+    auto origin = metrics::get_origin();
+    for (auto & e : m_pending_state_changes) {
+        metrics::set_origin(e.second.second);
+        m_routing_management->event_querier_state_change(e.second.first, e.first);
+        metrics::add_latency(LATENCY_ROUTING);
+    }
+    metrics::set_origin(origin);
+
+    m_pending_state_changes.clear();
+}
+
+void proxy_instance::publish_snapshot()
+{
+    HC_LOG_TRACE("");
+
+    auto last = std::atomic_load(&m_snapshot);
+
+    std::vector<unsigned int> upstreams;
+    upstreams.reserve(m_upstreams.size());
+    for (auto & e : m_upstreams) {
+        upstreams.push_back(e.m_if_index);
+    }
+
+    //only the queriers whose state version changed are locked, the others keep their last snapshot,
+    //so the querier shards are not stalled after each batch
+    std::vector<std::shared_ptr<const downstream_snapshot>> downstreams;
+    downstreams.reserve(m_downstreams.size());
+    for (auto & e : m_downstreams) {
+        for (unsigned int i = 0; i < e.second.m_queriers.size(); ++i) {
+            auto& q = e.second.m_queriers[i];
+            std::size_t pos = downstreams.size();
+            if (last != nullptr && pos < last->downstreams.size() && last->downstreams[pos]->if_index == e.first && last->downstreams[pos]->version == q->get_state_version()) {
+                downstreams.push_back(last->downstreams[pos]);
             } else {
-                HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<timer_msg>(msg)->get_if_index()));
+                auto lock = lock_querier(e.first, i);
+                downstreams.push_back(q->get_snapshot());
             }
         }
+    }
+
+    auto routes = m_routing_management->get_snapshot();
+
+    //the queriers and the routing return their last snapshot as long as nothing changed
+    if (last != nullptr && last->upstreams == upstreams && last->downstreams == downstreams && last->routes == routes) {
+        return;
+    }
+
+    auto snapshot = std::make_shared<proxy_snapshot>();
+    snapshot->version = last != nullptr ? last->version + 1 : 1;
+    snapshot->time = std::chrono::steady_clock::now();
+    snapshot->instance_name = m_instance_name;
+    snapshot->table_number = m_table_number;
+    snapshot->upstreams = std::move(upstreams);
+    snapshot->downstreams = std::move(downstreams);
+    snapshot->routes = std::move(routes);
+
+    std::atomic_store(&m_snapshot, std::shared_ptr<const proxy_snapshot>(std::move(snapshot)));
+}
+
+bool proxy_instance::has_native_reports() const
+{
+    HC_LOG_TRACE("");
+    return m_native_reports;
+}
+
+bool proxy_instance::has_explicit_tracking() const
+{
+    HC_LOG_TRACE("");
+    return m_explicit_tracking;
+}
+
+std::shared_ptr<const proxy_snapshot> proxy_instance::get_snapshot() const
+{
+    HC_LOG_TRACE("");
+    return std::atomic_load(&m_snapshot);
+}
+
+bool proxy_instance::is_merged(const std::shared_ptr<proxy_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    if (get_queue_policy(msg) != MQ_MERGE) {
+        //any other event (e.g. a timer) can change the state, so older messages are no longer comparable
+        m_batch_records.clear();
+        m_batch_sources.clear();
+        return false;
+    }
+
+    switch (msg->get_type()) {
+    case proxy_msg::GROUP_RECORD_MSG: {
+        auto r = std::static_pointer_cast<group_record_msg>(msg);
+        //the explicit tracking needs the equal record of each host
+        auto& last = m_batch_records[std::make_tuple(r->get_if_index(), r->get_gaddr(), m_explicit_tracking ? r->get_host() : mc_addr())];
+
+        if (last != nullptr
+            && last->get_record_type() == r->get_record_type()
+            && last->get_grp_mem_proto() == r->get_grp_mem_proto()
+            && last->get_slist() == r->get_slist()) {
+            return true;
+        }
+
+        last = r;
+        return false;
+    }
+    case proxy_msg::NEW_SOURCE_MSG: {
+        auto s = std::static_pointer_cast<new_source_msg>(msg);
+        return !m_batch_sources.insert(std::make_tuple(s->get_if_index(), s->get_gaddr(), s->get_saddr())).second;
+    }
+    default:
+        return false;
+    }
+}
+
+void proxy_instance::handle_msg(const std::shared_ptr<proxy_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    switch (msg->get_type()) {
+    case proxy_msg::TEST_MSG:
+        (*msg)();
+        break;
+    case proxy_msg::CONFIG_MSG:
+        flush_state_changes();
+        handle_config(std::static_pointer_cast<config_msg>(msg));
+        break;
+    case proxy_msg::FILTER_TIMER_MSG:
+    case proxy_msg::SOURCE_TIMER_MSG:
+    case proxy_msg::RET_GROUP_TIMER_MSG:
+    case proxy_msg::RET_SOURCE_TIMER_MSG:
+    case proxy_msg::OLDER_HOST_PRESENT_TIMER_MSG:
+    case proxy_msg::GENERAL_QUERY_TIMER_MSG: {
+        auto it = m_downstreams.find(std::static_pointer_cast<timer_msg>(msg)->get_if_index());
+        if (it != std::end(m_downstreams)) {
+            it->second.m_queriers.front()->timer_triggerd(msg);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<timer_msg>(msg)->get_if_index()));
+        }
+    }
+    break;
+    case proxy_msg::GROUP_RECORD_MSG: {
+        auto r =  std::static_pointer_cast<group_record_msg>(msg);
+
+        if (m_in_debug_testing_mode) {
+            std::cout << "!!--ACTION: receive record" << std::endl;
+            std::cout << *r << std::endl;
+            std::cout << std::endl;
+        }
+
+        metrics::add_latency(LATENCY_QUEUE);
+
+        auto it = m_downstreams.find(r->get_if_index());
+        if (it != std::end(m_downstreams)) {
+            it->second.m_queriers.front()->receive_record(msg);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<timer_msg>(msg)->get_if_index()));
+        }
+    }
+    break;
+    case proxy_msg::NEW_SOURCE_MSG: {
+        auto s = std::static_pointer_cast<new_source_msg>(msg);
+        m_routing_management->event_new_source(msg);
+        m_receiver->release_source(s->get_if_index(), s->get_gaddr(), s->get_saddr());
+    }
+    break;
+    case proxy_msg::NEW_SOURCE_TIMER_MSG:
+        m_routing_management->timer_triggerd_maintain_routing_table(msg);
+        break;
+    case proxy_msg::TIMER_BATCH_MSG:
+        handle_timer_batch(std::static_pointer_cast<timer_batch_msg>(msg));
+        break;
+    case proxy_msg::STATE_CHANGE_MSG: {
+        auto sc = std::static_pointer_cast<state_change_msg>(msg);
+        add_pending_state_change(sc->get_if_index(), sc->get_gaddr(), sc->get_origin());
+    }
+    break;
+    case proxy_msg::UPSTREAM_QUERY_MSG:
+        handle_upstream_query(std::static_pointer_cast<upstream_query_msg>(msg));
+        break;
+    case proxy_msg::UPSTREAM_REPORT_TIMER_MSG:
+        handle_upstream_report(std::static_pointer_cast<upstream_report_timer_msg>(msg));
+        break;
+    case proxy_msg::QUERIER_QUERY_MSG:
+        handle_querier_query(std::static_pointer_cast<querier_query_msg>(msg));
+        break;
+    case proxy_msg::RESTORE_MSG:
+        handle_restore(std::static_pointer_cast<restore_msg>(msg));
+        break;
+    case proxy_msg::DEBUG_MSG:
+        flush_state_changes();
+        std::cout << *this << std::endl;
+        std::cout << std::endl;
+        break;
+    case proxy_msg::EXIT_MSG:
+        HC_LOG_DEBUG("received exit command");
+        stop();
+        break;
+    default:
+        HC_LOG_ERROR("Received unknown message");
+        break;
+    }
+}
+
+void proxy_instance::handle_timer_batch(const std::shared_ptr<timer_batch_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    //the timer events are moved, the queriers detect outdated timers by their reference count
+    std::map<unsigned int, std::vector<std::shared_ptr<proxy_msg>>> querier_timers;
+
+    for (auto & e : msg->get_timers()) {
+        switch (e->get_type()) {
+        case proxy_msg::FILTER_TIMER_MSG:
+        case proxy_msg::SOURCE_TIMER_MSG:
+        case proxy_msg::RET_GROUP_TIMER_MSG:
+        case proxy_msg::RET_SOURCE_TIMER_MSG:
+        case proxy_msg::OLDER_HOST_PRESENT_TIMER_MSG:
+        case proxy_msg::GENERAL_QUERY_TIMER_MSG: {
+            unsigned int if_index = std::static_pointer_cast<timer_msg>(e)->get_if_index();
+            querier_timers[if_index].push_back(std::move(e));
+        }
         break;
-        case proxy_msg::NEW_SOURCE_MSG:
-            m_routing_management->event_new_source(msg);
-            break;
         case proxy_msg::NEW_SOURCE_TIMER_MSG:
-            m_routing_management->timer_triggerd_maintain_routing_table(msg);
+            m_routing_management->timer_triggerd_maintain_routing_table(e);
             break;
-        case proxy_msg::DEBUG_MSG:
-            std::cout << *this << std::endl;
-            std::cout << std::endl;
-            break;
-        case proxy_msg::EXIT_MSG:
-            HC_LOG_DEBUG("received exit command");
-            stop();
+        case proxy_msg::UPSTREAM_REPORT_TIMER_MSG:
+            handle_upstream_report(std::static_pointer_cast<upstream_report_timer_msg>(e));
             break;
         default:
-            HC_LOG_ERROR("Received unknown message");
+            HC_LOG_ERROR("unknown timer message format");
             break;
         }
     }
 
-    HC_LOG_DEBUG("worker thread proxy_instance end");
+    msg->get_timers().clear();
+
+    for (auto & e : querier_timers) {
+        auto it = m_downstreams.find(e.first);
+        if (it != std::end(m_downstreams)) {
+            it->second.m_queriers.front()->timer_triggerd(e.second);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(e.first));
+        }
+    }
 }
 
 std::string proxy_instance::to_string() const
@@ -245,6 +780,17 @@ std::string proxy_instance::to_string() const
     s << m_upstream_input_rule->to_string() << std::endl;
     s << m_upstream_output_rule->to_string() << std::endl;
 
+    s << "##-- job queue --##" << std::endl;
+    s << queue_stats_to_string() << std::endl;
+
+    s << "##-- route writer --##" << std::endl;
+    s << "changes: " << m_route_changes << " failed: " << m_route_failures << " max latency: " << m_route_max_latency_usec << "usec" << std::endl;
+
+    if (m_report_pacer != nullptr) {
+        s << "##-- report pacing --##" << std::endl;
+        s << m_report_pacer->to_string() << std::endl;
+    }
+
     s << *m_routing_management << std::endl;
 
     s << "##-- upstream interfaces --##" << std::endl;
@@ -254,7 +800,10 @@ std::string proxy_instance::to_string() const
     s << std::endl;
 
     for (auto it = std::begin(m_downstreams); it != std::end(m_downstreams); ++it) {
-        s << std::endl << *it->second.m_querier;
+        for (unsigned int i = 0; i < it->second.m_queriers.size(); ++i) {
+            auto lock = lock_querier(it->first, i);
+            s << std::endl << *it->second.m_queriers[i];
+        }
     }
     return s.str();
 }
@@ -264,10 +813,47 @@ std::ostream& operator<<(std::ostream& stream, const proxy_instance& pr_i)
     return stream << pr_i.to_string();
 }
 
+void proxy_instance::spread_general_queries()
+{
+    HC_LOG_TRACE("");
+
+    if (m_downstreams.empty()) {
+        return;
+    }
+
+    //downstream i sends its general queries in the middle of the i-th slot of the query interval (+- jitter),
+    //so the reports of the hosts of different downstreams do not arrive at the same time
+    auto now = timer_clock::now(); //the virtual clock of the scale suite like the timers of the queriers
+    unsigned int slots = m_downstreams.size();
+    unsigned int i = 0;
+    for (auto & e : m_downstreams) {
+        std::chrono::milliseconds slot;
+        {
+            auto lock = lock_querier(e.first);
+            slot = e.second.m_queriers.front()->get_timers_values().get_query_interval();
+        }
+        slot /= slots;
+
+        long jitter = slot.count() * PROXY_INSTANCE_QUERY_JITTER / 100;
+        std::uniform_int_distribution<long> dist(-jitter, jitter);
+        auto offset = slot * i + slot / 2 + std::chrono::milliseconds(dist(m_query_jitter));
+
+        //all group slices of a downstream share the phase of its general queries
+        for (unsigned int k = 0; k < e.second.m_queriers.size(); ++k) {
+            auto lock = lock_querier(e.first, k);
+            e.second.m_queriers[k]->set_general_query_phase(now + offset);
+        }
+        ++i;
+    }
+}
+
 void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
 {
     HC_LOG_TRACE("");
 
+    //the cached filter decisions refer to the current interfaces and rule bindings
+    m_routing_management->event_config_change();
+
     switch (msg->get_instruction()) {
     case config_msg::ADD_DOWNSTREAM: {
 
@@ -282,13 +868,36 @@ void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
                 HC_LOG_DEBUG("interface also used as upstream");
             }
 
-            //create a querier
-            std::function<void(unsigned int, const addr_storage&)> cb_state_change = std::bind(&routing_management::event_querier_state_change, m_routing_management.get(), std::placeholders::_1, std::placeholders::_2);
-            std::unique_ptr<querier> q(new querier(this, m_group_mem_protocol, msg->get_if_index(), m_sender, m_timing, msg->get_timers_values(), cb_state_change));
-            m_downstreams.insert(std::pair<unsigned int, downstream_infos>(msg->get_if_index(), downstream_infos(move(q), msg->get_interface())));
+            //create a querier per group slice, the slices share the usage of the limits
+            std::vector<std::unique_ptr<querier>> queriers;
+            auto usage = std::make_shared<downstream_usage>();
+            for (unsigned int i = 0; i < get_slice_count(); ++i) {
+                auto lock = lock_querier(msg->get_if_index(), i);
+                querier_shard* shard = get_shard(msg->get_if_index(), i);
+
+                std::function<void(unsigned int, const addr_storage&)> cb_state_change;
+                const worker* msg_worker;
+                if (shard == nullptr) {
+                    cb_state_change = std::bind(&proxy_instance::querier_state_change, this, std::placeholders::_1, std::placeholders::_2);
+                    msg_worker = this;
+                } else {
+                    cb_state_change = std::bind(&querier_shard::querier_state_change, shard, std::placeholders::_1, std::placeholders::_2);
+                    msg_worker = shard;
+                }
+
+                std::unique_ptr<querier> q(new querier(msg_worker, m_group_mem_protocol, msg->get_if_index(), m_sender, m_timing, msg->get_timers_values(), cb_state_change, m_explicit_tracking, i == 0, msg->get_interface()->get_limits(), usage));
+                q->set_fast_leave(msg->get_interface()->is_fast_leave());
+                if (shard != nullptr) {
+                    shard->add_querier(msg->get_if_index(), q.get());
+                }
+                queriers.push_back(std::move(q));
+            }
+            m_downstreams.insert(std::pair<unsigned int, downstream_infos>(msg->get_if_index(), downstream_infos(std::move(queriers), msg->get_interface())));
         } else {
             HC_LOG_WARN("downstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " already exists");
         }
+
+        spread_general_queries();
     }
     break;
     case config_msg::DEL_DOWNSTREAM: {
@@ -304,11 +913,30 @@ void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
                 HC_LOG_DEBUG("interface still used as upstream");
             }
 
-            //delete querier
+            //delete the queriers, the first one leaves the router groups last
+            std::vector<mc_addr> groups;
+            for (unsigned int i = it->second.m_queriers.size(); i-- > 0;) {
+                auto lock = lock_querier(msg->get_if_index(), i);
+                querier_shard* shard = get_shard(msg->get_if_index(), i);
+                if (shard != nullptr) {
+                    shard->del_querier(msg->get_if_index());
+                }
+                for (auto & g : it->second.m_queriers[i]->get_snapshot()->groups) {
+                    groups.push_back(g->gaddr);
+                }
+                it->second.m_queriers[i].reset();
+            }
             m_downstreams.erase(it);
+
+            //the routes and upstream memberships of the groups of this downstream
+            for (auto & e : groups) {
+                querier_state_change(msg->get_if_index(), e);
+            }
         } else {
             HC_LOG_WARN("failed to delete downstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " interface not found");
         }
+
+        spread_general_queries();
     }
     break;
     case config_msg::ADD_UPSTREAM: {
@@ -329,6 +957,7 @@ void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
             HC_LOG_DEBUG("registerd upstreams: " << m_upstreams.size());
             HC_LOG_DEBUG("upstream priority: " << msg->get_upstream_priority());
             m_upstreams.insert(upstream_infos(msg->get_if_index(), msg->get_interface(), msg->get_upstream_priority()));
+            reevaluate_groups();
         }
         else {
             HC_LOG_WARN("upstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " already exists");
@@ -351,7 +980,14 @@ void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
                 HC_LOG_DEBUG("interface still used as downstream");
             }
 
+            //leave the groups of the upstream router, the remaining upstreams take over
+            m_sender->leave_all_groups(msg->get_if_index());
+            if (m_report_pacer != nullptr) {
+                m_report_pacer->del_upstream(msg->get_if_index());
+            }
+            m_upstream_reports.erase(msg->get_if_index());
             m_upstreams.erase(it);
+            reevaluate_groups();
         } else {
             HC_LOG_WARN("failed to delete upstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " interface not found");
         }
@@ -378,367 +1014,155 @@ void proxy_instance::handle_config(const std::shared_ptr<config_msg>& msg)
         } else {
             HC_LOG_ERROR("failed to set global rule binding, rule not defined");
         }
+
+        reevaluate_groups();
     }
     break;
-    default:
-        HC_LOG_ERROR("unknown config message format");
+    case config_msg::SET_DOWNSTREAM: {
+        auto it = m_downstreams.find(msg->get_if_index());
+        if (it != std::end(m_downstreams)) {
+            HC_LOG_DEBUG("set rule bindings of downstream interface: " << interfaces::get_if_name(msg->get_if_index()));
+            it->second.m_interface = msg->get_interface();
+            for (unsigned int i = 0; i < it->second.m_queriers.size(); ++i) {
+                auto lock = lock_querier(msg->get_if_index(), i);
+                it->second.m_queriers[i]->set_limits(msg->get_interface()->get_limits());
+                it->second.m_queriers[i]->set_fast_leave(msg->get_interface()->is_fast_leave());
+            }
+            reevaluate_groups();
+        } else {
+            HC_LOG_WARN("failed to set downstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " interface not found");
+        }
     }
-}
-
-bool proxy_instance::is_upstream(unsigned int if_index) const
-{
-    HC_LOG_TRACE("");
+    break;
+    case config_msg::SET_UPSTREAM: {
+        auto it = std::find_if(m_upstreams.begin(), m_upstreams.end(), [&](const upstream_infos & ui) {
+            return ui.m_if_index == msg->get_if_index();
+        } );
 
-    for (auto & e : m_upstreams) {
-        if (e.m_if_index == if_index) {
-            return true;
+        if (it != m_upstreams.end()) {
+            HC_LOG_DEBUG("set rule bindings of upstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " with priority: " << msg->get_upstream_priority());
+            m_upstreams.erase(it);
+            m_upstreams.insert(upstream_infos(msg->get_if_index(), msg->get_interface(), msg->get_upstream_priority()));
+            reevaluate_groups();
+        } else {
+            HC_LOG_WARN("failed to set upstream interface: " << interfaces::get_if_name(msg->get_if_index()) << " interface not found");
         }
     }
+    break;
+    case config_msg::LINK_UP: {
+        //the hosts may have changed while the link was down, query them like on startup
+        auto it = m_downstreams.find(msg->get_if_index());
+        if (it != std::end(m_downstreams)) {
+            HC_LOG_DEBUG("link up of downstream interface: " << interfaces::get_if_name(msg->get_if_index()));
+            for (unsigned int i = 0; i < it->second.m_queriers.size(); ++i) {
+                auto lock = lock_querier(msg->get_if_index(), i);
+                if (!it->second.m_queriers[i]->restart_startup_queries()) {
+                    HC_LOG_WARN("failed to restart the startup queries of interface: " << interfaces::get_if_name(msg->get_if_index()));
+                }
+            }
+        }
 
-    return false;
+        //the upstream router may have lost the memberships, report them like an answer to a general query
+        if (m_native_reports && is_upstream(msg->get_if_index())) {
+            HC_LOG_DEBUG("link up of upstream interface: " << interfaces::get_if_name(msg->get_if_index()));
+            auto delay = timers_values().get_unsolicited_report_interval();
+            handle_upstream_query(make_pooled_msg<upstream_query_msg>(msg->get_if_index(), mc_addr(addr_storage(get_addr_family(m_group_mem_protocol))), delay));
+        }
+    }
+    break;
+    case config_msg::LINK_DOWN: {
+        //a pending report cannot be sent, it is restarted by the next link up or query
+        m_upstream_reports.erase(msg->get_if_index());
+    }
+    break;
+    default:
+        HC_LOG_ERROR("unknown config message format");
+    }
 }
 
-bool proxy_instance::is_downstream(unsigned int if_index) const
+void proxy_instance::reevaluate_groups()
 {
     HC_LOG_TRACE("");
 
-    return m_downstreams.find(if_index) != m_downstreams.end();
-}
-
-#ifdef DEBUG_MODE
-void proxy_instance::test_querier(std::string if_name)
-{
-    using namespace std;
-    addr_storage gaddr("239.99.99.99");
-
-    group_mem_protocol memproto = IGMPv3;
-    //create a proxy_instance
-    proxy_instance pr_i(memproto, "test", 0,  make_shared<interfaces>(get_addr_family(memproto), false), make_shared<timing>(), true);
-
-    //add a downstream
-    timers_values tv;
-
-    //set mali to 10 seconds
-    tv.set_query_interval(chrono::seconds(10));
-    tv.set_startup_query_interval(chrono::seconds(10));
-    tv.set_startup_query_count(4);
-    tv.set_query_response_interval(chrono::seconds(4));
-
-    cout << tv << endl;
-    cout << endl;
-
-    pr_i.add_msg(make_shared<config_msg>(config_msg::ADD_DOWNSTREAM, interfaces::get_if_index(if_name), std::make_shared<interface>(if_name), tv));
-
-    auto print_proxy_instance = bind(&proxy_instance::add_msg, &pr_i, make_shared<debug_msg>());
-
-    auto __tmp = [&, if_name](mcast_addr_record_type t, source_list<source> && slist, group_mem_protocol gmp) {
-        return make_shared<group_record_msg>(interfaces::get_if_index(if_name), t, gaddr, move(slist), gmp);
-    };
-
-    auto send_record = bind(&proxy_instance::add_msg, &pr_i, bind(__tmp, placeholders::_1, placeholders::_2, placeholders::_3));
-
-    //-----------------------------------------------------------------
-    //quick_test(send_record, print_proxy_instance);
-    rand_test(send_record, print_proxy_instance);
-    //test_a(send_record, print_proxy_instance);
-    //test_b(send_record, print_proxy_instance);
-    //test_c(send_record, print_proxy_instance);
-    //test_d(send_record, print_proxy_instance);
-    //test_backward_compatibility(send_record, print_proxy_instance);
-    //test_backward_compatibility(send_record, print_proxy_instance);
-}
-
-void proxy_instance::quick_test(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
-{
-    using namespace std;
-    cout << "##-- querier quick test --##" << endl;
-    print_proxy_instance();
-
-    send_record(MODE_IS_INCLUDE, source_list<source> {}, IGMPv3);
-    send_record(MODE_IS_INCLUDE, source_list<source> {}, IGMPv3);
-
-    //send_record(MODE_IS_INCLUDE, source_list<source> {});
-
-    for (int i = 0; i < 120; ++i) {
-        sleep(1);
-        print_proxy_instance();
+    for (auto & e : m_downstreams) {
+        for (unsigned int i = 0; i < e.second.m_queriers.size(); ++i) {
+            auto lock = lock_querier(e.first, i);
+            for (auto & g : e.second.m_queriers[i]->get_snapshot()->groups) {
+                querier_state_change(e.first, g->gaddr);
+            }
+        }
     }
 
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
-}
-
-void proxy_instance::test_a(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
-{
-    using namespace std;
-    source s1(addr_storage("1.1.1.1"));
-    source s2(addr_storage("2.2.2.2"));
-    source s3(addr_storage("3.3.3.3"));
-    source s4(addr_storage("4.4.4.4"));
-    source s5(addr_storage("5.5.5.5"));
-    source s6(addr_storage("6.6.6.6"));
-    source s7(addr_storage("7.7.7.7"));
-
-    cout << "##-- querier test A --##" << endl;
-    print_proxy_instance();
-
-    send_record(MODE_IS_INCLUDE, source_list<source> {s1, s2, s3, s4, s5}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(4);
-    send_record(MODE_IS_INCLUDE, source_list<source> {s1, s3, s5}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(5);
-    send_record(MODE_IS_INCLUDE, source_list<source> {s1, s3, s5}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(MODE_IS_EXCLUDE, source_list<source> {s1, s2, s3}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(5);
-    send_record(MODE_IS_INCLUDE, source_list<source> {s1, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(MODE_IS_EXCLUDE, source_list<source> {s6, s7}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(MODE_IS_EXCLUDE, source_list<source> {s6, s7}, IGMPv3);
-    print_proxy_instance();
-
-    for (int i = 0; i < 6; ++i) {
-        sleep(2);
-        print_proxy_instance();
+    auto routes = m_routing_management->get_snapshot();
+    if (routes != nullptr) {
+        for (auto & e : *routes) {
+            querier_state_change(e.input_if_index, e.gaddr);
+        }
     }
 
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
-}
-
-void proxy_instance::test_b(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
-{
-
-    using namespace std;
-    source s1(addr_storage("1.1.1.1"));
-    source s2(addr_storage("2.2.2.2"));
-    source s3(addr_storage("3.3.3.3"));
-    source s4(addr_storage("4.4.4.4"));
-    source s5(addr_storage("5.5.5.5"));
-    source s6(addr_storage("6.6.6.6"));
-    source s7(addr_storage("7.7.7.7"));
-
-    cout << "##-- querier test B --##" << endl;
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s1, s2, s3}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(BLOCK_OLD_SOURCES, source_list<source> {s2}, IGMPv3);
-    print_proxy_instance();
-
-    for (int i = 0; i < 6; ++i) {
-        sleep(2);
-        print_proxy_instance();
+    //join new hot groups and leave the groups that are no longer hot
+    for (auto & e : m_routing_management->get_prejoined_groups()) {
+        querier_state_change(0, e);
     }
-
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
 }
 
-void proxy_instance::test_c(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
+void proxy_instance::handle_restore(const std::shared_ptr<restore_msg>& msg)
 {
-    using namespace std;
-    source s1(addr_storage("1.1.1.1"));
-    source s2(addr_storage("2.2.2.2"));
-    source s3(addr_storage("3.3.3.3"));
-    source s4(addr_storage("4.4.4.4"));
-    source s5(addr_storage("5.5.5.5"));
-    source s6(addr_storage("6.6.6.6"));
-    source s7(addr_storage("7.7.7.7"));
-
-    cout << "##-- querier test C --##" << endl;
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s1, s2, s3, s4}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(CHANGE_TO_EXCLUDE_MODE, source_list<source> {s3, s4, s5, s6}, IGMPv3);
-    print_proxy_instance();
+    HC_LOG_TRACE("");
 
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s7}, IGMPv3);
-    print_proxy_instance();
+    unsigned int groups = 0;
+    for (auto & d : msg->get_snapshot()->downstreams) {
+        auto it = m_downstreams.find(d->if_index);
+        if (it == std::end(m_downstreams)) {
+            HC_LOG_DEBUG("failed to restore downstream interface: " << interfaces::get_if_name(d->if_index) << " interface not found");
+            continue;
+        }
 
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s6}, IGMPv3);
-    print_proxy_instance();
+        for (auto & g : d->groups) {
+            unsigned int slice = get_slice(g->gaddr);
+            bool restored;
+            {
+                auto lock = lock_querier(d->if_index, slice);
+                restored = it->second.m_queriers[slice]->restore_group(*g, msg->get_elapsed());
+            }
 
-    for (int i = 0; i < 6; ++i) {
-        sleep(2);
-        print_proxy_instance();
+            if (restored) {
+                querier_state_change(d->if_index, g->gaddr);
+                ++groups;
+            }
+        }
     }
 
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
-}
-
-void proxy_instance::test_d(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
-{
-    using namespace std;
-    source s1(addr_storage("1.1.1.1"));
-    source s2(addr_storage("2.2.2.2"));
-    source s3(addr_storage("3.3.3.3"));
-    source s4(addr_storage("4.4.4.4"));
-    source s5(addr_storage("5.5.5.5"));
-    source s6(addr_storage("6.6.6.6"));
-    source s7(addr_storage("7.7.7.7"));
-
-    cout << "##-- querier test D --##" << endl;
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s1, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(MODE_IS_EXCLUDE, source_list<source> {s2, s3}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(BLOCK_OLD_SOURCES, source_list<source> {s2, s7}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(CHANGE_TO_INCLUDE_MODE, source_list<source> {s1, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(4);
-    send_record(CHANGE_TO_EXCLUDE_MODE, source_list<source> {s1, s7}, IGMPv3);
-    print_proxy_instance();
-    for (int i = 0; i < 6; ++i) {
-        sleep(2);
-        print_proxy_instance();
+    //the routes of the sources are installed again and kept as long as the kernel counts packets for them
+    unsigned int sources = 0;
+    if (msg->get_snapshot()->routes != nullptr) {
+        for (auto & r : *msg->get_snapshot()->routes) {
+            if (is_upstream(r.input_if_index) || is_downstream(r.input_if_index)) {
+                m_routing_management->event_new_source(make_pooled_msg<new_source_msg>(r.input_if_index, r.gaddr, r.saddr));
+                ++sources;
+            }
+        }
     }
 
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
+    HC_LOG_DEBUG("restored " << groups << " group(s) and " << sources << " source(s) of a checkpoint written " << msg->get_elapsed().count() << "msec ago");
 }
 
-void proxy_instance::test_backward_compatibility(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
+bool proxy_instance::is_upstream(unsigned int if_index) const
 {
-    using namespace std;
-    source s1(addr_storage("1.1.1.1"));
-    source s2(addr_storage("2.2.2.2"));
-    source s3(addr_storage("3.3.3.3"));
-    source s4(addr_storage("4.4.4.4"));
-    source s5(addr_storage("5.5.5.5"));
-    source s6(addr_storage("6.6.6.6"));
-    source s7(addr_storage("7.7.7.7"));
-
-    cout << "##-- querier test BACKWARD COMPATIBILITY --##" << endl;
-    print_proxy_instance();
-
-    sleep(1);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s1, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s3, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s4, s2}, IGMPv2);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s5, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s6, s2}, IGMPv3);
-    print_proxy_instance();
-
-    sleep(2);
-    send_record(ALLOW_NEW_SOURCES, source_list<source> {s7, s2}, IGMPv2);
-    print_proxy_instance();
+    HC_LOG_TRACE("");
 
-    sleep(4);
-    for (int i = 0; i < 23; ++i) {
-        sleep(2);
-        send_record(ALLOW_NEW_SOURCES, source_list<source> {s1, s2}, IGMPv3);
-        print_proxy_instance();
+    for (auto & e : m_upstreams) {
+        if (e.m_if_index == if_index) {
+            return true;
+        }
     }
 
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
+    return false;
 }
 
-void proxy_instance::rand_test(std::function < void(mcast_addr_record_type, source_list<source>&&, group_mem_protocol) > send_record, std::function<void()> print_proxy_instance)
+bool proxy_instance::is_downstream(unsigned int if_index) const
 {
-    using namespace std;
-    default_random_engine re;
-    int time;
-
-    vector<mcast_addr_record_type> r_type {MODE_IS_INCLUDE, MODE_IS_EXCLUDE, CHANGE_TO_INCLUDE_MODE, CHANGE_TO_EXCLUDE_MODE, ALLOW_NEW_SOURCES, BLOCK_OLD_SOURCES};
-    uniform_int_distribution<int> d_r_type(0, r_type.size() - 1);
-
-    vector<source> src;
-    src.push_back(addr_storage("1.1.1.1"));
-    src.push_back(addr_storage("2.2.2.2"));
-    src.push_back(addr_storage("3.3.3.3"));
-    src.push_back(addr_storage("4.4.4.4"));
-    src.push_back(addr_storage("5.5.5.5"));
-    src.push_back(addr_storage("6.6.6.6"));
-    src.push_back(addr_storage("7.7.7.7"));
-    src.push_back(addr_storage("8.8.8.8"));
-    src.push_back(addr_storage("9.9.9.9"));
-    src.push_back(addr_storage("10.10.10.10"));
-    src.push_back(addr_storage("11.11.11.11"));
-    src.push_back(addr_storage("12.12.12.12"));
-    uniform_int_distribution<int> d_src(0, 8);
-
-    cout << "##-- querier random test --##" << endl;
-    print_proxy_instance();
-
-    auto get_src_list = [&]() {
-        source_list<source> s;
-        int max = d_src(re);
-        for (int i = 0; i <= max; i++) {
-            s.insert(src[d_src(re)]);
-        }
-        return s;
-    };
-
-    for (int i = 0; i < 50; i++) {
-        time = d_src(re);
-        cout << "!!--wait: " << time << "sec" << endl;
-        cout << endl;
-
-        if (i == 10 || i == 20 || i == 40 ) {
-            sleep(2);
-            send_record(MODE_IS_EXCLUDE, {}, IGMPv2); 
-        }
-
-        if (i == 11 || i == 25 || i == 40 ) {
-            sleep(2);
-            send_record(CHANGE_TO_EXCLUDE_MODE, {}, IGMPv2); 
-        }
+    HC_LOG_TRACE("");
 
-        sleep(time);
-        send_record(r_type[d_r_type(re)], get_src_list(), IGMPv3);
-        print_proxy_instance();
-    }
-    sleep(1);
-    cout << "##-- querier end --##" << endl;
+    return m_downstreams.find(if_index) != m_downstreams.end();
 }
-#endif /* DEBUG_MODE */
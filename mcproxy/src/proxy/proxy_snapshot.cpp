@@ -0,0 +1,92 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/proxy_snapshot.hpp"
+#include "include/proxy/interfaces.hpp"
+
+#include <sstream>
+
+std::string group_snapshot::to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+    s << get_group_mem_protocol_name(compatibility_mode) << ", " << get_mc_filter_name(filter_mode) << " (version:" << version << ")" << std::endl;
+    if (filter_mode == INCLUDE_MODE) {
+        s << "included list(#" << include_requested_list.size() << "): " << include_requested_list;
+    } else if (filter_mode == EXCLUDE_MODE) {
+        s << "requested list(#" << include_requested_list.size() << "): " << include_requested_list << std::endl;
+        s << "exclude_list(#" << exclude_list.size() << "): " << exclude_list;
+    } else {
+        HC_LOG_ERROR("unknown filter mode");
+    }
+    return s.str();
+}
+
+std::string downstream_snapshot::to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+    s << "##-- downstream " << interfaces::get_if_name(if_index) << "(index:" << if_index << ") --##" << std::endl;
+    s << "querier version: " << get_group_mem_protocol_name(querier_version_mode) << std::endl;
+    s << "is querier: " << (is_querier ? "true" : "false") << std::endl;
+    s << "subscribed groups: " << groups.size();
+    for (auto & e : groups) {
+        s << std::endl << "-- group address: " << e->gaddr << std::endl;
+        s << indention(e->to_string());
+    }
+    return s.str();
+}
+
+std::string proxy_snapshot::to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    s << "@@##-- snapshot of proxy instance " << instance_name << " (table:" << table_number << ",version:" << version << ") --##@@" << std::endl;
+
+    s << "##-- upstream interfaces --##" << std::endl;
+    for (auto e : upstreams) {
+        s << interfaces::get_if_name(e) << "(index:" << e << ") ";
+    }
+    s << std::endl;
+
+    if (routes != nullptr) {
+        s << "##-- multicast sources (#" << routes->size() << ") --##";
+        for (auto & e : *routes) {
+            s << std::endl << "(" << e.gaddr << ", " << e.saddr << ") from " << interfaces::get_if_name(e.input_if_index);
+        }
+        s << std::endl;
+    }
+
+    for (auto & e : downstreams) {
+        s << std::endl << e->to_string() << std::endl;
+    }
+
+    return s.str();
+}
+
+std::ostream& operator<<(std::ostream& stream, const proxy_snapshot& s)
+{
+    return stream << s.to_string();
+}
@@ -22,10 +22,12 @@
 
 #include "include/hamcast_logging.h"
 #include "include/proxy/querier.hpp"
-#include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_addr.hpp"
 #include "include/proxy/timing.hpp"
 #include "include/proxy/interfaces.hpp"
 #include "include/proxy/def.hpp"
+#include "include/utils/tracepoints.hpp"
+#include "include/utils/metrics.hpp"
 
 #include "include/proxy/sender.hpp"
 #include "include/proxy/igmp_sender.hpp"
@@ -34,8 +36,11 @@
 #include <unistd.h>
 #include <iostream>
 #include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <limits>
 
-querier::querier(worker* msg_worker, group_mem_protocol querier_version_mode, int if_index, const std::shared_ptr<const sender>& sender, const std::shared_ptr<timing>& timing, const timers_values& tv, callback_querier_state_change cb_state_change)
+querier::querier(const worker* msg_worker, group_mem_protocol querier_version_mode, int if_index, const std::shared_ptr<const sender>& sender, const std::shared_ptr<timing>& timing, const timers_values& tv, callback_querier_state_change cb_state_change, bool explicit_tracking, bool owns_interface, const membership_limits& limits, const std::shared_ptr<downstream_usage>& usage)
     : m_msg_worker(msg_worker)
     , m_if_index(if_index)
     , m_db(querier_version_mode)
@@ -43,9 +48,18 @@ querier::querier(worker* msg_worker, group_mem_protocol querier_version_mode, in
     , m_cb_state_change(cb_state_change)
     , m_sender(sender)
     , m_timing(timing)
+    , m_owns_interface(owns_interface)
+    , m_has_general_query_phase(false)
+    , m_is_startup_timer(false)
+    , m_limits(limits)
+    , m_usage(usage != nullptr ? usage : std::make_shared<downstream_usage>())
+    , m_fast_leave(false)
+    , m_state_version(next_group_version())
 {
     HC_LOG_TRACE("");
 
+    m_db.explicit_tracking = explicit_tracking;
+
     //join all router groups
     if (!router_groups_function(true)) {
         HC_LOG_ERROR("failed to subscribe multicast router groups");
@@ -58,7 +72,7 @@ querier::querier(worker* msg_worker, group_mem_protocol querier_version_mode, in
     }
 }
 
-//unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist
+//unsigned int if_index, mc_filter filter_mode, const mc_addr& gaddr, const source_list<source>& slist
 
 bool querier::router_groups_function(bool subscribe) const
 {
@@ -70,6 +84,10 @@ bool querier::router_groups_function(bool subscribe) const
 //IGMPv2 RFC 2236: Section 9. ALL-ROUTERS (224.0.0.2)
 //IGMPv3 IANA: IGMP (224.0.0.22)
 
+    if (!m_owns_interface) {
+        return true;
+    }
+
     mc_filter mf;
 
     if (subscribe) {
@@ -80,12 +98,12 @@ bool querier::router_groups_function(bool subscribe) const
 
     bool rc = true;
     if (is_IPv4(m_db.querier_version_mode)) {
-        rc = rc && m_sender->send_record(m_if_index, mf, addr_storage(IPV4_ALL_IGMP_ROUTERS_ADDR), source_list<source>());
-        rc = rc && m_sender->send_record(m_if_index, mf, addr_storage(IPV4_IGMPV3_ADDR), source_list<source>());
+        rc = rc && m_sender->send_record(m_if_index, mf, mc_addr(IPV4_ALL_IGMP_ROUTERS_ADDR), source_list<source>());
+        rc = rc && m_sender->send_record(m_if_index, mf, mc_addr(IPV4_IGMPV3_ADDR), source_list<source>());
     } else if (is_IPv6(m_db.querier_version_mode)) {
-        rc = rc && m_sender->send_record(m_if_index, mf, addr_storage(IPV6_ALL_NODE_LOCAL_ROUTER), source_list<source>());
-        rc = rc && m_sender->send_record(m_if_index, mf, addr_storage(IPV6_ALL_SITE_LOCAL_ROUTER), source_list<source>());
-        rc = rc && m_sender->send_record(m_if_index, mf, addr_storage(IPV6_ALL_MLDv2_CAPABLE_ROUTERS), source_list<source>());
+        rc = rc && m_sender->send_record(m_if_index, mf, mc_addr(IPV6_ALL_NODE_LOCAL_ROUTER), source_list<source>());
+        rc = rc && m_sender->send_record(m_if_index, mf, mc_addr(IPV6_ALL_SITE_LOCAL_ROUTER), source_list<source>());
+        rc = rc && m_sender->send_record(m_if_index, mf, mc_addr(IPV6_ALL_MLDv2_CAPABLE_ROUTERS), source_list<source>());
     } else {
         HC_LOG_ERROR("unknown ip version");
         return false;
@@ -95,25 +113,137 @@ bool querier::router_groups_function(bool subscribe) const
 bool querier::send_general_query()
 {
     HC_LOG_TRACE("");
+
+    //hosts answer each general query, forget the ones that have been silent for the Multicast Address Listening Interval
+    if (m_db.explicit_tracking) {
+        auto now = timer_clock::now();
+        for (auto & e : m_db.group_info) {
+            e.second.tracking.purge(now);
+        }
+    }
+
     if (m_db.general_query_timer.get() == nullptr) {
         m_db.startup_query_count = m_timers_values.get_startup_query_count() - 1;
     }
 
-    std::chrono::seconds t;
+    std::chrono::milliseconds t;
     if (m_db.startup_query_count > 0) {
         m_db.startup_query_count--;
         t  = m_timers_values.get_startup_query_interval();
+        m_is_startup_timer = true;
+    } else if (m_has_general_query_phase) {
+        t = get_general_query_phase_delay();
+        m_is_startup_timer = false;
     } else {
         t = m_timers_values.get_query_interval();
+        m_is_startup_timer = false;
     }
 
-    auto gqt = std::make_shared<general_query_timer_msg>(m_if_index, t);
+    auto gqt = make_pooled_msg<general_query_timer_msg>(m_if_index, t);
     m_db.general_query_timer = gqt;
 
-    m_timing->add_time(t, m_msg_worker, gqt);
+    add_timer(t, gqt);
+
+    //the timer of a group slice keeps the startup queries and the host tracking in step without sending
+    if (!m_owns_interface) {
+        return true;
+    }
+
     return m_sender->send_general_query(m_if_index, m_timers_values);
 }
 
+std::chrono::milliseconds querier::get_general_query_phase_delay() const
+{
+    HC_LOG_TRACE("");
+
+    auto now = timer_clock::now();
+    std::chrono::steady_clock::duration qi = m_timers_values.get_query_interval();
+    auto next = m_general_query_phase;
+    if (next <= now) {
+        next += ((now - next) / qi + 1) * qi;
+    }
+
+    return std::chrono::duration_cast<std::chrono::milliseconds>(next - now);
+}
+
+void querier::set_general_query_phase(std::chrono::steady_clock::time_point phase)
+{
+    HC_LOG_TRACE("");
+
+    m_general_query_phase = phase;
+    m_has_general_query_phase = true;
+
+    //the startup queries and the other querier present timer are not moved, the phase is used after them
+    if (m_is_startup_timer || m_db.general_query_timer == nullptr || !m_db.is_querier) {
+        return;
+    }
+
+    //if the timer cannot be restarted it has already expired and the query is sent right now
+    auto delay = get_general_query_phase_delay();
+    if (m_db.general_query_timer->is_remaining_time_greater_than(delay)) {
+        restart_timer(delay, m_db.general_query_timer);
+    }
+}
+
+bool querier::restart_startup_queries()
+{
+    HC_LOG_TRACE("");
+
+    //a router starts as querier, the election begins again
+    set_querier(true);
+
+    //the pending general query is replaced, without a general query timer the startup queries begin again
+    std::shared_ptr<timer_msg> last = m_db.general_query_timer;
+    m_db.general_query_timer = nullptr;
+    cancel_unused_timer(last);
+
+    return send_general_query();
+}
+
+void querier::receive_query(const std::shared_ptr<querier_query_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    //the election is decided by the general queries, they reach the queriers of all group slices of the downstream
+    if (!msg->get_gaddr().is_multicast_addr()) {
+        if (m_db.is_querier) {
+            HC_LOG_DEBUG("querier " << msg->get_querier() << " on interface " << interfaces::get_if_name(m_if_index) << " has a lower address, stop querying");
+        }
+        m_other_querier = msg->get_querier();
+
+        //the general query timer runs as other querier present timer, the startup queries are over
+        auto oqpi = m_timers_values.get_other_querier_present_interval();
+        m_db.startup_query_count = 0;
+        m_is_startup_timer = false;
+        if (m_db.general_query_timer == nullptr || !restart_timer(oqpi, m_db.general_query_timer)) {
+            std::shared_ptr<timer_msg> last = m_db.general_query_timer;
+            auto oqpt = make_pooled_msg<general_query_timer_msg>(m_if_index, oqpi);
+            m_db.general_query_timer = oqpt;
+            add_timer(oqpi, oqpt);
+            cancel_unused_timer(last);
+        }
+
+        set_querier(false);
+        return;
+    }
+
+    if (m_db.is_querier || msg->is_suppressed()) {
+        return;
+    }
+
+    auto db_info_it = m_db.group_info.find(msg->get_gaddr());
+    if (db_info_it == std::end(m_db.group_info)) {
+        return;
+    }
+
+    //the hosts answer the query of the querier, without an answer the group expires after the last listener query time
+    gaddr_info& ginfo = db_info_it->second;
+    auto llqt = m_timers_values.get_last_listener_query_time();
+    if (ginfo.filter_mode == EXCLUDE_MODE && ginfo.shared_filter_timer != nullptr && ginfo.shared_filter_timer->is_remaining_time_greater_than(llqt)) {
+        set_filter_timer(db_info_it->first, ginfo, llqt);
+    }
+}
+
 void querier::receive_record(const std::shared_ptr<proxy_msg>& msg)
 {
     HC_LOG_TRACE("");
@@ -124,21 +254,164 @@ void querier::receive_record(const std::shared_ptr<proxy_msg>& msg)
     }
 
     auto gr = std::static_pointer_cast<group_record_msg>(msg);
+    MCPROXY_PROBE(record_dispatched, m_if_index, gr->get_record_type(), &gr->get_gaddr(), gr->get_slist().size());
 
     auto db_info_it = m_db.group_info.find(gr->get_gaddr());
 
-    if (db_info_it == end(m_db.group_info)) {
+    if (m_limits.is_limited() && !apply_limits(*gr, db_info_it)) {
+        return;
+    }
+
+    membership_size before;
+    if (db_info_it != std::end(m_db.group_info)) {
+        before = db_info_it->second.get_size();
+    }
+
+    process_record(gr, db_info_it);
+    update_usage(before, get_group_size(gr->get_gaddr()));
+}
+
+bool querier::apply_limits(group_record_msg& gr, gaddr_map::iterator db_info_it)
+{
+    HC_LOG_TRACE("");
+
+    mcast_addr_record_type record_type = gr.get_record_type();
+    source_list<source>& slist = gr.get_slist();
+    bool is_new_group = db_info_it == std::end(m_db.group_info);
+
+    //records that create no state
+    if (is_new_group) {
+        if (record_type == BLOCK_OLD_SOURCES || (slist.empty() && record_type != MODE_IS_EXCLUDE && record_type != CHANGE_TO_EXCLUDE_MODE)) {
+            return true;
+        }
+    } else {
+        const gaddr_info& ginfo = db_info_it->second;
+        if (record_type == BLOCK_OLD_SOURCES && ginfo.filter_mode == INCLUDE_MODE) {
+            return true;
+        }
+
+        //the source lists of these records are ignored (RFC3810 8.3.2)
+        if (ginfo.is_in_backward_compatibility_mode() && (record_type == CHANGE_TO_EXCLUDE_MODE || record_type == BLOCK_OLD_SOURCES)) {
+            return true;
+        }
+    }
+
+    //the groups of the other slices are counted concurrently, so the limit can be exceeded by a few groups
+    if (is_new_group && m_limits.max_groups > 0 && m_usage->groups.load(std::memory_order_relaxed) >= static_cast<long>(m_limits.max_groups)) {
+        HC_LOG_DEBUG("group limit of interface " << interfaces::get_if_name(m_if_index) << " reached, ignore group " << gr.get_gaddr());
+        metrics::add(METRIC_RECORDS_LIMITED, 1, m_if_index);
+        return false;
+    }
+
+    //sources that fit into the limits
+    long room = std::numeric_limits<long>::max();
+    long group_sources = 0;
+    if (!is_new_group) {
+        group_sources = db_info_it->second.include_requested_list.size() + db_info_it->second.exclude_list.size();
+    }
+
+    if (m_limits.max_sources > 0) {
+        room = std::min(room, static_cast<long>(m_limits.max_sources) - group_sources);
+    }
+
+    if (m_limits.max_total_sources > 0) {
+        room = std::min(room, static_cast<long>(m_limits.max_total_sources) - m_usage->sources.load(std::memory_order_relaxed));
+    }
+
+    auto is_known = [&](const source & s) {
+        return !is_new_group && (db_info_it->second.include_requested_list.count(s) > 0 || db_info_it->second.exclude_list.count(s) > 0);
+    };
+
+    long new_sources = 0;
+    for (auto & e : slist) {
+        if (!is_known(e)) {
+            ++new_sources;
+        }
+    }
+
+    if (new_sources <= room) {
+        return true;
+    }
+
+    metrics::add(METRIC_RECORDS_LIMITED, 1, m_if_index);
+
+    if (m_limits.policy == LP_REJECT) {
+        HC_LOG_DEBUG("source limit of interface " << interfaces::get_if_name(m_if_index) << " reached, ignore record of group " << gr.get_gaddr());
+        return false;
+    }
+
+    //keep the known sources and the first new ones
+    HC_LOG_DEBUG("source limit of interface " << interfaces::get_if_name(m_if_index) << " reached, truncate record of group " << gr.get_gaddr());
+    source_list<source> truncated;
+    truncated.reserve(slist.size());
+    for (auto & e : slist) {
+        if (is_known(e)) {
+            truncated.insert(truncated.end(), e);
+        } else if (room > 0) {
+            truncated.insert(truncated.end(), e);
+            --room;
+        }
+    }
+    slist = std::move(truncated);
+
+    return true;
+}
+
+membership_size querier::get_group_size(const mc_addr& gaddr) const
+{
+    auto db_info_it = m_db.group_info.find(gaddr);
+    if (db_info_it != std::end(m_db.group_info)) {
+        return db_info_it->second.get_size();
+    } else {
+        return membership_size();
+    }
+}
+
+void querier::update_usage(const membership_size& before, const membership_size& after)
+{
+    membership_size diff = after;
+    diff -= before;
+
+    if (diff.groups != 0) {
+        m_usage->groups.fetch_add(diff.groups, std::memory_order_relaxed);
+        metrics::add(METRIC_MEMBERSHIP_GROUPS, diff.groups, m_if_index);
+    }
+
+    if (diff.sources != 0) {
+        m_usage->sources.fetch_add(diff.sources, std::memory_order_relaxed);
+        metrics::add(METRIC_MEMBERSHIP_SOURCES, diff.sources, m_if_index);
+    }
+
+    if (diff.bytes != 0) {
+        metrics::add(METRIC_MEMBERSHIP_BYTES, diff.bytes, m_if_index);
+    }
+
+    m_size += diff;
+}
+
+void querier::process_record(const std::shared_ptr<group_record_msg>& gr, gaddr_map::iterator db_info_it)
+{
+    HC_LOG_TRACE("");
+
+    if (db_info_it == std::end(m_db.group_info)) {
         //add an empty neutral record  to membership database
         HC_LOG_DEBUG("gaddr not found");
-        db_info_it = m_db.group_info.insert(gaddr_pair(gr->get_gaddr(), gaddr_info(m_db.querier_version_mode))).first;
+        db_info_it = m_db.add_group(gr->get_gaddr());
+        db_info_it->second.version = next_group_version();
     }
 
     //backwards compatibility coordination
     if (!is_newest_version(gr->get_grp_mem_proto()) && is_older_or_equal_version(gr->get_grp_mem_proto(), m_db.querier_version_mode) ) {
         db_info_it->second.compatibility_mode_variable = gr->get_grp_mem_proto();
-        auto ohpt = std::make_shared<older_host_present_timer_msg>(m_if_index, db_info_it->first, m_timers_values.get_older_host_present_interval());
-        db_info_it->second.older_host_present_timer = ohpt;
-        m_timing->add_time(m_timers_values.get_older_host_present_interval(), m_msg_worker, ohpt);
+        auto& ohpt = db_info_it->second.older_host_present_timer;
+        if (ohpt == nullptr || !restart_timer(m_timers_values.get_older_host_present_interval(), ohpt)) {
+            if (ohpt == nullptr) {
+                //all sources are accepted from now on
+                db_info_it->second.version = next_group_version();
+            }
+            ohpt = make_pooled_msg<older_host_present_timer_msg>(m_if_index, db_info_it->first, m_timers_values.get_older_host_present_interval());
+            add_timer(m_timers_values.get_older_host_present_interval(), ohpt);
+        }
     }
 
     //section 8.3.2. In the Presence of MLDv1 Multicast Address Listeners
@@ -152,13 +425,17 @@ void querier::receive_record(const std::shared_ptr<proxy_msg>& msg)
         }
     }
 
+    if (m_db.explicit_tracking && gr->get_host().is_valid()) {
+        db_info_it->second.tracking.update(gr->get_host(), gr->get_record_type(), gr->get_slist(), timer_clock::now() + m_timers_values.get_multicast_address_listening_interval());
+    }
+
     switch (db_info_it->second.filter_mode) {
     case  INCLUDE_MODE:
         receive_record_in_include_mode(gr->get_record_type(), gr->get_gaddr(), gr->get_slist(), db_info_it->second);
 
         //if the new created group is not used delete it
         if (db_info_it->second.filter_mode == INCLUDE_MODE && db_info_it->second.include_requested_list.empty()) {
-            m_db.group_info.erase(db_info_it);
+            m_db.erase_group(db_info_it);
         }
 
         break;
@@ -172,7 +449,7 @@ void querier::receive_record(const std::shared_ptr<proxy_msg>& msg)
 
 }
 
-void querier::receive_record_in_include_mode(mcast_addr_record_type record_type, const addr_storage& gaddr, source_list<source>& slist, gaddr_info& ginfo)
+void querier::receive_record_in_include_mode(mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>& slist, gaddr_info& ginfo)
 {
     HC_LOG_TRACE("record type: " << record_type);
     //7.4.1.  Reception of Current State Records
@@ -191,7 +468,7 @@ void querier::receive_record_in_include_mode(mcast_addr_record_type record_type,
     case ALLOW_NEW_SOURCES: {//ALLOW(x)
         A += B;
 
-        mali(gaddr, A, std::move(B));
+        mali(gaddr, ginfo, A, std::move(B));
 
         state_change_notification(gaddr);
     }
@@ -229,7 +506,7 @@ void querier::receive_record_in_include_mode(mcast_addr_record_type record_type,
         A += B;
 
         send_Q(gaddr, ginfo, A, (A - B));
-        mali(gaddr, A, std::move(B));
+        mali(gaddr, ginfo, A, std::move(B));
 
         state_change_notification(gaddr);
     }
@@ -255,7 +532,7 @@ void querier::receive_record_in_include_mode(mcast_addr_record_type record_type,
     case MODE_IS_INCLUDE: {//IS_IN(x)
         A += B;
 
-        mali(gaddr, A, move(B));
+        mali(gaddr, ginfo, A, std::move(B));
 
         state_change_notification(gaddr);
     }
@@ -269,7 +546,7 @@ void querier::receive_record_in_include_mode(mcast_addr_record_type record_type,
 
 }
 
-void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type, const addr_storage& gaddr, source_list<source>& slist, gaddr_info& ginfo)
+void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>& slist, gaddr_info& ginfo)
 {
     HC_LOG_TRACE("record type: " << record_type);
     //7.4.1.  Reception of Current State Records
@@ -291,7 +568,7 @@ void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type,
         X += A;
         Y -= A;
 
-        mali(gaddr, X, std::move(A));
+        mali(gaddr, ginfo, X, std::move(A));
 
         state_change_notification(gaddr);
     }
@@ -329,7 +606,7 @@ void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type,
         Y *= A;
 
         auto tmpXa = X;
-        send_Q(gaddr, ginfo, X, move(tmpXa)); //bad style, but i haven't a better solution right now ???????????
+        send_Q(gaddr, ginfo, X, std::move(tmpXa)); //bad style, but i haven't a better solution right now ???????????
         mali(gaddr, filter_timer);
 
         state_change_notification(gaddr);
@@ -346,7 +623,7 @@ void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type,
 
         send_Q(gaddr, ginfo, X, (X - A));
         send_Q(gaddr, ginfo);
-        mali(gaddr, X, std::move(A));
+        mali(gaddr, ginfo, X, std::move(A));
 
         state_change_notification(gaddr);
     }
@@ -358,7 +635,7 @@ void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type,
     //                                                   Delete (Y-A)
     //                                                   Filter Timer=MALI
     case  MODE_IS_EXCLUDE: {//IS_EX(x)
-        mali(gaddr, A, (A - X) - Y);
+        mali(gaddr, ginfo, A, (A - X) - Y);
 
         //X = (A - Y);
         //this is bad!! if in request_list is IP 1.1.1.1 and in A 1.1.1.1 then you create a zombie in X (without a running timer)?????????????????????
@@ -379,7 +656,7 @@ void querier::receive_record_in_exclude_mode(mcast_addr_record_type record_type,
         X += A;
         Y -= A;
 
-        mali(gaddr, X, std::move(A));
+        mali(gaddr, ginfo, X, std::move(A));
 
         state_change_notification(gaddr);
     }
@@ -407,7 +684,7 @@ void querier::timer_triggerd(const std::shared_ptr<proxy_msg>& msg)
 
             db_info_it = m_db.group_info.find(tm->get_gaddr());
 
-            if (db_info_it == end(m_db.group_info)) {
+            if (db_info_it == std::end(m_db.group_info)) {
                 HC_LOG_ERROR("filter_timer message is still in use but cannot found");
                 return;
             }
@@ -422,9 +699,15 @@ void querier::timer_triggerd(const std::shared_ptr<proxy_msg>& msg)
         }
     } else {
         HC_LOG_DEBUG("filter_timer is outdate");
+        MCPROXY_PROBE(timer_stale, m_if_index, msg->get_type());
         return;
     }
 
+    membership_size before;
+    if (msg->get_type() != proxy_msg::GENERAL_QUERY_TIMER_MSG) {
+        before = db_info_it->second.get_size();
+    }
+
     switch (msg->get_type()) {
     case proxy_msg::FILTER_TIMER_MSG:
         timer_triggerd_filter_timer(db_info_it, tm);
@@ -448,6 +731,19 @@ void querier::timer_triggerd(const std::shared_ptr<proxy_msg>& msg)
         HC_LOG_ERROR("unknown timer message format");
         return;
     }
+
+    if (msg->get_type() != proxy_msg::GENERAL_QUERY_TIMER_MSG) {
+        update_usage(before, get_group_size(tm->get_gaddr()));
+    }
+}
+
+void querier::timer_triggerd(const std::vector<std::shared_ptr<proxy_msg>>& msgs)
+{
+    HC_LOG_TRACE("count: " << msgs.size());
+
+    for (auto & e : msgs) {
+        timer_triggerd(e);
+    }
 }
 
 void querier::timer_triggerd_filter_timer(gaddr_map::iterator db_info_it, const std::shared_ptr<timer_msg>& msg)
@@ -492,13 +788,13 @@ void querier::timer_triggerd_filter_timer(gaddr_map::iterator db_info_it, const
 
     if (ginfo.filter_mode == EXCLUDE_MODE) {
         if (ginfo.include_requested_list.empty()) {
-            addr_storage notify_gaddr = db_info_it->first;
+            mc_addr notify_gaddr = db_info_it->first;
 
-            m_db.group_info.erase(db_info_it);
+            m_db.erase_group(db_info_it);
 
             state_change_notification(notify_gaddr); //only A
         } else {
-            addr_storage notify_gaddr = db_info_it->first;
+            mc_addr notify_gaddr = db_info_it->first;
 
             ginfo.filter_mode = INCLUDE_MODE;
             ginfo.shared_filter_timer.reset();
@@ -527,7 +823,7 @@ void querier::timer_triggerd_source_timer(gaddr_map::iterator db_info_it, const
         //Include List.  If there are no more source records left, the
         //multicast address record is deleted from the router.
     case INCLUDE_MODE: {
-        addr_storage notify_gaddr = db_info_it->first;
+        mc_addr notify_gaddr = db_info_it->first;
 
         for (auto it = std::begin(ginfo.include_requested_list); it != std::end(ginfo.include_requested_list);) {
             if (it->shared_source_timer.get() == msg.get()) {
@@ -539,7 +835,7 @@ void querier::timer_triggerd_source_timer(gaddr_map::iterator db_info_it, const
         }
 
         if (ginfo.include_requested_list.empty()) {
-            m_db.group_info.erase(db_info_it);
+            m_db.erase_group(db_info_it);
         }
 
 
@@ -552,7 +848,7 @@ void querier::timer_triggerd_source_timer(gaddr_map::iterator db_info_it, const
     //of a source from the Requested List expires, the source is moved to
     //the Exclude List.
     case EXCLUDE_MODE: {
-        addr_storage notify_gaddr = db_info_it->first;
+        mc_addr notify_gaddr = db_info_it->first;
 
         for (auto it = std::begin(ginfo.include_requested_list); it != std::end(ginfo.include_requested_list);) {
             if (it->shared_source_timer.get() == msg.get()) {
@@ -604,6 +900,12 @@ void querier::timer_triggerd_general_query_timer(const std::shared_ptr<timer_msg
     HC_LOG_TRACE("");
 
     if (m_db.general_query_timer.get() == msg.get()) {
+        //the other querier present timer has expired, take over the queries
+        if (!m_db.is_querier) {
+            HC_LOG_DEBUG("querier " << m_other_querier << " on interface " << interfaces::get_if_name(m_if_index) << " is gone, start querying");
+            set_querier(true);
+        }
+
         send_general_query();
     } else {
         HC_LOG_ERROR("general query timer not found");
@@ -634,42 +936,132 @@ void querier::timer_triggerd_older_host_present_timer(gaddr_map::iterator db_inf
                 delay = m_timers_values.get_older_host_present_interval();
             }
 
-            auto ohpt = std::make_shared<older_host_present_timer_msg>(m_if_index, db_info_it->first, delay);
+            auto ohpt = make_pooled_msg<older_host_present_timer_msg>(m_if_index, db_info_it->first, delay);
             ginfo.older_host_present_timer = ohpt;
-            m_timing->add_time(delay, m_msg_worker, ohpt);
+            add_timer(delay, ohpt);
         }
     }
 }
 
-void querier::mali(const addr_storage& gaddr, gaddr_info& ginfo) const
+void querier::add_timer(std::chrono::milliseconds delay, const std::shared_ptr<timer_msg>& timer) const
 {
     HC_LOG_TRACE("");
-    auto ft = std::make_shared<filter_timer_msg>(m_if_index, gaddr, m_timers_values.get_multicast_address_listening_interval());
+    timer->set_handle(m_timing->add_time(delay, m_msg_worker, timer));
+}
+
+bool querier::restart_timer(std::chrono::milliseconds delay, const std::shared_ptr<timer_msg>& timer) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_timing->reschedule_time(timer->get_handle(), delay)) {
+        timer->restart(delay);
+        return true;
+    } else {
+        return false;
+    }
+}
+
+void querier::cancel_unused_timer(const std::shared_ptr<timer_msg>& timer) const
+{
+    HC_LOG_TRACE("");
+
+    //a pending timer is also referenced by the timing
+    if (timer != nullptr && timer.use_count() <= 2) {
+        m_timing->cancel_time(timer->get_handle());
+    }
+}
+
+void querier::cancel_unused_timers(const std::set<std::shared_ptr<timer_msg>>& timers) const
+{
+    HC_LOG_TRACE("");
+
+    for (auto & e : timers) {
+        cancel_unused_timer(e);
+    }
+}
+
+void querier::set_filter_timer(const mc_addr& gaddr, gaddr_info& ginfo, std::chrono::milliseconds delay) const
+{
+    HC_LOG_TRACE("");
+
+    //sources that share the filter timer keep its current value
+    if (ginfo.shared_filter_timer != nullptr && !ginfo.shared_filter_timer->is_used_as_source_timer()) {
+        if (restart_timer(delay, ginfo.shared_filter_timer)) {
+            return;
+        }
+    }
+
+    std::shared_ptr<timer_msg> old_ft = ginfo.shared_filter_timer;
+    auto ft = make_pooled_msg<filter_timer_msg>(m_if_index, gaddr, delay);
 
     ginfo.shared_filter_timer = ft;
 
-    m_timing->add_time(m_timers_values.get_multicast_address_listening_interval(), m_msg_worker, ft);
+    add_timer(delay, ft);
+    cancel_unused_timer(old_ft);
+}
+
+void querier::mali(const mc_addr& gaddr, gaddr_info& ginfo) const
+{
+    HC_LOG_TRACE("");
+    set_filter_timer(gaddr, ginfo, m_timers_values.get_multicast_address_listening_interval());
 }
 
-void querier::mali(const addr_storage& gaddr, source_list<source>& slist) const
+void querier::mali(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist) const
 {
     HC_LOG_TRACE("");
-    auto st = std::make_shared<source_timer_msg>(m_if_index, gaddr, m_timers_values.get_multicast_address_listening_interval());
+
+    if (slist.empty()) {
+        return;
+    }
+
+    auto delay = m_timers_values.get_multicast_address_listening_interval();
+
+    //join the expiry bucket of the group if it ends at most QUERIER_SOURCE_TIMER_BUCKET earlier, the bucket is extended to the new deadline
+    std::shared_ptr<source_timer_msg> st = ginfo.source_timer_bucket.lock();
+    if (st == nullptr || !st->is_remaining_time_greater_than(delay - std::chrono::milliseconds(QUERIER_SOURCE_TIMER_BUCKET)) || !restart_timer(delay, st)) {
+        st = make_pooled_msg<source_timer_msg>(m_if_index, gaddr, delay);
+        ginfo.source_timer_bucket = st;
+        add_timer(delay, st);
+    }
 
     for (auto & e : slist) {
         e.shared_source_timer = st; //shard_source_timer is mutable
         e.retransmission_count = -1;
     }
-
-    if (!slist.empty()) {
-        m_timing->add_time(m_timers_values.get_multicast_address_listening_interval(), m_msg_worker, st);
-    }
 }
 
-void querier::mali(const addr_storage& gaddr, source_list<source>& slist, source_list<source>&& tmp_slist) const
+void querier::mali(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_slist) const
 {
     HC_LOG_TRACE("");
-    mali(gaddr, tmp_slist);
+
+    std::list<source_list<source>::iterator> updated_sources;
+    std::set<std::shared_ptr<timer_msg>> old_timers;
+    unsigned int old_timer_refs = 0;
+
+    for (auto & e : tmp_slist) {
+        auto it = slist.find(e);
+        if (it != std::end(slist)) {
+            updated_sources.push_back(it);
+            if (it->shared_source_timer != nullptr) {
+                old_timers.insert(it->shared_source_timer);
+                old_timer_refs++;
+            }
+        }
+    }
+
+    //if all sources sharing a source timer get updated, the source timer is restarted in place
+    if (old_timers.size() == 1) {
+        auto& st = *old_timers.begin();
+        if (st->get_type() == proxy_msg::SOURCE_TIMER_MSG && st.use_count() == old_timer_refs + 2 && restart_timer(m_timers_values.get_multicast_address_listening_interval(), st)) {
+            for (auto & e : updated_sources) {
+                e->shared_source_timer = st;
+                e->retransmission_count = -1;
+            }
+            return;
+        }
+    }
+
+    mali(gaddr, ginfo, tmp_slist);
 
     for (auto & e : tmp_slist) {
         auto it = slist.find(e);
@@ -678,6 +1070,8 @@ void querier::mali(const addr_storage& gaddr, source_list<source>& slist, source
             it->retransmission_count = -1;
         }
     }
+
+    cancel_unused_timers(old_timers);
 }
 
 void querier::filter_time(gaddr_info& ginfo, source_list<source>& slist, source_list<source>&&  tmp_slist)
@@ -693,7 +1087,7 @@ void querier::filter_time(gaddr_info& ginfo, source_list<source>& slist, source_
     }
 }
 
-void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo)
+void querier::send_Q(const mc_addr& gaddr, gaddr_info& ginfo)
 {
     HC_LOG_TRACE("");
 
@@ -708,14 +1102,26 @@ void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo)
     //Timer is larger than LLQT, the "Suppress Router-Side Processing" bit
     //is set in the query message.
 
-    if (ginfo.group_retransmission_timer == nullptr) {
-        ginfo.group_retransmission_count = m_timers_values.get_last_listener_query_count();
-        auto llqt = m_timers_values.get_last_listener_query_time();
-        auto ftimer = std::make_shared<filter_timer_msg>(m_if_index, gaddr, llqt);
+    //fast leave: the only listener has left, the filter timer expires immediately
+    if (ginfo.group_retransmission_timer == nullptr && m_fast_leave) {
+        HC_LOG_DEBUG("fast leave of the group " << gaddr);
+        set_filter_timer(gaddr, ginfo, std::chrono::milliseconds(0));
+        return;
+    }
 
-        ginfo.shared_filter_timer = ftimer;
+    //explicit tracking: the tracked hosts answer the query without asking, if the last host in EXCLUDE_MODE
+    //has left the filter timer expires immediately
+    if (ginfo.group_retransmission_timer == nullptr && is_tracking_reliable(ginfo)) {
+        if (!ginfo.tracking.is_group_wanted()) {
+            HC_LOG_DEBUG("last tracked host left the group " << gaddr);
+            set_filter_timer(gaddr, ginfo, std::chrono::milliseconds(0));
+        }
+        return;
+    }
 
-        m_timing->add_time(llqt, m_msg_worker, ftimer);
+    if (ginfo.group_retransmission_timer == nullptr) {
+        ginfo.group_retransmission_count = m_timers_values.get_last_listener_query_count();
+        set_filter_timer(gaddr, ginfo, m_timers_values.get_last_listener_query_time());
     }
 
     if (ginfo.group_retransmission_count > 0) {
@@ -723,12 +1129,14 @@ void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo)
 
         if (ginfo.group_retransmission_count > 0) {
             auto llqi = m_timers_values.get_last_listener_query_interval();
-            auto rtimer = std::make_shared<retransmit_group_timer_msg>(m_if_index, gaddr, llqi);
+            auto rtimer = make_pooled_msg<retransmit_group_timer_msg>(m_if_index, gaddr, llqi);
+            std::shared_ptr<timer_msg> old_rtimer = ginfo.group_retransmission_timer;
             ginfo.group_retransmission_timer = rtimer;
-            m_timing->add_time(llqi, m_msg_worker, rtimer);
+            add_timer(llqi, rtimer);
+            cancel_unused_timer(old_rtimer);
         }
 
-        m_sender->send_mc_addr_specific_query(m_if_index, m_timers_values, gaddr, ginfo.shared_filter_timer->is_remaining_time_greater_than(m_timers_values.get_last_listener_query_time()));
+        m_pending_queries[gaddr].m_group = true;
 
     } else { //reset itself
         ginfo.group_retransmission_timer = nullptr;
@@ -737,14 +1145,34 @@ void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo)
 }
 
 
-void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_list, bool in_retransmission_state)
+void querier::send_Q(const mc_addr& gaddr, gaddr_info& ginfo, source_list<source>& slist, source_list<source>&& tmp_list, bool in_retransmission_state)
 {
     HC_LOG_TRACE("");
 
+    //fast leave: the only listener has blocked the sources, they expire immediately
+    if (!tmp_list.empty() && m_fast_leave) {
+        expire_sources(gaddr, slist, std::move(tmp_list));
+        tmp_list.clear();
+    }
+
+    //explicit tracking: the tracked hosts answer the query without asking, sources without a tracked host expire immediately
+    if (!tmp_list.empty() && is_tracking_reliable(ginfo)) {
+        source_list<source> expired;
+        for (auto & e : tmp_list) {
+            if (!ginfo.tracking.is_source_wanted(e.saddr)) {
+                expired.insert(expired.end(), e);
+            }
+        }
+
+        expire_sources(gaddr, slist, std::move(expired));
+        tmp_list.clear();
+    }
+
     bool is_used = false;
 
     auto llqt = m_timers_values.get_last_listener_query_time();
-    auto st = std::make_shared<source_timer_msg>(m_if_index, gaddr, llqt);
+    auto st = make_pooled_msg<source_timer_msg>(m_if_index, gaddr, llqt);
+    std::set<std::shared_ptr<timer_msg>> old_timers;
 
     for (auto & e : tmp_list) {
         auto it = slist.find(e);
@@ -752,6 +1180,9 @@ void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo, source_list<s
             if (it->retransmission_count < 1) {
                 is_used = true;
 
+                if (it->shared_source_timer != nullptr) {
+                    old_timers.insert(it->shared_source_timer);
+                }
                 it->shared_source_timer = st;
                 it->retransmission_count = m_timers_values.get_last_listener_query_count();
             }
@@ -759,31 +1190,235 @@ void querier::send_Q(const addr_storage& gaddr, gaddr_info& ginfo, source_list<s
     }
 
     if (is_used) {
-        m_timing->add_time(llqt, m_msg_worker, st);
+        add_timer(llqt, st);
+        cancel_unused_timers(old_timers);
     }
 
     if (is_used  || in_retransmission_state) {
-        if (m_sender->send_mc_addr_and_src_specific_query(m_if_index, m_timers_values, gaddr, slist)) {
-            auto llqi = m_timers_values.get_last_listener_query_interval();
-            auto rst = std::make_shared<retransmit_source_timer_msg>(m_if_index, gaddr, llqi);
-            ginfo.source_retransmission_timer = rst;
-            m_timing->add_time(llqi, m_msg_worker, rst);
+        m_pending_queries[gaddr].m_sources = true;
+    }
+}
+
+void querier::flush_queries()
+{
+    HC_LOG_TRACE("");
+
+    //a non-querier lowers its timers like the querier but leaves the queries to the querier
+    if (!m_db.is_querier) {
+        m_pending_queries.clear();
+        return;
+    }
+
+    for (auto & e : m_pending_queries) {
+        auto db_info_it = m_db.group_info.find(e.first);
+        if (db_info_it == std::end(m_db.group_info)) { //deleted in the meantime
+            continue;
+        }
+
+        gaddr_info& ginfo = db_info_it->second;
+
+        if (e.second.m_group && ginfo.shared_filter_timer != nullptr) {
+            m_sender->send_mc_addr_specific_query(m_if_index, m_timers_values, e.first, ginfo.shared_filter_timer->is_remaining_time_greater_than(m_timers_values.get_last_listener_query_time()));
+        }
+
+        //the retransmissions of the sources are counted once per flush
+        if (e.second.m_sources) {
+            if (m_sender->send_mc_addr_and_src_specific_query(m_if_index, m_timers_values, e.first, ginfo.include_requested_list)) {
+                auto llqi = m_timers_values.get_last_listener_query_interval();
+                auto rst = make_pooled_msg<retransmit_source_timer_msg>(m_if_index, e.first, llqi);
+                std::shared_ptr<timer_msg> old_rst = ginfo.source_retransmission_timer;
+                ginfo.source_retransmission_timer = rst;
+                add_timer(llqi, rst);
+                cancel_unused_timer(old_rst);
+            }
         }
     }
+
+    m_pending_queries.clear();
+}
+
+bool querier::is_tracking_reliable(const gaddr_info& ginfo) const
+{
+    HC_LOG_TRACE("");
+    return m_db.explicit_tracking && !ginfo.is_in_backward_compatibility_mode() && !ginfo.is_under_bakcward_compatibility_effects();
+}
+
+void querier::expire_sources(const mc_addr& gaddr, source_list<source>& slist, source_list<source>&& tmp_slist) const
+{
+    HC_LOG_TRACE("");
+
+    if (tmp_slist.empty()) {
+        return;
+    }
+
+    bool is_used = false;
+
+    auto st = make_pooled_msg<source_timer_msg>(m_if_index, gaddr, std::chrono::milliseconds(0));
+    std::set<std::shared_ptr<timer_msg>> old_timers;
+
+    for (auto & e : tmp_slist) {
+        auto it = slist.find(e);
+        if (it != std::end(slist)) {
+            is_used = true;
+
+            if (it->shared_source_timer != nullptr) {
+                old_timers.insert(it->shared_source_timer);
+            }
+            it->shared_source_timer = st;
+            it->retransmission_count = -1;
+        }
+    }
+
+    if (is_used) {
+        HC_LOG_DEBUG("last listener left " << tmp_slist.size() << " source(s) of the group " << gaddr);
+        add_timer(std::chrono::milliseconds(0), st);
+        cancel_unused_timers(old_timers);
+    }
 }
 
-void querier::state_change_notification(const addr_storage& gaddr)
+void querier::state_change_notification(const mc_addr& gaddr)
 {
     HC_LOG_TRACE("");
+
+    auto db_info_it = m_db.group_info.find(gaddr);
+    if (db_info_it != std::end(m_db.group_info)) {
+        db_info_it->second.version = next_group_version();
+    }
+
+    m_state_version = next_group_version();
     m_cb_state_change(m_if_index, gaddr);
 }
 
+void querier::set_querier(bool is_querier)
+{
+    HC_LOG_TRACE("");
+
+    if (m_db.is_querier == is_querier) {
+        return;
+    }
+
+    m_db.is_querier = is_querier;
+    if (is_querier) {
+        m_other_querier = mc_addr();
+    }
+
+    m_state_version = next_group_version();
+    for (auto & e : m_db.group_info) {
+        state_change_notification(e.first);
+    }
+}
+
+unsigned long long querier::next_group_version()
+{
+    HC_LOG_TRACE("");
+    static std::atomic<unsigned long long> version(0);
+    return ++version;
+}
+
+unsigned long long querier::get_state_version() const
+{
+    HC_LOG_TRACE("");
+    return m_state_version;
+}
+
+std::shared_ptr<const downstream_snapshot> querier::get_snapshot()
+{
+    HC_LOG_TRACE("");
+
+    if (m_snapshot != nullptr && m_snapshot->version == m_state_version) {
+        return m_snapshot;
+    }
+
+    auto snapshot = std::make_shared<downstream_snapshot>();
+    snapshot->if_index = m_if_index;
+    snapshot->version = m_state_version;
+    snapshot->querier_version_mode = m_db.querier_version_mode;
+    snapshot->is_querier = m_db.is_querier;
+
+    //the hash map is unordered, sort the groups to merge them with the previous snapshot
+    std::vector<const gaddr_pair*> groups;
+    groups.reserve(m_db.group_info.size());
+    for (auto & e : m_db.group_info) {
+        groups.push_back(&e);
+    }
+    std::sort(std::begin(groups), std::end(groups), [](const gaddr_pair * l, const gaddr_pair * r) {
+        return l->first < r->first;
+    });
+
+    static const std::vector<std::shared_ptr<const group_snapshot>> no_groups;
+    const auto& old_groups = m_snapshot != nullptr ? m_snapshot->groups : no_groups;
+    auto old_it = std::begin(old_groups);
+
+    snapshot->groups.reserve(groups.size());
+    for (auto e : groups) {
+        while (old_it != std::end(old_groups) && (*old_it)->gaddr < e->first) {
+            ++old_it;
+        }
+
+        //the group has not changed since the last snapshot
+        if (old_it != std::end(old_groups) && (*old_it)->gaddr == e->first && (*old_it)->version == e->second.version) {
+            snapshot->groups.push_back(*old_it);
+            continue;
+        }
+
+        auto g = std::make_shared<group_snapshot>();
+        g->gaddr = e->first;
+        g->version = e->second.version;
+        g->filter_mode = e->second.filter_mode;
+        g->compatibility_mode = e->second.compatibility_mode_variable;
+        g->include_requested_list.reserve(e->second.include_requested_list.size());
+        for (auto & src : e->second.include_requested_list) {
+            g->include_requested_list.insert(std::end(g->include_requested_list), src.saddr);
+        }
+        g->exclude_list.reserve(e->second.exclude_list.size());
+        for (auto & src : e->second.exclude_list) {
+            g->exclude_list.insert(std::end(g->exclude_list), src.saddr);
+        }
+        snapshot->groups.push_back(std::move(g));
+    }
+
+    m_snapshot = std::move(snapshot);
+    return m_snapshot;
+}
+
+unsigned long long querier::get_group_version(const mc_addr& gaddr) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_db.is_querier == true) {
+        auto db_info_it = m_db.group_info.find(gaddr);
+        if (db_info_it != std::end(m_db.group_info)) {
+            return db_info_it->second.version;
+        }
+    }
+
+    return 0;
+}
+
 querier::~querier()
 {
     HC_LOG_TRACE("");
+    update_usage(m_size, membership_size());
     router_groups_function(false);
 }
 
+void querier::set_limits(const membership_limits& limits)
+{
+    HC_LOG_TRACE("");
+    m_limits = limits;
+}
+
+void querier::set_fast_leave(bool fast_leave)
+{
+    HC_LOG_TRACE("");
+    m_fast_leave = fast_leave;
+}
+
+const membership_size& querier::get_size() const
+{
+    return m_size;
+}
+
 timers_values& querier::get_timers_values()
 {
     HC_LOG_TRACE("");
@@ -791,7 +1426,7 @@ timers_values& querier::get_timers_values()
 }
 
 //interface_filter_fun is very useless, please overwork ???????????????
-void querier::suggest_to_forward_traffic(const addr_storage& gaddr, std::list<std::pair<source, std::list<unsigned int>>>& rt_slist, std::function<bool(const addr_storage&)> interface_filter_fun) const
+void querier::suggest_to_forward_traffic(const mc_addr& gaddr, std::list<std::pair<source, std::list<unsigned int>>>& rt_slist, std::function<bool(const mc_addr&)> interface_filter_fun) const
 {
     HC_LOG_TRACE("");
 
@@ -837,7 +1472,99 @@ void querier::suggest_to_forward_traffic(const addr_storage& gaddr, std::list<st
 
 }
 
-std::pair<mc_filter, source_list<source>> querier::get_group_membership_infos(const addr_storage& gaddr)
+bool querier::is_source_independent(const mc_addr& gaddr, bool& forward) const
+{
+    HC_LOG_TRACE("");
+
+    forward = false;
+    if (m_db.is_querier == false) {
+        return true;
+    }
+
+    auto db_info_it = m_db.group_info.find(gaddr);
+    if (db_info_it == std::end(m_db.group_info)) {
+        return true;
+    }
+
+    if (db_info_it->second.is_under_bakcward_compatibility_effects()) {
+        forward = true;
+        return true;
+    } else if (db_info_it->second.filter_mode == INCLUDE_MODE) {
+        return db_info_it->second.include_requested_list.empty();
+    } else if (db_info_it->second.filter_mode == EXCLUDE_MODE) {
+        forward = true;
+        return db_info_it->second.exclude_list.empty();
+    } else {
+        HC_LOG_ERROR("unknown filter mode");
+        return false;
+    }
+}
+
+bool querier::restore_group(const group_snapshot& g, std::chrono::milliseconds elapsed)
+{
+    HC_LOG_TRACE("");
+
+    std::chrono::milliseconds delay = m_timers_values.get_multicast_address_listening_interval() - elapsed;
+    if (delay <= std::chrono::milliseconds(0) || (g.filter_mode == INCLUDE_MODE && g.include_requested_list.empty())) {
+        return false;
+    }
+
+    if (m_db.group_info.find(g.gaddr) != std::end(m_db.group_info)) {
+        return false;
+    }
+
+    auto db_info_it = m_db.add_group(g.gaddr);
+    gaddr_info& ginfo = db_info_it->second;
+    ginfo.filter_mode = g.filter_mode;
+
+    for (auto & e : g.include_requested_list) {
+        ginfo.include_requested_list.insert(source(e));
+    }
+
+    for (auto & e : g.exclude_list) {
+        ginfo.exclude_list.insert(source(e));
+    }
+
+    if (g.filter_mode == EXCLUDE_MODE) {
+        set_filter_timer(g.gaddr, ginfo, delay);
+    }
+
+    //all requested sources share one source timer
+    if (!ginfo.include_requested_list.empty()) {
+        auto st = make_pooled_msg<source_timer_msg>(m_if_index, g.gaddr, delay);
+        ginfo.source_timer_bucket = st;
+        add_timer(delay, st);
+
+        for (auto & e : ginfo.include_requested_list) {
+            e.shared_source_timer = st;
+            e.retransmission_count = -1;
+        }
+    }
+
+    //backwards compatibility coordination
+    std::chrono::milliseconds ohpi = m_timers_values.get_older_host_present_interval() - elapsed;
+    if (!is_newest_version(g.compatibility_mode) && is_older_or_equal_version(g.compatibility_mode, m_db.querier_version_mode) && g.compatibility_mode != m_db.querier_version_mode && ohpi > std::chrono::milliseconds(0)) {
+        ginfo.compatibility_mode_variable = g.compatibility_mode;
+        ginfo.older_host_present_timer = make_pooled_msg<older_host_present_timer_msg>(m_if_index, g.gaddr, ohpi);
+        add_timer(ohpi, ginfo.older_host_present_timer);
+    }
+
+    //the reporting hosts are unknown, a placeholder host keeps the group until the restored state expires
+    if (m_db.explicit_tracking) {
+        source_list<source> slist;
+        for (auto & e : g.filter_mode == INCLUDE_MODE ? g.include_requested_list : g.exclude_list) {
+            slist.insert(source(e));
+        }
+        ginfo.tracking.update(mc_addr(addr_storage(get_addr_family(m_db.querier_version_mode))), g.filter_mode == INCLUDE_MODE ? MODE_IS_INCLUDE : MODE_IS_EXCLUDE, slist, timer_clock::now() + delay);
+    }
+
+    ginfo.version = next_group_version();
+    m_state_version = next_group_version();
+    update_usage(membership_size(), ginfo.get_size());
+    return true;
+}
+
+std::pair<mc_filter, source_list<source>> querier::get_group_membership_infos(const mc_addr& gaddr)
 {
     HC_LOG_TRACE("");
     std::pair<mc_filter, source_list<source>> rt_pair;
@@ -871,6 +1598,9 @@ std::string querier::to_string() const
     std::ostringstream s;
     s << "##-- downstream interface: " << interfaces::get_if_name(m_if_index) << " (index:" << m_if_index << ") --##" << std::endl;
     s << m_db;
+    if (!m_db.is_querier) {
+        s << "other querier: " << m_other_querier << std::endl;
+    }
     return s.str();
 }
 
@@ -0,0 +1,209 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/querier_shard.hpp"
+#include "include/proxy/proxy_instance.hpp"
+#include "include/proxy/querier.hpp"
+#include "include/proxy/sender.hpp"
+#include "include/proxy/event_trace.hpp"
+#include "include/utils/metrics.hpp"
+
+querier_shard::querier_shard(proxy_instance* coordinator, const std::shared_ptr<const sender>& sender, const std::shared_ptr<event_trace>& trace)
+    : m_coordinator(coordinator)
+    , m_sender(sender)
+    , m_event_trace(trace)
+{
+    HC_LOG_TRACE("");
+    start(TR_QUERIER, "mcp-querier");
+}
+
+querier_shard::~querier_shard()
+{
+    HC_LOG_TRACE("");
+    shutdown();
+}
+
+void querier_shard::shutdown()
+{
+    HC_LOG_TRACE("");
+
+    if (m_thread.get() != nullptr) {
+        add_msg(std::make_shared<exit_cmd>());
+
+        //join here, the worker thread uses the members of this class
+        join();
+        m_thread.reset();
+    }
+}
+
+std::mutex& querier_shard::get_lock() const
+{
+    HC_LOG_TRACE("");
+    return m_lock;
+}
+
+void querier_shard::add_querier(unsigned int if_index, querier* q)
+{
+    HC_LOG_TRACE("");
+    m_queriers[if_index] = q;
+}
+
+void querier_shard::del_querier(unsigned int if_index)
+{
+    HC_LOG_TRACE("");
+    m_queriers.erase(if_index);
+}
+
+void querier_shard::querier_state_change(unsigned int if_index, const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+    metrics::add_latency(LATENCY_QUERIER);
+    m_state_changes.push_back(std::make_tuple(if_index, gaddr, metrics::get_origin()));
+}
+
+void querier_shard::post_state_changes()
+{
+    HC_LOG_TRACE("");
+
+    for (auto & e : m_state_changes) {
+        auto msg = make_pooled_msg<state_change_msg>(std::get<0>(e), std::get<1>(e));
+        msg->set_origin(std::get<2>(e));
+        m_coordinator->add_msg(msg);
+    }
+
+    m_state_changes.clear();
+}
+
+void querier_shard::worker_thread()
+{
+    HC_LOG_TRACE("");
+
+    std::vector<std::shared_ptr<proxy_msg>> batch;
+    batch.reserve(QUERIER_SHARD_BATCH_SIZE);
+
+    while (m_running) {
+        m_job_queue.dequeue_batch(batch, QUERIER_SHARD_BATCH_SIZE);
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (auto & msg : batch) {
+                if (!m_running) {
+                    break;
+                }
+                //the queries of other routers are recorded by the proxy instance that hands them to the shards
+                if (m_event_trace != nullptr && msg->get_type() != proxy_msg::QUERIER_QUERY_MSG) {
+                    m_event_trace->record(msg);
+                }
+                metrics::set_origin(msg->get_origin());
+                handle_msg(msg);
+            }
+            metrics::set_origin(std::chrono::steady_clock::time_point());
+
+            for (auto & e : m_queriers) {
+                e.second->flush_queries();
+            }
+        }
+
+        m_sender->flush_packets();
+
+        batch.clear();
+
+        //the coordinator may wait for m_lock, so never post with m_lock held
+        post_state_changes();
+    }
+
+    HC_LOG_DEBUG("worker thread querier_shard end");
+}
+
+void querier_shard::handle_msg(const std::shared_ptr<proxy_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    switch (msg->get_type()) {
+    case proxy_msg::FILTER_TIMER_MSG:
+    case proxy_msg::SOURCE_TIMER_MSG:
+    case proxy_msg::RET_GROUP_TIMER_MSG:
+    case proxy_msg::RET_SOURCE_TIMER_MSG:
+    case proxy_msg::OLDER_HOST_PRESENT_TIMER_MSG:
+    case proxy_msg::GENERAL_QUERY_TIMER_MSG: {
+        auto it = m_queriers.find(std::static_pointer_cast<timer_msg>(msg)->get_if_index());
+        if (it != std::end(m_queriers)) {
+            it->second->timer_triggerd(msg);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<timer_msg>(msg)->get_if_index()));
+        }
+    }
+    break;
+    case proxy_msg::GROUP_RECORD_MSG: {
+        metrics::add_latency(LATENCY_QUEUE);
+        auto it = m_queriers.find(std::static_pointer_cast<group_record_msg>(msg)->get_if_index());
+        if (it != std::end(m_queriers)) {
+            it->second->receive_record(msg);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(std::static_pointer_cast<group_record_msg>(msg)->get_if_index()));
+        }
+    }
+    break;
+    case proxy_msg::QUERIER_QUERY_MSG: {
+        auto it = m_queriers.find(std::static_pointer_cast<querier_query_msg>(msg)->get_if_index());
+        if (it != std::end(m_queriers)) {
+            it->second->receive_query(std::static_pointer_cast<querier_query_msg>(msg));
+        }
+    }
+    break;
+    case proxy_msg::TIMER_BATCH_MSG:
+        handle_timer_batch(std::static_pointer_cast<timer_batch_msg>(msg));
+        break;
+    case proxy_msg::EXIT_MSG:
+        HC_LOG_DEBUG("received exit command");
+        stop();
+        break;
+    default:
+        HC_LOG_ERROR("Received unknown message");
+        break;
+    }
+}
+
+void querier_shard::handle_timer_batch(const std::shared_ptr<timer_batch_msg>& msg)
+{
+    HC_LOG_TRACE("");
+
+    //the timer events are moved, the queriers detect outdated timers by their reference count
+    std::map<unsigned int, std::vector<std::shared_ptr<proxy_msg>>> querier_timers;
+
+    for (auto & e : msg->get_timers()) {
+        unsigned int if_index = std::static_pointer_cast<timer_msg>(e)->get_if_index();
+        querier_timers[if_index].push_back(std::move(e));
+    }
+
+    msg->get_timers().clear();
+
+    for (auto & e : querier_timers) {
+        auto it = m_queriers.find(e.first);
+        if (it != std::end(m_queriers)) {
+            it->second->timer_triggerd(e.second);
+        } else {
+            HC_LOG_DEBUG("failed to find querier of interface: " << interfaces::get_if_name(e.first));
+        }
+    }
+}
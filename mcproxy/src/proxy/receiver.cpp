@@ -23,37 +23,98 @@
 
 #include "include/hamcast_logging.h"
 #include "include/proxy/receiver.hpp"
+#include "include/proxy/proxy_instance.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/tracepoints.hpp"
+
+#include <functional>
+#include <algorithm>
 
 #include <unistd.h>
 
 receiver::receiver(proxy_instance* pr_i, int addr_family, const std::shared_ptr<const mroute_socket> mrt_sock, const std::shared_ptr<const interfaces> interfaces, bool in_debug_testing_mode)
     : m_running(false)
     , m_in_debug_testing_mode(in_debug_testing_mode)
-    , m_thread(nullptr)
+    , m_io(nullptr)
+    , m_relevant_if_bitmap(new if_index_bitmap())
+    , m_relevant_if_bitmap_in_use(nullptr)
+    , m_batch_if_bitmap(nullptr)
+    , m_dedup_last_purge(std::chrono::steady_clock::now())
+    , m_dedup_suppressed(0)
+    , m_pending_last_purge(std::chrono::steady_clock::now())
+    , m_upcall_duplicates(0)
     , m_proxy_instance(pr_i)
     , m_addr_family(addr_family)
     , m_mrt_sock(mrt_sock)
     , m_interfaces(interfaces)
 {
     HC_LOG_TRACE("");
-
-    if (!m_mrt_sock->set_receive_timeout(RECEIVER_RECV_TIMEOUT)) {
-        throw std::string("failed to set receive timeout");
-    }
-
 }
 
 receiver::~receiver()
 {
     HC_LOG_TRACE("");
     stop();
-    join();
+
+    delete m_relevant_if_bitmap.load();
+    for (auto e : m_retired_if_bitmaps) {
+        delete e;
+    }
 }
 
 bool receiver::is_if_index_relevant(unsigned int if_index) const
 {
     HC_LOG_TRACE("");
-    return m_relevant_if_index.find(if_index) != std::end(m_relevant_if_index);
+    return m_batch_if_bitmap->contains(if_index);
+}
+
+void receiver::publish_relevant_if_bitmap()
+{
+    HC_LOG_TRACE("");
+
+    auto bitmap = new if_index_bitmap();
+    if (!m_relevant_if_index.empty()) {
+        bitmap->m_bits.resize(*m_relevant_if_index.rbegin() / 64 + 1, 0);
+        for (auto e : m_relevant_if_index) {
+            bitmap->m_bits[e / 64] |= uint64_t(1) << (e % 64);
+        }
+    }
+
+    m_retired_if_bitmaps.push_back(m_relevant_if_bitmap.exchange(bitmap));
+
+    //a retired bitmap can only be in use by the batch that protected it before the exchange
+    const if_index_bitmap* in_use = m_relevant_if_bitmap_in_use.load();
+    for (auto it = std::begin(m_retired_if_bitmaps); it != std::end(m_retired_if_bitmaps);) {
+        if (*it != in_use) {
+            delete *it;
+            it = m_retired_if_bitmaps.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void receiver::acquire_relevant_if_bitmap()
+{
+    HC_LOG_TRACE("");
+
+    //the bitmap is protected if it is still the current one after the hazard pointer has been set
+    const if_index_bitmap* bitmap = m_relevant_if_bitmap.load();
+    m_relevant_if_bitmap_in_use.store(bitmap);
+    while (bitmap != m_relevant_if_bitmap.load()) {
+        bitmap = m_relevant_if_bitmap.load();
+        m_relevant_if_bitmap_in_use.store(bitmap);
+    }
+
+    m_batch_if_bitmap = bitmap;
+}
+
+void receiver::release_relevant_if_bitmap()
+{
+    HC_LOG_TRACE("");
+
+    m_relevant_if_bitmap_in_use.store(nullptr);
+    m_batch_if_bitmap = nullptr;
 }
 
 void receiver::registrate_interface(unsigned int if_index)
@@ -63,6 +124,8 @@ void receiver::registrate_interface(unsigned int if_index)
     std::lock_guard<std::mutex> lock(m_data_lock);
 
     m_relevant_if_index.insert(if_index);
+    publish_relevant_if_bitmap();
+    update_socket_filter();
 }
 
 void receiver::del_interface(unsigned int if_index)
@@ -72,85 +135,396 @@ void receiver::del_interface(unsigned int if_index)
     std::lock_guard<std::mutex> lock(m_data_lock);
 
     m_relevant_if_index.erase(if_index);
+    publish_relevant_if_bitmap();
+    update_socket_filter();
+
+    m_upcall_limits.erase(if_index);
+    for (auto it = std::begin(m_pending_sources); it != std::end(m_pending_sources);) {
+        if (std::get<0>(it->first) == if_index) {
+            it = m_pending_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
-void receiver::worker_thread()
+void receiver::release_source(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr)
 {
     HC_LOG_TRACE("");
 
-    int info_size = 0;
+    std::lock_guard<std::mutex> lock(m_data_lock);
 
-    //########################
-    //create msg
-    //iov
+    m_pending_sources.erase(std::make_tuple(if_index, gaddr, saddr));
+}
 
-    std::unique_ptr<unsigned char[]> iov_buf { new unsigned char[get_iov_min_size()] };
-    //unsigned char iov_buf[r->get_iov_min_size()];
-    struct iovec iov;
-    iov.iov_base = iov_buf.get();
-    iov.iov_len = get_iov_min_size(); //sizeof(iov_buf);
+void receiver::update_socket_filter()
+{
+    HC_LOG_TRACE("");
 
-    //control
-    std::unique_ptr<unsigned char[]> ctrl { new unsigned char[get_ctrl_min_size()] };
-    //unsigned char ctrl[r->get_ctrl_min_size()];
+    if (m_in_debug_testing_mode) {
+        return;
+    }
 
-    //create msghdr
-    struct msghdr msg;
-    msg.msg_name = nullptr;
-    msg.msg_namelen = 0;
+    std::vector<struct sock_filter> filter;
+    get_socket_filter(filter);
 
-    msg.msg_iov = &iov;
-    msg.msg_iovlen = 1;
+    //interface check
+    std::size_t check_interface = filter.size();
+    if (m_relevant_if_index.size() <= RECEIVER_FILTER_MAX_INTERFACES) {
+        filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<unsigned int>(SKF_AD_OFF + SKF_AD_IFINDEX)));
+        for (auto e : m_relevant_if_index) {
+            filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, e, FILTER_ACCEPT, 0));
+        }
+    } else {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0)); //over the drop
+    }
 
-    msg.msg_control = ctrl.get();
-    msg.msg_controllen = get_ctrl_min_size(); //sizeof(ctrl);
+    std::size_t drop = filter.size();
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, 0));
 
-    msg.msg_flags = 0;
-    //########################
+    std::size_t accept = filter.size();
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, 0xFFFFFFFF));
 
-    while (m_running) {
-        if (!m_mrt_sock->receive_msg(&msg, info_size)) {
-            HC_LOG_ERROR("received failed");
-            sleep(1);
+    //resolve the labels to relative jumps
+    for (std::size_t i = 0; i < filter.size(); ++i) {
+        if (BPF_CLASS(filter[i].code) != BPF_JMP || BPF_OP(filter[i].code) == BPF_JA) {
             continue;
         }
-        if (info_size == 0) {
-            continue; //on timeout
+
+        for (unsigned char* j : {&filter[i].jt, &filter[i].jf}) {
+            switch (*j) {
+            case FILTER_CHECK_INTERFACE:
+                *j = check_interface - i - 1;
+                break;
+            case FILTER_DROP:
+                *j = drop - i - 1;
+                break;
+            case FILTER_ACCEPT:
+                *j = accept - i - 1;
+                break;
+            default:
+                break;
+            }
         }
+    }
 
-        m_data_lock.lock();
-        analyse_packet(&msg, info_size);
-        m_data_lock.unlock();
+    struct sock_fprog prog;
+    prog.len = filter.size();
+    prog.filter = filter.data();
+    if (!m_mrt_sock->attach_filter(&prog)) {
+        HC_LOG_WARN("failed to update the socket filter, all packets are delivered");
     }
 }
 
-bool receiver::is_running()
+unsigned long long receiver::hash_slist(const source_list<source>& slist)
 {
     HC_LOG_TRACE("");
-    return m_running;
+
+    //FNV-1a over the source addresses in the order of the list
+    unsigned long long hash = 14695981039346656037ULL;
+    for (auto & e : slist) {
+        const unsigned char* addr;
+        std::size_t size;
+
+        if (e.saddr.get().get_addr_family() == AF_INET) {
+            addr = reinterpret_cast<const unsigned char*>(&e.saddr.get().get_in_addr());
+            size = sizeof(in_addr);
+        } else {
+            addr = reinterpret_cast<const unsigned char*>(&e.saddr.get().get_in6_addr());
+            size = sizeof(in6_addr);
+        }
+
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ addr[i]) * 1099511628211ULL;
+        }
+    }
+
+    return hash;
 }
 
-void receiver::start()
+void receiver::purge_dedup_cache(const std::chrono::steady_clock::time_point& now)
+{
+    HC_LOG_TRACE("");
+
+    for (auto it = std::begin(m_dedup_cache); it != std::end(m_dedup_cache);) {
+        if (now - it->second.m_time >= std::chrono::milliseconds(RECEIVER_DEDUP_WINDOW_MSEC)) {
+            it = m_dedup_cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_dedup_last_purge = now;
+}
+
+bool receiver::is_duplicate_record(unsigned int if_index, mcast_addr_record_type record_type, const mc_addr& gaddr, const source_list<source>& slist, group_mem_protocol grp_mem_proto, const mc_addr& host)
+{
+    HC_LOG_TRACE("");
+
+    //the explicit tracking needs the record of each host, otherwise the answers of all hosts are equal
+    auto key = std::make_tuple(if_index, gaddr, m_proxy_instance->has_explicit_tracking() ? host : mc_addr());
+
+    //a state change record is never suppressed and ends the window of the group
+    if (record_type != MODE_IS_INCLUDE && record_type != MODE_IS_EXCLUDE) {
+        m_dedup_cache.erase(key);
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_dedup_last_purge >= std::chrono::milliseconds(RECEIVER_DEDUP_WINDOW_MSEC)) {
+        purge_dedup_cache(now);
+    }
+
+    unsigned long long slist_hash = hash_slist(slist);
+    auto it = m_dedup_cache.find(key);
+    if (it != std::end(m_dedup_cache)
+        && now - it->second.m_time < std::chrono::milliseconds(RECEIVER_DEDUP_WINDOW_MSEC)
+        && it->second.m_record_type == record_type
+        && it->second.m_grp_mem_proto == grp_mem_proto
+        && it->second.m_slist_hash == slist_hash) {
+        ++m_dedup_suppressed;
+        return true;
+    }
+
+    dedup_entry& entry = m_dedup_cache[key];
+    entry.m_time = now;
+    entry.m_record_type = record_type;
+    entry.m_grp_mem_proto = grp_mem_proto;
+    entry.m_slist_hash = slist_hash;
+    return false;
+}
+
+void receiver::send_record(unsigned int if_index, mcast_addr_record_type record_type, const mc_addr& gaddr, source_list<source>&& slist, group_mem_protocol grp_mem_proto, const mc_addr& host)
+{
+    HC_LOG_TRACE("");
+
+    metrics::add(static_cast<metric_id>(METRIC_RECORDS_IS_IN + record_type - MODE_IS_INCLUDE), 1, if_index);
+    MCPROXY_PROBE(record_parsed, if_index, record_type, &gaddr, slist.size());
+
+    if (is_duplicate_record(if_index, record_type, gaddr, slist, grp_mem_proto, host)) {
+        metrics::add(METRIC_RECORDS_SUPPRESSED, 1, if_index);
+        HC_LOG_DEBUG("duplicate record suppressed (total: " << m_dedup_suppressed << ")");
+        return;
+    }
+
+    //the record leaves the receive buffer here, the querier worker gets its own copy (see report_view)
+    auto msg = make_pooled_msg<group_record_msg>(if_index, record_type, gaddr, std::move(slist), grp_mem_proto, host);
+    msg->set_origin(m_receive_time);
+    deliver(m_proxy_instance->get_querier_worker(if_index, gaddr), msg);
+}
+
+bool receiver::is_upcall_pending(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr, const std::chrono::steady_clock::time_point& now)
+{
+    HC_LOG_TRACE("");
+
+    const std::chrono::milliseconds hold_time(RECEIVER_UPCALL_HOLD_MSEC);
+
+    //drop the sources whose messages got lost (e.g. dropped by a full queue)
+    if (now - m_pending_last_purge >= hold_time) {
+        for (auto it = std::begin(m_pending_sources); it != std::end(m_pending_sources);) {
+            if (now - it->second >= hold_time) {
+                it = m_pending_sources.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        m_pending_last_purge = now;
+    }
+
+    auto rc = m_pending_sources.insert(std::make_pair(std::make_tuple(if_index, gaddr, saddr), now));
+    if (!rc.second) {
+        if (now - rc.first->second < hold_time) {
+            ++m_upcall_duplicates;
+            return true;
+        }
+        rc.first->second = now;
+    }
+
+    return false;
+}
+
+bool receiver::is_upcall_rate_limited(unsigned int if_index, const std::chrono::steady_clock::time_point& now)
+{
+    HC_LOG_TRACE("");
+
+    auto rc = m_upcall_limits.insert(std::make_pair(if_index, upcall_limit{RECEIVER_UPCALL_BURST, now, 0}));
+    upcall_limit& limit = rc.first->second;
+
+    if (!rc.second) {
+        std::chrono::duration<double> elapsed = now - limit.m_time;
+        limit.m_tokens = std::min<double>(RECEIVER_UPCALL_BURST, limit.m_tokens + elapsed.count() * RECEIVER_UPCALL_RATE);
+        limit.m_time = now;
+    }
+
+    if (limit.m_tokens < 1) {
+        ++limit.m_rate_limited;
+        return true;
+    }
+
+    limit.m_tokens -= 1;
+    return false;
+}
+
+void receiver::send_new_source(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr)
 {
     HC_LOG_TRACE("");
+
+    auto now = std::chrono::steady_clock::now();
+    metrics::add(METRIC_UPCALLS, 1, if_index);
+
+    std::unique_lock<std::mutex> lock(m_data_lock);
+    if (is_upcall_pending(if_index, gaddr, saddr, now)) {
+        metrics::add(METRIC_UPCALLS_DROPPED, 1, if_index);
+        HC_LOG_DEBUG("upcall of pending source dropped (total: " << m_upcall_duplicates << ")");
+        return;
+    }
+
+    if (is_upcall_rate_limited(if_index, now)) {
+        //the source has to be reported again by the kernel
+        m_pending_sources.erase(std::make_tuple(if_index, gaddr, saddr));
+        metrics::add(METRIC_UPCALLS_DROPPED, 1, if_index);
+        HC_LOG_DEBUG("upcall rate of interface " << interfaces::get_if_name(if_index) << " exceeded (total: " << m_upcall_limits[if_index].m_rate_limited << ")");
+        return;
+    }
+    lock.unlock();
+
+    deliver(m_proxy_instance, make_pooled_msg<new_source_msg>(if_index, gaddr, saddr));
+}
+
+void receiver::send_upstream_query(unsigned int if_index, const mc_addr& gaddr, const std::chrono::milliseconds& max_resp_time)
+{
+    HC_LOG_TRACE("");
+
+    deliver(m_proxy_instance, make_pooled_msg<upstream_query_msg>(if_index, gaddr, max_resp_time));
+}
+
+void receiver::send_querier_query(unsigned int if_index, const mc_addr& querier, const mc_addr& gaddr, bool suppress)
+{
+    HC_LOG_TRACE("");
+
+    //the router with the lowest address is the querier (RFC 3376 6.6.2, RFC 3810 7.6.2, MLD compares the
+    //link-local addresses), this drops also the own queries looped back
+    mc_addr own = m_interfaces->get_link_local_saddr(if_index);
+    if (!own.is_valid() || own.get_addr_family() != querier.get_addr_family() || !(querier < own)) {
+        HC_LOG_DEBUG("query of " << querier << " does not win the querier election against " << own);
+        return;
+    }
+
+    deliver(m_proxy_instance, make_pooled_msg<querier_query_msg>(if_index, querier, gaddr, suppress));
+}
+
+void receiver::deliver(const worker* target, const std::shared_ptr<proxy_msg>& msg) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_in_debug_testing_mode) {
+        target->add_msg_with_policy(msg, MQ_BLOCK);
+    } else {
+        target->add_msg(msg);
+    }
+}
+
+void receiver::init_msgs()
+{
+    HC_LOG_TRACE("");
+
+    const int iov_size = get_iov_min_size();
+    const int ctrl_size = get_ctrl_min_size();
+
+    m_iov_buf.reset(new unsigned char[RECEIVER_BATCH_SIZE * iov_size]);
+    m_ctrl_buf.reset(new unsigned char[RECEIVER_BATCH_SIZE * ctrl_size]);
+
+    for (int i = 0; i < RECEIVER_BATCH_SIZE; ++i) {
+        m_iov[i].iov_base = m_iov_buf.get() + i * iov_size;
+        m_iov[i].iov_len = iov_size;
+
+        m_msgs[i].msg_hdr.msg_name = &m_names[i];
+
+        m_msgs[i].msg_hdr.msg_iov = &m_iov[i];
+        m_msgs[i].msg_hdr.msg_iovlen = 1;
+
+        m_msgs[i].msg_hdr.msg_control = m_ctrl_buf.get() + i * ctrl_size;
+        m_msgs[i].msg_len = 0;
+    }
+}
+
+void receiver::receive_batch()
+{
+    HC_LOG_TRACE("");
+
+    int received = 0;
+    const int ctrl_size = get_ctrl_min_size();
+
+    //the kernel overwrites the name and control length and the flags
+    for (int i = 0; i < RECEIVER_BATCH_SIZE; ++i) {
+        m_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        m_msgs[i].msg_hdr.msg_controllen = ctrl_size;
+        m_msgs[i].msg_hdr.msg_flags = 0;
+    }
+
+    if (!m_mrt_sock->receive_mmsg(m_msgs, RECEIVER_BATCH_SIZE, received)) {
+        HC_LOG_ERROR("received failed");
+        return;
+    }
+
+    metrics::add(METRIC_PACKETS_RECEIVED, received);
+    MCPROXY_PROBE(packet_received, received);
+    m_receive_time = std::chrono::steady_clock::now();
+
+    acquire_relevant_if_bitmap();
+    for (int i = 0; i < received; ++i) {
+        analyse_packet(&m_msgs[i].msg_hdr, m_msgs[i].msg_len);
+    }
+    release_relevant_if_bitmap();
+}
+
+void receiver::inject_packet(struct msghdr* msg, int info_size)
+{
+    HC_LOG_TRACE("");
+
     if (!m_in_debug_testing_mode) {
-        m_running =  true;
-        m_thread.reset(new std::thread(&receiver::worker_thread, this));
+        HC_LOG_ERROR("packets can be injected only in debug testing mode");
+        return;
     }
+
+    metrics::add(METRIC_PACKETS_RECEIVED);
+    m_receive_time = std::chrono::steady_clock::now();
+
+    acquire_relevant_if_bitmap();
+    analyse_packet(msg, info_size);
+    release_relevant_if_bitmap();
 }
 
-void receiver::stop()
+bool receiver::is_running()
 {
     HC_LOG_TRACE("");
+    return m_running;
+}
 
-    m_running = false;
+void receiver::start()
+{
+    HC_LOG_TRACE("");
+    if (!m_in_debug_testing_mode) {
+        {
+            std::lock_guard<std::mutex> lock(m_data_lock);
+            update_socket_filter();
+        }
+
+        init_msgs();
+        m_io = receiver_io::get_instance();
+        if (!m_io->add_socket(m_mrt_sock->get_sock(), std::bind(&receiver::receive_batch, this))) {
+            throw "failed to register receiver socket";
+        }
+        m_running =  true;
+    }
 }
 
-void receiver::join()
+void receiver::stop()
 {
     HC_LOG_TRACE("");
 
-    if (m_thread.get() != nullptr) {
-        m_thread->join();
+    if (m_running) {
+        m_io->del_socket(m_mrt_sock->get_sock());
+        m_running = false;
     }
 }
@@ -0,0 +1,216 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/receiver_io.hpp"
+#include "include/utils/thread_settings.hpp"
+
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+receiver_io::receiver_io()
+    : m_running(false)
+    , m_thread(nullptr)
+    , m_event_fd(-1)
+    , m_epoll_fd(-1)
+{
+    HC_LOG_TRACE("");
+    init_fds();
+    start();
+}
+
+receiver_io::~receiver_io()
+{
+    HC_LOG_TRACE("");
+    stop();
+    join();
+    close_fds();
+}
+
+std::shared_ptr<receiver_io> receiver_io::get_instance()
+{
+    HC_LOG_TRACE("");
+
+    static std::mutex instance_lock;
+    static std::weak_ptr<receiver_io> instance;
+
+    std::lock_guard<std::mutex> lock(instance_lock);
+    auto result = instance.lock();
+    if (result == nullptr) {
+        result = std::make_shared<receiver_io>();
+        instance = result;
+    }
+    return result;
+}
+
+void receiver_io::init_fds()
+{
+    HC_LOG_TRACE("");
+
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_event_fd < 0) {
+        HC_LOG_ERROR("failed to create eventfd! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create eventfd";
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        HC_LOG_ERROR("failed to create epoll instance! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create epoll instance";
+    }
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_event_fd;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &ev) < 0) {
+        HC_LOG_ERROR("failed to register eventfd! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to register eventfd";
+    }
+}
+
+void receiver_io::close_fds()
+{
+    HC_LOG_TRACE("");
+
+    for (int* fd : {&m_epoll_fd, &m_event_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool receiver_io::add_socket(int sock, const std::function<void()>& handler)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sock;
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+        HC_LOG_ERROR("failed to register socket! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    m_handlers[sock] = handler;
+    return true;
+}
+
+bool receiver_io::del_socket(int sock)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_handlers.erase(sock) == 0) {
+        return false;
+    }
+
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, sock, nullptr) < 0) {
+        HC_LOG_ERROR("failed to unregister socket! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    return true;
+}
+
+void receiver_io::worker_thread()
+{
+    HC_LOG_TRACE("");
+
+    epoll_event events[RECEIVER_IO_MAX_EVENTS];
+
+    while (m_running) {
+        int nfds = epoll_wait(m_epoll_fd, events, RECEIVER_IO_MAX_EVENTS, -1);
+        if (nfds < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to wait for socket events! Error: " << strerror(errno) << " errno: " << errno);
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (int i = 0; i < nfds; ++i) {
+            if (events[i].data.fd == m_event_fd) {
+                std::uint64_t count;
+                if (read(m_event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    HC_LOG_ERROR("failed to read eventfd! Error: " << strerror(errno) << " errno: " << errno);
+                }
+                continue;
+            }
+
+            //the socket may be deleted while waiting
+            auto it = m_handlers.find(events[i].data.fd);
+            if (it != std::end(m_handlers)) {
+                it->second();
+            }
+        }
+    }
+}
+
+void receiver_io::start()
+{
+    HC_LOG_TRACE("");
+
+    if (m_thread.get() == nullptr) {
+        m_running = true;
+        m_thread.reset(new std::thread([this]() {
+            thread_settings::apply(TR_RECEIVER, "mcp-receiver");
+            worker_thread();
+        }));
+    } else {
+        HC_LOG_WARN("receiver_io is already running");
+    }
+}
+
+void receiver_io::stop()
+{
+    HC_LOG_TRACE("");
+
+    m_running = false;
+
+    std::uint64_t one = 1;
+    if (m_event_fd >= 0 && write(m_event_fd, &one, sizeof(one)) < 0) {
+        HC_LOG_ERROR("failed to wake up receiver_io thread! Error: " << strerror(errno) << " errno: " << errno);
+    }
+}
+
+void receiver_io::join() const
+{
+    HC_LOG_TRACE("");
+
+    if (m_thread.get() != nullptr) {
+        m_thread->join();
+    }
+}
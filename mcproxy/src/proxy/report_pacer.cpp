@@ -0,0 +1,253 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/report_pacer.hpp"
+#include "include/proxy/sender.hpp"
+#include "include/proxy/message_format.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+bool report_pacing::parse(const std::string& arg)
+{
+    HC_LOG_TRACE("");
+
+    auto pos = arg.find(':');
+    std::string interval_value = arg.substr(0, pos);
+    try {
+        std::size_t end;
+        long long msec = std::stoll(interval_value, &end);
+        if (end != interval_value.size() || msec < 0) {
+            throw std::invalid_argument(interval_value);
+        }
+        interval = std::chrono::milliseconds(msec);
+
+        if (pos != std::string::npos) {
+            std::string rate_value = arg.substr(pos + 1);
+            unsigned long r = std::stoul(rate_value, &end);
+            if (end != rate_value.size() || rate_value[0] == '-') {
+                throw std::invalid_argument(rate_value);
+            }
+            rate = r;
+        }
+    } catch (const std::exception&) {
+        HC_LOG_ERROR("report pacing has to be <msec>[:<records per second>]: " << arg);
+        return false;
+    }
+
+    if (!is_enabled()) {
+        HC_LOG_ERROR("report pacing without interval and rate: " << arg);
+        return false;
+    }
+
+    return true;
+}
+
+report_pacer::report_pacer(const std::shared_ptr<const sender>& snd, const report_pacing& pacing)
+    : m_sender(snd)
+    , m_pacing(pacing)
+    , m_merged_records(0)
+    , m_urgent_records(0)
+{
+    HC_LOG_TRACE("");
+}
+
+report_pacer::upstream_budget& report_pacer::refill(unsigned int if_index, const std::chrono::steady_clock::time_point& now)
+{
+    HC_LOG_TRACE("");
+
+    auto rc = m_budgets.insert(std::make_pair(if_index, upstream_budget {static_cast<double>(m_pacing.rate), now}));
+    upstream_budget& b = rc.first->second;
+    if (!rc.second) {
+        double elapsed = std::chrono::duration<double>(now - b.m_last_refill).count();
+        b.m_tokens = std::min(static_cast<double>(m_pacing.rate), b.m_tokens + elapsed * m_pacing.rate);
+        b.m_last_refill = now;
+    }
+
+    return b;
+}
+
+void report_pacer::send(const key& k, mc_filter filter_mode, const source_list<source>& slist)
+{
+    HC_LOG_TRACE("");
+
+    if (filter_mode == INCLUDE_MODE && slist.empty()) {
+        m_reported.erase(k);
+    } else {
+        m_reported[k] = std::make_pair(filter_mode, slist);
+    }
+
+    m_sender->send_record(k.first, filter_mode, k.second, slist);
+}
+
+void report_pacer::send_record(unsigned int if_index, mc_filter filter_mode, const mc_addr& gaddr, const source_list<source>& slist)
+{
+    HC_LOG_TRACE("");
+
+    key k(if_index, gaddr);
+    auto now = std::chrono::steady_clock::now();
+
+    bool join = !(filter_mode == INCLUDE_MODE && slist.empty());
+    auto rep = m_reported.find(k);
+    auto it = m_pending.find(k);
+
+    //the group is back in the state that was sent last, e.g. a leave and a join within the interval
+    bool unchanged = rep == std::end(m_reported) ? !join : rep->second.first == filter_mode && rep->second.second == slist;
+    if (unchanged) {
+        if (it != std::end(m_pending)) {
+            m_pending.erase(it);
+            ++m_merged_records;
+        }
+        return;
+    }
+
+    //a host waits for the first join of a group, it is sent immediately and uses the budget without waiting for it
+    if (join && rep == std::end(m_reported)) {
+        if (it != std::end(m_pending)) {
+            m_pending.erase(it);
+        }
+        if (m_pacing.rate > 0) {
+            upstream_budget& b = refill(if_index, now);
+            b.m_tokens = std::max(0.0, b.m_tokens - 1);
+        }
+        send(k, filter_mode, slist);
+        ++m_urgent_records;
+        return;
+    }
+
+    //the queued state is replaced, the group keeps its place in the order
+    if (it != std::end(m_pending)) {
+        it->second.m_filter_mode = filter_mode;
+        it->second.m_slist = slist;
+        ++m_merged_records;
+    } else {
+        auto due = now + m_pacing.interval;
+        m_pending.insert(std::make_pair(k, pending_record {due, filter_mode, slist}));
+        m_order.push_back(std::make_pair(due, k));
+    }
+}
+
+std::chrono::milliseconds report_pacer::flush()
+{
+    HC_LOG_TRACE("");
+
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration next = std::chrono::steady_clock::duration::zero();
+
+    //records of upstreams without budget keep their place in front of the later records
+    std::deque<std::pair<std::chrono::steady_clock::time_point, key>> blocked;
+
+    while (!m_order.empty()) {
+        auto e = m_order.front();
+
+        //skip the entries of records sent immediately or replaced by a later change
+        auto it = m_pending.find(e.second);
+        if (it == std::end(m_pending) || it->second.m_due != e.first) {
+            m_order.pop_front();
+            continue;
+        }
+
+        //the order is sorted by the due time
+        if (e.first > now) {
+            next = next == std::chrono::steady_clock::duration::zero() ? e.first - now : std::min(next, e.first - now);
+            break;
+        }
+
+        m_order.pop_front();
+
+        if (m_pacing.rate > 0) {
+            upstream_budget& b = refill(e.second.first, now);
+            if (b.m_tokens < 1) {
+                auto wait = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((1 - b.m_tokens) / m_pacing.rate));
+                next = next == std::chrono::steady_clock::duration::zero() ? wait : std::min(next, wait);
+                blocked.push_back(e);
+                continue;
+            }
+            b.m_tokens -= 1;
+        }
+
+        send(e.second, it->second.m_filter_mode, it->second.m_slist);
+        m_pending.erase(it);
+    }
+
+    m_order.insert(std::begin(m_order), std::begin(blocked), std::end(blocked));
+
+    if (m_pending.empty()) {
+        return std::chrono::milliseconds(0);
+    }
+
+    //round up to the next millisecond, a pending record never returns zero
+    auto msec = std::chrono::duration_cast<std::chrono::milliseconds>(next + std::chrono::milliseconds(1) - std::chrono::steady_clock::duration(1));
+    return std::max(msec, std::chrono::milliseconds(1));
+}
+
+bool report_pacer::has_pending() const
+{
+    HC_LOG_TRACE("");
+    return !m_pending.empty();
+}
+
+const report_pacing& report_pacer::get_pacing() const
+{
+    HC_LOG_TRACE("");
+    return m_pacing;
+}
+
+void report_pacer::del_upstream(unsigned int if_index)
+{
+    HC_LOG_TRACE("");
+
+    //the order entries of the removed records are skipped by flush()
+    for (auto it = std::begin(m_pending); it != std::end(m_pending);) {
+        if (it->first.first == if_index) {
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = std::begin(m_reported); it != std::end(m_reported);) {
+        if (it->first.first == if_index) {
+            it = m_reported.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    m_budgets.erase(if_index);
+}
+
+std::string report_pacer::to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+    s << "interval: " << m_pacing.interval.count() << "msec rate: ";
+    if (m_pacing.rate > 0) {
+        s << m_pacing.rate << " records/sec";
+    } else {
+        s << "unlimited";
+    }
+    s << " pending: " << m_pending.size() << " merged: " << m_merged_records << " sent immediately: " << m_urgent_records;
+    return s.str();
+}
@@ -26,55 +26,76 @@
 #include "include/proxy/interfaces.hpp"
 #include "include/utils/addr_storage.hpp"
 #include "include/utils/mroute_socket.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/tracepoints.hpp"
+#include "include/utils/thread_settings.hpp"
 
 #include <net/if.h>
 #include <linux/mroute.h>
 #include <linux/mroute6.h>
 #include <iostream>
+#include <algorithm>
 
 routing::routing(int addr_family, std::shared_ptr<const mroute_socket> mrt_sock, std::shared_ptr<const interfaces> interfaces, int table_number)
     : m_table_number(table_number)
     , m_addr_family(addr_family)
     , m_interfaces(interfaces)
     , m_mrt_sock(mrt_sock)
+    , m_route_version(0)
+    , m_writer(nullptr)
+    , m_writer_busy(false)
+    , m_writer_stop(false)
 {
     HC_LOG_TRACE("");
 
-    if (!m_if_prop.refresh_network_interfaces()) {
-        throw "failed to refresh netwok interfaces";
-    }
+    m_writer.reset(new std::thread([this]() {
+        thread_settings::apply(TR_ROUTING, "mcp-routing");
+        writer_thread();
+    }));
+}
+
+void routing::set_route_callback(const route_callback& callback)
+{
+    HC_LOG_TRACE("");
+    m_route_callback = callback;
 }
 
 bool routing::add_vif(int if_index, int vif) const
 {
     HC_LOG_TRACE("");
 
-    char cstr[IF_NAMESIZE];
-    const struct ifaddrs* item = nullptr;
+    //the queued routes refer to the current virtual interfaces
+    hand_over_routes();
+    wait_for_routes();
 
-    std::string if_name(if_indextoname(if_index, cstr)); //fehler!!!!!! könnte abastürzten ???????????????????????ßß<F8><F8><F8>
+    if_index_prop prop;
+    const if_addr_prop* item = nullptr;
+    if (!m_interfaces->get_if_prop(if_index, prop)) {
+        HC_LOG_ERROR("interface not found: " << if_index);
+        return false;
+    }
+    const std::string& if_name = prop.name;
 
-    //useless ????????????????????????????????????????????????????????????????????
     if (m_addr_family == AF_INET) {
-        if ((item = m_if_prop.get_ip4_if(if_name)) == nullptr) {
+        if (!prop.has_ip4) {
             HC_LOG_ERROR("interface not found: " << if_name);
             return false;
         }
+        item = &prop.ip4;
     } else if (m_addr_family == AF_INET6) {
-        if ((item = m_if_prop.get_ip6_if(if_name)->front()) == nullptr) {
+        if (prop.ip6.empty()) {
             HC_LOG_ERROR("interface not found: " << if_name);
             return false;
         }
+        item = &prop.ip6.front();
     } else {
         HC_LOG_ERROR("wrong addr_family: " << m_addr_family);
         return false;
     }
 
-    if ((item->ifa_flags & IFF_POINTOPOINT) && (item->ifa_dstaddr != nullptr)) { //tunnel
+    if ((prop.flags & IFF_POINTOPOINT) && item->dstaddr.is_valid()) { //tunnel
 
-        //addr_storage p2p_addr(*(item->ifa_dstaddr));
-
-        if (!m_mrt_sock->add_vif(vif, if_index, addr_storage(*(item->ifa_dstaddr)))) {
+        if (!m_mrt_sock->add_vif(vif, if_index, item->dstaddr)) {
             return false;
         }
 
@@ -90,9 +111,7 @@ bool routing::add_vif(int if_index, int vif) const
     }
 
     if (m_table_number > 0) {
-        if (!m_mrt_sock->bind_vif_to_table(if_index, m_table_number)) {
-            return false;
-        }
+        m_pending_table_binds.push_back(if_index);
     }
 
     HC_LOG_DEBUG("added interface: " << if_name << " to vif_table with vif number:" << vif);
@@ -116,8 +135,25 @@ bool routing::add_route(int input_vif, const addr_storage& g_addr, const addr_st
         return false;
     }
 
-    if (!m_mrt_sock->add_mroute(input_vif, src_addr, g_addr, output_vif)) {
-        return false;
+    std::vector<int> output_vifs(std::begin(output_vif), std::end(output_vif));
+    std::sort(std::begin(output_vifs), std::end(output_vifs));
+
+    auto key = std::make_pair(mc_addr(g_addr), mc_addr(src_addr));
+    auto mfc_it = m_mfc.find(key);
+    if (mfc_it != std::end(m_mfc) && mfc_it->second.m_input_vif == input_vif && mfc_it->second.m_output_vifs == output_vifs) {
+        HC_LOG_DEBUG("route (" << g_addr << ", " << src_addr << ") is up to date");
+        return true;
+    }
+
+    //the entry is forgotten by flush_routes() if the kernel refuses it
+    queue_route_change(key, true, mfc_it != std::end(m_mfc), input_vif, output_vif);
+
+    if (mfc_it != std::end(m_mfc)) {
+        mfc_it->second.m_input_vif = input_vif;
+        mfc_it->second.m_output_vifs = std::move(output_vifs);
+        mfc_it->second.m_version = m_route_version;
+    } else {
+        m_mfc.insert(std::make_pair(key, mfc_entry {input_vif, std::move(output_vifs), m_route_version}));
     }
 
     return true;
@@ -127,23 +163,214 @@ bool routing::del_route(int vif, const addr_storage& g_addr, const addr_storage&
 {
     HC_LOG_TRACE("");
 
-    if (!m_mrt_sock->del_mroute(vif, src_addr, g_addr)) {
+    auto mfc_it = m_mfc.find(std::make_pair(mc_addr(g_addr), mc_addr(src_addr)));
+    if (mfc_it == std::end(m_mfc)) {
+        HC_LOG_DEBUG("route (" << g_addr << ", " << src_addr << ") is not installed");
+        return true;
+    }
+
+    queue_route_change(mfc_it->first, false, true, vif, std::list<int>());
+    m_mfc.erase(mfc_it);
+    return true;
+}
+
+void routing::queue_route_change(const std::pair<mc_addr, mc_addr>& key, bool add, bool installed, int input_vif, const std::list<int>& output_vif) const
+{
+    HC_LOG_TRACE("");
+
+    ++m_route_version;
+
+    auto rc = m_queued_changes.insert(std::make_pair(key, route_change {add, input_vif, output_vif, m_route_version, std::chrono::steady_clock::now(), !installed, metrics::get_origin()}));
+    if (!rc.second) { //only the latest change is applied, the time of the first one is kept
+        rc.first->second.m_origin = metrics::earliest_origin(rc.first->second.m_origin, metrics::get_origin());
+
+        if (!add && rc.first->second.m_new_route) {
+            m_queued_changes.erase(rc.first);
+            return;
+        }
+
+        rc.first->second.m_add = add;
+        rc.first->second.m_input_vif = input_vif;
+        rc.first->second.m_output_vif = output_vif;
+        rc.first->second.m_version = m_route_version;
+    }
+}
+
+bool routing::bind_pending_vifs() const
+{
+    HC_LOG_TRACE("");
+
+    if (m_pending_table_binds.empty()) {
+        return true;
+    }
+
+    //the interfaces that could not be bound stay queued for the next flush
+    std::size_t count = m_pending_table_binds.size();
+    if (!m_mrt_sock->bind_vifs_to_table(m_pending_table_binds, m_table_number)) {
+        HC_LOG_ERROR("failed to bind " << m_pending_table_binds.size() << " of " << count << " interfaces to table " << m_table_number << ", they are bound again with the next flush");
         return false;
     }
 
     return true;
 }
 
+bool routing::flush_routes() const
+{
+    HC_LOG_TRACE("");
+
+    //the routes of this flush may use the new virtual interfaces
+    bool bound = bind_pending_vifs();
+    return hand_over_routes() && bound;
+}
+
+bool routing::hand_over_routes() const
+{
+    HC_LOG_TRACE("");
+
+    std::vector<std::pair<std::pair<mc_addr, mc_addr>, unsigned long long>> failed;
+
+    {
+        std::lock_guard<std::mutex> lock(m_writer_lock);
+        failed.swap(m_failed_changes);
+
+        if (!m_queued_changes.empty()) {
+            if (m_pending_changes.empty()) {
+                m_pending_changes.swap(m_queued_changes);
+            } else { //the route writer is still busy with an earlier flush, coalesce with its pending changes
+                for (auto & e : m_queued_changes) {
+                    auto rc = m_pending_changes.insert(e);
+                    if (!rc.second) {
+                        if (!e.second.m_add && rc.first->second.m_new_route) {
+                            m_pending_changes.erase(rc.first);
+                            continue;
+                        }
+
+                        auto time = rc.first->second.m_time;
+                        auto new_route = rc.first->second.m_new_route;
+                        auto origin = metrics::earliest_origin(rc.first->second.m_origin, e.second.m_origin);
+                        rc.first->second = std::move(e.second);
+                        rc.first->second.m_time = time;
+                        rc.first->second.m_new_route = new_route;
+                        rc.first->second.m_origin = origin;
+                    }
+                }
+                m_queued_changes.clear();
+            }
+
+            m_writer_cond.notify_one();
+        }
+    }
+
+    //the state of the kernel entries is unknown, set them again next time if they have not been changed since
+    for (auto & e : failed) {
+        auto mfc_it = m_mfc.find(e.first);
+        if (mfc_it != std::end(m_mfc) && mfc_it->second.m_version == e.second) {
+            m_mfc.erase(mfc_it);
+        }
+    }
+
+    return failed.empty();
+}
+
+void routing::wait_for_routes() const
+{
+    HC_LOG_TRACE("");
+
+    std::unique_lock<std::mutex> lock(m_writer_lock);
+    m_writer_idle_cond.wait(lock, [this]() {
+        return m_pending_changes.empty() && !m_writer_busy;
+    });
+}
+
+void routing::writer_thread()
+{
+    HC_LOG_TRACE("");
+
+    std::unique_lock<std::mutex> lock(m_writer_lock);
+
+    while (true) {
+        m_writer_cond.wait(lock, [this]() {
+            return m_writer_stop || !m_pending_changes.empty();
+        });
+
+        if (m_pending_changes.empty()) { //stopped
+            break;
+        }
+
+        route_change_map changes;
+        changes.swap(m_pending_changes);
+        m_writer_busy = true;
+
+        lock.unlock();
+        auto failed = apply_route_changes(changes);
+        lock.lock();
+
+        for (auto & e : failed) {
+            m_failed_changes.push_back(std::make_pair(e, changes[e].m_version));
+        }
+
+        m_writer_busy = false;
+        m_writer_idle_cond.notify_all();
+    }
+
+    HC_LOG_DEBUG("route writer thread end");
+}
+
+std::set<std::pair<mc_addr, mc_addr>> routing::apply_route_changes(const route_change_map& changes)
+{
+    HC_LOG_TRACE("");
+
+    for (auto & e : changes) {
+        if (e.second.m_add) {
+            MCPROXY_PROBE(route_add, e.second.m_input_vif, &e.first.first, &e.first.second, probe_vif_mask(e.second.m_output_vif));
+            m_mrt_sock->queue_add_mroute(e.second.m_input_vif, e.first.second, e.first.first, e.second.m_output_vif);
+        } else {
+            MCPROXY_PROBE(route_del, e.second.m_input_vif, &e.first.first, &e.first.second);
+            m_mrt_sock->queue_del_mroute(e.second.m_input_vif, e.first.second, e.first.first);
+        }
+    }
+
+    std::list<std::pair<mc_addr, mc_addr>> failed;
+    m_mrt_sock->flush_mroutes(failed);
+
+    std::set<std::pair<mc_addr, mc_addr>> result(std::begin(failed), std::end(failed));
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto & e : changes) {
+        metrics::add(e.second.m_add ? METRIC_ROUTES_ADDED : METRIC_ROUTES_DELETED);
+        if (e.second.m_add && e.second.m_origin != std::chrono::steady_clock::time_point() && result.find(e.first) == std::end(result)) {
+            metrics::add_latency(LATENCY_KERNEL, now - e.second.m_origin);
+        }
+    }
+    metrics::add(METRIC_ROUTES_FAILED, result.size());
+
+    if (m_route_callback) {
+        for (auto & e : changes) {
+            m_route_callback(e.first.first, e.first.second, e.second.m_add, result.find(e.first) == std::end(result), now - e.second.m_time);
+        }
+    }
+
+    return result;
+}
+
 bool routing::del_vif(int if_index, int vif) const
 {
     HC_LOG_TRACE("");
 
+    //the queued routes refer to the current virtual interfaces
+    hand_over_routes();
+    wait_for_routes();
+
     if (!m_mrt_sock->del_vif(vif)) {
         return false;
     }
 
     if (m_table_number > 0) {
-        if (!m_mrt_sock->unbind_vif_form_table(if_index, m_table_number)) {
+        //an interface that is not bound yet is only forgotten
+        auto it = std::find(std::begin(m_pending_table_binds), std::end(m_pending_table_binds), static_cast<uint32_t>(if_index));
+        if (it != std::end(m_pending_table_binds)) {
+            m_pending_table_binds.erase(it);
+        } else if (!m_mrt_sock->unbind_vif_form_table(if_index, m_table_number)) {
             return false;
         }
     }
@@ -161,8 +388,20 @@ routing::~routing()
 {
     HC_LOG_TRACE("");
 
-    //clean up all added interfaces
-    for (auto e : m_added_ifs) {
+    //clean up all added interfaces, del_vif() erases them from m_added_ifs
+    auto added_ifs = m_added_ifs;
+    for (auto e : added_ifs) {
         del_vif(e, m_interfaces->get_virtual_if_index(e));
     }
+
+    flush_routes();
+    wait_for_routes();
+
+    {
+        std::lock_guard<std::mutex> lock(m_writer_lock);
+        m_writer_stop = true;
+        m_writer_cond.notify_one();
+    }
+
+    m_writer->join();
 }
@@ -0,0 +1,499 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/scale_suite.hpp"
+#include "include/proxy/querier.hpp"
+#include "include/proxy/recording_sender.hpp"
+#include "include/proxy/interfaces.hpp"
+#include "include/proxy/timing.hpp"
+#include "include/proxy/message_format.hpp"
+#include "include/utils/mroute_socket.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+namespace
+{
+//peak resident set size of the process in kB
+long get_peak_rss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+//a record after a wait in seconds
+struct scripted_record {
+    unsigned int wait;
+    mcast_addr_record_type record_type;
+    std::vector<unsigned int> sources;
+    group_mem_protocol version;
+};
+
+//scenarios of the former querier tests, with the sources 1.1.1.1 to 7.7.7.7 numbered 1 to 7
+struct scripted_scenario {
+    std::string name;
+    std::vector<scripted_record> records;
+    unsigned int final_wait;
+};
+
+const std::vector<scripted_scenario> scripted_scenarios = {
+    {
+        "A", {
+            {0, MODE_IS_INCLUDE, {1, 2, 3, 4, 5}, IGMPv3},
+            {4, MODE_IS_INCLUDE, {1, 3, 5}, IGMPv3},
+            {5, MODE_IS_INCLUDE, {1, 3, 5}, IGMPv3},
+            {3, MODE_IS_EXCLUDE, {1, 2, 3}, IGMPv3},
+            {5, MODE_IS_INCLUDE, {1, 2}, IGMPv3},
+            {1, MODE_IS_EXCLUDE, {6, 7}, IGMPv3},
+            {1, MODE_IS_EXCLUDE, {6, 7}, IGMPv3}
+        }, 13
+    }, {
+        "B", {
+            {1, ALLOW_NEW_SOURCES, {1, 2, 3}, IGMPv3},
+            {1, BLOCK_OLD_SOURCES, {2}, IGMPv3}
+        }, 13
+    }, {
+        "C", {
+            {1, ALLOW_NEW_SOURCES, {1, 2, 3, 4}, IGMPv3},
+            {1, CHANGE_TO_EXCLUDE_MODE, {3, 4, 5, 6}, IGMPv3},
+            {1, ALLOW_NEW_SOURCES, {7}, IGMPv3},
+            {1, ALLOW_NEW_SOURCES, {6}, IGMPv3}
+        }, 13
+    }, {
+        "D", {
+            {1, ALLOW_NEW_SOURCES, {1, 2}, IGMPv3},
+            {2, MODE_IS_EXCLUDE, {2, 3}, IGMPv3},
+            {2, BLOCK_OLD_SOURCES, {2, 7}, IGMPv3},
+            {2, CHANGE_TO_INCLUDE_MODE, {1, 2}, IGMPv3},
+            {4, CHANGE_TO_EXCLUDE_MODE, {1, 7}, IGMPv3}
+        }, 13
+    }, {
+        "backward compatibility", {
+            {1, ALLOW_NEW_SOURCES, {1, 2}, IGMPv3},
+            {2, ALLOW_NEW_SOURCES, {3, 2}, IGMPv3},
+            {2, ALLOW_NEW_SOURCES, {4, 2}, IGMPv2},
+            {2, ALLOW_NEW_SOURCES, {5, 2}, IGMPv3},
+            {2, ALLOW_NEW_SOURCES, {6, 2}, IGMPv3},
+            {2, ALLOW_NEW_SOURCES, {7, 2}, IGMPv2}
+        }, 51
+    }
+};
+
+const std::vector<mcast_addr_record_type> record_types {MODE_IS_INCLUDE, MODE_IS_EXCLUDE, CHANGE_TO_INCLUDE_MODE, CHANGE_TO_EXCLUDE_MODE, ALLOW_NEW_SOURCES, BLOCK_OLD_SOURCES};
+
+group_mem_protocol get_older_version(group_mem_protocol gmp)
+{
+    return is_IPv4(gmp) ? IGMPv2 : MLDv1;
+}
+}
+
+scale_suite::scale_suite(const scale_suite_settings& settings)
+    : m_settings(settings)
+    , m_addr_family(get_addr_family(settings.version))
+    , m_rand(settings.seed)
+    , m_records(0)
+    , m_timers(0)
+    , m_state_changes(0)
+    , m_run_time(0)
+{
+    HC_LOG_TRACE("");
+
+    m_timing = std::make_shared<timing>(true);
+    m_sender = std::make_shared<recording_sender>(std::make_shared<interfaces>(m_addr_family, false), settings.version);
+    m_start = timer_clock::now();
+}
+
+scale_suite::~scale_suite()
+{
+    HC_LOG_TRACE("");
+    m_queriers.clear();
+}
+
+mc_addr scale_suite::get_group_addr(unsigned int group) const
+{
+    HC_LOG_TRACE("");
+
+    //232.1.0.0 and ff0e::1:0 upwards
+    if (m_addr_family == AF_INET) {
+        in_addr addr;
+        addr.s_addr = htonl(0xe8010000 + group);
+        return mc_addr(addr_storage(addr));
+    } else {
+        in6_addr addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.s6_addr[0] = 0xff;
+        addr.s6_addr[1] = 0x0e;
+        uint32_t low = htonl(0x00010000 + group);
+        memcpy(&addr.s6_addr[12], &low, sizeof(low));
+        return mc_addr(addr_storage(addr));
+    }
+}
+
+addr_storage scale_suite::get_source_addr(unsigned int source) const
+{
+    HC_LOG_TRACE("");
+
+    //10.0.0.0 and 2001:db8:: upwards
+    if (m_addr_family == AF_INET) {
+        in_addr addr;
+        addr.s_addr = htonl(0x0a000000 + source);
+        return addr_storage(addr);
+    } else {
+        in6_addr addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.s6_addr[0] = 0x20;
+        addr.s6_addr[1] = 0x01;
+        addr.s6_addr[2] = 0x0d;
+        addr.s6_addr[3] = 0xb8;
+        uint32_t low = htonl(source);
+        memcpy(&addr.s6_addr[12], &low, sizeof(low));
+        return addr_storage(addr);
+    }
+}
+
+void scale_suite::create_queriers(unsigned int count)
+{
+    HC_LOG_TRACE("");
+
+    m_queriers.clear();
+    m_timing->stop_all_time(nullptr); //the timers of the removed queriers
+
+    auto cb_state_change = [this](unsigned int, const mc_addr&) {
+        ++m_state_changes;
+    };
+
+    for (unsigned int i = 1; i <= count; ++i) {
+        m_queriers.emplace_back(new querier(nullptr, m_settings.version, i, m_sender, m_timing, m_timers_values, cb_state_change));
+    }
+}
+
+void scale_suite::send_record(unsigned int if_index, const mc_addr& gaddr, mcast_addr_record_type record_type, source_list<source>&& slist, group_mem_protocol gmp)
+{
+    HC_LOG_TRACE("");
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto& q = m_queriers[if_index - 1];
+    q->receive_record(make_pooled_msg<group_record_msg>(if_index, record_type, gaddr, std::move(slist), gmp));
+    q->flush_queries();
+
+    m_run_time += std::chrono::steady_clock::now() - start;
+    ++m_records;
+}
+
+void scale_suite::wait(std::chrono::milliseconds duration)
+{
+    HC_LOG_TRACE("");
+
+    auto start = std::chrono::steady_clock::now();
+    timing_db_key until = timer_clock::now() + duration;
+    timing_wheel_bucket expired;
+
+    while (m_timing->advance(until, expired)) {
+        for (auto & e : expired) {
+            //the queriers detect outdated timers by their reference count
+            std::shared_ptr<proxy_msg> msg = std::move(std::get<1>(e.m_value));
+            (*msg.get())();
+
+            unsigned int if_index = std::static_pointer_cast<timer_msg>(msg)->get_if_index();
+            if (if_index == 0 || if_index > m_queriers.size()) {
+                HC_LOG_ERROR("timer of an unknown downstream: " << if_index);
+                continue;
+            }
+
+            m_queriers[if_index - 1]->timer_triggerd(msg);
+            ++m_timers;
+        }
+        expired.clear();
+
+        for (auto & q : m_queriers) {
+            q->flush_queries();
+        }
+    }
+
+    m_run_time += std::chrono::steady_clock::now() - start;
+}
+
+uint64_t scale_suite::get_digest() const
+{
+    HC_LOG_TRACE("");
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (auto & q : m_queriers) {
+        for (char c : q->to_string()) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+std::size_t scale_suite::get_group_count() const
+{
+    HC_LOG_TRACE("");
+
+    std::size_t count = 0;
+    for (auto & q : m_queriers) {
+        count += q->get_snapshot()->groups.size();
+    }
+    return count;
+}
+
+uint64_t scale_suite::run_scripted_scenarios()
+{
+    HC_LOG_TRACE("");
+
+    //short intervals to let the timers of the scenarios expire
+    m_timers_values.set_query_interval(std::chrono::seconds(10));
+    m_timers_values.set_startup_query_interval(std::chrono::seconds(10));
+    m_timers_values.set_startup_query_count(4);
+    m_timers_values.set_query_response_interval(std::chrono::seconds(4));
+
+    mc_addr gaddr = get_group_addr(0);
+    uint64_t digest = FNV_OFFSET_BASIS;
+
+    //the scenarios are written for IGMP, MLD runs them with the corresponding versions
+    for (auto & scenario : scripted_scenarios) {
+        create_queriers(1);
+
+        uint64_t scenario_digest = get_digest();
+        auto add_digest = [&]() {
+            scenario_digest = (scenario_digest ^ get_digest()) * FNV_PRIME;
+        };
+
+        for (auto & r : scenario.records) {
+            wait(std::chrono::seconds(r.wait));
+            source_list<source> slist;
+            for (auto s : r.sources) {
+                slist.insert(source(get_source_addr(s)));
+            }
+            send_record(1, gaddr, r.record_type, std::move(slist), r.version == IGMPv3 ? m_settings.version : get_older_version(m_settings.version));
+            add_digest();
+        }
+
+        //the state after each second of the final wait
+        for (unsigned int i = 0; i < scenario.final_wait; ++i) {
+            wait(std::chrono::seconds(1));
+            add_digest();
+        }
+
+        std::cout << "scenario " << scenario.name << ": digest " << std::hex << std::setw(16) << std::setfill('0') << scenario_digest << std::dec << std::setfill(' ') << std::endl;
+        digest = (digest ^ scenario_digest) * FNV_PRIME;
+    }
+
+    m_timers_values = timers_values();
+    return digest;
+}
+
+uint64_t scale_suite::run_random_rounds()
+{
+    HC_LOG_TRACE("");
+
+    create_queriers(m_settings.downstreams);
+
+    std::vector<mc_addr> groups;
+    for (unsigned int g = 0; g < m_settings.groups; ++g) {
+        groups.push_back(get_group_addr(g));
+    }
+
+    std::vector<source> sources;
+    for (unsigned int s = 1; s <= m_settings.sources; ++s) {
+        sources.push_back(source(get_source_addr(s)));
+    }
+
+    std::uniform_int_distribution<unsigned int> d_record_type(0, record_types.size() - 1);
+    std::uniform_int_distribution<unsigned int> d_source(0, std::max(m_settings.sources, 1U) - 1);
+    std::uniform_int_distribution<unsigned int> d_older_version(0, SCALE_SUITE_OLDER_VERSION_RATE - 1);
+
+    //the records of a round reach the downstreams and groups in a random order
+    std::vector<std::pair<unsigned int, unsigned int>> order;
+    for (unsigned int d = 1; d <= m_settings.downstreams; ++d) {
+        for (unsigned int g = 0; g < m_settings.groups; ++g) {
+            order.push_back(std::make_pair(d, g));
+        }
+    }
+
+    uint64_t digest = FNV_OFFSET_BASIS;
+    std::size_t max_groups = 0;
+
+    for (unsigned int round = 0; round < m_settings.rounds; ++round) {
+        std::shuffle(order.begin(), order.end(), m_rand);
+
+        auto step = m_settings.round_interval / std::max<std::size_t>(order.size(), 1);
+        auto rest = m_settings.round_interval - step * order.size();
+
+        for (auto & e : order) {
+            //like the former random test, an older host joins now and then
+            if (d_older_version(m_rand) == 0) {
+                send_record(e.first, groups[e.second], d_older_version(m_rand) % 2 == 0 ? MODE_IS_EXCLUDE : CHANGE_TO_EXCLUDE_MODE, source_list<source>(), get_older_version(m_settings.version));
+            } else {
+                source_list<source> slist;
+                if (m_settings.sources > 0) {
+                    unsigned int count = d_source(m_rand) + 1;
+                    for (unsigned int i = 0; i < count; ++i) {
+                        slist.insert(sources[d_source(m_rand)]);
+                    }
+                }
+                send_record(e.first, groups[e.second], record_types[d_record_type(m_rand)], std::move(slist), m_settings.version);
+            }
+
+            wait(step);
+        }
+        wait(rest);
+
+        std::size_t group_count = get_group_count();
+        max_groups = std::max(max_groups, group_count);
+        uint64_t round_digest = get_digest();
+        std::cout << "round " << round + 1 << ": groups " << group_count << ", digest " << std::hex << std::setw(16) << std::setfill('0') << round_digest << std::dec << std::setfill(' ') << std::endl;
+        digest = (digest ^ round_digest) * FNV_PRIME;
+    }
+
+    //without further records all memberships expire
+    wait(m_timers_values.get_multicast_address_listening_interval() + m_timers_values.get_query_interval());
+    std::size_t remaining = get_group_count();
+    std::cout << "groups after the listening interval: " << remaining << (remaining > 0 ? " (expected 0)" : "") << std::endl;
+    digest = (digest ^ get_digest()) * FNV_PRIME;
+
+    std::cout << "groups at most: " << max_groups << " of " << static_cast<unsigned long long>(m_settings.groups) * m_settings.downstreams << std::endl;
+    return digest;
+}
+
+bool scale_suite::parse_settings(const std::string& arg, scale_suite_settings& settings)
+{
+    HC_LOG_TRACE("");
+
+    std::istringstream list(arg);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+
+        auto pos = item.find('=');
+        if (pos == std::string::npos) {
+            HC_LOG_ERROR("scale suite setting without value: " << item);
+            return false;
+        }
+
+        std::string key = item.substr(0, pos);
+        std::string value = item.substr(pos + 1);
+
+        if (key == "protocol") {
+            if (value == "IGMPv3") {
+                settings.version = IGMPv3;
+            } else if (value == "MLDv2") {
+                settings.version = MLDv2;
+            } else {
+                HC_LOG_ERROR("scale suite protocol has to be IGMPv3 or MLDv2: " << value);
+                return false;
+            }
+            continue;
+        }
+
+        unsigned long number;
+        try {
+            std::size_t end;
+            number = std::stoul(value, &end);
+            if (end != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::exception&) {
+            HC_LOG_ERROR("scale suite setting " << key << " is not a number: " << value);
+            return false;
+        }
+
+        if (key == "groups") {
+            settings.groups = number;
+        } else if (key == "sources") {
+            settings.sources = number;
+        } else if (key == "downstreams") {
+            settings.downstreams = number;
+        } else if (key == "rounds") {
+            settings.rounds = number;
+        } else if (key == "interval") {
+            settings.round_interval = std::chrono::milliseconds(number);
+        } else if (key == "seed") {
+            settings.seed = number;
+        } else {
+            HC_LOG_ERROR("unknown scale suite setting: " << key);
+            return false;
+        }
+    }
+
+    if (settings.groups == 0 || settings.downstreams == 0) {
+        HC_LOG_ERROR("scale suite needs at least one group and one downstream");
+        return false;
+    }
+
+    return true;
+}
+
+void scale_suite::run(const scale_suite_settings& settings)
+{
+    HC_LOG_TRACE("");
+
+    scale_suite s(settings);
+
+    std::cout << "scale suite: " << get_group_mem_protocol_name(settings.version) << ", " << settings.groups << " groups x " << settings.sources << " sources x " << settings.downstreams << " downstreams, " << settings.rounds << " rounds of " << settings.round_interval.count() << " msec, seed " << settings.seed << std::endl;
+
+    //the queriers send their reports without the raw socket, check the checksum kernels of the sender here
+    std::cout << "checksum kernels: " << (mroute_socket::test_checksum() ? "ok" : "FAILED") << std::endl;
+
+    uint64_t scripted_digest = s.run_scripted_scenarios();
+
+    long start_rss = get_peak_rss();
+    unsigned long long scripted_records = s.m_records;
+    unsigned long long scripted_timers = s.m_timers;
+    s.m_run_time = std::chrono::steady_clock::duration(0);
+    auto scripted_end = timer_clock::now();
+
+    uint64_t random_digest = s.run_random_rounds();
+
+    unsigned long long records = s.m_records - scripted_records;
+    unsigned long long timers = s.m_timers - scripted_timers;
+    double virtual_sec = std::chrono::duration_cast<std::chrono::milliseconds>(timer_clock::now() - scripted_end).count() / 1000.0;
+    double run_sec = std::chrono::duration_cast<std::chrono::microseconds>(s.m_run_time).count() / 1000000.0;
+
+    std::cout << "records: " << records << ", expired timers: " << timers << ", state changes: " << s.m_state_changes << std::endl;
+    std::cout << "sender calls: records: " << s.m_sender->m_records << ", general queries: " << s.m_sender->m_general_queries << ", group specific queries: " << s.m_sender->m_group_queries << ", group and source specific queries: " << s.m_sender->m_source_queries << std::endl;
+    std::cout << "virtual duration: " << virtual_sec << " sec, run duration: " << run_sec << " sec";
+    if (run_sec > 0) {
+        std::cout << " (" << static_cast<unsigned long long>(virtual_sec / run_sec) << " times faster than real time)" << std::endl;
+        std::cout << "throughput: " << static_cast<unsigned long long>(records / run_sec) << " records/sec, " << static_cast<unsigned long long>(timers / run_sec) << " timers/sec, mean time per record and timer: " << run_sec * 1000000000.0 / std::max(records + timers, 1ULL) << " nsec";
+    }
+    std::cout << std::endl;
+    std::cout << "peak memory: " << get_peak_rss() << " kB (" << start_rss << " kB before the rounds)" << std::endl;
+    std::cout << "digest: scripted scenarios " << std::hex << std::setw(16) << std::setfill('0') << scripted_digest << ", random rounds " << std::setw(16) << random_digest << std::dec << std::setfill(' ') << std::endl;
+}
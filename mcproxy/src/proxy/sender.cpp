@@ -25,14 +25,30 @@
 #include "include/proxy/sender.hpp"
 #include "include/proxy/message_format.hpp" //source
 #include "include/proxy/timers_values.hpp"
+#include "include/utils/metrics.hpp"
 
 #include <iostream>
-sender::sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp)
+#include <cstring>
+#include <algorithm>
+#include <netinet/in.h>
+#include <sys/socket.h>
+sender::sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp, bool native_reports)
+    : sender(interfaces, gmp, native_reports, true)
+{
+    HC_LOG_TRACE("");
+}
+
+sender::sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_protocol gmp, bool native_reports, bool open_socket)
     : m_group_mem_protocol(gmp)
     , m_interfaces(interfaces)
+    , m_native_reports(native_reports)
 {
     HC_LOG_TRACE("");
 
+    if (!open_socket) {
+        return;
+    }
+
     if (is_IPv4(m_group_mem_protocol)) {
         if (!m_sock.create_raw_ipv4_socket()) {
             throw "failed to create raw ipv4 socket";
@@ -51,6 +67,30 @@ sender::sender(const std::shared_ptr<const interfaces>& interfaces, group_mem_pr
     }
 }
 
+unsigned int sender::get_mtu(unsigned int if_index) const
+{
+    HC_LOG_TRACE("");
+
+    unsigned int mtu;
+    if (!m_sock.get_mtu(if_index, mtu)) {
+        mtu = SENDER_DEFAULT_MTU;
+    }
+
+    return mtu;
+}
+
+unsigned int sender::get_max_sources(unsigned int if_index, unsigned int header_size, unsigned int addr_size) const
+{
+    HC_LOG_TRACE("");
+
+    unsigned int mtu = get_mtu(if_index);
+    if (mtu <= header_size + addr_size) {
+        mtu = SENDER_DEFAULT_MTU;
+    }
+
+    return (mtu - header_size) / addr_size;
+}
+
 #ifdef DEBUG_MODE
 bool sender::send_record(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const
 {
@@ -158,6 +198,426 @@ bool sender::send_mc_addr_and_src_specific_query(unsigned int, const timers_valu
 
 #endif /* DEBUG_MODE */
 
+void sender::queue_packet(unsigned int if_index, const addr_storage& dst, std::vector<unsigned char>&& data) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_send_lock);
+    m_pending_packets.push_back(pending_packet {if_index, dst, std::move(data)});
+}
+
+bool sender::flush_packets() const
+{
+    HC_LOG_TRACE("");
+
+    std::vector<report_record> records;
+    {
+        std::lock_guard<std::mutex> lock(m_send_lock);
+        records.swap(m_pending_records);
+    }
+
+    if (!records.empty()) {
+        queue_reports(records);
+    }
+
+    std::vector<pending_packet> packets;
+    {
+        std::lock_guard<std::mutex> lock(m_send_lock);
+        packets.swap(m_pending_packets);
+    }
+
+    if (packets.empty()) {
+        return true;
+    }
+
+    union control_buffer {
+        cmsghdr m_align;
+        unsigned char m_buf[CMSG_SPACE(sizeof(in6_pktinfo))];
+    };
+
+    std::vector<mmsghdr> msgs(packets.size());
+    std::vector<iovec> iovs(packets.size());
+    std::vector<control_buffer> controls(packets.size());
+    bool ipv4 = is_IPv4(m_group_mem_protocol);
+
+    for (unsigned int i = 0; i < packets.size(); ++i) {
+        pending_packet& p = packets[i];
+        iovs[i].iov_base = p.m_data.data();
+        iovs[i].iov_len = p.m_data.size();
+
+        msghdr& m = msgs[i].msg_hdr;
+        memset(&m, 0, sizeof(m));
+        m.msg_name = const_cast<sockaddr*>(&p.m_dst.get_sockaddr());
+        m.msg_namelen = p.m_dst.get_addr_len();
+        m.msg_iov = &iovs[i];
+        m.msg_iovlen = 1;
+        m.msg_control = controls[i].m_buf;
+
+        //the outgoing interface of each packet, saves a setsockopt per packet
+        memset(controls[i].m_buf, 0, sizeof(controls[i].m_buf));
+        if (ipv4) {
+            m.msg_controllen = CMSG_SPACE(sizeof(in_pktinfo));
+            cmsghdr* c = CMSG_FIRSTHDR(&m);
+            c->cmsg_level = IPPROTO_IP;
+            c->cmsg_type = IP_PKTINFO;
+            c->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+            reinterpret_cast<in_pktinfo*>(CMSG_DATA(c))->ipi_ifindex = p.m_if_index;
+        } else {
+            m.msg_controllen = CMSG_SPACE(sizeof(in6_pktinfo));
+            cmsghdr* c = CMSG_FIRSTHDR(&m);
+            c->cmsg_level = IPPROTO_IPV6;
+            c->cmsg_type = IPV6_PKTINFO;
+            c->cmsg_len = CMSG_LEN(sizeof(in6_pktinfo));
+            reinterpret_cast<in6_pktinfo*>(CMSG_DATA(c))->ipi6_ifindex = p.m_if_index;
+        }
+    }
+
+    bool rc = true;
+    unsigned int i = 0;
+    while (i < msgs.size()) {
+        int sent;
+        unsigned int n = std::min<unsigned int>(msgs.size() - i, SENDER_MAX_BATCH);
+        if (!m_sock.send_mmsg(&msgs[i], n, sent) || sent == 0) {
+            //skip the packet that failed
+            HC_LOG_ERROR("failed to send a packet on interface " << interfaces::get_if_name(packets[i].m_if_index) << " to " << packets[i].m_dst);
+            metrics::add(METRIC_SEND_FAILURES, 1, packets[i].m_if_index);
+            rc = false;
+            i++;
+        } else {
+            for (int j = 0; j < sent; ++j) {
+                metrics::add(METRIC_PACKETS_SENT, 1, packets[i + j].m_if_index);
+            }
+            i += sent;
+        }
+    }
+
+    return rc;
+}
+
+bool sender::set_socket_filter(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const
+{
+    HC_LOG_TRACE("");
+
+    if (filter_mode != INCLUDE_MODE && filter_mode != EXCLUDE_MODE) {
+        HC_LOG_ERROR("unknown filter mode");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+    auto key = std::make_pair(if_index, gaddr);
+    auto it = m_socket_filters.find(key);
+
+    if (filter_mode == INCLUDE_MODE && slist.empty()) {
+        if (it != std::end(m_socket_filters)) {
+            m_sock.leave_group(gaddr, if_index);
+            m_socket_filters.erase(it);
+        }
+        return true;
+    }
+
+    source_list<source> new_slist;
+    for (auto & e : slist) {
+        new_slist.insert(source(e.saddr));
+    }
+
+    if (it != std::end(m_socket_filters) && it->second.first == filter_mode && it->second.second == new_slist) {
+        return true;
+    }
+
+    bool rc;
+    if (it != std::end(m_socket_filters) && it->second.first == filter_mode) {
+        rc = change_socket_filter(if_index, filter_mode, gaddr, it->second.second, new_slist);
+    } else {
+        rc = false;
+    }
+
+    if (!rc) {
+        //first join, changed filter mode or a failed delta, (re)write the whole filter
+        if (it == std::end(m_socket_filters)) {
+            m_sock.join_group(gaddr, if_index);
+        }
+
+        std::list<addr_storage> src_list;
+        for (auto & e : new_slist) {
+            src_list.push_back(e.saddr.get());
+        }
+
+        rc = m_sock.set_source_filter(if_index, gaddr, filter_mode, src_list);
+    }
+
+    if (rc) {
+        m_socket_filters[key] = std::make_pair(filter_mode, std::move(new_slist));
+    } else {
+        //unknown socket state, the next call rewrites the filter
+        m_socket_filters[key] = std::make_pair(filter_mode == INCLUDE_MODE ? EXCLUDE_MODE : INCLUDE_MODE, source_list<source>());
+    }
+
+    return rc;
+}
+
+bool sender::change_socket_filter(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& from, const source_list<source>& to) const
+{
+    HC_LOG_TRACE("");
+
+    //add before remove, an INCLUDE filter must not become empty in between (this would leave the group)
+    for (auto & e : to - from) {
+        bool rc = filter_mode == INCLUDE_MODE ? m_sock.join_source_group(gaddr, e.saddr.get(), if_index) : m_sock.block_source(gaddr, e.saddr.get(), if_index);
+        if (!rc) {
+            return false;
+        }
+    }
+
+    for (auto & e : from - to) {
+        bool rc = filter_mode == INCLUDE_MODE ? m_sock.leave_source_group(gaddr, e.saddr.get(), if_index) : m_sock.unblock_source(gaddr, e.saddr.get(), if_index);
+        if (!rc) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool sender::has_native_reports() const
+{
+    HC_LOG_TRACE("");
+    return m_native_reports;
+}
+
+void sender::queue_record(unsigned int if_index, mcast_addr_record_type type, const addr_storage& gaddr, const source_list<source>& slist) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_send_lock);
+    m_pending_records.push_back(report_record {if_index, type, gaddr, slist});
+}
+
+bool sender::set_report_state(unsigned int if_index, mc_filter filter_mode, const addr_storage& gaddr, const source_list<source>& slist) const
+{
+    HC_LOG_TRACE("");
+
+    if (filter_mode != INCLUDE_MODE && filter_mode != EXCLUDE_MODE) {
+        HC_LOG_ERROR("unknown filter mode");
+        return false;
+    }
+
+    source_list<source> new_slist;
+    for (auto & e : slist) {
+        new_slist.insert(source(e.saddr));
+    }
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+    auto key = std::make_pair(if_index, gaddr);
+    auto it = m_socket_filters.find(key);
+
+    //a group without state is INCLUDE({})
+    const source_list<source> no_sources;
+    mc_filter old_mode = it != std::end(m_socket_filters) ? it->second.first : INCLUDE_MODE;
+    const source_list<source>& old_slist = it != std::end(m_socket_filters) ? it->second.second : no_sources;
+
+    if (old_mode == filter_mode && old_slist == new_slist) {
+        return true;
+    }
+
+    if (old_mode == filter_mode) {
+        //INCLUDE(A) -> INCLUDE(B): ALLOW(B-A), BLOCK(A-B); EXCLUDE(A) -> EXCLUDE(B): ALLOW(A-B), BLOCK(B-A)
+        source_list<source> allow = filter_mode == INCLUDE_MODE ? new_slist - old_slist : old_slist - new_slist;
+        source_list<source> block = filter_mode == INCLUDE_MODE ? old_slist - new_slist : new_slist - old_slist;
+
+        if (!allow.empty()) {
+            queue_record(if_index, ALLOW_NEW_SOURCES, gaddr, allow);
+        }
+
+        if (!block.empty()) {
+            queue_record(if_index, BLOCK_OLD_SOURCES, gaddr, block);
+        }
+    } else {
+        queue_record(if_index, filter_mode == INCLUDE_MODE ? CHANGE_TO_INCLUDE_MODE : CHANGE_TO_EXCLUDE_MODE, gaddr, new_slist);
+    }
+
+    if (filter_mode == INCLUDE_MODE && new_slist.empty()) {
+        if (it != std::end(m_socket_filters)) {
+            m_socket_filters.erase(it);
+        }
+    } else {
+        m_socket_filters[key] = std::make_pair(filter_mode, std::move(new_slist));
+    }
+
+    unsigned int robustness = timers_values().get_robustness_variable();
+    if (robustness > 1) {
+        m_retransmissions[key] = robustness - 1;
+    }
+
+    return true;
+}
+
+void sender::queue_current_state(const std::pair<unsigned int, addr_storage>& key, const std::pair<mc_filter, source_list<source>>& state) const
+{
+    HC_LOG_TRACE("");
+    queue_record(key.first, state.first == INCLUDE_MODE ? MODE_IS_INCLUDE : MODE_IS_EXCLUDE, key.second, state.second);
+}
+
+bool sender::send_current_state(unsigned int if_index, addr_storage& gaddr, unsigned int max_records) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+
+    auto it = m_socket_filters.upper_bound(std::make_pair(if_index, gaddr));
+    for (unsigned int i = 0; i < max_records && it != std::end(m_socket_filters) && it->first.first == if_index; ++i, ++it) {
+        queue_current_state(it->first, it->second);
+        gaddr = it->first.second;
+    }
+
+    return it != std::end(m_socket_filters) && it->first.first == if_index;
+}
+
+void sender::send_current_state(unsigned int if_index, const addr_storage& gaddr) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+
+    auto it = m_socket_filters.find(std::make_pair(if_index, gaddr));
+    if (it != std::end(m_socket_filters)) {
+        queue_current_state(it->first, it->second);
+    }
+}
+
+void sender::retransmit_state_changes() const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+
+    for (auto it = std::begin(m_retransmissions); it != std::end(m_retransmissions);) {
+        auto state = m_socket_filters.find(it->first);
+        if (state == std::end(m_socket_filters)) {
+            queue_record(it->first.first, CHANGE_TO_INCLUDE_MODE, it->first.second, source_list<source>());
+        } else {
+            queue_record(it->first.first, state->second.first == INCLUDE_MODE ? CHANGE_TO_INCLUDE_MODE : CHANGE_TO_EXCLUDE_MODE, it->first.second, state->second.second);
+        }
+
+        if (--it->second == 0) {
+            it = m_retransmissions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool sender::has_retransmissions() const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+    return !m_retransmissions.empty();
+}
+
+void sender::leave_all_groups(unsigned int if_index) const
+{
+    HC_LOG_TRACE("");
+
+    std::vector<addr_storage> groups;
+    {
+        std::lock_guard<std::mutex> lock(m_socket_filters_lock);
+        for (auto it = m_socket_filters.lower_bound(std::make_pair(if_index, addr_storage(get_addr_family(m_group_mem_protocol)))); it != std::end(m_socket_filters) && it->first.first == if_index; ++it) {
+            groups.push_back(it->first.second);
+        }
+    }
+
+    for (auto & e : groups) {
+        send_record(if_index, INCLUDE_MODE, e, source_list<source>());
+    }
+}
+
+void sender::queue_reports(std::vector<report_record>& records) const
+{
+    HC_LOG_TRACE("");
+
+    unsigned int header_size;
+    unsigned int record_size;
+    unsigned int addr_size;
+    get_report_sizes(header_size, record_size, addr_size);
+
+    //the records of an interface keep their order
+    std::stable_sort(std::begin(records), std::end(records), [](const report_record & l, const report_record & r) {
+        return l.m_if_index < r.m_if_index;
+    });
+
+    std::vector<report_record> report;
+    unsigned int if_index = 0;
+    unsigned int mtu = 0;
+    unsigned int size = 0;
+
+    for (auto & e : records) {
+        if (e.m_if_index != if_index) {
+            if (!report.empty()) {
+                queue_report(if_index, std::begin(report), std::end(report));
+                report.clear();
+            }
+
+            if_index = e.m_if_index;
+            mtu = get_mtu(if_index);
+            if (mtu < header_size + record_size + addr_size) {
+                mtu = SENDER_DEFAULT_MTU;
+            }
+            size = header_size;
+        }
+
+        //split records that do not fit into one report, the sources of an exclude record are truncated (RFC 3376 4.2.16)
+        unsigned int max_sources = (mtu - header_size - record_size) / addr_size;
+        std::vector<report_record> parts;
+        if (e.m_slist.size() <= max_sources) {
+            parts.push_back(std::move(e));
+        } else {
+            bool exclude = e.m_type == MODE_IS_EXCLUDE || e.m_type == CHANGE_TO_EXCLUDE_MODE;
+            if (exclude) {
+                HC_LOG_WARN("the source list of group " << e.m_gaddr << " exceeds the mtu of interface " << interfaces::get_if_name(if_index) << " and is truncated");
+            }
+
+            for (auto & s : e.m_slist) {
+                if (parts.empty() || parts.back().m_slist.size() == max_sources) {
+                    if (exclude && !parts.empty()) {
+                        break;
+                    }
+                    parts.push_back(report_record {if_index, e.m_type, e.m_gaddr, source_list<source>()});
+                }
+                parts.back().m_slist.insert(parts.back().m_slist.end(), s);
+            }
+        }
+
+        for (auto & p : parts) {
+            unsigned int p_size = record_size + p.m_slist.size() * addr_size;
+            if (!report.empty() && size + p_size > mtu) {
+                queue_report(if_index, std::begin(report), std::end(report));
+                report.clear();
+                size = header_size;
+            }
+
+            report.push_back(std::move(p));
+            size += p_size;
+        }
+    }
+
+    if (!report.empty()) {
+        queue_report(if_index, std::begin(report), std::end(report));
+    }
+}
+
+void sender::get_report_sizes(unsigned int& header_size, unsigned int& record_size, unsigned int& addr_size) const
+{
+    HC_LOG_TRACE("");
+    header_size = 0;
+    record_size = 0;
+    addr_size = 1;
+}
+
+void sender::queue_report(unsigned int, std::vector<report_record>::const_iterator, std::vector<report_record>::const_iterator) const
+{
+    HC_LOG_TRACE("");
+    HC_LOG_ERROR("native reports are not supported by this sender");
+}
+
 sender::~sender()
 {
     HC_LOG_TRACE("");
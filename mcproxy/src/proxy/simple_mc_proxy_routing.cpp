@@ -23,16 +23,19 @@
 #include "include/hamcast_logging.h"
 #include "include/proxy/simple_mc_proxy_routing.hpp"
 #include "include/proxy/interfaces.hpp"
-#include "include/utils/addr_storage.hpp"
+#include "include/utils/mc_addr.hpp"
 #include "include/proxy/proxy_instance.hpp"
 #include "include/proxy/querier.hpp"
 #include "include/proxy/routing.hpp"
 #include "include/proxy/interfaces.hpp"
 #include "include/proxy/sender.hpp"
 #include "include/proxy/timing.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/tracepoints.hpp"
 
 #include <algorithm>
 #include <memory>
+#include <cmath>
 
 //-------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------
@@ -58,14 +61,75 @@ std::string source_state::to_string() const
 }
 //-------------------------------------------------------------------------------
 //-------------------------------------------------------------------------------
-interface_memberships::interface_memberships(rb_rule_matching_type upstream_in_rule_matching_type, const addr_storage& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data)
+bool filter_cache::match(const interface& interf, rb_interface_direction interface_direction, unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
 {
     HC_LOG_TRACE("");
 
-    if (upstream_in_rule_matching_type == RMT_FIRST) {
-        process_upstream_in_first(gaddr, pi);
+    if (!interf.has_filter()) {
+        return true;
+    }
+
+    filter_key key {&interf, interface_direction, input_if_index, gaddr, saddr};
+    auto it = m_decisions.find(key);
+    if (it != std::end(m_decisions)) {
+        return it->second;
+    }
+
+    bool result;
+    if (interface_direction == ID_IN) {
+        result = interf.match_input_filter(input_if_index, gaddr, saddr);
     } else {
-        process_upstream_in_mutex(gaddr, pi, routing_data);
+        result = interf.match_output_filter(input_if_index, gaddr, saddr);
+    }
+
+    if (m_decisions.size() >= SIMPLE_MC_PROXY_ROUTING_FILTER_CACHE_SIZE) {
+        m_decisions.clear();
+    }
+
+    m_decisions.insert(std::make_pair(key, result));
+    return result;
+}
+
+void filter_cache::clear()
+{
+    HC_LOG_TRACE("");
+    m_decisions.clear();
+}
+//-------------------------------------------------------------------------------
+interface_memberships::interface_memberships(rb_rule_matching_type upstream_in_rule_matching_type, const mc_addr& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data, const filter_cache& filters)
+{
+    HC_LOG_TRACE("");
+
+    if (upstream_in_rule_matching_type == RMT_FIRST || upstream_in_rule_matching_type == RMT_HASH) {
+        std::vector<std::pair<unsigned int, const interface*>> upstreams;
+        for (auto & e : pi->m_upstreams) {
+            upstreams.push_back(std::make_pair(e.m_if_index, e.m_interface.get()));
+        }
+
+        if (upstream_in_rule_matching_type == RMT_FIRST) {
+            process_upstream_in_first(gaddr, pi, filters, upstreams);
+            return;
+        }
+
+        //the upstream with the highest score gets the group, the next ones the sources it filters
+        std::map<unsigned int, double> scores;
+        std::map<unsigned int, unsigned int> positions;
+        for (auto & e : upstreams) {
+            scores[e.first] = get_hash_score(e.first, e.second->get_weight(), gaddr, mc_addr());
+            positions.insert(std::make_pair(e.first, positions.size()));
+        }
+
+        std::stable_sort(upstreams.begin(), upstreams.end(), [&](const std::pair<unsigned int, const interface*>& l, const std::pair<unsigned int, const interface*>& r) {
+            return scores[l.first] > scores[r.first];
+        });
+        process_upstream_in_first(gaddr, pi, filters, upstreams);
+
+        //get_group_memberships() is called in the order of the upstreams
+        m_data.sort([&](const std::pair<unsigned int, std::list<source_state>>& l, const std::pair<unsigned int, std::list<source_state>>& r) {
+            return positions[l.first] < positions[r.first];
+        });
+    } else {
+        process_upstream_in_mutex(gaddr, pi, routing_data, filters);
     }
 }
 
@@ -95,17 +159,18 @@ void interface_memberships::merge_membership_infos(source_state& merge_to, const
     }
 }
 
-void interface_memberships::process_upstream_in_first(const addr_storage& gaddr, const proxy_instance* pi)
+void interface_memberships::process_upstream_in_first(const mc_addr& gaddr, const proxy_instance* pi, const filter_cache& filters, const std::vector<std::pair<unsigned int, const interface*>>& upstreams)
 {
     HC_LOG_TRACE("");
 
     state_list init_sstate_list;
     for (auto & downs_e : pi->m_downstreams) {
-        init_sstate_list.push_back(state_pair(source_state(downs_e.second.m_querier->get_group_membership_infos(gaddr)), downs_e.second.m_interface));
+        auto lock = pi->lock_querier(downs_e.first, gaddr);
+        init_sstate_list.push_back(state_pair(source_state(downs_e.second.m_queriers[pi->get_slice(gaddr)]->get_group_membership_infos(gaddr)), downs_e.second.m_interface));
     }
 
     //init and fill database
-    for (auto & upstr_e : pi->m_upstreams) {
+    for (auto & upstr_e : upstreams) {
 
         state_list tmp_sstate_list;
 
@@ -118,13 +183,13 @@ void interface_memberships::process_upstream_in_first(const addr_storage& gaddr,
             for (auto source_it = cs.first.m_source_list.begin(); source_it != cs.first.m_source_list.end();) {
 
                 //downstream out
-                if (!cs.second->match_output_filter(interfaces::get_if_name(upstr_e.m_if_index), gaddr, source_it->saddr)) {
+                if (!filters.match(*cs.second, ID_OUT, upstr_e.first, gaddr, source_it->saddr)) {
                     source_it = cs.first.m_source_list.erase(source_it);
                     continue;
                 }
 
                 //upstream in
-                if (!upstr_e.m_interface->match_input_filter(interfaces::get_if_name(upstr_e.m_if_index), gaddr, source_it->saddr)) {
+                if (!filters.match(*upstr_e.second, ID_IN, upstr_e.first, gaddr, source_it->saddr)) {
                     tmp_sstate.m_source_list.insert(*source_it);
                     source_it = cs.first.m_source_list.erase(source_it);
                     continue;
@@ -143,20 +208,21 @@ void interface_memberships::process_upstream_in_first(const addr_storage& gaddr,
         for (auto & e : init_sstate_list) {
             ret_source_list.push_back(std::move(e.first));
         }
-        m_data.push_back(std::pair<unsigned int, std::list<source_state>>(upstr_e.m_if_index, std::move(ret_source_list)));
+        m_data.push_back(std::pair<unsigned int, std::list<source_state>>(upstr_e.first, std::move(ret_source_list)));
         init_sstate_list = std::move(tmp_sstate_list);
     }
 
 }
 
-void interface_memberships::process_upstream_in_mutex(const addr_storage& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data)
+void interface_memberships::process_upstream_in_mutex(const mc_addr& gaddr, const proxy_instance* pi, const simple_routing_data& routing_data, const filter_cache& filters)
 {
     HC_LOG_TRACE("");
 
     state_list ref_sstate_list;
 
     for (auto & downs_e : pi->m_downstreams) {
-        ref_sstate_list.push_back(state_pair(source_state(downs_e.second.m_querier->get_group_membership_infos(gaddr)), downs_e.second.m_interface));
+        auto lock = pi->lock_querier(downs_e.first, gaddr);
+        ref_sstate_list.push_back(state_pair(source_state(downs_e.second.m_queriers[pi->get_slice(gaddr)]->get_group_membership_infos(gaddr)), downs_e.second.m_interface));
     }
     //print(ref_sstate_list);
 
@@ -175,18 +241,18 @@ void interface_memberships::process_upstream_in_mutex(const addr_storage& gaddr,
             for (auto source_it = cs_it->first.m_source_list.begin(); source_it != cs_it->first.m_source_list.end();) {
 
                 //downstream out
-                if (!cs_it->second->match_output_filter(interfaces::get_if_name(upstr_e.m_if_index), gaddr, source_it->saddr)) {
+                if (!filters.match(*cs_it->second, ID_OUT, upstr_e.m_if_index, gaddr, source_it->saddr)) {
                     ++source_it;
                     continue;
                 }
 
                 //upstream in
-                if (!upstr_e.m_interface->match_input_filter(interfaces::get_if_name(upstr_e.m_if_index), gaddr, source_it->saddr)) {
+                if (!filters.match(*upstr_e.m_interface, ID_IN, upstr_e.m_if_index, gaddr, source_it->saddr)) {
                     ++source_it;
                     continue;
                 }
 
-                const std::map<addr_storage, unsigned int>& available_sources = routing_data.get_interface_map(gaddr);
+                const std::map<mc_addr, unsigned int>& available_sources = routing_data.get_interface_map(gaddr);
                 auto av_src_it = available_sources.find(source_it->saddr);
                 if (av_src_it != available_sources.end()) {
 
@@ -238,6 +304,22 @@ void interface_memberships::process_upstream_in_mutex(const addr_storage& gaddr,
 
 }
 
+double interface_memberships::get_hash_score(unsigned int upstream_if_index, unsigned int weight, const mc_addr& gaddr, const mc_addr& saddr)
+{
+    HC_LOG_TRACE("");
+
+    uint32_t h = gaddr.hash() ^ (saddr.is_valid() ? saddr.hash() * 0x9e3779b1 : 0) ^ (upstream_if_index * 0x85ebca77);
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    //weight / -ln(u) with u uniform in (0, 1), the share of an upstream is proportional to its weight
+    double u = (h + 0.5) / 4294967296.0;
+    return weight / -std::log(u);
+}
+
 source_state interface_memberships::get_group_memberships(unsigned int upstream_if_index)
 {
     HC_LOG_TRACE("");
@@ -287,10 +369,22 @@ void interface_memberships::print(const state_list& sl)
 simple_mc_proxy_routing::simple_mc_proxy_routing(const proxy_instance* p)
     : routing_management(p)
     , m_data(p->m_group_mem_protocol, p->m_mrt_sock)
+    , m_snapshot_version(0)
+    , m_wildcard_routes_supported(p->m_mrt_sock->is_wildcard_mroute_supported())
+    , m_hot_membership(std::make_pair(EXCLUDE_MODE, source_list<source>()))
 {
     HC_LOG_TRACE("");
 }
 
+void simple_mc_proxy_routing::event_config_change()
+{
+    HC_LOG_TRACE("");
+
+    m_filter_cache.clear();
+    m_forwarding_cache.clear();
+    m_aggregates.clear();
+}
+
 std::chrono::seconds simple_mc_proxy_routing::get_source_life_time()
 {
     HC_LOG_TRACE("");
@@ -304,11 +398,10 @@ void simple_mc_proxy_routing::event_new_source(const std::shared_ptr<proxy_msg>&
     switch (msg->get_type()) {
     case proxy_msg::NEW_SOURCE_MSG: {
         auto sm = std::static_pointer_cast<new_source_msg>(msg);
-        source s(sm->get_saddr());
-        s.shared_source_timer = set_source_timer(sm->get_if_index(), sm->get_gaddr(), sm->get_saddr());
 
         //route calculation
-        m_data.set_source(sm->get_if_index(), sm->get_gaddr(), s);
+        m_data.set_source(sm->get_if_index(), sm->get_gaddr(), source(sm->get_saddr()));
+        start_aging_timer();
 
         set_routes(sm->get_gaddr(), collect_interested_interfaces(sm->get_gaddr(), {sm->get_saddr()}));
 
@@ -325,11 +418,17 @@ void simple_mc_proxy_routing::event_new_source(const std::shared_ptr<proxy_msg>&
     }
 }
 
-void simple_mc_proxy_routing::event_querier_state_change(unsigned int /*if_index*/, const addr_storage& gaddr)
+void simple_mc_proxy_routing::event_querier_state_change(unsigned int /*if_index*/, const mc_addr& gaddr)
 {
     HC_LOG_TRACE("");
 
+    if (get_popular_count() > 0) {
+        count_joins(gaddr);
+        start_aging_timer();
+    }
+
     //route calculation
+    set_wildcard_route(gaddr);
     set_routes(gaddr, collect_interested_interfaces(gaddr, m_data.get_available_sources(gaddr)));
 
     //membership agregation
@@ -337,6 +436,8 @@ void simple_mc_proxy_routing::event_querier_state_change(unsigned int /*if_index
         process_membership_aggregation(RMT_FIRST, gaddr);
     } else if (is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_MUTEX)) {
         process_membership_aggregation(RMT_MUTEX, gaddr);
+    } else if (is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_HASH)) {
+        process_membership_aggregation(RMT_HASH, gaddr);
     } else {
         HC_LOG_ERROR("unkown rule matching type in this context");
     }
@@ -346,44 +447,30 @@ void simple_mc_proxy_routing::timer_triggerd_maintain_routing_table(const std::s
 {
     HC_LOG_TRACE("");
 
-    std::shared_ptr<new_source_timer_msg> tm;
-
-    if (!msg.unique()) {
-        switch (msg->get_type()) {
-        case proxy_msg::NEW_SOURCE_TIMER_MSG: {
-            tm = std::static_pointer_cast<new_source_timer_msg>(msg);
-
-            auto cmp_source_lst = m_data.get_available_sources(tm->get_gaddr());
-            auto cmp_source_it = cmp_source_lst.find(tm->get_saddr());
-            if (cmp_source_it != cmp_source_lst.end()) {
-                if (tm.get() == cmp_source_it->shared_source_timer.get()) {
-                    auto saddr_it = m_data.refresh_source_or_del_it_if_unused(tm->get_gaddr(), tm->get_saddr());
-                    if (!saddr_it.second) {
+    if (msg.get() != m_aging_timer.get()) {
+        HC_LOG_DEBUG("aging timer is outdate");
+        return;
+    }
 
-                        del_route(tm->get_if_index(), tm->get_gaddr(), tm->get_saddr());
+    m_aging_timer = nullptr;
 
-                        if (is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_MUTEX)) {
-                            process_membership_aggregation(RMT_MUTEX, tm->get_gaddr());
-                        }
-                    } else {
-                        saddr_it.first->shared_source_timer = set_source_timer(tm->get_if_index(), tm->get_gaddr(), tm->get_saddr());
-                    }
-
-                } else {
-                    HC_LOG_DEBUG("filter_timer is outdate");
-                }
-            }
+    //a source is removed if it has not sent any packet since the last pass
+    std::set<mc_addr> changed_groups;
+    for (auto & e : m_data.refresh_sources_or_del_unused()) {
+        del_route(e.input_if_index, e.gaddr, e.saddr);
+        del_forwarding_verdicts(e.gaddr, e.saddr);
+        changed_groups.insert(e.gaddr);
+    }
 
+    if (is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_MUTEX)) {
+        for (auto & e : changed_groups) {
+            process_membership_aggregation(RMT_MUTEX, e);
         }
-        break;
-        default:
-            HC_LOG_ERROR("unknown timer message format");
-            return;
-        }
-    } else {
-        HC_LOG_DEBUG("filter_timer is outdate");
-        return;
     }
+
+    update_popular_groups();
+
+    start_aging_timer();
 }
 
 bool simple_mc_proxy_routing::is_rule_matching_type(rb_interface_type interface_type, rb_interface_direction interface_direction, rb_rule_matching_type rule_matching_type) const
@@ -415,11 +502,11 @@ bool simple_mc_proxy_routing::is_rule_matching_type(rb_interface_type interface_
     }
 }
 
-std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::collect_interested_interfaces(const addr_storage& gaddr, const source_list<source>& slist) const
+std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::collect_interested_interfaces(const mc_addr& gaddr, const source_list<source>& slist) const
 {
     HC_LOG_TRACE("");
 
-    const std::map<addr_storage, unsigned int>& input_if_index_map = m_data.get_interface_map(gaddr);
+    const std::map<mc_addr, unsigned int>& input_if_index_map = m_data.get_interface_map(gaddr);
 
     //add upstream interfaces
     std::list<std::pair<source, std::list<unsigned int>>> rt_list;
@@ -439,6 +526,7 @@ std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::c
             }
 
             std::list<unsigned int> up_if_list;
+            double best_score = 0;
             for (auto ui : m_p->m_upstreams) {
                 if (check_interface(IT_UPSTREAM, ID_OUT, ui.m_if_index, input_if_it->second, gaddr, s.saddr)) {
 
@@ -447,6 +535,13 @@ std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::c
                     } else if (is_rule_matching_type(IT_UPSTREAM, ID_OUT, RMT_FIRST)) {
                         up_if_list.push_back(ui.m_if_index);
                         break;
+                    } else if (is_rule_matching_type(IT_UPSTREAM, ID_OUT, RMT_HASH)) {
+                        //the (S,G) pair is forwarded to the eligible upstream with the highest score
+                        double score = interface_memberships::get_hash_score(ui.m_if_index, ui.m_interface->get_weight(), gaddr, s.saddr);
+                        if (score > best_score) {
+                            up_if_list.assign(1, ui.m_if_index);
+                            best_score = score;
+                        }
                     } else {
                         HC_LOG_ERROR("unknown rule matching type");
                     }
@@ -461,7 +556,7 @@ std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::c
     }
 
     //add downstream interfaces
-    std::function<bool(unsigned int, const addr_storage&)> filter_fun = [&](unsigned int output_if_index, const addr_storage & saddr) {
+    std::function<bool(unsigned int, const mc_addr&)> filter_fun = [&](unsigned int output_if_index, const mc_addr & saddr) {
         auto input_if_it = input_if_index_map.find(saddr);
         if (input_if_it == input_if_index_map.end()) {
             HC_LOG_ERROR("input interface of multicast source " << saddr << " not found");
@@ -475,32 +570,447 @@ std::list<std::pair<source, std::list<unsigned int>>> simple_mc_proxy_routing::c
         }
     };
 
+    //ask only the queriers whose group state changed since the last call, and only for sources without a valid suggestion
+    auto& gaddr_cache = m_forwarding_cache[gaddr];
     for (auto & dif : m_p->m_downstreams) {
-        dif.second.m_querier->suggest_to_forward_traffic(gaddr, rt_list, std::bind(filter_fun, dif.first, std::placeholders::_1));
+        auto lock = m_p->lock_querier(dif.first, gaddr);
+
+        auto& dv = gaddr_cache[dif.first];
+        unsigned long long version = dif.second.m_queriers[m_p->get_slice(gaddr)]->get_group_version(gaddr);
+        if (dv.m_version != version || dv.m_interface != dif.second.m_interface) {
+            dv.m_version = version;
+            dv.m_interface = dif.second.m_interface;
+            dv.m_verdicts.clear();
+        }
+
+        if (version == 0) { //no interest in this group
+            continue;
+        }
+
+        std::list<std::pair<source, std::list<unsigned int>>> suggest_list;
+        for (auto & e : rt_list) {
+            auto input_if_it = input_if_index_map.find(e.first.saddr);
+            unsigned int input_if_index = input_if_it != input_if_index_map.end() ? input_if_it->second : 0;
+
+            auto verdict_it = dv.m_verdicts.find(e.first.saddr);
+            if (verdict_it == dv.m_verdicts.end() || verdict_it->second.m_input_if_index != input_if_index) {
+                suggest_list.push_back(std::pair<source, std::list<unsigned int>>(e.first, {}));
+            }
+        }
+
+        if (!suggest_list.empty()) {
+            dif.second.m_queriers[m_p->get_slice(gaddr)]->suggest_to_forward_traffic(gaddr, suggest_list, std::bind(filter_fun, dif.first, std::placeholders::_1));
+
+            for (auto & e : suggest_list) {
+                auto input_if_it = input_if_index_map.find(e.first.saddr);
+                unsigned int input_if_index = input_if_it != input_if_index_map.end() ? input_if_it->second : 0;
+                dv.m_verdicts[e.first.saddr] = {input_if_index, !e.second.empty()};
+            }
+        }
+
+        for (auto & e : rt_list) {
+            auto verdict_it = dv.m_verdicts.find(e.first.saddr);
+            if (verdict_it != dv.m_verdicts.end() && verdict_it->second.m_forward) {
+                e.second.push_back(dif.first);
+            }
+        }
+    }
+
+    //remove the suggestions of deleted downstreams and of groups without sources
+    if (m_data.get_available_sources(gaddr).empty()) {
+        m_forwarding_cache.erase(gaddr);
+    } else {
+        for (auto it = gaddr_cache.begin(); it != gaddr_cache.end();) {
+            if (!m_p->is_downstream(it->first)) {
+                it = gaddr_cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 
     return rt_list;
 }
 
-void simple_mc_proxy_routing::process_membership_aggregation(rb_rule_matching_type rule_matching_type, const addr_storage& gaddr)
+void simple_mc_proxy_routing::del_forwarding_verdicts(const mc_addr& gaddr, const mc_addr& saddr)
 {
     HC_LOG_TRACE("");
 
-    if (rule_matching_type == RMT_FIRST || rule_matching_type == RMT_MUTEX) {
-        interface_memberships im(rule_matching_type , gaddr, m_p, m_data);
+    auto gaddr_it = m_forwarding_cache.find(gaddr);
+    if (gaddr_it == m_forwarding_cache.end()) {
+        return;
+    }
+
+    if (m_data.get_available_sources(gaddr).empty()) {
+        m_forwarding_cache.erase(gaddr_it);
+    } else {
+        for (auto & e : gaddr_it->second) {
+            e.second.m_verdicts.erase(saddr);
+        }
+    }
+}
+
+void simple_mc_proxy_routing::process_membership_aggregation(rb_rule_matching_type rule_matching_type, const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+
+    //a hot group is joined by its upstreams whatever the downstreams want
+    bool prejoined = false;
+
+    if (rule_matching_type == RMT_FIRST && is_aggregation_incremental()) {
+        //without filters the first upstream gets all memberships
+        bool is_first = true;
+        for (auto & e : m_p->m_upstreams) {
+            const source_state& sstate = is_first ? update_aggregate(gaddr) : m_no_membership;
+            bool hot = is_hot(e.m_interface.get(), gaddr);
+            send_record(e.m_if_index, gaddr, hot ? m_hot_membership : sstate);
+            prejoined = prejoined || hot;
+            is_first = false;
+        }
+    } else if (rule_matching_type == RMT_FIRST || rule_matching_type == RMT_MUTEX || rule_matching_type == RMT_HASH) {
+        m_aggregates.clear();
+
+        interface_memberships im(rule_matching_type , gaddr, m_p, m_data, m_filter_cache);
         for (auto & e : m_p->m_upstreams) {
-            send_record(e.m_if_index, gaddr, im.get_group_memberships(e.m_if_index));
+            bool hot = is_hot(e.m_interface.get(), gaddr);
+            send_record(e.m_if_index, gaddr, hot ? m_hot_membership : im.get_group_memberships(e.m_if_index));
+            prejoined = prejoined || hot;
         }
     } else {
         HC_LOG_ERROR("unkown rule matching type in this context");
     }
+
+    if (prejoined) {
+        m_prejoined.insert(gaddr);
+    } else {
+        m_prejoined.erase(gaddr);
+    }
+}
+
+bool simple_mc_proxy_routing::is_hot(const interface* upstream, const mc_addr& gaddr) const
+{
+    if (upstream == nullptr) {
+        return false;
+    }
+
+    const prejoin_groups& prejoin = upstream->get_prejoin();
+    if (!prejoin.is_enabled()) {
+        return false;
+    }
+
+    if (prejoin.is_configured(gaddr)) {
+        return true;
+    }
+
+    auto it = m_popular_ranks.find(gaddr);
+    return it != std::end(m_popular_ranks) && it->second < prejoin.popular;
+}
+
+bool simple_mc_proxy_routing::is_hot(unsigned int upstream_if_index, const mc_addr& gaddr) const
+{
+    for (auto & e : m_p->m_upstreams) {
+        if (e.m_if_index == upstream_if_index) {
+            return is_hot(e.m_interface.get(), gaddr);
+        }
+    }
+    return false;
+}
+
+unsigned int simple_mc_proxy_routing::get_popular_count() const
+{
+    unsigned int result = 0;
+    for (auto & e : m_p->m_upstreams) {
+        if (e.m_interface != nullptr) {
+            result = std::max(result, e.m_interface->get_prejoin().popular);
+        }
+    }
+    return result;
+}
+
+void simple_mc_proxy_routing::count_joins(const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+
+    //a join is a downstream starting to want the group
+    auto& joined = m_joined_downstreams[gaddr];
+    for (auto & dif : m_p->m_downstreams) {
+        auto lock = m_p->lock_querier(dif.first, gaddr);
+        if (dif.second.m_queriers[m_p->get_slice(gaddr)]->get_group_version(gaddr) != 0) {
+            if (joined.insert(dif.first).second) {
+                m_join_counts[gaddr] += 1;
+            }
+        } else {
+            joined.erase(dif.first);
+        }
+    }
+
+    //forget deleted downstreams
+    for (auto it = std::begin(joined); it != std::end(joined);) {
+        if (!m_p->is_downstream(*it)) {
+            it = joined.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (joined.empty()) {
+        m_joined_downstreams.erase(gaddr);
+    }
 }
 
-void simple_mc_proxy_routing::set_routes(const addr_storage& gaddr, const std::list<std::pair<source, std::list<unsigned int>>>& output_if_index) const
+void simple_mc_proxy_routing::update_popular_groups()
 {
     HC_LOG_TRACE("");
 
-    const std::map<addr_storage, unsigned int>& input_if_index_map = m_data.get_interface_map(gaddr);
+    unsigned int popular_count = get_popular_count();
+    if (popular_count == 0) {
+        m_join_counts.clear();
+        m_joined_downstreams.clear();
+    }
+
+    std::vector<std::pair<double, mc_addr>> counts;
+    for (auto it = std::begin(m_join_counts); it != std::end(m_join_counts);) {
+        it->second *= SIMPLE_MC_PROXY_ROUTING_JOIN_DECAY;
+        if (it->second < SIMPLE_MC_PROXY_ROUTING_JOIN_MIN && m_joined_downstreams.find(it->first) == std::end(m_joined_downstreams)) {
+            it = m_join_counts.erase(it);
+        } else {
+            counts.push_back(std::make_pair(it->second, it->first));
+            ++it;
+        }
+    }
+
+    //the most often joined groups first, equal counts are ordered by the group address
+    auto popular_end = std::begin(counts) + std::min<std::size_t>(popular_count, counts.size());
+    std::partial_sort(std::begin(counts), popular_end, std::end(counts), [](const std::pair<double, mc_addr>& l, const std::pair<double, mc_addr>& r) {
+        return l.first > r.first || (l.first == r.first && l.second < r.second);
+    });
+
+    std::map<mc_addr, unsigned int> ranks;
+    for (auto it = std::begin(counts); it != popular_end; ++it) {
+        ranks.insert(std::make_pair(it->second, static_cast<unsigned int>(it - std::begin(counts))));
+    }
+
+    std::set<mc_addr> changed;
+    for (auto & e : m_popular_ranks) {
+        auto it = ranks.find(e.first);
+        if (it == std::end(ranks) || it->second != e.second) {
+            changed.insert(e.first);
+        }
+    }
+
+    for (auto & e : ranks) {
+        if (m_popular_ranks.find(e.first) == std::end(m_popular_ranks)) {
+            changed.insert(e.first);
+        }
+    }
+
+    m_popular_ranks = std::move(ranks);
+
+    for (auto & e : changed) {
+        HC_LOG_DEBUG("popularity of the group " << e << " changed");
+        event_querier_state_change(0, e);
+    }
+}
+
+std::vector<mc_addr> simple_mc_proxy_routing::get_prejoined_groups() const
+{
+    HC_LOG_TRACE("");
+
+    std::set<mc_addr> result(std::begin(m_prejoined), std::end(m_prejoined));
+    for (auto & e : m_p->m_upstreams) {
+        if (e.m_interface != nullptr) {
+            for (auto & g : e.m_interface->get_prejoin().get_configured_groups()) {
+                result.insert(g);
+            }
+        }
+    }
+
+    for (auto & e : m_popular_ranks) {
+        result.insert(e.first);
+    }
+
+    return std::vector<mc_addr>(std::begin(result), std::end(result));
+}
+
+bool simple_mc_proxy_routing::is_aggregation_incremental() const
+{
+    HC_LOG_TRACE("");
+
+    for (auto & e : m_p->m_upstreams) {
+        if (e.m_interface == nullptr || e.m_interface->has_filter()) {
+            return false;
+        }
+    }
+
+    for (auto & e : m_p->m_downstreams) {
+        if (e.second.m_interface == nullptr || e.second.m_interface->has_filter()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const source_state& simple_mc_proxy_routing::update_aggregate(const mc_addr& gaddr)
+{
+    HC_LOG_TRACE("");
+
+    auto& ga = m_aggregates[gaddr];
+    if (ga.m_downstreams.empty() && ga.m_sources.empty()) {
+        ga.m_exclude_count = 0;
+    }
+
+    //ask only the queriers whose group state changed since the last aggregation
+    for (auto & dif : m_p->m_downstreams) {
+        auto lock = m_p->lock_querier(dif.first, gaddr);
+
+        unsigned long long version = dif.second.m_queriers[m_p->get_slice(gaddr)]->get_group_version(gaddr);
+        auto it = ga.m_downstreams.find(dif.first);
+        if (it == std::end(ga.m_downstreams)) {
+            if (version == 0) { //no interest in this group
+                continue;
+            }
+
+            it = ga.m_downstreams.insert(std::make_pair(dif.first, std::make_pair(0ULL, source_state()))).first;
+        } else if (it->second.first == version) {
+            continue;
+        }
+
+        source_state new_state;
+        if (version != 0) {
+            new_state = source_state(dif.second.m_queriers[m_p->get_slice(gaddr)]->get_group_membership_infos(gaddr));
+        }
+        lock = std::unique_lock<std::mutex>();
+
+        change_membership(ga, it->second.second, new_state);
+
+        if (version == 0) {
+            ga.m_downstreams.erase(it);
+        } else {
+            it->second.first = version;
+            it->second.second = std::move(new_state);
+        }
+    }
+
+    //forget the memberships of deleted downstreams
+    for (auto it = std::begin(ga.m_downstreams); it != std::end(ga.m_downstreams);) {
+        if (!m_p->is_downstream(it->first)) {
+            change_membership(ga, it->second.second, source_state());
+            it = ga.m_downstreams.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (ga.m_downstreams.empty()) {
+        m_aggregates.erase(gaddr);
+        return m_no_membership;
+    }
+
+    return ga.m_result;
+}
+
+void simple_mc_proxy_routing::change_membership(group_aggregate& ga, const source_state& from, const source_state& to)
+{
+    HC_LOG_TRACE("");
+
+    if (from.m_mc_filter == to.m_mc_filter) {
+        //count only the difference of both sorted source lists
+        auto f = std::begin(from.m_source_list);
+        auto t = std::begin(to.m_source_list);
+        while (f != std::end(from.m_source_list) || t != std::end(to.m_source_list)) {
+            if (t == std::end(to.m_source_list) || (f != std::end(from.m_source_list) && *f < *t)) {
+                change_source_refs(ga, f->saddr, from.m_mc_filter, -1, true);
+                ++f;
+            } else if (f == std::end(from.m_source_list) || *t < *f) {
+                change_source_refs(ga, t->saddr, to.m_mc_filter, 1, true);
+                ++t;
+            } else {
+                ++f;
+                ++t;
+            }
+        }
+        return;
+    }
+
+    //a changed filter mode changes the number of excluding downstreams and so the requirement of every source
+    for (auto & e : from.m_source_list) {
+        change_source_refs(ga, e.saddr, from.m_mc_filter, -1, false);
+    }
+
+    for (auto & e : to.m_source_list) {
+        change_source_refs(ga, e.saddr, to.m_mc_filter, 1, false);
+    }
+
+    if (from.m_mc_filter == EXCLUDE_MODE) {
+        --ga.m_exclude_count;
+    }
+
+    if (to.m_mc_filter == EXCLUDE_MODE) {
+        ++ga.m_exclude_count;
+    }
+
+    rebuild_aggregate_result(ga);
+}
+
+void simple_mc_proxy_routing::change_source_refs(group_aggregate& ga, const source_addr& saddr, mc_filter filter_mode, int diff, bool update_result)
+{
+    HC_LOG_TRACE("");
+
+    auto it = ga.m_sources.find(saddr.get());
+    if (it == std::end(ga.m_sources)) {
+        it = ga.m_sources.insert(std::make_pair(saddr.get(), source_refs {0, 0})).first;
+    }
+
+    if (filter_mode == INCLUDE_MODE) {
+        it->second.m_include += diff;
+    } else {
+        it->second.m_exclude += diff;
+    }
+
+    if (update_result) {
+        if (is_aggregated_source(ga, it->second)) {
+            ga.m_result.m_source_list.insert(source(saddr));
+        } else {
+            ga.m_result.m_source_list.erase(source(saddr));
+        }
+    }
+
+    if (it->second.m_include == 0 && it->second.m_exclude == 0) {
+        ga.m_sources.erase(it);
+    }
+}
+
+bool simple_mc_proxy_routing::is_aggregated_source(const group_aggregate& ga, const source_refs& refs) const
+{
+    //INCLUDE: union of all requested sources, EXCLUDE: sources excluded by all excluding downstreams and requested by none
+    if (ga.m_exclude_count == 0) {
+        return refs.m_include > 0;
+    } else {
+        return refs.m_exclude == ga.m_exclude_count && refs.m_include == 0;
+    }
+}
+
+void simple_mc_proxy_routing::rebuild_aggregate_result(group_aggregate& ga)
+{
+    HC_LOG_TRACE("");
+
+    std::vector<source> slist;
+    for (auto & e : ga.m_sources) {
+        if (is_aggregated_source(ga, e.second)) {
+            slist.push_back(source(e.first));
+        }
+    }
+
+    ga.m_result.m_mc_filter = ga.m_exclude_count == 0 ? INCLUDE_MODE : EXCLUDE_MODE;
+    ga.m_result.m_source_list = source_list<source>(std::begin(slist), std::end(slist));
+}
+
+void simple_mc_proxy_routing::set_routes(const mc_addr& gaddr, const std::list<std::pair<source, std::list<unsigned int>>>& output_if_index) const
+{
+    HC_LOG_TRACE("");
+
+    const std::map<mc_addr, unsigned int>& input_if_index_map = m_data.get_interface_map(gaddr);
     unsigned int input_if_index;
 
     for (auto & e : output_if_index) {
@@ -514,6 +1024,12 @@ void simple_mc_proxy_routing::set_routes(const addr_storage& gaddr, const std::l
                 continue;
             }
 
+            //the sources of a hot group keep a route without output interfaces, a join only adds the downstream
+            if (m_p->is_upstream(input_if_index) && is_hot(input_if_index, gaddr) && check_interface(IT_UPSTREAM, ID_IN, input_if_index, input_if_index, gaddr, e.first.saddr)) {
+                m_p->m_routing->add_route(m_p->m_interfaces->get_virtual_if_index(input_if_index), gaddr, e.first.saddr.get(), std::list<int>());
+                continue;
+            }
+
             del_route(input_if_index, gaddr, e.first.saddr);
         } else {
             std::list<int> vif_out;
@@ -548,41 +1064,94 @@ void simple_mc_proxy_routing::set_routes(const addr_storage& gaddr, const std::l
                 continue;
             }
 
-            m_p->m_routing->add_route(m_p->m_interfaces->get_virtual_if_index(input_if_index), gaddr, e.first.saddr, vif_out);
+            m_p->m_routing->add_route(m_p->m_interfaces->get_virtual_if_index(input_if_index), gaddr, e.first.saddr.get(), vif_out);
         }
 
     }
 }
 
-void simple_mc_proxy_routing::send_record(unsigned int upstream_if_index, const addr_storage& gaddr, const source_state& sstate) const
+void simple_mc_proxy_routing::send_record(unsigned int upstream_if_index, const mc_addr& gaddr, const source_state& sstate) const
 {
     HC_LOG_TRACE("");
-    m_p->m_sender->send_record(upstream_if_index, sstate.m_mc_filter, gaddr, sstate.m_source_list);
+    if (m_p->m_report_pacer != nullptr) {
+        m_p->m_report_pacer->send_record(upstream_if_index, sstate.m_mc_filter, gaddr, sstate.m_source_list);
+    } else {
+        m_p->m_sender->send_record(upstream_if_index, sstate.m_mc_filter, gaddr, sstate.m_source_list);
+    }
+    metrics::add_latency(LATENCY_UPSTREAM);
+    MCPROXY_PROBE(report_sent, upstream_if_index, sstate.m_mc_filter, &gaddr, sstate.m_source_list.size());
 }
 
-void simple_mc_proxy_routing::del_route(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr) const
+void simple_mc_proxy_routing::del_route(unsigned int if_index, const mc_addr& gaddr, const mc_addr& saddr) const
 {
     HC_LOG_TRACE("");
     m_p->m_routing->del_route(m_p->m_interfaces->get_virtual_if_index(if_index), gaddr, saddr);
 }
 
-std::shared_ptr<new_source_timer_msg> simple_mc_proxy_routing::set_source_timer(unsigned int if_index, const addr_storage& gaddr, const addr_storage& saddr)
+void simple_mc_proxy_routing::set_wildcard_route(const mc_addr& gaddr)
 {
     HC_LOG_TRACE("");
-    std::chrono::milliseconds source_life_time;
-    if (m_p->is_upstream(if_index) && is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_MUTEX)) {
-        source_life_time = m_p->m_upstream_input_rule->get_timeout();
-    } else {
-        source_life_time = get_source_life_time();
+
+    //the traffic of a single upstream is forwarded independent of its source if no interface has a filter
+    //and each querier suggests to forward all or none of the sources
+    bool use_wildcard = m_wildcard_routes_supported && m_p->m_upstreams.size() == 1 && is_rule_matching_type(IT_UPSTREAM, ID_IN, RMT_FIRST);
+
+    unsigned int upstream_if_index = 0;
+    if (use_wildcard) {
+        auto& upstream = *m_p->m_upstreams.begin();
+        upstream_if_index = upstream.m_if_index;
+        use_wildcard = upstream.m_interface != nullptr && !upstream.m_interface->has_filter();
     }
 
-    auto nst = std::make_shared<new_source_timer_msg>(if_index, gaddr, saddr, source_life_time);
-    m_p->m_timing->add_time(get_source_life_time(), m_p, nst);
+    std::list<int> vif_out;
+    for (auto & dif : m_p->m_downstreams) {
+        if (!use_wildcard) {
+            break;
+        }
+
+        if (dif.second.m_interface == nullptr || dif.second.m_interface->has_filter()) {
+            use_wildcard = false;
+            break;
+        }
+
+        auto lock = m_p->lock_querier(dif.first, gaddr);
+        bool forward;
+        if (!dif.second.m_queriers[m_p->get_slice(gaddr)]->is_source_independent(gaddr, forward)) {
+            use_wildcard = false;
+        } else if (forward && dif.first != upstream_if_index) {
+            vif_out.push_back(m_p->m_interfaces->get_virtual_if_index(dif.first));
+        }
+    }
+
+    addr_storage any_source(get_addr_family(m_p->m_group_mem_protocol));
+    auto route_it = m_wildcard_routes.find(gaddr);
+
+    if (route_it != std::end(m_wildcard_routes) && (!use_wildcard || vif_out.empty() || route_it->second != upstream_if_index)) {
+        m_p->m_routing->del_route(m_p->m_interfaces->get_virtual_if_index(route_it->second), gaddr, any_source);
+        m_wildcard_routes.erase(route_it);
+    }
+
+    if (use_wildcard && !vif_out.empty()) {
+        //the kernel matches a (*,G) entry only on the interfaces with a TTL and does not forward back to the input interface
+        vif_out.push_back(m_p->m_interfaces->get_virtual_if_index(upstream_if_index));
+        m_p->m_routing->add_route(m_p->m_interfaces->get_virtual_if_index(upstream_if_index), gaddr, any_source, vif_out);
+        m_wildcard_routes[gaddr] = upstream_if_index;
+    }
+}
+
+void simple_mc_proxy_routing::start_aging_timer()
+{
+    HC_LOG_TRACE("");
+
+    if (m_aging_timer != nullptr || (m_data.empty() && m_join_counts.empty())) {
+        return;
+    }
 
-    return nst;
+    m_aging_timer = make_pooled_msg<new_source_timer_msg>(0, mc_addr(), mc_addr(), get_source_life_time());
+    m_aging_timer->set_handle(m_p->m_timing->add_time(get_source_life_time(), m_p, m_aging_timer));
 }
 
-bool simple_mc_proxy_routing::check_interface(rb_interface_type interface_type, rb_interface_direction interface_direction, unsigned int checking_if_index, unsigned int input_if_index, const addr_storage& gaddr, const addr_storage& saddr) const
+bool simple_mc_proxy_routing::check_interface(rb_interface_type interface_type, rb_interface_direction interface_direction, unsigned int checking_if_index, unsigned int input_if_index, const mc_addr& gaddr, const mc_addr& saddr) const
 {
     HC_LOG_TRACE("");
 
@@ -616,25 +1185,47 @@ bool simple_mc_proxy_routing::check_interface(rb_interface_type interface_type,
         return false;
     }
 
-    std::string input_if_index_name = interfaces::get_if_name(input_if_index);
-    if (!input_if_index_name.empty()) {
-        if (interface_direction == ID_IN) {
-            return interf->match_input_filter(input_if_index_name, gaddr, saddr);
-        } else if (interface_direction == ID_OUT) {
-            return interf->match_output_filter(input_if_index_name, gaddr, saddr);
-        } else {
-            HC_LOG_ERROR("unkown interface direction");
-            return false;
-        }
+    if (interface_direction == ID_IN || interface_direction == ID_OUT) {
+        return m_filter_cache.match(*interf, interface_direction, input_if_index, gaddr, saddr);
     } else {
-        HC_LOG_ERROR("failed to map interface index " << input_if_index << " to interface name");
+        HC_LOG_ERROR("unkown interface direction");
         return false;
     }
 }
 
+std::shared_ptr<const route_snapshot_list> simple_mc_proxy_routing::get_snapshot()
+{
+    HC_LOG_TRACE("");
+
+    if (m_snapshot == nullptr || m_snapshot_version != m_data.get_version()) {
+        m_snapshot = std::make_shared<route_snapshot_list>(m_data.get_routes());
+        m_snapshot_version = m_data.get_version();
+    }
+
+    return m_snapshot;
+}
+
 std::string simple_mc_proxy_routing::to_string() const
 {
     HC_LOG_TRACE("");
-    return m_data.to_string();
+    std::ostringstream s;
+    s << m_data.to_string();
+    if (!m_wildcard_routes.empty()) {
+        s << std::endl << "wildcard routes:";
+        for (auto & e : m_wildcard_routes) {
+            s << std::endl << "\t(*, " << e.first << ") from " << interfaces::get_if_name(e.second);
+        }
+    }
+    if (!m_prejoined.empty()) {
+        s << std::endl << "prejoined groups:";
+        for (auto & e : m_prejoined) {
+            auto it = m_popular_ranks.find(e);
+            s << std::endl << "\t" << e;
+            if (it != std::end(m_popular_ranks)) {
+                s << " popular rank " << it->second + 1;
+            }
+        }
+    }
+    return s.str();
 }
 
@@ -29,37 +29,27 @@
 simple_routing_data::simple_routing_data(group_mem_protocol group_mem_protocol, const std::shared_ptr<const mroute_socket>& mrt_sock)
     : m_group_mem_protocol(group_mem_protocol)
     , m_mrt_sock(mrt_sock)
+    , m_version(0)
 {
     HC_LOG_TRACE("");
 }
 
-unsigned long simple_routing_data::get_current_packet_count(const addr_storage& gaddr, const addr_storage& saddr)
+unsigned long simple_routing_data::get_current_packet_count(const mc_addr& gaddr, const mc_addr& saddr)
 {
     HC_LOG_TRACE("");
 
-    if (is_IPv4(m_group_mem_protocol)) {
-        struct sioc_sg_req tmp_stat;
-        if (m_mrt_sock->get_mroute_stats(saddr, gaddr, &tmp_stat, nullptr)) {
-            return tmp_stat.pktcnt;
-        } else {
-            return true;
-        }
-    } else if (is_IPv6(m_group_mem_protocol)) {
-        struct sioc_sg_req6 tmp_stat;
-        if (m_mrt_sock->get_mroute_stats(saddr, gaddr, nullptr, &tmp_stat)) {
-            return tmp_stat.pktcnt;
-        } else {
-            return true;
-        }
+    unsigned long pkt_count;
+    if (m_mrt_sock->get_mroute_pkt_count(saddr, gaddr, pkt_count)) {
+        return pkt_count;
     } else {
-        HC_LOG_ERROR("unknown IP version");
         return true;
     }
 }
 
-void simple_routing_data::set_source(unsigned int if_index, const addr_storage& gaddr, const source& saddr)
+void simple_routing_data::set_source(unsigned int if_index, const mc_addr& gaddr, const source& saddr)
 {
     HC_LOG_TRACE("");
+    ++m_version;
     auto gaddr_it = m_data.find(gaddr);
     if (gaddr_it != std::end(m_data)) {
         auto list_result = gaddr_it->second.m_source_list.insert(saddr);
@@ -69,22 +59,23 @@ void simple_routing_data::set_source(unsigned int if_index, const addr_storage&
             gaddr_it->second.m_source_list.insert(saddr);
         }
 
-        auto map_result = gaddr_it->second.m_if_map.insert(std::pair<addr_storage, unsigned int>(saddr.saddr, if_index));
+        auto map_result = gaddr_it->second.m_if_map.insert(std::pair<mc_addr, unsigned int>(saddr.saddr, if_index));
         if (!map_result.second) {
             map_result.first->second = if_index;
             HC_LOG_WARN("data already exists");
         }
 
     } else {
-        m_data.insert(s_routing_data_pair(gaddr, sr_data_value({saddr}, {std::pair<addr_storage, unsigned int>(saddr.saddr, if_index)})));
+        m_data.insert(s_routing_data_pair(gaddr, sr_data_value({saddr}, {std::pair<mc_addr, unsigned int>(saddr.saddr, if_index)})));
     }
 }
 
-void simple_routing_data::del_source(const addr_storage& gaddr, const addr_storage& saddr)
+void simple_routing_data::del_source(const mc_addr& gaddr, const mc_addr& saddr)
 {
     HC_LOG_TRACE("");
     auto gaddr_it = m_data.find(gaddr);
     if (gaddr_it != std::end(m_data)) {
+        ++m_version;
         gaddr_it->second.m_source_list.erase(saddr);
         gaddr_it->second.m_if_map.erase(saddr);
         if (gaddr_it->second.m_source_list.empty()) {
@@ -94,37 +85,85 @@ void simple_routing_data::del_source(const addr_storage& gaddr, const addr_stora
 
 }
 
-std::pair<source_list<source>::iterator, bool> simple_routing_data::refresh_source_or_del_it_if_unused(const addr_storage& gaddr, const addr_storage& saddr)
+route_snapshot_list simple_routing_data::refresh_sources_or_del_unused()
 {
     HC_LOG_TRACE("");
-    auto gaddr_it = m_data.find(gaddr);
-    if (gaddr_it != std::end(m_data)) {
+    route_snapshot_list removed;
+
+    //one dump of all counters, otherwise one request per source
+    std::map<std::pair<mc_addr, mc_addr>, unsigned long> pkt_counts;
+    bool has_pkt_counts = m_mrt_sock->get_all_mroute_pkt_counts(pkt_counts);
 
-        auto saddr_it = gaddr_it->second.m_source_list.find(saddr);
-        if (saddr_it != std::end(gaddr_it->second.m_source_list)) {
+    for (auto gaddr_it = std::begin(m_data); gaddr_it != std::end(m_data);) {
+        source_list<source> used_sources;
+        used_sources.reserve(gaddr_it->second.m_source_list.size());
 
-            auto cnt = get_current_packet_count(gaddr, saddr);
-            if (static_cast<unsigned long>(saddr_it->retransmission_count) == cnt) {
-                gaddr_it->second.m_source_list.erase(saddr_it);
-                gaddr_it->second.m_if_map.erase(saddr);
+        for (auto & e : gaddr_it->second.m_source_list) {
+            unsigned long cnt;
+            if (has_pkt_counts) {
+                auto cnt_it = pkt_counts.find(std::make_pair(gaddr_it->first, e.saddr));
+                cnt = (cnt_it != std::end(pkt_counts)) ? cnt_it->second : true; //the same as a failed request of get_current_packet_count
             } else {
-                saddr_it->retransmission_count = cnt;
-                return std::pair<source_list<source>::iterator, bool>(saddr_it, true);
+                cnt = get_current_packet_count(gaddr_it->first, e.saddr);
             }
 
+            if (static_cast<unsigned long>(e.retransmission_count) == cnt) {
+                auto if_it = gaddr_it->second.m_if_map.find(e.saddr);
+                if (if_it != std::end(gaddr_it->second.m_if_map)) {
+                    removed.push_back(route_snapshot {gaddr_it->first, e.saddr, if_it->second});
+                    gaddr_it->second.m_if_map.erase(if_it);
+                } else {
+                    HC_LOG_ERROR("failed to find input interface of  (" << gaddr_it->first << ", " << e.saddr << ")");
+                }
+            } else {
+                e.retransmission_count = cnt;
+                used_sources.insert(std::end(used_sources), e);
+            }
         }
 
-        gaddr_it->second.m_source_list.erase(saddr);
-        gaddr_it->second.m_if_map.erase(saddr);
-        if (gaddr_it->second.m_source_list.empty()) {
-            m_data.erase(gaddr_it);
+        if (used_sources.empty()) {
+            gaddr_it = m_data.erase(gaddr_it);
+        } else {
+            gaddr_it->second.m_source_list = std::move(used_sources);
+            ++gaddr_it;
         }
     }
 
-    return std::pair<source_list<source>::iterator, bool>(source_list<source>::iterator(), false);
+    if (!removed.empty()) {
+        ++m_version;
+    }
+
+    return removed;
+}
+
+bool simple_routing_data::empty() const
+{
+    HC_LOG_TRACE("");
+    return m_data.empty();
+}
+
+unsigned long long simple_routing_data::get_version() const
+{
+    HC_LOG_TRACE("");
+    return m_version;
+}
+
+route_snapshot_list simple_routing_data::get_routes() const
+{
+    HC_LOG_TRACE("");
+    route_snapshot_list rt;
+
+    for (auto & e : m_data) {
+        for (auto & s : e.second.m_source_list) {
+            auto if_it = e.second.m_if_map.find(s.saddr);
+            rt.push_back(route_snapshot {e.first, s.saddr, if_it != std::end(e.second.m_if_map) ? if_it->second : 0});
+        }
+    }
+
+    return rt;
 }
 
-const source_list<source>& simple_routing_data::get_available_sources(const addr_storage& gaddr) const
+const source_list<source>& simple_routing_data::get_available_sources(const mc_addr& gaddr) const
 {
     HC_LOG_TRACE("");
     static source_list<source> rt;
@@ -157,14 +196,14 @@ std::string simple_routing_data::to_string() const
     return s.str();
 }
 
-const std::map<addr_storage, unsigned int>& simple_routing_data::get_interface_map(const addr_storage& gaddr) const
+const std::map<mc_addr, unsigned int>& simple_routing_data::get_interface_map(const mc_addr& gaddr) const
 {
     HC_LOG_TRACE("");
     auto it = m_data.find(gaddr);
     if(it != std::end(m_data)){
         return it->second.m_if_map; 
     }else{
-        static std::map<addr_storage, unsigned int> result;
+        static std::map<mc_addr, unsigned int> result;
         result.clear();
         return result; 
     }
@@ -181,19 +220,19 @@ void simple_routing_data::test_simple_routing_data()
     using namespace std;
     //simple_routing_data srd;
     //cout << srd << endl;
-    //srd.set_source(1, addr_storage("10.1.1.1"), addr_storage("1.1.1.1"));
-    //srd.set_source(1, addr_storage("10.1.1.1"), addr_storage("1.1.1.2"));
-    //srd.set_source(1, addr_storage("10.1.1.1"), addr_storage("1.1.1.3"));
-    //srd.set_source(1, addr_storage("10.1.1.2"), addr_storage("1.1.1.1"));
-    //srd.set_source(1, addr_storage("10.1.1.2"), addr_storage("1.1.1.2"));
-    //srd.set_source(1, addr_storage("10.1.1.3"), addr_storage("1.1.1.1"));
-    //srd.set_source(0, addr_storage("10.1.1.1"), addr_storage("1.1.1.1"));
-    //srd.set_source(0, addr_storage("10.1.1.1"), addr_storage("1.1.1.2"));
+    //srd.set_source(1, mc_addr("10.1.1.1"), mc_addr("1.1.1.1"));
+    //srd.set_source(1, mc_addr("10.1.1.1"), mc_addr("1.1.1.2"));
+    //srd.set_source(1, mc_addr("10.1.1.1"), mc_addr("1.1.1.3"));
+    //srd.set_source(1, mc_addr("10.1.1.2"), mc_addr("1.1.1.1"));
+    //srd.set_source(1, mc_addr("10.1.1.2"), mc_addr("1.1.1.2"));
+    //srd.set_source(1, mc_addr("10.1.1.3"), mc_addr("1.1.1.1"));
+    //srd.set_source(0, mc_addr("10.1.1.1"), mc_addr("1.1.1.1"));
+    //srd.set_source(0, mc_addr("10.1.1.1"), mc_addr("1.1.1.2"));
     //cout << srd << endl;
-    //srd.del_source(1, addr_storage("10.1.1.2"), addr_storage("1.1.1.1"));
-    //srd.del_source(1, addr_storage("10.1.1.2"), addr_storage("1.1.1.1"));
-    //srd.del_source(0, addr_storage("10.1.1.1"), addr_storage("1.1.1.1"));
-    //srd.del_source(0, addr_storage("10.1.1.1"), addr_storage("1.1.1.2"));
+    //srd.del_source(1, mc_addr("10.1.1.2"), mc_addr("1.1.1.1"));
+    //srd.del_source(1, mc_addr("10.1.1.2"), mc_addr("1.1.1.1"));
+    //srd.del_source(0, mc_addr("10.1.1.1"), mc_addr("1.1.1.1"));
+    //srd.del_source(0, mc_addr("10.1.1.1"), mc_addr("1.1.1.2"));
     //cout << srd << endl;
 }
 #endif /* DEBUG_MODE */
@@ -23,72 +23,355 @@
 #include "include/hamcast_logging.h"
 #include "include/proxy/timing.hpp"
 #include "include/proxy/worker.hpp"
+#include "include/utils/metrics.hpp"
+#include "include/utils/tracepoints.hpp"
+#include "include/utils/thread_settings.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
-timing::timing():
-    m_running(false), m_thread(nullptr)
+timing::timing(bool virtual_clock):
+    m_is_virtual(virtual_clock)
+    , m_running(false), m_thread(nullptr)
+    , m_timer_fd(-1)
+    , m_event_fd(-1)
+    , m_epoll_fd(-1)
+    , m_is_armed(false)
 {
     HC_LOG_TRACE("");
+
+    if (m_is_virtual) {
+        timer_clock::start_virtual();
+        return;
+    }
+
+    init_fds();
     start();
 }
 
 timing::~timing()
 {
     HC_LOG_TRACE("");
+
+    if (m_is_virtual) {
+        return;
+    }
+
     stop();
     join();
+    close_fds();
+}
+
+void timing::init_fds()
+{
+    HC_LOG_TRACE("");
+
+    m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (m_timer_fd < 0) {
+        HC_LOG_ERROR("failed to create timerfd! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create timerfd";
+    }
+
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_event_fd < 0) {
+        HC_LOG_ERROR("failed to create eventfd! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create eventfd";
+    }
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd < 0) {
+        HC_LOG_ERROR("failed to create epoll instance! Error: " << strerror(errno) << " errno: " << errno);
+        close_fds();
+        throw "failed to create epoll instance";
+    }
+
+    for (int fd : {m_timer_fd, m_event_fd}) {
+        epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            HC_LOG_ERROR("failed to register file descriptor! Error: " << strerror(errno) << " errno: " << errno);
+            close_fds();
+            throw "failed to register file descriptor";
+        }
+    }
+}
+
+void timing::close_fds()
+{
+    HC_LOG_TRACE("");
+
+    for (int* fd : {&m_epoll_fd, &m_event_fd, &m_timer_fd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void timing::drain(int fd) const
+{
+    HC_LOG_TRACE("");
+
+    std::uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        HC_LOG_ERROR("failed to read file descriptor! Error: " << strerror(errno) << " errno: " << errno);
+    }
+}
+
+void timing::arm_timer()
+{
+    HC_LOG_TRACE("");
+
+    if (m_is_virtual) {
+        return;
+    }
+
+    itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    if (m_db.empty() && m_deferred.empty()) {
+        if (m_is_armed) {
+            m_is_armed = false;
+            timerfd_settime(m_timer_fd, 0, &its, nullptr); //disarm
+        }
+        return;
+    }
+
+    timing_db_key until;
+    if (m_deferred.empty()) {
+        until = m_db.get_next_wakeup();
+    } else {
+        until = timer_clock::now() + TIMING_RETRY_DELAY;
+        if (!m_db.empty()) {
+            until = std::min(until, m_db.get_next_wakeup());
+        }
+    }
+    if (m_is_armed && m_armed_until <= until) {
+        return;
+    }
+
+    set_timer(until);
+}
+
+void timing::arm_timer(const timing_db_key& until)
+{
+    HC_LOG_TRACE("");
+
+    if (m_is_virtual) {
+        return;
+    }
+
+    //without an armed deadline other reminders may be due earlier, only a single one is known to be the next
+    if (!m_is_armed && m_db.size() > 1) {
+        arm_timer();
+        return;
+    }
+
+    timing_db_key wakeup = m_db.get_wakeup(until);
+    if (m_is_armed && m_armed_until <= wakeup) {
+        return;
+    }
+
+    set_timer(wakeup);
+}
+
+void timing::set_timer(const timing_db_key& until)
+{
+    HC_LOG_TRACE("");
+
+    itimerspec its;
+    memset(&its, 0, sizeof(its));
+
+    //steady_clock counts the time of CLOCK_MONOTONIC
+    auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(until.time_since_epoch()).count();
+    its.it_value.tv_sec = since_epoch / 1000000000;
+    its.it_value.tv_nsec = since_epoch % 1000000000;
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) {
+        its.it_value.tv_nsec = 1; //a zero value disarms the timerfd
+    }
+
+    if (timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &its, nullptr) < 0) {
+        HC_LOG_ERROR("failed to arm timerfd! Error: " << strerror(errno) << " errno: " << errno);
+        return;
+    }
+
+    m_is_armed = true;
+    m_armed_until = until;
 }
 
 void timing::worker_thread()
 {
     HC_LOG_TRACE("");
 
-    while (m_running) {
+    epoll_event events[2];
 
-        std::mutex lokal_lock;
-        std::unique_lock<std::mutex> ull(lokal_lock);
+    while (m_running) {
+        int nfds = epoll_wait(m_epoll_fd, events, 2, -1);
+        if (nfds < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to wait for timer events! Error: " << strerror(errno) << " errno: " << errno);
+            break;
+        }
 
-        if (m_db.empty()) {
-            sleep(TIMING_IDLE_POLLING_INTERVAL);
-        } else {
-            m_con_var.wait_until(ull, m_db.begin()->first);
+        for (int i = 0; i < nfds; ++i) {
+            drain(events[i].data.fd);
         }
 
         std::lock_guard<std::mutex> lock(m_global_lock);
 
-        timing_db_key now = std::chrono::steady_clock::now();
+        timing_wheel_bucket expired;
+        m_db.expire(timer_clock::now(), expired);
+        metrics::add(METRIC_TIMERS_PENDING, -static_cast<long long>(expired.size()));
+        metrics::add(METRIC_TIMERS_EXPIRED, expired.size());
+        MCPROXY_PROBE(timer_fired, expired.size());
+        deliver(expired);
+
+        //the armed deadline is consumed or was only a wakeup
+        m_is_armed = false;
+        arm_timer();
+    }
+}
+
+void timing::deliver(timing_wheel_bucket& expired)
+{
+    HC_LOG_TRACE("");
+
+    //a full job queue must not stall the timer thread, which serves all instances, the deferred
+    //reminders of a worker go ahead of its new ones and are retried with them in one message
+    std::map<const worker*, std::shared_ptr<timer_batch_msg>> batches;
+    batches.swap(m_deferred);
+
+    for (auto & e : expired) {
+        const worker* msg_worker = std::get<0>(e.m_value);
+        std::shared_ptr<proxy_msg>& msg = std::get<1>(e.m_value);
 
-        for (auto it = begin(m_db); it != end(m_db);) {
-            if (it->first <= now) {
-                timing_db_value& db_value = it->second;
-                (*std::get<1>(db_value).get())();
-                if (std::get<0>(db_value) != nullptr) {
-                    std::get<0>(db_value)->add_msg(std::get<1>(db_value));
-                }
+        (*msg.get())();
 
-                it = m_db.erase(it);
+        if (msg_worker == nullptr) {
+            continue;
+        }
+
+        auto batch_it = batches.find(msg_worker);
+        if (batch_it == std::end(batches)) {
+            //the reminders of a worker without timer slack are delivered one by one
+            if (m_slack.find(msg_worker) == std::end(m_slack) && msg_worker->try_add_msg(msg)) {
                 continue;
+            }
+            batch_it = batches.insert(std::make_pair(msg_worker, make_pooled_msg<timer_batch_msg>())).first;
+        }
+        batch_it->second->get_timers().push_back(std::move(msg));
+    }
 
-            } else {
-                break;
+    for (auto & e : batches) {
+        auto& timers = e.second->get_timers();
+        bool delivered;
+        if (timers.size() == 1) {
+            delivered = e.first->try_add_msg(timers.front());
+            if (delivered) {
+                timers.clear();
             }
+        } else {
+            delivered = e.first->try_add_msg(e.second);
+        }
 
-            ++it;
+        if (!delivered) {
+            metrics::add(METRIC_TIMERS_DEFERRED, timers.size());
+            m_deferred.insert(e);
         }
     }
 }
 
-void timing::add_time(std::chrono::milliseconds delay, const worker* msg_worker, const std::shared_ptr<proxy_msg>& pr_msg)
+timing_db_key timing::apply_slack(const worker* msg_worker, const timing_db_key& until) const
+{
+    HC_LOG_TRACE("");
+
+    auto it = m_slack.find(msg_worker);
+    if (it == std::end(m_slack)) {
+        return until;
+    }
+
+    auto slack = std::chrono::duration_cast<timing_db_key::duration>(it->second);
+    auto since_epoch = until.time_since_epoch();
+    auto rest = since_epoch % slack;
+    if (rest.count() == 0) {
+        return until;
+    } else {
+        return until + (slack - rest);
+    }
+}
+
+void timing::set_slack(const worker* msg_worker, std::chrono::milliseconds slack)
 {
     HC_LOG_TRACE("");
-    timing_db_key until = std::chrono::steady_clock::now() + delay;
 
     std::lock_guard<std::mutex> lock(m_global_lock);
 
-    m_db.insert(timing_db_pair(until, std::make_tuple(msg_worker, pr_msg)));
-    m_con_var.notify_one();
+    if (slack.count() > 0) {
+        m_slack[msg_worker] = slack;
+    } else {
+        m_slack.erase(msg_worker);
+    }
+}
+
+timer_handle timing::add_time(std::chrono::milliseconds delay, const worker* msg_worker, const std::shared_ptr<proxy_msg>& pr_msg)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_global_lock);
+
+    timing_db_key until = apply_slack(msg_worker, timer_clock::now() + delay);
+
+    timer_handle handle = m_db.add(until, std::make_tuple(msg_worker, pr_msg));
+    metrics::add(METRIC_TIMERS_PENDING);
+    MCPROXY_PROBE(timer_armed, delay.count(), msg_worker);
+    arm_timer(until);
+    return handle;
+}
+
+bool timing::cancel_time(const timer_handle& handle)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_global_lock);
+    if (m_db.cancel(handle)) {
+        metrics::add(METRIC_TIMERS_PENDING, -1);
+        return true;
+    }
+
+    return false;
+}
+
+bool timing::reschedule_time(const timer_handle& handle, std::chrono::milliseconds delay)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_global_lock);
+
+    if (handle == nullptr || !handle->is_pending()) {
+        return false;
+    }
+
+    timing_db_key until = apply_slack(std::get<0>(handle->m_it->m_value), timer_clock::now() + delay);
+
+    if (m_db.reschedule(handle, until)) {
+        arm_timer(until);
+        return true;
+    }
+
+    return false;
 }
 
 void timing::stop_all_time(const worker* msg_worker)
@@ -96,15 +379,36 @@ void timing::stop_all_time(const worker* msg_worker)
     HC_LOG_TRACE("");
 
     std::lock_guard<std::mutex> lock(m_global_lock);
+    std::size_t size = m_db.size();
+    m_db.remove(msg_worker);
+    m_deferred.erase(msg_worker);
+    metrics::add(METRIC_TIMERS_PENDING, static_cast<long long>(m_db.size()) - static_cast<long long>(size));
+}
 
-    for (auto it = begin(m_db); it != end(m_db);) {
-        if (std::get<0>(it->second) == msg_worker) {
-            it = m_db.erase(it);
-            continue;
-        }
-        ++it;
+bool timing::advance(const timing_db_key& until, timing_wheel_bucket& expired)
+{
+    HC_LOG_TRACE("");
+
+    if (!m_is_virtual) {
+        HC_LOG_ERROR("only a timing with a virtual clock can be advanced");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_global_lock);
+
+    if (m_db.empty() || m_db.get_next_wakeup() > until) {
+        timer_clock::set_virtual(until);
+        return false;
     }
 
+    //a wakeup of the higher levels only cascades its reminders, expired stays empty
+    timing_db_key next = std::max(m_db.get_next_wakeup(), timer_clock::now());
+    timer_clock::set_virtual(next);
+    std::size_t size = expired.size();
+    m_db.expire(next, expired);
+    metrics::add(METRIC_TIMERS_PENDING, -static_cast<long long>(expired.size() - size));
+    metrics::add(METRIC_TIMERS_EXPIRED, expired.size() - size);
+    return true;
 }
 
 void timing::start()
@@ -113,7 +417,10 @@ void timing::start()
 
     if (m_thread.get() == nullptr) {
         m_running =  true;
-        m_thread.reset(new std::thread(&timing::worker_thread, this));
+        m_thread.reset(new std::thread([this]() {
+            thread_settings::apply(TR_TIMING, "mcp-timing");
+            worker_thread();
+        }));
     } else {
         HC_LOG_WARN("timing is already running");
     }
@@ -123,7 +430,11 @@ void timing::stop()
 {
     HC_LOG_TRACE("");
     m_running = false;
-    m_con_var.notify_one();
+
+    std::uint64_t wakeup = 1;
+    if (write(m_event_fd, &wakeup, sizeof(wakeup)) < 0) {
+        HC_LOG_ERROR("failed to wake up the timer thread! Error: " << strerror(errno) << " errno: " << errno);
+    }
 }
 
 void timing::join() const
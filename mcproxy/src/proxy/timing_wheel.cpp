@@ -0,0 +1,292 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/proxy/timing_wheel.hpp"
+
+#include <algorithm>
+
+std::atomic<bool> timer_clock::m_is_virtual(false);
+std::atomic<timing_db_key::rep> timer_clock::m_virtual_now(0);
+
+void timer_clock::start_virtual()
+{
+    HC_LOG_TRACE("");
+
+    if (!m_is_virtual) {
+        m_virtual_now = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_is_virtual = true;
+    }
+}
+
+void timer_clock::set_virtual(const timing_db_key& now)
+{
+    HC_LOG_TRACE("");
+
+    if (now.time_since_epoch().count() > m_virtual_now) {
+        m_virtual_now = now.time_since_epoch().count();
+    }
+}
+
+bool timer_clock::is_virtual()
+{
+    HC_LOG_TRACE("");
+    return m_is_virtual;
+}
+
+timing_wheel::timing_wheel()
+    : m_epoch(timer_clock::now())
+    , m_next_tick(0)
+    , m_size(0)
+{
+    HC_LOG_TRACE("");
+}
+
+std::uint64_t timing_wheel::get_tick(const timing_db_key& time_point) const
+{
+    HC_LOG_TRACE("");
+
+    if (time_point <= m_epoch) {
+        return 0;
+    }
+
+    //round up, a reminder must never expire before its deadline
+    auto since_epoch = time_point - m_epoch;
+    std::uint64_t tick = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch).count() / TIMING_WHEEL_TICK;
+    if (get_time_point(tick) < time_point) {
+        ++tick;
+    }
+
+    return tick;
+}
+
+timing_db_key timing_wheel::get_time_point(std::uint64_t tick) const
+{
+    HC_LOG_TRACE("");
+    return m_epoch + std::chrono::milliseconds(tick * TIMING_WHEEL_TICK);
+}
+
+timing_wheel_bucket& timing_wheel::get_bucket(std::uint64_t& expire_tick)
+{
+    HC_LOG_TRACE("");
+
+    if (expire_tick < m_next_tick) {
+        expire_tick = m_next_tick;
+    }
+
+    std::uint64_t delta = expire_tick - m_next_tick;
+    if (delta > TIMING_WHEEL_MAX_TICKS) {
+        HC_LOG_WARN("reminder exceeds the range of the timing wheel, clamp it");
+        expire_tick = m_next_tick + TIMING_WHEEL_MAX_TICKS;
+        delta = TIMING_WHEEL_MAX_TICKS;
+    }
+
+    if (delta < TIMING_WHEEL_ROOT_SIZE) {
+        return m_root[expire_tick & TIMING_WHEEL_ROOT_MASK];
+    }
+
+    unsigned int level = 0;
+    while (level < TIMING_WHEEL_LEVELS - 1 && delta >= (static_cast<std::uint64_t>(1) << (TIMING_WHEEL_ROOT_BITS + (level + 1) * TIMING_WHEEL_LEVEL_BITS))) {
+        ++level;
+    }
+
+    return m_levels[level][(expire_tick >> (TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS)) & TIMING_WHEEL_LEVEL_MASK];
+}
+
+unsigned int timing_wheel::cascade(unsigned int level)
+{
+    HC_LOG_TRACE("level: " << level);
+
+    unsigned int index = (m_next_tick >> (TIMING_WHEEL_ROOT_BITS + level * TIMING_WHEEL_LEVEL_BITS)) & TIMING_WHEEL_LEVEL_MASK;
+
+    timing_wheel_bucket& b = m_levels[level][index];
+    while (!b.empty()) {
+        place(b, b.begin());
+    }
+
+    return index;
+}
+
+void timing_wheel::place(timing_wheel_bucket& from, timing_wheel_bucket::iterator it)
+{
+    HC_LOG_TRACE("");
+
+    timing_wheel_bucket& to = get_bucket(it->m_expire_tick);
+    to.splice(to.end(), from, it);
+    it->m_token->m_bucket = &to;
+}
+
+timer_handle timing_wheel::add(const timing_db_key& until, const timing_db_value& value)
+{
+    HC_LOG_TRACE("");
+
+    std::uint64_t expire_tick = get_tick(until);
+    timing_wheel_bucket& b = get_bucket(expire_tick);
+
+    auto token = std::make_shared<timing_wheel_token>();
+    token->m_bucket = &b;
+    token->m_it = b.emplace(b.end(), expire_tick, value, token);
+    ++m_size;
+
+    return token;
+}
+
+bool timing_wheel::cancel(const timer_handle& handle)
+{
+    HC_LOG_TRACE("");
+
+    if (handle == nullptr || !handle->is_pending()) {
+        return false;
+    }
+
+    handle->m_bucket->erase(handle->m_it);
+    handle->m_bucket = nullptr;
+    --m_size;
+    return true;
+}
+
+bool timing_wheel::reschedule(const timer_handle& handle, const timing_db_key& until)
+{
+    HC_LOG_TRACE("");
+
+    if (handle == nullptr || !handle->is_pending()) {
+        return false;
+    }
+
+    handle->m_it->m_expire_tick = get_tick(until);
+    place(*handle->m_bucket, handle->m_it);
+    return true;
+}
+
+void timing_wheel::expire(const timing_db_key& now, timing_wheel_bucket& expired)
+{
+    HC_LOG_TRACE("");
+
+    if (now < m_epoch) {
+        return;
+    }
+
+    std::uint64_t now_tick = std::chrono::duration_cast<std::chrono::milliseconds>(now - m_epoch).count() / TIMING_WHEEL_TICK;
+
+    while (m_size > 0 && m_next_tick <= now_tick) {
+        unsigned int index = m_next_tick & TIMING_WHEEL_ROOT_MASK;
+
+        if (index == 0) {
+            for (unsigned int level = 0; level < TIMING_WHEEL_LEVELS; ++level) {
+                if (cascade(level) != 0) {
+                    break;
+                }
+            }
+        }
+
+        timing_wheel_bucket& b = m_root[index];
+        for (auto & e : b) {
+            e.m_token->m_bucket = nullptr;
+        }
+        m_size -= b.size();
+        expired.splice(expired.end(), b);
+
+        ++m_next_tick;
+    }
+
+    //nothing left to cascade, skip the idle ticks
+    if (m_size == 0 && m_next_tick <= now_tick) {
+        m_next_tick = now_tick + 1;
+    }
+}
+
+void timing_wheel::remove(const worker* msg_worker)
+{
+    HC_LOG_TRACE("");
+
+    auto remove_from = [&](timing_wheel_bucket & b) {
+        for (auto it = begin(b); it != end(b);) {
+            if (std::get<0>(it->m_value) == msg_worker) {
+                it->m_token->m_bucket = nullptr;
+                it = b.erase(it);
+                --m_size;
+                continue;
+            }
+            ++it;
+        }
+    };
+
+    for (auto & b : m_root) {
+        remove_from(b);
+    }
+
+    for (auto & l : m_levels) {
+        for (auto & b : l) {
+            remove_from(b);
+        }
+    }
+}
+
+timing_db_key timing_wheel::get_next_wakeup() const
+{
+    HC_LOG_TRACE("");
+
+    //all reminders of the root level expire within the next TIMING_WHEEL_ROOT_SIZE ticks
+    std::uint64_t next_tick = m_next_tick + TIMING_WHEEL_ROOT_SIZE;
+    std::size_t root_count = 0;
+    for (std::uint64_t i = 0; i < TIMING_WHEEL_ROOT_SIZE; ++i) {
+        const timing_wheel_bucket& b = m_root[(m_next_tick + i) & TIMING_WHEEL_ROOT_MASK];
+        if (!b.empty()) {
+            if (root_count == 0) {
+                next_tick = m_next_tick + i;
+            }
+            root_count += b.size();
+        }
+    }
+
+    //the higher levels cascade if the root level wraps around
+    if (root_count < m_size) {
+        std::uint64_t wrap_tick = (m_next_tick + TIMING_WHEEL_ROOT_MASK) & ~static_cast<std::uint64_t>(TIMING_WHEEL_ROOT_MASK);
+        if (wrap_tick < next_tick) {
+            next_tick = wrap_tick;
+        }
+    }
+
+    return get_time_point(next_tick);
+}
+
+timing_db_key timing_wheel::get_wakeup(const timing_db_key& until) const
+{
+    HC_LOG_TRACE("");
+
+    //same rounding and clamping as get_bucket()
+    std::uint64_t tick = std::max(get_tick(until), m_next_tick);
+    tick = std::min(tick, m_next_tick + TIMING_WHEEL_MAX_TICKS);
+    return get_time_point(tick);
+}
+
+bool timing_wheel::empty() const
+{
+    HC_LOG_TRACE("");
+    return m_size == 0;
+}
+
+std::size_t timing_wheel::size() const
+{
+    HC_LOG_TRACE("");
+    return m_size;
+}
@@ -26,6 +26,8 @@
 
 #include "unistd.h"
 
+#include <sstream>
+
 worker::worker()
     : worker(WORKER_MESSAGE_QUEUE_DEFAULT_SIZE)
 {
@@ -36,8 +38,11 @@ worker::worker(int queue_size)
     : m_thread(nullptr)
     , m_running(false)
     , m_job_queue(queue_size)
+    , m_merged_msgs(0)
 {
     HC_LOG_TRACE("");
+    set_queue_bound(proxy_msg::USER_INPUT, WORKER_MESSAGE_QUEUE_USER_INPUT_SIZE);
+    set_queue_bound(proxy_msg::SYSTEMIC, WORKER_MESSAGE_QUEUE_SYSTEMIC_SIZE);
 }
 
 worker::~worker()
@@ -48,13 +53,16 @@ worker::~worker()
 }
 
 
-void worker::start()
+void worker::start(thread_role role, const std::string& thread_name)
 {
     HC_LOG_TRACE("");
 
     if (m_thread.get() == nullptr) {
         m_running =  true;
-        m_thread.reset(new std::thread(&worker::worker_thread, this));
+        m_thread.reset(new std::thread([this, role, thread_name]() {
+            thread_settings::apply(role, thread_name);
+            worker_thread();
+        }));
     } else {
         HC_LOG_WARN("timing is already running");
     }
@@ -66,11 +74,63 @@ void worker::add_msg(const std::shared_ptr<proxy_msg>& msg) const
 
     HC_LOG_DEBUG("message type: " << proxy_msg::get_message_type_name(msg->get_type()));
     HC_LOG_DEBUG("message priority: " << proxy_msg::get_message_priority_name(msg->get_priority()));
-    if (msg->get_priority() == proxy_msg::LOSEABLE) {
-        m_job_queue.enqueue_loseable(msg);
+    m_job_queue.enqueue(msg, get_queue_policy(msg));
+}
+
+void worker::add_msg_with_policy(const std::shared_ptr<proxy_msg>& msg, message_queue_policy policy) const
+{
+    HC_LOG_TRACE("");
+    m_job_queue.enqueue(msg, policy);
+}
+
+bool worker::try_add_msg(const std::shared_ptr<proxy_msg>& msg) const
+{
+    HC_LOG_TRACE("");
+    return m_job_queue.enqueue(msg, MQ_TRY);
+}
+
+void worker::set_queue_policy(proxy_msg::message_type type, message_queue_policy policy)
+{
+    HC_LOG_TRACE("");
+    m_queue_policies[type] = policy;
+}
+
+message_queue_policy worker::get_queue_policy(const std::shared_ptr<proxy_msg>& msg) const
+{
+    HC_LOG_TRACE("");
+
+    auto it = m_queue_policies.find(msg->get_type());
+    if (it != std::end(m_queue_policies)) {
+        return it->second;
+    } else if (msg->get_priority() == proxy_msg::LOSEABLE) {
+        return MQ_DROP_NEWEST;
     } else {
-        m_job_queue.enqueue(msg);
+        return MQ_BLOCK;
+    }
+}
+
+void worker::set_queue_bound(proxy_msg::message_priority prio, unsigned int bound)
+{
+    HC_LOG_TRACE("");
+    m_job_queue.set_lane_bound(lane_proxy_msg::get_lane(prio), bound);
+}
+
+std::string worker::queue_stats_to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    const proxy_msg::message_priority prios[] = {proxy_msg::USER_INPUT, proxy_msg::SYSTEMIC, proxy_msg::LOSEABLE};
+    for (auto p : prios) {
+        auto st = m_job_queue.get_stats(lane_proxy_msg::get_lane(p));
+        s << proxy_msg::get_message_priority_name(p) << ": size " << st.m_size << "/" << st.m_bound;
+        s << " high water: " << st.m_high_water;
+        s << " enqueued: " << st.m_enqueued;
+        s << " dropped: " << st.m_dropped << std::endl;
     }
+    s << "merged: " << m_merged_msgs;
+
+    return s.str();
 }
 
 bool worker::is_running() const
@@ -136,8 +196,8 @@ void worker::test_worker()
 
     //};
 
-    std::unique_ptr<worker> m(new my_worker(4));
-    //[4 6] 5  [1 2 3 ] without 7
+    std::unique_ptr<worker> m(new my_worker(3));
+    //[4 6] 5  [1 2 3 ] without 7, the lane of loseable messages holds only 3 messages
 
     m->add_msg(std::make_shared<test_msg>(test_msg(1, proxy_msg::LOSEABLE)));
     m->add_msg(std::make_shared<test_msg>(test_msg(2, proxy_msg::LOSEABLE)));
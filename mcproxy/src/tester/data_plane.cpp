@@ -0,0 +1,540 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/tester/data_plane.hpp"
+#include "include/proxy/interfaces.hpp"
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#include <endian.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#define DATA_PLANE_RECV_SIZE 2048
+#define DATA_PLANE_RCVBUF (4 * 1024 * 1024)
+#define DATA_PLANE_POLL_TIMEOUT 100 //msec
+#define DATA_PLANE_MAX_LAG 1000 //msec the sender may fall behind its rate before it stops catching up
+
+sequence_window::sequence_window()
+    : m_is_started(false)
+    , m_first(0)
+    , m_highest(0)
+    , m_lost(0)
+    , m_reordered(0)
+    , m_duplicated(0)
+{
+    m_bits.fill(0);
+}
+
+bool sequence_window::is_set(uint64_t sequence) const
+{
+    unsigned int slot = sequence % SEQUENCE_WINDOW_SIZE;
+    return (m_bits[slot / 64] >> (slot % 64)) & 1;
+}
+
+void sequence_window::set(uint64_t sequence)
+{
+    unsigned int slot = sequence % SEQUENCE_WINDOW_SIZE;
+    m_bits[slot / 64] |= static_cast<uint64_t>(1) << (slot % 64);
+}
+
+void sequence_window::clear(uint64_t sequence)
+{
+    unsigned int slot = sequence % SEQUENCE_WINDOW_SIZE;
+    m_bits[slot / 64] &= ~(static_cast<uint64_t>(1) << (slot % 64));
+}
+
+sequence_window::result sequence_window::add(uint64_t sequence)
+{
+    if (!m_is_started) {
+        m_is_started = true;
+        m_first = sequence;
+        m_highest = sequence;
+        set(sequence);
+        return SW_NEW;
+    }
+
+    if (sequence > m_highest) {
+        uint64_t gap = sequence - m_highest;
+        if (gap >= SEQUENCE_WINDOW_SIZE) {
+            //the whole window is left and the numbers in between have never been in it
+            for (uint64_t s = m_highest - std::min<uint64_t>(m_highest - m_first, SEQUENCE_WINDOW_SIZE - 1); s <= m_highest; ++s) {
+                if (!is_set(s)) {
+                    ++m_lost;
+                }
+            }
+            m_lost += gap - SEQUENCE_WINDOW_SIZE;
+            m_bits.fill(0);
+        } else {
+            //each new number reuses the slot of the number that leaves the window
+            for (uint64_t s = m_highest + 1; s <= sequence; ++s) {
+                if (s >= m_first + SEQUENCE_WINDOW_SIZE && !is_set(s)) {
+                    ++m_lost;
+                }
+                clear(s);
+            }
+        }
+
+        m_highest = sequence;
+        set(sequence);
+        return SW_NEW;
+    }
+
+    if (sequence < m_first || m_highest - sequence >= SEQUENCE_WINDOW_SIZE) {
+        //older than the window, it has been counted as lost (or is a duplicate, which cannot be told apart)
+        if (sequence >= m_first && m_lost > 0) {
+            --m_lost;
+        }
+        ++m_reordered;
+        return SW_REORDERED;
+    }
+
+    if (is_set(sequence)) {
+        ++m_duplicated;
+        return SW_DUPLICATED;
+    }
+
+    set(sequence);
+    ++m_reordered;
+    return SW_REORDERED;
+}
+
+unsigned long long sequence_window::get_lost() const
+{
+    if (!m_is_started) {
+        return 0;
+    }
+
+    unsigned long long lost = m_lost;
+    for (uint64_t s = m_highest - std::min<uint64_t>(m_highest - m_first, SEQUENCE_WINDOW_SIZE - 1); s <= m_highest; ++s) {
+        if (!is_set(s)) {
+            ++lost;
+        }
+    }
+    return lost;
+}
+
+unsigned long long sequence_window::get_reordered() const
+{
+    return m_reordered;
+}
+
+unsigned long long sequence_window::get_duplicated() const
+{
+    return m_duplicated;
+}
+
+namespace
+{
+//add n to the lowest 32 bits of an address
+addr_storage add_to_addr(const addr_storage& addr, unsigned int n)
+{
+    if (addr.get_addr_family() == AF_INET) {
+        in_addr result = addr.get_in_addr();
+        result.s_addr = htonl(ntohl(result.s_addr) + n);
+        return addr_storage(result);
+    } else {
+        in6_addr result = addr.get_in6_addr();
+        uint32_t low;
+        memcpy(&low, &result.s6_addr[12], sizeof(low));
+        low = htonl(ntohl(low) + n);
+        memcpy(&result.s6_addr[12], &low, sizeof(low));
+        return addr_storage(result);
+    }
+}
+
+double get_msec(std::chrono::steady_clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.0;
+}
+}
+
+data_plane::data_plane(const data_plane_settings& settings, const bool& running)
+    : m_settings(settings)
+    , m_addr_family(settings.first_group.get_addr_family())
+    , m_running(running)
+    , m_invalid(0)
+{
+    HC_LOG_TRACE("");
+
+    if (m_settings.group_count == 0) {
+        throw "group_count must be at least 1";
+    }
+
+    if (m_settings.batch == 0) {
+        throw "batch must be at least 1";
+    }
+
+    if (m_settings.payload_size < sizeof(data_plane_header) || m_settings.payload_size > DATA_PLANE_RECV_SIZE) {
+        throw "payload_size must be between the header size (24 bytes) and 2048 bytes";
+    }
+
+    bool rc = m_addr_family == AF_INET ? m_sock.create_udp_ipv4_socket() : m_sock.create_udp_ipv6_socket();
+    if (!rc) {
+        throw "failed to create udp socket";
+    }
+}
+
+addr_storage data_plane::get_group_addr(unsigned int group) const
+{
+    return add_to_addr(m_settings.first_group, group);
+}
+
+uint64_t data_plane::get_real_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void data_plane::send()
+{
+    HC_LOG_TRACE("");
+
+    if (!m_sock.choose_if(interfaces::get_if_index(m_settings.if_name))) {
+        throw "failed to choose interface";
+    }
+
+    if (!m_sock.set_ttl(m_settings.ttl)) {
+        throw "failed to set ttl";
+    }
+
+    std::cout << "send " << m_settings.group_count << " groups from " << m_settings.first_group << " port " << m_settings.port << " on interface " << m_settings.if_name << " with " << m_settings.payload_size << " bytes per packet at ";
+    if (m_settings.rate == 0) {
+        std::cout << "full speed";
+    } else {
+        std::cout << m_settings.rate << " packets per second";
+    }
+    std::cout << " in batches of " << m_settings.batch << std::endl;
+
+    std::vector<addr_storage> destinations;
+    for (unsigned int g = 0; g < m_settings.group_count; ++g) {
+        destinations.push_back(get_group_addr(g).set_port(m_settings.port));
+    }
+
+    std::vector<unsigned char> buf(m_settings.batch * m_settings.payload_size, 0);
+    std::vector<iovec> iov(m_settings.batch);
+    std::vector<mmsghdr> msgs(m_settings.batch);
+    std::vector<uint64_t> sequences(m_settings.group_count, 0);
+
+    unsigned long long max_total = static_cast<unsigned long long>(m_settings.max_count) * m_settings.group_count;
+    unsigned long long sent = 0;
+    unsigned long long failures = 0;
+    unsigned int cursor = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start;
+    auto next_status = start + std::chrono::seconds(1);
+
+    while (m_running && (max_total == 0 || sent < max_total)) {
+        unsigned int count = m_settings.batch;
+        if (max_total != 0) {
+            count = std::min<unsigned long long>(count, max_total - sent);
+        }
+
+        //one time stamp per batch, the packets of a batch leave together
+        uint64_t send_time = htobe64(get_real_time());
+        for (unsigned int i = 0; i < count; ++i) {
+            unsigned int g = cursor;
+            cursor = (cursor + 1) % m_settings.group_count;
+
+            data_plane_header* h = reinterpret_cast<data_plane_header*>(&buf[i * m_settings.payload_size]);
+            h->magic = htonl(DATA_PLANE_MAGIC);
+            h->group = htonl(g);
+            h->sequence = htobe64(sequences[g]++);
+            h->send_time = send_time;
+
+            iov[i].iov_base = h;
+            iov[i].iov_len = m_settings.payload_size;
+            memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr*>(&destinations[g].get_sockaddr());
+            msgs[i].msg_hdr.msg_namelen = destinations[g].get_addr_len();
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int batch_sent = 0;
+        if (!m_sock.send_mmsg(msgs.data(), count, batch_sent)) {
+            ++failures;
+        }
+        //the unsent packets keep their sequence numbers and count as lost at the receiver
+        sent += count;
+
+        auto now = std::chrono::steady_clock::now();
+        if (m_settings.rate != 0) {
+            deadline += std::chrono::nanoseconds(static_cast<long long>(count) * 1000000000 / m_settings.rate);
+            if (deadline > now) {
+                std::this_thread::sleep_until(deadline);
+            } else if (now - deadline > std::chrono::milliseconds(DATA_PLANE_MAX_LAG)) {
+                deadline = now;
+            }
+        }
+
+        if (m_settings.print_status_msg && now >= next_status) {
+            next_status += std::chrono::seconds(1);
+            std::cout << "\rsent(#): " << sent << "; packets per sec: " << static_cast<unsigned long long>(sent / (get_msec(now - start) / 1000.0));
+            std::flush(std::cout);
+        }
+    }
+
+    double duration = get_msec(std::chrono::steady_clock::now() - start) / 1000.0;
+    if (m_settings.print_status_msg) {
+        std::cout << std::endl;
+    }
+
+    std::cout << "send summary==> packet_count(#): " << sent << "; groups(#): " << m_settings.group_count << "; send duration(ms): " << static_cast<unsigned long long>(duration * 1000);
+    if (duration > 0) {
+        std::cout << "; packets per sec: " << static_cast<unsigned long long>(sent / duration) << "; throughput(Mbit/s): " << sent * m_settings.payload_size * 8 / duration / 1000000;
+    }
+    std::cout << "; failed batches(#): " << failures << std::endl;
+}
+
+void data_plane::receive_packet(const unsigned char* buf, unsigned int size, uint64_t receive_time, std::chrono::steady_clock::time_point now)
+{
+    if (size < sizeof(data_plane_header)) {
+        ++m_invalid;
+        return;
+    }
+
+    data_plane_header h;
+    memcpy(&h, buf, sizeof(h));
+    unsigned int g = ntohl(h.group);
+    if (ntohl(h.magic) != DATA_PLANE_MAGIC || g >= m_groups.size()) {
+        ++m_invalid;
+        return;
+    }
+
+    group_stats& s = m_groups[g];
+    if (s.window.add(be64toh(h.sequence)) == sequence_window::SW_DUPLICATED) {
+        return;
+    }
+
+    long long latency = static_cast<long long>(receive_time - be64toh(h.send_time));
+    if (s.packets == 0) {
+        s.first = now;
+        s.latency_min = latency;
+        s.latency_max = latency;
+    } else {
+        s.latency_min = std::min(s.latency_min, latency);
+        s.latency_max = std::max(s.latency_max, latency);
+    }
+    s.latency_sum += latency;
+    s.last = now;
+    ++s.packets;
+    s.bytes += size;
+
+    //clocks out of sync can cause negative latencies, they are counted in the first bucket
+    long long bucket = std::max(0LL, latency / 1000);
+    ++m_latencies[std::min<long long>(bucket, DATA_PLANE_LATENCY_BUCKETS - 1)];
+}
+
+void data_plane::receive()
+{
+    HC_LOG_TRACE("");
+
+    unsigned int if_index = interfaces::get_if_index(m_settings.if_name);
+
+    if (!m_sock.set_reuse_port(true) || !m_sock.set_multicast_all(false)) {
+        throw "failed to set socket options";
+    }
+
+    if (!m_sock.bind_udp_socket(addr_storage(m_addr_family), m_settings.port)) {
+        throw "failed to bind port";
+    }
+
+    int enable = 1;
+    if (setsockopt(m_sock.get_sock(), SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0) {
+        throw "failed to enable receive time stamps";
+    }
+
+    int rcvbuf = DATA_PLANE_RCVBUF;
+    if (setsockopt(m_sock.get_sock(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) != 0) {
+        std::cout << "failed to enlarge the receive buffer" << std::endl;
+    }
+
+    m_groups = std::vector<group_stats>(m_settings.group_count);
+    m_latencies.assign(DATA_PLANE_LATENCY_BUCKETS, 0);
+
+    std::cout << "join " << m_settings.group_count << " groups from " << m_settings.first_group << " port " << m_settings.port << " on interface " << m_settings.if_name << std::endl;
+    for (unsigned int g = 0; g < m_settings.group_count; ++g) {
+        m_groups[g].joined = std::chrono::steady_clock::now();
+        if (!m_sock.join_group(get_group_addr(g), if_index)) {
+            std::cout << "failed to join group " << get_group_addr(g) << " (IPv4 limits the groups per socket, see net.ipv4.igmp_max_memberships)" << std::endl;
+            exit(0);
+        }
+    }
+
+    std::vector<unsigned char> buf(m_settings.batch * DATA_PLANE_RECV_SIZE);
+    std::vector<unsigned char> control(m_settings.batch * CMSG_SPACE(sizeof(timespec)));
+    std::vector<iovec> iov(m_settings.batch);
+    std::vector<mmsghdr> msgs(m_settings.batch);
+
+    pollfd pfd;
+    pfd.fd = m_sock.get_sock();
+    pfd.events = POLLIN;
+
+    auto next_status = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    unsigned long long received = 0;
+    unsigned long long max_total = static_cast<unsigned long long>(m_settings.max_count) * m_settings.group_count;
+
+    while (m_running && (max_total == 0 || received < max_total)) {
+        if (poll(&pfd, 1, DATA_PLANE_POLL_TIMEOUT) <= 0) {
+            continue; //timeout or an interrupt (SIGINT)
+        }
+
+        for (unsigned int i = 0; i < m_settings.batch; ++i) {
+            iov[i].iov_base = &buf[i * DATA_PLANE_RECV_SIZE];
+            iov[i].iov_len = DATA_PLANE_RECV_SIZE;
+            memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = &control[i * CMSG_SPACE(sizeof(timespec))];
+            msgs[i].msg_hdr.msg_controllen = CMSG_SPACE(sizeof(timespec));
+        }
+
+        int count = 0;
+        if (!m_sock.receive_mmsg(msgs.data(), m_settings.batch, count)) {
+            continue;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        uint64_t fallback_time = get_real_time();
+        for (int i = 0; i < count; ++i) {
+            uint64_t receive_time = fallback_time;
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec ts;
+                    memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    receive_time = static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+                }
+            }
+            receive_packet(&buf[i * DATA_PLANE_RECV_SIZE], msgs[i].msg_len, receive_time, now);
+        }
+        received += count;
+
+        if (m_settings.print_status_msg && now >= next_status) {
+            next_status += std::chrono::seconds(1);
+            unsigned int active = std::count_if(std::begin(m_groups), std::end(m_groups), [](const group_stats & s) {
+                return s.packets > 0;
+            });
+            std::cout << "\rreceived(#): " << received << "; groups with traffic(#): " << active << "/" << m_groups.size();
+            std::flush(std::cout);
+        }
+    }
+
+    if (m_settings.print_status_msg) {
+        std::cout << std::endl;
+    }
+
+    m_sock.close_socket();
+    print_receive_summary();
+}
+
+long long data_plane::get_latency_percentile(double p) const
+{
+    unsigned long long total = 0;
+    for (auto e : m_latencies) {
+        total += e;
+    }
+
+    unsigned long long rank = static_cast<unsigned long long>(p * total);
+    unsigned long long seen = 0;
+    for (unsigned int i = 0; i < m_latencies.size(); ++i) {
+        seen += m_latencies[i];
+        if (seen > rank) {
+            return i;
+        }
+    }
+    return m_latencies.size() - 1;
+}
+
+void data_plane::print_receive_summary() const
+{
+    HC_LOG_TRACE("");
+
+    std::cout << std::setw(24) << std::left << "group" << std::right
+              << std::setw(12) << "packets(#)" << std::setw(12) << "pkt/s" << std::setw(10) << "Mbit/s"
+              << std::setw(10) << "lost(#)" << std::setw(9) << "loss(%)" << std::setw(12) << "reorder(#)" << std::setw(10) << "dup(#)"
+              << std::setw(16) << "first pkt(ms)" << std::setw(30) << "latency min/avg/max(us)" << std::endl;
+
+    unsigned long long packets = 0;
+    unsigned long long bytes = 0;
+    unsigned long long lost = 0;
+    unsigned long long reordered = 0;
+    unsigned long long duplicated = 0;
+    unsigned int silent = 0;
+    std::vector<double> first_packet;
+
+    for (unsigned int g = 0; g < m_groups.size(); ++g) {
+        const group_stats& s = m_groups[g];
+        std::ostringstream gaddr;
+        gaddr << get_group_addr(g);
+        std::cout << std::setw(24) << std::left << gaddr.str() << std::right << std::setw(12) << s.packets;
+
+        packets += s.packets;
+        bytes += s.bytes;
+        lost += s.window.get_lost();
+        reordered += s.window.get_reordered();
+        duplicated += s.window.get_duplicated();
+
+        if (s.packets == 0) {
+            ++silent;
+            std::cout << "  no traffic" << std::endl;
+            continue;
+        }
+
+        double duration = get_msec(s.last - s.first) / 1000.0;
+        double expected = s.packets + s.window.get_lost();
+        std::ostringstream latency;
+        latency << s.latency_min / 1000 << "/" << s.latency_sum / static_cast<long long>(s.packets) / 1000 << "/" << s.latency_max / 1000;
+        first_packet.push_back(get_msec(s.first - s.joined));
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(12) << (duration > 0 ? static_cast<unsigned long long>(s.packets / duration) : 0)
+                  << std::setw(10) << (duration > 0 ? s.bytes * 8 / duration / 1000000 : 0)
+                  << std::setw(10) << s.window.get_lost() << std::setw(9) << 100.0 * s.window.get_lost() / expected
+                  << std::setw(12) << s.window.get_reordered() << std::setw(10) << s.window.get_duplicated()
+                  << std::setw(16) << first_packet.back() << std::setw(30) << latency.str() << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << std::setprecision(6);
+    }
+
+    std::sort(std::begin(first_packet), std::end(first_packet));
+
+    std::cout << "receive summary==> packet_count(#): " << packets << "; total data size(byte): " << bytes << "; lost(#): " << lost;
+    if (packets + lost > 0) {
+        std::cout << "; loss(%): " << 100.0 * lost / (packets + lost);
+    }
+    std::cout << "; reordered(#): " << reordered << "; duplicated(#): " << duplicated << "; invalid(#): " << m_invalid << "; groups without traffic(#): " << silent << std::endl;
+
+    if (!first_packet.empty()) {
+        std::cout << "join to first packet(ms)==> min: " << first_packet.front() << "; p50: " << first_packet[first_packet.size() / 2] << "; max: " << first_packet.back() << std::endl;
+        std::cout << "one-way latency(us)==> p50: " << get_latency_percentile(0.5) << "; p90: " << get_latency_percentile(0.9) << "; p99: " << get_latency_percentile(0.99) << "; p99.9: " << get_latency_percentile(0.999) << std::endl;
+    }
+}
@@ -0,0 +1,721 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/tester/host_population.hpp"
+#include "include/proxy/interfaces.hpp"
+#include "include/utils/mroute_socket.hpp"
+#include "include/utils/extended_igmp_defines.hpp"
+#include "include/utils/extended_mld_defines.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/icmp6.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define HOST_POPULATION_MTU 1500
+#define HOST_POPULATION_IP6_HBH_SIZE 8 //hop-by-hop header with router alert and PadN
+#define HOST_POPULATION_RECV_SIZE 2048
+
+namespace
+{
+//add n to the lowest 32 bits of an address
+addr_storage add_to_addr(const addr_storage& addr, unsigned int n)
+{
+    if (addr.get_addr_family() == AF_INET) {
+        in_addr result = addr.get_in_addr();
+        result.s_addr = htonl(ntohl(result.s_addr) + n);
+        return addr_storage(result);
+    } else {
+        in6_addr result = addr.get_in6_addr();
+        uint32_t low;
+        memcpy(&low, &result.s6_addr[12], sizeof(low));
+        low = htonl(ntohl(low) + n);
+        memcpy(&result.s6_addr[12], &low, sizeof(low));
+        return addr_storage(result);
+    }
+}
+
+//IGMPv3 and MLDv2 encode long maximum response times as floating point values
+long long decode_float(unsigned int code, unsigned int threshold, unsigned int exp_bits, unsigned int mant_bits)
+{
+    if (code < threshold) {
+        return code;
+    }
+    unsigned int exp = (code >> mant_bits) & ((1 << exp_bits) - 1);
+    unsigned int mant = code & ((1 << mant_bits) - 1);
+    return static_cast<long long>((mant | (1 << mant_bits))) << (exp + 3);
+}
+
+double get_percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+}
+}
+
+host_population::host_population(const host_population_settings& settings, const bool& running)
+    : m_settings(settings)
+    , m_addr_family(get_addr_family(settings.version))
+    , m_running(running)
+    , m_send_fd(-1)
+    , m_query_fd(-1)
+    , m_stop(false)
+    , m_rand(settings.seed)
+    , m_host_groups(settings.host_count)
+    , m_groups(settings.group_count)
+    , m_active_groups(0)
+    , m_query_received(false)
+    , m_query_max_resp(0)
+    , m_response_cursor(settings.host_count)
+    , m_reports_sent(0)
+    , m_send_failures(0)
+    , m_queries(0)
+    , m_late_responses(0)
+{
+    HC_LOG_TRACE("");
+
+    if (m_settings.first_group.get_addr_family() != m_addr_family || m_settings.first_host.get_addr_family() != m_addr_family) {
+        throw "group and first_host must match the ip version of the protocol";
+    }
+
+    if (m_settings.group_count == 0 || m_settings.groups_per_host == 0 || m_settings.groups_per_host > m_settings.group_count) {
+        throw "groups_per_host must be between 1 and group_count";
+    }
+
+    if (m_settings.pattern == HP_ZAPPING && m_settings.groups_per_host == m_settings.group_count) {
+        throw "zapping needs more groups than groups_per_host";
+    }
+
+    //IPPROTO_RAW sockets include the ip header, for IPv6 as well
+    m_send_fd = socket(m_addr_family, SOCK_RAW, IPPROTO_RAW);
+    if (m_send_fd < 0 || !m_send_sock.set_own_socket(m_send_fd, m_addr_family)) {
+        throw "failed to create raw socket";
+    }
+
+    if (!m_send_sock.choose_if(interfaces::get_if_index(m_settings.if_name))) {
+        throw "failed to choose interface";
+    }
+
+    if (m_settings.answer_queries) {
+        m_query_fd = socket(m_addr_family, SOCK_RAW, m_addr_family == AF_INET ? static_cast<int>(IPPROTO_IGMP) : static_cast<int>(IPPROTO_ICMPV6));
+        if (m_query_fd < 0) {
+            throw "failed to create query socket";
+        }
+
+        if (setsockopt(m_query_fd, SOL_SOCKET, SO_BINDTODEVICE, m_settings.if_name.c_str(), m_settings.if_name.size()) != 0) {
+            throw "failed to bind query socket to interface";
+        }
+    }
+}
+
+host_population::~host_population()
+{
+    HC_LOG_TRACE("");
+
+    m_stop = true;
+    for (auto t : {&m_monitor_thread, &m_query_thread, &m_source_thread}) {
+        if (t->joinable()) {
+            t->join();
+        }
+    }
+
+    if (m_send_fd >= 0) {
+        close(m_send_fd);
+    }
+
+    if (m_query_fd >= 0) {
+        close(m_query_fd);
+    }
+}
+
+addr_storage host_population::get_host_addr(unsigned int host) const
+{
+    return add_to_addr(m_settings.first_host, host);
+}
+
+addr_storage host_population::get_group_addr(unsigned int group) const
+{
+    return add_to_addr(m_settings.first_group, group);
+}
+
+int host_population::get_group_index(const addr_storage& gaddr) const
+{
+    long long diff;
+    if (m_addr_family == AF_INET) {
+        diff = static_cast<long long>(ntohl(gaddr.get_in_addr().s_addr)) - ntohl(m_settings.first_group.get_in_addr().s_addr);
+    } else {
+        const in6_addr& a = gaddr.get_in6_addr();
+        const in6_addr& b = m_settings.first_group.get_in6_addr();
+        if (memcmp(a.s6_addr, b.s6_addr, 12) != 0) {
+            return -1;
+        }
+        uint32_t low_a;
+        uint32_t low_b;
+        memcpy(&low_a, &a.s6_addr[12], sizeof(low_a));
+        memcpy(&low_b, &b.s6_addr[12], sizeof(low_b));
+        diff = static_cast<long long>(ntohl(low_a)) - ntohl(low_b);
+    }
+
+    if (diff < 0 || diff >= m_settings.group_count) {
+        return -1;
+    }
+    return static_cast<int>(diff);
+}
+
+bool host_population::is_active() const
+{
+    return m_running && !m_stop;
+}
+
+void host_population::wait_for_send_slot()
+{
+    if (m_settings.rate == 0) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (m_next_send < now - std::chrono::seconds(1)) {
+        m_next_send = now; //do not catch up after a stall
+    }
+
+    m_next_send += std::chrono::nanoseconds(1000000000 / m_settings.rate);
+    if (m_next_send > now) {
+        std::this_thread::sleep_until(m_next_send);
+    }
+}
+
+void host_population::serve_queries()
+{
+    if (m_query_received.exchange(false)) {
+        ++m_queries;
+        m_response_cursor = 0;
+        m_response_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_query_max_resp.load());
+    }
+
+    //answer one host per call, the reports share the rate with the churn
+    while (m_response_cursor < m_settings.host_count && is_active()) {
+        unsigned int host = m_response_cursor++;
+        if (!m_host_groups[host].empty()) {
+            report_current_state(host);
+            if (std::chrono::steady_clock::now() > m_response_deadline) {
+                ++m_late_responses;
+            }
+            return;
+        }
+    }
+}
+
+void host_population::idle(std::chrono::milliseconds duration)
+{
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (is_active() && (duration.count() == 0 || std::chrono::steady_clock::now() < end)) {
+        if (m_response_cursor < m_settings.host_count || m_query_received) {
+            serve_queries();
+        } else {
+            std::this_thread::sleep_for(std::min(m_settings.poll_interval, std::chrono::milliseconds(10)));
+        }
+    }
+}
+
+void host_population::set_members(unsigned int group, bool join)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    group_state& gs = m_groups[group];
+
+    if (join) {
+        ++gs.members;
+        if (gs.members != 1) {
+            return;
+        }
+        ++m_active_groups;
+    } else {
+        --gs.members;
+        if (gs.members != 0) {
+            return;
+        }
+        --m_active_groups;
+    }
+
+    //the expected forwarding state changed
+    gs.pending = (gs.members > 0) != gs.observed;
+    gs.changed = std::chrono::steady_clock::now();
+}
+
+void host_population::join(unsigned int host, unsigned int group)
+{
+    m_host_groups[host].push_back(group);
+    set_members(group, true);
+
+    send_report(host, {std::make_pair(CHANGE_TO_EXCLUDE_MODE, group)});
+}
+
+void host_population::leave(unsigned int host, unsigned int group)
+{
+    auto& groups = m_host_groups[host];
+    groups.erase(std::find(std::begin(groups), std::end(groups), group));
+    set_members(group, false);
+
+    send_report(host, {std::make_pair(CHANGE_TO_INCLUDE_MODE, group)});
+}
+
+void host_population::zap(unsigned int host, unsigned int from, unsigned int to)
+{
+    auto& groups = m_host_groups[host];
+    *std::find(std::begin(groups), std::end(groups), from) = to;
+    set_members(from, false);
+    set_members(to, true);
+
+    //a channel change is one report with two records, or a leave and a report for the older versions
+    send_report(host, {std::make_pair(CHANGE_TO_INCLUDE_MODE, from), std::make_pair(CHANGE_TO_EXCLUDE_MODE, to)});
+}
+
+void host_population::join_all()
+{
+    HC_LOG_TRACE("");
+
+    for (unsigned int h = 0; h < m_settings.host_count && is_active(); ++h) {
+        for (unsigned int k = 0; k < m_settings.groups_per_host; ++k) {
+            join(h, (h * m_settings.groups_per_host + k) % m_settings.group_count);
+        }
+        serve_queries();
+    }
+}
+
+void host_population::leave_all()
+{
+    HC_LOG_TRACE("");
+
+    for (unsigned int h = 0; h < m_settings.host_count && is_active(); ++h) {
+        while (!m_host_groups[h].empty()) {
+            leave(h, m_host_groups[h].back());
+        }
+        serve_queries();
+    }
+}
+
+void host_population::report_current_state(unsigned int host)
+{
+    std::vector<std::pair<mcast_addr_record_type, unsigned int>> records;
+    for (auto e : m_host_groups[host]) {
+        records.push_back(std::make_pair(MODE_IS_EXCLUDE, e));
+    }
+    send_report(host, records);
+}
+
+void host_population::send_report(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records)
+{
+    if (records.empty()) {
+        return;
+    }
+
+    std::size_t max_records;
+    if (m_settings.version == IGMPv2 || m_settings.version == MLDv1) {
+        max_records = 1; //one group per message
+    } else if (m_addr_family == AF_INET) {
+        max_records = (HOST_POPULATION_MTU - sizeof(ip) - sizeof(router_alert_option) - sizeof(igmpv3_mc_report)) / sizeof(igmpv3_mc_record);
+    } else {
+        max_records = (HOST_POPULATION_MTU - sizeof(ip6_hdr) - HOST_POPULATION_IP6_HBH_SIZE - sizeof(mldv2_mc_report)) / sizeof(mldv2_mc_record);
+    }
+
+    for (std::size_t i = 0; i < records.size(); i += max_records) {
+        std::vector<std::pair<mcast_addr_record_type, unsigned int>> part(records.begin() + i, records.begin() + std::min(records.size(), i + max_records));
+
+        wait_for_send_slot();
+        bool rc = m_addr_family == AF_INET ? send_igmp(host, part) : send_mld(host, part);
+        if (rc) {
+            ++m_reports_sent;
+        } else {
+            ++m_send_failures;
+        }
+    }
+}
+
+bool host_population::send_igmp(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records)
+{
+    const unsigned int header_size = sizeof(ip) + sizeof(router_alert_option);
+    const bool v2 = m_settings.version == IGMPv2;
+    unsigned int size = header_size + (v2 ? sizeof(igmp) : sizeof(igmpv3_mc_report) + records.size() * sizeof(igmpv3_mc_record));
+    std::vector<unsigned char> packet(size, 0);
+    addr_storage dst;
+
+    unsigned char* payload = packet.data() + header_size;
+    if (v2) {
+        const bool is_leave = records.front().first == CHANGE_TO_INCLUDE_MODE;
+        dst = is_leave ? addr_storage(std::string(IPV4_ALL_IGMP_ROUTERS_ADDR)) : get_group_addr(records.front().second);
+
+        igmp* msg = reinterpret_cast<igmp*>(payload);
+        msg->igmp_type = is_leave ? IGMP_V2_LEAVE_GROUP : IGMP_V2_MEMBERSHIP_REPORT;
+        msg->igmp_group = get_group_addr(records.front().second).get_in_addr();
+        msg->igmp_cksum = mroute_socket::checksum_fold(mroute_socket::checksum_add(0, payload, sizeof(igmp)));
+    } else {
+        dst = addr_storage(std::string(IPV4_IGMPV3_ADDR));
+
+        igmpv3_mc_report* report = reinterpret_cast<igmpv3_mc_report*>(payload);
+        report->type = IGMP_V3_MEMBERSHIP_REPORT;
+        report->num_of_mc_records = htons(records.size());
+
+        igmpv3_mc_record* rec = reinterpret_cast<igmpv3_mc_record*>(payload + sizeof(igmpv3_mc_report));
+        for (auto & e : records) {
+            rec->type = e.first;
+            rec->gaddr = get_group_addr(e.second).get_in_addr();
+            ++rec;
+        }
+        report->checksum = mroute_socket::checksum_fold(mroute_socket::checksum_add(0, payload, size - header_size));
+    }
+
+    ip* ip_hdr = reinterpret_cast<ip*>(packet.data());
+    ip_hdr->ip_v = 4;
+    ip_hdr->ip_hl = header_size / 4;
+    ip_hdr->ip_tos = 0xc0; //internetwork control
+    ip_hdr->ip_len = htons(size);
+    ip_hdr->ip_ttl = 1;
+    ip_hdr->ip_p = IPPROTO_IGMP;
+    ip_hdr->ip_src = get_host_addr(host).get_in_addr();
+    ip_hdr->ip_dst = dst.get_in_addr();
+    *reinterpret_cast<router_alert_option*>(packet.data() + sizeof(ip)) = router_alert_option();
+    ip_hdr->ip_sum = mroute_socket::checksum_fold(mroute_socket::checksum_add(0, packet.data(), header_size));
+
+    return m_send_sock.send_packet(dst, packet.data(), packet.size());
+}
+
+bool host_population::send_mld(unsigned int host, const std::vector<std::pair<mcast_addr_record_type, unsigned int>>& records)
+{
+    const unsigned int header_size = sizeof(ip6_hdr) + HOST_POPULATION_IP6_HBH_SIZE;
+    const bool v1 = m_settings.version == MLDv1;
+    unsigned int payload_size = v1 ? sizeof(mldv1) : sizeof(mldv2_mc_report) + records.size() * sizeof(mldv2_mc_record);
+    std::vector<unsigned char> packet(header_size + payload_size, 0);
+    addr_storage dst;
+
+    unsigned char* payload = packet.data() + header_size;
+    if (v1) {
+        const bool is_leave = records.front().first == CHANGE_TO_INCLUDE_MODE;
+        dst = is_leave ? addr_storage(std::string(IPV6_ALL_LINK_LOCAL_ROUTER)) : get_group_addr(records.front().second);
+
+        mldv1* msg = reinterpret_cast<mldv1*>(payload);
+        msg->type = is_leave ? MLD_LISTENER_REDUCTION : MLD_LISTENER_REPORT;
+        msg->gaddr = get_group_addr(records.front().second).get_in6_addr();
+    } else {
+        dst = addr_storage(std::string(IPV6_ALL_MLDv2_CAPABLE_ROUTERS));
+
+        mldv2_mc_report* report = reinterpret_cast<mldv2_mc_report*>(payload);
+        report->type = MLD_V2_LISTENER_REPORT;
+        report->num_of_mc_records = htons(records.size());
+
+        mldv2_mc_record* rec = reinterpret_cast<mldv2_mc_record*>(payload + sizeof(mldv2_mc_report));
+        for (auto & e : records) {
+            rec->type = e.first;
+            rec->gaddr = get_group_addr(e.second).get_in6_addr();
+            ++rec;
+        }
+    }
+
+    ip6_hdr* ip6 = reinterpret_cast<ip6_hdr*>(packet.data());
+    ip6->ip6_flow = htonl(6 << 28);
+    ip6->ip6_plen = htons(HOST_POPULATION_IP6_HBH_SIZE + payload_size);
+    ip6->ip6_nxt = IPPROTO_HOPOPTS;
+    ip6->ip6_hlim = 1;
+    ip6->ip6_src = get_host_addr(host).get_in6_addr();
+    ip6->ip6_dst = dst.get_in6_addr();
+
+    //RFC 2711 router alert (MLD) followed by a PadN option
+    unsigned char* hbh = packet.data() + sizeof(ip6_hdr);
+    hbh[0] = IPPROTO_ICMPV6;
+    hbh[1] = 0;
+    hbh[2] = IP6OPT_ROUTER_ALERT;
+    hbh[3] = 2;
+    hbh[6] = IP6OPT_PADN;
+
+    //the checksum covers the pseudo header of RFC 2460 section 8.1
+    uint32_t upper_len = htonl(payload_size);
+    uint32_t next_hdr = htonl(IPPROTO_ICMPV6);
+    uint64_t sum = mroute_socket::checksum_add(0, reinterpret_cast<unsigned char*>(&ip6->ip6_src), 2 * sizeof(in6_addr));
+    sum = mroute_socket::checksum_add(sum, reinterpret_cast<unsigned char*>(&upper_len), sizeof(upper_len));
+    sum = mroute_socket::checksum_add(sum, reinterpret_cast<unsigned char*>(&next_hdr), sizeof(next_hdr));
+    sum = mroute_socket::checksum_add(sum, payload, payload_size);
+    reinterpret_cast<icmp6_hdr*>(payload)->icmp6_cksum = mroute_socket::checksum_fold(sum);
+
+    return m_send_sock.send_packet(dst, packet.data(), packet.size());
+}
+
+bool host_population::read_routes(std::vector<bool>& forwarded) const
+{
+    std::ifstream file(m_addr_family == AF_INET ? "/proc/net/ip_mr_cache" : "/proc/net/ip6_mr_cache");
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    std::getline(file, line); //header
+    while (std::getline(file, line)) {
+        //Group Origin Iif Pkts Bytes Wrong Oifs(vif:ttl ...)
+        std::istringstream iss(line);
+        std::string group;
+        std::string token;
+        iss >> group;
+        for (int i = 0; i < 5 && iss >> token; ++i) {}
+
+        bool has_oif = false;
+        while (iss >> token) {
+            has_oif |= token.find(':') != std::string::npos;
+        }
+        if (!has_oif) {
+            continue;
+        }
+
+        addr_storage gaddr;
+        if (m_addr_family == AF_INET) {
+            in_addr addr;
+            addr.s_addr = static_cast<uint32_t>(std::stoul(group, nullptr, 16)); //printed in network byte order
+            gaddr = addr;
+        } else {
+            gaddr = group;
+        }
+
+        int index = get_group_index(gaddr);
+        if (index >= 0) {
+            forwarded[index] = true;
+        }
+    }
+
+    return true;
+}
+
+void host_population::monitor_routes()
+{
+    HC_LOG_TRACE("");
+
+    std::vector<bool> forwarded(m_settings.group_count);
+    while (!m_stop) {
+        std::fill(std::begin(forwarded), std::end(forwarded), false);
+        if (!read_routes(forwarded)) {
+            std::cout << "failed to read the multicast forwarding cache" << std::endl;
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        unsigned long active;
+        unsigned long observed = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (unsigned int i = 0; i < m_groups.size(); ++i) {
+                group_state& gs = m_groups[i];
+                if (gs.observed != forwarded[i] && gs.pending && (gs.members > 0) == forwarded[i]) {
+                    double latency = std::chrono::duration_cast<std::chrono::microseconds>(now - gs.changed).count() / 1000.0;
+                    (forwarded[i] ? m_install_latencies : m_removal_latencies).push_back(latency);
+                    gs.pending = false;
+                }
+                gs.observed = forwarded[i];
+                observed += forwarded[i];
+            }
+            active = m_active_groups;
+        }
+
+        if (m_settings.print_status_msg) {
+            std::cout << "\rreports: " << m_reports_sent << "; groups with members: " << active << "; forwarded groups: " << observed << "    ";
+            std::flush(std::cout);
+        }
+
+        std::this_thread::sleep_for(m_settings.poll_interval);
+    }
+}
+
+void host_population::listen_queries()
+{
+    HC_LOG_TRACE("");
+
+    std::vector<unsigned char> buf(HOST_POPULATION_RECV_SIZE);
+    struct timeval t = {0, 100000};
+    setsockopt(m_query_fd, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof(t));
+
+    while (!m_stop) {
+        ssize_t size = recv(m_query_fd, buf.data(), buf.size(), 0);
+        if (size <= 0) {
+            continue;
+        }
+
+        long long max_resp;
+        if (m_addr_family == AF_INET) {
+            const ip* ip_hdr = reinterpret_cast<const ip*>(buf.data());
+            unsigned int offset = ip_hdr->ip_hl * 4;
+            if (size < static_cast<ssize_t>(offset + sizeof(igmp))) {
+                continue;
+            }
+
+            const igmp* query = reinterpret_cast<const igmp*>(buf.data() + offset);
+            if (query->igmp_type != IGMP_MEMBERSHIP_QUERY || query->igmp_group.s_addr != 0) {
+                continue; //only general queries
+            }
+
+            if (size >= static_cast<ssize_t>(offset + sizeof(igmpv3_query))) {
+                max_resp = decode_float(query->igmp_code, 128, 3, 4) * 100;
+            } else {
+                max_resp = query->igmp_code == 0 ? 10000 : query->igmp_code * 100; //IGMPv1 has no maximum response time
+            }
+        } else {
+            if (size < static_cast<ssize_t>(sizeof(mldv1))) {
+                continue;
+            }
+
+            const mldv1* query = reinterpret_cast<const mldv1*>(buf.data());
+            in6_addr gaddr = query->gaddr;
+            if (query->type != MLD_LISTENER_QUERY || !IN6_IS_ADDR_UNSPECIFIED(&gaddr)) {
+                continue;
+            }
+
+            if (size >= static_cast<ssize_t>(sizeof(mldv2_query))) {
+                max_resp = decode_float(ntohs(query->max_resp_delay), 32768, 3, 12);
+            } else {
+                max_resp = ntohs(query->max_resp_delay);
+            }
+        }
+
+        m_query_max_resp = max_resp;
+        m_query_received = true;
+    }
+}
+
+void host_population::send_traffic()
+{
+    HC_LOG_TRACE("");
+
+    mc_socket ms;
+    bool rc = m_addr_family == AF_INET ? ms.create_udp_ipv4_socket() : ms.create_udp_ipv6_socket();
+    if (!rc || !ms.choose_if(interfaces::get_if_index(m_settings.source_if_name)) || !ms.set_ttl(m_settings.ttl)) {
+        std::cout << "failed to prepare the source socket on interface " << m_settings.source_if_name << std::endl;
+        return;
+    }
+
+    const std::string data = "host population";
+    while (!m_stop) {
+        for (unsigned int g = 0; g < m_settings.group_count && !m_stop; ++g) {
+            ms.send_packet(get_group_addr(g).set_port(m_settings.port), data);
+        }
+        std::this_thread::sleep_for(m_settings.source_interval);
+    }
+}
+
+void host_population::print_latencies(const std::string& name, std::vector<double>& latencies, unsigned long pending) const
+{
+    std::sort(std::begin(latencies), std::end(latencies));
+    double sum = 0;
+    for (auto e : latencies) {
+        sum += e;
+    }
+
+    std::cout << name << " latency(ms)==> samples(#): " << latencies.size();
+    if (!latencies.empty()) {
+        std::cout << "; min: " << latencies.front() << "; avg: " << sum / latencies.size() << "; p50: " << get_percentile(latencies, 0.5) << "; p90: " << get_percentile(latencies, 0.9) << "; p99: " << get_percentile(latencies, 0.99) << "; max: " << latencies.back();
+    }
+    std::cout << "; pending(#): " << pending << std::endl;
+}
+
+void host_population::run()
+{
+    HC_LOG_TRACE("");
+
+    std::cout << "emulate " << m_settings.host_count << " " << get_group_mem_protocol_name(m_settings.version) << " hosts from " << m_settings.first_host << " with " << m_settings.groups_per_host << " of " << m_settings.group_count << " groups from " << m_settings.first_group << " on interface " << m_settings.if_name << std::endl;
+    if (m_settings.source_if_name.empty()) {
+        std::cout << "no source_interface, only forwarding entries of foreign traffic can be observed" << std::endl;
+    }
+
+    m_monitor_thread = std::thread(&host_population::monitor_routes, this);
+    if (m_settings.answer_queries) {
+        m_query_thread = std::thread(&host_population::listen_queries, this);
+    }
+    if (!m_settings.source_if_name.empty()) {
+        m_source_thread = std::thread(&host_population::send_traffic, this);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    m_next_send = start;
+    unsigned long count = 0;
+
+    switch (m_settings.pattern) {
+    case HP_JOIN:
+        join_all();
+        idle(std::chrono::milliseconds(0));
+        break;
+    case HP_ZAPPING: {
+        join_all();
+        std::uniform_int_distribution<unsigned int> host_dist(0, m_settings.host_count - 1);
+        std::uniform_int_distribution<unsigned int> group_dist(0, m_settings.group_count - 1);
+        for (; is_active() && (m_settings.max_count == 0 || count < m_settings.max_count); ++count) {
+            unsigned int host = host_dist(m_rand);
+            auto& groups = m_host_groups[host];
+            unsigned int from = groups[m_rand() % groups.size()];
+            unsigned int to;
+            do {
+                to = group_dist(m_rand);
+            } while (std::find(std::begin(groups), std::end(groups), to) != std::end(groups));
+            zap(host, from, to);
+            serve_queries();
+        }
+        idle(m_settings.hold_time);
+        break;
+    }
+    case HP_LEAVE_STORM:
+        for (; is_active() && (m_settings.max_count == 0 || count < m_settings.max_count); ++count) {
+            join_all();
+            idle(m_settings.hold_time);
+            leave_all();
+            idle(m_settings.hold_time);
+        }
+        break;
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    m_stop = true;
+    for (auto t : {&m_monitor_thread, &m_query_thread, &m_source_thread}) {
+        if (t->joinable()) {
+            t->join();
+        }
+    }
+
+    if (m_settings.print_status_msg) {
+        std::cout << std::endl;
+    }
+
+    unsigned long pending_installs = 0;
+    unsigned long pending_removals = 0;
+    for (auto & e : m_groups) {
+        if (e.pending) {
+            ++(e.members > 0 ? pending_installs : pending_removals);
+        }
+    }
+
+    std::cout << "summary==> reports(#): " << m_reports_sent << "; send failures(#): " << m_send_failures << "; churn events(#): " << count << "; duration(ms): " << duration << "; reports per sec: " << (duration > 0 ? m_reports_sent * 1000 / duration : 0) << "; general queries(#): " << m_queries << "; late responses(#): " << m_late_responses << std::endl;
+    print_latencies("install", m_install_latencies, pending_installs);
+    print_latencies("removal", m_removal_latencies, pending_removals);
+}
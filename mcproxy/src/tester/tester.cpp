@@ -23,6 +23,7 @@
 
 #include "include/hamcast_logging.h"
 #include "include/tester/tester.hpp"
+#include "include/tester/host_population.hpp"
 #include "include/utils/mc_socket.hpp"
 #include "include/proxy/interfaces.hpp"
 
@@ -75,8 +76,7 @@ int high_pres_usleep(unsigned long long int delay) //minimum delay about 7usec
     return 0;
 }
 
-packet_manager::packet_manager(unsigned int max_count)
-    : m_max_count(max_count)
+packet_manager::packet_manager()
 {
     HC_LOG_TRACE("");
 }
@@ -84,15 +84,7 @@ packet_manager::packet_manager(unsigned int max_count)
 bool packet_manager::is_packet_new(long packet_number)
 {
     HC_LOG_TRACE("");
-    auto result = m_data.insert(packet_number);
-    if (result.second) {
-        if (m_data.size() > m_max_count) {
-            m_data.erase(m_data.begin());
-        }
-        return true;
-    } else {
-        return false;
-    }
+    return m_window.add(packet_number) != sequence_window::SW_DUPLICATED;
 }
 
 tester::tester(int arg_count, char* args[])
@@ -155,7 +147,7 @@ tester::tester(int arg_count, char* args[])
         m_config_map.read_ini(config_file);
     }
 
-    packet_manager pmanager(1000);
+    packet_manager pmanager;
     run(to_do, output_file, 0, pmanager, msg);
 }
 
@@ -188,11 +180,32 @@ void tester::help()
     cout << "\t\tSet the message to be send (this doesn't include the" << endl;
     cout << "\t\tpacket number (9 chars) plus one escape char add the end of the string)" << endl;
 
+    cout << endl;
+    cout << "\taction=hosts" << endl;
+    cout << "\t\tEmulate host_count hosts (spoofed addresses from first_host on) that send" << endl;
+    cout << "\t\tIGMPv2/v3 or MLDv1/v2 reports over a raw socket at rate reports per second" << endl;
+    cout << "\t\twith the pattern join, zapping or leave_storm and answer general queries." << endl;
+    cout << "\t\tPrints how long the proxy takes to install and remove the forwarding" << endl;
+    cout << "\t\tentries of /proc/net/ip_mr_cache or ip6_mr_cache (default table only)." << endl;
+
+    cout << endl;
+    cout << "\taction=data_send" << endl;
+    cout << "\t\tSend numbered and time stamped packets to group_count groups (from group on)" << endl;
+    cout << "\t\tround robin over one socket in batches of batch packets (sendmmsg) at rate" << endl;
+    cout << "\t\tpackets per second." << endl;
+
+    cout << endl;
+    cout << "\taction=data_receive" << endl;
+    cout << "\t\tJoin group_count groups on one socket, receive in batches (recvmmsg) and print" << endl;
+    cout << "\t\tper group the throughput, loss, reordering, join to first packet time and" << endl;
+    cout << "\t\tone-way latency (sender and receiver need synchronized clocks)." << endl;
+
     cout << endl;
     cout << "\tfor example:" << endl;
     cout << "\t\t./tester send" << endl;
     cout << "\t\t./tester recv -i tester.ini" << endl;
     cout << "\t\t./tester send_a_hallo -i tester.ini -o logfile" << endl;
+    cout << "\t\t./tester zapping4 -i tester.ini" << endl;
 }
 
 addr_storage tester::get_gaddr(const std::string& to_do)
@@ -470,6 +483,96 @@ std::string tester::get_to_do_next(const std::string& to_do)
     return to_do_next;
 }
 
+host_population_settings tester::get_host_population_settings(const std::string& to_do, const std::string& if_name, const addr_storage& gaddr)
+{
+    HC_LOG_TRACE("");
+
+    host_population_settings result;
+    result.if_name = if_name;
+    result.first_group = gaddr;
+
+    std::string version = m_config_map.get(to_do, "version");
+    if (version.empty()) {
+        result.version = gaddr.get_addr_family() == AF_INET ? IGMPv3 : MLDv2;
+    } else if (version.compare("IGMPv2") == 0) {
+        result.version = IGMPv2;
+    } else if (version.compare("IGMPv3") == 0) {
+        result.version = IGMPv3;
+    } else if (version.compare("MLDv1") == 0) {
+        result.version = MLDv1;
+    } else if (version.compare("MLDv2") == 0) {
+        result.version = MLDv2;
+    } else {
+        std::cout << version << " is not a version" << std::endl;
+        exit(0);
+    }
+
+    std::string first_host = m_config_map.get(to_do, "first_host");
+    if (first_host.empty()) {
+        std::cout << "no first_host found" << std::endl;
+        exit(0);
+    }
+    result.first_host = first_host;
+    if (result.first_host.get_addr_family() != gaddr.get_addr_family()) {
+        std::cout << "first_host is not an ip address or has the wrong ip version" << std::endl;
+        exit(0);
+    }
+
+    std::string pattern = m_config_map.get(to_do, "pattern");
+    if (pattern.empty() || pattern.compare("join") == 0) {
+        result.pattern = HP_JOIN;
+    } else if (pattern.compare("zapping") == 0) {
+        result.pattern = HP_ZAPPING;
+    } else if (pattern.compare("leave_storm") == 0) {
+        result.pattern = HP_LEAVE_STORM;
+    } else {
+        std::cout << pattern << " is not a pattern" << std::endl;
+        exit(0);
+    }
+
+    result.source_if_name = m_config_map.get(to_do, "source_interface");
+    if (!result.source_if_name.empty() && interfaces::get_if_index(result.source_if_name) == 0) {
+        std::cout << "interface " << result.source_if_name << " not found" << std::endl;
+        exit(0);
+    }
+
+    result.host_count = get_int(to_do, "host_count", result.host_count);
+    result.group_count = get_int(to_do, "group_count", result.group_count);
+    result.groups_per_host = get_int(to_do, "groups_per_host", result.groups_per_host);
+    result.rate = get_int(to_do, "rate", result.rate);
+    result.max_count = get_max_count(to_do);
+    result.hold_time = std::chrono::milliseconds(get_int(to_do, "hold_time", result.hold_time.count()));
+    result.answer_queries = get_boolean(to_do, "answer_queries", result.answer_queries);
+    result.poll_interval = std::chrono::milliseconds(get_int(to_do, "poll_interval", result.poll_interval.count()));
+    result.source_interval = std::chrono::milliseconds(get_int(to_do, "source_interval", result.source_interval.count()));
+    result.ttl = get_int(to_do, "ttl", result.ttl);
+    result.port = get_int(to_do, "port", result.port);
+    result.seed = get_int(to_do, "seed", result.seed);
+    result.print_status_msg = get_boolean(to_do, "print_status_msg", result.print_status_msg);
+
+    return result;
+}
+
+data_plane_settings tester::get_data_plane_settings(const std::string& to_do, const std::string& if_name, const addr_storage& gaddr)
+{
+    HC_LOG_TRACE("");
+
+    data_plane_settings result;
+    result.if_name = if_name;
+    result.first_group = gaddr;
+
+    result.group_count = get_int(to_do, "group_count", result.group_count);
+    result.port = get_int(to_do, "port", result.port);
+    result.payload_size = get_int(to_do, "payload_size", result.payload_size);
+    result.rate = get_int(to_do, "rate", result.rate);
+    result.batch = get_int(to_do, "batch", result.batch);
+    result.max_count = get_max_count(to_do);
+    result.ttl = get_int(to_do, "ttl", result.ttl);
+    result.print_status_msg = get_boolean(to_do, "print_status_msg", result.print_status_msg);
+
+    return result;
+}
+
 void tester::receive_data(const std::unique_ptr<const mc_socket>& ms, int port, const addr_storage& gaddr, unsigned long max_count, bool parse_time_stamp, bool print_status_msg, bool save_to_file, const std::string& file_name, bool include_file_header, bool include_data, bool include_summary, bool ignore_duplicated_packets, packet_manager& pmanager, const std::string& file_operation_mode)
 {
     HC_LOG_TRACE("");
@@ -806,6 +909,40 @@ void tester::run(const std::string& to_do, const std::string& output_file, unsig
             run(to_do_next, output_file, current_packet_number, pmanager, send_msg);
         }
 
+        return;
+    } else if (action.compare("hosts") == 0) {
+        ms->close_socket();
+        try {
+            host_population hp(get_host_population_settings(to_do, if_name, gaddr), m_running);
+            hp.run();
+        } catch (const char* e) {
+            std::cout << e << std::endl;
+            exit(0);
+        }
+
+        if (to_do_next.compare("null") != 0) {
+            run(to_do_next, output_file, current_packet_number, pmanager, send_msg);
+        }
+
+        return;
+    } else if (action.compare("data_send") == 0 || action.compare("data_receive") == 0) {
+        ms->close_socket();
+        try {
+            data_plane dp(get_data_plane_settings(to_do, if_name, gaddr), m_running);
+            if (action.compare("data_send") == 0) {
+                dp.send();
+            } else {
+                dp.receive();
+            }
+        } catch (const char* e) {
+            std::cout << e << std::endl;
+            exit(0);
+        }
+
+        if (to_do_next.compare("null") != 0) {
+            run(to_do_next, output_file, current_packet_number, pmanager, send_msg);
+        }
+
         return;
     } else {
         std::cout << "action " << action << " not available" << std::endl;
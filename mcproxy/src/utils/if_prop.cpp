@@ -47,19 +47,34 @@ bool if_prop::refresh_network_interfaces()
     }
 
     m_if_map.clear();
+    m_if_index_props.clear();
 
     //create
     if (getifaddrs(&m_if_addrs) < 0) {
         HC_LOG_ERROR("getifaddrs failed! Error: " << strerror(errno) );
+        m_if_addrs = nullptr;
         return false;
     }
 
+    //if_name, if_index
+    std::map<std::string, unsigned int> if_indexes;
+
     struct ifaddrs* ifEntry = nullptr;
     for (ifEntry = m_if_addrs; ifEntry != nullptr; ifEntry = ifEntry->ifa_next) {
         if (ifEntry->ifa_addr == nullptr || ifEntry->ifa_addr->sa_data == nullptr) {
             continue;
         }
 
+        if (ifEntry->ifa_addr->sa_family == AF_INET || ifEntry->ifa_addr->sa_family == AF_INET6) {
+            auto it = if_indexes.find(ifEntry->ifa_name);
+            if (it == std::end(if_indexes)) {
+                it = if_indexes.insert(std::make_pair(std::string(ifEntry->ifa_name), if_nametoindex(ifEntry->ifa_name))).first;
+            }
+            if (it->second != 0) {
+                add_if_index_prop(it->second, ifEntry);
+            }
+        }
+
         if (ifEntry->ifa_addr->sa_family == AF_INET) {
             if_prop_map::iterator iter = m_if_map.find(ifEntry->ifa_name);
             if (iter != m_if_map.end()) { //existing interface
@@ -90,6 +105,39 @@ bool if_prop::refresh_network_interfaces()
     return true;
 }
 
+void if_prop::add_if_index_prop(unsigned int if_index, const struct ifaddrs* if_p)
+{
+    HC_LOG_TRACE("");
+
+    if (if_index >= m_if_index_props.size()) {
+        m_if_index_props.resize(if_index + 1);
+    }
+
+    if_index_prop& prop = m_if_index_props[if_index];
+    if (prop.name.empty()) {
+        prop.name = if_p->ifa_name;
+        prop.flags = if_p->ifa_flags;
+    }
+
+    if_addr_prop addr;
+    addr.addr = addr_storage(*if_p->ifa_addr);
+    if (if_p->ifa_netmask != nullptr) {
+        addr.netmask = addr_storage(*if_p->ifa_netmask);
+    }
+    if ((if_p->ifa_flags & IFF_POINTOPOINT) && if_p->ifa_dstaddr != nullptr) {
+        addr.dstaddr = addr_storage(*if_p->ifa_dstaddr);
+    }
+
+    if (if_p->ifa_addr->sa_family == AF_INET) {
+        if (!prop.has_ip4) {
+            prop.has_ip4 = true;
+            prop.ip4 = addr;
+        }
+    } else {
+        prop.ip6.push_back(addr);
+    }
+}
+
 const if_prop_map* if_prop::get_if_props() const
 {
     HC_LOG_TRACE("");
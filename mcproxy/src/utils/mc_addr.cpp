@@ -0,0 +1,89 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/utils/mc_addr.hpp"
+
+mc_addr::mc_addr(const addr_storage& addr)
+    : m_family(AF_UNSPEC)
+{
+    std::memset(m_words, 0, sizeof(m_words));
+
+    if (addr.get_addr_family() == AF_INET) {
+        m_family = AF_INET;
+        m_in = addr.get_in_addr();
+    } else if (addr.get_addr_family() == AF_INET6) {
+        m_family = AF_INET6;
+        m_in6 = addr.get_in6_addr();
+    }
+}
+
+mc_addr::mc_addr(const in_addr& addr)
+    : m_family(AF_INET)
+{
+    std::memset(m_words, 0, sizeof(m_words));
+    m_in = addr;
+}
+
+mc_addr::mc_addr(const in6_addr& addr)
+    : m_family(AF_INET6)
+{
+    m_in6 = addr;
+}
+
+mc_addr::mc_addr(const std::string& addr)
+    : mc_addr(addr_storage(addr))
+{
+}
+
+mc_addr::operator addr_storage() const
+{
+    if (m_family == AF_INET) {
+        return addr_storage(m_in);
+    } else if (m_family == AF_INET6) {
+        return addr_storage(m_in6);
+    } else {
+        return addr_storage();
+    }
+}
+
+bool mc_addr::is_multicast_addr() const
+{
+    if (m_family == AF_INET) {
+        return IN_MULTICAST(ntohl(m_in.s_addr));
+    } else if (m_family == AF_INET6) {
+        return IN6_IS_ADDR_MULTICAST(&m_in6);
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
+}
+
+std::string mc_addr::to_string() const
+{
+    return static_cast<addr_storage>(*this).to_string();
+}
+
+std::ostream& operator<<(std::ostream& s, const mc_addr& a)
+{
+    return s << a.to_string();
+}
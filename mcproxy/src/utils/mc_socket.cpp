@@ -24,6 +24,7 @@
 #include "include/utils/mc_socket.hpp"
 
 #include <netpacket/packet.h>
+#include <linux/filter.h>
 #include <cstring> //memset
 #include <iostream>
 #include <memory> //unique_ptr
@@ -421,6 +422,71 @@ bool mc_socket::receive_msg(struct msghdr* msg, int& sizeOfInfo) const
     //     //#######################
 }
 
+bool mc_socket::receive_mmsg(struct mmsghdr* msgvec, unsigned int vlen, int& received) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("udp_socket invalid");
+        return false;
+    }
+
+    int rc;
+    rc = recvmmsg(m_sock, msgvec, vlen, MSG_DONTWAIT, nullptr);
+    received = rc;
+    if (rc == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            received = 0;
+            return true;
+        } else {
+            HC_LOG_ERROR("failed to receive msgs Error: " << strerror(errno)  << " errno: " << errno);
+            return false;
+        }
+    } else {
+        return true;
+    }
+}
+
+bool mc_socket::send_mmsg(struct mmsghdr* msgvec, unsigned int vlen, int& sent) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("udp_socket invalid");
+        return false;
+    }
+
+    int rc;
+    rc = sendmmsg(m_sock, msgvec, vlen, 0);
+    if (rc == -1) {
+        sent = 0;
+        HC_LOG_ERROR("failed to send msgs Error: " << strerror(errno)  << " errno: " << errno);
+        return false;
+    } else {
+        sent = rc;
+        return true;
+    }
+}
+
+bool mc_socket::attach_filter(const struct sock_fprog* prog) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("udp_socket invalid");
+        return false;
+    }
+
+    int rc = setsockopt(m_sock, SOL_SOCKET, SO_ATTACH_FILTER, prog, sizeof(*prog));
+
+    if (rc == -1) {
+        HC_LOG_ERROR("failed to attach socket filter! Error: " << strerror(errno)  << " errno: " << errno);
+        return false;
+    } else {
+        return true;
+    }
+}
+
 bool mc_socket::set_receive_timeout(long msec) const
 {
     HC_LOG_TRACE("");
@@ -496,6 +562,30 @@ bool mc_socket::choose_if(uint32_t if_index) const
     }
 }
 
+bool mc_socket::get_mtu(uint32_t if_index, unsigned int& mtu) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("udp_socket invalid");
+        return false;
+    }
+
+    struct ifreq ifreq;
+    if (if_indextoname(if_index, ifreq.ifr_name) == nullptr) {
+        HC_LOG_ERROR("failed to get interface name! if_index:" << if_index << "! Error: " << strerror(errno)  << " errno: " << errno);
+        return false;
+    }
+
+    if (ioctl(m_sock, SIOCGIFMTU, &ifreq) < 0) {
+        HC_LOG_ERROR("failed to get interface mtu! if_name: " << ifreq.ifr_name << "! Error: " << strerror(errno));
+        return false;
+    }
+
+    mtu = ifreq.ifr_mtu;
+    return true;
+}
+
 bool mc_socket::set_ttl(int ttl) const
 {
     HC_LOG_TRACE("");
@@ -0,0 +1,229 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/utils/metrics.hpp"
+
+#include <sstream>
+#include <cstring>
+
+#include <net/if.h>
+
+namespace
+{
+struct metric_info {
+    const char* m_name;
+    const char* m_type;
+    const char* m_help;
+    const char* m_labels; //fixed labels of the metric
+    bool m_per_interface;
+};
+
+//indexed by metric_id, metrics of the same name have to follow each other
+const metric_info metric_infos[METRIC_COUNT] = {
+    {"mcproxy_packets_received_total", "counter", "Received membership reports, queries and kernel upcalls.", "", false},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"IS_IN\"", true},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"IS_EX\"", true},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"TO_IN\"", true},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"TO_EX\"", true},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"ALLOW\"", true},
+    {"mcproxy_records_received_total", "counter", "Received group records.", "type=\"BLOCK\"", true},
+    {"mcproxy_records_suppressed_total", "counter", "Duplicate current state records not sent to the queriers.", "", true},
+    {"mcproxy_records_limited_total", "counter", "Group records truncated or rejected by the membership limits.", "", true},
+    {"mcproxy_upcalls_total", "counter", "Kernel upcalls of new multicast sources.", "", true},
+    {"mcproxy_upcalls_dropped_total", "counter", "Kernel upcalls of pending sources or above the rate limit.", "", true},
+    {"mcproxy_queue_enqueued_total", "counter", "Messages added to the job queues.", "", false},
+    {"mcproxy_queue_dropped_total", "counter", "Messages dropped by full job queues.", "", false},
+    {"mcproxy_queue_depth", "gauge", "Messages waiting in the job queues.", "", false},
+    {"mcproxy_timers_pending", "gauge", "Pending reminders of the timer threads.", "", false},
+    {"mcproxy_timers_expired_total", "counter", "Expired reminders.", "", false},
+    {"mcproxy_timers_deferred_total", "counter", "Expired reminders a full job queue did not accept yet, counted per delivery attempt.", "", false},
+    {"mcproxy_routes_total", "counter", "Multicast route changes sent to the kernel.", "op=\"add\"", false},
+    {"mcproxy_routes_total", "counter", "Multicast route changes sent to the kernel.", "op=\"del\"", false},
+    {"mcproxy_routes_failed_total", "counter", "Multicast route changes refused by the kernel.", "", false},
+    {"mcproxy_route_syscalls_total", "counter", "System calls to change the multicast routes.", "", false},
+    {"mcproxy_packets_sent_total", "counter", "Sent reports and queries.", "", true},
+    {"mcproxy_send_failures_total", "counter", "Reports and queries that failed to be sent.", "", true},
+    {"mcproxy_membership_groups", "gauge", "Groups in the membership database.", "", true},
+    {"mcproxy_membership_sources", "gauge", "Requested and blocked sources in the membership database.", "", true},
+    {"mcproxy_membership_bytes", "gauge", "Estimated memory of the membership database.", "", true},
+};
+
+//indexed by latency_stage
+const char* latency_stage_names[LATENCY_STAGE_COUNT] = {"queue", "querier", "routing", "kernel", "upstream"};
+}
+
+thread_local metrics::block* metrics::m_block = nullptr;
+thread_local std::chrono::steady_clock::time_point metrics::m_origin;
+std::mutex metrics::m_blocks_lock;
+std::vector<std::unique_ptr<metrics::block>>* metrics::m_blocks = new std::vector<std::unique_ptr<metrics::block>>;
+
+const long long metrics::m_latency_bounds[METRICS_LATENCY_BUCKETS] = {
+#define METRICS_BOUNDS(usec) usec * 1000LL, usec * 1500LL
+    METRICS_BOUNDS(1), METRICS_BOUNDS(2), METRICS_BOUNDS(4), METRICS_BOUNDS(8), METRICS_BOUNDS(16), METRICS_BOUNDS(32),
+    METRICS_BOUNDS(64), METRICS_BOUNDS(128), METRICS_BOUNDS(256), METRICS_BOUNDS(512), METRICS_BOUNDS(1024), METRICS_BOUNDS(2048),
+    METRICS_BOUNDS(4096), METRICS_BOUNDS(8192), METRICS_BOUNDS(16384), METRICS_BOUNDS(32768), METRICS_BOUNDS(65536), METRICS_BOUNDS(131072),
+    METRICS_BOUNDS(262144), METRICS_BOUNDS(524288), METRICS_BOUNDS(1048576), METRICS_BOUNDS(2097152), METRICS_BOUNDS(4194304), METRICS_BOUNDS(8388608),
+    METRICS_BOUNDS(16777216), METRICS_BOUNDS(33554432), METRICS_BOUNDS(67108864)
+#undef METRICS_BOUNDS
+};
+
+metrics::block::block()
+{
+    for (auto & e : m_values) {
+        for (auto & v : e) {
+            v.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto & e : m_latencies) {
+        for (auto & v : e) {
+            v.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    for (auto & e : m_latency_sums) {
+        e.store(0, std::memory_order_relaxed);
+    }
+}
+
+void metrics::add_latency(latency_stage stage, std::chrono::steady_clock::duration latency)
+{
+    block* b = m_block != nullptr ? m_block : create_block();
+    long long nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+
+    unsigned int bucket = std::lower_bound(std::begin(m_latency_bounds), std::end(m_latency_bounds), nsec) - std::begin(m_latency_bounds);
+    std::atomic<long long>& v = b->m_latencies[stage][bucket];
+    v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    std::atomic<long long>& sum = b->m_latency_sums[stage];
+    sum.store(sum.load(std::memory_order_relaxed) + nsec, std::memory_order_relaxed);
+}
+
+metrics::block* metrics::create_block()
+{
+    std::unique_ptr<block> b(new block());
+    m_block = b.get();
+
+    std::lock_guard<std::mutex> lock(m_blocks_lock);
+    m_blocks->push_back(std::move(b));
+    return m_block;
+}
+
+long long metrics::get_value(metric_id id, unsigned int label)
+{
+    //m_blocks_lock has to be locked
+    long long result = 0;
+    for (auto & e : *m_blocks) {
+        result += e->m_values[id][label].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+long long metrics::get(metric_id id)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_blocks_lock);
+
+    long long result = 0;
+    for (unsigned int i = 0; i < METRICS_MAX_LABELS; ++i) {
+        result += get_value(id, i);
+    }
+    return result;
+}
+
+std::string metrics::to_string()
+{
+    HC_LOG_TRACE("");
+
+    std::ostringstream s;
+    std::lock_guard<std::mutex> lock(m_blocks_lock);
+
+    for (unsigned int id = 0; id < METRIC_COUNT; ++id) {
+        const metric_info& info = metric_infos[id];
+        if (id == 0 || std::strcmp(metric_infos[id - 1].m_name, info.m_name) != 0) {
+            s << "# HELP " << info.m_name << " " << info.m_help << std::endl;
+            s << "# TYPE " << info.m_name << " " << info.m_type << std::endl;
+        }
+
+        if (!info.m_per_interface) {
+            s << info.m_name;
+            if (*info.m_labels != '\0') {
+                s << "{" << info.m_labels << "}";
+            }
+            s << " " << get_value(static_cast<metric_id>(id), 0) << std::endl;
+            continue;
+        }
+
+        for (unsigned int label = 0; label < METRICS_MAX_LABELS; ++label) {
+            long long value = get_value(static_cast<metric_id>(id), label);
+            if (value == 0) {
+                continue;
+            }
+
+            char if_name[IF_NAMESIZE];
+            s << info.m_name << "{";
+            if (label == METRICS_MAX_LABELS - 1) {
+                s << "interface=\"other\"";
+            } else if (if_indextoname(label, if_name) != nullptr) {
+                s << "interface=\"" << if_name << "\"";
+            } else {
+                s << "interface=\"" << label << "\"";
+            }
+            if (*info.m_labels != '\0') {
+                s << "," << info.m_labels;
+            }
+            s << "} " << value << std::endl;
+        }
+    }
+
+    const char* name = "mcproxy_join_latency_seconds";
+    s << "# HELP " << name << " Time from the receipt of a group record until it passed a stage." << std::endl;
+    s << "# TYPE " << name << " histogram" << std::endl;
+    for (unsigned int stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        long long count = 0;
+        long long sum = 0;
+        for (auto & e : *m_blocks) {
+            sum += e->m_latency_sums[stage].load(std::memory_order_relaxed);
+        }
+
+        for (unsigned int bucket = 0; bucket <= METRICS_LATENCY_BUCKETS; ++bucket) {
+            for (auto & e : *m_blocks) {
+                count += e->m_latencies[stage][bucket].load(std::memory_order_relaxed);
+            }
+
+            s << name << "_bucket{stage=\"" << latency_stage_names[stage] << "\",le=\"";
+            if (bucket < METRICS_LATENCY_BUCKETS) {
+                s << m_latency_bounds[bucket] / 1e9;
+            } else {
+                s << "+Inf";
+            }
+            s << "\"} " << count << std::endl;
+        }
+
+        s << name << "_sum{stage=\"" << latency_stage_names[stage] << "\"} " << sum / 1e9 << std::endl;
+        s << name << "_count{stage=\"" << latency_stage_names[stage] << "\"} " << count << std::endl;
+    }
+
+    return s.str();
+}
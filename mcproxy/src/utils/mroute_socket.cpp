@@ -23,6 +23,8 @@
 #include "include/hamcast_logging.h"
 #include "include/utils/mroute_socket.hpp"
 #include "include/utils/extended_mld_defines.hpp"
+#include "include/utils/addr_family.hpp"
+#include "include/utils/metrics.hpp"
 
 #include <netinet/icmp6.h>
 #include <sys/socket.h>
@@ -32,14 +34,31 @@
 #include <arpa/inet.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <sys/utsname.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/fib_rules.h>
 
 #include <cstdlib>
+#include <cstdio>
 
 #include <cstring>
+#include <algorithm>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #include <iostream>
 #include <sstream>
 
 mroute_socket::mroute_socket()
+    : m_nl_sock(-1)
+    , m_nl_route_changes(false)
+    , m_nl_seq(0)
+    , m_table(RT_TABLE_DEFAULT)
 {
     HC_LOG_TRACE("");
 }
@@ -61,6 +80,7 @@ bool mroute_socket::create_raw_ipv4_socket()
         HC_LOG_DEBUG("get socket discriptor number: " << m_sock);
         m_addrFamily = AF_INET;
         m_own_socket = true;
+        open_route_netlink();
         return true;
     }
 
@@ -83,6 +103,7 @@ bool mroute_socket::create_raw_ipv6_socket()
         HC_LOG_DEBUG("get socket discriptor number: " << m_sock);
         m_addrFamily = AF_INET6;
         m_own_socket = true;
+        open_route_netlink();
         return true;
     }
 }
@@ -121,6 +142,7 @@ bool mroute_socket::set_kernel_table(int table) const
         return false;
     }
 
+    m_table = table;
     return true;
 }
 
@@ -154,21 +176,261 @@ bool mroute_socket::set_no_ip_hdr(bool enable) const
 u_int16_t mroute_socket::calc_checksum(const unsigned char* buf, int buf_size) const
 {
     HC_LOG_TRACE("");
+    return checksum_fold(checksum_add(0, buf, buf_size));
+}
+
+namespace
+{
+//ones' complement addition of 64 bit sums, the carry wraps around
+inline uint64_t add_with_carry(uint64_t a, uint64_t b)
+{
+    a += b;
+    return a + (a < b);
+}
 
-    u_int16_t* b = (u_int16_t*)buf;
-    int sum = 0;
+//sum of 16 bit words in 32 bit lanes, the lanes are emptied before they can overflow
+#define CHECKSUM_LANE_BLOCKS 16384
 
-    for (int i = 0; i < buf_size / 2; i++) {
-        ADD_SIGNED_NUM_U16(sum, b[i]);
-        //sum +=b[i];
+using checksum_kernel = uint64_t (*)(const unsigned char* buf, size_t blocks);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHECKSUM_SSE2_BLOCK 16
+#define CHECKSUM_AVX2_BLOCK 32
+
+__attribute__((target("sse2")))
+uint64_t checksum_sse2(const unsigned char* buf, size_t blocks)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+
+    while (blocks > 0) {
+        size_t n = std::min<size_t>(blocks, CHECKSUM_LANE_BLOCKS);
+        blocks -= n;
+
+        __m128i acc = zero;
+        for (; n > 0; --n, buf += CHECKSUM_SSE2_BLOCK) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+        }
+
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        for (auto l : lanes) {
+            sum += l;
+        }
     }
 
-    if (buf_size % 2 == 1) {
-        //sum += buf[buf_size-1];
-        ADD_SIGNED_NUM_U16(sum, buf[buf_size - 1]);
+    return sum;
+}
+
+__attribute__((target("avx2")))
+uint64_t checksum_avx2(const unsigned char* buf, size_t blocks)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+
+    while (blocks > 0) {
+        size_t n = std::min<size_t>(blocks, CHECKSUM_LANE_BLOCKS);
+        blocks -= n;
+
+        __m256i acc = zero;
+        for (; n > 0; --n, buf += CHECKSUM_AVX2_BLOCK) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf));
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+        }
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        for (auto l : lanes) {
+            sum += l;
+        }
     }
 
-    return ~sum;
+    return sum;
+}
+#elif defined(__aarch64__)
+#define CHECKSUM_NEON_BLOCK 16
+
+uint64_t checksum_neon(const unsigned char* buf, size_t blocks)
+{
+    uint64_t sum = 0;
+
+    while (blocks > 0) {
+        size_t n = std::min<size_t>(blocks, CHECKSUM_LANE_BLOCKS);
+        blocks -= n;
+
+        uint32x4_t acc = vdupq_n_u32(0);
+        for (; n > 0; --n, buf += CHECKSUM_NEON_BLOCK) {
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(buf)));
+        }
+
+        sum += vaddlvq_u32(acc);
+    }
+
+    return sum;
+}
+#endif
+
+struct checksum_simd {
+    checksum_kernel m_kernel;
+    size_t m_block;
+};
+
+//choose the widest kernel the cpu supports, a block size of 0 disables the simd path
+checksum_simd get_checksum_simd()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return checksum_simd {checksum_avx2, CHECKSUM_AVX2_BLOCK};
+    } else if (__builtin_cpu_supports("sse2")) {
+        return checksum_simd {checksum_sse2, CHECKSUM_SSE2_BLOCK};
+    }
+#elif defined(__aarch64__)
+    return checksum_simd {checksum_neon, CHECKSUM_NEON_BLOCK};
+#endif
+    return checksum_simd {nullptr, 0};
+}
+
+//sum buf with the simd kernel and the remaining bytes with wide words
+uint64_t checksum_add_simd(const checksum_simd& simd, uint64_t sum, const unsigned char* buf, size_t size)
+{
+    if (simd.m_block != 0 && size >= simd.m_block) {
+        size_t blocks = size / simd.m_block;
+        sum = add_with_carry(sum, simd.m_kernel(buf, blocks));
+        buf += blocks * simd.m_block;
+        size -= blocks * simd.m_block;
+    }
+
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), buf += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, buf, sizeof(w));
+        sum = add_with_carry(sum, w);
+    }
+
+    for (; size >= sizeof(u_int16_t); size -= sizeof(u_int16_t), buf += sizeof(u_int16_t)) {
+        u_int16_t w;
+        memcpy(&w, buf, sizeof(w));
+        sum = add_with_carry(sum, w);
+    }
+
+    if (size == 1) {
+        u_int16_t w = 0;
+        memcpy(&w, buf, 1);
+        sum = add_with_carry(sum, w);
+    }
+
+    return sum;
+}
+}
+
+uint64_t mroute_socket::checksum_add(uint64_t sum, const unsigned char* buf, int buf_size)
+{
+    //the words are summed in host byte order, the folded sum is in the byte order of the packet (RFC 1071 2.(B)),
+    //wider words give the same folded sum because 2^16 = 1 (mod 2^16 - 1)
+    static const checksum_simd simd = get_checksum_simd();
+
+    return checksum_add_simd(simd, sum, buf, buf_size > 0 ? buf_size : 0);
+}
+
+u_int16_t mroute_socket::checksum_fold(uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return ~static_cast<u_int16_t>(sum);
+}
+
+bool mroute_socket::test_checksum()
+{
+    HC_LOG_TRACE("");
+
+    std::vector<std::pair<std::string, checksum_simd>> kernels {{"scalar", checksum_simd {nullptr, 0}}};
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.push_back(std::make_pair("sse2", checksum_simd {checksum_sse2, CHECKSUM_SSE2_BLOCK}));
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(std::make_pair("avx2", checksum_simd {checksum_avx2, CHECKSUM_AVX2_BLOCK}));
+    }
+#elif defined(__aarch64__)
+    kernels.push_back(std::make_pair("neon", checksum_simd {checksum_neon, CHECKSUM_NEON_BLOCK}));
+#endif
+
+    //the largest buffer empties the 32 bit lanes of the kernels more than once
+    const size_t max_size = 2 * CHECKSUM_LANE_BLOCKS * 32 + 64;
+    const size_t max_offset = 32;
+    std::vector<unsigned char> data(max_size + max_offset);
+
+    std::mt19937 rand(1);
+    std::uniform_int_distribution<int> d_byte(0, 255);
+    std::uniform_int_distribution<size_t> d_size(0, 2048);
+    std::uniform_int_distribution<size_t> d_offset(0, max_offset - 1);
+
+    //bytewise ones' complement sum of 16 bit words (RFC 1071 4.1), an odd byte is padded with zero
+    auto reference = [](const unsigned char* buf, size_t size) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            u_int16_t w;
+            memcpy(&w, buf + i, sizeof(w));
+            sum += w;
+        }
+        if (size % 2 == 1) {
+            u_int16_t w = 0;
+            memcpy(&w, buf + size - 1, 1);
+            sum += w;
+        }
+        return checksum_fold(sum);
+    };
+
+    std::vector<size_t> sizes;
+    for (size_t size = 0; size <= 300; ++size) {
+        sizes.push_back(size);
+    }
+    for (int i = 0; i < 200; ++i) {
+        sizes.push_back(d_size(rand));
+    }
+    sizes.push_back(max_size - 1);
+    sizes.push_back(max_size);
+
+    bool ok = true;
+    for (int fill = 0; fill < 3; ++fill) {
+        //random bytes, all bits set (carries in each lane) and zero
+        for (auto & b : data) {
+            b = fill == 0 ? d_byte(rand) : (fill == 1 ? 0xff : 0);
+        }
+
+        for (auto size : sizes) {
+            size_t offset = size > 4096 ? d_offset(rand) : size % max_offset;
+            const unsigned char* buf = data.data() + offset;
+            u_int16_t expected = reference(buf, size);
+
+            for (auto & k : kernels) {
+                u_int16_t result = checksum_fold(checksum_add_simd(k.second, 0, buf, size));
+
+                //an even split gives the same sum, so does the dispatched kernel
+                size_t split = (size / 2) & ~static_cast<size_t>(1);
+                u_int16_t split_result = checksum_fold(checksum_add_simd(k.second, checksum_add_simd(k.second, 0, buf, split), buf + split, size - split));
+
+                if (result != expected || split_result != expected) {
+                    HC_LOG_ERROR("checksum kernel " << k.first << " failed, size: " << size << " offset: " << offset << " expected: " << expected << " result: " << result << " split result: " << split_result);
+                    ok = false;
+                }
+            }
+
+            if (checksum_fold(checksum_add(0, buf, size)) != expected) {
+                HC_LOG_ERROR("checksum of the dispatched kernel failed, size: " << size << " offset: " << offset);
+                ok = false;
+            }
+        }
+    }
+
+    return ok;
 }
 
 bool mroute_socket::set_ipv6_auto_icmp6_checksum_calc(bool enable) const
@@ -249,7 +511,7 @@ bool mroute_socket::set_ipv4_receive_packets_with_router_alert_header(bool enabl
     }
 }
 
-bool mroute_socket::set_ipv6_recv_icmpv6_msg() const
+bool mroute_socket::set_ipv6_recv_icmpv6_msg(bool queries) const
 {
     HC_LOG_TRACE("");
 
@@ -269,6 +531,9 @@ bool mroute_socket::set_ipv6_recv_icmpv6_msg() const
         ICMP6_FILTER_SETPASS(MLD_LISTENER_REPORT, &myfilter);
         ICMP6_FILTER_SETPASS(MLD_LISTENER_REDUCTION, &myfilter);
         ICMP6_FILTER_SETPASS(MLD_V2_LISTENER_REPORT, &myfilter);
+        if (queries) {
+            ICMP6_FILTER_SETPASS(MLD_LISTENER_QUERY, &myfilter);
+        }
 
         if (setsockopt(m_sock, IPPROTO_ICMPV6, ICMP6_FILTER, &myfilter, sizeof(myfilter)) < 0) {
             HC_LOG_ERROR("failed to set ICMP6 filter! Error: " << strerror(errno) << " errno: " << errno);
@@ -390,6 +655,50 @@ bool mroute_socket::set_mrt_flag(bool enable) const
     }
 }
 
+bool mroute_socket::set_assert(bool enable) const
+{
+    HC_LOG_TRACE("enable: " << enable);
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("raw_socket invalid");
+        return false;
+    }
+
+    int rc;
+    int val = enable ? 1 : 0;
+
+    if (m_addrFamily == AF_INET) {
+        rc = setsockopt(m_sock, IPPROTO_IP, MRT_ASSERT, (void*)&val, sizeof(val));
+    } else if (m_addrFamily == AF_INET6) {
+        rc = setsockopt(m_sock, IPPROTO_IPV6, MRT6_ASSERT, (void*)&val, sizeof(val));
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
+
+    if (rc == -1) {
+        HC_LOG_ERROR("failed to set assert flag! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    } else {
+        return true;
+    }
+}
+
+bool mroute_socket::is_wildcard_mroute_supported() const
+{
+    HC_LOG_TRACE("");
+
+    struct utsname name;
+    int major = 0;
+    int minor = 0;
+    if (uname(&name) < 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2) {
+        HC_LOG_ERROR("failed to get the kernel version");
+        return false;
+    }
+
+    return major > 3 || (major == 3 && minor >= 8);
+}
+
 //vifNum musst the same uniqueName  on delVIF (0 > vifNum < MAXVIF ==32)
 //iff_register = true if used for PIM Register encap/decap
 bool mroute_socket::add_vif(int vifNum, uint32_t if_index, const addr_storage& ip_tunnel_remote_addr) const
@@ -428,6 +737,7 @@ bool mroute_socket::add_vif(int vifNum, uint32_t if_index, const addr_storage& i
             HC_LOG_ERROR("failed to add VIF! Error: " << strerror(errno) << " errno: " << errno);
             return false;
         } else {
+            m_vif_if_index[vifNum] = if_index;
             return true;
         }
     } else if (m_addrFamily == AF_INET6) {
@@ -477,6 +787,7 @@ bool mroute_socket::del_vif(int vif_index) const
             HC_LOG_ERROR("failed to del VIF! Error: " << strerror(errno) << " errno: " << errno);
             return false;
         } else {
+            m_vif_if_index.erase(vif_index);
             return true;
         }
     } else if (m_addrFamily == AF_INET6) {
@@ -540,6 +851,155 @@ bool mroute_socket::bind_vif_to_table(uint32_t if_index, int table) const
     return true;
 }
 
+namespace
+{
+//append a multicast routing rule (ip mrule) that looks up a table for the packets of an input or output interface
+void append_rule_msg(std::vector<char>& buf, unsigned short type, unsigned int seq, unsigned char family, unsigned short if_attr, const char* if_name, uint32_t table)
+{
+    const size_t start = buf.size();
+    buf.resize(start + NLMSG_SPACE(sizeof(struct fib_rule_hdr)), 0);
+
+    auto add_attr = [&buf](unsigned short attr_type, const void* data, size_t len) {
+        size_t offset = buf.size();
+        buf.resize(offset + RTA_SPACE(len), 0);
+        auto rta = reinterpret_cast<struct rtattr*>(&buf[offset]);
+        rta->rta_type = attr_type;
+        rta->rta_len = RTA_LENGTH(len);
+        memcpy(RTA_DATA(rta), data, len);
+    };
+
+    add_attr(if_attr, if_name, strlen(if_name) + 1);
+    add_attr(FRA_TABLE, &table, sizeof(table));
+
+    auto nlh = reinterpret_cast<struct nlmsghdr*>(&buf[start]);
+    nlh->nlmsg_len = buf.size() - start;
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | (type == RTM_NEWRULE ? NLM_F_CREATE : 0);
+    nlh->nlmsg_seq = seq;
+
+    auto frh = reinterpret_cast<struct fib_rule_hdr*>(NLMSG_DATA(nlh));
+    frh->family = family;
+    frh->table = table < 256 ? table : static_cast<uint32_t>(RT_TABLE_UNSPEC);
+    frh->action = FR_ACT_TO_TBL;
+}
+
+//send the messages with the sequence numbers 1 to errors.size() and collect their acknowledgements (0 or -errno)
+bool send_rule_msgs(int sock, const std::vector<char>& buf, std::vector<int>& errors)
+{
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    if (sendto(sock, buf.data(), buf.size(), 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        HC_LOG_ERROR("failed to send rtnetlink request! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    std::vector<bool> acked(errors.size(), false);
+    unsigned int pending = errors.size();
+
+    char rbuf[8192];
+    while (pending > 0) {
+        int len = recv(sock, rbuf, sizeof(rbuf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to receive rtnetlink acknowledgement! Error: " << strerror(errno) << " errno: " << errno);
+            return false;
+        }
+
+        for (auto nlh = reinterpret_cast<struct nlmsghdr*>(rbuf); NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            unsigned int index = nlh->nlmsg_seq - 1;
+            if (nlh->nlmsg_type != NLMSG_ERROR || index >= acked.size() || acked[index]) {
+                continue;
+            }
+            acked[index] = true;
+            --pending;
+            errors[index] = reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(nlh))->error;
+        }
+    }
+
+    return true;
+}
+}
+
+bool mroute_socket::bind_vifs_to_table(std::list<uint32_t>& if_indexes, int table) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("raw_socket invalid");
+        return false;
+    }
+
+    unsigned char family;
+    if (m_addrFamily == AF_INET) {
+        family = RTNL_FAMILY_IPMR;
+    } else if (m_addrFamily == AF_INET6) {
+        family = RTNL_FAMILY_IP6MR;
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
+
+    //an input and an output rule per interface, the rules of interface i have the sequence numbers 2i + 1 and 2i + 2
+    std::vector<uint32_t> ifs;
+    std::vector<std::string> names;
+    std::list<uint32_t> failed;
+    std::vector<char> buf;
+    for (auto e : if_indexes) {
+        char if_name[IF_NAMESIZE];
+        if (if_indextoname(e, if_name) == nullptr) {
+            HC_LOG_ERROR("failed to convert if_index to name! Error: " << strerror(errno) << " errno: " << errno);
+            failed.push_back(e);
+            continue;
+        }
+
+        append_rule_msg(buf, RTM_NEWRULE, 2 * ifs.size() + 1, family, FRA_IIFNAME, if_name, table);
+        append_rule_msg(buf, RTM_NEWRULE, 2 * ifs.size() + 2, family, FRA_OIFNAME, if_name, table);
+        ifs.push_back(e);
+        names.push_back(if_name);
+    }
+
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) {
+        HC_LOG_ERROR("failed to create rtnetlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    std::vector<int> errors(2 * ifs.size(), 0);
+    if (!ifs.empty() && !send_rule_msgs(sock, buf, errors)) {
+        close(sock);
+        return false;
+    }
+
+    //an interface is bound by both rules or by none, so binding it again does not duplicate a rule
+    buf.clear();
+    unsigned int rollbacks = 0;
+    for (size_t i = 0; i < ifs.size(); ++i) {
+        int err_in = errors[2 * i];
+        int err_out = errors[2 * i + 1];
+        if (err_in == 0 && err_out == 0) {
+            continue;
+        }
+
+        HC_LOG_ERROR("failed to bind interface " << names[i] << " to table " << table << "! Error: " << strerror(-(err_in != 0 ? err_in : err_out)) << " errno: " << -(err_in != 0 ? err_in : err_out));
+        failed.push_back(ifs[i]);
+        if (err_in == 0 || err_out == 0) {
+            append_rule_msg(buf, RTM_DELRULE, ++rollbacks, family, err_in == 0 ? FRA_IIFNAME : FRA_OIFNAME, names[i].c_str(), table);
+        }
+    }
+
+    if (rollbacks > 0) {
+        std::vector<int> rollback_errors(rollbacks, 0);
+        send_rule_msgs(sock, buf, rollback_errors);
+    }
+
+    close(sock);
+    if_indexes.swap(failed);
+    return if_indexes.empty();
+}
 
 bool mroute_socket::unbind_vif_form_table(uint32_t if_index, int table) const
 {
@@ -587,11 +1047,38 @@ bool mroute_socket::unbind_vif_form_table(uint32_t if_index, int table) const
 
 //source_addr is the source address of the received multicast packet
 //group_addr group address of the received multicast packet
-bool mroute_socket::add_mroute(int vif_index, const addr_storage& source_addr, const addr_storage& group_addr, const std::list<int>& output_vif) const
+template<typename Family>
+bool mroute_socket::add_family_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const
 {
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("raw_socket invalid");
+        return false;
+    }
+
+    if (output_vif.size() > Family::max_vifs) {
+        HC_LOG_ERROR("output_vifNum_size to large: " << output_vif.size());
+        return false;
+    }
+
+    typename Family::mfc_ctl mc;
+    Family::set_mfc(mc, vif_index, source_addr, group_addr);
+    for (auto e : output_vif) {
+        Family::set_output_vif(mc, e, MROUTE_DEFAULT_TTL);
+    }
 
-//unsigned int* output_vifTTL, unsigned int output_vifTTL_Ncount){
+    if (setsockopt(m_sock, Family::level, Family::add_mfc, &mc, sizeof(mc)) == -1) {
+        HC_LOG_ERROR("failed to add multicast route! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    } else {
+        return true;
+    }
+}
 
+template<typename Family>
+bool mroute_socket::del_family_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const
+{
     HC_LOG_TRACE("");
 
     if (!is_udp_valid()) {
@@ -599,109 +1086,412 @@ bool mroute_socket::add_mroute(int vif_index, const addr_storage& source_addr, c
         return false;
     }
 
-    int rc;
+    typename Family::mfc_ctl mc;
+    Family::set_mfc(mc, vif_index, source_addr, group_addr);
+
+    if (setsockopt(m_sock, Family::level, Family::del_mfc, &mc, sizeof(mc)) == -1) {
+        HC_LOG_WARN("failed to delete multicast route! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    } else {
+        return true;
+    }
+}
+
+template<typename Family>
+bool mroute_socket::get_family_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const
+{
+    HC_LOG_TRACE("");
+
+    if (!is_udp_valid()) {
+        HC_LOG_ERROR("raw_socket invalid");
+        return false;
+    }
+
+    typename Family::sg_req req;
+    Family::set_sg(req, source_addr, group_addr);
+
+    if (ioctl(m_sock, Family::sg_count, &req) == -1) {
+        HC_LOG_ERROR("failed to get multicast route stats! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    } else {
+        pkt_count = req.pktcnt;
+        return true;
+    }
+}
+
+bool mroute_socket::add_mroute(int vif_index, const addr_storage& source_addr, const addr_storage& group_addr, const std::list<int>& output_vif) const
+{
+    HC_LOG_TRACE("");
 
     if (m_addrFamily == AF_INET) {
-        struct mfcctl mc;
-        memset(&mc, 0, sizeof(mc));
+        return add_family_mroute<ipv4_family>(vif_index, source_addr, group_addr, output_vif);
+    } else if (m_addrFamily == AF_INET6) {
+        return add_family_mroute<ipv6_family>(vif_index, source_addr, group_addr, output_vif);
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
+}
 
-        mc.mfcc_origin = source_addr.get_in_addr();
-        mc.mfcc_mcastgrp = group_addr.get_in_addr();
-        mc.mfcc_parent = vif_index;
+bool mroute_socket::del_mroute(int vif_index, const addr_storage& source_addr, const addr_storage& group_addr) const
+{
+    HC_LOG_TRACE("");
 
-        if (output_vif.size() > MAXVIFS) {
-            HC_LOG_ERROR("output_vifNum_size to large: " << output_vif.size());
-            return false;
+    if (m_addrFamily == AF_INET) {
+        return del_family_mroute<ipv4_family>(vif_index, source_addr, group_addr);
+    } else if (m_addrFamily == AF_INET6) {
+        return del_family_mroute<ipv6_family>(vif_index, source_addr, group_addr);
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
+}
+
+void mroute_socket::queue_add_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const
+{
+    HC_LOG_TRACE("");
+    m_mroute_ops.push_back(mroute_op {true, vif_index, source_addr, group_addr, output_vif});
+}
+
+void mroute_socket::queue_del_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const
+{
+    HC_LOG_TRACE("");
+    m_mroute_ops.push_back(mroute_op {false, vif_index, source_addr, group_addr, {}});
+}
+
+bool mroute_socket::apply_mroute_op(const mroute_op& op) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_addrFamily == AF_INET) {
+        return op.m_add ? add_family_mroute<ipv4_family>(op.m_vif_index, op.m_source_addr, op.m_group_addr, op.m_output_vif) : del_family_mroute<ipv4_family>(op.m_vif_index, op.m_source_addr, op.m_group_addr);
+    } else {
+        return op.m_add ? add_family_mroute<ipv6_family>(op.m_vif_index, op.m_source_addr, op.m_group_addr, op.m_output_vif) : del_family_mroute<ipv6_family>(op.m_vif_index, op.m_source_addr, op.m_group_addr);
+    }
+}
+
+bool mroute_socket::flush_mroutes(std::list<std::pair<mc_addr, mc_addr>>& failed) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_nl_lock);
+
+    std::vector<mroute_op> ops;
+    ops.swap(m_mroute_ops);
+
+    auto first = std::begin(ops);
+    std::vector<char> buf;
+    buf.reserve(MROUTE_NETLINK_BUFFER_SIZE);
+    std::vector<const mroute_op*> msgs;
+
+    while (m_nl_sock >= 0 && m_nl_route_changes && first != std::end(ops)) {
+        buf.clear();
+        msgs.clear();
+        auto failed_size = failed.size();
+        unsigned int first_seq = m_nl_seq + 1;
+
+        auto last = first;
+        while (last != std::end(ops) && buf.size() < MROUTE_NETLINK_BUFFER_SIZE / 2) {
+            if (append_route_msg(buf, first_seq + msgs.size(), *last)) {
+                msgs.push_back(&*last);
+            } else {
+                failed.push_back(std::make_pair(last->m_group_addr, last->m_source_addr));
+            }
+            ++last;
         }
+        m_nl_seq += msgs.size();
 
-        for (auto e : output_vif) {
-            mc.mfcc_ttls[e] = MROUTE_DEFAULT_TTL;
+        if (!send_route_msgs(buf, first_seq, msgs, failed)) {
+            HC_LOG_DEBUG("multicast routes over rtnetlink not supported, use setsockopt");
+            m_nl_route_changes = false;
+            failed.resize(failed_size);
+            break;
         }
 
-        rc = setsockopt(m_sock, IPPROTO_IP, MRT_ADD_MFC, (void *)&mc, sizeof(mc));
-        if (rc == -1) {
-            HC_LOG_ERROR("failed to add multicast route! Error: " << strerror(errno) << " errno: " << errno);
-            return false;
-        } else {
-            return true;
+        first = last;
+    }
+
+    //fallback
+    for (; first != std::end(ops); ++first) {
+        metrics::add(METRIC_ROUTE_SYSCALLS);
+        if (!apply_mroute_op(*first)) {
+            failed.push_back(std::make_pair(first->m_group_addr, first->m_source_addr));
         }
-    } else if (m_addrFamily == AF_INET6) {
-        struct mf6cctl mc;
-        memset(&mc, 0, sizeof(mc));
+    }
+
+    return failed.empty();
+}
+
+void mroute_socket::open_route_netlink()
+{
+    HC_LOG_TRACE("");
+
+    close_route_netlink();
+
+    m_nl_sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (m_nl_sock < 0) {
+        HC_LOG_DEBUG("failed to create rtnetlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        return;
+    }
+
+    struct sockaddr_nl local;
+    memset(&local, 0, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    if (bind(m_nl_sock, reinterpret_cast<struct sockaddr*>(&local), sizeof(local)) < 0) {
+        HC_LOG_DEBUG("failed to bind rtnetlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        close_route_netlink();
+        return;
+    }
+
+    m_nl_route_changes = (m_addrFamily == AF_INET);
+}
+
+void mroute_socket::close_route_netlink() const
+{
+    HC_LOG_TRACE("");
+
+    if (m_nl_sock >= 0) {
+        close(m_nl_sock);
+        m_nl_sock = -1;
+    }
+}
 
-        mc.mf6cc_origin.sin6_addr = source_addr.get_in6_addr();
-        mc.mf6cc_mcastgrp.sin6_addr = group_addr.get_in6_addr();
-        mc.mf6cc_parent = vif_index;
+bool mroute_socket::append_route_msg(std::vector<char>& buf, unsigned int seq, const mroute_op& op) const
+{
+    HC_LOG_TRACE("");
 
-        if (output_vif.size() > MAXMIFS) {
-            HC_LOG_ERROR("output_vifNum_size to large: " << output_vif.size());
+    unsigned int if_index = 0;
+    if (op.m_add) {
+        auto if_it = m_vif_if_index.find(op.m_vif_index);
+        if (if_it == std::end(m_vif_if_index)) {
+            HC_LOG_ERROR("failed to add multicast route! Error: unknown vif " << op.m_vif_index);
             return false;
         }
+        if_index = if_it->second;
 
-        for (auto e : output_vif) {
-            IF_SET(e, &mc.mf6cc_ifset);
+        if (op.m_output_vif.size() > MAXVIFS) {
+            HC_LOG_ERROR("output_vifNum_size to large: " << op.m_output_vif.size());
+            return false;
         }
+    }
 
-        rc = setsockopt(m_sock, IPPROTO_IPV6, MRT6_ADD_MFC, (void*)&mc, sizeof(mc));
-        if (rc == -1) {
-            HC_LOG_ERROR("failed to add multicast route! Error: " << strerror(errno) << " errno: " << errno);
-            return false;
-        } else {
-            return true;
+    const size_t start = buf.size();
+    buf.resize(start + NLMSG_SPACE(sizeof(struct rtmsg)), 0);
+
+    auto add_attr = [&buf](unsigned short type, const void* data, size_t len) {
+        size_t offset = buf.size();
+        buf.resize(offset + RTA_SPACE(len), 0);
+        auto rta = reinterpret_cast<struct rtattr*>(&buf[offset]);
+        rta->rta_type = type;
+        rta->rta_len = RTA_LENGTH(len);
+        memcpy(RTA_DATA(rta), data, len);
+    };
+
+    struct in_addr saddr = op.m_source_addr.get_in_addr();
+    struct in_addr gaddr = op.m_group_addr.get_in_addr();
+    uint32_t table = m_table;
+    add_attr(RTA_SRC, &saddr, sizeof(saddr));
+    add_attr(RTA_DST, &gaddr, sizeof(gaddr));
+    add_attr(RTA_TABLE, &table, sizeof(table));
+
+    if (op.m_add) {
+        add_attr(RTA_IIF, &if_index, sizeof(if_index));
+
+        //the kernel reads one next hop per vif, its hop count is the ttl threshold of the vif (0 = do not forward)
+        int max_vif = -1;
+        for (auto e : op.m_output_vif) {
+            max_vif = std::max(max_vif, e);
         }
-    } else {
-        HC_LOG_ERROR("wrong address family");
+        std::vector<struct rtnexthop> nexthops(max_vif + 1);
+        for (auto & e : nexthops) {
+            memset(&e, 0, sizeof(e));
+            e.rtnh_len = sizeof(e);
+        }
+        for (auto e : op.m_output_vif) {
+            nexthops[e].rtnh_hops = MROUTE_DEFAULT_TTL;
+        }
+        add_attr(RTA_MULTIPATH, nexthops.data(), nexthops.size() * sizeof(struct rtnexthop));
+    }
+
+    auto nlh = reinterpret_cast<struct nlmsghdr*>(&buf[start]);
+    nlh->nlmsg_len = buf.size() - start;
+    nlh->nlmsg_type = op.m_add ? RTM_NEWROUTE : RTM_DELROUTE;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | (op.m_add ? NLM_F_CREATE | NLM_F_REPLACE : 0);
+    nlh->nlmsg_seq = seq;
+
+    auto rtm = reinterpret_cast<struct rtmsg*>(NLMSG_DATA(nlh));
+    rtm->rtm_family = RTNL_FAMILY_IPMR;
+    rtm->rtm_dst_len = 32;
+    rtm->rtm_src_len = 32;
+    rtm->rtm_table = m_table < 256 ? m_table : static_cast<int>(RT_TABLE_UNSPEC);
+    rtm->rtm_protocol = RTPROT_MROUTED; //removed by the kernel together with the routes of this socket
+    rtm->rtm_scope = RT_SCOPE_UNIVERSE;
+    rtm->rtm_type = RTN_MULTICAST;
+
+    return true;
+}
+
+bool mroute_socket::send_route_msgs(const std::vector<char>& buf, unsigned int first_seq, const std::vector<const mroute_op*>& msgs, std::list<std::pair<mc_addr, mc_addr>>& failed) const
+{
+    HC_LOG_TRACE("");
+
+    if (buf.empty()) {
+        return true;
+    }
+
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+
+    metrics::add(METRIC_ROUTE_SYSCALLS);
+    if (sendto(m_nl_sock, buf.data(), buf.size(), 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        HC_LOG_ERROR("failed to send rtnetlink request! Error: " << strerror(errno) << " errno: " << errno);
         return false;
     }
 
+    //one acknowledgement per message
+    std::vector<bool> acked(msgs.size(), false);
+    unsigned int pending = msgs.size();
+
+    char rbuf[8192];
+    bool supported = true;
+    while (pending > 0) {
+        metrics::add(METRIC_ROUTE_SYSCALLS);
+        int len = recv(m_nl_sock, rbuf, sizeof(rbuf), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to receive rtnetlink acknowledgement! Error: " << strerror(errno) << " errno: " << errno);
+            return false;
+        }
+
+        for (auto nlh = reinterpret_cast<struct nlmsghdr*>(rbuf); NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type != NLMSG_ERROR) {
+                continue;
+            }
+
+            unsigned int index = nlh->nlmsg_seq - first_seq;
+            if (index >= acked.size() || acked[index]) {
+                continue;
+            }
+            acked[index] = true;
+            --pending;
+
+            auto err = reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(nlh));
+            if (err->error == -EOPNOTSUPP || err->error == -EAFNOSUPPORT) {
+                supported = false;
+            } else if (err->error != 0) {
+                auto& op = *msgs[index];
+                HC_LOG_WARN("failed to " << (op.m_add ? "add" : "delete") << " multicast route! Error: " << strerror(-err->error) << " errno: " << -err->error);
+                failed.push_back(std::make_pair(op.m_group_addr, op.m_source_addr));
+            }
+        }
+    }
+
+    return supported;
 }
 
-bool mroute_socket::del_mroute(int vif_index, const addr_storage& source_addr, const addr_storage& group_addr) const
+bool mroute_socket::get_all_mroute_pkt_counts(std::map<std::pair<mc_addr, mc_addr>, unsigned long>& pkt_counts) const
 {
     HC_LOG_TRACE("");
 
-    if (!is_udp_valid()) {
-        HC_LOG_ERROR("raw_socket invalid");
+    std::lock_guard<std::mutex> lock(m_nl_lock);
+
+    if (m_nl_sock < 0) {
         return false;
     }
 
-    int rc;
+    struct {
+        struct nlmsghdr nlh;
+        struct rtmsg rtm;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+    req.nlh.nlmsg_type = RTM_GETROUTE;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++m_nl_seq;
+    req.rtm.rtm_family = (m_addrFamily == AF_INET) ? RTNL_FAMILY_IPMR : RTNL_FAMILY_IP6MR;
 
-    if (m_addrFamily == AF_INET) {
-        struct mfcctl mc;
-        memset(&mc, 0, sizeof(mc));
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
 
-        mc.mfcc_origin = source_addr.get_in_addr();
-        mc.mfcc_mcastgrp = group_addr.get_in_addr();
-        mc.mfcc_parent = vif_index;
+    if (sendto(m_nl_sock, &req, req.nlh.nlmsg_len, 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        HC_LOG_ERROR("failed to send rtnetlink dump request! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
 
-        rc = setsockopt(m_sock, IPPROTO_IP, MRT_DEL_MFC, (void *)&mc, sizeof(mc));
-        if (rc == -1) {
-            HC_LOG_WARN("failed to delete multicast route! Error: " << strerror(errno) << " errno: " << errno);
+    std::vector<char> rbuf(MROUTE_NETLINK_BUFFER_SIZE);
+    bool result = true;
+    while (true) {
+        int len = recv(m_nl_sock, rbuf.data(), rbuf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            HC_LOG_ERROR("failed to receive rtnetlink dump! Error: " << strerror(errno) << " errno: " << errno);
             return false;
-        } else {
-            return true;
         }
-    } else if (m_addrFamily == AF_INET6) {
-        struct mf6cctl mc;
-        memset(&mc, 0, sizeof(mc));
 
-        mc.mf6cc_origin.sin6_addr = source_addr.get_in6_addr();
-        mc.mf6cc_mcastgrp.sin6_addr = group_addr.get_in6_addr();
-        mc.mf6cc_parent = vif_index;
+        for (auto nlh = reinterpret_cast<struct nlmsghdr*>(rbuf.data()); NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != m_nl_seq) {
+                continue; //late acknowledgement of an older request
+            }
 
-        rc = setsockopt(m_sock, IPPROTO_IPV6, MRT6_DEL_MFC, (void *)&mc, sizeof(mc));
-        if (rc == -1) {
-            HC_LOG_WARN("failed to delete multicast route! Error: " << strerror(errno) << " errno: " << errno);
-            return false;
-        } else {
-            return true;
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return result;
+            } else if (nlh->nlmsg_type == NLMSG_ERROR) {
+                HC_LOG_DEBUG("rtnetlink dump of the multicast routes failed! Error: " << strerror(-reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(nlh))->error));
+                return false;
+            } else if (nlh->nlmsg_type != RTM_NEWROUTE || !result) {
+                continue;
+            }
+
+            auto rtm = reinterpret_cast<struct rtmsg*>(NLMSG_DATA(nlh));
+            uint32_t table = rtm->rtm_table;
+            mc_addr saddr;
+            mc_addr gaddr;
+            bool has_stats = false;
+            unsigned long pkt_count = 0;
+
+            int attr_len = RTM_PAYLOAD(nlh);
+            for (auto rta = RTM_RTA(rtm); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+                switch (rta->rta_type) {
+                case RTA_TABLE:
+                    table = *reinterpret_cast<uint32_t*>(RTA_DATA(rta));
+                    break;
+                case RTA_SRC:
+                case RTA_DST: {
+                    mc_addr& addr = (rta->rta_type == RTA_SRC) ? saddr : gaddr;
+                    if (m_addrFamily == AF_INET && RTA_PAYLOAD(rta) == sizeof(struct in_addr)) {
+                        addr = mc_addr(*reinterpret_cast<struct in_addr*>(RTA_DATA(rta)));
+                    } else if (m_addrFamily == AF_INET6 && RTA_PAYLOAD(rta) == sizeof(struct in6_addr)) {
+                        addr = mc_addr(*reinterpret_cast<struct in6_addr*>(RTA_DATA(rta)));
+                    }
+                }
+                break;
+                case RTA_MFC_STATS:
+                    if (RTA_PAYLOAD(rta) >= sizeof(struct rta_mfc_stats)) {
+                        struct rta_mfc_stats stats;
+                        memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+                        pkt_count = stats.mfcs_packets;
+                        has_stats = true;
+                    }
+                    break;
+                }
+            }
+
+            //older kernels do not report the counters, they have to be requested per route
+            if (rtm->rtm_flags & RTNH_F_UNRESOLVED) {
+                continue;
+            } else if (!has_stats) {
+                result = false;
+            } else if (static_cast<int>(table) == m_table && saddr.is_valid() && gaddr.is_valid()) {
+                pkt_counts[std::make_pair(gaddr, saddr)] = pkt_count;
+            }
         }
-    } else {
-        HC_LOG_ERROR("wrong address family");
-        return false;
     }
-    return false;
 }
 
 bool mroute_socket::get_vif_stats(int vif_index, struct sioc_vif_req* req_v4, struct sioc_mif_req6* req_v6) const
@@ -763,36 +1553,23 @@ bool mroute_socket::get_mroute_stats(const addr_storage& source_addr, const addr
         return false;
     }
 
-    int rc;
-
     if (m_addrFamily == AF_INET) {
         if (sgreq_v4 != nullptr) {
-            memset(sgreq_v4, 0, sizeof(struct sioc_sg_req));
-
-            sgreq_v4->src = source_addr.get_in_addr();
-            sgreq_v4->grp = group_addr.get_in_addr();
-
-            rc = ioctl(m_sock, SIOCGETSGCNT, sgreq_v4);;
-            if (rc == -1) {
+            ipv4_family::set_sg(*sgreq_v4, source_addr, group_addr);
+            if (ioctl(m_sock, ipv4_family::sg_count, sgreq_v4) == -1) {
                 HC_LOG_ERROR("failed to get multicast route stats! Error: " << strerror(errno) << " errno: " << errno);
                 return false;
             } else {
                 return true;
             }
-
         } else {
             HC_LOG_ERROR("failed to get multicast route stats! Error: claimed parameter sgreq_v4 is null");
             return false;
         }
     } else if (m_addrFamily == AF_INET6) {
         if (sgreq_v6 != nullptr) {
-            memset(sgreq_v6, 0, sizeof(struct sioc_sg_req6));
-
-            sgreq_v6->src.sin6_addr = source_addr.get_in6_addr();
-            sgreq_v6->grp.sin6_addr = group_addr.get_in6_addr();
-
-            rc = ioctl(m_sock, SIOCGETSGCNT_IN6, sgreq_v6);
-            if (rc == -1) {
+            ipv6_family::set_sg(*sgreq_v6, source_addr, group_addr);
+            if (ioctl(m_sock, ipv6_family::sg_count, sgreq_v6) == -1) {
                 HC_LOG_ERROR("failed to get multicast route stats! Error: " << strerror(errno) << " errno: " << errno);
                 return false;
             } else {
@@ -806,7 +1583,20 @@ bool mroute_socket::get_mroute_stats(const addr_storage& source_addr, const addr
         HC_LOG_ERROR("wrong address family");
         return false;
     }
-    return false;
+}
+
+bool mroute_socket::get_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const
+{
+    HC_LOG_TRACE("");
+
+    if (m_addrFamily == AF_INET) {
+        return get_family_mroute_pkt_count<ipv4_family>(source_addr, group_addr, pkt_count);
+    } else if (m_addrFamily == AF_INET6) {
+        return get_family_mroute_pkt_count<ipv6_family>(source_addr, group_addr, pkt_count);
+    } else {
+        HC_LOG_ERROR("wrong address family");
+        return false;
+    }
 }
 
 #ifdef DEBUG_MODE
@@ -1281,4 +2071,5 @@ void mroute_socket::quick_test()
 mroute_socket::~mroute_socket()
 {
     HC_LOG_TRACE("");
+    close_route_netlink();
 }
@@ -0,0 +1,120 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/utils/source_table.hpp"
+
+source_table::source_table()
+    : m_next_id(1)
+{
+    HC_LOG_TRACE("");
+
+    for (auto & c : m_chunks) {
+        c.store(nullptr, std::memory_order_relaxed);
+    }
+
+    //the id 0 stands for the invalid address and is never released
+    m_chunks[0].store(new entry[SOURCE_TABLE_CHUNK_SIZE](), std::memory_order_release);
+}
+
+uint32_t source_table::get_free_id()
+{
+    HC_LOG_TRACE("");
+
+    if (!m_free_ids.empty()) {
+        uint32_t id = m_free_ids.back();
+        m_free_ids.pop_back();
+        return id;
+    }
+
+    uint32_t id = m_next_id;
+    std::size_t chunk = id / SOURCE_TABLE_CHUNK_SIZE;
+    if (chunk >= SOURCE_TABLE_MAX_CHUNKS) {
+        HC_LOG_ERROR("source table is full");
+        throw "source table is full";
+    }
+
+    if (m_chunks[chunk].load(std::memory_order_relaxed) == nullptr) {
+        m_chunks[chunk].store(new entry[SOURCE_TABLE_CHUNK_SIZE](), std::memory_order_release);
+    }
+
+    ++m_next_id;
+    return id;
+}
+
+uint32_t source_table::intern(const mc_addr& addr)
+{
+    HC_LOG_TRACE("");
+
+    if (!addr.is_valid()) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_ids.find(addr);
+    if (it != m_ids.end()) {
+        //the reference count may be zero if the last reference is being released, release_last checks it again
+        get_entry(it->second).m_refs.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+    }
+
+    uint32_t id = get_free_id();
+    entry& e = get_entry(id);
+    e.m_addr = addr;
+    e.m_refs.store(1, std::memory_order_relaxed);
+    e.m_used = true;
+    m_ids.insert(std::make_pair(addr, id));
+    return id;
+}
+
+void source_table::release_last(uint32_t id)
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    entry& e = get_entry(id);
+
+    //a reference can only be added from zero under the lock, so a used entry without references is free
+    if (e.m_used && e.m_refs.load(std::memory_order_acquire) == 0) {
+        m_ids.erase(e.m_addr);
+        e.m_addr = mc_addr();
+        e.m_used = false;
+        m_free_ids.push_back(id);
+    }
+}
+
+std::size_t source_table::size()
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_ids.size();
+}
+
+std::size_t source_table::get_memory()
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::size_t chunks = (m_next_id + SOURCE_TABLE_CHUNK_SIZE - 1) / SOURCE_TABLE_CHUNK_SIZE;
+    return chunks * SOURCE_TABLE_CHUNK_SIZE * sizeof(entry) + m_ids.size() * (sizeof(std::pair<mc_addr, uint32_t>) + 2 * 2 * sizeof(uint32_t)) + m_free_ids.capacity() * sizeof(uint32_t);
+}
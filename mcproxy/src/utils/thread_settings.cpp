@@ -0,0 +1,298 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/utils/thread_settings.hpp"
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+thread_role_settings thread_settings::m_roles[TR_COUNT];
+
+std::string thread_role_settings::to_string() const
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    s << "cpus=";
+    if (pinned) {
+        //ranges of consecutive cpus like taskset -c
+        bool first = true;
+        for (int i = 0; i < CPU_SETSIZE; ++i) {
+            if (!CPU_ISSET(i, &cpus)) {
+                continue;
+            }
+
+            int last = i;
+            while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus)) {
+                ++last;
+            }
+
+            s << (first ? "" : ",") << i;
+            if (last > i) {
+                s << "-" << last;
+            }
+            first = false;
+            i = last;
+        }
+    } else {
+        s << "inherited";
+    }
+
+    s << " policy=";
+    if (scheduled) {
+        s << (policy == SCHED_FIFO ? "fifo" : policy == SCHED_RR ? "rr" : "other") << " priority=" << priority;
+    } else {
+        s << "inherited";
+    }
+
+    return s.str();
+}
+
+std::string thread_settings::get_role_name(thread_role role)
+{
+    HC_LOG_TRACE("");
+
+    switch (role) {
+    case TR_RECEIVER:
+        return "receiver";
+    case TR_INSTANCE:
+        return "instance";
+    case TR_QUERIER:
+        return "querier";
+    case TR_TIMING:
+        return "timing";
+    case TR_ROUTING:
+        return "routing";
+    case TR_MONITOR:
+        return "monitor";
+    default:
+        return "ERROR";
+    }
+}
+
+bool thread_settings::parse_cpus(const std::string& list, cpu_set_t& cpus)
+{
+    HC_LOG_TRACE("");
+
+    cpu_set_t available;
+    CPU_ZERO(&available);
+    if (sched_getaffinity(0, sizeof(available), &available) != 0) {
+        HC_LOG_ERROR("failed to get the cpu affinity! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    CPU_ZERO(&cpus);
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        unsigned long first;
+        unsigned long last;
+        try {
+            std::size_t end;
+            first = std::stoul(item, &end);
+            last = first;
+            if (end < item.size() && item[end] == '-') {
+                std::size_t end_last;
+                last = std::stoul(item.substr(end + 1), &end_last);
+                end += 1 + end_last;
+            }
+            if (end != item.size()) {
+                throw std::invalid_argument(item);
+            }
+        } catch (const std::exception&) {
+            HC_LOG_ERROR("invalid cpu list: " << list);
+            return false;
+        }
+
+        if (first > last || last >= CPU_SETSIZE) {
+            HC_LOG_ERROR("invalid cpu range: " << item);
+            return false;
+        }
+
+        for (unsigned long i = first; i <= last; ++i) {
+            if (!CPU_ISSET(i, &available)) {
+                HC_LOG_ERROR("cpu " << i << " is not available to the proxy");
+                return false;
+            }
+            CPU_SET(i, &cpus);
+        }
+    }
+
+    if (CPU_COUNT(&cpus) == 0) {
+        HC_LOG_ERROR("empty cpu list: " << list);
+        return false;
+    }
+
+    return true;
+}
+
+bool thread_settings::parse_scheduling(const std::string& sched, thread_role_settings& settings)
+{
+    HC_LOG_TRACE("");
+
+    auto pos = sched.find(':');
+    std::string policy_name = sched.substr(0, pos);
+    if (policy_name == "other") {
+        settings.policy = SCHED_OTHER;
+    } else if (policy_name == "fifo") {
+        settings.policy = SCHED_FIFO;
+    } else if (policy_name == "rr") {
+        settings.policy = SCHED_RR;
+    } else {
+        HC_LOG_ERROR("scheduling policy has to be other, fifo or rr: " << policy_name);
+        return false;
+    }
+
+    int min = settings.policy == SCHED_OTHER ? -20 : sched_get_priority_min(settings.policy);
+    int max = settings.policy == SCHED_OTHER ? 19 : sched_get_priority_max(settings.policy);
+    settings.priority = settings.policy == SCHED_OTHER ? 0 : min;
+
+    if (pos != std::string::npos) {
+        std::string value = sched.substr(pos + 1);
+        try {
+            std::size_t end;
+            settings.priority = std::stoi(value, &end);
+            if (end != value.size()) {
+                throw std::invalid_argument(value);
+            }
+        } catch (const std::exception&) {
+            HC_LOG_ERROR("scheduling priority is not a number: " << value);
+            return false;
+        }
+    }
+
+    if (settings.priority < min || settings.priority > max) {
+        HC_LOG_ERROR("scheduling priority of " << policy_name << " has to be between " << min << " and " << max << ": " << settings.priority);
+        return false;
+    }
+
+    settings.scheduled = true;
+    return true;
+}
+
+bool thread_settings::parse(const std::string& arg)
+{
+    HC_LOG_TRACE("");
+
+    auto pos = arg.find('=');
+    if (pos == std::string::npos) {
+        HC_LOG_ERROR("thread setting has to be <role>=<value>: " << arg);
+        return false;
+    }
+
+    std::string role_name = arg.substr(0, pos);
+    std::string value = arg.substr(pos + 1);
+    auto sched_pos = value.find('/');
+    std::string cpu_list = value.substr(0, sched_pos);
+
+    thread_role_settings settings;
+    if (!cpu_list.empty()) {
+        if (!parse_cpus(cpu_list, settings.cpus)) {
+            return false;
+        }
+        settings.pinned = true;
+    }
+
+    if (sched_pos != std::string::npos && !parse_scheduling(value.substr(sched_pos + 1), settings)) {
+        return false;
+    }
+
+    if (!settings.pinned && !settings.scheduled) {
+        HC_LOG_ERROR("thread setting without cpu list and scheduling policy: " << arg);
+        return false;
+    }
+
+    bool found = false;
+    for (int i = 0; i < TR_COUNT; ++i) {
+        if (role_name == "all" || role_name == get_role_name(static_cast<thread_role>(i))) {
+            if (settings.pinned) {
+                m_roles[i].pinned = true;
+                m_roles[i].cpus = settings.cpus;
+            }
+            if (settings.scheduled) {
+                m_roles[i].scheduled = true;
+                m_roles[i].policy = settings.policy;
+                m_roles[i].priority = settings.priority;
+            }
+            found = true;
+        }
+    }
+
+    if (!found) {
+        HC_LOG_ERROR("unknown thread role: " << role_name);
+        return false;
+    }
+
+    return true;
+}
+
+void thread_settings::apply(thread_role role, const std::string& name)
+{
+    HC_LOG_TRACE("");
+
+    int rc = pthread_setname_np(pthread_self(), name.substr(0, THREAD_NAME_MAX_LEN).c_str());
+    if (rc != 0) {
+        HC_LOG_WARN("failed to set the thread name " << name << "! Error: " << strerror(rc));
+    }
+
+    const thread_role_settings& settings = m_roles[role];
+
+    if (settings.pinned) {
+        rc = pthread_setaffinity_np(pthread_self(), sizeof(settings.cpus), &settings.cpus);
+        if (rc != 0) {
+            HC_LOG_ERROR("failed to set the cpu affinity of the thread " << name << "! Error: " << strerror(rc));
+        }
+    }
+
+    if (settings.scheduled) {
+        sched_param param;
+        param.sched_priority = settings.policy == SCHED_OTHER ? 0 : settings.priority;
+        rc = pthread_setschedparam(pthread_self(), settings.policy, &param);
+        if (rc != 0) {
+            HC_LOG_ERROR("failed to set the scheduling policy of the thread " << name << "! Error: " << strerror(rc));
+        } else if (settings.policy == SCHED_OTHER && setpriority(PRIO_PROCESS, syscall(SYS_gettid), settings.priority) != 0) {
+            HC_LOG_ERROR("failed to set the nice value of the thread " << name << "! Error: " << strerror(errno) << " errno: " << errno);
+        }
+    }
+}
+
+std::string thread_settings::to_string()
+{
+    HC_LOG_TRACE("");
+    std::ostringstream s;
+
+    for (int i = 0; i < TR_COUNT; ++i) {
+        if (m_roles[i].pinned || m_roles[i].scheduled) {
+            s << "thread role=" << get_role_name(static_cast<thread_role>(i)) << " " << m_roles[i].to_string() << std::endl;
+        }
+    }
+
+    return s.str();
+}
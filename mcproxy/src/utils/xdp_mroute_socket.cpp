@@ -0,0 +1,534 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+#include "include/hamcast_logging.h"
+#include "include/utils/xdp_mroute_socket.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+namespace
+{
+//the interfaces of the instances share the entries of mcproxy_ifs and mcproxy_devs
+std::mutex g_if_lock;
+
+int bpf(int cmd, union bpf_attr& attr)
+{
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+bool map_lookup(int fd, const void* key, void* value)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fd;
+    attr.key = reinterpret_cast<uint64_t>(key);
+    attr.value = reinterpret_cast<uint64_t>(value);
+    return bpf(BPF_MAP_LOOKUP_ELEM, attr) == 0;
+}
+
+bool map_update(int fd, const void* key, const void* value)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fd;
+    attr.key = reinterpret_cast<uint64_t>(key);
+    attr.value = reinterpret_cast<uint64_t>(value);
+    attr.flags = BPF_ANY;
+    return bpf(BPF_MAP_UPDATE_ELEM, attr) == 0;
+}
+
+bool map_delete(int fd, const void* key)
+{
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = fd;
+    attr.key = reinterpret_cast<uint64_t>(key);
+    return bpf(BPF_MAP_DELETE_ELEM, attr) == 0;
+}
+
+//attach a program to an interface or detach it with prog_fd -1
+bool set_link_xdp(uint32_t if_index, int prog_fd)
+{
+    HC_LOG_TRACE("");
+
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (sock < 0) {
+        HC_LOG_ERROR("failed to create netlink socket! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifi;
+        char attrs[64];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_type = RTM_SETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+    req.ifi.ifi_family = AF_UNSPEC;
+    req.ifi.ifi_index = if_index;
+
+    auto xdp = reinterpret_cast<struct rtattr*>(req.attrs);
+    xdp->rta_type = IFLA_XDP | NLA_F_NESTED;
+    auto fd = reinterpret_cast<struct rtattr*>(req.attrs + RTA_LENGTH(0));
+    fd->rta_type = IFLA_XDP_FD;
+    fd->rta_len = RTA_LENGTH(sizeof(prog_fd));
+    memcpy(RTA_DATA(fd), &prog_fd, sizeof(prog_fd));
+    xdp->rta_len = RTA_LENGTH(0) + RTA_ALIGN(fd->rta_len);
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)) + xdp->rta_len;
+
+    bool rc = false;
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(sock, &req, req.nlh.nlmsg_len, 0, reinterpret_cast<struct sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+        HC_LOG_ERROR("failed to send XDP attach request! Error: " << strerror(errno) << " errno: " << errno);
+    } else {
+        char rbuf[1024];
+        int len = recv(sock, rbuf, sizeof(rbuf), 0);
+        auto nlh = reinterpret_cast<struct nlmsghdr*>(rbuf);
+        if (len < 0) {
+            HC_LOG_ERROR("failed to receive XDP attach ack! Error: " << strerror(errno) << " errno: " << errno);
+        } else if (NLMSG_OK(nlh, static_cast<unsigned int>(len)) && nlh->nlmsg_type == NLMSG_ERROR) {
+            auto err = reinterpret_cast<struct nlmsgerr*>(NLMSG_DATA(nlh));
+            if (err->error != 0) {
+                errno = -err->error;
+                HC_LOG_ERROR("failed to " << (prog_fd < 0 ? "detach" : "attach") << " the XDP program of interface " << if_index << "! Error: " << strerror(errno) << " errno: " << errno);
+            } else {
+                rc = true;
+            }
+        }
+    }
+
+    close(sock);
+    return rc;
+}
+
+bool get_mac(uint32_t if_index, uint8_t* mac)
+{
+    HC_LOG_TRACE("");
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    if (if_indextoname(if_index, ifr.ifr_name) == nullptr) {
+        return false;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return false;
+    }
+
+    bool rc = ioctl(sock, SIOCGIFHWADDR, &ifr) == 0;
+    if (rc) {
+        memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+    }
+    close(sock);
+    return rc;
+}
+}
+
+xdp_mroute_socket::xdp_mroute_socket(const std::string& pin_path, uint32_t table)
+    : m_pin_path(pin_path)
+    , m_table(table)
+    , m_routes_fd(-1)
+    , m_ifs_fd(-1)
+    , m_devs_fd(-1)
+    , m_ingress_fd(-1)
+    , m_egress_fd(-1)
+{
+    HC_LOG_TRACE("");
+
+    m_routes_fd = open_map(XDP_MROUTE_ROUTES_MAP, BPF_MAP_TYPE_HASH, sizeof(xdp_mroute_key), sizeof(xdp_mroute_value));
+    m_ifs_fd = open_map(XDP_MROUTE_IFS_MAP, BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(xdp_mroute_if));
+    m_devs_fd = open_map(XDP_MROUTE_DEVS_MAP, BPF_MAP_TYPE_DEVMAP_HASH, sizeof(uint32_t), sizeof(struct bpf_devmap_val));
+    m_ingress_fd = open_prog(XDP_MROUTE_INGRESS_PROG);
+    m_egress_fd = open_prog(XDP_MROUTE_EGRESS_PROG);
+
+    if (m_routes_fd < 0 || m_ifs_fd < 0 || m_devs_fd < 0 || m_ingress_fd < 0 || m_egress_fd < 0) {
+        close_fds();
+        throw "failed to open the XDP program";
+    }
+}
+
+xdp_mroute_socket::~xdp_mroute_socket()
+{
+    HC_LOG_TRACE("");
+
+    //the packets of the removed routes and interfaces are passed to the kernel again
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto & e : m_installed) {
+        xdp_mroute_key key;
+        set_key(key, e.second, e.first.second, e.first.first);
+        map_delete(m_routes_fd, &key);
+    }
+
+    for (auto & e : m_vif_if_index) {
+        unregister_if(e.second);
+    }
+
+    close_fds();
+}
+
+void xdp_mroute_socket::close_fds()
+{
+    HC_LOG_TRACE("");
+
+    for (int fd : {m_routes_fd, m_ifs_fd, m_devs_fd, m_ingress_fd, m_egress_fd}) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+int xdp_mroute_socket::open_map(const std::string& name, uint32_t type, uint32_t key_size, uint32_t value_size) const
+{
+    HC_LOG_TRACE("");
+
+    std::string path = m_pin_path + "/" + name;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = reinterpret_cast<uint64_t>(path.c_str());
+    int fd = bpf(BPF_OBJ_GET, attr);
+    if (fd < 0) {
+        HC_LOG_ERROR("failed to open the XDP map " << path << "! Error: " << strerror(errno) << " errno: " << errno);
+        return -1;
+    }
+
+    struct bpf_map_info info;
+    memset(&info, 0, sizeof(info));
+    memset(&attr, 0, sizeof(attr));
+    attr.info.bpf_fd = fd;
+    attr.info.info_len = sizeof(info);
+    attr.info.info = reinterpret_cast<uint64_t>(&info);
+    if (bpf(BPF_OBJ_GET_INFO_BY_FD, attr) < 0 || info.type != type || info.key_size != key_size || info.value_size != value_size) {
+        HC_LOG_ERROR("the XDP map " << path << " has another layout than xdp_mroute_maps.h, expected " << key_size << " byte keys and " << value_size << " byte values");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+int xdp_mroute_socket::open_prog(const std::string& name) const
+{
+    HC_LOG_TRACE("");
+
+    std::string path = m_pin_path + "/" + name;
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = reinterpret_cast<uint64_t>(path.c_str());
+    int fd = bpf(BPF_OBJ_GET, attr);
+    if (fd < 0) {
+        HC_LOG_ERROR("failed to open the XDP program " << path << "! Error: " << strerror(errno) << " errno: " << errno);
+        return -1;
+    }
+
+    struct bpf_prog_info info;
+    memset(&info, 0, sizeof(info));
+    memset(&attr, 0, sizeof(attr));
+    attr.info.bpf_fd = fd;
+    attr.info.info_len = sizeof(info);
+    attr.info.info = reinterpret_cast<uint64_t>(&info);
+    if (bpf(BPF_OBJ_GET_INFO_BY_FD, attr) < 0 || info.type != BPF_PROG_TYPE_XDP) {
+        HC_LOG_ERROR(path << " is not an XDP program");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void xdp_mroute_socket::set_key(xdp_mroute_key& key, uint32_t input_if_index, const mc_addr& source_addr, const mc_addr& group_addr) const
+{
+    memset(&key, 0, sizeof(key));
+    key.table = m_table;
+    key.input_if_index = input_if_index;
+    key.family = group_addr.get_addr_family();
+    if (key.family == AF_INET) {
+        memcpy(key.source, &source_addr.get_in_addr(), sizeof(struct in_addr));
+        memcpy(key.group, &group_addr.get_in_addr(), sizeof(struct in_addr));
+    } else {
+        memcpy(key.source, &source_addr.get_in6_addr(), sizeof(struct in6_addr));
+        memcpy(key.group, &group_addr.get_in6_addr(), sizeof(struct in6_addr));
+    }
+}
+
+bool xdp_mroute_socket::register_if(uint32_t if_index) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(g_if_lock);
+    xdp_mroute_if entry;
+    bool known = map_lookup(m_ifs_fd, &if_index, &entry);
+    if (!known) {
+        memset(&entry, 0, sizeof(entry));
+        if (!get_mac(if_index, entry.mac)) {
+            HC_LOG_ERROR("failed to get the MAC address of interface " << if_index << "! Error: " << strerror(errno) << " errno: " << errno);
+            return false;
+        }
+    }
+
+    auto tables_end = entry.table + entry.table_count;
+    if (std::find(entry.table, tables_end, m_table) == tables_end) {
+        if (entry.table_count >= XDP_MROUTE_MAX_TABLES) {
+            HC_LOG_ERROR("interface " << if_index << " belongs to more than " << XDP_MROUTE_MAX_TABLES << " proxy instances");
+            return false;
+        }
+        entry.table[entry.table_count++] = m_table;
+    }
+
+    if (!map_update(m_ifs_fd, &if_index, &entry)) {
+        HC_LOG_ERROR("failed to add interface " << if_index << " to the XDP map! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    if (!known) {
+        struct bpf_devmap_val dev;
+        memset(&dev, 0, sizeof(dev));
+        dev.ifindex = if_index;
+        dev.bpf_prog.fd = m_egress_fd;
+        if (!map_update(m_devs_fd, &if_index, &dev)) {
+            HC_LOG_ERROR("failed to add interface " << if_index << " to the XDP devmap! Error: " << strerror(errno) << " errno: " << errno);
+            map_delete(m_ifs_fd, &if_index);
+            return false;
+        }
+
+        if (!set_link_xdp(if_index, m_ingress_fd)) {
+            map_delete(m_devs_fd, &if_index);
+            map_delete(m_ifs_fd, &if_index);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void xdp_mroute_socket::unregister_if(uint32_t if_index) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(g_if_lock);
+    xdp_mroute_if entry;
+    if (!map_lookup(m_ifs_fd, &if_index, &entry)) {
+        return;
+    }
+
+    auto tables_end = std::remove(entry.table, entry.table + entry.table_count, m_table);
+    entry.table_count = tables_end - entry.table;
+    if (entry.table_count > 0) {
+        map_update(m_ifs_fd, &if_index, &entry);
+    } else {
+        set_link_xdp(if_index, -1);
+        map_delete(m_devs_fd, &if_index);
+        map_delete(m_ifs_fd, &if_index);
+    }
+}
+
+bool xdp_mroute_socket::add_vif(int vif_index, uint32_t if_index, const addr_storage& ip_tunnel_remote_addr) const
+{
+    HC_LOG_TRACE("");
+
+    //the kernel still reports the new sources of the virtual interfaces
+    if (!mroute_socket::add_vif(vif_index, if_index, ip_tunnel_remote_addr)) {
+        return false;
+    }
+
+    if (!register_if(if_index)) {
+        mroute_socket::del_vif(vif_index);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_vif_if_index[vif_index] = if_index;
+    return true;
+}
+
+bool xdp_mroute_socket::del_vif(int vif_index) const
+{
+    HC_LOG_TRACE("");
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_vif_if_index.find(vif_index);
+        if (it != std::end(m_vif_if_index)) {
+            unregister_if(it->second);
+            m_vif_if_index.erase(it);
+        }
+    }
+
+    return mroute_socket::del_vif(vif_index);
+}
+
+bool xdp_mroute_socket::is_wildcard_mroute_supported() const
+{
+    HC_LOG_TRACE("");
+    return false;
+}
+
+void xdp_mroute_socket::queue_add_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr, const std::list<int>& output_vif) const
+{
+    HC_LOG_TRACE("");
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_ops.push_back(route_op {true, vif_index, source_addr, group_addr, output_vif});
+}
+
+void xdp_mroute_socket::queue_del_mroute(int vif_index, const mc_addr& source_addr, const mc_addr& group_addr) const
+{
+    HC_LOG_TRACE("");
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_ops.push_back(route_op {false, vif_index, source_addr, group_addr, std::list<int>()});
+}
+
+bool xdp_mroute_socket::apply_op(const route_op& op) const
+{
+    HC_LOG_TRACE("");
+
+    auto route = std::make_pair(op.m_group_addr, op.m_source_addr);
+    auto installed = m_installed.find(route);
+
+    xdp_mroute_key key;
+
+    if (!op.m_add) {
+        if (installed == std::end(m_installed)) {
+            return false;
+        }
+
+        set_key(key, installed->second, op.m_source_addr, op.m_group_addr);
+        m_installed.erase(installed);
+        if (!map_delete(m_routes_fd, &key)) {
+            HC_LOG_WARN("failed to delete XDP route (" << op.m_group_addr << ", " << op.m_source_addr << ")! Error: " << strerror(errno) << " errno: " << errno);
+            return false;
+        }
+        return true;
+    }
+
+    auto vif_it = m_vif_if_index.find(op.m_vif_index);
+    if (vif_it == std::end(m_vif_if_index)) {
+        HC_LOG_ERROR("unknown input vif " << op.m_vif_index << " of XDP route (" << op.m_group_addr << ", " << op.m_source_addr << ")");
+        return false;
+    }
+
+    if (op.m_output_vif.size() > XDP_MROUTE_MAX_OUTPUT_IFS) {
+        HC_LOG_ERROR("XDP route (" << op.m_group_addr << ", " << op.m_source_addr << ") has more than " << XDP_MROUTE_MAX_OUTPUT_IFS << " output interfaces");
+        return false;
+    }
+
+    xdp_mroute_value value;
+    memset(&value, 0, sizeof(value));
+    for (auto e : op.m_output_vif) {
+        auto it = m_vif_if_index.find(e);
+        if (it != std::end(m_vif_if_index)) {
+            value.output_if_index[value.output_count++] = it->second;
+        }
+    }
+
+    //the counter of a changed route is taken over, the packets counted meanwhile are lost
+    if (installed != std::end(m_installed)) {
+        xdp_mroute_value last;
+        set_key(key, installed->second, op.m_source_addr, op.m_group_addr);
+        if (map_lookup(m_routes_fd, &key, &last)) {
+            value.pkt_count = last.pkt_count;
+        }
+
+        //the input interface has changed
+        if (installed->second != vif_it->second) {
+            map_delete(m_routes_fd, &key);
+            m_installed.erase(installed);
+        }
+    }
+
+    set_key(key, vif_it->second, op.m_source_addr, op.m_group_addr);
+    if (!map_update(m_routes_fd, &key, &value)) {
+        HC_LOG_ERROR("failed to add XDP route (" << op.m_group_addr << ", " << op.m_source_addr << ")! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    m_installed[route] = vif_it->second;
+    return true;
+}
+
+bool xdp_mroute_socket::flush_mroutes(std::list<std::pair<mc_addr, mc_addr>>& failed) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto & e : m_ops) {
+        if (!apply_op(e)) {
+            failed.push_back(std::make_pair(e.m_group_addr, e.m_source_addr));
+        }
+    }
+    m_ops.clear();
+
+    return failed.empty();
+}
+
+bool xdp_mroute_socket::get_mroute_pkt_count(const mc_addr& source_addr, const mc_addr& group_addr, unsigned long& pkt_count) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_installed.find(std::make_pair(group_addr, source_addr));
+    if (it == std::end(m_installed)) {
+        return false;
+    }
+
+    xdp_mroute_key key;
+    xdp_mroute_value value;
+    set_key(key, it->second, source_addr, group_addr);
+    if (!map_lookup(m_routes_fd, &key, &value)) {
+        HC_LOG_ERROR("failed to get XDP route stats (" << group_addr << ", " << source_addr << ")! Error: " << strerror(errno) << " errno: " << errno);
+        return false;
+    }
+
+    pkt_count = value.pkt_count;
+    return true;
+}
+
+bool xdp_mroute_socket::get_all_mroute_pkt_counts(std::map<std::pair<mc_addr, mc_addr>, unsigned long>& pkt_counts) const
+{
+    HC_LOG_TRACE("");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    for (auto & e : m_installed) {
+        xdp_mroute_key key;
+        xdp_mroute_value value;
+        set_key(key, e.second, e.first.second, e.first.first);
+        if (map_lookup(m_routes_fd, &key, &value)) {
+            pkt_counts[e.first] = value.pkt_count;
+        }
+    }
+
+    return true;
+}
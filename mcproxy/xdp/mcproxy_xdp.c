@@ -0,0 +1,226 @@
+/*
+ * This file is part of mcproxy.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * written by Sebastian Woelke, in cooperation with:
+ * INET group, Hamburg University of Applied Sciences,
+ * Website: http://mcproxy.realmv6.org/
+ */
+
+/*
+ * Reference XDP program of the proxy option -X, it forwards the multicast data with the routes the
+ * proxy writes to the maps (layout in include/utils/xdp_mroute_maps.h).
+ *
+ * mcproxy_ingress runs on the interfaces of the proxy instances. It looks up the (S,G) route of a
+ * packet in each table of its input interface, counts it, decrements the TTL (hop limit) and
+ * broadcasts it over the devmap mcproxy_devs. Packets without a route are passed to the kernel,
+ * which reports the new source to the proxy as before. mcproxy_egress runs on each copy before it
+ * is sent, drops the copies for interfaces that are not an output interface of the route and sets
+ * the source MAC address of the output interface.
+ *
+ * Requires Linux 5.13 (devmap broadcast), clang and the libbpf headers (libbpf 1.0 or later).
+ *
+ * Build:
+ *     cd mcproxy/xdp
+ *     clang -O2 -g -target bpf -I.. -c mcproxy_xdp.c -o mcproxy_xdp.o
+ *
+ * Load the programs and pin them with their maps into one directory of a bpffs:
+ *     mkdir -p /sys/fs/bpf/mcproxy
+ *     bpftool prog loadall mcproxy_xdp.o /sys/fs/bpf/mcproxy pinmaps /sys/fs/bpf/mcproxy
+ *
+ * Start the proxy with the directory, it attaches mcproxy_ingress to the interfaces of its
+ * instances and adds them with mcproxy_egress to the devmap:
+ *     mcproxy -f mcproxy.conf -X /sys/fs/bpf/mcproxy
+ *
+ * A veth interface drops redirected frames unless its peer has an XDP program attached too.
+ */
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/ip.h>
+#include <linux/ipv6.h>
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_endian.h>
+
+#include "include/utils/xdp_mroute_maps.h"
+
+//address families of the keys (sys/socket.h)
+#define MCPROXY_AF_INET 2
+#define MCPROXY_AF_INET6 10
+
+#define MCPROXY_MAX_IFS 256
+#define MCPROXY_MAX_ROUTES 65536
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MCPROXY_MAX_ROUTES);
+    __type(key, struct xdp_mroute_key);
+    __type(value, struct xdp_mroute_value);
+} mcproxy_routes SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, MCPROXY_MAX_IFS);
+    __type(key, __u32);
+    __type(value, struct xdp_mroute_if);
+} mcproxy_ifs SEC(".maps");
+
+struct {
+    __uint(type, BPF_MAP_TYPE_DEVMAP_HASH);
+    __uint(max_entries, MCPROXY_MAX_IFS);
+    __type(key, __u32);
+    __type(value, struct bpf_devmap_val);
+} mcproxy_devs SEC(".maps");
+
+//fill the key with the addresses of a routable multicast packet, returns its TTL (hop limit) field or NULL
+static __always_inline __u8* parse(struct xdp_md* ctx, struct xdp_mroute_key* key, struct iphdr** ip4)
+{
+    void* data = (void*)(long)ctx->data;
+    void* data_end = (void*)(long)ctx->data_end;
+    struct ethhdr* eth = data;
+
+    if ((void*)(eth + 1) > data_end) {
+        return NULL;
+    }
+
+    __builtin_memset(key, 0, sizeof(*key));
+    *ip4 = NULL;
+
+    if (eth->h_proto == bpf_htons(ETH_P_IP)) {
+        struct iphdr* ip = (void*)(eth + 1);
+        if ((void*)(ip + 1) > data_end) {
+            return NULL;
+        }
+
+        //224.0.0.0/4 without the link local groups 224.0.0.0/24
+        __u32 daddr = bpf_ntohl(ip->daddr);
+        if ((daddr & 0xf0000000) != 0xe0000000 || (daddr & 0xffffff00) == 0xe0000000) {
+            return NULL;
+        }
+
+        key->family = MCPROXY_AF_INET;
+        __builtin_memcpy(key->source, &ip->saddr, sizeof(ip->saddr));
+        __builtin_memcpy(key->group, &ip->daddr, sizeof(ip->daddr));
+        *ip4 = ip;
+        return &ip->ttl;
+    } else if (eth->h_proto == bpf_htons(ETH_P_IPV6)) {
+        struct ipv6hdr* ip6 = (void*)(eth + 1);
+        if ((void*)(ip6 + 1) > data_end) {
+            return NULL;
+        }
+
+        //ff00::/8 with a scope wider than link local
+        if (ip6->daddr.s6_addr[0] != 0xff || (ip6->daddr.s6_addr[1] & 0x0f) <= 2) {
+            return NULL;
+        }
+
+        key->family = MCPROXY_AF_INET6;
+        __builtin_memcpy(key->source, &ip6->saddr, sizeof(ip6->saddr));
+        __builtin_memcpy(key->group, &ip6->daddr, sizeof(ip6->daddr));
+        return &ip6->hop_limit;
+    }
+
+    return NULL;
+}
+
+SEC("xdp")
+int mcproxy_ingress(struct xdp_md* ctx)
+{
+    struct xdp_mroute_key key;
+    struct iphdr* ip4;
+    __u8* ttl = parse(ctx, &key, &ip4);
+    if (ttl == NULL || *ttl <= 1) {
+        return XDP_PASS;
+    }
+
+    __u32 if_index = ctx->ingress_ifindex;
+    struct xdp_mroute_if* in = bpf_map_lookup_elem(&mcproxy_ifs, &if_index);
+    if (in == NULL) {
+        return XDP_PASS;
+    }
+
+    //the instances sharing this interface have their own routes
+    int found = 0;
+    key.input_if_index = if_index;
+    for (int i = 0; i < XDP_MROUTE_MAX_TABLES && i < in->table_count; ++i) {
+        key.table = in->table[i];
+        struct xdp_mroute_value* route = bpf_map_lookup_elem(&mcproxy_routes, &key);
+        if (route != NULL) {
+            __sync_fetch_and_add(&route->pkt_count, 1);
+            found = 1;
+        }
+    }
+
+    //the kernel reports the new source to the proxy
+    if (!found) {
+        return XDP_PASS;
+    }
+
+    //TTL and protocol share a checksum word (RFC 1624)
+    if (ip4 != NULL) {
+        __u32 check = ip4->check;
+        check += bpf_htons(0x0100);
+        ip4->check = (__u16)(check + (check >= 0xffff));
+    }
+    --*ttl;
+
+    return bpf_redirect_map(&mcproxy_devs, 0, BPF_F_BROADCAST | BPF_F_EXCLUDE_INGRESS);
+}
+
+SEC("xdp/devmap")
+int mcproxy_egress(struct xdp_md* ctx)
+{
+    struct xdp_mroute_key key;
+    struct iphdr* ip4;
+    if (parse(ctx, &key, &ip4) == NULL) {
+        return XDP_DROP;
+    }
+
+    __u32 in_index = ctx->ingress_ifindex;
+    __u32 out_index = ctx->egress_ifindex;
+    struct xdp_mroute_if* in = bpf_map_lookup_elem(&mcproxy_ifs, &in_index);
+    struct xdp_mroute_if* out = bpf_map_lookup_elem(&mcproxy_ifs, &out_index);
+    if (in == NULL || out == NULL) {
+        return XDP_DROP;
+    }
+
+    key.input_if_index = in_index;
+    for (int i = 0; i < XDP_MROUTE_MAX_TABLES && i < in->table_count; ++i) {
+        key.table = in->table[i];
+        struct xdp_mroute_value* route = bpf_map_lookup_elem(&mcproxy_routes, &key);
+        if (route == NULL) {
+            continue;
+        }
+
+        for (int j = 0; j < XDP_MROUTE_MAX_OUTPUT_IFS && j < route->output_count; ++j) {
+            if (route->output_if_index[j] == out_index) {
+                void* data = (void*)(long)ctx->data;
+                void* data_end = (void*)(long)ctx->data_end;
+                struct ethhdr* eth = data;
+                if ((void*)(eth + 1) > data_end) {
+                    return XDP_DROP;
+                }
+
+                __builtin_memcpy(eth->h_source, out->mac, ETH_ALEN);
+                return XDP_PASS;
+            }
+        }
+    }
+
+    return XDP_DROP;
+}
+
+char _license[] SEC("license") = "GPL";